@@ -75,6 +75,8 @@ extern void *block_cache_get_empty(void *cache, off_t blockNumber,
 extern status_t block_cache_get_etc(void *cache, off_t blockNumber,
 					off_t base, off_t length, const void** _block);
 extern const void *block_cache_get(void *cache, off_t blockNumber);
+extern status_t block_cache_prefetch(void *cache, off_t blockNumber,
+					size_t numBlocks);
 extern status_t block_cache_set_dirty(void *cache, off_t blockNumber,
 					bool isDirty, int32 transaction);
 extern void block_cache_put(void *cache, off_t blockNumber);
@@ -17,6 +17,7 @@
 #include <sys/uio.h>
 
 
+struct attr_io_vec;
 struct dirent;
 struct stat;
 struct fs_info;
@@ -39,7 +40,9 @@ struct file_io_vec {
 	off_t	length;
 };
 
-#define	B_CURRENT_FS_API_VERSION "/v1"
+#define	B_CURRENT_FS_API_VERSION "/v2"
+	// v2: added fs_vnode_ops::read_dir_stat(), read_attrs(), and
+	// write_attrs()
 
 // flags for publish_vnode() and fs_volume_ops::get_vnode()
 #define B_VNODE_PUBLISH_REMOVED					0x01
@@ -251,6 +254,18 @@ struct fs_vnode_ops {
 				const struct flock* lock, bool wait);
 	status_t (*release_lock)(fs_volume* volume, fs_vnode* vnode, void* cookie,
 				const struct flock* lock);
+
+	/* bulk directory operations */
+	status_t (*read_dir_stat)(fs_volume* volume, fs_vnode* vnode,
+				void* cookie, struct dirent* buffer, size_t bufferSize,
+				struct stat* stats, const char* attribute,
+				void* attributeBuffer, size_t attributeSize, uint32* _num);
+
+	/* bulk attribute operations */
+	status_t (*read_attrs)(fs_volume* volume, fs_vnode* vnode,
+				struct attr_io_vec* vecs, size_t count);
+	status_t (*write_attrs)(fs_volume* volume, fs_vnode* vnode,
+				struct attr_io_vec* vecs, size_t count);
 };
 
 struct file_system_module_info {
@@ -15,6 +15,14 @@ typedef struct attr_info {
 	off_t	size;
 } attr_info;
 
+typedef struct attr_io_vec {
+	const char	*name;
+	uint32		type;		/* only used when writing */
+	void		*buffer;
+	size_t		length;		/* in: buffer size, out: bytes transferred */
+	status_t	status;		/* out: result for this attribute */
+} attr_io_vec;
+
 
 #ifdef  __cplusplus
 extern "C" {
@@ -27,6 +35,10 @@ extern ssize_t	fs_write_attr(int fd, const char *attribute, uint32 type,
 extern int		fs_remove_attr(int fd, const char *attribute);
 extern int		fs_stat_attr(int fd, const char *attribute,
 					struct attr_info *attrInfo);
+extern int		fs_read_attrs(int fd, struct attr_io_vec *vecs,
+					size_t count);
+extern int		fs_write_attrs(int fd, struct attr_io_vec *vecs,
+					size_t count);
 
 extern int		fs_open_attr(const char *path, const char *attribute,
 					uint32 type, int openMode);
@@ -61,6 +61,10 @@ public:
 			ssize_t				ReadAttr(const char* name, type_code type,
 									off_t offset, void* buffer,
 									size_t length) const;
+			status_t			WriteAttrs(struct attr_io_vec* vecs,
+									size_t count);
+			status_t			ReadAttrs(struct attr_io_vec* vecs,
+									size_t count) const;
 			status_t			RemoveAttr(const char* name);
 			status_t			RenameAttr(const char* oldName,
 									const char* newName);
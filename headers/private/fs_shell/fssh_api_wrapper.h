@@ -852,6 +852,7 @@
 #define block_cache_get_empty			fssh_block_cache_get_empty
 #define block_cache_get_etc				fssh_block_cache_get_etc
 #define block_cache_get					fssh_block_cache_get
+#define block_cache_prefetch			fssh_block_cache_prefetch
 #define block_cache_set_dirty			fssh_block_cache_set_dirty
 #define block_cache_put					fssh_block_cache_put
 
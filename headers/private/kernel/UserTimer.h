@@ -69,6 +69,8 @@ protected:
 
 
 struct SystemTimeUserTimer : public UserTimer {
+								SystemTimeUserTimer();
+
 	virtual	void				Schedule(bigtime_t nextTime, bigtime_t interval,
 									uint32 flags, bigtime_t& _oldRemainingTime,
 									bigtime_t& _oldInterval);
@@ -81,6 +83,10 @@ protected:
 
 			void				ScheduleKernelTimer(bigtime_t now,
 									bool checkPeriodicOverrun);
+
+protected:
+			bool				fPrecise;
+				// set by a real-time thread, never coarse
 };
 
 
@@ -0,0 +1,147 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef _KERNEL_WORK_QUEUE_H
+#define _KERNEL_WORK_QUEUE_H
+
+
+#include <sys/cdefs.h>
+
+#include <KernelExport.h>
+
+#include <util/DoublyLinkedList.h>
+
+#include <condition_variable.h>
+
+
+// WorkQueue::Init() flags
+#define WORK_QUEUE_UNBOUND		0x01
+	// Use a single worker pool for all CPUs instead of one pool per CPU.
+
+
+struct work_queue_stats {
+	int64		queued;				// number of items queued so far
+	int64		executed;			// number of items executed so far
+	int32		pending;			// number of items currently queued
+	int32		max_pending;		// maximum number of items queued at once
+	bigtime_t	total_latency;		// sum of the queue-to-start latencies
+	bigtime_t	max_latency;		// maximum queue-to-start latency
+};
+
+
+namespace BKernel {
+
+
+class WorkQueue;
+struct WorkerPool;
+
+
+class WorkItem : public DoublyLinkedListLinkImpl<WorkItem> {
+public:
+								WorkItem();
+	virtual						~WorkItem();
+
+	virtual	void				DoWork(WorkQueue* queue) = 0;
+
+private:
+			friend class WorkQueue;
+
+private:
+	static	int32				_TimerHook(timer* timer);
+
+private:
+			WorkQueue*			fInQueue;
+			WorkerPool*			fPool;
+			bigtime_t			fQueueTime;
+			timer				fTimer;
+			WorkQueue*			fTimerQueue;
+};
+
+
+class FunctionWorkItem : public WorkItem {
+public:
+								FunctionWorkItem();
+
+			void				SetTo(void (*function)(void*), void* argument);
+
+	virtual	void				DoWork(WorkQueue* queue);
+
+private:
+			void 				(*fFunction)(void*);
+			void*				fArgument;
+};
+
+
+/*!	A queue of work items executed by kernel worker threads.
+
+	A bound queue has one worker pool per CPU; items are executed by the pool
+	of the CPU they were queued on. An unbound queue has a single pool shared
+	by all CPUs. Each pool runs at most \c maxActive items concurrently.
+	Items may be queued from interrupt context.
+*/
+class WorkQueue : public DoublyLinkedListLinkImpl<WorkQueue> {
+public:
+								WorkQueue();
+								~WorkQueue();
+
+	static	WorkQueue*			DefaultQueue();
+	static	WorkQueue*			DefaultUnboundQueue();
+
+			status_t			Init(const char* name, int32 priority,
+									uint32 flags, int32 maxActive);
+			void				Close(bool cancelPending);
+
+			status_t			Queue(WorkItem* item);
+			status_t			QueueOn(int32 cpu, WorkItem* item);
+			status_t			QueueDelayed(WorkItem* item,
+									bigtime_t delay);
+			bool				Cancel(WorkItem* item);
+
+			bool				IsWorkerThread(thread_id thread) const;
+
+			void				GetStatistics(work_queue_stats& stats) const;
+
+			const char*			Name() const	{ return fName; }
+			void				Dump() const;
+
+private:
+			struct Worker;
+
+private:
+	static	status_t			_WorkerEntry(void* data);
+			status_t			_Worker(Worker* worker);
+
+			status_t			_Queue(WorkerPool* pool, WorkItem* item);
+			Worker*				_ExecutingWorker(int32 pool,
+									WorkItem* item) const;
+			bool				_IsClosed() const
+									{ return fClosed; }
+
+private:
+			char				fName[B_OS_NAME_LENGTH];
+			uint32				fFlags;
+			int32				fMaxActive;
+			int32				fPoolCount;
+			WorkerPool*			fPools;
+			Worker*				fWorkers;
+			bool				fClosed;
+};
+
+
+}	// namespace BKernel
+
+
+using BKernel::FunctionWorkItem;
+using BKernel::WorkItem;
+using BKernel::WorkQueue;
+
+
+__BEGIN_DECLS
+
+void		work_queue_init();
+
+__END_DECLS
+
+
+#endif	// _KERNEL_WORK_QUEUE_H
@@ -26,6 +26,8 @@ bool		msi_supported();
 status_t	msi_allocate_vectors(uint32 count, uint32 *startVector,
 				uint64 *address, uint32 *data);
 void		msi_free_vectors(uint32 count, uint32 startVector);
+void		msi_set_vector_table(uint32 count, uint32 startVector,
+				addr_t tableAddress);
 
 #ifdef __cplusplus
 }
@@ -65,6 +65,11 @@ typedef struct CACHE_LINE_ALIGN cpu_ent {
 
 	int32			ici_counter;
 
+	// RCU read-side nesting and the generation seen at the last quiescent
+	// state (see util/rcu.h)
+	int32			rcu_read_nesting;
+	int64			rcu_generation;
+
 	// used in the kernel debugger
 	addr_t			fault_handler;
 	addr_t			fault_handler_stack_pointer;
@@ -23,6 +23,8 @@
 #define FILE_CACHE_LOADED_COMPLETELY	0x02
 #define FILE_CACHE_NO_IO				0x04
 
+struct dirty_device;
+
 struct cache_module_info {
 	module_info	info;
 
@@ -44,6 +46,16 @@ extern void cache_node_closed(struct vnode *vnode, int32 fdType, VMCache *cache,
 extern void cache_node_launched(size_t argCount, char * const *args);
 extern void cache_prefetch_vnode(struct vnode *vnode, off_t offset, size_t size);
 extern void cache_prefetch(dev_t mountID, ino_t vnodeID, off_t offset, size_t size);
+extern status_t cache_advise_vnode(struct vnode *vnode, void *cookie,
+				off_t offset, off_t length, int advice);
+extern void cache_node_cookie_freed(VMCache *cache, void *cookie);
+
+extern struct dirty_device *cache_acquire_dirty_device(dev_t device,
+				uint32 allocationFlags);
+extern void cache_release_dirty_device(struct dirty_device *device);
+extern void cache_balance_dirty_pages(VMCache *cache);
+extern void cache_dirty_pages_changed(struct dirty_device *device,
+				int32 delta);
 
 extern status_t file_map_init(void);
 extern status_t file_cache_init_post_boot_device(void);
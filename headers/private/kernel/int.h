@@ -18,6 +18,7 @@
 #define B_NO_LOCK_VECTOR	0x100
 #define B_NO_HANDLED_INFO	0x200
 
+struct interrupt_info;
 struct kernel_args;
 
 
@@ -40,6 +41,8 @@ struct irq_assignment {
 
 	int32		load;
 	int32		cpu;
+
+	bool		pinned;
 };
 
 
@@ -83,6 +86,13 @@ status_t allocate_io_interrupt_vectors(int32 count, int32 *startVector,
 	enum interrupt_type type);
 void free_io_interrupt_vectors(int32 count, int32 startVector);
 
+void split_io_interrupt_vectors(int32 count, int32 startVector);
+
 void assign_io_interrupt_to_cpu(int32 vector, int32 cpu);
+status_t set_io_interrupt_affinity(int32 vector, int32 cpu);
+
+status_t _user_get_next_interrupt_info(int32* _cookie,
+	struct interrupt_info* info, uint64* cpuCounts, uint32 cpuCount);
+status_t _user_set_interrupt_affinity(int32 vector, int32 cpu);
 
 #endif /* _KERNEL_INT_H */
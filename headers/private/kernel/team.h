@@ -51,6 +51,7 @@ void team_set_controlling_tty(void* tty);
 void* team_get_controlling_tty();
 status_t team_set_foreground_process_group(void *tty, pid_t processGroup);
 uid_t team_geteuid(team_id id);
+int32 team_get_io_class(team_id id);
 
 status_t start_watching_team(team_id team, void (*hook)(team_id, void *),
 			void *data);
@@ -86,6 +87,8 @@ status_t _user_get_team_usage_info(team_id team, int32 who,
 			team_usage_info *info, size_t size);
 status_t _user_get_extended_team_info(team_id teamID, uint32 flags,
 			void* buffer, size_t size, size_t* _sizeNeeded);
+status_t _user_set_team_io_class(team_id team, int32 ioClass);
+int32 _user_get_team_io_class(team_id team);
 
 #ifdef __cplusplus
 }
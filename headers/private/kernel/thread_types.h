@@ -25,6 +25,7 @@
 #include <util/DoublyLinkedList.h>
 #include <util/KernelReferenceable.h>
 #include <util/list.h>
+#include <util/rcu.h>
 
 #include <SupportDefs.h>
 
@@ -245,6 +246,7 @@ struct Team : TeamThreadIteratorEntry<team_id>, KernelReferenceable,
 	struct realtime_sem_context	*realtime_sem_context;
 	struct xsi_sem_context *xsi_sem_context;
 	struct team_death_entry *death_entry;	// protected by fLock
+	int32			io_class;		// one of IO_CLASS_*; accessed atomically
 	struct list		dead_threads;
 
 	// protected by the team's fLock
@@ -263,7 +265,8 @@ struct Team : TeamThreadIteratorEntry<team_id>, KernelReferenceable,
 	struct team_loading_info *loading_info;	// protected by fLock
 	struct list		image_list;		// protected by sImageMutex
 	struct list		watcher_list;
-	struct list		sem_list;		// protected by sSemsSpinlock
+	struct list		sem_list;		// protected by sem_list_lock
+	spinlock		sem_list_lock;
 	struct list		port_list;		// protected by sPortsLock
 	struct arch_team arch_info;
 
@@ -307,9 +310,14 @@ struct Team : TeamThreadIteratorEntry<team_id>, KernelReferenceable,
 
 	spinlock		signal_lock;
 
+	rcu_head		rcu_entry;		// defers freeing the object until lockless
+									// hash lookups can no longer see it
+
 public:
 								~Team();
 
+			void				operator delete(void* pointer);
+
 	static	Team*				Create(team_id id, const char* name,
 									bool kernel);
 	static	Team*				Get(team_id id);
@@ -554,6 +562,9 @@ struct Thread : TeamThreadIteratorEntry<thread_id>, KernelReferenceable {
 	// architecture dependent section
 	struct arch_thread arch_info;
 
+	rcu_head		rcu_entry;		// defers freeing the object until lockless
+									// hash lookups can no longer see it
+
 public:
 								Thread() {}
 									// dummy for the idle threads
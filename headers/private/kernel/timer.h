@@ -23,8 +23,14 @@ struct kernel_args;
 #define B_TIMER_USE_TIMER_STRUCT_TIMES	0x4000
 	// For add_timer(): Use the timer::schedule_time (absolute time) and
 	// timer::period values instead of the period parameter.
+#define B_TIMER_COARSE					0x1000
+	// The timer may expire late by up to about an eighth of its delay. One-shot
+	// system time based timers with this flag are kept in a timer wheel, which
+	// makes adding and canceling them O(1). While such a timer is scheduled,
+	// its timer::period field is used internally. Short timers are always
+	// kept precise.
 #define B_TIMER_FLAGS	\
-	(B_TIMER_USE_TIMER_STRUCT_TIMES | B_TIMER_REAL_TIME_BASE)
+	(B_TIMER_USE_TIMER_STRUCT_TIMES | B_TIMER_REAL_TIME_BASE | B_TIMER_COARSE)
 
 /* Timer info structure */
 struct timer_info {
@@ -15,6 +15,9 @@ namespace BKernel {
 
 
 struct KernelReferenceable : BReferenceable, DeferredDeletable {
+public:
+			bool				TryAcquireReference();
+
 protected:
 	virtual	void				LastReferenceReleased();
 };
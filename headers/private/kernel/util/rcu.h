@@ -0,0 +1,120 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef _KERNEL_UTIL_RCU_H
+#define _KERNEL_UTIL_RCU_H
+
+
+#include <OS.h>
+
+#include <cpu.h>
+#include <debug.h>
+#include <int.h>
+#include <smp.h>
+
+
+/*!	Epoch based deferred reclamation for read-mostly data structures.
+
+	Readers enter a read-side critical section via rcu_read_lock(). Sections
+	run with interrupts disabled and therefore cannot be preempted; entering
+	one only touches a per-CPU counter. A CPU that performs a context switch
+	cannot be inside a critical section anymore, so the scheduler reports each
+	context switch as a quiescent state via rcu_quiescent_state().
+
+	Writers unlink an object from the shared structure (under whatever lock
+	protects the writer side) and hand it to rcu_call() or rcu_free(). The
+	rcu_head is usually embedded in the object and must not be one of the
+	fields readers look at. The callback is invoked from a kernel daemon with
+	interrupts enabled, once every CPU has passed a quiescent state after the
+	call, i.e. when no reader can still hold a pointer to the object.
+*/
+
+
+typedef void (*rcu_callback)(void* cookie);
+
+struct rcu_head {
+	struct rcu_head*	next;
+	rcu_callback		callback;
+	void*				cookie;
+	int64				generation;
+};
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int64 gRCUGeneration;
+
+void rcu_call(struct rcu_head* head, rcu_callback callback, void* cookie);
+void rcu_free(struct rcu_head* head, void* memory);
+void rcu_synchronize(void);
+
+status_t rcu_init(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+/*!	Enters a read-side critical section. Interrupts must be disabled. */
+static inline void
+rcu_read_lock(void)
+{
+	ASSERT(!are_interrupts_enabled());
+	gCPU[smp_get_current_cpu()].rcu_read_nesting++;
+}
+
+
+static inline void
+rcu_read_unlock(void)
+{
+	ASSERT(!are_interrupts_enabled());
+	ASSERT(gCPU[smp_get_current_cpu()].rcu_read_nesting > 0);
+	gCPU[smp_get_current_cpu()].rcu_read_nesting--;
+}
+
+
+/*!	Called by the scheduler on every context switch of the given CPU. */
+static inline void
+rcu_quiescent_state(int32 cpu)
+{
+	ASSERT(gCPU[cpu].rcu_read_nesting == 0);
+	gCPU[cpu].rcu_generation = atomic_get64(&gRCUGeneration);
+}
+
+
+#ifdef __cplusplus
+
+namespace BKernel {
+
+
+class RCUReadLocker {
+public:
+	inline RCUReadLocker()
+	{
+		fState = disable_interrupts();
+		rcu_read_lock();
+	}
+
+	inline ~RCUReadLocker()
+	{
+		rcu_read_unlock();
+		restore_interrupts(fState);
+	}
+
+private:
+	int		fState;
+};
+
+
+}	// namespace BKernel
+
+
+using BKernel::RCUReadLocker;
+
+#endif	// __cplusplus
+
+
+#endif	/* _KERNEL_UTIL_RCU_H */
@@ -32,6 +32,7 @@
 #define B_UNMOUNT_BUSY_PARTITION	0x80000000
 
 struct attr_info;
+struct attr_io_vec;
 struct file_descriptor;
 struct generic_io_vec;
 struct kernel_args;
@@ -182,6 +183,9 @@ int			_user_open_dir_node_ref(dev_t device, ino_t inode);
 int			_user_open_dir_entry_ref(dev_t device, ino_t inode,
 				const char *name);
 int			_user_open_dir(int fd, const char *path);
+ssize_t		_user_read_dir_stat(int fd, struct dirent *buffer,
+				size_t bufferSize, struct stat *stats, const char *attribute,
+				void *attributeBuffer, size_t attributeSize, uint32 maxCount);
 int			_user_open_parent_dir(int fd, char *name, size_t nameLength);
 status_t	_user_fcntl(int fd, int op, size_t argument);
 status_t	_user_fsync(int fd);
@@ -221,6 +225,8 @@ ssize_t		_user_write_attr(int fd, const char *attribute, uint32 type,
 				off_t pos, const void *buffer, size_t readBytes);
 status_t	_user_stat_attr(int fd, const char *attribute,
 				struct attr_info *attrInfo);
+status_t	_user_read_attrs(int fd, struct attr_io_vec *vecs, size_t count);
+status_t	_user_write_attrs(int fd, struct attr_io_vec *vecs, size_t count);
 int			_user_open_attr(int fd, const char* path, const char *name,
 				uint32 type, int openMode);
 status_t	_user_remove_attr(int fd, const char *name);
@@ -254,6 +260,7 @@ int			_user_dup2(int ofd, int nfd);
 status_t	_user_lock_node(int fd);
 status_t	_user_unlock_node(int fd);
 status_t	_user_preallocate(int fd, off_t offset, off_t length);
+status_t	_user_fadvise(int fd, off_t offset, off_t length, int advice);
 
 /* socket user prototypes (implementation in socket.cpp) */
 int			_user_socket(int family, int type, int protocol);
@@ -178,6 +178,10 @@ public:
 	virtual	void				AcquireStoreRef();
 	virtual	void				ReleaseStoreRef();
 
+	virtual	void				ModifiedPageCountChanged(int32 delta)
+									{}
+									// called for non-temporary caches only
+
 	virtual	bool				DebugHasPage(off_t offset);
 			vm_page*			DebugLookupPage(off_t offset);
 
@@ -0,0 +1,28 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef _SYSTEM_INTERRUPT_DEFS_H
+#define _SYSTEM_INTERRUPT_DEFS_H
+
+
+#include <OS.h>
+
+
+// interrupt_info::flags
+#define INTERRUPT_INFO_PINNED	0x01
+	// the vector has been bound to its CPU via _kern_set_interrupt_affinity()
+	// and is left alone by the automatic balancing
+
+
+typedef struct interrupt_info {
+	int32		vector;
+	int32		cpu;			// CPU the vector is routed to
+	uint32		flags;
+	int32		handlers;		// number of installed handlers
+	int32		load;			// per mille of the time spent in the handlers
+	uint64		count;			// number of interrupts, summed over all CPUs
+} interrupt_info;
+
+
+#endif	/* _SYSTEM_INTERRUPT_DEFS_H */
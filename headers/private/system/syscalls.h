@@ -22,11 +22,13 @@ extern "C" {
 #endif
 
 struct attr_info;
+struct attr_io_vec;
 struct dirent;
 struct event_wait_info;
 struct fd_info;
 struct fd_set;
 struct fs_info;
+struct interrupt_info;
 struct iovec;
 struct msqid_ds;
 struct net_stat;
@@ -196,6 +198,8 @@ extern status_t		_kern_get_team_usage_info(team_id team, int32 who,
 						team_usage_info *info, size_t size);
 extern status_t		_kern_get_extended_team_info(team_id teamID, uint32 flags,
 						void* buffer, size_t size, size_t* _sizeNeeded);
+extern status_t		_kern_set_team_io_class(team_id team, int32 ioClass);
+extern int32		_kern_get_team_io_class(team_id team);
 extern int			_kern_get_cpu();
 
 extern status_t		_kern_start_watching_system(int32 object, uint32 flags,
@@ -310,6 +314,10 @@ extern ssize_t		_kern_write_attr(int fd, const char *attribute, uint32 type,
 						off_t pos, const void *buffer, size_t readBytes);
 extern status_t		_kern_stat_attr(int fd, const char *attribute,
 						struct attr_info *attrInfo);
+extern status_t		_kern_read_attrs(int fd, struct attr_io_vec *vecs,
+						size_t count);
+extern status_t		_kern_write_attrs(int fd, struct attr_io_vec *vecs,
+						size_t count);
 extern int			_kern_open_attr(int fd, const char* path, const char *name,
 						uint32 type, int openMode);
 extern status_t		_kern_remove_attr(int fd, const char *name);
@@ -340,6 +348,10 @@ extern status_t		_kern_ioctl(int fd, uint32 cmd, void *data, size_t length);
 extern ssize_t		_kern_read_dir(int fd, struct dirent *buffer,
 						size_t bufferSize, uint32 maxCount);
 extern status_t		_kern_rewind_dir(int fd);
+extern ssize_t		_kern_read_dir_stat(int fd, struct dirent *buffer,
+						size_t bufferSize, struct stat *stats,
+						const char *attribute, void *attributeBuffer,
+						size_t attributeSize, uint32 maxCount);
 extern status_t		_kern_read_stat(int fd, const char *path, bool traverseLink,
 						struct stat *stat, size_t statSize);
 extern status_t		_kern_write_stat(int fd, const char *path,
@@ -353,6 +365,8 @@ extern status_t		_kern_unlock_node(int fd);
 extern status_t		_kern_get_next_fd_info(team_id team, uint32 *_cookie,
 						struct fd_info *info, size_t infoSize);
 extern status_t		_kern_preallocate(int fd, off_t offset, off_t length);
+extern status_t		_kern_fadvise(int fd, off_t offset, off_t length,
+						int advice);
 
 // socket functions
 extern int			_kern_socket(int family, int type, int protocol);
@@ -566,6 +580,10 @@ extern void			_kern_clear_caches(void *address, size_t length,
 						uint32 flags);
 extern bool			_kern_cpu_enabled(int32 cpu);
 extern status_t		_kern_set_cpu_enabled(int32 cpu, bool enabled);
+extern status_t		_kern_get_next_interrupt_info(int32 *_cookie,
+						struct interrupt_info *info, uint64 *cpuCounts,
+						uint32 cpuCount);
+extern status_t		_kern_set_interrupt_affinity(int32 vector, int32 cpu);
 
 #if defined(__i386__) || defined(__x86_64__)
 // our only x86 only syscall
@@ -35,6 +35,17 @@ enum {
 };
 
 
+// I/O priority classes of a team (_kern_set_team_io_class()). The I/O
+// scheduler serves the classes in this order, except for the default class,
+// which picks one depending on the I/O priority of the requesting thread.
+enum {
+	IO_CLASS_DEFAULT						= 0,
+	IO_CLASS_REALTIME						= 1,
+	IO_CLASS_BEST_EFFORT					= 2,
+	IO_CLASS_IDLE							= 3,
+};
+
+
 #define THREAD_CREATION_FLAG_DEFER_SIGNALS	0x01
 	// create the thread with signals deferred, i.e. with
 	// user_thread::defer_signals set to 1
@@ -2168,6 +2168,9 @@ PCI::ConfigureMSIX(PCIDev *device, uint32 count, uint32 *startVector)
 		*entry &= ~PCI_msix_vctrl_mask;
 	}
 
+	// allow the vectors to be distributed over the CPUs individually
+	msi_set_vector_table(count, info->start_vector, info->table_address);
+
 	info->configured_count = count;
 	*startVector = info->start_vector;
 	dprintf("msix configured for %" B_PRIu32 " vectors\n", count);
@@ -11,7 +11,9 @@
 #include <bus/PCI.h>
 #include <SupportDefs.h>
 
+#include <int.h>
 #include <kernel.h>
+#include <smp.h>
 #include <virtio.h>
 
 #include "virtio_pci.h"
@@ -512,6 +514,7 @@ setup_interrupt(void* cookie, uint16 queueCount)
 		}
 		int32 irq = bus->irq + 1;
 		if (bus->irq_type == VIRTIO_IRQ_MSI_X) {
+			int32 cpuCount = smp_get_num_cpus();
 			for (int32 queue = 0; queue < queueCount; queue++, irq++) {
 				bus->cookies[queue].sim = bus->sim;
 				bus->cookies[queue].queue = queue;
@@ -521,6 +524,15 @@ setup_interrupt(void* cookie, uint16 queueCount)
 					ERROR("can't install interrupt handler\n");
 					return status;
 				}
+
+				// Spread the queues over the CPUs: a queue is bound to the
+				// first CPU c for which c * queueCount / cpuCount is the queue,
+				// so that drivers using one queue per group of CPUs get the
+				// completions on the CPUs that submitted the requests.
+				int32 cpu = queue % cpuCount;
+				if (queueCount <= cpuCount)
+					cpu = (queue * cpuCount + queueCount - 1) / queueCount;
+				set_io_interrupt_affinity(irq, cpu);
 			}
 		} else {
 			status_t status = install_io_interrupt_handler(irq,
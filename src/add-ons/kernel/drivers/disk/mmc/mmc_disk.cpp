@@ -263,7 +263,8 @@ mmc_disk_init_driver(device_node* node, void** cookie)
 		return error;
 	}
 
-	info->scheduler = new(std::nothrow) IOSchedulerSimple(info->dmaResource);
+	info->scheduler = IOSchedulerRoster::Default()->CreateScheduler(
+		info->dmaResource, "mmc storage");
 	if (info->scheduler == NULL) {
 		TRACE("Failed to allocate scheduler");
 		delete info->dmaResource;
@@ -17,7 +17,8 @@
 
 #include <mmc.h>
 
-#include "IOSchedulerSimple.h"
+#include "dma_resources.h"
+#include "IOSchedulerRoster.h"
 
 
 enum MMCDiskFlags {
@@ -371,6 +371,14 @@ struct nvme_ctrlr_opts {
 	 */
 	enum nvme_cc_ams	arb_mechanism;
 
+	/**
+	 * Number of interrupt vectors to spread the I/O completion queues
+	 * over, not counting vector 0, which is used by the admin queue.
+	 * I/O queue n then signals vector ((n - 1) % io_interrupt_vectors) + 1.
+	 * (default: 0, all queues use vector 0)
+	 */
+	unsigned int		io_interrupt_vectors;
+
 };
 
 /**
@@ -210,6 +210,10 @@ int nvme_admin_create_ioq(struct nvme_ctrlr *ctrlr,
 		cmd.opc = NVME_OPC_CREATE_IO_CQ;
 #ifdef __HAIKU__ // TODO: Option!
 		cmd.cdw11 = 0x1 | 0x2; /* enable interrupts */
+		if (ctrlr->opts.io_interrupt_vectors > 0) {
+			cmd.cdw11 |= (((qpair->id - 1)
+				% ctrlr->opts.io_interrupt_vectors) + 1) << 16;
+		}
 #else
 		cmd.cdw11 = 0x1;
 #endif
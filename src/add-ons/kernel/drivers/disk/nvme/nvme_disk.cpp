@@ -13,6 +13,7 @@
 #include <algorithm>
 #include <condition_variable.h>
 #include <AutoDeleter.h>
+#include <int.h>
 #include <kernel.h>
 #include <smp.h>
 #include <util/AutoLock.h>
@@ -76,7 +77,7 @@ static const uint8 kDriveIcon[] = {
 
 static device_manager_info* sDeviceManager;
 
-typedef struct {
+typedef struct nvme_disk_driver_info {
 	device_node*			node;
 	pci_info				info;
 
@@ -93,11 +94,15 @@ typedef struct {
 
 	rw_lock					rounded_write_lock;
 
-	ConditionVariable		interrupt;
+	uint32					irq;
+	uint32					io_vector_count;
+		// if not 0, each qpair has its own interrupt vector, following irq
 	int32					polling;
 
 	struct qpair_info {
 		struct nvme_qpair*	qpair;
+		nvme_disk_driver_info* info;
+		ConditionVariable	interrupt;
 	}						qpairs[NVME_MAX_QPAIRS];
 	uint32					qpair_count;
 } nvme_disk_driver_info;
@@ -148,6 +153,7 @@ nvme_disk_set_capacity(nvme_disk_driver_info* info, uint64 capacity,
 
 
 static int32 nvme_interrupt_handler(void* _info);
+static int32 nvme_qpair_interrupt_handler(void* _qpinfo);
 
 
 static status_t
@@ -229,18 +235,45 @@ nvme_disk_init_device(void* _info, void** _cookie)
 	command &= ~(PCI_command_int_disable);
 	pci->write_pci_config(pcidev, PCI_command, 2, command);
 
+	// determine the number of qpairs
+	uint32 try_qpairs = cstat.io_qpairs;
+	try_qpairs = min_c(try_qpairs, NVME_MAX_QPAIRS);
+	if (try_qpairs >= (uint32)smp_get_num_cpus()) {
+		try_qpairs = smp_get_num_cpus();
+	} else {
+		// Find the highest number of qpairs that evenly divides the number of CPUs.
+		while ((smp_get_num_cpus() % try_qpairs) != 0)
+			try_qpairs--;
+	}
+
 	uint32 irq = info->info.u.h0.interrupt_line;
 	if (irq == 0xFF)
 		irq = 0;
 
-	if (pci->get_msix_count(pcidev)) {
+	// Give each qpair its own MSI-X vector if there are enough of them; the
+	// first one is used for the admin queue.
+	uint32 msixCount = pci->get_msix_count(pcidev);
+	info->io_vector_count = 0;
+	if (try_qpairs > 1 && msixCount > try_qpairs) {
+		uint32 msixVector = 0;
+		if (pci->configure_msix(pcidev, try_qpairs + 1, &msixVector) == B_OK
+			&& pci->enable_msix(pcidev) == B_OK) {
+			TRACE_ALWAYS("using MSI-X, %" B_PRIu32 " I/O vectors\n",
+				try_qpairs);
+			irq = msixVector;
+			info->io_vector_count = try_qpairs;
+		} else
+			pci->unconfigure_msi(pcidev);
+	}
+
+	if (info->io_vector_count == 0 && msixCount > 0) {
 		uint32 msixVector = 0;
 		if (pci->configure_msix(pcidev, 1, &msixVector) == B_OK
 			&& pci->enable_msix(pcidev) == B_OK) {
 			TRACE_ALWAYS("using MSI-X\n");
 			irq = msixVector;
 		}
-	} else if (pci->get_msi_count(pcidev) >= 1) {
+	} else if (info->io_vector_count == 0 && pci->get_msi_count(pcidev) >= 1) {
 		uint32 msiVector = 0;
 		if (pci->configure_msi(pcidev, 1, &msiVector) == B_OK
 			&& pci->enable_msi(pcidev) == B_OK) {
@@ -256,9 +289,25 @@ nvme_disk_init_device(void* _info, void** _cookie)
 	} else {
 		info->polling = 0;
 	}
-	info->interrupt.Init(NULL, NULL);
+	info->irq = irq;
+
+	for (uint32 i = 0; i < NVME_MAX_QPAIRS; i++) {
+		info->qpairs[i].info = info;
+		info->qpairs[i].interrupt.Init(&info->qpairs[i], "nvme qpair");
+	}
+
 	install_io_interrupt_handler(irq, nvme_interrupt_handler, (void*)info, B_NO_HANDLED_INFO);
 
+	// Bind each qpair's vector to the first CPU that submits to it (see
+	// get_qpair()), so that its completions are handled where they were
+	// issued.
+	for (uint32 i = 0; i < info->io_vector_count; i++) {
+		install_io_interrupt_handler(irq + 1 + i, nvme_qpair_interrupt_handler,
+			&info->qpairs[i], B_NO_HANDLED_INFO);
+		set_io_interrupt_affinity(irq + 1 + i, i);
+	}
+	info->ctrlr->opts.io_interrupt_vectors = info->io_vector_count;
+
 	if (info->ctrlr->feature_supported[NVME_FEAT_INTERRUPT_COALESCING]) {
 		uint32 microseconds = 16, threshold = 32;
 		nvme_admin_set_feature(info->ctrlr, false, NVME_FEAT_INTERRUPT_COALESCING,
@@ -266,15 +315,6 @@ nvme_disk_init_device(void* _info, void** _cookie)
 	}
 
 	// allocate qpairs
-	uint32 try_qpairs = cstat.io_qpairs;
-	try_qpairs = min_c(try_qpairs, NVME_MAX_QPAIRS);
-	if (try_qpairs >= (uint32)smp_get_num_cpus()) {
-		try_qpairs = smp_get_num_cpus();
-	} else {
-		// Find the highest number of qpairs that evenly divides the number of CPUs.
-		while ((smp_get_num_cpus() % try_qpairs) != 0)
-			try_qpairs--;
-	}
 	info->qpair_count = 0;
 	for (uint32 i = 0; i < try_qpairs; i++) {
 		info->qpairs[i].qpair = nvme_ioqp_get(info->ctrlr,
@@ -333,8 +373,12 @@ nvme_disk_uninit_device(void* _cookie)
 	CALLED();
 	nvme_disk_driver_info* info = (nvme_disk_driver_info*)_cookie;
 
-	remove_io_interrupt_handler(info->info.u.h0.interrupt_line,
-		nvme_interrupt_handler, (void*)info);
+	remove_io_interrupt_handler(info->irq, nvme_interrupt_handler,
+		(void*)info);
+	for (uint32 i = 0; i < info->io_vector_count; i++) {
+		remove_io_interrupt_handler(info->irq + 1 + i,
+			nvme_qpair_interrupt_handler, &info->qpairs[i]);
+	}
 
 	rw_lock_destroy(&info->rounded_write_lock);
 
@@ -392,12 +436,26 @@ static int32
 nvme_interrupt_handler(void* _info)
 {
 	nvme_disk_driver_info* info = (nvme_disk_driver_info*)_info;
-	info->interrupt.NotifyAll();
+	if (info->io_vector_count == 0) {
+		// all qpairs share this vector
+		for (uint32 i = 0; i < info->qpair_count; i++)
+			info->qpairs[i].interrupt.NotifyAll();
+	}
 	info->polling = -1;
 	return 0;
 }
 
 
+static int32
+nvme_qpair_interrupt_handler(void* _qpinfo)
+{
+	qpair_info* qpinfo = (qpair_info*)_qpinfo;
+	qpinfo->interrupt.NotifyAll();
+	qpinfo->info->polling = -1;
+	return 0;
+}
+
+
 static qpair_info*
 get_qpair(nvme_disk_driver_info* info)
 {
@@ -413,14 +471,15 @@ io_finished_callback(status_t* status, const struct nvme_cpl* cpl)
 
 
 static void
-await_status(nvme_disk_driver_info* info, struct nvme_qpair* qpair, status_t& status)
+await_status(nvme_disk_driver_info* info, qpair_info* qpinfo, status_t& status)
 {
 	CALLED();
 
+	struct nvme_qpair* qpair = qpinfo->qpair;
 	ConditionVariableEntry entry;
 	int timeouts = 0;
 	while (status == EINPROGRESS) {
-		info->interrupt.Add(&entry);
+		qpinfo->interrupt.Add(&entry);
 
 		nvme_qpair_poll(qpair, 0);
 
@@ -433,7 +492,7 @@ await_status(nvme_disk_driver_info* info, struct nvme_qpair* qpair, status_t& st
 			timeouts++;
 		} else if (entry.Wait(B_RELATIVE_TIMEOUT, 5 * 1000 * 1000) != B_OK) {
 			// This should never happen, as we are woken up on every interrupt
-			// no matter the qpair or transfer within; so if it does occur,
+			// for our qpair no matter the transfer within; so if it does occur,
 			// that probably means the controller stalled, or maybe cannot
 			// generate interrupts at all.
 
@@ -532,7 +591,7 @@ do_nvme_io_request(nvme_disk_driver_info* info, nvme_io_request* request)
 		return ret;
 	}
 
-	await_status(info, qpinfo->qpair, request->status);
+	await_status(info, qpinfo, request->status);
 
 	if (request->status != B_OK) {
 		TRACE_ERROR("%s at LBA %" B_PRIdOFF " of %" B_PRIuSIZE
@@ -852,7 +911,7 @@ nvme_disk_flush(nvme_disk_driver_info* info)
 	if (ret != 0)
 		return ret;
 
-	await_status(info, qpinfo->qpair, status);
+	await_status(info, qpinfo, status);
 	return status;
 }
 
@@ -919,7 +978,7 @@ nvme_disk_trim(nvme_disk_driver_info* info, fs_trim_data* trimData)
 			(nvme_cmd_cb)io_finished_callback, &status) != 0)
 		return B_IO_ERROR;
 
-	await_status(info, qpair->qpair, status);
+	await_status(info, qpair, status);
 	if (status != B_OK)
 		return status;
 
@@ -29,7 +29,7 @@
 
 #include "dma_resources.h"
 #include "IORequest.h"
-#include "IOSchedulerSimple.h"
+#include "IOSchedulerRoster.h"
 
 
 //#define TRACE_SCSI_DISK
@@ -426,8 +426,8 @@ das_set_capacity(das_driver_info* info, uint64 capacity, uint32 blockSize, uint3
 		if (status != B_OK)
 			panic("initializing DMAResource failed: %s", strerror(status));
 
-		info->io_scheduler = new(std::nothrow) IOSchedulerSimple(
-			info->dma_resource);
+		info->io_scheduler = IOSchedulerRoster::Default()->CreateScheduler(
+			info->dma_resource, "scsi");
 		if (info->io_scheduler == NULL)
 			panic("allocating IOScheduler failed.");
 
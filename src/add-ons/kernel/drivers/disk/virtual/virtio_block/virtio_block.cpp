@@ -6,6 +6,7 @@
 
 #include <condition_variable.h>
 #include <lock.h>
+#include <smp.h>
 #include <StackOrHeapArray.h>
 #include <virtio.h>
 
@@ -47,20 +48,46 @@ static const uint8 kDriveIcon[] = {
 #define VIRTIO_BLOCK_DEVICE_MODULE_NAME "drivers/disk/virtual/virtio_block/device_v1"
 #define VIRTIO_BLOCK_DEVICE_ID_GENERATOR	"virtio_block/device_id"
 
+#define VIRTIO_BLOCK_MAX_QUEUES		VIRTIO_VIRTQUEUES_MAX_COUNT
+#define VIRTIO_BLOCK_QUEUE_SLOTS	32
+	// requests that can be in flight on each queue
+#define VIRTIO_BLOCK_SLOT_SIZE		32
+	// room for the request header, and the status byte
+#define VIRTIO_BLOCK_DMA_BUFFERS	32
+
+
+struct virtio_block_driver_info;
 
 typedef struct {
+	virtio_block_driver_info*	info;
+	::virtio_queue			virtio_queue;
+
+	addr_t					bufferAddr;
+	phys_addr_t				bufferPhysAddr;
+
+	spinlock				lock;
+	uint32					used_slots;
+	uint32					done_slots;
+	uint32					abandoned_slots;
+		// slots of requests that timed out, freed once they complete
+	ConditionVariable		slot_condition;
+	ConditionVariable		done_conditions[VIRTIO_BLOCK_QUEUE_SLOTS];
+} virtio_block_queue;
+
+
+typedef struct virtio_block_driver_info {
 	device_node*			node;
 	::virtio_device			virtio_device;
 	virtio_device_interface*	virtio;
-	::virtio_queue			virtio_queue;
 	IOScheduler*			io_scheduler;
 	DMAResource*			dma_resource;
+	sem_id					dma_buffers_sem;
+	rw_lock					rounded_write_lock;
 
 	struct virtio_blk_config	config;
 
 	area_id					bufferArea;
 	addr_t					bufferAddr;
-	phys_addr_t				bufferPhysAddr;
 
 	uint64 					features;
 	uint64					capacity;
@@ -68,10 +95,8 @@ typedef struct {
 	uint32					physical_block_size;
 	status_t				media_status;
 
-	mutex					lock;
-	int32					currentRequest;
-	ConditionVariable		interruptCondition;
-	ConditionVariableEntry 	interruptConditionEntry;
+	virtio_block_queue		queues[VIRTIO_BLOCK_MAX_QUEUES];
+	uint32					queue_count;
 } virtio_block_driver_info;
 
 
@@ -85,10 +110,11 @@ typedef struct {
 #include <stdlib.h>
 
 #include <fs/devfs.h>
+#include <util/AutoLock.h>
 
 #include "dma_resources.h"
 #include "IORequest.h"
-#include "IOSchedulerSimple.h"
+#include "IOSchedulerRoster.h"
 
 
 //#define TRACE_VIRTIO_BLOCK
@@ -131,6 +157,8 @@ get_feature_name(uint64 feature)
 			return "topology";
 		case VIRTIO_BLK_F_CONFIG_WCE:
 			return "config wce";
+		case VIRTIO_BLK_F_MQ:
+			return "multiple queues";
 	}
 	return NULL;
 }
@@ -177,35 +205,85 @@ virtio_block_config_callback(void* driverCookie)
 static void
 virtio_block_callback(void* driverCookie, void* _cookie)
 {
-	virtio_block_driver_info* info = (virtio_block_driver_info*)_cookie;
+	virtio_block_queue* queue = (virtio_block_queue*)_cookie;
+
+	InterruptsSpinLocker locker(queue->lock);
 
 	void* cookie = NULL;
-	while (info->virtio->queue_dequeue(info->virtio_queue, &cookie, NULL)) {
-		if ((int32)(addr_t)cookie == atomic_get(&info->currentRequest))
-			info->interruptCondition.NotifyAll();
+	while (queue->info->virtio->queue_dequeue(queue->virtio_queue, &cookie,
+			NULL)) {
+		int32 slot = (int32)(addr_t)cookie - 1;
+		uint32 mask = 1U << slot;
+
+		if ((queue->abandoned_slots & mask) != 0) {
+			queue->abandoned_slots &= ~mask;
+			queue->used_slots &= ~mask;
+			queue->slot_condition.NotifyAll();
+			continue;
+		}
+
+		queue->done_slots |= mask;
+		queue->done_conditions[slot].NotifyAll();
 	}
 }
 
 
-static status_t
-do_io(void* cookie, IOOperation* operation)
+/*!	Returns the queue the current CPU submits its requests to; the CPUs are
+	split into as many groups as there are queues, and the queue's interrupt
+	is bound to the first CPU of its group by the virtio bus.
+*/
+static virtio_block_queue*
+get_queue(virtio_block_driver_info* info)
 {
-	virtio_block_driver_info* info = (virtio_block_driver_info*)cookie;
+	return &info->queues[smp_get_current_cpu() * info->queue_count
+		/ smp_get_num_cpus()];
+}
 
-	if (mutex_trylock(&info->lock) != B_OK)
-		return B_BUSY;
 
+/*!	Transfers the data of \a operation, and waits for it to complete. Any
+	number of threads may do this at the same time, as long as there are
+	free slots for their requests in the queue they are using.
+*/
+static status_t
+transfer(virtio_block_driver_info* info, IOOperation* operation)
+{
 	BStackOrHeapArray<physical_entry, 16> entries(operation->VecCount() + 2);
+	if (!entries.IsValid())
+		return B_NO_MEMORY;
+
+	virtio_block_queue* queue = get_queue(info);
+
+	// reserve a slot for the request header, and the status
+	InterruptsSpinLocker locker(queue->lock);
+	while (queue->used_slots == ~(uint32)0) {
+		ConditionVariableEntry entry;
+		queue->slot_condition.Add(&entry);
+		locker.Unlock();
+		entry.Wait();
+		locker.Lock();
+	}
+
+	int32 slot = 0;
+	while ((queue->used_slots & (1U << slot)) != 0)
+		slot++;
+	uint32 mask = 1U << slot;
+	queue->used_slots |= mask;
+	queue->done_slots &= ~mask;
+	locker.Unlock();
+
+	addr_t slotAddress = queue->bufferAddr + slot * VIRTIO_BLOCK_SLOT_SIZE;
+	phys_addr_t slotPhysAddress = queue->bufferPhysAddr
+		+ slot * VIRTIO_BLOCK_SLOT_SIZE;
 
-	struct virtio_blk_outhdr *header = (struct virtio_blk_outhdr*)info->bufferAddr;
+	struct virtio_blk_outhdr *header = (struct virtio_blk_outhdr*)slotAddress;
 	header->type = operation->IsWrite() ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
 	header->sector = operation->Offset() / 512;
 	header->ioprio = 1;
 
-	uint8* ack = (uint8*)info->bufferAddr + sizeof(struct virtio_blk_outhdr);
+	uint8* ack = (uint8*)slotAddress + sizeof(struct virtio_blk_outhdr);
 	*ack = 0xff;
 
-	entries[0].address = info->bufferPhysAddr;
+	entries[0].address = slotPhysAddress;
 	entries[0].size = sizeof(struct virtio_blk_outhdr);
 	entries[operation->VecCount() + 1].address = entries[0].address
 		+ sizeof(struct virtio_blk_outhdr);
@@ -214,39 +292,135 @@ do_io(void* cookie, IOOperation* operation)
 	memcpy(entries + 1, operation->Vecs(), operation->VecCount()
 		* sizeof(physical_entry));
 
-	atomic_add(&info->currentRequest, 1);
-	info->interruptCondition.Add(&info->interruptConditionEntry);
-
-	info->virtio->queue_request_v(info->virtio_queue, entries,
-		1 + (operation->IsWrite() ? operation->VecCount() : 0 ),
-		1 + (operation->IsWrite() ? 0 : operation->VecCount()),
-		(void *)(addr_t)info->currentRequest);
-
-	status_t result = info->interruptConditionEntry.Wait(B_RELATIVE_TIMEOUT,
-		10 * 1000 * 1000);
-
-	size_t bytesTransferred = 0;
-	status_t status = B_OK;
-	if (result != B_OK) {
-		status = EIO;
-	} else {
-		switch (*ack) {
-			case VIRTIO_BLK_S_OK:
-				status = B_OK;
-				bytesTransferred = operation->Length();
-				break;
-			case VIRTIO_BLK_S_UNSUPP:
-				status = ENOTSUP;
-				break;
-			default:
-				status = EIO;
-				break;
-		}
+	locker.Lock();
+
+	status_t status;
+	while (true) {
+		status = info->virtio->queue_request_v(queue->virtio_queue, entries,
+			1 + (operation->IsWrite() ? operation->VecCount() : 0 ),
+			1 + (operation->IsWrite() ? 0 : operation->VecCount()),
+			(void *)(addr_t)(slot + 1));
+		if (status != B_BUSY || queue->used_slots == mask)
+			break;
+
+		// the ring is full, wait until another request is done
+		ConditionVariableEntry entry;
+		queue->slot_condition.Add(&entry);
+		locker.Unlock();
+		entry.Wait();
+		locker.Lock();
+	}
+
+	if (status == B_OK && (queue->done_slots & mask) == 0) {
+		ConditionVariableEntry entry;
+		queue->done_conditions[slot].Add(&entry);
+		locker.Unlock();
+		entry.Wait(B_RELATIVE_TIMEOUT, 10 * 1000 * 1000);
+		locker.Lock();
 	}
 
+	if (status == B_OK && (queue->done_slots & mask) == 0) {
+		// the device still owns the slot
+		queue->abandoned_slots |= mask;
+		return EIO;
+	}
+
+	queue->used_slots &= ~mask;
+	queue->slot_condition.NotifyAll();
+	locker.Unlock();
+
+	if (status != B_OK)
+		return status;
+
+	switch (*ack) {
+		case VIRTIO_BLK_S_OK:
+			return B_OK;
+		case VIRTIO_BLK_S_UNSUPP:
+			return ENOTSUP;
+		default:
+			return EIO;
+	}
+}
+
+
+static status_t
+do_io(void* cookie, IOOperation* operation)
+{
+	virtio_block_driver_info* info = (virtio_block_driver_info*)cookie;
+
+	status_t status = transfer(info, operation);
+
 	info->io_scheduler->OperationCompleted(operation, status,
-		bytesTransferred);
-	mutex_unlock(&info->lock);
+		status == B_OK ? operation->Length() : 0);
+	return status;
+}
+
+
+/*!	Used instead of the I/O scheduler when the device has more than one
+	queue: the request is translated, and transferred by the calling thread
+	on the queue of its CPU, so that requests from different CPUs do not
+	have to pass through a single scheduler thread.
+*/
+static status_t
+direct_io(virtio_block_driver_info* info, io_request* request)
+{
+	IOBuffer* buffer = request->Buffer();
+	if (buffer->IsVirtual()) {
+		status_t status = buffer->LockMemory(request->TeamID(),
+			request->IsWrite());
+		if (status != B_OK) {
+			request->SetStatusAndNotify(status);
+			return status;
+		}
+	}
+
+	// Writes that do not cover whole blocks need to read the rest of the
+	// first and last block; they must not run concurrently with other writes.
+	ReadLocker readLocker;
+	WriteLocker writeLocker;
+	if (request->IsWrite()) {
+		if ((request->Offset() % info->block_size) != 0
+			|| (request->Length() % info->block_size) != 0)
+			writeLocker.SetTo(info->rounded_write_lock, false);
+		else
+			readLocker.SetTo(info->rounded_write_lock, false);
+	}
+
+	status_t status = acquire_sem(info->dma_buffers_sem);
+	if (status != B_OK) {
+		request->SetStatusAndNotify(status);
+		return status;
+	}
+
+	while (request->RemainingBytes() > 0) {
+		IOOperation operation;
+		status = info->dma_resource->TranslateNext(request, &operation, 0);
+		if (status != B_OK)
+			break;
+
+		do {
+			status = transfer(info, &operation);
+			operation.SetStatus(status,
+				status == B_OK ? operation.Length() : 0);
+		} while (status == B_OK && !operation.Finish());
+
+		if (status == B_OK && operation.Status() != B_OK)
+			status = operation.Status();
+
+		request->OperationFinished(&operation);
+		info->dma_resource->RecycleBuffer(operation.Buffer());
+
+		if (status != B_OK)
+			break;
+	}
+
+	release_sem(info->dma_buffers_sem);
+
+	// Notify() also takes care of UnlockMemory().
+	if (status != B_OK && request->Status() == B_OK)
+		request->SetStatusAndNotify(status);
+	else
+		request->NotifyFinished();
 	return status;
 }
 
@@ -270,7 +444,7 @@ virtio_block_init_device(void* _info, void** _cookie)
 			| VIRTIO_BLK_F_SEG_MAX | VIRTIO_BLK_F_GEOMETRY
 			| VIRTIO_BLK_F_RO | VIRTIO_BLK_F_BLK_SIZE
 			| VIRTIO_BLK_F_FLUSH | VIRTIO_BLK_F_TOPOLOGY
-			| VIRTIO_FEATURE_RING_INDIRECT_DESC,
+			| VIRTIO_BLK_F_MQ | VIRTIO_FEATURE_RING_INDIRECT_DESC,
 		&info->features, &get_feature_name);
 
 	status_t status = info->virtio->read_device_config(
@@ -284,18 +458,59 @@ virtio_block_init_device(void* _info, void** _cookie)
 	TRACE("virtio_block: capacity: %" B_PRIu64 ", block_size %" B_PRIu32 "\n",
 		info->capacity, info->block_size);
 
-	status = info->virtio->alloc_queues(info->virtio_device, 1,
-		&info->virtio_queue);
+	info->dma_buffers_sem = create_sem(VIRTIO_BLOCK_DMA_BUFFERS,
+		"virtio block buffers");
+	if (info->dma_buffers_sem < 0)
+		return info->dma_buffers_sem;
+
+	// use one queue per CPU, or group of CPUs, if the device supports it
+	uint32 queueCount = 1;
+	if ((info->features & VIRTIO_BLK_F_MQ) != 0) {
+		queueCount = min_c(info->config.num_queues,
+			min_c((uint32)smp_get_num_cpus(), VIRTIO_BLOCK_MAX_QUEUES));
+		if (queueCount == 0)
+			queueCount = 1;
+	}
+
+	::virtio_queue virtioQueues[VIRTIO_BLOCK_MAX_QUEUES];
+	status = info->virtio->alloc_queues(info->virtio_device, queueCount,
+		virtioQueues);
 	if (status != B_OK) {
 		ERROR("queue allocation failed (%s)\n", strerror(status));
 		return status;
 	}
+
+	for (uint32 i = 0; i < queueCount; i++) {
+		virtio_block_queue* queue = &info->queues[i];
+		queue->info = info;
+		queue->virtio_queue = virtioQueues[i];
+		queue->bufferAddr = info->bufferAddr
+			+ i * VIRTIO_BLOCK_QUEUE_SLOTS * VIRTIO_BLOCK_SLOT_SIZE;
+
+		physical_entry entry;
+		status = get_memory_map((void*)queue->bufferAddr,
+			VIRTIO_BLOCK_QUEUE_SLOTS * VIRTIO_BLOCK_SLOT_SIZE, &entry, 1);
+		if (status != B_OK)
+			return status;
+
+		queue->bufferPhysAddr = entry.address;
+		B_INITIALIZE_SPINLOCK(&queue->lock);
+		queue->slot_condition.Init(queue, "virtio block slot");
+		for (int32 slot = 0; slot < VIRTIO_BLOCK_QUEUE_SLOTS; slot++) {
+			queue->done_conditions[slot].Init(queue,
+				"virtio block transfer");
+		}
+	}
+	info->queue_count = queueCount;
+	TRACE("using %" B_PRIu32 " queues\n", queueCount);
+
 	status = info->virtio->setup_interrupt(info->virtio_device,
 		virtio_block_config_callback, info);
 
-	if (status == B_OK) {
-		status = info->virtio->queue_setup_interrupt(info->virtio_queue,
-			virtio_block_callback, info);
+	for (uint32 i = 0; status == B_OK && i < queueCount; i++) {
+		status = info->virtio->queue_setup_interrupt(
+			info->queues[i].virtio_queue, virtio_block_callback,
+			&info->queues[i]);
 	}
 
 	*_cookie = info;
@@ -309,6 +524,7 @@ virtio_block_uninit_device(void* _cookie)
 	CALLED();
 	virtio_block_driver_info* info = (virtio_block_driver_info*)_cookie;
 
+	delete_sem(info->dma_buffers_sem);
 	delete info->io_scheduler;
 	delete info->dma_resource;
 }
@@ -359,6 +575,9 @@ virtio_block_io(void *cookie, io_request *request)
 	CALLED();
 	virtio_block_handle* handle = (virtio_block_handle*)cookie;
 
+	if (handle->info->queue_count > 1)
+		return direct_io(handle->info, request);
+
 	return handle->info->io_scheduler->ScheduleRequest(request);
 }
 
@@ -469,12 +688,12 @@ virtio_block_set_capacity(virtio_block_driver_info* info)
 
 	// TODO: we need to replace the DMAResource in our IOScheduler
 	status_t status = info->dma_resource->Init(restrictions, blockSize,
-		1024, 32);
+		1024, VIRTIO_BLOCK_DMA_BUFFERS);
 	if (status != B_OK)
 		panic("initializing DMAResource failed: %s", strerror(status));
 
-	info->io_scheduler = new(std::nothrow) IOSchedulerSimple(
-		info->dma_resource);
+	info->io_scheduler = IOSchedulerRoster::Default()->CreateScheduler(
+		info->dma_resource, "virtio");
 	if (info->io_scheduler == NULL)
 		panic("allocating IOScheduler failed.");
 
@@ -553,9 +772,10 @@ virtio_block_init_driver(device_node *node, void **cookie)
 		return B_NO_MEMORY;
 	}
 
-	// create command buffer area
+	// create command buffer area, each queue gets its own part of it
 	info->bufferArea = create_area("virtio_block command buffer", (void**)&info->bufferAddr,
-		B_ANY_KERNEL_BLOCK_ADDRESS, B_PAGE_SIZE,
+		B_ANY_KERNEL_BLOCK_ADDRESS, ROUNDUP(VIRTIO_BLOCK_MAX_QUEUES
+			* VIRTIO_BLOCK_QUEUE_SLOTS * VIRTIO_BLOCK_SLOT_SIZE, B_PAGE_SIZE),
 		B_FULL_LOCK, B_KERNEL_READ_AREA | B_KERNEL_WRITE_AREA);
 	if (info->bufferArea < B_OK) {
 		status_t status = info->bufferArea;
@@ -564,19 +784,7 @@ virtio_block_init_driver(device_node *node, void **cookie)
 		return status;
 	}
 
-	physical_entry entry;
-	status_t status = get_memory_map((void*)info->bufferAddr, B_PAGE_SIZE, &entry, 1);
-	if (status != B_OK) {
-		delete_area(info->bufferArea);
-		delete info->dma_resource;
-		free(info);
-		return status;
-	}
-
-	info->bufferPhysAddr = entry.address;
-	info->interruptCondition.Init(info, "virtio block transfer");
-	info->currentRequest = 0;
-	mutex_init(&info->lock, "virtio block request");
+	rw_lock_init(&info->rounded_write_lock, "virtio block rounded writes");
 
 	info->node = node;
 
@@ -590,7 +798,7 @@ virtio_block_uninit_driver(void *_cookie)
 {
 	CALLED();
 	virtio_block_driver_info* info = (virtio_block_driver_info*)_cookie;
-	mutex_destroy(&info->lock);
+	rw_lock_destroy(&info->rounded_write_lock);
 	delete_area(info->bufferArea);
 	free(info);
 }
@@ -31,6 +31,12 @@ namespace BFS {
 #endif
 
 
+#if !_BOOT_MODE
+static const int32 kPrefetchNodes = 16;
+	// number of leaf nodes read ahead when iterating through a tree
+#endif
+
+
 /*!	Simple array used for the duplicate handling in the B+Tree. This is an
 	on disk structure.
 */
@@ -230,6 +236,50 @@ private:
 };
 
 
+/*!	Holds the complete keys of one or more nodes, so that they can be
+	changed, and written back to nodes with or without prefix compression.
+*/
+class KeyList {
+public:
+								KeyList();
+								~KeyList();
+
+			status_t			Add(const bplustree_node* node,
+									uint32 nodeSize);
+			status_t			Add(const uint8* key, uint16 keyLength,
+									off_t value);
+			status_t			Insert(int32 index, const uint8* key,
+									uint16 keyLength, off_t value);
+			void				Remove(int32 index);
+
+			int32				Count() const { return fCount; }
+			const uint8*		KeyAt(int32 index, uint16* _keyLength) const;
+			off_t				ValueAt(int32 index) const
+									{ return fValues[index]; }
+
+			int32				NodeSize(int32 first, int32 count,
+									bool prefixKeys) const;
+			void				WriteTo(bplustree_node* node, int32 first,
+									int32 count, bool prefixKeys) const;
+
+private:
+			status_t			_Grow(uint16 keyLength);
+			uint32				_KeyStart(int32 index) const
+									{ return index > 0
+										? fKeyEnds[index - 1] : 0; }
+			uint16				_PrefixLength(int32 first, int32 count,
+									bool prefixKeys) const;
+
+private:
+			uint8*				fKeys;
+			uint32*				fKeyEnds;
+			off_t*				fValues;
+			int32				fCount;
+			int32				fMaxCount;
+			uint32				fMaxLength;
+};
+
+
 // #pragma mark -
 
 
@@ -518,6 +568,37 @@ CachedNode::Free(Transaction& transaction, off_t offset)
 }
 
 
+/*!	Starts reading up to \a count nodes starting at \a offset into the block
+	cache, without waiting for them. Only the blocks in the same block run
+	as the first node are read.
+*/
+void
+CachedNode::Prefetch(off_t offset, int32 count)
+{
+	if (fTree == NULL || fTree->fStream == NULL || offset < 0)
+		return;
+
+	Inode* stream = fTree->fStream;
+	Volume* volume = stream->GetVolume();
+
+	off_t fileOffset;
+	block_run run;
+	if (offset >= stream->Size()
+		|| stream->FindBlockRun(offset, run, fileOffset) != B_OK)
+		return;
+
+	int32 blockOffset = (offset - fileOffset) >> volume->BlockShift();
+	int32 numBlocks = ((off_t)count * fTree->fNodeSize
+		+ volume->BlockSize() - 1) >> volume->BlockShift();
+	numBlocks = min_c(numBlocks, run.Length() - blockOffset);
+
+	if (numBlocks > 0) {
+		block_cache_prefetch(volume->BlockCache(),
+			volume->ToBlock(run) + blockOffset, numBlocks);
+	}
+}
+
+
 status_t
 CachedNode::Allocate(Transaction& transaction, bplustree_node** _node,
 	off_t* _offset)
@@ -582,6 +663,7 @@ CachedNode::Allocate(Transaction& transaction, bplustree_node** _node,
 BPlusTree::BPlusTree(Transaction& transaction, Inode* stream, int32 nodeSize)
 	:
 	fStream(NULL),
+	fPrefixKeys(false),
 	fInTransaction(false)
 {
 	mutex_init(&fIteratorLock, "bfs b+tree iterator");
@@ -593,6 +675,7 @@ BPlusTree::BPlusTree(Transaction& transaction, Inode* stream, int32 nodeSize)
 BPlusTree::BPlusTree(Inode* stream)
 	:
 	fStream(NULL),
+	fPrefixKeys(false),
 	fInTransaction(false)
 {
 #if !_BOOT_MODE
@@ -608,6 +691,7 @@ BPlusTree::BPlusTree()
 	fStream(NULL),
 	fNodeSize(BPLUSTREE_NODE_SIZE),
 	fAllowDuplicates(true),
+	fPrefixKeys(false),
 	fInTransaction(false),
 	fStatus(B_NO_INIT)
 {
@@ -661,6 +745,8 @@ BPlusTree::SetTo(Transaction& transaction, Inode* stream, int32 nodeSize)
 
 	fAllowDuplicates = stream->IsIndex()
 		|| (stream->Mode() & S_ALLOW_DUPS) != 0;
+	fPrefixKeys = stream->GetVolume()->HasFeature(
+		SUPER_BLOCK_FEATURE_PREFIX_KEYS);
 
 	fNodeSize = nodeSize;
 
@@ -745,6 +831,10 @@ BPlusTree::SetTo(Inode* stream)
 	// in the original BFS code - we will honour it nevertheless
 	fAllowDuplicates = stream->IsIndex()
 		|| (stream->Mode() & S_ALLOW_DUPS) != 0;
+#if !_BOOT_MODE
+	fPrefixKeys = stream->GetVolume()->HasFeature(
+		SUPER_BLOCK_FEATURE_PREFIX_KEYS);
+#endif
 
 	cached.SetTo(fHeader.RootNode());
 	RETURN_ERROR(fStatus = cached.Node() ? B_OK : B_BAD_DATA);
@@ -990,6 +1080,18 @@ BPlusTree::_UpdateIterators(off_t offset, off_t nextOffset, uint16 keyIndex,
 }
 
 
+void
+BPlusTree::_MoveIterators(off_t offset, off_t nextOffset, int32 shift)
+{
+	MutexLocker _(fIteratorLock);
+
+	SinglyLinkedList<TreeIterator>::Iterator iterator
+		= fIterators.GetIterator();
+	while (iterator.HasNext())
+		iterator.Next()->Move(offset, nextOffset, shift);
+}
+
+
 void
 BPlusTree::_AddIterator(TreeIterator* iterator)
 {
@@ -1062,11 +1164,11 @@ BPlusTree::_FindKey(const bplustree_node* node, const uint8* key,
 	for (int16 first = 0, last = node->NumKeys() - 1; first <= last;) {
 		uint16 i = (first + last) >> 1;
 
+		uint8 buffer[BPLUSTREE_MAX_KEY_LENGTH];
 		uint16 searchLength = 0;
-		uint8* searchKey = node->KeyAt(i, &searchLength);
-		if (searchKey + searchLength + sizeof(off_t) + sizeof(uint16)
-				> (uint8*)node + fNodeSize
-			|| searchLength > BPLUSTREE_MAX_KEY_LENGTH) {
+		const uint8* searchKey = node->GetKey(i, buffer, &searchLength,
+			fNodeSize);
+		if (searchKey == NULL) {
 #if !_BOOT_MODE
 			fStream->GetVolume()->Panic();
 #endif
@@ -1361,13 +1463,37 @@ BPlusTree::_InsertDuplicate(Transaction& transaction, CachedNode& cached,
 }
 
 
-void
+/*!	Inserts the key/value pair into the node at the given index, or returns
+	B_BUFFER_OVERFLOW if there is not enough space left in the node.
+*/
+status_t
 BPlusTree::_InsertKey(bplustree_node* node, uint16 index, uint8* key,
 	uint16 keyLength, off_t value)
 {
 	// should never happen, but who knows?
 	if (index > node->NumKeys())
-		return;
+		return B_BAD_VALUE;
+
+	if (_UsePrefixKeys(node)) {
+		KeyList keys;
+		status_t status = keys.Add(node, fNodeSize);
+		if (status == B_OK)
+			status = keys.Insert(index, key, keyLength, value);
+		if (status != B_OK)
+			return status;
+
+		if (keys.NodeSize(0, keys.Count(), fPrefixKeys) > fNodeSize)
+			return B_BUFFER_OVERFLOW;
+
+		keys.WriteTo(node, 0, keys.Count(), fPrefixKeys);
+		return B_OK;
+	}
+
+	// is the node big enough to hold the pair?
+	if (int32(key_align(sizeof(bplustree_node) + node->AllKeyLength()
+			+ keyLength) + (node->NumKeys() + 1) * (sizeof(uint16)
+			+ sizeof(off_t))) >= fNodeSize)
+		return B_BUFFER_OVERFLOW;
 
 	Unaligned<off_t>* values = node->Values();
 	Unaligned<uint16>* keyLengths = node->KeyLengths();
@@ -1406,6 +1532,7 @@ BPlusTree::_InsertKey(bplustree_node* node, uint16 index, uint8* key,
 		memmove(keys + length, keys + length - keyLength, size);
 
 	memcpy(keys + keyStart, key, keyLength);
+	return B_OK;
 }
 
 
@@ -1421,6 +1548,11 @@ BPlusTree::_SplitNode(bplustree_node* node, off_t nodeOffset,
 	if (*_keyIndex > node->NumKeys() + 1)
 		return B_BAD_VALUE;
 
+	if (_UsePrefixKeys(node)) {
+		return _SplitCompressedNode(node, nodeOffset, other, otherOffset,
+			*_keyIndex, key, _keyLength, _value);
+	}
+
 	Unaligned<uint16>* inKeyLengths = node->KeyLengths();
 	Unaligned<off_t>* inKeyValues = node->Values();
 	uint8* inKeys = node->Keys();
@@ -1670,6 +1802,86 @@ BPlusTree::_SplitNode(bplustree_node* node, off_t nodeOffset,
 }
 
 
+/*!	Does the same as _SplitNode() for trees that use prefix compressed
+	keys: the keys of \a node, including the new one, are split where both
+	halves use about the same space, which does not need to be in the middle
+	anymore, as the prefix the keys share may change.
+*/
+status_t
+BPlusTree::_SplitCompressedNode(bplustree_node* node, off_t nodeOffset,
+	bplustree_node* other, off_t otherOffset, uint16 keyIndex, uint8* key,
+	uint16* _keyLength, off_t* _value)
+{
+	KeyList keys;
+	status_t status = keys.Add(node, fNodeSize);
+	if (status == B_OK)
+		status = keys.Insert(keyIndex, key, *_keyLength, *_value);
+	if (status != B_OK)
+		RETURN_ERROR(status);
+
+	// If we split an index node, the key at the split is dropped: it's
+	// moved to the parent node, and its value becomes the overflow link
+	// of the other node.
+	int32 dropped = node->IsLeaf() ? 0 : 1;
+	int32 count = keys.Count();
+
+	// The other node gets the keys before the split; its size grows with
+	// the split, while the one of the node shrinks
+	int32 first = 1;
+	int32 last = count - 1 - dropped;
+	if (last < first)
+		RETURN_ERROR(B_BAD_DATA);
+
+	while (first < last) {
+		int32 split = (first + last) / 2;
+		if (keys.NodeSize(0, split, fPrefixKeys) < keys.NodeSize(
+				split + dropped, count - split - dropped, fPrefixKeys))
+			first = split + 1;
+		else
+			last = split;
+	}
+
+	int32 split = first;
+	int32 otherSize = keys.NodeSize(0, split, fPrefixKeys);
+	int32 nodeSize = keys.NodeSize(split + dropped, count - split - dropped,
+		fPrefixKeys);
+	if (split > 1) {
+		// the split before might be the more even one
+		int32 previousOtherSize = keys.NodeSize(0, split - 1, fPrefixKeys);
+		int32 previousNodeSize = keys.NodeSize(split - 1 + dropped,
+			count - split + 1 - dropped, fPrefixKeys);
+		if (max_c(previousOtherSize, previousNodeSize)
+				< max_c(otherSize, nodeSize)) {
+			split--;
+			otherSize = previousOtherSize;
+			nodeSize = previousNodeSize;
+		}
+	}
+	if (otherSize > fNodeSize || nodeSize > fNodeSize)
+		RETURN_ERROR(B_BAD_DATA);
+
+	other->left_link = node->left_link;
+	other->right_link = HOST_ENDIAN_TO_BFS_INT64(nodeOffset);
+	if (dropped)
+		other->overflow_link = HOST_ENDIAN_TO_BFS_INT64(keys.ValueAt(split));
+	keys.WriteTo(other, 0, split, fPrefixKeys);
+
+	node->left_link = HOST_ENDIAN_TO_BFS_INT64(otherOffset);
+		// right link, and overflow link can stay the same
+	keys.WriteTo(node, split + dropped, count - split - dropped, fPrefixKeys);
+
+	// The key that will be inserted in the parent node is either the
+	// dropped key or the last of the other node
+	uint16 length;
+	const uint8* newKey = keys.KeyAt(dropped ? split : split - 1, &length);
+	memcpy(key, newKey, length);
+	*_keyLength = length;
+	*_value = otherOffset;
+
+	return B_OK;
+}
+
+
 /*!	This inserts a key into the tree. The changes made to the tree will
 	all be part of the \a transaction.
 	You need to have the inode write locked.
@@ -1728,16 +1940,15 @@ BPlusTree::Insert(Transaction& transaction, const uint8* key, uint16 keyLength,
 			return B_IO_ERROR;
 
 		// is the node big enough to hold the pair?
-		if (int32(key_align(sizeof(bplustree_node)
-				+ writableNode->AllKeyLength() + keyLength)
-				+ (writableNode->NumKeys() + 1) * (sizeof(uint16)
-				+ sizeof(off_t))) < fNodeSize) {
-			_InsertKey(writableNode, nodeAndKey.keyIndex,
-				keyBuffer, keyLength, value);
+		status_t status = _InsertKey(writableNode, nodeAndKey.keyIndex,
+			keyBuffer, keyLength, value);
+		if (status == B_OK) {
 			_UpdateIterators(nodeAndKey.nodeOffset, BPLUSTREE_NULL,
 				nodeAndKey.keyIndex, 0, 1);
 
 			return B_OK;
+		} else if (status != B_BUFFER_OVERFLOW) {
+			RETURN_ERROR(status);
 		} else {
 			CachedNode cachedNewRoot(this);
 			CachedNode cachedOther(this);
@@ -1747,8 +1958,7 @@ BPlusTree::Insert(Transaction& transaction, const uint8* key, uint16 keyLength,
 			off_t newRoot = BPLUSTREE_NULL;
 			if (nodeAndKey.nodeOffset == fHeader.RootNode()) {
 				bplustree_node* root;
-				status_t status = cachedNewRoot.Allocate(transaction, &root,
-					&newRoot);
+				status = cachedNewRoot.Allocate(transaction, &root, &newRoot);
 				if (status != B_OK) {
 					// The tree is most likely corrupted!
 					// But it's still sane at leaf level - we could set
@@ -1763,8 +1973,7 @@ BPlusTree::Insert(Transaction& transaction, const uint8* key, uint16 keyLength,
 			// reserve space for the other node
 			bplustree_node* other;
 			off_t otherOffset;
-			status_t status = cachedOther.Allocate(transaction, &other,
-				&otherOffset);
+			status = cachedOther.Allocate(transaction, &other, &otherOffset);
 			if (status != B_OK) {
 				cachedNewRoot.Free(transaction, newRoot);
 				RETURN_ERROR(status);
@@ -1797,8 +2006,11 @@ BPlusTree::Insert(Transaction& transaction, const uint8* key, uint16 keyLength,
 			if (newRoot != BPLUSTREE_NULL) {
 				bplustree_node* root = cachedNewRoot.Node();
 
-				_InsertKey(root, 0, keyBuffer, keyLength,
+				status = _InsertKey(root, 0, keyBuffer, keyLength,
 					writableNode->LeftLink());
+				if (status != B_OK)
+					RETURN_ERROR(status);
+
 				root->overflow_link = HOST_ENDIAN_TO_BFS_INT64(
 					nodeAndKey.nodeOffset);
 
@@ -2030,14 +2242,14 @@ BPlusTree::_RemoveDuplicate(Transaction& transaction,
 	pointer), it's not needed to pass the key & its length, although
 	the calling method (BPlusTree::Remove()) have this data.
 */
-void
+status_t
 BPlusTree::_RemoveKey(bplustree_node* node, uint16 index)
 {
 	// should never happen, but who knows?
 	if (index > node->NumKeys() && node->NumKeys() > 0) {
 		FATAL(("Asked me to remove key outer limits: %u, inode %" B_PRIdOFF
 			"\n", index, fStream->ID()));
-		return;
+		return B_BAD_VALUE;
 	}
 
 	Unaligned<off_t>* values = node->Values();
@@ -2048,6 +2260,20 @@ BPlusTree::_RemoveKey(bplustree_node* node, uint16 index)
 	if (!node->IsLeaf() && index == node->NumKeys())
 		node->overflow_link = values[--index];
 
+	if (_UsePrefixKeys(node)) {
+		KeyList keys;
+		status_t status = keys.Add(node, fNodeSize);
+		if (status != B_OK)
+			return status;
+
+		keys.Remove(index);
+		if (keys.NodeSize(0, keys.Count(), fPrefixKeys) > fNodeSize)
+			RETURN_ERROR(B_BAD_DATA);
+
+		keys.WriteTo(node, 0, keys.Count(), fPrefixKeys);
+		return B_OK;
+	}
+
 	uint16 length = 0;
 	uint8* key = node->KeyAt(index, &length);
 	if (key + length + sizeof(off_t) + sizeof(uint16) > (uint8*)node + fNodeSize
@@ -2055,7 +2281,7 @@ BPlusTree::_RemoveKey(bplustree_node* node, uint16 index)
 		FATAL(("Key length to long: %s, %u inode %" B_PRIdOFF "\n", key, length,
 			fStream->ID()));
 		fStream->GetVolume()->Panic();
-		return;
+		return B_BAD_DATA;
 	}
 
 	Unaligned<uint16>* keyLengths = node->KeyLengths();
@@ -2086,6 +2312,8 @@ BPlusTree::_RemoveKey(bplustree_node* node, uint16 index)
 		memmove(newValues + index, values + index + 1,
 			(node->NumKeys() - index) * sizeof(off_t));
 	}
+
+	return B_OK;
 }
 
 
@@ -2184,8 +2412,12 @@ BPlusTree::Remove(Transaction& transaction, const uint8* key, uint16 keyLength,
 		// the overflow link, so we have to drop the last key)
 		if (writableNode->NumKeys() > 1
 			|| (!writableNode->IsLeaf() && writableNode->NumKeys() == 1)) {
-			_RemoveKey(writableNode, nodeAndKey.keyIndex);
-			return B_OK;
+			status_t status = _RemoveKey(writableNode, nodeAndKey.keyIndex);
+			if (status != B_OK)
+				RETURN_ERROR(status);
+
+			cached.Unset();
+			return _MergeNode(transaction, stack, nodeAndKey.nodeOffset);
 		}
 
 		// when we are here, we can just free the node, but
@@ -2208,6 +2440,158 @@ BPlusTree::Remove(Transaction& transaction, const uint8* key, uint16 keyLength,
 }
 
 
+/*!	Merges the node at \a offset with one of its siblings if it is less
+	than a quarter full, and the keys of both fit into a single node. The
+	left node of the two is freed, and its key removed from the parent node,
+	which is then checked the same way; \a stack must contain the path to
+	the node.
+	If the root node is left with nothing but its overflow link, the tree
+	shrinks by one level.
+*/
+status_t
+BPlusTree::_MergeNode(Transaction& transaction, Stack<node_and_key>& stack,
+	off_t offset)
+{
+	CachedNode cached(this);
+	node_and_key parent;
+
+	while (true) {
+		const bplustree_node* node = cached.SetTo(offset);
+		if (node == NULL)
+			RETURN_ERROR(B_IO_ERROR);
+
+		if (offset == fHeader.RootNode()) {
+			if (node->IsLeaf() || node->NumKeys() > 0)
+				return B_OK;
+
+			// the only child of the root becomes the new root
+			bplustree_node* root = cached.MakeWritable(transaction);
+			if (root == NULL)
+				return B_IO_ERROR;
+
+			CachedNode cachedHeader(this);
+			bplustree_header* header
+				= cachedHeader.SetToWritableHeader(transaction);
+			if (header == NULL)
+				return B_IO_ERROR;
+
+			header->root_node_pointer = root->overflow_link;
+			header->max_number_of_levels = HOST_ENDIAN_TO_BFS_INT32(
+				header->MaxNumberOfLevels() - 1);
+			cachedHeader.Unset();
+
+			return cached.Free(transaction, offset);
+		}
+
+		if (node->Used() >= fNodeSize / 4 || !stack.Pop(&parent))
+			return B_OK;
+
+		CachedNode cachedParent(this);
+		const bplustree_node* parentNode = cachedParent.SetTo(
+			parent.nodeOffset);
+		if (parentNode == NULL)
+			RETURN_ERROR(B_IO_ERROR);
+
+		Unaligned<off_t>* values = parentNode->Values();
+		uint16 numKeys = parentNode->NumKeys();
+		if (parent.keyIndex > numKeys
+			|| (parent.keyIndex < numKeys
+				? BFS_ENDIAN_TO_HOST_INT64(values[parent.keyIndex])
+				: parentNode->OverflowLink()) != offset) {
+			FATAL(("node %" B_PRIdOFF " not found in its parent, inode %"
+				B_PRIdOFF "\n", offset, fStream->ID()));
+			return B_OK;
+		}
+
+		// The node is merged with its left sibling, or its right one if it
+		// doesn't have one
+		uint16 leftIndex = parent.keyIndex > 0 ? parent.keyIndex - 1 : 0;
+		if (leftIndex >= numKeys)
+			return B_OK;
+
+		off_t leftOffset = BFS_ENDIAN_TO_HOST_INT64(values[leftIndex]);
+		off_t rightOffset = leftIndex + 1 < numKeys
+			? BFS_ENDIAN_TO_HOST_INT64(values[leftIndex + 1])
+			: parentNode->OverflowLink();
+
+		CachedNode cachedLeft(this);
+		CachedNode cachedRight(this);
+		const bplustree_node* left = cachedLeft.SetTo(leftOffset);
+		const bplustree_node* right = cachedRight.SetTo(rightOffset);
+		if (left == NULL || right == NULL)
+			RETURN_ERROR(B_IO_ERROR);
+		if (left->IsLeaf() != right->IsLeaf())
+			RETURN_ERROR(B_BAD_DATA);
+
+		KeyList keys;
+		status_t status = keys.Add(left, fNodeSize);
+		if (status == B_OK && !left->IsLeaf()) {
+			// the key in the parent node is the one of the overflow link
+			// of the left node
+			uint8 buffer[BPLUSTREE_MAX_KEY_LENGTH];
+			uint16 length;
+			const uint8* key = parentNode->GetKey(leftIndex, buffer, &length,
+				fNodeSize);
+			if (key == NULL)
+				RETURN_ERROR(B_BAD_DATA);
+
+			status = keys.Add(key, length, left->OverflowLink());
+		}
+		if (status == B_OK)
+			status = keys.Add(right, fNodeSize);
+		if (status != B_OK)
+			RETURN_ERROR(status);
+
+		if (keys.NodeSize(0, keys.Count(), fPrefixKeys) > fNodeSize)
+			return B_OK;
+
+		// the right node takes over all keys
+		off_t leftLink = left->LeftLink();
+		int32 leftCount = left->NumKeys();
+		bool isLeaf = left->IsLeaf();
+
+		bplustree_node* writableRight = cachedRight.MakeWritable(transaction);
+		if (writableRight == NULL)
+			return B_IO_ERROR;
+
+		keys.WriteTo(writableRight, 0, keys.Count(), fPrefixKeys);
+		writableRight->left_link = HOST_ENDIAN_TO_BFS_INT64(leftLink);
+
+		if (isLeaf) {
+			_MoveIterators(rightOffset, rightOffset, leftCount);
+			_MoveIterators(leftOffset, rightOffset, 0);
+		}
+
+		if (cachedLeft.MakeWritable(transaction) == NULL)
+			return B_IO_ERROR;
+
+		status = cachedLeft.Free(transaction, leftOffset);
+		if (status != B_OK)
+			return status;
+
+		if (leftLink != BPLUSTREE_NULL) {
+			bplustree_node* sibling = cachedLeft.SetToWritable(transaction,
+				leftLink);
+			if (sibling == NULL)
+				return B_IO_ERROR;
+
+			sibling->right_link = HOST_ENDIAN_TO_BFS_INT64(rightOffset);
+		}
+
+		bplustree_node* writableParent = cachedParent.MakeWritable(
+			transaction);
+		if (writableParent == NULL)
+			return B_IO_ERROR;
+
+		status = _RemoveKey(writableParent, leftIndex);
+		if (status != B_OK)
+			return status;
+
+		offset = parent.nodeOffset;
+	}
+}
+
+
 /*!	Replaces the value for the key in the tree.
 	Returns B_OK if the key could be found and its value replaced,
 	B_ENTRY_NOT_FOUND if the key couldn't be found, and other errors
@@ -2362,8 +2746,10 @@ BPlusTree::_ValidateChildren(TreeCheck& check, uint32 level, off_t offset,
 	CachedNode cached(this);
 
 	for (uint32 i = 0; i < count; i++) {
-		uint16 keyLength;
-		uint8* key = parent->KeyAt(i, &keyLength);
+		uint8 buffer[BPLUSTREE_MAX_KEY_LENGTH];
+		uint16 keyLength = 0;
+		const uint8* key = parent->GetKey(i, buffer, &keyLength, fNodeSize);
+			// CheckIntegrity() made sure that all keys are valid
 		if (largestKey != NULL) {
 			int result = _CompareKeys(key, keyLength, largestKey,
 				largestKeyLength);
@@ -2713,6 +3099,13 @@ TreeIterator::Traverse(int8 direction, void* key, uint16* keyLength,
 
 		// are there any more nodes?
 		if (fCurrentNodeOffset != BPLUSTREE_NULL) {
+#if !_BOOT_MODE
+			if (forward) {
+				// Leaf nodes are usually allocated in ascending order, so
+				// the next ones are likely to follow this one
+				cached.Prefetch(fCurrentNodeOffset, kPrefetchNodes);
+			}
+#endif
 			node = cached.SetTo(fCurrentNodeOffset);
 			if (!node)
 				RETURN_ERROR(B_ERROR);
@@ -2731,11 +3124,11 @@ TreeIterator::Traverse(int8 direction, void* key, uint16* keyLength,
 	if (node->all_key_count == 0)
 		RETURN_ERROR(B_ERROR);	// B_ENTRY_NOT_FOUND ?
 
+	uint8 buffer[BPLUSTREE_MAX_KEY_LENGTH];
 	uint16 length = 0;
-	uint8* keyStart = node->KeyAt(fCurrentKey, &length);
-	if (keyStart + length + sizeof(off_t) + sizeof(uint16)
-			> (uint8*)node + fTree->fNodeSize
-		|| length > BPLUSTREE_MAX_KEY_LENGTH) {
+	const uint8* keyStart = node->GetKey(fCurrentKey, buffer, &length,
+		fTree->fNodeSize);
+	if (keyStart == NULL) {
 #if !_BOOT_MODE
 		fTree->fStream->GetVolume()->Panic();
 #endif
@@ -2876,6 +3269,21 @@ TreeIterator::Update(off_t offset, off_t nextOffset, uint16 keyIndex,
 }
 
 
+/*!	Moves the iterator from the node at \a offset to the one at
+	\a nextOffset, where the keys it pointed to are now found \a shift
+	positions later.
+*/
+void
+TreeIterator::Move(off_t offset, off_t nextOffset, int32 shift)
+{
+	if (offset != fCurrentNodeOffset)
+		return;
+
+	fCurrentNodeOffset = nextOffset;
+	fCurrentKey += shift;
+}
+
+
 void
 TreeIterator::Stop()
 {
@@ -2927,6 +3335,10 @@ bplustree_node::Initialize()
 }
 
 
+/*!	Returns the key at \a index as it is stored in the node; if the node
+	has prefix compressed keys, this is only the part after the prefix.
+	Use GetKey() to retrieve the complete key.
+*/
 uint8*
 bplustree_node::KeyAt(int32 index, uint16* keyLength) const
 {
@@ -2936,12 +3348,45 @@ bplustree_node::KeyAt(int32 index, uint16* keyLength) const
 	uint8* keyStart = Keys();
 	Unaligned<uint16>* keyLengths = KeyLengths();
 
-	*keyLength = BFS_ENDIAN_TO_HOST_INT16(keyLengths[index])
-		- (index != 0 ? BFS_ENDIAN_TO_HOST_INT16(keyLengths[index - 1]) : 0);
+	uint16 start = HasPrefixKeys() ? 1 + PrefixLength() : 0;
 	if (index > 0)
-		keyStart += BFS_ENDIAN_TO_HOST_INT16(keyLengths[index - 1]);
+		start = BFS_ENDIAN_TO_HOST_INT16(keyLengths[index - 1]);
 
-	return keyStart;
+	*keyLength = BFS_ENDIAN_TO_HOST_INT16(keyLengths[index]) - start;
+	return keyStart + start;
+}
+
+
+/*!	Returns the complete key at \a index, or \c NULL if it is corrupted.
+	If the node has prefix compressed keys, the key is assembled in
+	\a buffer, which must be able to hold BPLUSTREE_MAX_KEY_LENGTH bytes;
+	otherwise, the key is returned directly from the node.
+*/
+const uint8*
+bplustree_node::GetKey(int32 index, uint8* buffer, uint16* _keyLength,
+	uint32 nodeSize) const
+{
+	uint16 length = 0;
+	uint8* key = KeyAt(index, &length);
+	if (key == NULL
+		|| key + length + sizeof(off_t) + sizeof(uint16)
+			> (uint8*)this + nodeSize
+		|| length > BPLUSTREE_MAX_KEY_LENGTH)
+		return NULL;
+
+	if (!HasPrefixKeys()) {
+		*_keyLength = length;
+		return key;
+	}
+
+	uint16 prefixLength = PrefixLength();
+	if (prefixLength + length > BPLUSTREE_MAX_KEY_LENGTH)
+		return NULL;
+
+	memcpy(buffer, Keys() + 1, prefixLength);
+	memcpy(buffer + prefixLength, key, length);
+	*_keyLength = prefixLength + length;
+	return buffer;
 }
 
 
@@ -2998,11 +3443,9 @@ bplustree_node::CheckIntegrity(uint32 nodeSize) const
 		DEBUGGER(("invalid node: key/length count"));
 
 	for (int32 i = 0; i < NumKeys(); i++) {
+		uint8 buffer[BPLUSTREE_MAX_KEY_LENGTH];
 		uint16 length = 0;
-		uint8* key = KeyAt(i, &length);
-		if (key + length + sizeof(off_t) + sizeof(uint16)
-				> (uint8*)this + nodeSize
-			|| length > BPLUSTREE_MAX_KEY_LENGTH) {
+		if (GetKey(i, buffer, &length, nodeSize) == NULL) {
 			dprintf("invalid node %p, key %d: keys corrupted\n", this, (int)i);
 			return B_BAD_DATA;
 		}
@@ -3067,6 +3510,243 @@ BitmapArray::Set(size_t index, bool set)
 		fCountSet--;
 	}
 }
+
+
+// #pragma mark -
+
+
+KeyList::KeyList()
+	:
+	fKeys(NULL),
+	fKeyEnds(NULL),
+	fValues(NULL),
+	fCount(0),
+	fMaxCount(0),
+	fMaxLength(0)
+{
+}
+
+
+KeyList::~KeyList()
+{
+	free(fKeys);
+	free(fKeyEnds);
+	free(fValues);
+}
+
+
+/*!	Adds all keys of \a node to the end of the list. */
+status_t
+KeyList::Add(const bplustree_node* node, uint32 nodeSize)
+{
+	Unaligned<off_t>* values = node->Values();
+
+	for (int32 i = 0; i < node->NumKeys(); i++) {
+		uint8 buffer[BPLUSTREE_MAX_KEY_LENGTH];
+		uint16 length;
+		const uint8* key = node->GetKey(i, buffer, &length, nodeSize);
+		if (key == NULL)
+			RETURN_ERROR(B_BAD_DATA);
+
+		status_t status = Add(key, length, BFS_ENDIAN_TO_HOST_INT64(values[i]));
+		if (status != B_OK)
+			return status;
+	}
+
+	return B_OK;
+}
+
+
+status_t
+KeyList::Add(const uint8* key, uint16 keyLength, off_t value)
+{
+	return Insert(fCount, key, keyLength, value);
+}
+
+
+status_t
+KeyList::Insert(int32 index, const uint8* key, uint16 keyLength, off_t value)
+{
+	if (index < 0 || index > fCount)
+		return B_BAD_VALUE;
+
+	status_t status = _Grow(keyLength);
+	if (status != B_OK)
+		return status;
+
+	uint32 start = _KeyStart(index);
+	memmove(fKeys + start + keyLength, fKeys + start,
+		_KeyStart(fCount) - start);
+	memcpy(fKeys + start, key, keyLength);
+
+	for (int32 i = fCount; i > index; i--) {
+		fKeyEnds[i] = fKeyEnds[i - 1] + keyLength;
+		fValues[i] = fValues[i - 1];
+	}
+	fKeyEnds[index] = start + keyLength;
+	fValues[index] = value;
+
+	fCount++;
+	return B_OK;
+}
+
+
+void
+KeyList::Remove(int32 index)
+{
+	if (index < 0 || index >= fCount)
+		return;
+
+	uint32 end = fKeyEnds[index];
+	uint32 length = end - _KeyStart(index);
+	memmove(fKeys + end - length, fKeys + end, _KeyStart(fCount) - end);
+
+	for (int32 i = index; i < fCount - 1; i++) {
+		fKeyEnds[i] = fKeyEnds[i + 1] - length;
+		fValues[i] = fValues[i + 1];
+	}
+
+	fCount--;
+}
+
+
+const uint8*
+KeyList::KeyAt(int32 index, uint16* _keyLength) const
+{
+	uint32 start = _KeyStart(index);
+	*_keyLength = fKeyEnds[index] - start;
+	return fKeys + start;
+}
+
+
+/*!	Returns the number of bytes a node would use to store the \a count keys
+	starting at \a first.
+*/
+int32
+KeyList::NodeSize(int32 first, int32 count, bool prefixKeys) const
+{
+	uint16 prefixLength = _PrefixLength(first, count, prefixKeys);
+	int32 length = _KeyStart(first + count) - _KeyStart(first);
+	if (prefixLength > 0)
+		length += 1 + prefixLength - count * prefixLength;
+
+	return key_align(sizeof(bplustree_node) + length)
+		+ count * (sizeof(uint16) + sizeof(off_t));
+}
+
+
+/*!	Replaces the keys of \a node with the \a count keys starting at
+	\a first. The links of the node are left alone. The caller must have
+	made sure that the keys fit into the node.
+*/
+void
+KeyList::WriteTo(bplustree_node* node, int32 first, int32 count,
+	bool prefixKeys) const
+{
+	uint16 prefixLength = _PrefixLength(first, count, prefixKeys);
+	uint32 length = _KeyStart(first + count) - _KeyStart(first);
+	uint32 keyStart = 0;
+	if (prefixLength > 0) {
+		keyStart = 1 + prefixLength;
+		length += keyStart - count * prefixLength;
+	}
+
+	node->all_key_count = HOST_ENDIAN_TO_BFS_INT16(count);
+	node->all_key_length = HOST_ENDIAN_TO_BFS_INT16(length
+		| (prefixLength > 0 ? BPLUSTREE_PREFIX_KEYS : 0));
+
+	uint8* keys = node->Keys();
+	Unaligned<uint16>* keyLengths = node->KeyLengths();
+	Unaligned<off_t>* values = node->Values();
+
+	if (prefixLength > 0) {
+		uint16 firstLength;
+		keys[0] = prefixLength;
+		memcpy(keys + 1, KeyAt(first, &firstLength), prefixLength);
+	}
+
+	for (int32 i = 0; i < count; i++) {
+		uint16 keyLength;
+		const uint8* key = KeyAt(first + i, &keyLength);
+
+		memcpy(keys + keyStart, key + prefixLength,
+			keyLength - prefixLength);
+		keyStart += keyLength - prefixLength;
+
+		keyLengths[i] = HOST_ENDIAN_TO_BFS_INT16(keyStart);
+		values[i] = HOST_ENDIAN_TO_BFS_INT64(fValues[first + i]);
+	}
+}
+
+
+status_t
+KeyList::_Grow(uint16 keyLength)
+{
+	uint32 length = _KeyStart(fCount) + keyLength;
+	if (length > fMaxLength) {
+		uint32 maxLength = max_c(fMaxLength * 2, max_c(length, 1024));
+		uint8* keys = (uint8*)realloc(fKeys, maxLength);
+		if (keys == NULL)
+			return B_NO_MEMORY;
+
+		fKeys = keys;
+		fMaxLength = maxLength;
+	}
+
+	if (fCount == fMaxCount) {
+		int32 maxCount = max_c(fMaxCount * 2, 64);
+		uint32* keyEnds = (uint32*)realloc(fKeyEnds,
+			maxCount * sizeof(uint32));
+		if (keyEnds == NULL)
+			return B_NO_MEMORY;
+		fKeyEnds = keyEnds;
+
+		off_t* values = (off_t*)realloc(fValues, maxCount * sizeof(off_t));
+		if (values == NULL)
+			return B_NO_MEMORY;
+		fValues = values;
+
+		fMaxCount = maxCount;
+	}
+
+	return B_OK;
+}
+
+
+/*!	Returns the length of the prefix the \a count keys starting at \a first
+	share, if it is worth storing them prefix compressed.
+*/
+uint16
+KeyList::_PrefixLength(int32 first, int32 count, bool prefixKeys) const
+{
+	if (!prefixKeys || count < 2)
+		return 0;
+
+	uint16 firstLength;
+	const uint8* firstKey = KeyAt(first, &firstLength);
+
+	// the length of the prefix is stored in a single byte
+	uint16 prefixLength = min_c(firstLength, 255);
+
+	for (int32 i = first + 1; i < first + count && prefixLength > 0; i++) {
+		uint16 length;
+		const uint8* key = KeyAt(i, &length);
+		if (length < prefixLength)
+			prefixLength = length;
+
+		uint16 shared = 0;
+		while (shared < prefixLength && key[shared] == firstKey[shared])
+			shared++;
+
+		prefixLength = shared;
+	}
+
+	// the prefix has to make up for its length byte
+	if ((count - 1) * prefixLength <= 1)
+		return 0;
+
+	return prefixLength;
+}
 #endif // !_BOOT_MODE
 
 
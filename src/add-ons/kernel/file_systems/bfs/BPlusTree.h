@@ -86,6 +86,14 @@ struct  __attribute__((packed)) Unaligned {
 };
 
 
+// If this flag is set in the all_key_length field of a node, the prefix
+// that all of its keys share is only stored once: the key area starts with
+// the length of the prefix (one byte) and the prefix itself, followed by
+// the rest of each key. The key lengths array still contains the end of
+// each key in the key area. Only used on volumes with the
+// SUPER_BLOCK_FEATURE_PREFIX_KEYS feature.
+#define BPLUSTREE_PREFIX_KEYS		0x8000
+
 struct bplustree_node {
 			int64				left_link;
 			int64				right_link;
@@ -107,13 +115,19 @@ struct bplustree_node {
 										all_key_count); }
 			uint16				AllKeyLength() const
 									{ return BFS_ENDIAN_TO_HOST_INT16(
-										all_key_length); }
+										all_key_length)
+										& ~BPLUSTREE_PREFIX_KEYS; }
 
 	inline	Unaligned<uint16>*	KeyLengths() const;
 	inline	Unaligned<off_t>*   Values() const;
 	inline	uint8*				Keys() const;
 	inline	int32				Used() const;
 			uint8*				KeyAt(int32 index, uint16* keyLength) const;
+			const uint8*		GetKey(int32 index, uint8* buffer,
+									uint16* _keyLength, uint32 nodeSize) const;
+
+	inline	bool				HasPrefixKeys() const;
+	inline	uint16				PrefixLength() const;
 
 	inline	bool				IsLeaf() const;
 
@@ -228,6 +242,8 @@ public:
 			status_t			Free(Transaction& transaction, off_t offset);
 			status_t			Allocate(Transaction& transaction,
 									bplustree_node** _node, off_t* _offset);
+
+			void				Prefetch(off_t offset, int32 count);
 #endif // !_BOOT_MODE
 
 			bool				IsWritable() const { return fWritable; }
@@ -339,23 +355,36 @@ private:
 									CachedNode& cached,
 									const bplustree_node* node, uint16 index,
 									off_t value);
-			void				_InsertKey(bplustree_node* node, uint16 index,
+			bool				_UsePrefixKeys(
+									const bplustree_node* node) const
+									{ return fPrefixKeys
+										|| node->HasPrefixKeys(); }
+			status_t			_InsertKey(bplustree_node* node, uint16 index,
 									uint8* key, uint16 keyLength, off_t value);
 			status_t			_SplitNode(bplustree_node* node,
 									off_t nodeOffset, bplustree_node* other,
 									off_t otherOffset, uint16* _keyIndex,
 									uint8* key, uint16* _keyLength,
 									off_t* _value);
+			status_t			_SplitCompressedNode(bplustree_node* node,
+									off_t nodeOffset, bplustree_node* other,
+									off_t otherOffset, uint16 keyIndex,
+									uint8* key, uint16* _keyLength,
+									off_t* _value);
 
 			status_t			_RemoveDuplicate(Transaction& transaction,
 									const bplustree_node* node,
 									CachedNode& cached, uint16 keyIndex,
 									off_t value);
-			void				_RemoveKey(bplustree_node* node, uint16 index);
+			status_t			_RemoveKey(bplustree_node* node, uint16 index);
+			status_t			_MergeNode(Transaction& transaction,
+									Stack<node_and_key>& stack, off_t offset);
 
 			void				_UpdateIterators(off_t offset, off_t nextOffset,
 									uint16 keyIndex, uint16 splitAt,
 									int8 change);
+			void				_MoveIterators(off_t offset, off_t nextOffset,
+									int32 shift);
 			void				_AddIterator(TreeIterator* iterator);
 			void				_RemoveIterator(TreeIterator* iterator);
 
@@ -379,6 +408,7 @@ private:
 			bplustree_header	fHeader;
 			int32				fNodeSize;
 			bool				fAllowDuplicates;
+			bool				fPrefixKeys;
 			bool				fInTransaction;
 			status_t			fStatus;
 
@@ -425,6 +455,8 @@ private:
 			void				Update(off_t offset, off_t nextOffset,
 									uint16 keyIndex, uint16 splitAt,
 									int8 change);
+			void				Move(off_t offset, off_t nextOffset,
+									int32 shift);
 			void				Stop();
 
 private:
@@ -555,6 +587,8 @@ bplustree_header::CheckNode(const bplustree_node* node) const
 	return IsValidLink(node->LeftLink())
 		&& IsValidLink(node->RightLink())
 		&& IsValidLink(node->OverflowLink())
+		&& (!node->HasPrefixKeys()
+			|| node->PrefixLength() < node->AllKeyLength())
 		&& (int8*)node->Values() + node->NumKeys() * sizeof(off_t)
 				<= (int8*)node + NodeSize();
 }
@@ -609,6 +643,24 @@ bplustree_node::IsLeaf() const
 }
 
 
+inline bool
+bplustree_node::HasPrefixKeys() const
+{
+	return (BFS_ENDIAN_TO_HOST_INT16(all_key_length)
+		& BPLUSTREE_PREFIX_KEYS) != 0;
+}
+
+
+/*!	Returns the length of the prefix that all keys of the node share, not
+	including its length byte.
+*/
+inline uint16
+bplustree_node::PrefixLength() const
+{
+	return HasPrefixKeys() ? Keys()[0] : 0;
+}
+
+
 inline duplicate_array*
 bplustree_node::FragmentAt(int8 index) const
 {
@@ -0,0 +1,1321 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * This file may be used under the terms of the MIT License.
+ */
+
+
+//! Building B+trees bottom-up from sorted entries
+
+
+#include "BPlusTreeLoader.h"
+
+#include <file_systems/QueryParserUtils.h>
+
+#include "Debug.h"
+#include "Utility.h"
+
+
+static const size_t kWriteBufferSize = 64 * 1024;
+
+
+/*!	The entries are stored like this in the runs of a KeySorter, aligned
+	to an off_t boundary. The offsets of the entries are stored from the end
+	of the run downwards.
+	In the storage, the entries of each run follow each other in sorted
+	order, starting at a chunk of their own.
+*/
+struct sort_entry {
+	off_t		value;
+	uint16		length;
+	uint8		key[0];
+};
+
+static const uint32 kMaxEntrySize = (offsetof(sort_entry, key)
+	+ BPLUSTREE_MAX_KEY_LENGTH + 7) & ~7;
+
+
+struct KeySorter::sort_run {
+	uint8*		data;
+	uint32		used;
+	uint32		count;
+	uint32		position;
+
+	// A run in the storage is read through the buffer in data that holds a
+	// chunk, and the start of an entry that didn't fit into the one before.
+	off_t		offset;
+	off_t		size;
+	off_t		read;
+	uint32		current;
+		// the offset of the current entry in data
+
+	bool IsStored() const
+		{ return offset >= 0; }
+	uint32* Offsets(size_t runSize) const
+		{ return (uint32*)(data + runSize) - count; }
+	const sort_entry* EntryAt(size_t runSize, uint32 index) const
+		{ return (const sort_entry*)(data + Offsets(runSize)[index]); }
+	const sort_entry* Current(size_t runSize) const
+	{
+		if (IsStored())
+			return (const sort_entry*)(data + current);
+		return EntryAt(runSize, position);
+	}
+};
+
+
+static inline uint32
+entry_size(uint16 keyLength)
+{
+	return key_align(offsetof(sort_entry, key) + keyLength);
+}
+
+
+static int
+compare_entries(type_code type, const sort_entry* first,
+	const sort_entry* second)
+{
+	int compare = QueryParser::compareKeys(type, first->key, first->length,
+		second->key, second->length);
+	if (compare != 0)
+		return compare;
+
+	if (first->value < second->value)
+		return -1;
+	return first->value > second->value ? 1 : 0;
+}
+
+
+//	#pragma mark -
+
+
+BPlusTreeSource::~BPlusTreeSource()
+{
+}
+
+
+//	#pragma mark -
+
+
+KeySorter::KeySorter(type_code type, size_t maxMemory, size_t runSize)
+	:
+	fType(type),
+	fMaxMemory(maxMemory),
+	fRunSize(key_align(runSize)),
+	fChunkSize(min_c((fRunSize / 4) & ~(size_t)1023, (size_t)kMaxChunkSize)),
+	fRuns(NULL),
+	fRunCount(0),
+	fRunsAllocated(0),
+	fSortedRuns(0),
+	fStoredRuns(0),
+	fStorageSize(0),
+	fChunk(NULL),
+	fScratch(NULL),
+	fHeap(NULL),
+	fHeapCount(0),
+	fEntries(0),
+	fStatus(B_OK)
+{
+	if (fRunSize < 4096 || fRunSize > 0x7fffffff)
+		fStatus = B_BAD_VALUE;
+}
+
+
+KeySorter::~KeySorter()
+{
+	for (int32 i = 0; i < fRunCount; i++)
+		free(fRuns[i].data);
+
+	free(fRuns);
+	free(fChunk);
+	free(fScratch);
+	free(fHeap);
+}
+
+
+status_t
+KeySorter::Add(const uint8* key, uint16 keyLength, off_t value)
+{
+	if (fStatus != B_OK)
+		return fStatus;
+	if (keyLength < BPLUSTREE_MIN_KEY_LENGTH
+		|| keyLength > BPLUSTREE_MAX_KEY_LENGTH)
+		return B_BAD_VALUE;
+
+	uint32 size = entry_size(keyLength);
+
+	sort_run* run = fRunCount > fStoredRuns ? &fRuns[fRunCount - 1] : NULL;
+	if (run == NULL
+		|| run->used + size + (run->count + 1) * sizeof(uint32) > fRunSize) {
+		status_t status = _AddRun();
+		if (status != B_OK)
+			return status;
+
+		run = &fRuns[fRunCount - 1];
+	}
+
+	sort_entry* entry = (sort_entry*)(run->data + run->used);
+	entry->value = value;
+	entry->length = keyLength;
+	memcpy(entry->key, key, keyLength);
+
+	run->count++;
+	run->Offsets(fRunSize)[0] = run->used;
+	run->used += size;
+	fEntries++;
+
+	return B_OK;
+}
+
+
+status_t
+KeySorter::Rewind()
+{
+	if (fStatus != B_OK)
+		return fStatus;
+
+	while (fSortedRuns < fRunCount)
+		_SortRun(fRuns[fSortedRuns++]);
+
+	if (fStoredRuns > 0) {
+		// all runs are merged from the storage, then
+		status_t status = _StoreRuns();
+		if (status != B_OK)
+			return status;
+
+		for (int32 i = 0; i < fRunCount; i++) {
+			if (fRuns[i].data != NULL)
+				continue;
+
+			fRuns[i].data = (uint8*)malloc(fChunkSize + kMaxEntrySize);
+			if (fRuns[i].data == NULL)
+				return B_NO_MEMORY;
+		}
+	}
+
+	free(fHeap);
+	fHeap = (int32*)malloc((fRunCount + 1) * sizeof(int32));
+	if (fHeap == NULL)
+		return B_NO_MEMORY;
+
+	fHeapCount = 0;
+	for (int32 i = 0; i < fRunCount; i++) {
+		sort_run& run = fRuns[i];
+		run.position = 0;
+		if (run.count == 0)
+			continue;
+
+		if (run.IsStored()) {
+			run.used = 0;
+			run.read = 0;
+			run.current = 0;
+
+			status_t status = _ReadChunk(run);
+			if (status != B_OK)
+				return status;
+		}
+
+		fHeap[fHeapCount++] = i;
+	}
+
+	for (int32 i = fHeapCount / 2; i-- > 0;)
+		_SiftDown(i);
+
+	return B_OK;
+}
+
+
+status_t
+KeySorter::GetNext(const uint8** _key, uint16* _keyLength, off_t* _value)
+{
+	if (fHeap == NULL)
+		return B_NO_INIT;
+	if (fHeapCount == 0)
+		return B_ENTRY_NOT_FOUND;
+
+	sort_run& run = fRuns[fHeap[0]];
+	const sort_entry* entry = run.Current(fRunSize);
+
+	*_key = entry->key;
+	*_keyLength = entry->length;
+	*_value = entry->value;
+	run.position++;
+
+	if (run.IsStored()) {
+		// the buffer of the run is overwritten when the next chunk is read
+		memcpy(fKey, entry->key, entry->length);
+		*_key = fKey;
+
+		run.current += entry_size(entry->length);
+		if (run.position < run.count) {
+			status_t status = _ReadChunk(run);
+			if (status != B_OK) {
+				fHeapCount = 0;
+				return status;
+			}
+		}
+	}
+
+	if (run.position == run.count)
+		fHeap[0] = fHeap[--fHeapCount];
+	_SiftDown(0);
+
+	return B_OK;
+}
+
+
+status_t
+KeySorter::WriteStorage(off_t offset, const uint8* buffer, size_t size)
+{
+	return B_NOT_SUPPORTED;
+}
+
+
+status_t
+KeySorter::ReadStorage(off_t offset, uint8* buffer, size_t size)
+{
+	return B_NOT_SUPPORTED;
+}
+
+
+/*!	Sorts the last run, and starts a new one. If that would need too much
+	memory, the runs are moved to the storage first.
+*/
+status_t
+KeySorter::_AddRun()
+{
+	// the scratch space for sorting is large enough for the entries of a
+	// run with only the shortest keys
+	size_t scratchSize = fRunSize / 4;
+	if ((fRunCount - fStoredRuns + 1) * (off_t)fRunSize + scratchSize
+			> (off_t)fMaxMemory) {
+		status_t status = B_NO_MEMORY;
+		if (fRunCount > fStoredRuns)
+			status = _StoreRuns();
+		if (status != B_OK)
+			return status == B_NOT_SUPPORTED ? B_NO_MEMORY : status;
+		if ((off_t)fRunSize + scratchSize > (off_t)fMaxMemory)
+			return B_NO_MEMORY;
+	}
+
+	// all runs need a chunk in memory to be merged from the storage
+	if (fStoredRuns > 0 && (fRunCount + 1) * (off_t)(fChunkSize
+			+ kMaxEntrySize) > (off_t)fMaxMemory)
+		return B_NO_MEMORY;
+
+	if (fScratch == NULL) {
+		fScratch = (uint32*)malloc(scratchSize);
+		if (fScratch == NULL)
+			return B_NO_MEMORY;
+	}
+
+	if (fRunCount == fRunsAllocated) {
+		int32 count = max_c(fRunsAllocated * 2, 16);
+		sort_run* runs = (sort_run*)realloc(fRuns, count * sizeof(sort_run));
+		if (runs == NULL)
+			return B_NO_MEMORY;
+
+		fRuns = runs;
+		fRunsAllocated = count;
+	}
+
+	sort_run& run = fRuns[fRunCount];
+	run.data = (uint8*)malloc(fRunSize);
+	if (run.data == NULL)
+		return B_NO_MEMORY;
+
+	run.used = 0;
+	run.count = 0;
+	run.position = 0;
+	run.offset = -1;
+	run.size = 0;
+
+	while (fSortedRuns < fRunCount)
+		_SortRun(fRuns[fSortedRuns++]);
+
+	fRunCount++;
+	return B_OK;
+}
+
+
+/*!	Writes the entries of all runs that are still in memory to the storage
+	in sorted order, and frees their memory.
+*/
+status_t
+KeySorter::_StoreRuns()
+{
+	if (fChunk == NULL) {
+		fChunk = (uint8*)malloc(fChunkSize);
+		if (fChunk == NULL)
+			return B_NO_MEMORY;
+	}
+
+	while (fSortedRuns < fRunCount)
+		_SortRun(fRuns[fSortedRuns++]);
+
+	for (; fStoredRuns < fRunCount; fStoredRuns++) {
+		sort_run& run = fRuns[fStoredRuns];
+		off_t offset = fStorageSize;
+		size_t used = 0;
+
+		for (uint32 i = 0; i < run.count; i++) {
+			const uint8* entry = (const uint8*)run.EntryAt(fRunSize, i);
+			size_t size = entry_size(((const sort_entry*)entry)->length);
+
+			// the entries continue in the next chunk
+			while (size > 0) {
+				size_t length = min_c(size, fChunkSize - used);
+				memcpy(fChunk + used, entry, length);
+				entry += length;
+				size -= length;
+				used += length;
+
+				if (used == fChunkSize) {
+					status_t status = _FlushChunk(used);
+					if (status != B_OK)
+						return status;
+					used = 0;
+				}
+			}
+		}
+
+		if (used > 0) {
+			status_t status = _FlushChunk(used);
+			if (status != B_OK)
+				return status;
+		}
+
+		free(run.data);
+		run.data = NULL;
+		run.offset = offset;
+		run.size = run.used;
+		run.used = 0;
+	}
+
+	return B_OK;
+}
+
+
+//!	Writes the next chunk of the storage, and clears its unused rest.
+status_t
+KeySorter::_FlushChunk(size_t used)
+{
+	memset(fChunk + used, 0, fChunkSize - used);
+
+	status_t status = WriteStorage(fStorageSize, fChunk, fChunkSize);
+	if (status != B_OK)
+		return status;
+
+	fStorageSize += fChunkSize;
+	return B_OK;
+}
+
+
+/*!	Makes sure that the current entry of a run in the storage is completely
+	in its buffer, and reads the next chunk of the run if it is not.
+*/
+status_t
+KeySorter::_ReadChunk(sort_run& run)
+{
+	uint32 left = run.used - run.current;
+	if (left >= offsetof(sort_entry, key)) {
+		const sort_entry* entry = (const sort_entry*)(run.data + run.current);
+		if (entry->length > BPLUSTREE_MAX_KEY_LENGTH)
+			return B_BAD_DATA;
+		if (left >= entry_size(entry->length))
+			return B_OK;
+	}
+	if (run.read >= run.size)
+		return B_BAD_DATA;
+
+	memmove(run.data, run.data + run.current, left);
+
+	status_t status = ReadStorage(run.offset + run.read, run.data + left,
+		fChunkSize);
+	if (status != B_OK)
+		return status;
+
+	run.used = left + min_c(run.size - run.read, (off_t)fChunkSize);
+	run.current = 0;
+	run.read += fChunkSize;
+	return B_OK;
+}
+
+
+//!	Sorts the offsets of the entries of the run with a bottom-up merge sort.
+void
+KeySorter::_SortRun(sort_run& run)
+{
+	uint32* offsets = run.Offsets(fRunSize);
+	uint32* from = offsets;
+	uint32* to = fScratch;
+	uint32 count = run.count;
+
+	for (uint32 width = 1; width < count; width *= 2) {
+		for (uint32 left = 0; left < count; left += 2 * width) {
+			uint32 middle = min_c(left + width, count);
+			uint32 right = min_c(left + 2 * width, count);
+			uint32 first = left;
+			uint32 second = middle;
+			uint32 index = left;
+
+			while (first < middle && second < right) {
+				if (_Compare(run, from[second], from[first]) < 0)
+					to[index++] = from[second++];
+				else
+					to[index++] = from[first++];
+			}
+			while (first < middle)
+				to[index++] = from[first++];
+			while (second < right)
+				to[index++] = from[second++];
+		}
+
+		uint32* swap = from;
+		from = to;
+		to = swap;
+	}
+
+	if (from != offsets)
+		memcpy(offsets, from, count * sizeof(uint32));
+}
+
+
+int
+KeySorter::_Compare(const sort_run& run, uint32 first, uint32 second) const
+{
+	return compare_entries(fType, (const sort_entry*)(run.data + first),
+		(const sort_entry*)(run.data + second));
+}
+
+
+//!	Compares the current entries of two runs.
+int
+KeySorter::_CompareRuns(int32 first, int32 second) const
+{
+	const sort_run& firstRun = fRuns[first];
+	const sort_run& secondRun = fRuns[second];
+
+	return compare_entries(fType, firstRun.Current(fRunSize),
+		secondRun.Current(fRunSize));
+}
+
+
+void
+KeySorter::_SiftDown(int32 index)
+{
+	while (true) {
+		int32 smallest = index;
+		int32 left = 2 * index + 1;
+		int32 right = left + 1;
+
+		if (left < fHeapCount && _CompareRuns(fHeap[left], fHeap[smallest]) < 0)
+			smallest = left;
+		if (right < fHeapCount
+			&& _CompareRuns(fHeap[right], fHeap[smallest]) < 0)
+			smallest = right;
+		if (smallest == index)
+			return;
+
+		int32 swap = fHeap[index];
+		fHeap[index] = fHeap[smallest];
+		fHeap[smallest] = swap;
+		index = smallest;
+	}
+}
+
+
+//	#pragma mark -
+
+
+/*!	Collects whole nodes, and writes them in chunks to consecutive offsets
+	of the tree.
+*/
+class BPlusTreeLoader::NodeWriter {
+public:
+	NodeWriter(BPlusTreeLoader& loader, off_t offset, uint32 nodeSize,
+			uint32 blockSize)
+		:
+		fLoader(loader),
+		fOffset(offset),
+		fNodeSize(nodeSize),
+		fSize(round_up(kWriteBufferSize, blockSize)),
+		fUsed(0),
+		fStatus(B_OK)
+	{
+		fBuffer = (uint8*)malloc(fSize);
+		if (fBuffer == NULL)
+			fStatus = B_NO_MEMORY;
+	}
+
+	~NodeWriter()
+	{
+		free(fBuffer);
+	}
+
+	status_t Status() const { return fStatus; }
+	off_t NextOffset() const { return fOffset + fUsed; }
+
+	bplustree_node* Next()
+	{
+		if (fUsed == fSize && Flush() != B_OK)
+			return NULL;
+		if (fStatus != B_OK)
+			return NULL;
+
+		bplustree_node* node = (bplustree_node*)(fBuffer + fUsed);
+		fUsed += fNodeSize;
+		return node;
+	}
+
+	status_t Flush()
+	{
+		if (fStatus == B_OK && fUsed > 0) {
+			fStatus = fLoader.WriteNodes(fOffset, fBuffer, fUsed);
+			fOffset += fUsed;
+			fUsed = 0;
+		}
+		return fStatus;
+	}
+
+private:
+	BPlusTreeLoader&	fLoader;
+	off_t				fOffset;
+	uint32				fNodeSize;
+	size_t				fSize;
+	size_t				fUsed;
+	uint8*				fBuffer;
+	status_t			fStatus;
+};
+
+
+/*!	A list of keys that can only grow. */
+class BPlusTreeLoader::KeyList {
+public:
+	KeyList()
+		:
+		fData(NULL),
+		fSize(0),
+		fAllocated(0),
+		fOffsets(NULL),
+		fCount(0),
+		fMaxCount(0)
+	{
+	}
+
+	~KeyList()
+	{
+		free(fData);
+		free(fOffsets);
+	}
+
+	off_t Count() const { return fCount; }
+
+	status_t Add(const uint8* key, uint16 length)
+	{
+		if (fSize + sizeof(uint16) + length > fAllocated) {
+			size_t size = max_c(fAllocated * 2, 16384);
+			uint8* data = (uint8*)realloc(fData, size);
+			if (data == NULL)
+				return B_NO_MEMORY;
+
+			fData = data;
+			fAllocated = size;
+		}
+		if (fCount == fMaxCount) {
+			off_t count = max_c(fMaxCount * 2, 1024);
+			size_t* offsets = (size_t*)realloc(fOffsets,
+				count * sizeof(size_t));
+			if (offsets == NULL)
+				return B_NO_MEMORY;
+
+			fOffsets = offsets;
+			fMaxCount = count;
+		}
+
+		fOffsets[fCount++] = fSize;
+		memcpy(fData + fSize, &length, sizeof(uint16));
+		memcpy(fData + fSize + sizeof(uint16), key, length);
+		fSize += sizeof(uint16) + length;
+		return B_OK;
+	}
+
+	const uint8* KeyAt(off_t index, uint16& _length) const
+	{
+		const uint8* entry = fData + fOffsets[index];
+		memcpy(&_length, entry, sizeof(uint16));
+		return entry + sizeof(uint16);
+	}
+
+private:
+	uint8*		fData;
+	size_t		fSize;
+	size_t		fAllocated;
+	size_t*		fOffsets;
+	off_t		fCount;
+	off_t		fMaxCount;
+};
+
+
+//	#pragma mark -
+
+
+BPlusTreeLoader::BPlusTreeLoader(uint32 nodeSize, uint32 blockSize,
+	type_code type)
+	:
+	fNodeSize(nodeSize),
+	fBlockSize(blockSize),
+	fType(type),
+	fWriting(false),
+	fStatus(B_OK),
+	fLevels(0),
+	fHeaderArea(NULL),
+	fNodeKeyCount(0),
+	fNodeKeyLength(0),
+	fKeyLength(0),
+	fValueCount(0),
+	fLastValue(0),
+	fDuplicateOffset(BPLUSTREE_NULL),
+	fFirstDuplicate(BPLUSTREE_NULL),
+	fFragmentOffset(BPLUSTREE_NULL),
+	fFragmentIndex(-1),
+	fLeaves(0),
+	fDuplicates(0),
+	fFragments(0)
+{
+	memset(fAreas, 0, sizeof(fAreas));
+	memset(fKeys, 0, sizeof(fKeys));
+	memset(fWriters, 0, sizeof(fWriters));
+
+	// there can't be more keys in a node than there are bytes
+	fNode = (bplustree_node*)malloc(nodeSize);
+	fNodeKeys = (uint8*)malloc(nodeSize);
+	fNodeKeyLengths = (uint16*)malloc(nodeSize * sizeof(uint16));
+	fNodeValues = (off_t*)malloc(nodeSize * sizeof(off_t));
+	fDuplicate = (bplustree_node*)malloc(nodeSize);
+	fFragment = (bplustree_node*)malloc(nodeSize);
+
+	if (fNode == NULL || fNodeKeys == NULL || fNodeKeyLengths == NULL
+		|| fNodeValues == NULL || fDuplicate == NULL || fFragment == NULL)
+		fStatus = B_NO_MEMORY;
+	else if (nodeSize != BPLUSTREE_NODE_SIZE || blockSize < nodeSize)
+		fStatus = B_BAD_VALUE;
+}
+
+
+BPlusTreeLoader::~BPlusTreeLoader()
+{
+	for (int32 i = 0; i < kMaxLevels; i++)
+		delete fKeys[i];
+	for (int32 i = 0; i < kAreaCount; i++)
+		delete fWriters[i];
+
+	free(fHeaderArea);
+	free(fNode);
+	free(fNodeKeys);
+	free(fNodeKeyLengths);
+	free(fNodeValues);
+	free(fDuplicate);
+	free(fFragment);
+}
+
+
+/*!	Reads all entries from \a source to find out how many nodes of which
+	kind the tree needs, and where they will be placed.
+*/
+status_t
+BPlusTreeLoader::Prepare(BPlusTreeSource& source)
+{
+	if (fStatus != B_OK)
+		return fStatus;
+
+	for (int32 i = 0; i < kMaxLevels; i++) {
+		delete fKeys[i];
+		fKeys[i] = NULL;
+	}
+
+	fWriting = false;
+	fLevels = 0;
+
+	fKeys[0] = new(std::nothrow) KeyList;
+	if (fKeys[0] == NULL)
+		return B_NO_MEMORY;
+
+	status_t status = _ReadEntries(source);
+	if (status != B_OK)
+		return status;
+
+	fLevelCounts[0] = fLeaves;
+	fLevels = 1;
+
+	while (fLevelCounts[fLevels - 1] > 1) {
+		if (fLevels == kMaxLevels)
+			return B_BAD_VALUE;
+
+		fKeys[fLevels] = new(std::nothrow) KeyList;
+		if (fKeys[fLevels] == NULL)
+			return B_NO_MEMORY;
+
+		status = _BuildLevel(fLevels - 1);
+		if (status != B_OK)
+			return status;
+
+		fLevels++;
+	}
+
+	// the header and the root node come first, then the areas
+
+	fAreas[kHeaderArea].start = 0;
+	fAreas[kHeaderArea].count = 2;
+	fAreas[kLeafArea].count = fLevels > 1 ? fLeaves : 0;
+	fAreas[kDuplicateArea].count = fDuplicates;
+	fAreas[kFragmentArea].count = fFragments;
+	fAreas[kInnerArea].count = 0;
+	for (uint32 level = 1; level + 1 < fLevels; level++)
+		fAreas[kInnerArea].count += fLevelCounts[level];
+
+	for (int32 i = kLeafArea; i < kAreaCount; i++)
+		fAreas[i].start = _AreaEnd(i - 1);
+
+	return B_OK;
+}
+
+
+/*!	Reads all entries from \a source again, and writes the tree. The source
+	must return the same entries as it did for Prepare().
+*/
+status_t
+BPlusTreeLoader::Write(BPlusTreeSource& source)
+{
+	if (fStatus != B_OK)
+		return fStatus;
+	if (fLevels == 0)
+		return B_NO_INIT;
+
+	fWriting = true;
+
+	free(fHeaderArea);
+	fHeaderArea = (uint8*)calloc(1, HeaderSize());
+	if (fHeaderArea == NULL)
+		return B_NO_MEMORY;
+
+	for (int32 i = kLeafArea; i < kAreaCount; i++) {
+		delete fWriters[i];
+		fWriters[i] = new(std::nothrow) NodeWriter(*this, fAreas[i].start,
+			fNodeSize, fBlockSize);
+		if (fWriters[i] == NULL)
+			return B_NO_MEMORY;
+		if (fWriters[i]->Status() != B_OK)
+			return fWriters[i]->Status();
+	}
+
+	// without any entries, the root stays an empty leaf
+	bplustree_node* root = (bplustree_node*)(fHeaderArea + fNodeSize);
+	root->left_link = root->right_link = root->overflow_link
+		= HOST_ENDIAN_TO_BFS_INT64((uint64)BPLUSTREE_NULL);
+
+	status_t status = _ReadEntries(source);
+	if (status == B_OK && (fLeaves != fLevelCounts[0]
+			|| fDuplicates != fAreas[kDuplicateArea].count
+			|| fFragments != fAreas[kFragmentArea].count)) {
+		// the source did not return the same entries again
+		status = B_BAD_DATA;
+	}
+
+	for (uint32 level = 0; status == B_OK && level + 1 < fLevels; level++)
+		status = _BuildLevel(level);
+
+	for (int32 i = kLeafArea; status == B_OK && i < kAreaCount; i++)
+		status = _FinishArea(i);
+
+	if (status == B_OK) {
+		for (off_t offset = 2 * fNodeSize; offset < HeaderSize();
+				offset += fNodeSize) {
+			_InitializeFreeNode((bplustree_node*)(fHeaderArea + offset),
+				offset);
+		}
+
+		status = WriteNodes(fNodeSize, fHeaderArea + fNodeSize,
+			HeaderSize() - fNodeSize);
+	}
+
+	for (int32 i = kLeafArea; i < kAreaCount; i++) {
+		delete fWriters[i];
+		fWriters[i] = NULL;
+	}
+
+	return status;
+}
+
+
+//!	Returns the size of the tree; only valid after Prepare().
+off_t
+BPlusTreeLoader::Size() const
+{
+	return _AreaEnd(kInnerArea);
+}
+
+
+/*!	Returns the size of the area at the start of the tree that contains
+	the header, and the root node.
+*/
+off_t
+BPlusTreeLoader::HeaderSize() const
+{
+	return round_up((off_t)2 * fNodeSize, fBlockSize);
+}
+
+
+//!	Returns the first node in the list of free nodes.
+off_t
+BPlusTreeLoader::FreeNode() const
+{
+	return _NextFreeNode(0);
+}
+
+
+status_t
+BPlusTreeLoader::_ReadEntries(BPlusTreeSource& source)
+{
+	fLeaves = 0;
+	fDuplicates = 0;
+	fFragments = 0;
+	fKeyLength = 0;
+	fFirstDuplicate = BPLUSTREE_NULL;
+	fFragmentIndex = -1;
+	_StartNode();
+
+	status_t status = source.Rewind();
+	if (status != B_OK)
+		return status;
+
+	while (true) {
+		const uint8* key;
+		uint16 keyLength;
+		off_t value;
+		status = source.GetNext(&key, &keyLength, &value);
+		if (status == B_ENTRY_NOT_FOUND)
+			break;
+		if (status == B_OK)
+			status = _AddEntry(key, keyLength, value);
+		if (status != B_OK)
+			return status;
+	}
+
+	if (fKeyLength > 0) {
+		status = _FinishDuplicates();
+		if (status != B_OK)
+			return status;
+	}
+
+	if (fFragmentIndex >= 0 && fWriting) {
+		status = _WriteNode(kFragmentArea, fFragmentOffset, fFragment);
+		if (status != B_OK)
+			return status;
+	}
+
+	if (fNodeKeyCount > 0)
+		return _FinishLeaf(true);
+
+	return B_OK;
+}
+
+
+status_t
+BPlusTreeLoader::_AddEntry(const uint8* key, uint16 keyLength, off_t value)
+{
+	if (keyLength < BPLUSTREE_MIN_KEY_LENGTH
+		|| keyLength > BPLUSTREE_MAX_KEY_LENGTH || value < 0)
+		return B_BAD_VALUE;
+
+	if (fKeyLength > 0) {
+		int compare = QueryParser::compareKeys(fType, key, keyLength, fKey,
+			fKeyLength);
+		if (compare < 0 || (compare == 0 && value < fLastValue)) {
+			// the entries are not sorted
+			return B_BAD_DATA;
+		}
+		if (compare == 0) {
+			if (value == fLastValue)
+				return B_OK;
+
+			return _AddDuplicate(value);
+		}
+
+		status_t status = _FinishDuplicates();
+		if (status != B_OK)
+			return status;
+	}
+
+	memcpy(fKey, key, keyLength);
+	fKeyLength = keyLength;
+	fValues[0] = value;
+	fValueCount = 1;
+	fLastValue = value;
+
+	return B_OK;
+}
+
+
+/*!	Up to NUM_FRAGMENT_VALUES values of a key are kept in a duplicate
+	fragment; any more are stored in a list of duplicate nodes.
+*/
+status_t
+BPlusTreeLoader::_AddDuplicate(off_t value)
+{
+	fLastValue = value;
+
+	off_t* array = (off_t*)fDuplicate->DuplicateArray();
+
+	if (fFirstDuplicate == BPLUSTREE_NULL) {
+		if (fValueCount < NUM_FRAGMENT_VALUES) {
+			fValues[fValueCount++] = value;
+			return B_OK;
+		}
+
+		_StartDuplicate(BPLUSTREE_NULL);
+		fFirstDuplicate = fDuplicateOffset;
+
+		for (int32 i = 0; i < fValueCount; i++)
+			array[i + 1] = HOST_ENDIAN_TO_BFS_INT64(fValues[i]);
+		array[0] = HOST_ENDIAN_TO_BFS_INT64(fValueCount);
+	} else if (BFS_ENDIAN_TO_HOST_INT64(array[0]) == NUM_DUPLICATE_VALUES) {
+		// the list continues with the next duplicate node
+		off_t previous = fDuplicateOffset;
+		fDuplicate->right_link = HOST_ENDIAN_TO_BFS_INT64(previous + fNodeSize);
+
+		if (fWriting) {
+			status_t status = _WriteNode(kDuplicateArea, previous, fDuplicate);
+			if (status != B_OK)
+				return status;
+		}
+
+		_StartDuplicate(previous);
+	}
+
+	off_t count = BFS_ENDIAN_TO_HOST_INT64(array[0]);
+	array[count + 1] = HOST_ENDIAN_TO_BFS_INT64(value);
+	array[0] = HOST_ENDIAN_TO_BFS_INT64(count + 1);
+
+	return B_OK;
+}
+
+
+void
+BPlusTreeLoader::_StartDuplicate(off_t previous)
+{
+	fDuplicateOffset = fAreas[kDuplicateArea].start
+		+ fDuplicates++ * fNodeSize;
+
+	memset(fDuplicate, 0, fNodeSize);
+	fDuplicate->left_link = HOST_ENDIAN_TO_BFS_INT64(previous);
+	fDuplicate->right_link = HOST_ENDIAN_TO_BFS_INT64((uint64)BPLUSTREE_NULL);
+}
+
+
+//!	Adds the collected key with its values to the leaf.
+status_t
+BPlusTreeLoader::_FinishDuplicates()
+{
+	off_t value;
+
+	if (fFirstDuplicate != BPLUSTREE_NULL) {
+		if (fWriting) {
+			status_t status = _WriteNode(kDuplicateArea, fDuplicateOffset,
+				fDuplicate);
+			if (status != B_OK)
+				return status;
+		}
+
+		value = bplustree_node::MakeLink(BPLUSTREE_DUPLICATE_NODE,
+			fFirstDuplicate);
+		fFirstDuplicate = BPLUSTREE_NULL;
+	} else if (fValueCount == 1) {
+		value = fValues[0];
+	} else {
+		if (fFragmentIndex < 0
+			|| (uint32)fFragmentIndex == bplustree_node::MaxFragments(
+				fNodeSize)) {
+			if (fFragmentIndex >= 0 && fWriting) {
+				status_t status = _WriteNode(kFragmentArea, fFragmentOffset,
+					fFragment);
+				if (status != B_OK)
+					return status;
+			}
+
+			// a fragment node does not have a node header
+			fFragmentOffset = fAreas[kFragmentArea].start
+				+ fFragments++ * fNodeSize;
+			fFragmentIndex = 0;
+			memset(fFragment, 0, fNodeSize);
+		}
+
+		off_t* array = (off_t*)fFragment->FragmentAt(fFragmentIndex);
+		array[0] = HOST_ENDIAN_TO_BFS_INT64(fValueCount);
+		for (int32 i = 0; i < fValueCount; i++)
+			array[i + 1] = HOST_ENDIAN_TO_BFS_INT64(fValues[i]);
+
+		value = bplustree_node::MakeLink(BPLUSTREE_DUPLICATE_FRAGMENT,
+			fFragmentOffset, fFragmentIndex++);
+	}
+
+	return _AddToLeaf(value);
+}
+
+
+status_t
+BPlusTreeLoader::_AddToLeaf(off_t value)
+{
+	if (fNodeKeyCount > 0 && !_Fits(fKeyLength)) {
+		status_t status = _FinishLeaf(false);
+		if (status != B_OK)
+			return status;
+
+		_StartNode();
+	}
+
+	_AppendKey(fKey, fKeyLength, value);
+	return B_OK;
+}
+
+
+status_t
+BPlusTreeLoader::_FinishLeaf(bool last)
+{
+	off_t index = fLeaves++;
+
+	if (!fWriting) {
+		// remember the last key of the leaf for the level above
+		uint16 length = fNodeKeyLengths[fNodeKeyCount - 1];
+		return fKeys[0]->Add(fNodeKeys + fNodeKeyLength - length, length);
+	}
+
+	if (index >= fLevelCounts[0])
+		return B_BAD_DATA;
+
+	_FinishNode(index > 0 ? _NodeOffset(0, index - 1) : BPLUSTREE_NULL,
+		last ? BPLUSTREE_NULL : _NodeOffset(0, index + 1), BPLUSTREE_NULL);
+
+	if (fLevels == 1) {
+		memcpy(fHeaderArea + fNodeSize, fNode, fNodeSize);
+		return B_OK;
+	}
+
+	return _WriteNode(kLeafArea, _NodeOffset(0, index), fNode);
+}
+
+
+/*!	Builds the nodes of the level above \a level: each of them gets as many
+	children as fit, and the key of each child but the last one, which
+	becomes its overflow link. When writing, the levels above are already
+	known, otherwise the last keys of the nodes are collected for them.
+*/
+status_t
+BPlusTreeLoader::_BuildLevel(int32 level)
+{
+	KeyList& children = *fKeys[level];
+	off_t count = fLevelCounts[level];
+	off_t parents = 0;
+
+	for (off_t first = 0; first < count;) {
+		_StartNode();
+
+		off_t last = first;
+		while (last + 1 < count) {
+			uint16 length;
+			const uint8* key = children.KeyAt(last, length);
+			if (!_Fits(length))
+				break;
+
+			_AppendKey(key, length, fWriting ? _NodeOffset(level, last) : 0);
+			last++;
+		}
+
+		if (last + 2 == count && last >= first + 2) {
+			// leave two children for the last node instead of just one
+			fNodeKeyLength -= fNodeKeyLengths[--fNodeKeyCount];
+			last--;
+		}
+
+		off_t index = parents++;
+		first = last + 1;
+
+		if (!fWriting) {
+			uint16 length;
+			const uint8* key = children.KeyAt(last, length);
+			status_t status = fKeys[level + 1]->Add(key, length);
+			if (status != B_OK)
+				return status;
+			continue;
+		}
+
+		if (index >= fLevelCounts[level + 1])
+			return B_BAD_DATA;
+
+		_FinishNode(
+			index > 0 ? _NodeOffset(level + 1, index - 1) : BPLUSTREE_NULL,
+			index + 1 < fLevelCounts[level + 1]
+				? _NodeOffset(level + 1, index + 1) : BPLUSTREE_NULL,
+			_NodeOffset(level, last));
+
+		if ((uint32)level + 2 == fLevels)
+			memcpy(fHeaderArea + fNodeSize, fNode, fNodeSize);
+		else {
+			status_t status = _WriteNode(kInnerArea,
+				_NodeOffset(level + 1, index), fNode);
+			if (status != B_OK)
+				return status;
+		}
+	}
+
+	if (!fWriting)
+		fLevelCounts[level + 1] = parents;
+
+	return B_OK;
+}
+
+
+void
+BPlusTreeLoader::_StartNode()
+{
+	fNodeKeyCount = 0;
+	fNodeKeyLength = 0;
+}
+
+
+bool
+BPlusTreeLoader::_Fits(uint16 keyLength) const
+{
+	return key_align(sizeof(bplustree_node) + fNodeKeyLength + keyLength)
+		+ (fNodeKeyCount + 1) * (sizeof(uint16) + sizeof(off_t)) <= fNodeSize;
+}
+
+
+void
+BPlusTreeLoader::_AppendKey(const uint8* key, uint16 keyLength, off_t value)
+{
+	memcpy(fNodeKeys + fNodeKeyLength, key, keyLength);
+	fNodeKeyLengths[fNodeKeyCount] = keyLength;
+	fNodeValues[fNodeKeyCount] = value;
+	fNodeKeyCount++;
+	fNodeKeyLength += keyLength;
+}
+
+
+void
+BPlusTreeLoader::_FinishNode(off_t left, off_t right, off_t overflow)
+{
+	memset(fNode, 0, fNodeSize);
+
+	fNode->left_link = HOST_ENDIAN_TO_BFS_INT64(left);
+	fNode->right_link = HOST_ENDIAN_TO_BFS_INT64(right);
+	fNode->overflow_link = HOST_ENDIAN_TO_BFS_INT64(overflow);
+	fNode->all_key_count = HOST_ENDIAN_TO_BFS_INT16(fNodeKeyCount);
+	fNode->all_key_length = HOST_ENDIAN_TO_BFS_INT16(fNodeKeyLength);
+
+	memcpy(fNode->Keys(), fNodeKeys, fNodeKeyLength);
+
+	Unaligned<uint16>* keyLengths = fNode->KeyLengths();
+	Unaligned<off_t>* values = fNode->Values();
+	uint16 end = 0;
+
+	for (int32 i = 0; i < fNodeKeyCount; i++) {
+		end += fNodeKeyLengths[i];
+		keyLengths[i] = HOST_ENDIAN_TO_BFS_INT16(end);
+		values[i] = HOST_ENDIAN_TO_BFS_INT64(fNodeValues[i]);
+	}
+}
+
+
+status_t
+BPlusTreeLoader::_WriteNode(int32 area, off_t offset,
+	const bplustree_node* node)
+{
+	NodeWriter* writer = fWriters[area];
+	if (writer->NextOffset() != offset) {
+		FATAL(("bulk loaded node at %" B_PRIdOFF " written out of order\n",
+			offset));
+		return B_ERROR;
+	}
+
+	bplustree_node* target = writer->Next();
+	if (target == NULL)
+		return writer->Status();
+
+	memcpy(target, node, fNodeSize);
+	return B_OK;
+}
+
+
+//!	Puts the rest of the area into the list of free nodes, and writes it.
+status_t
+BPlusTreeLoader::_FinishArea(int32 area)
+{
+	NodeWriter* writer = fWriters[area];
+	off_t end = _AreaEnd(area);
+
+	while (writer->NextOffset() < end) {
+		off_t offset = writer->NextOffset();
+		bplustree_node* node = writer->Next();
+		if (node == NULL)
+			return writer->Status();
+
+		_InitializeFreeNode(node, offset);
+	}
+
+	return writer->Flush();
+}
+
+
+off_t
+BPlusTreeLoader::_AreaEnd(int32 area) const
+{
+	return round_up(fAreas[area].start + fAreas[area].count * fNodeSize,
+		(off_t)fBlockSize);
+}
+
+
+/*!	Returns the offset of the node \a index of \a level, counted from the
+	leaves. The root is always right after the header, the inner nodes of
+	the other levels follow each other in their area.
+*/
+off_t
+BPlusTreeLoader::_NodeOffset(int32 level, off_t index) const
+{
+	if ((uint32)level + 1 == fLevels)
+		return fNodeSize;
+	if (level == 0)
+		return fAreas[kLeafArea].start + index * fNodeSize;
+
+	off_t offset = fAreas[kInnerArea].start;
+	for (int32 i = 1; i < level; i++)
+		offset += fLevelCounts[i] * fNodeSize;
+
+	return offset + index * fNodeSize;
+}
+
+
+//!	Returns the free node that follows \a offset.
+off_t
+BPlusTreeLoader::_NextFreeNode(off_t offset) const
+{
+	for (int32 i = 0; i < kAreaCount; i++) {
+		off_t next = fAreas[i].start + fAreas[i].count * fNodeSize;
+		if (next <= offset)
+			next = offset + fNodeSize;
+		if (next < _AreaEnd(i))
+			return next;
+	}
+
+	return BPLUSTREE_NULL;
+}
+
+
+void
+BPlusTreeLoader::_InitializeFreeNode(bplustree_node* node, off_t offset) const
+{
+	memset(node, 0, fNodeSize);
+
+	node->left_link = HOST_ENDIAN_TO_BFS_INT64(_NextFreeNode(offset));
+	node->right_link = HOST_ENDIAN_TO_BFS_INT64((uint64)BPLUSTREE_NULL);
+	node->overflow_link = HOST_ENDIAN_TO_BFS_INT64((uint64)BPLUSTREE_FREE);
+}
@@ -0,0 +1,229 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * This file may be used under the terms of the MIT License.
+ */
+#ifndef B_PLUS_TREE_LOADER_H
+#define B_PLUS_TREE_LOADER_H
+
+
+#include "system_dependencies.h"
+
+#include "BPlusTree.h"
+
+
+/*!	Provides the entries of a B+tree in the order of the tree: sorted by
+	key, and the values of each key in ascending order.
+*/
+class BPlusTreeSource {
+public:
+	virtual						~BPlusTreeSource();
+
+	virtual	status_t			Rewind() = 0;
+	virtual	status_t			GetNext(const uint8** _key, uint16* _keyLength,
+									off_t* _value) = 0;
+									// B_ENTRY_NOT_FOUND at the end
+};
+
+
+/*!	Collects entries, and returns them sorted. The entries are kept in runs
+	of \a runSize bytes that are sorted one by one as they fill up, and
+	merged when they are read back.
+	Once the runs would use more than \a maxMemory bytes, they are written
+	to a storage that subclasses can provide with WriteStorage() and
+	ReadStorage(), and only read back in chunks of ChunkSize() bytes for
+	the merge. Without a storage, Add() fails with B_NO_MEMORY instead; with
+	one, it only does so when there are too many runs to merge them with
+	one chunk of each in memory.
+*/
+class KeySorter : public BPlusTreeSource {
+public:
+								KeySorter(type_code type, size_t maxMemory,
+									size_t runSize = kDefaultRunSize);
+	virtual						~KeySorter();
+
+			status_t			InitCheck() const { return fStatus; }
+
+			status_t			Add(const uint8* key, uint16 keyLength,
+									off_t value);
+
+			off_t				CountEntries() const { return fEntries; }
+			int32				CountRuns() const { return fRunCount; }
+			off_t				StorageSize() const { return fStorageSize; }
+			size_t				ChunkSize() const { return fChunkSize; }
+
+	virtual	status_t			Rewind();
+	virtual	status_t			GetNext(const uint8** _key, uint16* _keyLength,
+									off_t* _value);
+
+	static	const size_t		kDefaultRunSize = 4 * 1024 * 1024;
+	static	const size_t		kMaxChunkSize = 64 * 1024;
+
+protected:
+	virtual	status_t			WriteStorage(off_t offset, const uint8* buffer,
+									size_t size);
+	virtual	status_t			ReadStorage(off_t offset, uint8* buffer,
+									size_t size);
+									// both only get whole chunks
+
+private:
+			struct sort_run;
+
+			status_t			_AddRun();
+			status_t			_StoreRuns();
+			status_t			_FlushChunk(size_t used);
+			status_t			_ReadChunk(sort_run& run);
+			void				_SortRun(sort_run& run);
+			int					_Compare(const sort_run& run, uint32 first,
+									uint32 second) const;
+			int					_CompareRuns(int32 first, int32 second) const;
+			void				_SiftDown(int32 index);
+
+private:
+			type_code			fType;
+			size_t				fMaxMemory;
+			size_t				fRunSize;
+			size_t				fChunkSize;
+			sort_run*			fRuns;
+			int32				fRunCount;
+			int32				fRunsAllocated;
+			int32				fSortedRuns;
+			int32				fStoredRuns;
+				// the runs before this one are in the storage
+			off_t				fStorageSize;
+			uint8*				fChunk;
+			uint8				fKey[BPLUSTREE_MAX_KEY_LENGTH];
+				// the last key returned from a run in the storage
+			uint32*				fScratch;
+			int32*				fHeap;
+			int32				fHeapCount;
+			off_t				fEntries;
+			status_t			fStatus;
+};
+
+
+/*!	Builds a complete B+tree from a BPlusTreeSource, bottom-up: the leaves
+	are filled completely in key order, and the levels above are built from
+	the last keys of the nodes below.
+	Prepare() reads the entries once to find the size and shape of the tree,
+	and Write() reads them again, and passes the nodes on to WriteNodes().
+	The nodes of each kind (leaves, duplicate nodes, duplicate fragments,
+	and inner nodes) are placed in areas of their own that are written in
+	order, in chunks of whole blocks; the space left at the end of each area
+	is put into the list of free nodes. The root node is always at the
+	start of the tree, right after the header, and is written last, along
+	with the rest of the first HeaderSize() bytes of the stream.
+	The header itself is left to the caller, see RootNode(), FreeNode(),
+	CountLevels(), and Size().
+*/
+class BPlusTreeLoader {
+public:
+								BPlusTreeLoader(uint32 nodeSize,
+									uint32 blockSize, type_code type);
+	virtual						~BPlusTreeLoader();
+
+			status_t			InitCheck() const { return fStatus; }
+
+			status_t			Prepare(BPlusTreeSource& source);
+			status_t			Write(BPlusTreeSource& source);
+
+			off_t				Size() const;
+			off_t				HeaderSize() const;
+			off_t				RootNode() const { return fNodeSize; }
+			off_t				FreeNode() const;
+			uint32				CountLevels() const { return fLevels; }
+
+	virtual	status_t			WriteNodes(off_t offset, const uint8* buffer,
+									size_t size) = 0;
+
+	static	const int32			kMaxLevels = 24;
+
+private:
+			class NodeWriter;
+			class KeyList;
+
+			enum {
+				kHeaderArea = 0,
+				kLeafArea,
+				kDuplicateArea,
+				kFragmentArea,
+				kInnerArea,
+				kAreaCount
+			};
+
+			struct area {
+				off_t			start;
+				off_t			count;
+			};
+
+			status_t			_ReadEntries(BPlusTreeSource& source);
+			status_t			_AddEntry(const uint8* key, uint16 keyLength,
+									off_t value);
+			status_t			_AddDuplicate(off_t value);
+			void				_StartDuplicate(off_t previous);
+			status_t			_FinishDuplicates();
+			status_t			_AddToLeaf(off_t value);
+			status_t			_FinishLeaf(bool last);
+			status_t			_BuildLevel(int32 level);
+
+			void				_StartNode();
+			bool				_Fits(uint16 keyLength) const;
+			void				_AppendKey(const uint8* key,
+									uint16 keyLength, off_t value);
+			void				_FinishNode(off_t left, off_t right,
+									off_t overflow);
+			status_t			_WriteNode(int32 area, off_t offset,
+									const bplustree_node* node);
+			status_t			_FinishArea(int32 area);
+
+			off_t				_AreaEnd(int32 area) const;
+			off_t				_NodeOffset(int32 level, off_t index) const;
+			off_t				_NextFreeNode(off_t offset) const;
+			void				_InitializeFreeNode(bplustree_node* node,
+									off_t offset) const;
+
+private:
+			uint32				fNodeSize;
+			uint32				fBlockSize;
+			type_code			fType;
+			bool				fWriting;
+			status_t			fStatus;
+
+			area				fAreas[kAreaCount];
+			off_t				fLevelCounts[kMaxLevels];
+			uint32				fLevels;
+			KeyList*			fKeys[kMaxLevels];
+				// the last keys of the nodes of each level
+
+			NodeWriter*			fWriters[kAreaCount];
+			uint8*				fHeaderArea;
+
+			// the node that is being filled
+			bplustree_node*		fNode;
+			uint8*				fNodeKeys;
+			uint16*				fNodeKeyLengths;
+			off_t*				fNodeValues;
+			int32				fNodeKeyCount;
+			uint16				fNodeKeyLength;
+
+			// the key whose values are being collected
+			uint8				fKey[BPLUSTREE_MAX_KEY_LENGTH];
+			uint16				fKeyLength;
+			off_t				fValues[NUM_FRAGMENT_VALUES];
+			int32				fValueCount;
+			off_t				fLastValue;
+
+			bplustree_node*		fDuplicate;
+			off_t				fDuplicateOffset;
+			off_t				fFirstDuplicate;
+
+			bplustree_node*		fFragment;
+			off_t				fFragmentOffset;
+			int32				fFragmentIndex;
+
+			off_t				fLeaves;
+			off_t				fDuplicates;
+			off_t				fFragments;
+};
+
+
+#endif	// B_PLUS_TREE_LOADER_H
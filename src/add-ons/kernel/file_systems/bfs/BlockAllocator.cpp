@@ -728,10 +728,13 @@ BlockAllocator::Uninitialize()
 
 	The number of allocated blocks is always a multiple of \a minimum which
 	has to be a power of two value.
+	The blocks reserved for delayed allocations are left alone, except for
+	the \a reserved blocks that have been reserved for the caller itself.
 */
 status_t
 BlockAllocator::AllocateBlocks(Transaction& transaction, int32 groupIndex,
-	uint16 start, uint16 maximum, uint16 minimum, block_run& run)
+	uint16 start, uint16 maximum, uint16 minimum, block_run& run,
+	off_t reserved)
 {
 	if (maximum == 0)
 		return B_BAD_VALUE;
@@ -743,6 +746,14 @@ BlockAllocator::AllocateBlocks(Transaction& transaction, int32 groupIndex,
 	AllocationBlock cached(fVolume);
 	RecursiveLocker lock(fLock);
 
+	off_t available = fVolume->FreeBlocks() + reserved;
+	if (available < (off_t)maximum) {
+		if (available < (off_t)minimum)
+			return B_DEVICE_FULL;
+
+		maximum = round_down((uint16)available, minimum);
+	}
+
 	uint32 bitsPerFullBlock = fVolume->BlockSize() << 3;
 
 	// Find the block_run that can fulfill the request best
@@ -992,7 +1003,9 @@ BlockAllocator::Allocate(Transaction& transaction, Inode* inode,
 		group = inode->BlockRun().AllocationGroup() + 1;
 	}
 
-	return AllocateBlocks(transaction, group, start, numBlocks, minimum, run);
+	// the inode may use the blocks reserved for its delayed allocation
+	return AllocateBlocks(transaction, group, start, numBlocks, minimum, run,
+		inode->ReservedBlocks());
 }
 
 
@@ -1181,7 +1194,6 @@ BlockAllocator::Trim(uint64 offset, uint64 size, uint64& trimmedSize)
 		return B_NO_MEMORY;
 
 	MemoryDeleter deleter(trimData);
-	RecursiveLocker locker(fLock);
 
 	// TODO: take given offset and size into account!
 	int32 lastGroup = fNumGroups - 1;
@@ -1200,6 +1212,10 @@ BlockAllocator::Trim(uint64 offset, uint64 size, uint64& trimmedSize)
 	for (int32 groupIndex = 0; groupIndex <= lastGroup; groupIndex++) {
 		AllocationGroup& group = fGroups[groupIndex];
 
+		// Only lock one group at a time, so that we do not keep everyone
+		// from allocating blocks for the whole time it takes to trim the disk
+		RecursiveLocker locker(fLock);
+
 		for (uint32 block = firstBlock; block < group.NumBlocks(); block++) {
 			cached.SetTo(group, block);
 
@@ -1233,12 +1249,19 @@ BlockAllocator::Trim(uint64 offset, uint64 size, uint64& trimmedSize)
 			}
 		}
 
+		// The free ranges may no longer be free once we unlock; trim them now
+		status_t status = _TrimNext(*trimData, kTrimRanges,
+			firstFree << blockShift, freeLength << blockShift, true,
+			trimmedSize);
+		if (status != B_OK)
+			return status;
+
+		freeLength = 0;
 		firstBlock = 0;
 		firstBit = 0;
 	}
 
-	return _TrimNext(*trimData, kTrimRanges, firstFree << blockShift,
-		freeLength << blockShift, true, trimmedSize);
+	return B_OK;
 }
 
 
@@ -1356,7 +1379,7 @@ BlockAllocator::_TrimNext(fs_trim_data& trimData, uint32 maxRanges,
 
 	const bool rangesFilled = _AddTrim(trimData, maxRanges, offset, size);
 
-	if (rangesFilled || force) {
+	if (rangesFilled || (force && trimData.range_count > 0)) {
 		// Trim now
 		trimData.trimmed_size = 0;
 #ifdef DEBUG_TRIM
@@ -41,7 +41,8 @@ public:
 
 			status_t		AllocateBlocks(Transaction& transaction,
 								int32 group, uint16 start, uint16 numBlocks,
-								uint16 minimum, block_run& run);
+								uint16 minimum, block_run& run,
+								off_t reserved = 0);
 
 			status_t		Trim(uint64 offset, uint64 size,
 								uint64& trimmedSize);
@@ -42,6 +42,9 @@ public:
 									block_run run, bool empty = false);
 	inline status_t				MakeWritable(Transaction& transaction);
 
+	inline	void				Prefetch(off_t block, size_t numBlocks);
+	inline	void				Prefetch(block_run run);
+
 			const uint8*		Block() const { return fBlock; }
 			uint8*				WritableBlock() const { return fBlock; }
 			off_t				BlockNumber() const { return fBlockNumber; }
@@ -177,4 +180,21 @@ CachedBlock::MakeWritable(Transaction& transaction)
 }
 
 
+/*!	Starts reading the specified blocks into the block cache in the
+	background, so that they are likely already there when they are needed.
+*/
+inline void
+CachedBlock::Prefetch(off_t block, size_t numBlocks)
+{
+	block_cache_prefetch(fVolume->BlockCache(), block, numBlocks);
+}
+
+
+inline void
+CachedBlock::Prefetch(block_run run)
+{
+	Prefetch(fVolume->ToBlock(run), run.Length());
+}
+
+
 #endif	// CACHED_BLOCK_H
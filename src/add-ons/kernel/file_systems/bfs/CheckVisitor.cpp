@@ -1,5 +1,5 @@
 /*
- * Copyright 2002-2020, Axel Dörfler, axeld@pinc-software.de.
+ * Copyright 2002-2026, Axel Dörfler, axeld@pinc-software.de.
  * Copyright 2012, Andreas Henriksson, sausageboy@gmail.com
  * This file may be used under the terms of the MIT License.
  */
@@ -28,17 +28,39 @@ struct check_index {
 	Inode*				inode;
 };
 
+struct check_node {
+	check_control		control;
+		// what is reported for the node; the stats only count its blocks
+	Inode*				inode;
+	status_t			status;
+		// an error stops the check
+	bool				inTree;
+	bool				rebuildIndex;
+	bool				done;
+};
+
 
 CheckVisitor::CheckVisitor(Volume* volume)
 	:
 	FileSystemVisitor(volume),
-	fCheckBitmap(NULL)
+	fCheckBitmap(NULL),
+	fWorkSem(-1),
+	fDoneSem(-1),
+	fThreadCount(0),
+	fNodes(NULL),
+	fSubmitted(0),
+	fProcessed(0),
+	fReported(0),
+	fTraversalStatus(B_OK)
 {
+	mutex_init(&fLock, "bfs check");
 }
 
 
 CheckVisitor::~CheckVisitor()
 {
+	_StopThreads();
+	mutex_destroy(&fLock);
 	free(fCheckBitmap);
 }
 
@@ -55,7 +77,12 @@ CheckVisitor::StartBitmapPass()
 
 	size_t size = _BitmapSize();
 	fCheckBitmap = (uint32*)malloc(size);
-	if (fCheckBitmap == NULL) {
+	fNodes = (check_node*)malloc(kMaxQueuedNodes * sizeof(check_node));
+	if (fCheckBitmap == NULL || fNodes == NULL) {
+		free(fCheckBitmap);
+		fCheckBitmap = NULL;
+		free(fNodes);
+		fNodes = NULL;
 		recursive_lock_unlock(&GetVolume()->Allocator().Lock());
 		GetVolume()->GetJournal(0)->Unlock(NULL, true);
 		return B_NO_MEMORY;
@@ -75,13 +102,54 @@ CheckVisitor::StartBitmapPass()
 
 	// TODO: check reserved area in bitmap!
 
+	// All allocations are checked against the on-disk bitmap, so we will
+	// need all of it
+	CachedBlock cached(GetVolume());
+	cached.Prefetch(1, GetVolume()->NumBitmapBlocks());
+
 	Start(VISIT_REGULAR | VISIT_INDICES | VISIT_REMOVED
 		| VISIT_ATTRIBUTE_DIRECTORIES);
+	_StartThreads();
 
 	return B_OK;
 }
 
 
+/*!	Checks the next node, and puts its results into the check_control.
+	During the bitmap pass, the blocks and B+trees of the nodes are checked
+	by the check threads, while this thread already traverses the file
+	system to find the next nodes; the results are still reported in the
+	order the nodes were visited.
+*/
+status_t
+CheckVisitor::CheckNextNode()
+{
+	if (Pass() != BFS_CHECK_PASS_BITMAP)
+		return Next();
+
+	// Without any threads, every node is checked when it is visited
+	uint32 maxQueued = fThreadCount > 0 ? kMaxQueuedNodes : 1;
+
+	while (fTraversalStatus == B_OK && fSubmitted - fReported < maxQueued) {
+		status_t status = Next();
+		if (status != B_OK)
+			fTraversalStatus = status;
+	}
+
+	if (fReported == fSubmitted) {
+		// all visited nodes have been reported
+		_StopThreads();
+		return fTraversalStatus;
+	}
+
+	check_node& node = fNodes[fReported % kMaxQueuedNodes];
+	_WaitForNode(node);
+	fReported++;
+
+	return _ReportNode(node);
+}
+
+
 status_t
 CheckVisitor::WriteBackCheckBitmap()
 {
@@ -190,6 +258,7 @@ CheckVisitor::StopChecking()
 	if (Control().status != B_ENTRY_NOT_FOUND)
 		FATAL(("CheckVisitor didn't run through\n"));
 
+	_StopThreads();
 	_FreeIndices();
 
 	recursive_lock_unlock(&GetVolume()->Allocator().Lock());
@@ -226,7 +295,8 @@ CheckVisitor::VisitDirectoryEntry(Inode* inode, Inode* parent,
 				localName));
 
 			if ((Control().flags & BFS_FIX_NAME_MISMATCHES) != 0) {
-				// Rename the inode
+				// Rename the inode; this also changes the name index
+				_WaitForThreads();
 				Transaction transaction(GetVolume(), inode->BlockNumber());
 
 				// Note, this may need extra blocks, but the inode will
@@ -292,35 +362,8 @@ CheckVisitor::VisitInode(Inode* inode, const char* treeName)
 
 	switch (Pass()) {
 		case BFS_CHECK_PASS_BITMAP:
-		{
-			status = _CheckInodeBlocks(inode, NULL);
-			if (status != B_OK)
-				return status;
-
-			// Check the B+tree as well
-			if (inode->IsContainer()) {
-				bool repairErrors = (Control().flags & BFS_FIX_BPLUSTREES) != 0;
-				bool errorsFound = false;
-
-				status = inode->Tree()->Validate(repairErrors, errorsFound);
-
-				if (errorsFound) {
-					Control().errors |= BFS_INVALID_BPLUSTREE;
-					if (inode->IsIndex() && treeName != NULL && repairErrors) {
-						// We completely rebuild corrupt indices
-						check_index* index = new(std::nothrow) check_index;
-						if (index == NULL)
-							return B_NO_MEMORY;
-
-						strlcpy(index->name, treeName, sizeof(index->name));
-						index->run = inode->BlockRun();
-						Indices().Push(index);
-					}
-				}
-			}
-
-			break;
-		}
+			// the blocks and the B+tree are checked by _CheckNode()
+			return _SubmitNode(inode, treeName != NULL);
 
 		case BFS_CHECK_PASS_INDEX:
 			status = _AddInodeToIndex(inode);
@@ -390,6 +433,9 @@ status_t
 CheckVisitor::_RemoveInvalidNode(Inode* parent, BPlusTree* tree,
 	Inode* inode, const char* name)
 {
+	// The check threads must not read the B+trees we are about to change
+	_WaitForThreads();
+
 	// It's safe to start a transaction, because Inode::Remove()
 	// won't touch the block bitmap (which we hold the lock for)
 	// if we set the INODE_DONT_FREE_SPACE flag - since we fix
@@ -445,15 +491,21 @@ CheckVisitor::_CheckBitmapIsUsedAt(off_t block) const
 }
 
 
-void
+/*!	Sets the bit of \a block in the check bitmap, and returns whether it
+	had already been set before. This may be called by several threads at
+	once.
+*/
+bool
 CheckVisitor::_SetCheckBitmapAt(off_t block)
 {
 	size_t size = _BitmapSize();
 	uint32 index = block / 32;	// 32bit resolution
 	if (index > size / 4)
-		return;
+		return false;
 
-	fCheckBitmap[index] |= HOST_ENDIAN_TO_BFS_INT32(1UL << (block & 0x1f));
+	uint32 mask = HOST_ENDIAN_TO_BFS_INT32(1UL << (block & 0x1f));
+	return ((uint32)atomic_or((int32*)&fCheckBitmap[index], mask) & mask)
+		!= 0;
 }
 
 
@@ -465,9 +517,9 @@ CheckVisitor::_BitmapSize() const
 
 
 status_t
-CheckVisitor::_CheckInodeBlocks(Inode* inode, const char* name)
+CheckVisitor::_CheckInodeBlocks(check_control& control, Inode* inode)
 {
-	status_t status = _CheckAllocated(inode->BlockRun(), "inode");
+	status_t status = _CheckAllocated(control, inode->BlockRun(), "inode");
 	if (status != B_OK)
 		return status;
 
@@ -480,6 +532,7 @@ CheckVisitor::_CheckInodeBlocks(Inode* inode, const char* name)
 	}
 
 	data_stream* data = &inode->Node().data;
+	CachedBlock cached(GetVolume());
 
 	// check the direct range
 
@@ -488,26 +541,30 @@ CheckVisitor::_CheckInodeBlocks(Inode* inode, const char* name)
 			if (data->direct[i].IsZero())
 				break;
 
-			status = _CheckAllocated(data->direct[i], "direct");
+			status = _CheckAllocated(control, data->direct[i], "direct");
 			if (status < B_OK)
 				return status;
 
-			Control().stats.direct_block_runs++;
-			Control().stats.blocks_in_direct
+			if (inode->IsContainer()) {
+				// the B+tree will be validated right after this
+				cached.Prefetch(data->direct[i]);
+			}
+
+			control.stats.direct_block_runs++;
+			control.stats.blocks_in_direct
 				+= data->direct[i].Length();
 		}
 	}
 
-	CachedBlock cached(GetVolume());
-
 	// check the indirect range
 
 	if (data->max_indirect_range) {
-		status = _CheckAllocated(data->indirect, "indirect");
+		status = _CheckAllocated(control, data->indirect, "indirect");
 		if (status != B_OK)
 			return status;
 
 		off_t block = GetVolume()->ToBlock(data->indirect);
+		cached.Prefetch(data->indirect);
 
 		for (int32 i = 0; i < data->indirect.Length(); i++) {
 			status = cached.SetTo(block + i);
@@ -521,15 +578,16 @@ CheckVisitor::_CheckInodeBlocks(Inode* inode, const char* name)
 				if (runs[index].IsZero())
 					break;
 
-				status = _CheckAllocated(runs[index], "indirect->run");
+				status = _CheckAllocated(control, runs[index],
+					"indirect->run");
 				if (status < B_OK)
 					return status;
 
-				Control().stats.indirect_block_runs++;
-				Control().stats.blocks_in_indirect
+				control.stats.indirect_block_runs++;
+				control.stats.blocks_in_indirect
 					+= runs[index].Length();
 			}
-			Control().stats.indirect_array_blocks++;
+			control.stats.indirect_array_blocks++;
 
 			if (index < runsPerBlock)
 				break;
@@ -539,7 +597,8 @@ CheckVisitor::_CheckInodeBlocks(Inode* inode, const char* name)
 	// check the double indirect range
 
 	if (data->max_double_indirect_range) {
-		status = _CheckAllocated(data->double_indirect, "double indirect");
+		status = _CheckAllocated(control, data->double_indirect,
+			"double indirect");
 		if (status != B_OK)
 			return status;
 
@@ -547,6 +606,7 @@ CheckVisitor::_CheckInodeBlocks(Inode* inode, const char* name)
 		int32 runsPerArray = runsPerBlock * data->double_indirect.Length();
 
 		CachedBlock cachedDirect(GetVolume());
+		cached.Prefetch(data->double_indirect);
 
 		for (int32 indirectIndex = 0; indirectIndex < runsPerArray;
 				indirectIndex++) {
@@ -562,10 +622,13 @@ CheckVisitor::_CheckInodeBlocks(Inode* inode, const char* name)
 			if (indirect.IsZero())
 				return B_OK;
 
-			status = _CheckAllocated(indirect, "double indirect->runs");
+			status = _CheckAllocated(control, indirect,
+				"double indirect->runs");
 			if (status != B_OK)
 				return status;
 
+			cachedDirect.Prefetch(indirect);
+
 			int32 maxIndex
 				= ((uint32)indirect.Length() << GetVolume()->BlockShift())
 					/ sizeof(block_run);
@@ -583,18 +646,19 @@ CheckVisitor::_CheckInodeBlocks(Inode* inode, const char* name)
 					if (runs[index % runsPerBlock].IsZero())
 						return B_OK;
 
-					status = _CheckAllocated(runs[index % runsPerBlock],
+					status = _CheckAllocated(control,
+						runs[index % runsPerBlock],
 						"double indirect->runs->run");
 					if (status != B_OK)
 						return status;
 
-					Control().stats.double_indirect_block_runs++;
-					Control().stats.blocks_in_double_indirect
+					control.stats.double_indirect_block_runs++;
+					control.stats.blocks_in_double_indirect
 						+= runs[index % runsPerBlock].Length();
 				} while ((++index % runsPerBlock) != 0);
 			}
 
-			Control().stats.double_indirect_array_blocks++;
+			control.stats.double_indirect_array_blocks++;
 		}
 	}
 
@@ -603,13 +667,14 @@ CheckVisitor::_CheckInodeBlocks(Inode* inode, const char* name)
 
 
 status_t
-CheckVisitor::_CheckAllocated(block_run run, const char* type)
+CheckVisitor::_CheckAllocated(check_control& control, block_run run,
+	const char* type)
 {
 	BlockAllocator& allocator = GetVolume()->Allocator();
 
 	// make sure the block run is valid
 	if (!allocator.IsValidBlockRun(run, type)) {
-		Control().errors |= BFS_INVALID_BLOCK_RUN;
+		control.errors |= BFS_INVALID_BLOCK_RUN;
 		return B_OK;
 	}
 
@@ -642,7 +707,7 @@ CheckVisitor::_CheckAllocated(block_run run, const char* type)
 			type, run.AllocationGroup(), run.Start(),
 			run.Length(), firstMissing, afterLastMissing - 1));
 
-		Control().stats.missing += afterLastMissing - firstMissing;
+		control.stats.missing += afterLastMissing - firstMissing;
 
 		block = afterLastMissing;
 	}
@@ -651,12 +716,12 @@ CheckVisitor::_CheckAllocated(block_run run, const char* type)
 	off_t firstSet = -1;
 
 	for (block = start; block < end; block++) {
-		if (_CheckBitmapIsUsedAt(block)) {
+		if (_SetCheckBitmapAt(block)) {
 			if (firstSet == -1) {
 				firstSet = block;
-				Control().errors |= BFS_BLOCKS_ALREADY_SET;
+				control.errors |= BFS_BLOCKS_ALREADY_SET;
 			}
-			Control().stats.already_set++;
+			control.stats.already_set++;
 		} else {
 			if (firstSet != -1) {
 				FATAL(("%s: block_run(%d, %u, %u): blocks %" B_PRIdOFF
@@ -665,7 +730,6 @@ CheckVisitor::_CheckAllocated(block_run run, const char* type)
 					firstSet, block - 1));
 				firstSet = -1;
 			}
-			_SetCheckBitmapAt(block);
 		}
 	}
 
@@ -673,6 +737,224 @@ CheckVisitor::_CheckAllocated(block_run run, const char* type)
 }
 
 
+void
+CheckVisitor::_StartThreads()
+{
+	fWorkSem = create_sem(0, "bfs check work");
+	fDoneSem = create_sem(0, "bfs check done");
+	if (fWorkSem < 0 || fDoneSem < 0)
+		return;
+
+	// The threads mostly wait for the disk, so that there can be more of
+	// them than there are CPUs
+	while (fThreadCount < kMaxThreads) {
+		thread_id thread = spawn_kernel_thread(&CheckVisitor::_CheckThread,
+			"bfs check", B_NORMAL_PRIORITY, this);
+		if (thread < 0)
+			break;
+
+		fThreads[fThreadCount++] = thread;
+		resume_thread(thread);
+	}
+}
+
+
+/*!	Stops the check threads, and releases the nodes that have not been
+	reported yet.
+*/
+void
+CheckVisitor::_StopThreads()
+{
+	if (fWorkSem >= 0) {
+		// the threads finish the node they are working on, and then quit
+		delete_sem(fWorkSem);
+		fWorkSem = -1;
+	}
+	for (int32 i = 0; i < fThreadCount; i++)
+		wait_for_thread(fThreads[i], NULL);
+	fThreadCount = 0;
+
+	if (fDoneSem >= 0) {
+		delete_sem(fDoneSem);
+		fDoneSem = -1;
+	}
+
+	for (; fReported != fSubmitted; fReported++) {
+		check_node& node = fNodes[fReported % kMaxQueuedNodes];
+		put_vnode(GetVolume()->FSVolume(), node.inode->ID());
+	}
+
+	free(fNodes);
+	fNodes = NULL;
+}
+
+
+/*static*/ status_t
+CheckVisitor::_CheckThread(void* _visitor)
+{
+	CheckVisitor* visitor = (CheckVisitor*)_visitor;
+
+	while (acquire_sem(visitor->fWorkSem) == B_OK) {
+		mutex_lock(&visitor->fLock);
+		check_node& node
+			= visitor->fNodes[visitor->fProcessed++ % kMaxQueuedNodes];
+		mutex_unlock(&visitor->fLock);
+
+		visitor->_CheckNode(node);
+
+		mutex_lock(&visitor->fLock);
+		node.done = true;
+		mutex_unlock(&visitor->fLock);
+
+		release_sem(visitor->fDoneSem);
+	}
+
+	return B_OK;
+}
+
+
+/*!	Queues the \a inode to be checked by one of the check threads, or
+	checks it right away if there are none. The check_control as filled in
+	by the traversal is reported for it, together with the errors the
+	check finds.
+*/
+status_t
+CheckVisitor::_SubmitNode(Inode* inode, bool inTree)
+{
+	check_node& node = fNodes[fSubmitted % kMaxQueuedNodes];
+	memcpy(&node.control, &Control(), sizeof(check_control));
+	memset(&node.control.stats, 0, sizeof(node.control.stats));
+	node.control.status = B_OK;
+	node.status = B_OK;
+	node.inTree = inTree;
+	node.rebuildIndex = false;
+	node.done = false;
+
+	// the errors found so far belong to this node
+	Control().errors = 0;
+
+	// the inode must stay in memory until the node has been reported
+	acquire_vnode(GetVolume()->FSVolume(), inode->ID());
+	node.inode = inode;
+	fSubmitted++;
+
+	if (fThreadCount == 0) {
+		_CheckNode(node);
+		node.done = true;
+		return B_OK;
+	}
+
+	release_sem(fWorkSem);
+	return B_OK;
+}
+
+
+/*!	Checks the blocks, and the B+tree of the node. This is called by the
+	check threads, and must not change anything on disk.
+*/
+void
+CheckVisitor::_CheckNode(check_node& node)
+{
+	Inode* inode = node.inode;
+
+	node.status = _CheckInodeBlocks(node.control, inode);
+	if (node.status != B_OK)
+		return;
+
+	// Check the B+tree as well
+	if (inode->IsContainer()) {
+		bool repairErrors = (node.control.flags & BFS_FIX_BPLUSTREES) != 0;
+		bool errorsFound = false;
+
+		node.control.status = inode->Tree()->Validate(repairErrors,
+			errorsFound);
+
+		if (errorsFound) {
+			node.control.errors |= BFS_INVALID_BPLUSTREE;
+
+			// We completely rebuild corrupt indices
+			node.rebuildIndex = inode->IsIndex() && node.inTree
+				&& repairErrors;
+		}
+	}
+}
+
+
+void
+CheckVisitor::_WaitForNode(check_node& node)
+{
+	if (fThreadCount == 0)
+		return;
+
+	while (true) {
+		mutex_lock(&fLock);
+		bool done = node.done;
+		mutex_unlock(&fLock);
+
+		if (done)
+			return;
+
+		acquire_sem(fDoneSem);
+	}
+}
+
+
+/*!	Waits until the check threads have checked all nodes that were handed
+	to them; they must be idle while the file system is being changed.
+*/
+void
+CheckVisitor::_WaitForThreads()
+{
+	for (uint32 i = fReported; i != fSubmitted; i++)
+		_WaitForNode(fNodes[i % kMaxQueuedNodes]);
+}
+
+
+/*!	Puts the results of \a node into the check_control, and releases its
+	inode.
+*/
+status_t
+CheckVisitor::_ReportNode(check_node& node)
+{
+	check_control& control = node.control;
+	strlcpy(Control().name, control.name, B_FILE_NAME_LENGTH);
+	Control().inode = control.inode;
+	Control().mode = control.mode;
+	Control().errors = control.errors;
+	Control().status = control.status;
+
+	Control().stats.missing += control.stats.missing;
+	Control().stats.already_set += control.stats.already_set;
+	Control().stats.direct_block_runs += control.stats.direct_block_runs;
+	Control().stats.indirect_block_runs += control.stats.indirect_block_runs;
+	Control().stats.indirect_array_blocks
+		+= control.stats.indirect_array_blocks;
+	Control().stats.double_indirect_block_runs
+		+= control.stats.double_indirect_block_runs;
+	Control().stats.double_indirect_array_blocks
+		+= control.stats.double_indirect_array_blocks;
+	Control().stats.blocks_in_direct += control.stats.blocks_in_direct;
+	Control().stats.blocks_in_indirect += control.stats.blocks_in_indirect;
+	Control().stats.blocks_in_double_indirect
+		+= control.stats.blocks_in_double_indirect;
+
+	status_t status = node.status;
+
+	if (status == B_OK && node.rebuildIndex) {
+		check_index* index = new(std::nothrow) check_index;
+		if (index != NULL) {
+			strlcpy(index->name, control.name, sizeof(index->name));
+			index->run = node.inode->BlockRun();
+			Indices().Push(index);
+		} else
+			status = B_NO_MEMORY;
+	}
+
+	put_vnode(GetVolume()->FSVolume(), node.inode->ID());
+	return status;
+}
+
+
 status_t
 CheckVisitor::_PrepareIndices()
 {
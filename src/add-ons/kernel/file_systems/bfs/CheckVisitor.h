@@ -1,5 +1,5 @@
 /*
- * Copyright 2002-2012, Axel Dörfler, axeld@pinc-software.de.
+ * Copyright 2002-2026, Axel Dörfler, axeld@pinc-software.de.
  * Copyright 2012, Andreas Henriksson, sausageboy@gmail.com
  * This file may be used under the terms of the MIT License.
  */
@@ -17,6 +17,7 @@
 class BlockAllocator;
 class BPlusTree;
 struct check_index;
+struct check_node;
 
 typedef Stack<check_index*> IndexStack;
 
@@ -31,6 +32,7 @@ public:
 			uint32				Pass() { return control.pass; }
 
 			status_t			StartBitmapPass();
+			status_t			CheckNextNode();
 			status_t			WriteBackCheckBitmap();
 			status_t			StartIndexPass();
 			status_t			StopChecking();
@@ -46,6 +48,9 @@ public:
 	virtual status_t			TreeIterationFailed(status_t reason,
 									Inode* parent);
 
+	static	const int32			kMaxThreads = 4;
+	static	const uint32		kMaxQueuedNodes = 64;
+
 private:
 			status_t			_RemoveInvalidNode(Inode* parent,
 									BPlusTree* tree, Inode* inode,
@@ -53,11 +58,20 @@ private:
 
 			bool				_ControlValid();
 			bool				_CheckBitmapIsUsedAt(off_t block) const;
-			void				_SetCheckBitmapAt(off_t block);
-			status_t			_CheckInodeBlocks(Inode* inode,
-									const char* name);
-			status_t			_CheckAllocated(block_run run,
-									const char* type);
+			bool				_SetCheckBitmapAt(off_t block);
+			status_t			_CheckInodeBlocks(check_control& control,
+									Inode* inode);
+			status_t			_CheckAllocated(check_control& control,
+									block_run run, const char* type);
+
+			void				_StartThreads();
+			void				_StopThreads();
+	static	status_t			_CheckThread(void* _visitor);
+			status_t			_SubmitNode(Inode* inode, bool inTree);
+			void				_CheckNode(check_node& node);
+			void				_WaitForNode(check_node& node);
+			void				_WaitForThreads();
+			status_t			_ReportNode(check_node& node);
 
 			size_t				_BitmapSize() const;
 
@@ -70,6 +84,19 @@ private:
 			IndexStack			indices;
 
 			uint32*				fCheckBitmap;
+
+			// the nodes of the bitmap pass are checked by a number of
+			// threads; they are reported in the order they were visited
+			mutex				fLock;
+			sem_id				fWorkSem;
+			sem_id				fDoneSem;
+			thread_id			fThreads[kMaxThreads];
+			int32				fThreadCount;
+			check_node*			fNodes;
+			uint32				fSubmitted;
+			uint32				fProcessed;
+			uint32				fReported;
+			status_t			fTraversalStatus;
 };
 
 
@@ -202,12 +202,13 @@ dump_bplustree_node(const bplustree_node* node, const bplustree_header* header,
 	kprintf("  right_link     = %" B_PRId64 "\n", node->right_link);
 	kprintf("  overflow_link  = %" B_PRId64 "\n", node->overflow_link);
 	kprintf("  all_key_count  = %u\n", node->all_key_count);
-	kprintf("  all_key_length = %u\n", node->all_key_length);
+	kprintf("  all_key_length = %u%s\n", node->AllKeyLength(),
+		node->HasPrefixKeys() ? " (prefix keys)" : "");
 
 	if (header == NULL)
 		return;
 
-	if (node->all_key_count > node->all_key_length
+	if (node->all_key_count > node->AllKeyLength()
 		|| uint32(node->all_key_count * 10) > (uint32)header->node_size
 		|| node->all_key_count == 0) {
 		kprintf("\n");
@@ -217,9 +218,11 @@ dump_bplustree_node(const bplustree_node* node, const bplustree_header* header,
 
 	kprintf("\n");
 	for (int32 i = 0;i < node->all_key_count;i++) {
-		uint16 length;
-		char buffer[256], *key = (char *)node->KeyAt(i, &length);
-		if (length > 255 || length == 0) {
+		uint16 length = 0;
+		char buffer[BPLUSTREE_MAX_KEY_LENGTH + 1];
+		const uint8* key = node->GetKey(i, (uint8*)buffer, &length,
+			header->node_size);
+		if (key == NULL || length > 255 || length == 0) {
 			kprintf("  %2d. Invalid length (%u)!!\n", (int)i, length);
 			dump_block((char *)node, header->node_size/*, sizeof(off_t)*/);
 			break;
@@ -0,0 +1,439 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * This file may be used under the terms of the MIT License.
+ */
+
+
+//! Moving fragmented data streams into contiguous runs
+
+
+#include "Defragmenter.h"
+
+#include "BlockAllocator.h"
+#include "Debug.h"
+#include "Inode.h"
+#include "Volume.h"
+
+
+/*!	Returns whether the node has any blocks that could be moved; small
+	files and symbolic links keep their data in the inode.
+*/
+static bool
+has_data_stream(Inode* inode)
+{
+	return inode->Size() > 0 && !inode->HasInlineData()
+		&& (!inode->IsSymLink() || inode->IsLongSymLink())
+		&& !inode->IsDeleted();
+}
+
+
+/*!	Returns the number of contiguous extents of \a runs. */
+static uint32
+count_extents(Volume* volume, const block_run* runs, int32 count)
+{
+	uint32 extents = 0;
+	off_t end = -1;
+
+	for (int32 i = 0; i < count; i++) {
+		if (volume->ToBlock(runs[i]) != end)
+			extents++;
+		end = volume->ToBlock(runs[i]) + runs[i].Length();
+	}
+
+	return extents;
+}
+
+
+//	#pragma mark -
+
+
+Defragmenter::Defragmenter(Volume* volume)
+	:
+	FileSystemVisitor(volume),
+	fControl(NULL),
+	fUserControl(NULL),
+	fBuffer(NULL),
+	fStart(0)
+{
+}
+
+
+Defragmenter::~Defragmenter()
+{
+	free(fBuffer);
+}
+
+
+/*!	Moves the fragmented data streams of all files, attributes, directories,
+	and indices, and fills in the statistics of \a control. If
+	\a userControl is not \c NULL, the statistics are copied there after
+	each node that has been moved.
+	Unlike the index rebuild, this does not keep the volume locked during
+	the whole run: every node is moved in its own transaction.
+*/
+status_t
+Defragmenter::Defragment(defragment_control& control,
+	defragment_control* userControl)
+{
+	fStart = system_time();
+
+	if (control.load == 0 || control.load > 100)
+		control.load = kDefaultLoad;
+
+	control.nodes = 0;
+	control.fragmented_nodes = 0;
+	control.moved_nodes = 0;
+	control.moved_blocks = 0;
+	control.fragments_before = 0;
+	control.fragments_after = 0;
+
+	if (fBuffer == NULL) {
+		fBuffer = (uint8*)malloc(kBufferSize);
+		if (fBuffer == NULL)
+			return B_NO_MEMORY;
+	}
+
+	fControl = &control;
+	fUserControl = userControl;
+
+	Start(VISIT_REGULAR | VISIT_INDICES | VISIT_ATTRIBUTE_DIRECTORIES);
+
+	status_t status;
+	while ((status = Next()) == B_OK) {
+	}
+
+	Stop();
+	fControl = NULL;
+	fUserControl = NULL;
+
+	control.time = system_time() - fStart;
+
+	if (status != B_ENTRY_NOT_FOUND)
+		RETURN_ERROR(status);
+
+	INFORM(("defragmented %" B_PRIu64 " of %" B_PRIu64 " fragmented nodes, "
+		"%" B_PRIu64 " blocks moved, %" B_PRIu64 " extents before, %"
+		B_PRIu64 " after\n", control.moved_nodes, control.fragmented_nodes,
+		control.moved_blocks, control.fragments_before,
+		control.fragments_after));
+	return B_OK;
+}
+
+
+status_t
+Defragmenter::VisitInode(Inode* inode, const char* treeName)
+{
+	uint32 fragments;
+
+	{
+		InodeReadLocker locker(inode);
+
+		// nodes whose stream cannot be read are left to "checkfs"
+		if (!has_data_stream(inode)
+			|| _CountFragments(inode, fragments) != B_OK)
+			return B_OK;
+	}
+
+	fControl->nodes++;
+	fControl->fragments_before += fragments;
+
+	if (fragments <= 1) {
+		fControl->fragments_after += fragments;
+		return B_OK;
+	}
+
+	fControl->fragmented_nodes++;
+
+	bigtime_t start = system_time();
+	uint64 moved = fControl->moved_nodes;
+
+	status_t status = _Move(inode, fragments);
+	if (status != B_OK)
+		return status;
+
+	fControl->fragments_after += fragments;
+
+	if (fControl->moved_nodes == moved)
+		return B_OK;
+
+	if (fUserControl != NULL) {
+		fControl->time = system_time() - fStart;
+		if (user_memcpy(fUserControl, fControl, sizeof(defragment_control))
+				!= B_OK)
+			return B_BAD_ADDRESS;
+	}
+
+	_Throttle(system_time() - start);
+	return B_OK;
+}
+
+
+/*!	Counts the contiguous extents of the data stream of \a inode; the
+	inode must be locked.
+*/
+status_t
+Defragmenter::_CountFragments(Inode* inode, uint32& _fragments)
+{
+	Volume* volume = GetVolume();
+	off_t size = inode->Size();
+	off_t end = -1;
+	uint32 fragments = 0;
+
+	for (off_t pos = 0; pos < size;) {
+		block_run run;
+		off_t offset;
+		status_t status = inode->FindBlockRun(pos, run, offset);
+		if (status != B_OK)
+			return status;
+		if (run.Length() == 0)
+			RETURN_ERROR(B_BAD_DATA);
+
+		if (volume->ToBlock(run) != end)
+			fragments++;
+
+		end = volume->ToBlock(run) + run.Length();
+		pos = offset + ((off_t)run.Length() << volume->BlockShift());
+	}
+
+	_fragments = fragments;
+	return B_OK;
+}
+
+
+/*!	Moves the data stream of \a inode into fewer runs than the
+	\a _fragments extents it consists of, and sets \a _fragments to the
+	new number of extents. If there is no room for a better layout, the
+	stream is left alone, and B_OK is returned.
+*/
+status_t
+Defragmenter::_Move(Inode* inode, uint32& _fragments)
+{
+	Volume* volume = GetVolume();
+
+	Transaction transaction(volume, inode->BlockNumber());
+	inode->WriteLockInTransaction(transaction);
+
+	// the stream may have changed until we got the lock
+	uint32 fragments;
+	if (!has_data_stream(inode)
+		|| _CountFragments(inode, fragments) != B_OK)
+		return B_OK;
+
+	_fragments = fragments;
+	if (fragments <= 1)
+		return B_OK;
+
+	off_t blocks = (inode->Size() + volume->BlockSize() - 1)
+		>> volume->BlockShift();
+
+	// B+tree nodes are written to the log, and must fit into it; the
+	// blocks reserved for delayed allocations must not be used either
+	if ((inode->IsContainer() && blocks > volume->Log().Length() / 4)
+		|| blocks > volume->FreeBlocks())
+		return B_OK;
+
+	block_run runs[NUM_DIRECT_BLOCKS];
+	int32 count;
+	status_t status = _AllocateRuns(transaction, inode, blocks,
+		min_c((int32)fragments - 1, NUM_DIRECT_BLOCKS), runs, count);
+	if (status == B_DEVICE_FULL) {
+		// there is no better place for the stream right now; the runs
+		// have been freed again
+		return transaction.Done();
+	}
+	if (status != B_OK)
+		RETURN_ERROR(status);
+
+	status = _CopyStream(transaction, inode, runs, count);
+	if (status == B_OK && !inode->IsContainer()) {
+		// the data written directly must be on disk before the log
+		// refers to it
+		status = volume->FlushDevice();
+	}
+	if (status != B_OK) {
+		_FreeRuns(transaction, runs, count);
+		RETURN_ERROR(status);
+	}
+
+	data_stream oldStream;
+	status = inode->MoveStream(transaction, runs, count, oldStream);
+	if (status == B_OK)
+		status = transaction.Done();
+	if (status != B_OK)
+		RETURN_ERROR(status);
+
+	// The old blocks may only be reused once the log says that the stream
+	// has moved: data written to them directly would end up in the file
+	// otherwise, if we crashed before. If we crash in between, they are
+	// just lost until the volume is checked.
+	status = volume->GetJournal(0)->FlushLog();
+	if (status == B_OK)
+		status = transaction.Start(volume, inode->BlockNumber());
+	if (status == B_OK)
+		status = inode->FreeStream(transaction, oldStream);
+	if (status == B_OK)
+		status = transaction.Done();
+	if (status != B_OK)
+		RETURN_ERROR(status);
+
+	_fragments = count_extents(volume, runs, count);
+	fControl->moved_nodes++;
+	fControl->moved_blocks += blocks;
+	return B_OK;
+}
+
+
+/*!	Allocates \a blocks blocks in at most \a maxRuns runs, each as large as
+	possible. Returns \c B_DEVICE_FULL if that is not possible; the runs
+	allocated so far are freed again on failure.
+*/
+status_t
+Defragmenter::_AllocateRuns(Transaction& transaction, Inode* inode,
+	off_t blocks, int32 maxRuns, block_run* runs, int32& _count)
+{
+	BlockAllocator& allocator = GetVolume()->Allocator();
+
+	// like for a new stream, directories stay close to their inode, and
+	// the data of files starts in the next allocation group
+	int32 group = inode->BlockRun().AllocationGroup();
+	uint16 start = 0;
+	if (inode->IsContainer())
+		start = inode->BlockRun().Start();
+	else
+		group++;
+
+	int32 count = 0;
+	while (blocks > 0) {
+		status_t status = B_DEVICE_FULL;
+		if (count < maxRuns) {
+			status = allocator.AllocateBlocks(transaction, group, start,
+				min_c(blocks, (off_t)MAX_BLOCK_RUN_LENGTH), 1, runs[count]);
+		}
+		if (status != B_OK) {
+			_FreeRuns(transaction, runs, count);
+			return status;
+		}
+
+		block_run& run = runs[count++];
+		blocks -= run.Length();
+		group = run.AllocationGroup();
+		start = run.Start() + run.Length();
+	}
+
+	_count = count;
+	return B_OK;
+}
+
+
+void
+Defragmenter::_FreeRuns(Transaction& transaction, const block_run* runs,
+	int32 count)
+{
+	for (int32 i = 0; i < count; i++)
+		GetVolume()->Free(transaction, runs[i]);
+}
+
+
+/*!	Copies the blocks of the data stream of \a inode to \a runs. */
+status_t
+Defragmenter::_CopyStream(Transaction& transaction, Inode* inode,
+	const block_run* runs, int32 count)
+{
+	Volume* volume = GetVolume();
+	uint32 blockShift = volume->BlockShift();
+	off_t blocks = (inode->Size() + volume->BlockSize() - 1) >> blockShift;
+	bool logged = inode->IsContainer();
+
+	int32 index = 0;
+	uint32 runOffset = 0;
+
+	for (off_t block = 0; block < blocks;) {
+		block_run run;
+		off_t offset;
+		status_t status = inode->FindBlockRun(block << blockShift, run,
+			offset);
+		if (status != B_OK)
+			return status;
+
+		uint32 skip = block - (offset >> blockShift);
+		off_t length = min_c((off_t)run.Length() - skip, blocks - block);
+		length = min_c(length, (off_t)runs[index].Length() - runOffset);
+
+		status = _CopyBlocks(transaction, logged, volume->ToBlock(run) + skip,
+			volume->ToBlock(runs[index]) + runOffset, length);
+		if (status != B_OK)
+			return status;
+
+		block += length;
+		runOffset += length;
+		if (runOffset == runs[index].Length() && index < count - 1) {
+			index++;
+			runOffset = 0;
+		}
+	}
+
+	return B_OK;
+}
+
+
+status_t
+Defragmenter::_CopyBlocks(Transaction& transaction, bool logged, off_t from,
+	off_t to, uint32 count)
+{
+	Volume* volume = GetVolume();
+
+	if (logged) {
+		for (uint32 i = 0; i < count; i++) {
+			CachedBlock source(volume);
+			CachedBlock target(volume);
+
+			status_t status = source.SetTo(from + i);
+			if (status == B_OK)
+				status = target.SetToWritable(transaction, to + i, true);
+			if (status != B_OK)
+				return status;
+
+			memcpy(target.WritableBlock(), source.Block(),
+				volume->BlockSize());
+		}
+		return B_OK;
+	}
+
+	uint32 bufferBlocks = kBufferSize >> volume->BlockShift();
+
+	while (count > 0) {
+		uint32 chunk = min_c(count, bufferBlocks);
+		size_t bytes = (size_t)chunk << volume->BlockShift();
+
+		ssize_t bytesRead = read_pos(volume->Device(),
+			from << volume->BlockShift(), fBuffer, bytes);
+		if (bytesRead != (ssize_t)bytes)
+			RETURN_ERROR(bytesRead < 0 ? bytesRead : B_IO_ERROR);
+
+		ssize_t written = write_pos(volume->Device(),
+			to << volume->BlockShift(), fBuffer, bytes);
+		if (written != (ssize_t)bytes)
+			RETURN_ERROR(written < 0 ? written : B_IO_ERROR);
+
+		from += chunk;
+		to += chunk;
+		count -= chunk;
+	}
+
+	return B_OK;
+}
+
+
+/*!	Pauses after a node has been moved, so that moving it took no more
+	than the requested share of the time: while the transaction is
+	running, the inode as well as all other changes to the volume have to
+	wait.
+*/
+void
+Defragmenter::_Throttle(bigtime_t busy)
+{
+	if (fControl->load >= 100)
+		return;
+
+	snooze(busy * (100 - fControl->load) / fControl->load);
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * This file may be used under the terms of the MIT License.
+ */
+#ifndef DEFRAGMENTER_H
+#define DEFRAGMENTER_H
+
+
+#include "system_dependencies.h"
+
+#include "bfs_control.h"
+#include "FileSystemVisitor.h"
+
+
+class Transaction;
+
+
+/*!	Visits all nodes of the volume, and moves the data streams that consist
+	of more than one contiguous extent into fewer, larger runs. The data of
+	files and attributes is copied directly on the device, the nodes of
+	B+trees are copied through the block cache in the transaction that
+	moves them.
+*/
+class Defragmenter : public FileSystemVisitor {
+public:
+								Defragmenter(Volume* volume);
+	virtual						~Defragmenter();
+
+			status_t			Defragment(defragment_control& control,
+									defragment_control* userControl);
+
+	virtual status_t			VisitInode(Inode* inode, const char* treeName);
+
+	static	const uint32		kDefaultLoad = 50;
+	static	const size_t		kBufferSize = 256 * 1024;
+
+private:
+			status_t			_CountFragments(Inode* inode,
+									uint32& _fragments);
+			status_t			_Move(Inode* inode, uint32& _fragments);
+			status_t			_AllocateRuns(Transaction& transaction,
+									Inode* inode, off_t blocks,
+									int32 maxRuns, block_run* runs,
+									int32& _count);
+			void				_FreeRuns(Transaction& transaction,
+									const block_run* runs, int32 count);
+			status_t			_CopyStream(Transaction& transaction,
+									Inode* inode, const block_run* runs,
+									int32 count);
+			status_t			_CopyBlocks(Transaction& transaction,
+									bool logged, off_t from, off_t to,
+									uint32 count);
+			void				_Throttle(bigtime_t busy);
+
+private:
+			defragment_control*	fControl;
+			defragment_control*	fUserControl;
+				// receives the statistics after each node moved
+			uint8*				fBuffer;
+			bigtime_t			fStart;
+};
+
+
+#endif	// DEFRAGMENTER_H
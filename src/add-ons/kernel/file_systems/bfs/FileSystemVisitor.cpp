@@ -1,5 +1,5 @@
 /*
- * Copyright 2002-2012, Axel Dörfler, axeld@pinc-software.de.
+ * Copyright 2002-2026, Axel Dörfler, axeld@pinc-software.de.
  * Copyright 2012, Andreas Henriksson, sausageboy@gmail.com
  * This file may be used under the terms of the MIT License.
  */
@@ -16,10 +16,15 @@
 #include "Volume.h"
 
 
+// number of directory entries whose inodes are read ahead
+static const int32 kPrefetchInodes = 32;
+
+
 FileSystemVisitor::FileSystemVisitor(Volume* volume)
 	:
 	fVolume(volume),
-	fIterator(NULL)
+	fIterator(NULL),
+	fPrefetchIterator(NULL)
 {
 }
 
@@ -96,6 +101,11 @@ FileSystemVisitor::Next()
 				// the inode must stay locked in memory until the iterator
 				// is freed
 				vnode.Keep();
+
+				// this one is optional
+				fPrefetchIterator = new(std::nothrow) TreeIterator(tree);
+				for (int32 i = 0; i < kPrefetchInodes; i++)
+					_PrefetchNextInode();
 			}
 		} else {
 			uint16 length;
@@ -107,6 +117,8 @@ FileSystemVisitor::Next()
 				// we no longer need this iterator
 				delete fIterator;
 				fIterator = NULL;
+				delete fPrefetchIterator;
+				fPrefetchIterator = NULL;
 
 				// unlock the directory's inode from memory
 				put_vnode(fVolume->FSVolume(),
@@ -126,6 +138,8 @@ FileSystemVisitor::Next()
 				return status;
 			}
 
+			_PrefetchNextInode();
+
 			// ignore "." and ".." entries
 			if (!strcmp(treeName, ".") || !strcmp(treeName, ".."))
 				continue;
@@ -238,6 +252,8 @@ FileSystemVisitor::Stop()
 	if (fIterator != NULL) {
 		delete fIterator;
 		fIterator = NULL;
+		delete fPrefetchIterator;
+		fPrefetchIterator = NULL;
 
 		// the current directory inode is still locked in memory
 		put_vnode(fVolume->FSVolume(), fVolume->ToVnode(fCurrent));
@@ -250,6 +266,31 @@ FileSystemVisitor::Stop()
 }
 
 
+/*!	Starts reading the inode of the directory entry that is
+	\c kPrefetchInodes entries ahead of the current one, so that it is
+	likely in the block cache once it is visited.
+*/
+void
+FileSystemVisitor::_PrefetchNextInode()
+{
+	if (fPrefetchIterator == NULL)
+		return;
+
+	char name[B_FILE_NAME_LENGTH];
+	uint16 length;
+	ino_t id;
+	if (fPrefetchIterator->GetNextEntry(name, &length, B_FILE_NAME_LENGTH,
+			&id) != B_OK) {
+		delete fPrefetchIterator;
+		fPrefetchIterator = NULL;
+		return;
+	}
+
+	CachedBlock cached(fVolume);
+	cached.Prefetch(id, 1);
+}
+
+
 //	#pragma mark - overrideable actions
 
 
@@ -1,5 +1,5 @@
 /*
- * Copyright 2002-2012, Axel Dörfler, axeld@pinc-software.de.
+ * Copyright 2002-2026, Axel Dörfler, axeld@pinc-software.de.
  * Copyright 2012, Andreas Henriksson, sausageboy@gmail.com
  * This file may be used under the terms of the MIT License.
  */
@@ -49,6 +49,9 @@ public:
 	virtual status_t			TreeIterationFailed(status_t reason,
 									Inode* parent);
 
+private:
+			void				_PrefetchNextInode();
+
 private:
 			Volume*				fVolume;
 
@@ -57,6 +60,8 @@ private:
 			Inode*				fParent;
 			Stack<block_run>	fStack;
 			TreeIterator*		fIterator;
+			TreeIterator*		fPrefetchIterator;
+				// runs ahead of fIterator to read the inodes in advance
 
 			uint32				fFlags;
 };
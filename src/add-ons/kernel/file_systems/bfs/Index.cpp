@@ -15,6 +15,7 @@
 #include "Volume.h"
 #include "Inode.h"
 #include "BPlusTree.h"
+#include "TrigramIndex.h"
 
 
 Index::Index(Volume* volume)
@@ -131,6 +132,16 @@ Index::Type()
 }
 
 
+/*!	Returns whether the index contains the keys of all files. An index that
+	is still being filled (see IndexBuilder) must not be used by queries.
+*/
+bool
+Index::IsComplete() const
+{
+	return fNode != NULL && (fNode->Flags() & INODE_INCOMPLETE_INDEX) == 0;
+}
+
+
 size_t
 Index::KeySize()
 {
@@ -205,8 +216,19 @@ Index::Create(Transaction& transaction, const char* name, uint32 type)
 	}
 
 	// Inode::Create() will keep the inode locked for us
-	return Inode::Create(transaction, fVolume->IndicesNode(), name,
+	status_t status = Inode::Create(transaction, fVolume->IndicesNode(), name,
 		S_INDEX_DIR | S_DIRECTORY | mode, 0, type, NULL, NULL, &fNode);
+	if (status == B_OK) {
+		// the inode might have belonged to an index that was removed before
+		fVolume->InvalidateIndexStatistics(fNode->ID());
+
+		// if the transaction fails, the count will be too high, which only
+		// costs some needless lookups
+		if (mode == S_STR_INDEX && is_trigram_index_name(name))
+			fVolume->AddTrigramIndex();
+	}
+
+	return status;
 }
 
 
@@ -245,6 +267,15 @@ Index::Update(Transaction& transaction, const char* name, int32 type,
 	// update all live queries about the change, if they have an index or not
 	fVolume->UpdateLiveQueries(inode, name, type, oldKey, oldLength,
 		newKey, newLength);
+	fVolume->UpdateIndexBuilders(inode, name, oldKey, oldLength, newKey,
+		newLength);
+
+	if (type == B_STRING_TYPE && fVolume->HasTrigramIndices()) {
+		status_t status = _UpdateTrigrams(transaction, name, oldKey,
+			oldLength, newKey, newLength, inode);
+		if (status != B_OK && status != B_BAD_INDEX)
+			RETURN_ERROR(status);
+	}
 
 	if (((name != fName || strcmp(name, fName)) && SetTo(name) != B_OK)
 		|| fNode == NULL)
@@ -266,6 +297,7 @@ Index::Update(Transaction& transaction, const char* name, int32 type,
 		if (status == B_ENTRY_NOT_FOUND) {
 			// That's not nice, but no reason to let the whole thing fail
 			INFORM(("Could not find value in index \"%s\"!\n", name));
+			oldKey = NULL;
 		} else if (status != B_OK)
 			return status;
 	}
@@ -275,12 +307,99 @@ Index::Update(Transaction& transaction, const char* name, int32 type,
 	if (newKey != NULL) {
 		status = tree->Insert(transaction, (const uint8*)newKey, newLength,
 			inode->ID());
+		if (status != B_OK)
+			newKey = NULL;
+	}
+
+	// The statistics are not reverted if the transaction fails; they are
+	// only estimates anyway.
+	if (oldKey != NULL || newKey != NULL) {
+		fVolume->UpdateIndexStatistics(*this, oldKey, oldLength, newKey,
+			newLength);
 	}
 
 	RETURN_ERROR(status);
 }
 
 
+/*!	Updates the trigram index of the attribute, if there is one: only the
+	trigrams that are not part of both keys are removed from, or inserted
+	into it. Returns B_BAD_INDEX if the attribute has no trigram index.
+*/
+status_t
+Index::_UpdateTrigrams(Transaction& transaction, const char* name,
+	const uint8* oldKey, uint16 oldLength, const uint8* newKey,
+	uint16 newLength, Inode* inode)
+{
+	char indexName[B_FILE_NAME_LENGTH];
+	if (is_trigram_index_name(name)
+		|| !get_trigram_index_name(name, indexName))
+		return B_BAD_INDEX;
+
+	Index index(fVolume);
+	if (index.SetTo(indexName) != B_OK || index.Type() != B_STRING_TYPE)
+		return B_BAD_INDEX;
+
+	BPlusTree* tree = index.Node()->Tree();
+	if (tree == NULL)
+		return B_BAD_VALUE;
+
+	uint32* oldTrigrams = (uint32*)malloc(2 * MAX_TRIGRAMS * sizeof(uint32));
+	if (oldTrigrams == NULL)
+		return B_NO_MEMORY;
+	MemoryDeleter deleter(oldTrigrams);
+	uint32* newTrigrams = oldTrigrams + MAX_TRIGRAMS;
+
+	int32 oldCount = oldKey != NULL
+		? collect_trigrams(oldKey, oldLength, oldTrigrams) : 0;
+	int32 newCount = newKey != NULL
+		? collect_trigrams(newKey, newLength, newTrigrams) : 0;
+
+	index.Node()->WriteLockInTransaction(transaction);
+
+	// both lists are sorted, so they can be merged
+	int32 oldIndex = 0;
+	int32 newIndex = 0;
+	while (oldIndex < oldCount || newIndex < newCount) {
+		uint8 key[TRIGRAM_LENGTH];
+		status_t status;
+
+		if (newIndex == newCount || (oldIndex < oldCount
+				&& oldTrigrams[oldIndex] < newTrigrams[newIndex])) {
+			get_trigram_key(oldTrigrams[oldIndex++], key);
+			status = tree->Remove(transaction, key, TRIGRAM_LENGTH,
+				inode->ID());
+			if (status == B_ENTRY_NOT_FOUND) {
+				// the file might have been there before the index
+				continue;
+			}
+			if (status == B_OK) {
+				fVolume->UpdateIndexStatistics(index, key, TRIGRAM_LENGTH,
+					NULL, 0);
+			}
+		} else if (oldIndex == oldCount
+			|| newTrigrams[newIndex] < oldTrigrams[oldIndex]) {
+			get_trigram_key(newTrigrams[newIndex++], key);
+			status = tree->Insert(transaction, key, TRIGRAM_LENGTH,
+				inode->ID());
+			if (status == B_OK) {
+				fVolume->UpdateIndexStatistics(index, NULL, 0, key,
+					TRIGRAM_LENGTH);
+			}
+		} else {
+			// the trigram is part of both keys
+			oldIndex++;
+			newIndex++;
+			continue;
+		}
+
+		if (status != B_OK)
+			RETURN_ERROR(status);
+	}
+
+	return B_OK;
+}
+
 status_t
 Index::InsertName(Transaction& transaction, const char* name, Inode* inode)
 {
@@ -25,6 +25,7 @@ public:
 			Inode*			Node() const { return fNode; };
 			uint32			Type();
 			size_t			KeySize();
+			bool			IsComplete() const;
 
 			status_t		Create(Transaction& transaction, const char* name,
 								uint32 type);
@@ -58,6 +59,11 @@ private:
 							Index& operator=(const Index& other);
 								// no implementation
 
+			status_t		_UpdateTrigrams(Transaction& transaction,
+								const char* name, const uint8* oldKey,
+								uint16 oldLength, const uint8* newKey,
+								uint16 newLength, Inode* inode);
+
 private:
 			Volume*			fVolume;
 			Inode*			fNode;
@@ -0,0 +1,834 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * This file may be used under the terms of the MIT License.
+ */
+
+
+//! Rebuilding indices by bulk-loading their B+trees
+
+
+#include "IndexBuilder.h"
+
+#include "BPlusTree.h"
+#include "BPlusTreeLoader.h"
+#include "Debug.h"
+#include "Index.h"
+#include "Inode.h"
+#include "Journal.h"
+#include "TrigramIndex.h"
+#include "Volume.h"
+
+
+#define REBUILD_INDEX_PREFIX	".rebuild "
+
+
+/*!	The changes an IndexBuilder records are stored like this, aligned to an
+	off_t boundary.
+*/
+struct index_change {
+	ino_t		id;
+	uint16		length;
+	uint8		key[0];
+};
+
+
+static inline size_t
+change_size(uint16 length)
+{
+	return key_align(offsetof(index_change, key) + length);
+}
+
+
+/*!	Writes the nodes of the new B+tree into the stream of its index: the
+	blocks at the start of the stream have already been changed in the
+	transaction, and are written through it, too. All other blocks have
+	just been allocated, and nothing else refers to them until the
+	transaction is done, so they are written directly.
+*/
+class IndexLoader : public BPlusTreeLoader {
+public:
+	IndexLoader(Transaction& transaction, Inode* inode, type_code type)
+		:
+		BPlusTreeLoader(inode->Tree()->NodeSize(),
+			inode->GetVolume()->BlockSize(), type),
+		fTransaction(transaction),
+		fInode(inode)
+	{
+	}
+
+	virtual status_t WriteNodes(off_t offset, const uint8* buffer,
+		size_t size)
+	{
+		Volume* volume = fInode->GetVolume();
+		BPlusTree* tree = fInode->Tree();
+
+		while (size > 0) {
+			if (offset < HeaderSize()) {
+				CachedNode cached(tree);
+				bplustree_node* node = cached.SetToWritable(fTransaction,
+					offset, false);
+				if (node == NULL)
+					RETURN_ERROR(B_IO_ERROR);
+
+				memcpy(node, buffer, tree->NodeSize());
+				offset += tree->NodeSize();
+				buffer += tree->NodeSize();
+				size -= tree->NodeSize();
+				continue;
+			}
+
+			block_run run;
+			off_t fileOffset;
+			status_t status = fInode->FindBlockRun(offset, run, fileOffset);
+			if (status != B_OK)
+				RETURN_ERROR(status);
+
+			off_t runOffset = offset - fileOffset;
+			size_t length = min_c((off_t)size,
+				((off_t)run.Length() << volume->BlockShift()) - runOffset);
+
+			ssize_t written = write_pos(volume->Device(),
+				volume->ToOffset(run) + runOffset, buffer, length);
+			if (written != (ssize_t)length)
+				RETURN_ERROR(written < 0 ? written : B_IO_ERROR);
+
+			offset += length;
+			buffer += length;
+			size -= length;
+		}
+
+		return B_OK;
+	}
+
+private:
+	Transaction&	fTransaction;
+	Inode*			fInode;
+};
+
+
+/*!	A KeySorter that keeps the runs that don't fit into memory in blocks of
+	the volume. The blocks are allocated as they are needed, and written and
+	read directly; they are not part of any file, and are freed again when
+	the sorter is deleted. Only checkfs will find them after a crash.
+*/
+class IndexKeySorter : public KeySorter {
+public:
+	IndexKeySorter(Volume* volume, type_code type)
+		:
+		KeySorter(type, IndexBuilder::kMaxMemory),
+		fVolume(volume),
+		fRuns(NULL),
+		fCount(0),
+		fAllocated(0),
+		fSize(0)
+	{
+	}
+
+	virtual ~IndexKeySorter()
+	{
+		if (fCount > 0) {
+			Transaction transaction(fVolume, fRuns[0]);
+			for (int32 i = 0; i < fCount; i++)
+				fVolume->Allocator().Free(transaction, fRuns[i]);
+			transaction.Done();
+		}
+
+		free(fRuns);
+	}
+
+protected:
+	virtual status_t WriteStorage(off_t offset, const uint8* buffer,
+		size_t size)
+	{
+		while (offset + (off_t)size > fSize) {
+			status_t status = _Grow();
+			if (status != B_OK)
+				return status;
+		}
+
+		return _Access(offset, const_cast<uint8*>(buffer), size, true);
+	}
+
+	virtual status_t ReadStorage(off_t offset, uint8* buffer, size_t size)
+	{
+		if (offset + (off_t)size > fSize)
+			return B_BAD_VALUE;
+
+		return _Access(offset, buffer, size, false);
+	}
+
+private:
+	status_t _Grow()
+	{
+		if (fCount == fAllocated) {
+			int32 count = max_c(fAllocated * 2, 16);
+			block_run* runs = (block_run*)realloc(fRuns,
+				count * sizeof(block_run));
+			if (runs == NULL)
+				return B_NO_MEMORY;
+
+			fRuns = runs;
+			fAllocated = count;
+		}
+
+		// continue after the last run, if possible
+		block_run last = fCount > 0 ? fRuns[fCount - 1] : fVolume->Root();
+		uint16 blocks = min_c(kGrowSize >> fVolume->BlockShift(),
+			(size_t)MAX_BLOCK_RUN_LENGTH);
+
+		Transaction transaction(fVolume, last);
+
+		block_run& run = fRuns[fCount];
+		status_t status = fVolume->Allocator().AllocateBlocks(transaction,
+			last.AllocationGroup(), last.Start() + last.Length(), blocks, 1,
+			run);
+		if (status == B_OK)
+			status = transaction.Done();
+		if (status != B_OK)
+			return status;
+
+		fSize += (off_t)run.Length() << fVolume->BlockShift();
+		fCount++;
+		return B_OK;
+	}
+
+	status_t _Access(off_t offset, uint8* buffer, size_t size, bool write)
+	{
+		off_t runOffset = 0;
+		for (int32 i = 0; i < fCount && size > 0; i++) {
+			off_t runSize = (off_t)fRuns[i].Length() << fVolume->BlockShift();
+			if (offset >= runOffset + runSize) {
+				runOffset += runSize;
+				continue;
+			}
+
+			size_t length = min_c((off_t)size, runOffset + runSize - offset);
+			off_t position = fVolume->ToOffset(fRuns[i]) + offset - runOffset;
+			ssize_t bytes = write
+				? write_pos(fVolume->Device(), position, buffer, length)
+				: read_pos(fVolume->Device(), position, buffer, length);
+			if (bytes != (ssize_t)length)
+				RETURN_ERROR(bytes < 0 ? bytes : B_IO_ERROR);
+
+			offset += length;
+			buffer += length;
+			size -= length;
+			runOffset += runSize;
+		}
+
+		return size == 0 ? B_OK : B_BAD_VALUE;
+	}
+
+private:
+	static const size_t	kGrowSize = 16 * 1024 * 1024;
+
+	Volume*		fVolume;
+	block_run*	fRuns;
+	int32		fCount;
+	int32		fAllocated;
+	off_t		fSize;
+};
+
+
+//	#pragma mark -
+
+
+IndexBuilder::IndexBuilder(Volume* volume)
+	:
+	FileSystemVisitor(volume),
+	fTrigrams(false),
+	fTrigramBuffer(NULL),
+	fKeySize(0),
+	fSorter(NULL),
+	fEntries(0),
+	fLevels(0),
+	fChanges(NULL),
+	fChangesSize(0),
+	fChangesAllocated(0),
+	fChangesStatus(B_OK)
+{
+	fName[0] = '\0';
+	fTemporaryName[0] = '\0';
+	fAttribute[0] = '\0';
+}
+
+
+IndexBuilder::~IndexBuilder()
+{
+	free(fTrigramBuffer);
+	free(fChanges);
+}
+
+
+/*!	Rebuilds the index \a control.name, and fills in the statistics of
+	\a control. The old index stays in use until the new one is complete,
+	and replaces it.
+*/
+status_t
+IndexBuilder::Rebuild(rebuild_index_control& control)
+{
+	return _Build(control, false, 0);
+}
+
+
+/*!	Creates the index \a control.name of the given \a type, and fills it
+	with the keys of all files that already exist, before it becomes
+	visible under its name. Queries must never use an index that misses
+	some of the matching files.
+	Only indices without a fixed key size are supported.
+*/
+status_t
+IndexBuilder::Create(rebuild_index_control& control, uint32 type)
+{
+	if (type != B_STRING_TYPE)
+		RETURN_ERROR(B_BAD_TYPE);
+
+	return _Build(control, true, type);
+}
+
+
+/*!	Records a change of the attribute \a attribute of \a inode; it is called
+	by Index::Update() for every change of an attribute, as long as the
+	builder is known to the volume.
+	Both keys are recorded, as the keys that were collected for the inode
+	might be any of them.
+*/
+void
+IndexBuilder::Changed(Inode* inode, const char* attribute,
+	const uint8* oldKey, uint16 oldLength, const uint8* newKey,
+	uint16 newLength)
+{
+	if (strcmp(attribute, fAttribute))
+		return;
+
+	if (oldKey != NULL)
+		_RecordChange(inode->ID(), oldKey, oldLength);
+	if (newKey != NULL)
+		_RecordChange(inode->ID(), newKey, newLength);
+}
+
+
+status_t
+IndexBuilder::_Build(rebuild_index_control& control, bool create,
+	uint32 type)
+{
+	Volume* volume = GetVolume();
+	bigtime_t start = system_time();
+
+	control.name[B_FILE_NAME_LENGTH - 1] = '\0';
+	control.entries = 0;
+	control.nodes = 0;
+	control.levels = 0;
+
+	if (!create && volume->IndicesNode() == NULL)
+		return B_ENTRY_NOT_FOUND;
+	if (strlen(control.name) + strlen(REBUILD_INDEX_PREFIX)
+			>= B_FILE_NAME_LENGTH)
+		return B_NAME_TOO_LONG;
+
+	strlcpy(fName, control.name, sizeof(fName));
+	snprintf(fTemporaryName, sizeof(fTemporaryName), "%s%s",
+		REBUILD_INDEX_PREFIX, control.name);
+
+	{
+		Index index(volume);
+		status_t status = volume->IndicesNode() != NULL
+			? index.SetTo(control.name) : B_ENTRY_NOT_FOUND;
+		if (create) {
+			if (status == B_OK)
+				RETURN_ERROR(B_FILE_EXISTS);
+
+			// string indices don't have a fixed key size
+			fKeySize = 0;
+		} else {
+			if (status != B_OK)
+				RETURN_ERROR(status);
+
+			type = index.Type();
+			if (type == 0)
+				RETURN_ERROR(B_BAD_TYPE);
+			fKeySize = index.KeySize();
+		}
+	}
+
+	strlcpy(fAttribute, control.name, sizeof(fAttribute));
+	fTrigrams = type == B_STRING_TYPE && is_trigram_index_name(control.name);
+	if (fTrigrams) {
+		// the keys are the trigrams of the attribute that is indexed
+		fAttribute[strlen(fAttribute) - TRIGRAM_INDEX_SUFFIX_LENGTH] = '\0';
+
+		if (fTrigramBuffer == NULL) {
+			fTrigramBuffer = (uint32*)malloc(MAX_TRIGRAMS * sizeof(uint32));
+			if (fTrigramBuffer == NULL)
+				return B_NO_MEMORY;
+		}
+	}
+
+	// The changes to the attribute are recorded from now on. No transaction
+	// may be running when that starts, as it could still revert a change
+	// that the keys are collected from.
+	Journal* journal = volume->GetJournal(0);
+	journal->Lock(NULL, true);
+	status_t status = volume->AddIndexBuilder(this);
+	journal->Unlock(NULL, true);
+	if (status != B_OK)
+		RETURN_ERROR(status);
+
+	{
+		IndexKeySorter sorter(volume, type);
+		status = sorter.InitCheck();
+		if (status == B_OK)
+			status = _CollectKeys(sorter);
+		if (status == B_OK)
+			status = _LoadIndex(type, sorter);
+	}
+	if (status == B_OK) {
+		status = _ReplaceIndex(create, type, control);
+		if (status != B_OK)
+			_RemoveTemporaryIndex();
+	}
+
+	volume->RemoveIndexBuilder(this);
+
+	if (status == B_OK && fTrigrams && !create) {
+		// the new index has been counted when it was created
+		volume->RemoveTrigramIndex();
+	}
+
+	control.time = system_time() - start;
+	RETURN_ERROR(status);
+}
+
+
+status_t
+IndexBuilder::VisitInode(Inode* inode, const char* treeName)
+{
+	uint8 buffer[MAX_INDEX_KEY_LENGTH];
+	size_t length;
+	if (_GetKey(inode, treeName, buffer, length) != B_OK)
+		return B_OK;
+
+	int32 count = _SplitKeys(buffer, length);
+	for (int32 i = 0; i < count; i++) {
+		uint8 trigram[TRIGRAM_LENGTH];
+		uint16 keyLength;
+		const uint8* key = _KeyAt(i, buffer, length, trigram, keyLength);
+
+		status_t status = fSorter->Add(key, keyLength, inode->ID());
+		if (status != B_OK)
+			return status;
+	}
+
+	return B_OK;
+}
+
+
+status_t
+IndexBuilder::_CollectKeys(KeySorter& sorter)
+{
+	fSorter = &sorter;
+	Start(VISIT_REGULAR);
+
+	status_t status;
+	while ((status = Next()) == B_OK) {
+	}
+
+	Stop();
+	fSorter = NULL;
+
+	return status == B_ENTRY_NOT_FOUND ? B_OK : status;
+}
+
+
+/*!	Retrieves the value of the attribute of \a inode that is indexed.
+	Directories are only visited after their entries, so their name needs
+	to be read from the inode when there is no \a treeName.
+*/
+status_t
+IndexBuilder::_GetKey(Inode* inode, const char* treeName, uint8* buffer,
+	size_t& _length)
+{
+	// the root directory has no name in its parent
+	if (inode->BlockRun() == GetVolume()->Root())
+		return B_ENTRY_NOT_FOUND;
+
+	if (!strcmp(fAttribute, "name")) {
+		if (!inode->InNameIndex())
+			return B_ENTRY_NOT_FOUND;
+
+		if (treeName == NULL) {
+			status_t status = inode->GetName((char*)buffer,
+				MAX_INDEX_KEY_LENGTH);
+			if (status != B_OK)
+				return status;
+		} else
+			strlcpy((char*)buffer, treeName, MAX_INDEX_KEY_LENGTH);
+
+		_length = strlen((const char*)buffer);
+		return B_OK;
+	}
+
+	if (!strcmp(fAttribute, "size")) {
+		if (!inode->InSizeIndex())
+			return B_ENTRY_NOT_FOUND;
+
+		// Inode::OldSize() is the size that's in the index
+		off_t size = inode->OldSize();
+		memcpy(buffer, &size, sizeof(int64));
+		_length = sizeof(int64);
+		return B_OK;
+	}
+
+	if (!strcmp(fAttribute, "last_modified")) {
+		if (!inode->InLastModifiedIndex())
+			return B_ENTRY_NOT_FOUND;
+
+		off_t modified = inode->OldLastModified();
+		memcpy(buffer, &modified, sizeof(int64));
+		_length = sizeof(int64);
+		return B_OK;
+	}
+
+	_length = MAX_INDEX_KEY_LENGTH;
+	return inode->ReadAttribute(fAttribute, 0, 0, buffer, &_length);
+}
+
+
+/*!	Returns how many keys the index has for the attribute \a value: the
+	trigrams of the value for a trigram index, or the value itself.
+*/
+int32
+IndexBuilder::_SplitKeys(const uint8* value, size_t length)
+{
+	if (length > MAX_INDEX_KEY_LENGTH)
+		length = MAX_INDEX_KEY_LENGTH;
+
+	if (fTrigrams)
+		return collect_trigrams(value, length, fTrigramBuffer);
+
+	// Index::Update() would take any key, but the comparisons of
+	// the B+tree rely on the size of the type
+	if (length == 0 || (fKeySize != 0 && length != fKeySize))
+		return 0;
+
+	return 1;
+}
+
+
+//!	Returns the key \a index of the keys _SplitKeys() found in \a value.
+const uint8*
+IndexBuilder::_KeyAt(int32 index, const uint8* value, size_t length,
+	uint8* buffer, uint16& _keyLength)
+{
+	if (!fTrigrams) {
+		_keyLength = min_c(length, MAX_INDEX_KEY_LENGTH);
+		return value;
+	}
+
+	get_trigram_key(fTrigramBuffer[index], buffer);
+	_keyLength = TRIGRAM_LENGTH;
+	return buffer;
+}
+
+
+void
+IndexBuilder::_RecordChange(ino_t id, const uint8* key, uint16 length)
+{
+	if (fChangesStatus != B_OK)
+		return;
+	if (length > MAX_INDEX_KEY_LENGTH)
+		length = MAX_INDEX_KEY_LENGTH;
+
+	size_t size = change_size(length);
+	if (fChangesSize + size > fChangesAllocated) {
+		size_t allocated = max_c(fChangesAllocated * 2, 64 * 1024);
+		if (allocated > kMaxChangesSize) {
+			// the index must be built again later
+			fChangesStatus = B_BUSY;
+			return;
+		}
+
+		uint8* changes = (uint8*)realloc(fChanges, allocated);
+		if (changes == NULL) {
+			fChangesStatus = B_NO_MEMORY;
+			return;
+		}
+
+		fChanges = changes;
+		fChangesAllocated = allocated;
+	}
+
+	index_change* change = (index_change*)(fChanges + fChangesSize);
+	change->id = id;
+	change->length = length;
+	memcpy(change->key, key, length);
+	fChangesSize += size;
+}
+
+
+/*!	Builds the new B+tree in a new index with a temporary name, which is
+	marked incomplete until it has caught up with the recorded changes. An
+	incomplete index that a previous build might have left behind is
+	removed first.
+*/
+status_t
+IndexBuilder::_LoadIndex(uint32 type, KeySorter& sorter)
+{
+	Volume* volume = GetVolume();
+	Transaction transaction(volume, volume->Indices());
+
+	bool removed = false;
+	if (volume->IndicesNode() != NULL) {
+		Index index(volume);
+		if (index.SetTo(fTemporaryName) == B_OK) {
+			if (index.IsComplete())
+				RETURN_ERROR(B_FILE_EXISTS);
+			index.Unset();
+
+			status_t status = volume->IndicesNode()->Remove(transaction,
+				fTemporaryName);
+			if (status != B_OK)
+				RETURN_ERROR(status);
+			removed = true;
+		}
+	}
+
+	// this also creates the indices directory, if there is none yet
+	Index newIndex(volume);
+	status_t status = newIndex.Create(transaction, fTemporaryName, type);
+	if (status != B_OK)
+		RETURN_ERROR(status);
+
+	Inode* inode = newIndex.Node();
+	BPlusTree* tree = inode->Tree();
+	if (tree == NULL)
+		RETURN_ERROR(B_BAD_VALUE);
+
+	inode->Node().flags |= HOST_ENDIAN_TO_BFS_INT32(INODE_INCOMPLETE_INDEX);
+
+	IndexLoader loader(transaction, inode, type);
+	status = loader.InitCheck();
+	if (status == B_OK)
+		status = loader.Prepare(sorter);
+	if (status == B_OK)
+		status = inode->SetFileSize(transaction, loader.Size());
+	if (status != B_OK)
+		RETURN_ERROR(status);
+
+	// the header must know the new size before any node can be written
+	{
+		CachedNode cached(tree);
+		bplustree_header* header = cached.SetToWritableHeader(transaction);
+		if (header == NULL)
+			RETURN_ERROR(B_IO_ERROR);
+
+		header->root_node_pointer = HOST_ENDIAN_TO_BFS_INT64(
+			loader.RootNode());
+		header->free_node_pointer = HOST_ENDIAN_TO_BFS_INT64(
+			loader.FreeNode());
+		header->maximum_size = HOST_ENDIAN_TO_BFS_INT64(loader.Size());
+		header->max_number_of_levels = HOST_ENDIAN_TO_BFS_INT32(
+			loader.CountLevels());
+	}
+
+	status = loader.Write(sorter);
+	if (status == B_OK) {
+		// the nodes written directly must be on disk before the log
+		// refers to them
+		status = volume->FlushDevice();
+	}
+	if (status == B_OK)
+		status = inode->WriteBack(transaction);
+	if (status == B_OK)
+		status = transaction.Done();
+	if (status != B_OK)
+		RETURN_ERROR(status);
+
+	if (removed && fTrigrams)
+		volume->RemoveTrigramIndex();
+
+	fEntries = sorter.CountEntries();
+	fLevels = loader.CountLevels();
+	return B_OK;
+}
+
+
+/*!	Brings the new index up to date with the changes that were recorded
+	while the keys were collected: all keys the changed files had in the
+	meantime are removed, and their current keys are added.
+	Must be called while the journal is held, so that there cannot be any
+	new changes.
+*/
+status_t
+IndexBuilder::_CatchUp(Transaction& transaction, BPlusTree* tree)
+{
+	for (size_t offset = 0; offset < fChangesSize;) {
+		const index_change* change = (index_change*)(fChanges + offset);
+		offset += change_size(change->length);
+
+		status_t status = _UpdateKeys(transaction, tree, change->id,
+			change->key, change->length, false);
+		if (status != B_OK)
+			RETURN_ERROR(status);
+	}
+
+	for (size_t offset = 0; offset < fChangesSize;) {
+		const index_change* change = (index_change*)(fChanges + offset);
+		offset += change_size(change->length);
+
+		// the file might be gone already
+		Vnode vnode(GetVolume(), change->id);
+		Inode* inode;
+		if (vnode.Get(&inode) != B_OK || inode->IsDeleted())
+			continue;
+
+		uint8 buffer[MAX_INDEX_KEY_LENGTH];
+		size_t length;
+		if (_GetKey(inode, NULL, buffer, length) != B_OK)
+			continue;
+
+		status_t status = _UpdateKeys(transaction, tree, change->id, buffer,
+			length, true);
+		if (status != B_OK)
+			RETURN_ERROR(status);
+	}
+
+	return B_OK;
+}
+
+
+/*!	Inserts the keys of the attribute \a value into \a tree, or removes
+	them. The tree must only contain each key of a file once, but a file can
+	have been changed more than once.
+*/
+status_t
+IndexBuilder::_UpdateKeys(Transaction& transaction, BPlusTree* tree,
+	ino_t id, const uint8* value, size_t length, bool insert)
+{
+	int32 count = _SplitKeys(value, length);
+	for (int32 i = 0; i < count; i++) {
+		uint8 trigram[TRIGRAM_LENGTH];
+		uint16 keyLength;
+		const uint8* key = _KeyAt(i, value, length, trigram, keyLength);
+
+		status_t status = tree->Remove(transaction, key, keyLength, id);
+		if (status == B_OK)
+			fEntries--;
+		else if (status != B_ENTRY_NOT_FOUND)
+			RETURN_ERROR(status);
+
+		if (insert) {
+			status = tree->Insert(transaction, key, keyLength, id);
+			if (status != B_OK)
+				RETURN_ERROR(status);
+			fEntries++;
+		}
+	}
+
+	return B_OK;
+}
+
+
+/*!	Catches up with the recorded changes, removes the old index, if any,
+	and gives its name to the new one.
+*/
+status_t
+IndexBuilder::_ReplaceIndex(bool create, uint32 type,
+	rebuild_index_control& control)
+{
+	Volume* volume = GetVolume();
+	Transaction transaction(volume, volume->Indices());
+
+	// no one can change the attribute anymore while the transaction runs
+	volume->RemoveIndexBuilder(this);
+	if (fChangesStatus != B_OK)
+		RETURN_ERROR(fChangesStatus);
+
+	Inode* indices = volume->IndicesNode();
+
+	Index newIndex(volume);
+	status_t status = newIndex.SetTo(fTemporaryName);
+	if (status != B_OK)
+		RETURN_ERROR(status);
+
+	Inode* inode = newIndex.Node();
+	BPlusTree* tree = inode->Tree();
+	if (tree == NULL)
+		RETURN_ERROR(B_BAD_VALUE);
+
+	// the old index might have been changed in the meantime
+	Index index(volume);
+	status = index.SetTo(control.name);
+	if (create) {
+		if (status == B_OK)
+			RETURN_ERROR(B_FILE_EXISTS);
+	} else {
+		if (status != B_OK)
+			RETURN_ERROR(status);
+		if (index.Type() != type)
+			RETURN_ERROR(B_BAD_TYPE);
+	}
+
+	inode->WriteLockInTransaction(transaction);
+
+	status = _CatchUp(transaction, tree);
+	if (status != B_OK)
+		RETURN_ERROR(status);
+
+	// switch the indices
+
+	if (!create) {
+		ino_t oldID = index.Node()->ID();
+		index.Unset();
+
+		status = indices->Remove(transaction, control.name);
+		if (status != B_OK)
+			RETURN_ERROR(status);
+
+		volume->InvalidateIndexStatistics(oldID);
+	}
+
+	status = indices->Tree()->Remove(transaction, fTemporaryName,
+		inode->ID());
+	if (status == B_OK) {
+		status = indices->Tree()->Insert(transaction, control.name,
+			inode->ID());
+	}
+	if (status == B_OK)
+		status = inode->SetName(transaction, control.name);
+	if (status == B_OK) {
+		inode->Node().flags &= ~HOST_ENDIAN_TO_BFS_INT32(
+			INODE_INCOMPLETE_INDEX);
+		status = inode->WriteBack(transaction);
+	}
+	if (status == B_OK)
+		status = transaction.Done();
+	if (status != B_OK)
+		RETURN_ERROR(status);
+
+	volume->InvalidateIndexStatistics(inode->ID());
+
+	control.entries = fEntries;
+	control.nodes = inode->Size() / tree->NodeSize();
+	control.levels = fLevels;
+
+	return B_OK;
+}
+
+
+//!	Removes the new index again after it could not replace the old one.
+void
+IndexBuilder::_RemoveTemporaryIndex()
+{
+	Volume* volume = GetVolume();
+	Transaction transaction(volume, volume->Indices());
+
+	Index index(volume);
+	if (index.SetTo(fTemporaryName) != B_OK)
+		return;
+	index.Unset();
+
+	if (volume->IndicesNode()->Remove(transaction, fTemporaryName) == B_OK
+		&& transaction.Done() == B_OK && fTrigrams)
+		volume->RemoveTrigramIndex();
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * This file may be used under the terms of the MIT License.
+ */
+#ifndef INDEX_BUILDER_H
+#define INDEX_BUILDER_H
+
+
+#include "system_dependencies.h"
+
+#include "bfs_control.h"
+#include "FileSystemVisitor.h"
+
+
+class BPlusTree;
+class KeySorter;
+class Transaction;
+
+
+/*!	Rebuilds an index from the files of the volume: their keys are collected
+	in a KeySorter, and a new B+tree is bulk-loaded from them with the
+	BPlusTreeLoader, which then replaces the old index. New indices can be
+	filled the same way before they become visible.
+	The keys are collected without holding the journal; the changes that
+	are made to the attribute in the meantime are recorded (see Changed()),
+	and applied to the new tree before it replaces the old one.
+*/
+class IndexBuilder : public FileSystemVisitor,
+	public SinglyLinkedListLinkImpl<IndexBuilder> {
+public:
+								IndexBuilder(Volume* volume);
+	virtual						~IndexBuilder();
+
+			status_t			Rebuild(rebuild_index_control& control);
+			status_t			Create(rebuild_index_control& control,
+									uint32 type);
+
+			const char*			IndexName() const { return fName; }
+			void				Changed(Inode* inode, const char* attribute,
+									const uint8* oldKey, uint16 oldLength,
+									const uint8* newKey, uint16 newLength);
+
+	virtual status_t			VisitInode(Inode* inode, const char* treeName);
+
+	static	const size_t		kMaxMemory = 128 * 1024 * 1024;
+	static	const size_t		kMaxChangesSize = 16 * 1024 * 1024;
+
+private:
+			status_t			_Build(rebuild_index_control& control,
+									bool create, uint32 type);
+			status_t			_CollectKeys(KeySorter& sorter);
+			status_t			_GetKey(Inode* inode, const char* treeName,
+									uint8* buffer, size_t& _length);
+			int32				_SplitKeys(const uint8* value,
+									size_t length);
+			const uint8*		_KeyAt(int32 index, const uint8* value,
+									size_t length, uint8* buffer,
+									uint16& _keyLength);
+			void				_RecordChange(ino_t id, const uint8* key,
+									uint16 length);
+
+			status_t			_LoadIndex(uint32 type, KeySorter& sorter);
+			status_t			_CatchUp(Transaction& transaction,
+									BPlusTree* tree);
+			status_t			_UpdateKeys(Transaction& transaction,
+									BPlusTree* tree, ino_t id,
+									const uint8* value, size_t length,
+									bool insert);
+			status_t			_ReplaceIndex(bool create, uint32 type,
+									rebuild_index_control& control);
+			void				_RemoveTemporaryIndex();
+
+private:
+			char				fName[B_FILE_NAME_LENGTH];
+			char				fTemporaryName[B_FILE_NAME_LENGTH];
+				// the new index has this name until it is complete
+			char				fAttribute[B_FILE_NAME_LENGTH];
+				// the attribute the keys are taken from
+			bool				fTrigrams;
+			uint32*				fTrigramBuffer;
+			size_t				fKeySize;
+			KeySorter*			fSorter;
+			off_t				fEntries;
+			uint32				fLevels;
+
+			// changes recorded while the keys are collected, guarded by
+			// the index builder lock of the volume
+			uint8*				fChanges;
+			size_t				fChangesSize;
+			size_t				fChangesAllocated;
+			status_t			fChangesStatus;
+};
+
+
+#endif	// INDEX_BUILDER_H
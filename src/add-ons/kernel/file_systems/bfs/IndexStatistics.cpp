@@ -0,0 +1,445 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * This file may be used under the terms of the MIT License.
+ */
+
+
+//! Key distribution of an index, for the query planner
+
+
+#include "IndexStatistics.h"
+
+#include <file_systems/QueryParserUtils.h>
+
+
+static const int64 kMinUpdatesUntilStale = 1024;
+static const uint32 kShareOne = 1024;
+
+
+IndexStatistics::IndexStatistics(ino_t id, type_code type)
+	:
+	fID(id),
+	fType(type)
+{
+	Start();
+}
+
+
+/*!	Starts building the histogram from scratch; all keys of the index must
+	then be passed to Add() in the order of the index.
+*/
+void
+IndexStatistics::Start()
+{
+	fEntries = 0;
+	fBucketEntries = 1;
+	fGathered = 0;
+	fUpdates = 0;
+	fCount = 0;
+	fFirstLength = 0;
+}
+
+
+void
+IndexStatistics::Add(const uint8* key, uint16 length)
+{
+	if (length > MAX_INDEX_KEY_LENGTH)
+		length = MAX_INDEX_KEY_LENGTH;
+
+	if (fEntries == 0) {
+		memcpy(fFirst, key, length);
+		fFirstLength = length;
+	}
+
+	bucket* current = fCount > 0 ? &fBuckets[fCount - 1] : NULL;
+	if (current != NULL && current->entries >= fBucketEntries) {
+		// We don't know the number of entries in advance; when we run out
+		// of buckets, every two of them are merged into one that may hold
+		// twice as many entries as before.
+		if (fCount == kMaxBuckets * 2) {
+			_MergeBuckets();
+			fBucketEntries *= 2;
+		}
+
+		current = &fBuckets[fCount - 1];
+		if (current->entries >= fBucketEntries)
+			current = NULL;
+	}
+	if (current == NULL) {
+		current = &fBuckets[fCount++];
+		current->entries = 0;
+		current->keys = 0;
+		current->continued = 0;
+		current->length = 0;
+	}
+
+	if (current->entries == 0
+		|| _Compare(key, length, current->last, current->length) != 0)
+		current->keys++;
+
+	if (fCount > 1 && current->entries == current->continued) {
+		// a run of duplicates may continue from the previous bucket
+		const bucket& previous = fBuckets[fCount - 2];
+		if (_Compare(key, length, previous.last, previous.length) == 0)
+			current->continued++;
+	}
+
+	memcpy(current->last, key, length);
+	current->length = length;
+	current->entries++;
+	fEntries++;
+}
+
+
+void
+IndexStatistics::Finish()
+{
+	while (fCount > kMaxBuckets) {
+		_MergeBuckets();
+		fBucketEntries *= 2;
+	}
+
+	fGathered = fEntries;
+	fUpdates = 0;
+}
+
+
+void
+IndexStatistics::SetTo(const IndexStatistics& other)
+{
+	fType = other.fType;
+	fEntries = other.fEntries;
+	fBucketEntries = other.fBucketEntries;
+	fGathered = other.fGathered;
+	fUpdates = other.fUpdates;
+	fCount = other.fCount;
+	fFirstLength = other.fFirstLength;
+	memcpy(fFirst, other.fFirst, fFirstLength);
+	memcpy(fBuckets, other.fBuckets, sizeof(bucket) * fCount);
+}
+
+
+/*!	Accounts for a key that was removed from, and one that was inserted into
+	the index; either of them may be \c NULL.
+	Only the entry counts and the outer boundaries of the histogram are
+	adjusted; once many keys have changed, IsStale() suggests to build it
+	again.
+*/
+void
+IndexStatistics::Update(const uint8* oldKey, uint16 oldLength,
+	const uint8* newKey, uint16 newLength)
+{
+	if (oldLength > MAX_INDEX_KEY_LENGTH)
+		oldLength = MAX_INDEX_KEY_LENGTH;
+	if (newLength > MAX_INDEX_KEY_LENGTH)
+		newLength = MAX_INDEX_KEY_LENGTH;
+
+	if (oldKey != NULL && fCount > 0) {
+		bucket& bucket = fBuckets[_FindBucket(oldKey, oldLength)];
+		if (bucket.entries > 0) {
+			bucket.entries--;
+			bucket.continued = min_c(bucket.continued, bucket.entries);
+			fEntries--;
+		}
+	}
+
+	if (newKey != NULL) {
+		if (fCount == 0) {
+			memcpy(fFirst, newKey, newLength);
+			fFirstLength = newLength;
+
+			bucket& bucket = fBuckets[fCount++];
+			bucket.entries = 0;
+			bucket.keys = 1;
+			bucket.continued = 0;
+			memcpy(bucket.last, newKey, newLength);
+			bucket.length = newLength;
+		}
+
+		int32 index = _FindBucket(newKey, newLength);
+		bucket& bucket = fBuckets[index];
+
+		// keep the range of the histogram covering all keys, so that
+		// growing keys, like modification times, are accounted for
+		if (_CompareToLast(newKey, newLength, index) > 0) {
+			memcpy(bucket.last, newKey, newLength);
+			bucket.length = newLength;
+			bucket.keys++;
+		} else if (index == 0
+			&& _Compare(newKey, newLength, fFirst, fFirstLength) < 0) {
+			memcpy(fFirst, newKey, newLength);
+			fFirstLength = newLength;
+			bucket.keys++;
+		}
+
+		bucket.entries++;
+		fEntries++;
+	}
+
+	fUpdates++;
+}
+
+
+bool
+IndexStatistics::IsStale() const
+{
+	return fUpdates > kMinUpdatesUntilStale && fUpdates > fGathered / 2;
+}
+
+
+/*!	Returns the estimated number of entries with keys between \a lower, and
+	\a upper (inclusive); either of them may be \c NULL for an open range.
+	Within a bucket, the keys are assumed to be spread evenly.
+*/
+int64
+IndexStatistics::Estimate(const uint8* lower, uint16 lowerLength,
+	const uint8* upper, uint16 upperLength) const
+{
+	if (lowerLength > MAX_INDEX_KEY_LENGTH)
+		lowerLength = MAX_INDEX_KEY_LENGTH;
+	if (upperLength > MAX_INDEX_KEY_LENGTH)
+		upperLength = MAX_INDEX_KEY_LENGTH;
+
+	if (lower != NULL && upper != NULL
+		&& _Compare(lower, lowerLength, upper, upperLength) == 0)
+		return _EstimateEqual(lower, lowerLength);
+
+	int64 estimate = 0;
+
+	for (int32 i = 0; i < fCount; i++) {
+		if (lower != NULL && _CompareToLast(lower, lowerLength, i) > 0)
+			continue;
+		if (upper != NULL && _CompareToFirst(upper, upperLength, i) < 0)
+			break;
+
+		// the entries with the lower boundary are not spread over the bucket
+		const bucket& bucket = fBuckets[i];
+		if (lower == NULL || _CompareToFirst(lower, lowerLength, i) <= 0)
+			estimate += bucket.continued;
+
+		uint32 from = lower != NULL ? _ShareBelow(lower, lowerLength, i) : 0;
+		uint32 to = upper != NULL
+			? _ShareBelow(upper, upperLength, i) : kShareOne;
+		if (to > from) {
+			estimate += ((bucket.entries - bucket.continued) * (to - from)
+				+ kShareOne - 1) / kShareOne;
+		}
+	}
+
+	return estimate;
+}
+
+
+int
+IndexStatistics::_Compare(const uint8* key, uint16 length, const uint8* other,
+	uint16 otherLength) const
+{
+	return QueryParser::compareKeys(fType, key, length, other, otherLength);
+}
+
+
+int
+IndexStatistics::_CompareToLast(const uint8* key, uint16 length,
+	int32 index) const
+{
+	return _Compare(key, length, fBuckets[index].last,
+		fBuckets[index].length);
+}
+
+
+/*!	Compares the key with the lower boundary of the bucket; this is the
+	last key of the previous bucket, as a run of duplicates may continue in
+	the next bucket.
+*/
+int
+IndexStatistics::_CompareToFirst(const uint8* key, uint16 length,
+	int32 index) const
+{
+	if (index == 0)
+		return _Compare(key, length, fFirst, fFirstLength);
+
+	return _CompareToLast(key, length, index - 1);
+}
+
+
+//!	Returns the first bucket that may contain the key.
+int32
+IndexStatistics::_FindBucket(const uint8* key, uint16 length) const
+{
+	int32 first = 0;
+	int32 last = fCount - 1;
+
+	while (first < last) {
+		int32 middle = (first + last) / 2;
+		if (_CompareToLast(key, length, middle) > 0)
+			first = middle + 1;
+		else
+			last = middle;
+	}
+
+	return first;
+}
+
+
+void
+IndexStatistics::_GetFirst(int32 index, const uint8*& _key,
+	uint16& _length) const
+{
+	if (index == 0) {
+		_key = fFirst;
+		_length = fFirstLength;
+	} else {
+		_key = fBuckets[index - 1].last;
+		_length = fBuckets[index - 1].length;
+	}
+}
+
+
+/*!	Maps the key to a number with the same order, so that the distance
+	between keys can be computed. String keys are represented by the first
+	bytes after the \a prefix they all share. Returns 0 for types for which
+	this is not supported.
+*/
+uint64
+IndexStatistics::_Position(const uint8* key, uint16 length,
+	uint16 prefix) const
+{
+	switch (fType) {
+		case B_INT32_TYPE:
+		case B_UINT32_TYPE:
+		{
+			if (length < sizeof(uint32))
+				return 0;
+
+			uint32 value;
+			memcpy(&value, key, sizeof(uint32));
+			if (fType == B_INT32_TYPE)
+				value ^= 0x80000000;
+			return value;
+		}
+		case B_INT64_TYPE:
+		case B_UINT64_TYPE:
+		{
+			if (length < sizeof(uint64))
+				return 0;
+
+			uint64 value;
+			memcpy(&value, key, sizeof(uint64));
+			if (fType == B_INT64_TYPE)
+				value ^= 1ULL << 63;
+			return value;
+		}
+		case B_STRING_TYPE:
+		{
+			uint64 position = 0;
+			for (uint16 i = prefix; i < prefix + 7; i++)
+				position = (position << 8) | (i < length ? key[i] : 0);
+			return position;
+		}
+	}
+
+	return 0;
+}
+
+
+/*!	Returns the share of the key range of the bucket that is below or equal
+	to \a key, out of kShareOne.
+*/
+uint32
+IndexStatistics::_ShareBelow(const uint8* key, uint16 length,
+	int32 index) const
+{
+	const bucket& bucket = fBuckets[index];
+	const uint8* first;
+	uint16 firstLength;
+	_GetFirst(index, first, firstLength);
+
+	if (_Compare(key, length, first, firstLength) < 0)
+		return 0;
+	if (_CompareToLast(key, length, index) >= 0)
+		return kShareOne;
+
+	uint16 prefix = 0;
+	if (fType == B_STRING_TYPE) {
+		while (prefix < firstLength && prefix < bucket.length
+			&& first[prefix] == bucket.last[prefix])
+			prefix++;
+	}
+
+	uint64 low = _Position(first, firstLength, prefix);
+	uint64 high = _Position(bucket.last, bucket.length, prefix);
+	uint64 position = _Position(key, length, prefix);
+	if (high <= low || position < low)
+		return kShareOne / 2;
+
+	uint64 range = high - low;
+	uint64 offset = min_c(position - low, range);
+	while (range > (1ULL << 48)) {
+		range >>= 8;
+		offset >>= 8;
+	}
+	if (range == 0)
+		return kShareOne / 2;
+
+	return (uint32)(offset * kShareOne / range);
+}
+
+
+void
+IndexStatistics::_MergeBuckets()
+{
+	int32 count = 0;
+
+	for (int32 i = 0; i < fCount; i += 2, count++) {
+		bucket& target = fBuckets[count];
+		if (count != i)
+			target = fBuckets[i];
+		if (i + 1 == fCount)
+			continue;
+
+		const bucket& next = fBuckets[i + 1];
+		if (target.continued == target.entries)
+			target.continued += next.continued;
+		target.entries += next.entries;
+		target.keys += next.keys;
+		memcpy(target.last, next.last, next.length);
+		target.length = next.length;
+	}
+
+	fCount = count;
+}
+
+
+/*!	A key that fills whole buckets is a frequent one, and accounts for all
+	of their entries, as well as for those it continues with in the next
+	bucket; other keys are assumed to be spread evenly over the bucket they
+	are in.
+*/
+int64
+IndexStatistics::_EstimateEqual(const uint8* key, uint16 length) const
+{
+	int64 estimate = 0;
+
+	for (int32 i = _FindBucket(key, length); i < fCount; i++) {
+		const bucket& bucket = fBuckets[i];
+		int lastCompare = _CompareToLast(key, length, i);
+		int firstCompare = _CompareToFirst(key, length, i);
+		if (lastCompare > 0 || firstCompare < 0)
+			break;
+
+		if (firstCompare == 0 && lastCompare == 0)
+			estimate += bucket.entries;
+		else if (firstCompare == 0 && i > 0)
+			estimate += bucket.continued;
+		else if (bucket.entries > bucket.continued) {
+			int64 keys = bucket.keys - (bucket.continued > 0 ? 1 : 0);
+			estimate += max_c((bucket.entries - bucket.continued)
+				/ max_c(keys, 1), 1);
+		}
+
+		if (lastCompare != 0)
+			break;
+	}
+
+	return estimate;
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * This file may be used under the terms of the MIT License.
+ */
+#ifndef INDEX_STATISTICS_H
+#define INDEX_STATISTICS_H
+
+
+#include "system_dependencies.h"
+
+#include "bfs.h"
+
+
+/*!	An equi-depth histogram over the keys of an index, used by the query
+	planner to estimate how many entries a term will visit.
+	It is built from the keys in index order with Start(), Add(), and
+	Finish(), and kept roughly up to date by Update() afterwards. The
+	object does no locking of its own.
+*/
+class IndexStatistics : public SinglyLinkedListLinkImpl<IndexStatistics> {
+public:
+							IndexStatistics(ino_t id, type_code type);
+
+			ino_t			ID() const { return fID; }
+			type_code		Type() const { return fType; }
+
+			void			Start();
+			void			Add(const uint8* key, uint16 length);
+			void			Finish();
+			void			SetTo(const IndexStatistics& other);
+
+			void			Update(const uint8* oldKey, uint16 oldLength,
+								const uint8* newKey, uint16 newLength);
+			bool			IsStale() const;
+
+			int64			CountEntries() const { return fEntries; }
+			int32			CountBuckets() const { return fCount; }
+			int64			Estimate(const uint8* lower, uint16 lowerLength,
+								const uint8* upper, uint16 upperLength) const;
+
+	static	const int32		kMaxBuckets = 16;
+
+private:
+			struct bucket {
+				int64		entries;
+				int64		keys;
+				int64		continued;
+					// entries with the last key of the previous bucket
+				uint16		length;
+				uint8		last[MAX_INDEX_KEY_LENGTH];
+			};
+
+			int				_Compare(const uint8* key, uint16 length,
+								const uint8* other, uint16 otherLength) const;
+			int				_CompareToLast(const uint8* key, uint16 length,
+								int32 index) const;
+			int				_CompareToFirst(const uint8* key, uint16 length,
+								int32 index) const;
+			int32			_FindBucket(const uint8* key,
+								uint16 length) const;
+			void			_GetFirst(int32 index, const uint8*& _key,
+								uint16& _length) const;
+			uint64			_Position(const uint8* key, uint16 length,
+								uint16 prefix) const;
+			uint32			_ShareBelow(const uint8* key, uint16 length,
+								int32 index) const;
+			void			_MergeBuckets();
+			int64			_EstimateEqual(const uint8* key,
+								uint16 length) const;
+
+private:
+			ino_t			fID;
+			type_code		fType;
+			int64			fEntries;
+			int64			fBucketEntries;
+			int64			fGathered;
+			int64			fUpdates;
+			int32			fCount;
+			uint16			fFirstLength;
+			uint8			fFirst[MAX_INDEX_KEY_LENGTH];
+			bucket			fBuckets[kMaxBuckets * 2];
+				// twice as many while the histogram is being built
+};
+
+
+#endif	// INDEX_STATISTICS_H
@@ -344,7 +344,10 @@ Inode::Inode(Volume* volume, ino_t id)
 	fTree(NULL),
 	fAttributes(NULL),
 	fCache(NULL),
-	fMap(NULL)
+	fMap(NULL),
+	fDelayedSize(0),
+	fReservedBlocks(0),
+	fCancelDelayedAllocation(false)
 {
 	PRINT(("Inode::Inode(volume = %p, id = %" B_PRIdINO ") @ %p\n",
 		volume, id, this));
@@ -378,7 +381,10 @@ Inode::Inode(Volume* volume, Transaction& transaction, ino_t id, mode_t mode,
 	fTree(NULL),
 	fAttributes(NULL),
 	fCache(NULL),
-	fMap(NULL)
+	fMap(NULL),
+	fDelayedSize(0),
+	fReservedBlocks(0),
+	fCancelDelayedAllocation(false)
 {
 	PRINT(("Inode::Inode(volume = %p, transaction = %p, id = %" B_PRIdINO
 		") @ %p\n", volume, &transaction, id, this));
@@ -420,6 +426,9 @@ Inode::~Inode()
 {
 	PRINT(("Inode::~Inode() @ %p\n", this));
 
+	if (fReservedBlocks > 0)
+		fVolume->UnreserveBlocks(fReservedBlocks);
+
 	file_cache_delete(FileCache());
 	file_map_delete(Map());
 	delete fTree;
@@ -568,7 +577,8 @@ Inode::_MakeSpaceForSmallData(Transaction& transaction, bfs_inode* node,
 		int32 index = 0, maxIndex = 0;
 		for (; !item->IsLast(node); item = item->Next(), index++) {
 			// should not remove those
-			if (*item->Name() == FILE_NAME_NAME || !strcmp(name, item->Name()))
+			if (is_reserved_small_data_name(item->Name())
+				|| !strcmp(name, item->Name()))
 				continue;
 
 			if (max == NULL || max->Size() < item->Size()) {
@@ -842,7 +852,7 @@ Inode::_AddSmallData(Transaction& transaction, NodeGetter& nodeGetter,
 	memset(item, 0, spaceNeeded);
 	item->type = HOST_ENDIAN_TO_BFS_INT32(type);
 	item->name_size = HOST_ENDIAN_TO_BFS_INT16(nameLength);
-	item->data_size = HOST_ENDIAN_TO_BFS_INT16(length);
+	item->data_size = HOST_ENDIAN_TO_BFS_INT16(pos + length);
 	strcpy(item->Name(), name);
 	if (user_memcpy(item->Data() + pos, data, length) < B_OK)
 		return B_BAD_ADDRESS;
@@ -1086,6 +1096,71 @@ Inode::ReadAttribute(const char* name, int32 type, off_t pos, uint8* buffer,
 }
 
 
+#ifndef FS_SHELL
+/*!	Reads the start of several attributes at once, like ReadAttribute() at
+	position 0. The small_data section is searched only once for all of
+	them, only the remaining attributes are looked up in the attribute
+	directory. Vecs whose status isn't \c B_OK on entry are skipped.
+	The result of each read is stored in the vec's status, the number of
+	bytes read in its length field.
+*/
+void
+Inode::ReadAttributes(attr_io_vec* vecs, size_t count)
+{
+	bool needAttributeDirectory = false;
+
+	{
+		NodeGetter node(fVolume);
+		status_t status = node.SetTo(this);
+		if (status != B_OK) {
+			for (size_t i = 0; i < count; i++) {
+				if (vecs[i].status == B_OK)
+					vecs[i].status = status;
+			}
+		} else {
+			RecursiveLocker locker(fSmallDataLock);
+
+			for (size_t i = 0; i < count; i++) {
+				attr_io_vec& vec = vecs[i];
+				if (vec.status != B_OK)
+					continue;
+
+				small_data* smallData = FindSmallData(node.Node(), vec.name);
+				if (smallData == NULL) {
+					// look it up in the attribute directory below
+					vec.status = B_ENTRY_NOT_FOUND;
+					needAttributeDirectory = true;
+					continue;
+				}
+
+				size_t length = min_c(vec.length, smallData->DataSize());
+				vec.status = user_memcpy(vec.buffer, smallData->Data(), length);
+				vec.length = length;
+			}
+		}
+	}
+
+	for (size_t i = 0; needAttributeDirectory && i < count; i++) {
+		attr_io_vec& vec = vecs[i];
+		if (vec.status != B_ENTRY_NOT_FOUND)
+			continue;
+
+		Inode* attribute;
+		vec.status = GetAttribute(vec.name, &attribute);
+		if (vec.status == B_OK) {
+			vec.status = attribute->ReadAt(0, (uint8*)vec.buffer, &vec.length);
+			ReleaseAttribute(attribute);
+		}
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (vecs[i].status != B_OK)
+			vecs[i].length = 0;
+	}
+}
+#endif	// !FS_SHELL
+
+
 /*!	Writes data to the specified attribute.
 	This is a high-level attribute function that understands attributes
 	in the small_data section as well as real attribute files.
@@ -1428,8 +1503,9 @@ Inode::ContainerContentsChanged(Transaction& transaction)
 off_t
 Inode::AllocatedSize() const
 {
-	if (IsSymLink() && (Flags() & INODE_LONG_SYMLINK) == 0) {
-		// This symlink does not have a data stream
+	if ((IsSymLink() && (Flags() & INODE_LONG_SYMLINK) == 0)
+		|| HasInlineData()) {
+		// This node does not have a data stream
 		return Node().InodeSize();
 	}
 
@@ -1493,6 +1569,8 @@ Inode::FindBlockRun(off_t pos, block_run& run, off_t& offset)
 			off_t start = pos - data->MaxIndirectRange();
 			int32 index = start / indirectSize;
 
+			cached.Prefetch(data->double_indirect);
+
 			status_t status = cached.SetTo(fVolume->ToBlock(
 				data->double_indirect) + index / runsPerBlock);
 			if (status != B_OK)
@@ -1501,8 +1579,13 @@ Inode::FindBlockRun(off_t pos, block_run& run, off_t& offset)
 			block_run* indirect = (block_run*)cached.Block();
 			int32 current = (start % indirectSize) / directSize;
 
-			status = cached.SetTo(fVolume->ToBlock(indirect[
-				index % runsPerBlock]) + current / runsPerBlock);
+			// the following lookups will most likely need the rest of this
+			// array, too
+			block_run array = indirect[index % runsPerBlock];
+			cached.Prefetch(array);
+
+			status = cached.SetTo(fVolume->ToBlock(array)
+				+ current / runsPerBlock);
 			if (status != B_OK)
 				RETURN_ERROR(status);
 
@@ -1521,6 +1604,7 @@ Inode::FindBlockRun(off_t pos, block_run& run, off_t& offset)
 
 			CachedBlock cached(fVolume);
 			off_t block = fVolume->ToBlock(data->indirect);
+			cached.Prefetch(data->indirect);
 
 			for (int32 i = 0; i < data->indirect.Length(); i++) {
 				status_t status = cached.SetTo(block + i);
@@ -1593,50 +1677,94 @@ Inode::WriteAt(Transaction& transaction, off_t pos, const uint8* buffer,
 	// TODO: support INODE_LOGGED!
 
 	size_t length = *_length;
-	bool changeSize = (uint64)pos + (uint64)length > (uint64)Size();
+	bool changeSize = (uint64)pos + (uint64)length > (uint64)LogicalSize();
 
 	// set/check boundaries for pos/length
 	if (pos < 0)
 		return B_BAD_VALUE;
 
+	// The data of small files is written to their inode, which always needs
+	// a transaction
+	bool inlineData = length > 0
+		&& _CanInlineData(max_c((off_t)(pos + length), LogicalSize()));
+
 	locker.Unlock();
 
+	// Growing a file does not need a transaction if its blocks can be
+	// allocated later, when its data is written back
+	bool delayAllocation = !inlineData && !transaction.IsStarted()
+		&& _CanDelayAllocation();
+
 	// the transaction doesn't have to be started already
-	if (changeSize && !transaction.IsStarted())
+	if ((changeSize || inlineData) && !delayAllocation
+		&& !transaction.IsStarted())
 		transaction.Start(fVolume, BlockNumber());
 
 	WriteLocker writeLocker(fLock);
 
 	// Work around possible race condition: Someone might have shrunken the file
 	// while we had no lock.
-	if (!transaction.IsStarted()
-		&& (uint64)pos + (uint64)length > (uint64)Size()) {
+	if (!delayAllocation && !transaction.IsStarted()
+		&& (uint64)pos + (uint64)length > (uint64)LogicalSize()) {
 		writeLocker.Unlock();
 		transaction.Start(fVolume, BlockNumber());
 		writeLocker.Lock();
 	}
 
-	off_t oldSize = Size();
+	off_t oldSize = LogicalSize();
 
-	if ((uint64)pos + (uint64)length > (uint64)oldSize) {
-		// let's grow the data stream to the size needed
-		status_t status = SetFileSize(transaction, pos + length);
-		if (status != B_OK) {
+	if (inlineData && transaction.IsStarted()
+		&& _CanInlineData(max_c((off_t)(pos + length), oldSize))) {
+		status_t status = _WriteInlineData(transaction, pos, buffer, length);
+		if (status == B_OK) {
+			writeLocker.Unlock();
+
+			// the file cache has to see the same data
+			if (oldSize < pos)
+				FillGapWithZeros(oldSize, pos);
+
+			status = file_cache_write(FileCache(), NULL, pos, buffer, _length);
+			WriteLockInTransaction(transaction);
+			return status;
+		}
+		if (status != B_DEVICE_FULL) {
 			*_length = 0;
 			WriteLockInTransaction(transaction);
 			RETURN_ERROR(status);
 		}
-		// TODO: In theory we would need to update the file size
-		// index here as part of the current transaction - this might just
-		// be a bit too expensive, but worth a try.
 
-		// we need to write back the inode here because it has to
-		// go into this transaction (we cannot wait until the file
-		// is closed)
-		status = WriteBack(transaction);
-		if (status != B_OK) {
-			WriteLockInTransaction(transaction);
-			return status;
+		// the data does not fit into the inode anymore; SetFileSize() will
+		// move it to a data stream
+	}
+
+	if ((uint64)pos + (uint64)length > (uint64)oldSize) {
+		if (!transaction.IsStarted()) {
+			// only reserve the blocks for now
+			status_t status = _DelayAllocation(pos + length);
+			if (status != B_OK) {
+				*_length = 0;
+				RETURN_ERROR(status);
+			}
+		} else {
+			// let's grow the data stream to the size needed
+			status_t status = SetFileSize(transaction, pos + length);
+			if (status != B_OK) {
+				*_length = 0;
+				WriteLockInTransaction(transaction);
+				RETURN_ERROR(status);
+			}
+			// TODO: In theory we would need to update the file size
+			// index here as part of the current transaction - this might
+			// just be a bit too expensive, but worth a try.
+
+			// we need to write back the inode here because it has to
+			// go into this transaction (we cannot wait until the file
+			// is closed)
+			status = WriteBack(transaction);
+			if (status != B_OK) {
+				WriteLockInTransaction(transaction);
+				return status;
+			}
 		}
 	}
 
@@ -1755,7 +1883,7 @@ Inode::_GrowStream(Transaction& transaction, off_t size)
 	// do we have enough free blocks on the disk?
 	off_t blocksNeeded = (bytes + fVolume->BlockSize() - 1)
 		>> fVolume->BlockShift();
-	if (blocksNeeded > fVolume->FreeBlocks())
+	if (blocksNeeded > fVolume->FreeBlocks() + fReservedBlocks)
 		return B_DEVICE_FULL;
 
 	off_t blocksRequested = blocksNeeded;
@@ -2123,6 +2251,10 @@ Inode::_FreeStaticStreamArray(Transaction& transaction, int32 level,
 			if (level == 0) {
 				status = _FreeStaticStreamArray(transaction, 1, array[index],
 					size, offset, max);
+
+				// the indirect array itself is no longer needed either
+				if (status == B_OK && offset >= size)
+					status = fVolume->Free(transaction, array[index]);
 			} else if (offset >= size)
 				status = fVolume->Free(transaction, array[index]);
 			else
@@ -2205,7 +2337,18 @@ Inode::_FreeStreamArray(Transaction& transaction, block_run* array,
 status_t
 Inode::_ShrinkStream(Transaction& transaction, off_t size)
 {
-	data_stream* data = &Node().data;
+	return _ShrinkStream(transaction, Node().data, size);
+}
+
+
+/*!	Frees all blocks of \a stream after \a size; the stream does not need
+	to belong to this inode anymore.
+*/
+status_t
+Inode::_ShrinkStream(Transaction& transaction, data_stream& stream,
+	off_t size)
+{
+	data_stream* data = &stream;
 	status_t status;
 
 	if (data->MaxDoubleIndirectRange() > size) {
@@ -2273,9 +2416,34 @@ Inode::SetFileSize(Transaction& transaction, off_t size)
 		return B_BAD_VALUE;
 
 	off_t oldSize = Size();
+	off_t delayedSize = fDelayedSize;
+
+	// The new size replaces any size that was not allocated yet. The blocks
+	// reserved for it are only given up once the transaction that gives the
+	// stream its new size has been committed: they may be needed to grow
+	// it, and if that fails, the delayed size stays as it was.
+
+	if (HasInlineData() && size != oldSize) {
+		status_t status = _SetInlineDataSize(transaction, size);
+		if (status == B_OK) {
+			file_cache_set_size(FileCache(), size);
+			return WriteBack(transaction);
+		}
+		if (status != B_DEVICE_FULL)
+			return status;
+
+		// the data does not fit into the inode anymore
+		status = _MoveInlineData(transaction);
+		if (status != B_OK)
+			return status;
+	}
 
-	if (size == oldSize)
+	if (size == oldSize) {
+		_CancelDelayedAllocation(transaction);
+		if (delayedSize > size)
+			file_cache_set_size(FileCache(), size);
 		return B_OK;
+	}
 
 	T(Resize(this, oldSize, size, false));
 
@@ -2297,7 +2465,11 @@ Inode::SetFileSize(Transaction& transaction, off_t size)
 	file_cache_set_size(FileCache(), size);
 	file_map_set_size(Map(), size);
 
-	return WriteBack(transaction);
+	status = WriteBack(transaction);
+	if (status == B_OK)
+		_CancelDelayedAllocation(transaction);
+
+	return status;
 }
 
 
@@ -2308,6 +2480,391 @@ Inode::Append(Transaction& transaction, off_t bytes)
 }
 
 
+/*!	Replaces the blocks of the data stream with the \a count runs in
+	\a runs, which must already contain a copy of its data. The new runs all
+	go into the direct range.
+	The old blocks, including any preallocated ones, are not freed, but
+	returned in \a oldStream: they must not be reused before this
+	transaction has been written to the log, and are freed with FreeStream()
+	afterwards.
+	The inode must be write locked in \a transaction.
+*/
+status_t
+Inode::MoveStream(Transaction& transaction, const block_run* runs,
+	int32 count, data_stream& oldStream)
+{
+	if (count < 1 || count > NUM_DIRECT_BLOCKS || HasInlineData())
+		RETURN_ERROR(B_BAD_VALUE);
+
+	off_t size = Size();
+	off_t range = 0;
+	for (int32 i = 0; i < count; i++)
+		range += (off_t)runs[i].Length() << fVolume->BlockShift();
+	if (range < size)
+		RETURN_ERROR(B_BAD_VALUE);
+
+	data_stream* data = &Node().data;
+	oldStream = *data;
+
+	memset(data, 0, sizeof(data_stream));
+	for (int32 i = 0; i < count; i++)
+		data->direct[i] = runs[i];
+	data->max_direct_range = HOST_ENDIAN_TO_BFS_INT64(range);
+	data->size = HOST_ENDIAN_TO_BFS_INT64(size);
+
+	file_map_invalidate(Map(), 0, size);
+
+	return WriteBack(transaction);
+}
+
+
+/*!	Frees all blocks of \a stream, which no inode may refer to anymore,
+	like the one returned by MoveStream().
+*/
+status_t
+Inode::FreeStream(Transaction& transaction, data_stream& stream)
+{
+	return _ShrinkStream(transaction, stream, 0);
+}
+
+
+/*!	Allocates the blocks for all data that has been written to the file
+	beyond its allocated size. This must be done before that data can be
+	written back, or the file is closed.
+	Must not be called with the inode locked, as it needs to start its own
+	transaction.
+*/
+status_t
+Inode::AllocateDelayedBlocks()
+{
+	if (fDelayedSize <= Size())
+		return B_OK;
+
+	Transaction transaction(fVolume, BlockNumber());
+	WriteLockInTransaction(transaction);
+
+	off_t size = fDelayedSize;
+	if (size <= Size())
+		return B_OK;
+
+	// If this fails, the inode is reverted with the transaction, and keeps
+	// its delayed size and reserved blocks; we might be able to allocate
+	// them later
+	status_t status = SetFileSize(transaction, size);
+	if (status != B_OK)
+		RETURN_ERROR(status);
+
+	return transaction.Done();
+}
+
+
+/*!	Only the data of files is not written to the log, and may therefore be
+	written to the file cache before its blocks are allocated. Files with
+	inline data are changed in their inode right away.
+*/
+bool
+Inode::_CanDelayAllocation() const
+{
+	return IsFile() && FileCache() != NULL && (Flags() & INODE_LOGGED) == 0
+		&& !HasInlineData();
+}
+
+
+/*!	Grows the file to \a size without allocating any blocks for it yet;
+	only enough blocks are reserved on the volume to be able to do so later
+	on. Since the allocation then sees all of the data written in the mean
+	time, it can choose larger runs for the file.
+	The inode must be write locked.
+*/
+status_t
+Inode::_DelayAllocation(off_t size)
+{
+	// Reserve the data blocks, and some room for the indirect block arrays;
+	// preallocated blocks are ignored, as they might be trimmed before the
+	// allocation happens.
+	off_t blocks = (round_up(size, fVolume->BlockSize())
+		- round_up(Size(), fVolume->BlockSize())) >> fVolume->BlockShift();
+	if (size > Node().data.MaxDirectRange())
+		blocks += NUM_ARRAY_BLOCKS;
+
+	if (blocks > fReservedBlocks) {
+		status_t status = fVolume->ReserveBlocks(blocks - fReservedBlocks);
+		if (status != B_OK)
+			return status;
+
+		fReservedBlocks = blocks;
+	}
+
+	fDelayedSize = size;
+	file_cache_set_size(FileCache(), size);
+		// the file map keeps the allocated size
+	return B_OK;
+}
+
+
+void
+Inode::_CancelDelayedAllocation()
+{
+	if (fReservedBlocks > 0) {
+		fVolume->UnreserveBlocks(fReservedBlocks);
+		fReservedBlocks = 0;
+	}
+	fDelayedSize = 0;
+}
+
+
+/*!	Cancels the delayed allocation once \a transaction has been committed;
+	if it fails, the stream is reverted, and the inode keeps its delayed
+	size and the blocks reserved for it.
+*/
+void
+Inode::_CancelDelayedAllocation(Transaction& transaction)
+{
+	if (fDelayedSize == 0 && fReservedBlocks == 0)
+		return;
+
+	WriteLockInTransaction(transaction);
+	fCancelDelayedAllocation = true;
+}
+
+
+/*!	Returns the largest file that can keep its data in the small_data
+	section of its inode. There must always be room left for the longest
+	possible name, and the end of the section.
+*/
+off_t
+Inode::_MaxInlineDataSize() const
+{
+	// every item has a padding of 3 bytes after its name, and a terminating
+	// null byte after its data
+	int32 overhead = 3 * sizeof(small_data) + INLINE_DATA_NAME_LENGTH + 4
+		+ FILE_NAME_NAME_LENGTH + 4 + B_FILE_NAME_LENGTH - 1;
+
+	return fVolume->InodeSize() - sizeof(bfs_inode) - overhead;
+}
+
+
+/*!	Small files can store their data in the small_data section of their
+	inode instead of a data stream; reading them then does not need any
+	other block than the inode.
+	Only files that do not have any blocks yet may start doing so, and only
+	on volumes that have been initialized for it, as other implementations
+	would not understand them.
+*/
+bool
+Inode::_CanInlineData(off_t size) const
+{
+	if (!IsFile() || FileCache() == NULL || (Flags() & INODE_LOGGED) != 0
+		|| size > _MaxInlineDataSize())
+		return false;
+
+	return HasInlineData()
+		|| (fVolume->HasFeature(SUPER_BLOCK_FEATURE_INLINE_DATA)
+			&& LogicalSize() == 0 && Node().data.MaxDirectRange() == 0);
+}
+
+
+/*!	Writes \a length bytes at \a pos to the inline data of the file, and
+	grows it as needed. Returns \c B_DEVICE_FULL if the data does not fit
+	into the inode.
+	The inode must be write locked.
+*/
+status_t
+Inode::_WriteInlineData(Transaction& transaction, off_t pos,
+	const uint8* buffer, size_t length)
+{
+	off_t size = max_c(Size(), (off_t)(pos + length));
+	if (size > _MaxInlineDataSize())
+		return B_DEVICE_FULL;
+
+	NodeGetter node(fVolume);
+	status_t status = node.SetToWritable(transaction, this);
+	if (status != B_OK)
+		return status;
+
+	RecursiveLocker locker(fSmallDataLock);
+
+	const char name[2] = {INLINE_DATA_NAME, 0};
+	small_data* item = FindSmallData(node.Node(), name);
+	if (item != NULL && pos + length <= item->DataSize()) {
+		// _AddSmallData() would cut off the data behind it
+		if (user_memcpy(item->Data() + pos, buffer, length) != B_OK)
+			return B_BAD_ADDRESS;
+	} else {
+		status = _AddSmallData(transaction, node, name, INLINE_DATA_TYPE, pos,
+			buffer, length);
+		if (status != B_OK)
+			return status;
+	}
+
+	locker.Unlock();
+
+	Node().flags |= HOST_ENDIAN_TO_BFS_INT32(INODE_INLINE_DATA);
+	Node().data.size = HOST_ENDIAN_TO_BFS_INT64(size);
+	file_cache_set_size(FileCache(), size);
+
+	return WriteBack(transaction);
+}
+
+
+/*!	Changes the size of the inline data; the file no longer has inline data
+	when its size is zero. Returns \c B_DEVICE_FULL if the data does not fit
+	into the inode.
+	The inode must be write locked, and written back by the caller.
+*/
+status_t
+Inode::_SetInlineDataSize(Transaction& transaction, off_t size)
+{
+	if (size > _MaxInlineDataSize())
+		return B_DEVICE_FULL;
+
+	NodeGetter node(fVolume);
+	status_t status = node.SetToWritable(transaction, this);
+	if (status != B_OK)
+		return status;
+
+	const char name[2] = {INLINE_DATA_NAME, 0};
+
+	if (size == 0) {
+		status = _RemoveSmallData(transaction, node, name);
+		if (status != B_OK && status != B_ENTRY_NOT_FOUND)
+			return status;
+
+		Node().flags &= ~HOST_ENDIAN_TO_BFS_INT32(INODE_INLINE_DATA);
+	} else {
+		// this cuts off, or fills up the data with zeros
+		status = _AddSmallData(transaction, node, name, INLINE_DATA_TYPE, size,
+			(const uint8*)"", 0);
+		if (status != B_OK)
+			return status;
+	}
+
+	Node().data.size = HOST_ENDIAN_TO_BFS_INT64(size);
+	return B_OK;
+}
+
+
+/*!	Moves the inline data of the file to a data stream, so that it can grow
+	beyond what fits into its inode. Since the data is not necessarily in
+	the file cache, it is written to its new block right away; the file
+	stays intact if the transaction fails, as its inode then still contains
+	the data.
+	The inode must be write locked.
+*/
+status_t
+Inode::_MoveInlineData(Transaction& transaction)
+{
+	off_t size = Size();
+	uint32 blockSize = fVolume->BlockSize();
+
+	uint8* buffer = (uint8*)malloc(blockSize);
+	if (buffer == NULL)
+		return B_NO_MEMORY;
+
+	MemoryDeleter deleter(buffer);
+
+	status_t status = ReadInlineData(0, buffer, blockSize);
+	if (status != B_OK)
+		return status;
+
+	status = _SetInlineDataSize(transaction, 0);
+	if (status == B_OK)
+		status = _GrowStream(transaction, size);
+	if (status != B_OK)
+		return status;
+
+	file_map_set_size(Map(), size);
+
+	if (write_pos(fVolume->Device(), fVolume->ToOffset(Node().data.direct[0]),
+			buffer, blockSize) != (ssize_t)blockSize)
+		RETURN_ERROR(B_IO_ERROR);
+
+	return B_OK;
+}
+
+
+/*!	Copies the inline data of the file to \a buffer; anything beyond the
+	end of the file is filled with zeros.
+	The inode must be locked.
+*/
+status_t
+Inode::ReadInlineData(off_t pos, uint8* buffer, size_t length)
+{
+	NodeGetter node(fVolume);
+	status_t status = node.SetTo(this);
+	if (status != B_OK)
+		return status;
+
+	RecursiveLocker locker(fSmallDataLock);
+
+	const char name[2] = {INLINE_DATA_NAME, 0};
+	const small_data* item = FindSmallData(node.Node(), name);
+	if (item == NULL)
+		RETURN_ERROR(B_BAD_DATA);
+
+	size_t bytes = 0;
+	if (pos < item->DataSize())
+		bytes = min_c(length, item->DataSize() - pos);
+
+	memcpy(buffer, item->Data() + pos, bytes);
+	memset(buffer + bytes, 0, length - bytes);
+	return B_OK;
+}
+
+
+/*!	Is called when the pages of a file with inline data are written back.
+	They usually contain what is in the inode already, but they may also
+	have been changed via a memory mapping; only data within the file size
+	is written.
+	Returns \c B_ENTRY_NOT_FOUND if the file does not have inline data
+	(anymore), and its pages must be written to its data stream instead.
+*/
+status_t
+Inode::WriteBackInlineData(off_t pos, const uint8* buffer, size_t length)
+{
+	const char name[2] = {INLINE_DATA_NAME, 0};
+
+	{
+		InodeReadLocker locker(this);
+
+		if (!HasInlineData())
+			return B_ENTRY_NOT_FOUND;
+		if (pos >= Size())
+			return B_OK;
+		if (pos + (off_t)length > Size())
+			length = Size() - pos;
+
+		NodeGetter node(fVolume);
+		status_t status = node.SetTo(this);
+		if (status != B_OK)
+			return status;
+
+		RecursiveLocker smallDataLocker(fSmallDataLock);
+
+		const small_data* item = FindSmallData(node.Node(), name);
+		if (item != NULL && pos + length <= item->DataSize()
+			&& memcmp(item->Data() + pos, buffer, length) == 0)
+			return B_OK;
+	}
+
+	Transaction transaction(fVolume, BlockNumber());
+	WriteLocker locker(fLock);
+
+	if (!HasInlineData())
+		return B_ENTRY_NOT_FOUND;
+	if (pos >= Size())
+		return B_OK;
+	if (pos + (off_t)length > Size())
+		length = Size() - pos;
+
+	status_t status = _WriteInlineData(transaction, pos, buffer, length);
+	if (status != B_OK)
+		return status;
+
+	return transaction.Done();
+}
+
+
 /*!	Checks whether or not this inode's data stream needs to be trimmed
 	because of an earlier preallocation.
 	Returns true if there are any blocks to be trimmed.
@@ -2386,8 +2943,13 @@ Inode::Free(Transaction& transaction)
 status_t
 Inode::Sync()
 {
-	if (FileCache())
+	if (FileCache()) {
+		status_t status = AllocateDelayedBlocks();
+		if (status != B_OK)
+			return status;
+
 		return file_cache_sync(FileCache());
+	}
 
 	// We may also want to flush the attribute's data stream to
 	// disk here... (do we?)
@@ -2494,7 +3056,10 @@ Inode::TransactionDone(bool success)
 		// Revert any changes made to the cached bfs_inode
 		// TODO: return code gets eaten
 		UpdateNodeFromDisk();
-	}
+	} else if (fCancelDelayedAllocation)
+		_CancelDelayedAllocation();
+
+	fCancelDelayedAllocation = false;
 }
 
 
@@ -2895,8 +3460,7 @@ AttributeIterator::GetNext(char* name, size_t* _length, uint32* _type,
 
 		int32 index = 0;
 		for (; !item->IsLast(node); item = item->Next(), index++) {
-			if (item->NameSize() == FILE_NAME_NAME_LENGTH
-				&& *item->Name() == FILE_NAME_NAME)
+			if (is_reserved_small_data_name(item->Name()))
 				continue;
 
 			if (index >= fCurrentSmallData)
@@ -75,6 +75,9 @@ public:
 			bool				IsLongSymLink() const
 									{ return (Flags() & INODE_LONG_SYMLINK)
 										!= 0; }
+			bool				HasInlineData() const
+									{ return (Flags() & INODE_INLINE_DATA)
+										!= 0; }
 
 			bool				HasUserAccessableStream() const
 									{ return IsFile(); }
@@ -92,6 +95,12 @@ public:
 			int32				Flags() const { return fNode.Flags(); }
 
 			off_t				Size() const { return fNode.data.Size(); }
+			off_t				LogicalSize() const
+									{ return max_c(fDelayedSize, Size()); }
+									// includes data that has been written,
+									// but has no blocks allocated yet
+			off_t				ReservedBlocks() const
+									{ return fReservedBlocks; }
 			off_t				AllocatedSize() const;
 			off_t				LastModified() const
 									{ return fNode.LastModifiedTime(); }
@@ -120,6 +129,10 @@ public:
 			// high-level attribute methods
 			status_t			ReadAttribute(const char* name, int32 type,
 									off_t pos, uint8* buffer, size_t* _length);
+#ifndef FS_SHELL
+			void				ReadAttributes(attr_io_vec* vecs,
+									size_t count);
+#endif
 			status_t			WriteAttribute(Transaction& transaction,
 									const char* name, int32 type, off_t pos,
 									const uint8* buffer, size_t* _length,
@@ -149,10 +162,20 @@ public:
 			status_t			WriteAt(Transaction& transaction, off_t pos,
 									const uint8* buffer, size_t* length);
 			status_t			FillGapWithZeros(off_t oldSize, off_t newSize);
+			status_t			ReadInlineData(off_t pos, uint8* buffer,
+									size_t length);
+			status_t			WriteBackInlineData(off_t pos,
+									const uint8* buffer, size_t length);
 
 			status_t			SetFileSize(Transaction& transaction,
 									off_t size);
 			status_t			Append(Transaction& transaction, off_t bytes);
+			status_t			MoveStream(Transaction& transaction,
+									const block_run* runs, int32 count,
+									data_stream& oldStream);
+			status_t			FreeStream(Transaction& transaction,
+									data_stream& stream);
+			status_t			AllocateDelayedBlocks();
 			status_t			TrimPreallocation(Transaction& transaction);
 			bool				NeedsTrimming() const;
 
@@ -253,6 +276,23 @@ private:
 									off_t size);
 			status_t			_ShrinkStream(Transaction& transaction,
 									off_t size);
+			status_t			_ShrinkStream(Transaction& transaction,
+									data_stream& stream, off_t size);
+
+			bool				_CanDelayAllocation() const;
+			status_t			_DelayAllocation(off_t size);
+			void				_CancelDelayedAllocation();
+			void				_CancelDelayedAllocation(
+									Transaction& transaction);
+
+			off_t				_MaxInlineDataSize() const;
+			bool				_CanInlineData(off_t size) const;
+			status_t			_WriteInlineData(Transaction& transaction,
+									off_t pos, const uint8* buffer,
+									size_t length);
+			status_t			_SetInlineDataSize(Transaction& transaction,
+									off_t size);
+			status_t			_MoveInlineData(Transaction& transaction);
 
 private:
 			rw_lock				fLock;
@@ -264,6 +304,13 @@ private:
 			void*				fMap;
 			bfs_inode			fNode;
 
+			off_t				fDelayedSize;
+			off_t				fReservedBlocks;
+				// the file size including data without allocated blocks,
+				// and the blocks reserved for it
+			bool				fCancelDelayedAllocation;
+				// given up when the current transaction is committed
+
 			off_t				fOldSize;
 			off_t				fOldLastModified;
 				// we need those values to ensure we will remove
@@ -13,27 +13,12 @@
 
 #include "Debug.h"
 #include "Inode.h"
+#include "RunArray.h"
 
 
-struct run_array {
-	int32		count;
-	int32		max_runs;
-	block_run	runs[0];
+static const bigtime_t kMaxUnwrittenTime = 1000000LL;
+	// how long transactions may be batched before they are written to the log
 
-	void Init(int32 blockSize);
-	void Insert(block_run& run);
-
-	int32 CountRuns() const { return BFS_ENDIAN_TO_HOST_INT32(count); }
-	int32 MaxRuns() const { return BFS_ENDIAN_TO_HOST_INT32(max_runs) - 1; }
-		// that -1 accounts for an off-by-one error in Be's BFS implementation
-	const block_run& RunAt(int32 i) const { return runs[i]; }
-
-	static int32 MaxRuns(int32 blockSize);
-
-private:
-	static int _Compare(block_run& a, block_run& b);
-	int32 _FindInsertionIndex(block_run& run);
-};
 
 class RunArrays {
 public:
@@ -164,6 +149,30 @@ add_to_iovec(iovec* vecs, int32& index, int32 max, const void* address,
 }
 
 
+/*!	Gives check_log_transaction() access to the log area of the volume. */
+class LogBlockReader {
+public:
+	LogBlockReader(Volume* volume)
+		:
+		fCached(volume),
+		fLogOffset(volume->ToBlock(volume->Log()))
+	{
+	}
+
+	const void* operator()(uint32 position)
+	{
+		if (fCached.SetTo(fLogOffset + position) != B_OK)
+			return NULL;
+
+		return fCached.Block();
+	}
+
+private:
+	CachedBlock	fCached;
+	off_t		fLogOffset;
+};
+
+
 //	#pragma mark - LogEntry
 
 
@@ -218,18 +227,6 @@ run_array::Insert(block_run& run)
 }
 
 
-/*static*/ int32
-run_array::MaxRuns(int32 blockSize)
-{
-	// For whatever reason, BFS restricts the maximum array size
-	uint32 maxCount = (blockSize - sizeof(run_array)) / sizeof(block_run);
-	if (maxCount < 128)
-		return maxCount;
-
-	return 127;
-}
-
-
 /*static*/ int
 run_array::_Compare(block_run& a, block_run& b)
 {
@@ -407,11 +404,19 @@ Journal::Journal(Volume* volume)
 	fUsed(0),
 	fUnwrittenTransactions(0),
 	fHasSubtransaction(false),
-	fSeparateSubTransactions(false)
+	fSeparateSubTransactions(false),
+	fUnwrittenSince(0),
+	fLogFlushRequested(false),
+	fFlushRequests(0),
+	fFlushesDone(0),
+	fFlushWaiters(0),
+	fFlushStatus(B_OK)
 {
 	recursive_lock_init(&fLock, "bfs journal");
 	mutex_init(&fEntriesLock, "bfs journal entries");
+	mutex_init(&fFlushLock, "bfs journal flush");
 
+	fLogWrittenSem = create_sem(0, "bfs log written");
 	fLogFlusherSem = create_sem(0, "bfs log flusher");
 	fLogFlusher = spawn_kernel_thread(&Journal::_LogFlusher, "bfs log flusher",
 		B_NORMAL_PRIORITY, this);
@@ -424,13 +429,16 @@ Journal::~Journal()
 {
 	FlushLogAndBlocks();
 
-	recursive_lock_destroy(&fLock);
-	mutex_destroy(&fEntriesLock);
-
 	sem_id logFlusher = fLogFlusherSem;
 	fLogFlusherSem = -1;
 	delete_sem(logFlusher);
 	wait_for_thread(fLogFlusher, NULL);
+
+	delete_sem(fLogWrittenSem);
+
+	recursive_lock_destroy(&fLock);
+	mutex_destroy(&fEntriesLock);
+	mutex_destroy(&fFlushLock);
 }
 
 
@@ -470,6 +478,27 @@ Journal::_CheckRunArray(const run_array* array)
 }
 
 
+/*!	Makes sure that the transaction at \a start in the log has been written
+	completely, and sets \a _next to the log position after it.
+	Returns \c B_BAD_DATA if the transaction is incomplete, and \c B_ERROR
+	if its log entry is damaged.
+*/
+status_t
+Journal::_CheckTransaction(int32 start, int32& _next)
+{
+	LogBlockReader reader(fVolume);
+
+	uint32 next;
+	status_t status = check_log_transaction(reader, fVolume->BlockSize(),
+		fLogSize, start, fVolume->LogEnd(), next);
+	if (status != B_OK)
+		return status;
+
+	_next = next;
+	return B_OK;
+}
+
+
 /*!	Replays an entry in the log.
 	\a _start points to the entry in the log, and will be bumped to the next
 	one if replaying succeeded.
@@ -594,13 +623,33 @@ Journal::ReplayLog()
 		}
 		lastStart = start;
 
-		status_t status = _ReplayRunArray(&start);
+		// Only replay transactions that made it to the log completely; since
+		// the log end pointer is written after the log entries, a torn entry
+		// can only be the last one in the log.
+		int32 next;
+		status_t status = _CheckTransaction(start, next);
+		if (status == B_BAD_DATA) {
+			INFORM(("log entry at %d is incomplete, discarding the rest of "
+				"the log\n", (int)start));
+			fVolume->SuperBlock().log_end = HOST_ENDIAN_TO_BFS_INT64(start);
+			fVolume->LogEnd() = start;
+			break;
+		}
 		if (status != B_OK) {
-			FATAL(("replaying log entry from %d failed: %s\n", (int)start,
+			FATAL(("reading log entry from %d failed: %s\n", (int)start,
 				strerror(status)));
 			return B_ERROR;
 		}
-		start = start % fLogSize;
+
+		while (start != next) {
+			status = _ReplayRunArray(&start);
+			if (status != B_OK) {
+				FATAL(("replaying log entry from %d failed: %s\n", (int)start,
+					strerror(status)));
+				return B_ERROR;
+			}
+			start = start % fLogSize;
+		}
 	}
 
 	PRINT(("replaying worked fine!\n"));
@@ -705,6 +754,11 @@ Journal::_TransactionIdle(int32 transactionID, int32 event, void* _journal)
 }
 
 
+/*!	Writes the current log entry to disk whenever it has been idle for a
+	while, or when it has been requested via _RequestLogFlush(). In the latter
+	case, it will also wake up all threads waiting in FlushLog() for that
+	request.
+*/
 /*static*/ status_t
 Journal::_LogFlusher(void* _journal)
 {
@@ -713,12 +767,81 @@ Journal::_LogFlusher(void* _journal)
 		if (acquire_sem(journal->fLogFlusherSem) != B_OK)
 			continue;
 
-		journal->_FlushLog(false, false);
+		mutex_lock(&journal->fFlushLock);
+		int32 request = journal->fFlushRequests;
+		bool requested = request != journal->fFlushesDone;
+		mutex_unlock(&journal->fFlushLock);
+
+		// An idle transaction is only written if nobody is using the journal
+		// right now, but requests have to be served in any case
+		status_t status = journal->_FlushLog(requested, false);
+		if (!requested)
+			continue;
+
+		mutex_lock(&journal->fFlushLock);
+		journal->fFlushesDone = request;
+		journal->fFlushStatus = status;
+		int32 waiters = journal->fFlushWaiters;
+		journal->fFlushWaiters = 0;
+		mutex_unlock(&journal->fFlushLock);
+
+		if (waiters > 0)
+			release_sem_etc(journal->fLogWrittenSem, waiters, 0);
 	}
 	return B_OK;
 }
 
 
+/*!	Asks the log flusher to write the current log entry to disk, and returns
+	the number of the request.
+*/
+int32
+Journal::_RequestLogFlush()
+{
+	mutex_lock(&fFlushLock);
+	int32 request = ++fFlushRequests;
+	mutex_unlock(&fFlushLock);
+
+	release_sem(fLogFlusherSem);
+	return request;
+}
+
+
+/*!	Fills in the tail of the \a array, including the checksum over the array
+	and all of its blocks. If \a continued is \c true, the next array in the
+	log belongs to the same transaction.
+*/
+status_t
+Journal::_ChecksumRunArray(run_array* array, bool continued)
+{
+	int32 blockSize = fVolume->BlockSize();
+
+	log_entry_tail& tail = array->Tail();
+	tail.magic = HOST_ENDIAN_TO_BFS_INT16(LOG_ENTRY_TAIL_MAGIC);
+	tail.flags = HOST_ENDIAN_TO_BFS_INT16(continued ? LOG_ENTRY_CONTINUED : 0);
+
+	uint32 checksum = array->StartChecksum(blockSize);
+
+	for (int32 i = 0; i < array->CountRuns(); i++) {
+		const block_run& run = array->RunAt(i);
+		off_t blockNumber = fVolume->ToBlock(run);
+
+		for (int32 j = 0; j < run.Length(); j++) {
+			const void* data = block_cache_get(fVolume->BlockCache(),
+				blockNumber + j);
+			if (data == NULL)
+				return B_IO_ERROR;
+
+			checksum = run_array::AddToChecksum(checksum, data, blockSize);
+			block_cache_put(fVolume->BlockCache(), blockNumber + j);
+		}
+	}
+
+	tail.checksum = HOST_ENDIAN_TO_BFS_INT32(checksum);
+	return B_OK;
+}
+
+
 /*!	Writes the blocks that are part of current transaction into the log,
 	and ends the current transaction.
 	If the current transaction is too large to fit into the log, it will
@@ -731,6 +854,7 @@ Journal::_WriteTransactionToLog()
 	//	changed blocks back to disk immediately (hello disk corruption!)
 
 	bool detached = false;
+	fLogFlushRequested = false;
 
 	if (_TransactionSize() > fLogSize) {
 		// The current transaction won't fit into the log anymore, try to
@@ -812,6 +936,11 @@ Journal::_WriteTransactionToLog()
 		int32 index = 0, count = 1;
 		int32 wrap = fLogSize - logStart;
 
+		status = _ChecksumRunArray(array,
+			k < runArrays.CountArrays() - 1);
+		if (status != B_OK)
+			return status;
+
 		add_to_iovec(vecs, index, maxVecs, (void*)array, fVolume->BlockSize());
 
 		// add block runs
@@ -956,6 +1085,36 @@ Journal::_FlushLog(bool canWait, bool flushBlocks)
 }
 
 
+/*!	Writes all transactions that are done to the log, and waits until they
+	are on disk. The actual work is done by the log flusher, so that all
+	threads calling this at the same time share a single log write.
+	Must not be called from within a transaction.
+*/
+status_t
+Journal::FlushLog()
+{
+	if (fUnwrittenTransactions == 0)
+		return B_OK;
+	if (fLogFlusher < 0)
+		return _FlushLog(true, false);
+
+	int32 request = _RequestLogFlush();
+
+	MutexLocker locker(fFlushLock);
+
+	while (fFlushesDone < request) {
+		fFlushWaiters++;
+		locker.Unlock();
+
+		acquire_sem(fLogWrittenSem);
+
+		locker.Lock();
+	}
+
+	return fFlushStatus;
+}
+
+
 /*!	Flushes the current log entry to disk, and also writes back all dirty
 	blocks for this volume (completing all open transactions).
 */
@@ -966,6 +1125,94 @@ Journal::FlushLogAndBlocks()
 }
 
 
+/*!	Grows the log area to \a length blocks. The blocks directly following
+	the current log area must be free; they are allocated first, and only
+	become part of the log once it has been emptied completely. If we crash
+	in between, the blocks are just lost until the volume is checked.
+	Must not be called from within a transaction.
+*/
+status_t
+Journal::GrowLog(uint32 length)
+{
+	if (fVolume->IsReadOnly())
+		return B_READ_ONLY_DEVICE;
+
+	block_run log = fVolume->Log();
+	if (length == log.Length())
+		return B_OK;
+	if (length < log.Length() || length > MAX_BLOCK_RUN_LENGTH)
+		return B_BAD_VALUE;
+
+	uint32 end = log.Start() + length;
+	if (end > (1UL << fVolume->AllocationGroupShift()))
+		return B_DEVICE_FULL;
+
+	// Allocate the blocks after the log; the allocator is free to choose
+	// another range, so we have to check what we got
+
+	block_run run;
+	{
+		Transaction transaction(fVolume, fVolume->ToBlock(log));
+		uint16 blocks = length - log.Length();
+
+		status_t status = fVolume->Allocator().AllocateBlocks(transaction,
+			log.AllocationGroup(), log.Start() + log.Length(), blocks, blocks,
+			run);
+		if (status != B_OK)
+			return status;
+
+		if (run.AllocationGroup() != log.AllocationGroup()
+			|| run.Start() != log.Start() + log.Length()) {
+			fVolume->Allocator().Free(transaction, run);
+			transaction.Done();
+			return B_DEVICE_FULL;
+		}
+
+		status = transaction.Done();
+		if (status != B_OK)
+			return status;
+	}
+
+	// Empty the log, and keep it that way until the superblock is updated
+
+	RecursiveLocker locker(fLock);
+
+	status_t status = B_OK;
+	if (fUnwrittenTransactions != 0)
+		status = _WriteTransactionToLog();
+	if (status == B_OK)
+		status = fVolume->FlushDevice();
+	if (status == B_OK) {
+		MutexLocker entriesLocker(fEntriesLock);
+		if (!fEntries.IsEmpty())
+			status = B_BUSY;
+	}
+
+	if (status == B_OK) {
+		fVolume->SuperBlock().log_blocks.length
+			= HOST_ENDIAN_TO_BFS_INT16(length);
+		status = fVolume->WriteSuperBlock();
+		if (status != B_OK)
+			fVolume->SuperBlock().log_blocks = log;
+	}
+
+	if (status != B_OK) {
+		locker.Unlock();
+
+		Transaction transaction(fVolume, fVolume->ToBlock(run));
+		if (fVolume->Allocator().Free(transaction, run) == B_OK)
+			transaction.Done();
+		return status;
+	}
+
+	fLogSize = length;
+	fMaxTransactionSize = fLogSize / 2 - 5;
+
+	INFORM(("log grown to %" B_PRIu32 " blocks\n", length));
+	return B_OK;
+}
+
+
 status_t
 Journal::Lock(Transaction* owner, bool separateSubTransactions)
 {
@@ -1083,16 +1330,28 @@ Journal::_TransactionDone(bool success)
 	// Up to a maximum size, we will just batch several
 	// transactions together to improve speed
 	uint32 size = _TransactionSize();
-	if (size < fMaxTransactionSize) {
+	if (size < fMaxTransactionSize
+		|| (fLogFlusher >= 0 && size < fMaxTransactionSize * 3 / 2)) {
 		// Flush the log from time to time, so that we have enough space
 		// for this transaction
 		if (size > FreeLogBlocks())
 			cache_sync_transaction(fVolume->BlockCache(), fTransactionID);
 
-		fUnwrittenTransactions++;
+		if (fUnwrittenTransactions++ == 0)
+			fUnwrittenSince = system_time();
+
+		// Once the batch is large or old enough, the log flusher will write
+		// it as soon as it gets the journal, so that we don't have to wait
+		// for the log here
+		if (!fLogFlushRequested && (size >= fMaxTransactionSize
+				|| system_time() - fUnwrittenSince > kMaxUnwrittenTime)) {
+			fLogFlushRequested = true;
+			_RequestLogFlush();
+		}
 		return B_OK;
 	}
 
+	// the log flusher could not keep up, write the log entry ourselves
 	return _WriteTransactionToLog();
 }
 
@@ -1114,6 +1373,10 @@ Journal::Dump()
 	kprintf("  max transaction size: %" B_PRIu32 "\n", fMaxTransactionSize);
 	kprintf("  used:                 %" B_PRIu32 "\n", fUsed);
 	kprintf("  unwritten:            %" B_PRId32 "\n", fUnwrittenTransactions);
+	kprintf("  unwritten since:      %" B_PRId64 "\n", fUnwrittenSince);
+	kprintf("  flush requested:      %d\n", fLogFlushRequested);
+	kprintf("  flush requests:       %" B_PRId32 " (%" B_PRId32 " done)\n",
+		fFlushRequests, fFlushesDone);
 	kprintf("  timestamp:            %" B_PRId64 "\n", fTimestamp);
 	kprintf("  transaction ID:       %" B_PRId32 "\n", fTransactionID);
 	kprintf("  has subtransaction:   %d\n", fHasSubtransaction);
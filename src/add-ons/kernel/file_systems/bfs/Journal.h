@@ -35,7 +35,9 @@ public:
 			size_t			CurrentTransactionSize() const;
 			bool			CurrentTransactionTooLarge() const;
 
+			status_t		FlushLog();
 			status_t		FlushLogAndBlocks();
+			status_t		GrowLog(uint32 length);
 			Volume*			GetVolume() const { return fVolume; }
 			int32			TransactionID() const { return fTransactionID; }
 
@@ -52,9 +54,12 @@ private:
 			status_t		_FlushLog(bool canWait, bool flushBlocks);
 			uint32			_TransactionSize() const;
 			status_t		_WriteTransactionToLog();
+			status_t		_ChecksumRunArray(run_array* array, bool continued);
 			status_t		_CheckRunArray(const run_array* array);
+			status_t		_CheckTransaction(int32 start, int32& _next);
 			status_t		_ReplayRunArray(int32* start);
 			status_t		_TransactionDone(bool success);
+			int32			_RequestLogFlush();
 
 	static	void			_TransactionWritten(int32 transactionID,
 								int32 event, void* _logEntry);
@@ -77,8 +82,19 @@ private:
 			bool			fHasSubtransaction;
 			bool			fSeparateSubTransactions;
 
+			bigtime_t		fUnwrittenSince;
+			bool			fLogFlushRequested;
+
 			thread_id		fLogFlusher;
 			sem_id			fLogFlusherSem;
+
+			mutex			fFlushLock;
+			sem_id			fLogWrittenSem;
+			int32			fFlushRequests;
+			int32			fFlushesDone;
+			int32			fFlushWaiters;
+			status_t		fFlushStatus;
+				// these are guarded by fFlushLock
 };
 
 
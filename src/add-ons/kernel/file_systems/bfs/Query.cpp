@@ -1,5 +1,5 @@
 /*
- * Copyright 2001-2020, Axel Dörfler, axeld@pinc-software.de.
+ * Copyright 2001-2026, Axel Dörfler, axeld@pinc-software.de.
  * Copyright 2010, Clemens Zeidler <haiku@clemens-zeidler.de>
  * This file may be used under the terms of the MIT License.
  */
@@ -23,6 +23,7 @@
 #include "Debug.h"
 #include "Index.h"
 #include "Inode.h"
+#include "TrigramIndex.h"
 #include "Volume.h"
 
 
@@ -70,6 +71,41 @@ union value {
 };
 
 
+// The selectivity of a term is the share of entries it is expected to match,
+// as a fixed point value; kSelectivityOne means all of them.
+static const uint32 kSelectivityOne = 65536;
+
+// Used when there are no statistics for an index; these are the classic
+// defaults used by relational databases.
+static const uint32 kDefaultEqualSelectivity = kSelectivityOne / 100;
+static const uint32 kDefaultRangeSelectivity = kSelectivityOne / 3;
+static const uint32 kDefaultPatternSelectivity = kSelectivityOne / 10;
+static const uint32 kDefaultTrigramSelectivity = kSelectivityOne / 256;
+	// for a trigram made of common characters only, out of all entries of
+	// the trigram index; every rare character halves it
+
+static const int32 kAverageIndexEntrySize = 32;
+	// the space an entry takes in a B+tree on average, including the node
+	// overhead, and the space left free in the nodes
+
+
+/*!	Collects the text of a query plan in a buffer of fixed size; what does
+	not fit is cut off, but still counted.
+*/
+class QueryPlanWriter {
+public:
+								QueryPlanWriter(char* buffer, size_t size);
+
+			void				Print(int32 level, const char* format, ...);
+			size_t				Length() const { return fLength; }
+
+private:
+			char*				fBuffer;
+			size_t				fSize;
+			size_t				fLength;
+};
+
+
 /*!	Abstract base class for the operator/equation classes.
 */
 class Term {
@@ -88,8 +124,15 @@ public:
 									size_t size = 0) = 0;
 	virtual	void				Complement() = 0;
 
-	virtual	void				CalculateScore(Index& index) = 0;
-	virtual	int32				Score() const = 0;
+	virtual	void				Estimate(Volume* volume, Index& index,
+									bool useStatistics) = 0;
+	virtual	bool				IsIndexed() const = 0;
+	virtual	int64				Cost() const = 0;
+	virtual	uint32				Selectivity() const = 0;
+
+	virtual	int64				VisitedEntries() const = 0;
+	virtual	void				Explain(QueryPlanWriter& writer,
+									int32 level) = 0;
 
 	virtual	status_t			InitCheck() = 0;
 
@@ -108,7 +151,7 @@ protected:
 	Although an Equation object is quite independent from the volume on which
 	the query is run, there are some dependencies that are produced while
 	querying:
-	The type/size of the value, the score, and if it has an index or not.
+	The type/size of the value, the estimates, and if it has an index or not.
 	So you could run more than one query on the same volume, but it might return
 	wrong values when it runs concurrently on another volume.
 	That's not an issue right now, because we run single-threaded and don't use
@@ -134,8 +177,16 @@ public:
 									TreeIterator* iterator,
 									struct dirent* dirent, size_t bufferSize);
 
-	virtual	void				CalculateScore(Index &index);
-	virtual	int32				Score() const { return fScore; }
+			void				SetDriving() { fDriving = true; }
+
+	virtual	void				Estimate(Volume* volume, Index& index,
+									bool useStatistics);
+	virtual	bool				IsIndexed() const { return fIndexed; }
+	virtual	int64				Cost() const { return fCost; }
+	virtual	uint32				Selectivity() const { return fSelectivity; }
+
+	virtual	int64				VisitedEntries() const { return fVisited; }
+	virtual	void				Explain(QueryPlanWriter& writer, int32 level);
 
 #ifdef DEBUG
 	virtual	void				PrintToStream();
@@ -153,6 +204,14 @@ private:
 			status_t			_ConvertValue(type_code type);
 			bool				_CompareTo(const uint8* value, uint16 size);
 			uint8*				_Value() const { return (uint8*)&fValue; }
+			status_t			_EstimateMatches(Volume* volume, Index& index,
+									int64& _matches, int64& _entries);
+			void				_EstimateTrigrams(Volume* volume, Index& index,
+									bool useStatistics);
+			status_t			_PrepareTrigramQuery(Index& index,
+									TreeIterator** iterator);
+			bool				_IsTrigramKey(const uint8* key,
+									uint16 length) const;
 
 private:
 			char*				fAttribute;
@@ -163,8 +222,19 @@ private:
 			bool				fIsPattern;
 			bool				fIsSpecialTime;
 
-			int32				fScore;
 			bool				fHasIndex;
+
+			bool				fIndexed;
+			bool				fHasStatistics;
+			bool				fDriving;
+			int64				fCost;
+			uint32				fSelectivity;
+			int64				fVisited;
+			int64				fMatches;
+
+			bool				fUseTrigrams;
+			uint32				fTrigram;
+			char				fTrigramIndex[B_FILE_NAME_LENGTH];
 };
 
 
@@ -185,8 +255,16 @@ public:
 									size_t size = 0);
 	virtual	void				Complement();
 
-	virtual	void				CalculateScore(Index& index);
-	virtual	int32				Score() const;
+			Term*				Driver() const;
+
+	virtual	void				Estimate(Volume* volume, Index& index,
+									bool useStatistics);
+	virtual	bool				IsIndexed() const { return fIndexed; }
+	virtual	int64				Cost() const { return fCost; }
+	virtual	uint32				Selectivity() const { return fSelectivity; }
+
+	virtual	int64				VisitedEntries() const;
+	virtual	void				Explain(QueryPlanWriter& writer, int32 level);
 
 	virtual	status_t			InitCheck();
 
@@ -202,19 +280,134 @@ private:
 private:
 			Term*				fLeft;
 			Term*				fRight;
+
+			bool				fIndexed;
+			int64				fCost;
+			uint32				fSelectivity;
 };
 
 
 //	#pragma mark -
 
 
+static const char*
+operator_symbol(int8 op)
+{
+	switch (op) {
+		case OP_AND: return "AND";
+		case OP_OR: return "OR";
+		case OP_EQUAL: return "==";
+		case OP_UNEQUAL: return "!=";
+		case OP_GREATER_THAN: return ">";
+		case OP_GREATER_THAN_OR_EQUAL: return ">=";
+		case OP_LESS_THAN: return "<";
+		case OP_LESS_THAN_OR_EQUAL: return "<=";
+	}
+	return "???";
+}
+
+
+//!	Returns the selectivity in hundredths of a percent.
+static uint32
+selectivity_percent(uint32 selectivity)
+{
+	return (uint32)(((uint64)selectivity * 10000 + kSelectivityOne / 2)
+		/ kSelectivityOne);
+}
+
+
+//!	Guesses the number of entries in an index from its size.
+static int64
+estimated_index_entries(Inode* index)
+{
+	return index->Size() / kAverageIndexEntrySize;
+}
+
+
+/*!	Guesses the share of the entries of a trigram index that contain the
+	trigram, from how common its characters are in file names.
+*/
+static uint32
+default_trigram_selectivity(uint32 trigram)
+{
+	static const char* kCommon = "etaoinsrhl ._-";
+
+	uint32 selectivity = kDefaultTrigramSelectivity;
+	for (int32 i = 0; i < TRIGRAM_LENGTH; i++, trigram >>= 8) {
+		uint8 c = trigram & 0xff;
+		if (c == '\0' || strchr(kCommon, c) == NULL)
+			selectivity /= 2;
+	}
+	return selectivity;
+}
+
+
+static uint32
+default_selectivity(int8 op, bool isPattern)
+{
+	switch (op) {
+		case OP_EQUAL:
+			return isPattern
+				? kDefaultPatternSelectivity : kDefaultEqualSelectivity;
+		case OP_UNEQUAL:
+			return isPattern ? kSelectivityOne - kDefaultPatternSelectivity
+				: kSelectivityOne - kDefaultEqualSelectivity;
+		default:
+			return kDefaultRangeSelectivity;
+	}
+}
+
+
+QueryPlanWriter::QueryPlanWriter(char* buffer, size_t size)
+	:
+	fBuffer(buffer),
+	fSize(size),
+	fLength(0)
+{
+	if (fSize > 0)
+		fBuffer[0] = '\0';
+}
+
+
+void
+QueryPlanWriter::Print(int32 level, const char* format, ...)
+{
+	for (int32 i = 0; i < level; i++)
+		Print(0, "  ");
+
+	va_list args;
+	va_start(args, format);
+
+	size_t available = fLength < fSize ? fSize - fLength : 0;
+	int length = vsnprintf(available > 0 ? fBuffer + fLength : NULL,
+		available, format, args);
+	if (length > 0)
+		fLength += length;
+
+	va_end(args);
+}
+
+
+//	#pragma mark -
+
+
 Equation::Equation(char** _expression)
 	:
 	Term(OP_EQUATION),
 	fAttribute(NULL),
 	fString(NULL),
 	fType(0),
-	fIsPattern(false)
+	fIsPattern(false),
+	fHasIndex(false),
+	fIndexed(false),
+	fHasStatistics(false),
+	fDriving(false),
+	fCost(0),
+	fSelectivity(kSelectivityOne),
+	fVisited(0),
+	fMatches(0),
+	fUseTrigrams(false),
+	fTrigram(0)
 {
 	char* string = *_expression;
 	char* start = string;
@@ -483,6 +676,9 @@ status_t
 Equation::PrepareQuery(Volume* /*volume*/, Index& index,
 	TreeIterator** iterator, bool queryNonIndexed)
 {
+	if (fUseTrigrams)
+		return _PrepareTrigramQuery(index, iterator);
+
 	status_t status = index.SetTo(fAttribute);
 
 	// if we should query attributes without an index, we can just proceed here
@@ -591,6 +787,14 @@ Equation::GetNextMatching(Volume* volume, TreeIterator* iterator,
 		if (status != B_OK)
 			return status;
 
+		fVisited++;
+
+		// the trigram index only contains candidates, they are matched below;
+		// duplicates don't come with their key, they all share the first one
+		if (fUseTrigrams && duplicate < 2
+			&& !_IsTrigramKey((uint8*)&indexValue, keyLength))
+			return B_ENTRY_NOT_FOUND;
+
 		// only compare against the index entry when this is the correct
 		// index for the equation
 		if (fHasIndex && duplicate < 2
@@ -677,44 +881,93 @@ Equation::GetNextMatching(Volume* volume, TreeIterator* iterator,
 			}
 		}
 
-		if (status == MATCH_OK)
+		if (status == MATCH_OK) {
+			fMatches++;
 			return B_OK;
+		}
 	}
 	RETURN_ERROR(B_ERROR);
 }
 
 
+/*!	Estimates how many index entries have to be visited when this equation
+	drives the query, and which share of the entries it matches.
+	The statistics of the index are only used if \a useStatistics is true,
+	as gathering them requires reading the whole index once.
+*/
 void
-Equation::CalculateScore(Index &index)
+Equation::Estimate(Volume* volume, Index& index, bool useStatistics)
 {
-	// As always, these values could be tuned and refined.
-	// And the code could also need some real world testing :-)
+	fHasStatistics = false;
+	fUseTrigrams = false;
 
 	// do we have to operate on a "foreign" index?
-	if (fOp == OP_UNEQUAL || index.SetTo(fAttribute) < B_OK) {
-		fScore = 0;
+	if (fOp == OP_UNEQUAL || index.SetTo(fAttribute) != B_OK) {
+		// then the whole name index has to be visited
+		fIndexed = false;
+		fCost = index.SetTo("name") == B_OK
+			? estimated_index_entries(index.Node()) : 0;
+		fSelectivity = default_selectivity(fOp, fIsPattern);
+
+		if (fOp == OP_EQUAL && fIsPattern && volume->HasTrigramIndices())
+			_EstimateTrigrams(volume, index, useStatistics);
 		return;
 	}
 
-	// if we have a pattern, how much does it help our search?
-	if (fIsPattern)
-		fScore = getFirstPatternSymbol(fString) << 3;
-	else {
-		// Score by operator
-		if (fOp == OP_EQUAL)
-			// higher than pattern="255 chars+*"
-			fScore = 2048;
-		else
-			// the pattern search is regarded cheaper when you have at
-			// least one character to set your index to
-			fScore = 5;
+	fIndexed = true;
+	_ConvertValue(index.Type());
+
+	int64 matches;
+	int64 entries;
+	if (useStatistics
+		&& _EstimateMatches(volume, index, matches, entries) == B_OK) {
+		fHasStatistics = true;
+	} else {
+		entries = estimated_index_entries(index.Node());
+		matches = entries * default_selectivity(fOp, fIsPattern)
+			/ kSelectivityOne;
+	}
+
+	fCost = matches;
+	if (fIsPattern && getFirstPatternSymbol(fString) <= 0) {
+		// the iterator cannot be positioned
+		fCost = entries;
 	}
 
-	// take index size into account (1024 is the current node size
-	// in our B+trees)
-	// 2048 * 2048 == 4194304 is the maximum score (for an empty
-	// tree, since the header + 1 node are already 2048 bytes)
-	fScore = fScore * ((2048 * 1024LL) / index.Node()->Size());
+	if (entries > 0) {
+		fSelectivity = (uint32)min_c(matches * kSelectivityOne / entries,
+			(int64)kSelectivityOne);
+	} else
+		fSelectivity = 0;
+
+	if (fOp == OP_EQUAL && fIsPattern && volume->HasTrigramIndices())
+		_EstimateTrigrams(volume, index, useStatistics);
+}
+
+
+void
+Equation::Explain(QueryPlanWriter& writer, int32 level)
+{
+	const char* access = "no index";
+	if (fUseTrigrams)
+		access = fHasStatistics ? "trigram index statistics" : "trigram index";
+	else if (fIndexed)
+		access = fHasStatistics ? "index statistics" : "index";
+
+	uint32 percent = selectivity_percent(fSelectivity);
+	writer.Print(level, "\"%s\" %s \"%s\": %s", fAttribute,
+		operator_symbol(fOp), fString, access);
+	if (fUseTrigrams) {
+		writer.Print(0, " \"%c%c%c\"", (char)(fTrigram >> 16),
+			(char)(fTrigram >> 8), (char)fTrigram);
+	}
+	writer.Print(0, ", cost %" B_PRId64 ", selectivity %" B_PRIu32 ".%02"
+		B_PRIu32 "%%", fCost, percent / 100, percent % 100);
+	if (fDriving) {
+		writer.Print(0, ", drives the query: visited %" B_PRId64
+			", matched %" B_PRId64, fVisited, fMatches);
+	}
+	writer.Print(0, "\n");
 }
 
 
@@ -888,6 +1141,175 @@ Equation::_CompareTo(const uint8* value, uint16 size)
 }
 
 
+/*!	Asks the statistics of the index for the number of entries in the key
+	range the equation covers. You have to call ConvertValue() before this
+	one.
+*/
+status_t
+Equation::_EstimateMatches(Volume* volume, Index& index, int64& _matches,
+	int64& _entries)
+{
+	union value lowerValue;
+	union value upperValue;
+	const uint8* lower = NULL;
+	const uint8* upper = NULL;
+	uint16 lowerLength = fSize;
+	uint16 upperLength = fSize;
+
+	if (fIsSpecialTime) {
+		// the index contains shifted values
+		lowerValue.Int64 = fValue.Int64 << INODE_TIME_SHIFT;
+		upperValue.Int64 = ((fValue.Int64 + 1) << INODE_TIME_SHIFT) - 1;
+	} else {
+		memcpy(&lowerValue, &fValue, sizeof(union value));
+		memcpy(&upperValue, &fValue, sizeof(union value));
+	}
+
+	switch (fOp) {
+		case OP_EQUAL:
+			if (fIsPattern) {
+				// all keys starting with the part before the first pattern
+				// symbol
+				int32 prefix = getFirstPatternSymbol(fString);
+				if (prefix <= 0)
+					break;
+
+				prefix = min_c(prefix, MAX_INDEX_KEY_LENGTH - 1);
+				upperValue.String[prefix] = (char)0xff;
+				lower = (const uint8*)&lowerValue;
+				lowerLength = prefix;
+				upper = (const uint8*)&upperValue;
+				upperLength = prefix + 1;
+				break;
+			}
+			lower = (const uint8*)&lowerValue;
+			upper = (const uint8*)(fIsSpecialTime ? &upperValue : &lowerValue);
+			break;
+		case OP_GREATER_THAN:
+		case OP_GREATER_THAN_OR_EQUAL:
+			lower = (const uint8*)&lowerValue;
+			break;
+		case OP_LESS_THAN:
+		case OP_LESS_THAN_OR_EQUAL:
+			upper = (const uint8*)&lowerValue;
+			break;
+		default:
+			return B_BAD_VALUE;
+	}
+
+	status_t status = volume->EstimateIndex(index, lower, lowerLength, upper,
+		upperLength, _matches, _entries);
+	if (status != B_OK)
+		return status;
+
+	if (fIsPattern && lower == NULL) {
+		_matches = _entries * default_selectivity(fOp, fIsPattern)
+			/ kSelectivityOne;
+	}
+	return B_OK;
+}
+
+
+/*!	Checks if the trigram index of the attribute is a cheaper way to find
+	the candidates for the pattern than the access path chosen before, and
+	if so, picks its rarest trigram to drive the query.
+	Every value that matches the pattern contains all of its trigrams, so
+	visiting the files that contain one of them is enough.
+*/
+void
+Equation::_EstimateTrigrams(Volume* volume, Index& index, bool useStatistics)
+{
+	if (!get_trigram_index_name(fAttribute, fTrigramIndex)
+		|| index.SetTo(fTrigramIndex) != B_OK
+		|| index.Type() != B_STRING_TYPE
+		|| !index.IsComplete())
+		return;
+
+	uint32* trigrams = (uint32*)malloc(MAX_TRIGRAMS * sizeof(uint32));
+	if (trigrams == NULL)
+		return;
+	MemoryDeleter deleter(trigrams);
+
+	int32 count = collect_pattern_trigrams(fString, trigrams);
+	if (count == 0)
+		return;
+
+	int64 entries = estimated_index_entries(index.Node());
+	int64 bestCost = -1;
+	uint32 best = 0;
+	bool hasStatistics = false;
+
+	for (int32 i = 0; i < count; i++) {
+		uint8 key[TRIGRAM_LENGTH];
+		get_trigram_key(trigrams[i], key);
+
+		int64 matches;
+		if (useStatistics && volume->EstimateIndex(index, key, TRIGRAM_LENGTH,
+				key, TRIGRAM_LENGTH, matches, entries) == B_OK) {
+			hasStatistics = true;
+		} else {
+			// no need to try again for the other trigrams
+			useStatistics = false;
+			matches = entries * default_trigram_selectivity(trigrams[i])
+				/ kSelectivityOne;
+		}
+
+		if (bestCost < 0 || matches < bestCost) {
+			bestCost = matches;
+			best = trigrams[i];
+		}
+	}
+
+	if (fIndexed && bestCost >= fCost)
+		return;
+
+	fUseTrigrams = true;
+	fTrigram = best;
+	fIndexed = true;
+	fHasStatistics = hasStatistics;
+	fCost = bestCost;
+}
+
+
+/*!	Positions the iterator at the entries of the chosen trigram; since the
+	trigram index only contains candidates, they all have to be matched
+	against the attribute.
+*/
+status_t
+Equation::_PrepareTrigramQuery(Index& index, TreeIterator** iterator)
+{
+	if (index.SetTo(fTrigramIndex) != B_OK || !index.IsComplete())
+		return B_ENTRY_NOT_FOUND;
+
+	fHasIndex = false;
+
+	if (_ConvertValue(B_STRING_TYPE) < B_OK)
+		return B_BAD_VALUE;
+
+	BPlusTree* tree = index.Node()->Tree();
+	if (tree == NULL)
+		return B_ERROR;
+
+	*iterator = new(std::nothrow) TreeIterator(tree);
+	if (*iterator == NULL)
+		return B_NO_MEMORY;
+
+	uint8 key[TRIGRAM_LENGTH];
+	get_trigram_key(fTrigram, key);
+	return (*iterator)->Find(key, TRIGRAM_LENGTH);
+}
+
+
+bool
+Equation::_IsTrigramKey(const uint8* key, uint16 length) const
+{
+	uint8 trigram[TRIGRAM_LENGTH];
+	get_trigram_key(fTrigram, trigram);
+
+	return length == TRIGRAM_LENGTH && !memcmp(key, trigram, TRIGRAM_LENGTH);
+}
+
+
 //	#pragma mark -
 
 
@@ -895,7 +1317,10 @@ Operator::Operator(Term* left, int8 op, Term* right)
 	:
 	Term(op),
 	fLeft(left),
-	fRight(right)
+	fRight(right),
+	fIndexed(false),
+	fCost(0),
+	fSelectivity(kSelectivityOne)
 {
 	if (left)
 		left->SetParent(this);
@@ -916,19 +1341,24 @@ Operator::Match(Inode* inode, const char* attribute, int32 type,
 	const uint8* key, size_t size)
 {
 	if (fOp == OP_AND) {
-		status_t status = fLeft->Match(inode, attribute, type, key, size);
+		// start with the term that is least likely to match
+		Term* first = fLeft;
+		Term* second = fRight;
+		if (fRight->Selectivity() < fLeft->Selectivity()) {
+			first = fRight;
+			second = fLeft;
+		}
+
+		status_t status = first->Match(inode, attribute, type, key, size);
 		if (status != MATCH_OK)
 			return status;
 
-		return fRight->Match(inode, attribute, type, key, size);
+		return second->Match(inode, attribute, type, key, size);
 	} else {
-		// choose the term with the better score for OP_OR
-		Term* first;
-		Term* second;
-		if (fRight->Score() > fLeft->Score()) {
-			first = fLeft;
-			second = fRight;
-		} else {
+		// start with the term that is most likely to match for OP_OR
+		Term* first = fLeft;
+		Term* second = fRight;
+		if (fRight->Selectivity() > fLeft->Selectivity()) {
 			first = fRight;
 			second = fLeft;
 		}
@@ -955,30 +1385,65 @@ Operator::Complement()
 }
 
 
-void
-Operator::CalculateScore(Index &index)
+/*!	Returns the child that should drive the query for OP_AND; only the
+	entries of its index have to be visited, the other child only has to be
+	matched against them.
+*/
+Term*
+Operator::Driver() const
 {
-	fLeft->CalculateScore(index);
-	fRight->CalculateScore(index);
+	if (fLeft->IsIndexed() != fRight->IsIndexed())
+		return fLeft->IsIndexed() ? fLeft : fRight;
+
+	if (fRight->Cost() < fLeft->Cost())
+		return fRight;
+
+	return fLeft;
 }
 
 
-int32
-Operator::Score() const
+void
+Operator::Estimate(Volume* volume, Index& index, bool useStatistics)
 {
-	if (fOp == OP_AND) {
-		// return the one with the better score
-		if (fRight->Score() > fLeft->Score())
-			return fRight->Score();
+	fLeft->Estimate(volume, index, useStatistics);
+	fRight->Estimate(volume, index, useStatistics);
+
+	uint32 left = fLeft->Selectivity();
+	uint32 right = fRight->Selectivity();
 
-		return fLeft->Score();
+	if (fOp == OP_AND) {
+		// the terms are assumed to be independent
+		fIndexed = fLeft->IsIndexed() || fRight->IsIndexed();
+		fCost = Driver()->Cost();
+		fSelectivity = (uint32)(((uint64)left * right) / kSelectivityOne);
+		return;
 	}
 
-	// for OP_OR, be honest, and return the one with the worse score
-	if (fRight->Score() < fLeft->Score())
-		return fRight->Score();
+	// for OP_OR, both children have to be visited
+	fIndexed = fLeft->IsIndexed() && fRight->IsIndexed();
+	fCost = fLeft->Cost() + fRight->Cost();
+	fSelectivity = left + right
+		- (uint32)(((uint64)left * right) / kSelectivityOne);
+}
+
+
+int64
+Operator::VisitedEntries() const
+{
+	return fLeft->VisitedEntries() + fRight->VisitedEntries();
+}
+
+
+void
+Operator::Explain(QueryPlanWriter& writer, int32 level)
+{
+	uint32 percent = selectivity_percent(fSelectivity);
+	writer.Print(level, "%s: cost %" B_PRId64 ", selectivity %" B_PRIu32
+		".%02" B_PRIu32 "%%\n", operator_symbol(fOp), fCost, percent / 100,
+		percent % 100);
 
-	return fLeft->Score();
+	fLeft->Explain(writer, level + 1);
+	fRight->Explain(writer, level + 1);
 }
 
 
@@ -1235,6 +1700,7 @@ Query::Query(Volume* volume, Expression* expression, uint32 flags)
 	fCurrent(NULL),
 	fIterator(NULL),
 	fIndex(volume),
+	fMatches(0),
 	fFlags(flags),
 	fPort(-1)
 {
@@ -1244,8 +1710,11 @@ Query::Query(Volume* volume, Expression* expression, uint32 flags)
 	if (volume == NULL || expression == NULL || expression->Root() == NULL)
 		return;
 
-	// create index on the stack and delete it afterwards
-	fExpression->Root()->CalculateScore(fIndex);
+	// Gathering index statistics is only worth it if there is a choice
+	// between several indices
+	Term* root = fExpression->Root();
+	root->Estimate(volume, fIndex, root->Op() == OP_AND
+		|| root->Op() == OP_OR);
 	fIndex.Unset();
 
 	Rewind();
@@ -1287,16 +1756,15 @@ Query::Rewind()
 				stack.Push(op->Left());
 				stack.Push(op->Right());
 			} else {
-				// For OP_AND, we can use the scoring system to decide which
-				// path to add
-				if (op->Right()->Score() > op->Left()->Score())
-					stack.Push(op->Right());
-				else
-					stack.Push(op->Left());
+				// For OP_AND, we only need to visit the entries of the
+				// cheapest path
+				stack.Push(op->Driver());
 			}
 		} else if (term->Op() == OP_EQUATION
-			|| fStack.Push((Equation*)term) != B_OK)
+			|| fStack.Push((Equation*)term) != B_OK) {
 			FATAL(("Unknown term on stack or stack error"));
+		} else
+			((Equation*)term)->SetDriving();
 	}
 
 	return B_OK;
@@ -1335,12 +1803,44 @@ Query::GetNextEntry(struct dirent* dirent, size_t size)
 			fCurrent = NULL;
 		} else {
 			// only return if we have another entry
+			fMatches++;
 			return B_OK;
 		}
 	}
 }
 
 
+/*!	Describes the plan the query is evaluated with into \a buffer, and
+	returns the length of the complete text, which may be larger than
+	\a size. The number of visited index entries is only known once the
+	query has been read to its end.
+*/
+size_t
+Query::Explain(char* buffer, size_t size)
+{
+	QueryPlanWriter writer(buffer, size);
+
+	if (fExpression == NULL || fExpression->Root() == NULL)
+		return writer.Length();
+
+	fExpression->Root()->Explain(writer, 0);
+	writer.Print(0, "visited %" B_PRId64 " entries, %" B_PRId64
+		" matches\n", VisitedEntries(), fMatches);
+
+	return writer.Length();
+}
+
+
+int64
+Query::VisitedEntries() const
+{
+	if (fExpression == NULL || fExpression->Root() == NULL)
+		return 0;
+
+	return fExpression->Root()->VisitedEntries();
+}
+
+
 void
 Query::SetLiveMode(port_id port, int32 token)
 {
@@ -1,5 +1,5 @@
 /*
- * Copyright 2001-2008, Axel Dörfler, axeld@pinc-software.de.
+ * Copyright 2001-2026, Axel Dörfler, axeld@pinc-software.de.
  * This file may be used under the terms of the MIT License.
  */
 #ifndef QUERY_H
@@ -63,6 +63,10 @@ public:
 
 			Expression*		GetExpression() const { return fExpression; }
 
+			size_t			Explain(char* buffer, size_t size);
+			int64			VisitedEntries() const;
+			int64			CountMatches() const { return fMatches; }
+
 private:
 			Volume*			fVolume;
 			Expression*		fExpression;
@@ -70,6 +74,7 @@ private:
 			TreeIterator*	fIterator;
 			Index			fIndex;
 			Stack<Equation*> fStack;
+			int64			fMatches;
 
 			uint32			fFlags;
 			port_id			fPort;
@@ -0,0 +1,197 @@
+/*
+ * Copyright 2001-2026, Axel Dörfler, axeld@pinc-software.de.
+ * This file may be used under the terms of the MIT License.
+ */
+#ifndef RUN_ARRAY_H
+#define RUN_ARRAY_H
+
+
+//! The on-disk format of the log entries
+
+
+#include "bfs.h"
+#include "CRCTable.h"
+
+
+/*!	Every log entry starts with a run_array that lists the blocks that follow
+	it in the log, and where they belong on disk.
+	Be's BFS never uses the last run of the array; we store a log_entry_tail
+	there that contains a checksum of the array and all of its blocks. Since
+	the tail is ignored by implementations that don't know about it, the log
+	stays compatible both ways.
+*/
+struct log_entry_tail {
+	uint16		magic;
+	uint16		flags;
+	uint32		checksum;
+
+	uint16 Magic() const { return BFS_ENDIAN_TO_HOST_INT16(magic); }
+	uint16 Flags() const { return BFS_ENDIAN_TO_HOST_INT16(flags); }
+	uint32 Checksum() const { return BFS_ENDIAN_TO_HOST_INT32(checksum); }
+} _PACKED;
+
+#define LOG_ENTRY_TAIL_MAGIC	0x4c43		/* 'LC' */
+
+// log_entry_tail::flags
+#define LOG_ENTRY_CONTINUED		0x0001
+	// the next run_array in the log belongs to the same transaction
+
+
+struct run_array {
+	int32		count;
+	int32		max_runs;
+	block_run	runs[0];
+
+	void Init(int32 blockSize);
+	void Insert(block_run& run);
+
+	int32 CountRuns() const { return BFS_ENDIAN_TO_HOST_INT32(count); }
+	int32 MaxRuns() const { return BFS_ENDIAN_TO_HOST_INT32(max_runs) - 1; }
+		// that -1 accounts for an off-by-one error in Be's BFS implementation
+	const block_run& RunAt(int32 i) const { return runs[i]; }
+
+	log_entry_tail& Tail() { return *(log_entry_tail*)&runs[MaxRuns()]; }
+	const log_entry_tail& Tail() const
+		{ return *(const log_entry_tail*)&runs[MaxRuns()]; }
+	bool HasTail() const
+		{ return Tail().Magic() == LOG_ENTRY_TAIL_MAGIC; }
+	int32 CountBlocks() const;
+
+	uint32 StartChecksum(int32 blockSize) const;
+	static uint32 AddToChecksum(uint32 checksum, const void* block,
+		int32 blockSize);
+
+	static int32 MaxRuns(int32 blockSize);
+
+private:
+	static int _Compare(block_run& a, block_run& b);
+	int32 _FindInsertionIndex(block_run& run);
+};
+
+
+/*static*/ inline int32
+run_array::MaxRuns(int32 blockSize)
+{
+	// For whatever reason, BFS restricts the maximum array size
+	uint32 maxCount = (blockSize - sizeof(run_array)) / sizeof(block_run);
+	if (maxCount < 128)
+		return maxCount;
+
+	return 127;
+}
+
+
+inline int32
+run_array::CountBlocks() const
+{
+	int32 blocks = 0;
+	for (int32 i = 0; i < CountRuns(); i++)
+		blocks += RunAt(i).Length();
+
+	return blocks;
+}
+
+
+/*!	Starts the checksum of a log entry with its run_array; everything but the
+	checksum itself is covered. The blocks of the entry must be added in the
+	order they are written to the log with AddToChecksum().
+*/
+inline uint32
+run_array::StartChecksum(int32 blockSize) const
+{
+	const uint8* block = (const uint8*)this;
+	const uint8* checksum = (const uint8*)&Tail().checksum;
+	const uint8* end = checksum + sizeof(uint32);
+
+	uint32 crc = calculate_crc32c(0xffffffff, block, checksum - block);
+	return calculate_crc32c(crc, end, block + blockSize - end);
+}
+
+
+/*static*/ inline uint32
+run_array::AddToChecksum(uint32 checksum, const void* block, int32 blockSize)
+{
+	return calculate_crc32c(checksum, (const uint8*)block, blockSize);
+}
+
+
+/*!	Checks the log entry that starts at \a start, and all entries that
+	continue the same transaction; \a readBlock is called with a position in
+	the log, and must return a pointer to the contents of that block, or
+	\c NULL on error. The pointer only needs to stay valid until the next
+	call.
+	On success, \a _next is set to the position in the log (modulo
+	\a logSize) after the transaction.
+	Entries without a tail were written by an older implementation, and are
+	accepted as they are, one by one.
+	Returns \c B_BAD_DATA if the transaction was not completely written to
+	the log: the checksum of an entry does not match, or an entry that
+	continues a checksummed transaction is broken, or does not end before
+	\a end. Returns \c B_ERROR if the header of the first entry is invalid,
+	or if that entry does not end before \a end.
+*/
+template<typename BlockReader>
+status_t
+check_log_transaction(BlockReader& readBlock, int32 blockSize, uint32 logSize,
+	uint32 start, uint32 end, uint32& _next)
+{
+	uint32 position = start % logSize;
+	uint32 used = 0;
+	uint32 available = (end + logSize - position) % logSize;
+	if (available == 0)
+		available = logSize;
+
+	while (true) {
+		// only the entries following the first one may have been torn
+		// without a checksum telling us
+		status_t broken = used > 0 ? B_BAD_DATA : B_ERROR;
+
+		const run_array* array = (const run_array*)readBlock(position);
+		if (array == NULL)
+			return B_IO_ERROR;
+
+		int32 maxRuns = run_array::MaxRuns(blockSize) - 1;
+		if (array->MaxRuns() != maxRuns || array->CountRuns() > maxRuns
+			|| array->CountRuns() <= 0)
+			return broken;
+
+		uint32 length = 1 + array->CountBlocks();
+		if (used + length > available)
+			return broken;
+
+		if (!array->HasTail()) {
+			// written without checksum -- which a continued entry never is
+			if (used > 0)
+				return B_BAD_DATA;
+
+			_next = (position + length) % logSize;
+			return B_OK;
+		}
+
+		bool continued = (array->Tail().Flags() & LOG_ENTRY_CONTINUED) != 0;
+		uint32 expected = array->Tail().Checksum();
+		uint32 checksum = array->StartChecksum(blockSize);
+
+		for (uint32 i = 1; i < length; i++) {
+			const void* block = readBlock((position + i) % logSize);
+			if (block == NULL)
+				return B_IO_ERROR;
+
+			checksum = run_array::AddToChecksum(checksum, block, blockSize);
+		}
+
+		if (checksum != expected)
+			return B_BAD_DATA;
+
+		used += length;
+		position = (position + length) % logSize;
+
+		if (!continued) {
+			_next = position;
+			return B_OK;
+		}
+	}
+}
+
+
+#endif	// RUN_ARRAY_H
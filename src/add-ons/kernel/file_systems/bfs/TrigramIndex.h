@@ -0,0 +1,193 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * This file may be used under the terms of the MIT License.
+ */
+#ifndef TRIGRAM_INDEX_H
+#define TRIGRAM_INDEX_H
+
+
+//! Helpers for the trigram indices of string attributes
+
+
+#include "system_dependencies.h"
+
+#include "bfs.h"
+
+
+/*!	A trigram index is a string index named after the attribute it covers,
+	followed by TRIGRAM_INDEX_SUFFIX, like "name:trigrams". For every file,
+	it contains each sequence of three bytes of the attribute value once,
+	with ASCII letters folded to lower case. It allows to answer substring
+	and wildcard queries, case-insensitive or not, without visiting all
+	files: any value that matches must contain the trigrams of the pattern.
+	The trigram index is maintained along with the regular index of the
+	attribute, which must exist as well. Files that existed before the
+	trigram index was created are not part of it.
+*/
+#define TRIGRAM_INDEX_SUFFIX		":trigrams"
+#define TRIGRAM_INDEX_SUFFIX_LENGTH	9
+#define TRIGRAM_LENGTH				3
+#define MAX_TRIGRAMS				(MAX_INDEX_KEY_LENGTH - TRIGRAM_LENGTH + 1)
+
+
+static inline bool
+is_trigram_index_name(const char* name)
+{
+	size_t length = strlen(name);
+	return length > TRIGRAM_INDEX_SUFFIX_LENGTH
+		&& !strcmp(name + length - TRIGRAM_INDEX_SUFFIX_LENGTH,
+			TRIGRAM_INDEX_SUFFIX);
+}
+
+
+/*!	Builds the name of the trigram index of \a attribute into \a buffer,
+	which must be B_FILE_NAME_LENGTH bytes large. Returns \c false if the
+	name would be too long.
+*/
+static inline bool
+get_trigram_index_name(const char* attribute, char* buffer)
+{
+	size_t length = strlen(attribute);
+	if (length + TRIGRAM_INDEX_SUFFIX_LENGTH >= B_FILE_NAME_LENGTH)
+		return false;
+
+	memcpy(buffer, attribute, length);
+	memcpy(buffer + length, TRIGRAM_INDEX_SUFFIX,
+		TRIGRAM_INDEX_SUFFIX_LENGTH + 1);
+	return true;
+}
+
+
+static inline uint8
+fold_trigram_char(uint8 c)
+{
+	if (c >= 'A' && c <= 'Z')
+		return c - 'A' + 'a';
+	return c;
+}
+
+
+//!	Returns the key of the trigram in the index.
+static inline void
+get_trigram_key(uint32 trigram, uint8* key)
+{
+	key[0] = trigram >> 16;
+	key[1] = (trigram >> 8) & 0xff;
+	key[2] = trigram & 0xff;
+}
+
+
+/*!	Fills \a trigrams with the distinct trigrams of the value, in ascending
+	order, and returns their number. \a trigrams must have room for
+	MAX_TRIGRAMS entries.
+*/
+static inline int32
+collect_trigrams(const uint8* value, uint16 length, uint32* trigrams)
+{
+	// string attributes may contain their terminating null byte
+	while (length > 0 && value[length - 1] == '\0')
+		length--;
+	if (length > MAX_INDEX_KEY_LENGTH)
+		length = MAX_INDEX_KEY_LENGTH;
+
+	int32 count = 0;
+	uint32 window = 0;
+
+	for (uint16 i = 0; i < length; i++) {
+		window = ((window << 8) | fold_trigram_char(value[i])) & 0xffffff;
+		if (i < TRIGRAM_LENGTH - 1)
+			continue;
+
+		// insert sorted, and ignore duplicates
+		int32 index = count;
+		while (index > 0 && trigrams[index - 1] > window)
+			index--;
+		if (index > 0 && trigrams[index - 1] == window)
+			continue;
+
+		memmove(&trigrams[index + 1], &trigrams[index],
+			(count - index) * sizeof(uint32));
+		trigrams[index] = window;
+		count++;
+	}
+
+	return count;
+}
+
+
+/*!	Returns the next character of the pattern that every matching string
+	contains literally (ignoring the case of ASCII letters), and advances
+	\a pattern past it. Returns -1 for wildcards, and character classes
+	other than those that only contain both cases of a letter, like "[Hh]".
+	Escapes are not taken as literals either, as the pattern matcher does
+	not handle them consistently; the character after one is looked at on
+	its own.
+*/
+static inline int32
+next_pattern_literal(const char*& pattern)
+{
+	uint8 c = *pattern++;
+
+	switch (c) {
+		case '*':
+		case '?':
+		case '\\':
+			return -1;
+
+		case '[':
+		{
+			const char* start = pattern;
+			while (pattern[0] != '\0' && pattern[0] != ']') {
+				if (pattern[0] == '\\' && pattern[1] != '\0')
+					pattern++;
+				pattern++;
+			}
+			if (pattern[0] == '\0')
+				return -1;
+
+			int32 length = pattern - start;
+			pattern++;
+
+			if (length == 1 && start[0] != '^' && start[0] != '!'
+				&& start[0] != '\\' && (uint8)start[0] < 0x80)
+				return fold_trigram_char(start[0]);
+			if (length == 2 && start[0] != start[1]
+				&& fold_trigram_char(start[0]) == fold_trigram_char(start[1]))
+				return fold_trigram_char(start[0]);
+
+			return -1;
+		}
+	}
+
+	return fold_trigram_char(c);
+}
+
+
+/*!	Fills \a trigrams with the trigrams every string matching the pattern
+	contains, and returns their number; duplicates are not removed.
+	\a trigrams must have room for MAX_TRIGRAMS entries.
+*/
+static inline int32
+collect_pattern_trigrams(const char* pattern, uint32* trigrams)
+{
+	int32 count = 0;
+	int32 run = 0;
+	uint32 window = 0;
+
+	while (pattern[0] != '\0' && count < MAX_TRIGRAMS) {
+		int32 c = next_pattern_literal(pattern);
+		if (c < 0) {
+			run = 0;
+			continue;
+		}
+
+		window = ((window << 8) | c) & 0xffffff;
+		if (++run >= TRIGRAM_LENGTH)
+			trigrams[count++] = window;
+	}
+
+	return count;
+}
+
+
+#endif	// TRIGRAM_INDEX_H
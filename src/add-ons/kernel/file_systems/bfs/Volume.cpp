@@ -8,12 +8,17 @@
 
 
 #include "Attribute.h"
+#include "BPlusTree.h"
 #include "CheckVisitor.h"
 #include "Debug.h"
 #include "file_systems/DeviceOpener.h"
+#include "Index.h"
+#include "IndexBuilder.h"
+#include "IndexStatistics.h"
 #include "Inode.h"
 #include "Journal.h"
 #include "Query.h"
+#include "TrigramIndex.h"
 #include "Volume.h"
 
 
@@ -28,6 +33,10 @@ static const int32 kDesiredAllocationGroups = 56;
 	// file on a 1 GB disk without the need for double indirect
 	// blocks).
 
+static const off_t kMaxIndexSizeForStatistics = 16 * 1024 * 1024;
+	// Larger indices are not read completely to gather statistics for the
+	// query planner; it will fall back to default estimates for them.
+
 
 //	#pragma mark -
 
@@ -121,20 +130,29 @@ Volume::Volume(fs_volume* volume)
 	:
 	fVolume(volume),
 	fBlockAllocator(this),
+	fReservedBlocks(0),
 	fRootNode(NULL),
 	fIndicesNode(NULL),
 	fDirtyCachedBlocks(0),
+	fTrigramIndices(0),
 	fFlags(0),
 	fCheckingThread(-1),
 	fCheckVisitor(NULL)
 {
 	mutex_init(&fLock, "bfs volume");
 	mutex_init(&fQueryLock, "bfs queries");
+	mutex_init(&fIndexStatisticsLock, "bfs index statistics");
+	mutex_init(&fIndexBuilderLock, "bfs index builders");
 }
 
 
 Volume::~Volume()
 {
+	while (IndexStatistics* statistics = fIndexStatistics.RemoveHead())
+		delete statistics;
+
+	mutex_destroy(&fIndexBuilderLock);
+	mutex_destroy(&fIndexStatisticsLock);
 	mutex_destroy(&fQueryLock);
 	mutex_destroy(&fLock);
 }
@@ -191,6 +209,11 @@ Volume::Mount(const char* deviceName, uint32 flags)
 		FATAL(("invalid superblock!\n"));
 		return B_BAD_VALUE;
 	}
+	if ((fSuperBlock.Features() & ~SUPER_BLOCK_SUPPORTED_FEATURES) != 0) {
+		FATAL(("unsupported features %#" B_PRIx32 "!\n",
+			fSuperBlock.Features()));
+		return B_NOT_SUPPORTED;
+	}
 
 	// initialize short hands to the superblock (to save byte swapping)
 	fBlockSize = fSuperBlock.BlockSize();
@@ -268,6 +291,7 @@ Volume::Mount(const char* deviceName, uint32 flags)
 				}
 			} else {
 				// we don't use the vnode layer to access the indices node
+				_CountTrigramIndices();
 			}
 		} else {
 			FATAL(("could not create root node: publish_vnode() failed!\n"));
@@ -395,6 +419,34 @@ Volume::AllocateForInode(Transaction& transaction, const Inode* parent,
 }
 
 
+/*!	Makes sure that \a numBlocks blocks stay available for a later
+	allocation, without allocating them yet. The reserved blocks no longer
+	count as free blocks.
+*/
+status_t
+Volume::ReserveBlocks(off_t numBlocks)
+{
+	// the block allocator relies on the reservations while it holds its lock
+	RecursiveLocker locker(fBlockAllocator.Lock());
+
+	if (FreeBlocks() < numBlocks)
+		return B_DEVICE_FULL;
+
+	fReservedBlocks += numBlocks;
+	return B_OK;
+}
+
+
+void
+Volume::UnreserveBlocks(off_t numBlocks)
+{
+	RecursiveLocker locker(fBlockAllocator.Lock());
+
+	ASSERT(numBlocks <= fReservedBlocks);
+	fReservedBlocks -= numBlocks;
+}
+
+
 status_t
 Volume::WriteSuperBlock()
 {
@@ -469,6 +521,115 @@ Volume::RemoveQuery(Query* query)
 }
 
 
+/*!	Estimates how many entries of the index have keys between \a lower and
+	\a upper (see IndexStatistics::Estimate()), and how many entries the
+	index has in total.
+	The statistics of an index are gathered by reading all of its keys the
+	first time they are needed, and whenever they became stale.
+	Returns \c B_NOT_SUPPORTED if the index is too large for that.
+*/
+status_t
+Volume::EstimateIndex(Index& index, const uint8* lower, uint16 lowerLength,
+	const uint8* upper, uint16 upperLength, int64& _matches, int64& _entries)
+{
+	Inode* node = index.Node();
+	if (node == NULL)
+		return B_BAD_VALUE;
+
+	MutexLocker locker(fIndexStatisticsLock);
+
+	IndexStatistics* statistics = _FindIndexStatistics(node->ID());
+	if (statistics == NULL || statistics->IsStale()) {
+		locker.Unlock();
+
+		status_t status = _GatherIndexStatistics(index);
+		if (status != B_OK)
+			return status;
+
+		locker.Lock();
+		statistics = _FindIndexStatistics(node->ID());
+		if (statistics == NULL)
+			return B_ENTRY_NOT_FOUND;
+	}
+
+	_matches = statistics->Estimate(lower, lowerLength, upper, upperLength);
+	_entries = statistics->CountEntries();
+	return B_OK;
+}
+
+
+/*!	Called by Index::Update() with the index write locked; only indices
+	that were already used by a query have statistics to update.
+*/
+void
+Volume::UpdateIndexStatistics(Index& index, const uint8* oldKey,
+	uint16 oldLength, const uint8* newKey, uint16 newLength)
+{
+	MutexLocker _(fIndexStatisticsLock);
+
+	IndexStatistics* statistics = _FindIndexStatistics(index.Node()->ID());
+	if (statistics != NULL)
+		statistics->Update(oldKey, oldLength, newKey, newLength);
+}
+
+
+//!	Forgets the statistics of an index that has been created anew.
+void
+Volume::InvalidateIndexStatistics(ino_t index)
+{
+	MutexLocker _(fIndexStatisticsLock);
+
+	IndexStatistics* statistics = _FindIndexStatistics(index);
+	if (statistics != NULL)
+		statistics->Start();
+}
+
+
+/*!	Adds an index builder that wants to know about the changes to the
+	attribute of its index. Only one index can be built under each name at
+	a time.
+*/
+status_t
+Volume::AddIndexBuilder(IndexBuilder* builder)
+{
+	MutexLocker _(fIndexBuilderLock);
+
+	SinglyLinkedList<IndexBuilder>::Iterator iterator
+		= fIndexBuilders.GetIterator();
+	while (IndexBuilder* other = iterator.Next()) {
+		if (!strcmp(other->IndexName(), builder->IndexName()))
+			return B_BUSY;
+	}
+
+	fIndexBuilders.Add(builder);
+	return B_OK;
+}
+
+
+void
+Volume::RemoveIndexBuilder(IndexBuilder* builder)
+{
+	MutexLocker _(fIndexBuilderLock);
+	fIndexBuilders.Remove(builder);
+}
+
+
+void
+Volume::UpdateIndexBuilders(Inode* inode, const char* attribute,
+	const uint8* oldKey, uint16 oldLength, const uint8* newKey,
+	uint16 newLength)
+{
+	MutexLocker _(fIndexBuilderLock);
+
+	SinglyLinkedList<IndexBuilder>::Iterator iterator
+		= fIndexBuilders.GetIterator();
+	while (IndexBuilder* builder = iterator.Next()) {
+		builder->Changed(inode, attribute, oldKey, oldLength, newKey,
+			newLength);
+	}
+}
+
+
 status_t
 Volume::CreateCheckVisitor()
 {
@@ -567,6 +728,12 @@ Volume::Initialize(int fd, const char* name, uint32 blockSize,
 	// create valid superblock
 
 	fSuperBlock.Initialize(name, numBlocks, blockSize);
+	uint32 features = 0;
+	if ((flags & VOLUME_PREFIX_KEYS) != 0)
+		features |= SUPER_BLOCK_FEATURE_PREFIX_KEYS;
+	if ((flags & VOLUME_INLINE_DATA) != 0)
+		features |= SUPER_BLOCK_FEATURE_INLINE_DATA;
+	fSuperBlock.features = HOST_ENDIAN_TO_BFS_INT32(features);
 
 	// initialize short hands to the superblock (to save byte swapping)
 	fBlockSize = fSuperBlock.BlockSize();
@@ -679,3 +846,90 @@ Volume::_EraseUnusedBootBlock()
 
 	return B_OK;
 }
+
+
+IndexStatistics*
+Volume::_FindIndexStatistics(ino_t index)
+{
+	SinglyLinkedList<IndexStatistics>::Iterator iterator
+		= fIndexStatistics.GetIterator();
+	while (IndexStatistics* statistics = iterator.Next()) {
+		if (statistics->ID() == index)
+			return statistics;
+	}
+
+	return NULL;
+}
+
+
+/*!	Reads all keys of the index to build its statistics. This is done
+	without holding the statistics lock, as Index::Update() acquires it with
+	the index locked; changes made in the meantime are lost.
+*/
+status_t
+Volume::_GatherIndexStatistics(Index& index)
+{
+	Inode* node = index.Node();
+	if (node->Size() > kMaxIndexSizeForStatistics)
+		return B_NOT_SUPPORTED;
+
+	BPlusTree* tree = node->Tree();
+	if (tree == NULL)
+		return B_BAD_VALUE;
+
+	IndexStatistics* statistics = new(std::nothrow) IndexStatistics(
+		node->ID(), index.Type());
+	if (statistics == NULL)
+		return B_NO_MEMORY;
+
+	TreeIterator iterator(tree);
+	uint8 key[BPLUSTREE_MAX_KEY_LENGTH + 1];
+	uint16 length;
+	off_t value;
+	uint16 duplicate;
+
+	status_t status;
+	while ((status = iterator.GetNextEntry(key, &length, sizeof(key), &value,
+			&duplicate)) == B_OK) {
+		statistics->Add(key, length);
+	}
+	if (status != B_ENTRY_NOT_FOUND) {
+		delete statistics;
+		return status;
+	}
+
+	statistics->Finish();
+
+	MutexLocker _(fIndexStatisticsLock);
+
+	IndexStatistics* existing = _FindIndexStatistics(node->ID());
+	if (existing != NULL) {
+		existing->SetTo(*statistics);
+		delete statistics;
+	} else
+		fIndexStatistics.Add(statistics);
+
+	return B_OK;
+}
+
+
+/*!	Counts the trigram indices of the volume, so that Index::Update() only
+	needs to look for them if there are any.
+*/
+void
+Volume::_CountTrigramIndices()
+{
+	BPlusTree* tree = fIndicesNode->Tree();
+	if (tree == NULL)
+		return;
+
+	TreeIterator iterator(tree);
+	char name[B_FILE_NAME_LENGTH];
+	uint16 length;
+	off_t id;
+
+	while (iterator.GetNextEntry(name, &length, sizeof(name), &id) == B_OK) {
+		if (is_trigram_index_name(name))
+			fTrigramIndices++;
+	}
+}
@@ -14,6 +14,9 @@
 
 class CheckVisitor;
 class Journal;
+class Index;
+class IndexBuilder;
+class IndexStatistics;
 class Inode;
 class Query;
 
@@ -24,6 +27,8 @@ enum volume_flags {
 
 enum volume_initialize_flags {
 	VOLUME_NO_INDICES	= 0x0001,
+	VOLUME_PREFIX_KEYS	= 0x0002,
+	VOLUME_INLINE_DATA	= 0x0004,
 };
 
 typedef DoublyLinkedList<Inode> InodeList;
@@ -44,6 +49,9 @@ public:
 			bool			IsValidSuperBlock() const;
 			bool			IsValidInodeBlock(off_t block) const;
 			bool			IsReadOnly() const;
+			bool			HasFeature(uint32 feature) const
+								{ return (fSuperBlock.Features() & feature)
+									!= 0; }
 			void			Panic();
 			mutex&			Lock();
 
@@ -65,7 +73,8 @@ public:
 			off_t			UsedBlocks() const
 								{ return fSuperBlock.UsedBlocks(); }
 			off_t			FreeBlocks() const
-								{ return NumBlocks() - UsedBlocks(); }
+								{ return NumBlocks() - UsedBlocks()
+									- fReservedBlocks; }
 			off_t			NumBitmapBlocks() const
 								{ return (NumBlocks() + fBlockSize * 8 - 1)
 									/ (fBlockSize * 8); }
@@ -114,6 +123,8 @@ public:
 								off_t numBlocks, block_run& run,
 								uint16 minimum = 1);
 			status_t		Free(Transaction& transaction, block_run run);
+			status_t		ReserveBlocks(off_t numBlocks);
+			void			UnreserveBlocks(off_t numBlocks);
 			void			SetCheckingThread(thread_id thread)
 								{ fCheckingThread = thread; }
 			bool			IsCheckingThread() const
@@ -139,6 +150,32 @@ public:
 			void			AddQuery(Query* query);
 			void			RemoveQuery(Query* query);
 
+			// index statistics for the query planner
+			status_t		EstimateIndex(Index& index, const uint8* lower,
+								uint16 lowerLength, const uint8* upper,
+								uint16 upperLength, int64& _matches,
+								int64& _entries);
+			void			UpdateIndexStatistics(Index& index,
+								const uint8* oldKey, uint16 oldLength,
+								const uint8* newKey, uint16 newLength);
+			void			InvalidateIndexStatistics(ino_t index);
+
+			// trigram indices, see TrigramIndex.h
+			bool			HasTrigramIndices() const
+								{ return fTrigramIndices > 0; }
+			void			AddTrigramIndex()
+								{ atomic_add(&fTrigramIndices, 1); }
+			void			RemoveTrigramIndex()
+								{ atomic_add(&fTrigramIndices, -1); }
+
+			// indices that are being built, see IndexBuilder.h
+			status_t		AddIndexBuilder(IndexBuilder* builder);
+			void			RemoveIndexBuilder(IndexBuilder* builder);
+			void			UpdateIndexBuilders(Inode* inode,
+								const char* attribute, const uint8* oldKey,
+								uint16 oldLength, const uint8* newKey,
+								uint16 newLength);
+
 			status_t		Sync();
 			Journal*		GetJournal(off_t refBlock) const;
 
@@ -150,6 +187,9 @@ public:
 
 private:
 			status_t		_EraseUnusedBootBlock();
+			IndexStatistics* _FindIndexStatistics(ino_t index);
+			status_t		_GatherIndexStatistics(Index& index);
+			void			_CountTrigramIndices();
 
 protected:
 			fs_volume*		fVolume;
@@ -163,6 +203,8 @@ protected:
 
 			BlockAllocator	fBlockAllocator;
 			mutex			fLock;
+			off_t			fReservedBlocks;
+				// blocks promised to delayed allocations, guarded by fLock
 			Journal*		fJournal;
 			vint32			fLogStart;
 			vint32			fLogEnd;
@@ -175,6 +217,14 @@ protected:
 			mutex			fQueryLock;
 			SinglyLinkedList<Query> fQueries;
 
+			mutex			fIndexStatisticsLock;
+			SinglyLinkedList<IndexStatistics> fIndexStatistics;
+				// the objects are only deleted on unmount
+			int32			fTrigramIndices;
+
+			mutex			fIndexBuilderLock;
+			SinglyLinkedList<IndexBuilder> fIndexBuilders;
+
 			uint32			fFlags;
 
 			void*			fBlockCache;
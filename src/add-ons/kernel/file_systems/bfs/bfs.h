@@ -76,7 +76,8 @@ struct disk_super_block {
 	int32		magic3;
 	inode_addr	root_dir;
 	inode_addr	indices;
-	int32		_reserved[8];
+	int32		features;
+	int32		_reserved[7];
 	int32		pad_to_block[87];
 		// this also contains parts of the boot block
 
@@ -95,6 +96,7 @@ struct disk_super_block {
 	int32 AllocationGroupShift() const
 		{ return BFS_ENDIAN_TO_HOST_INT32(ag_shift); }
 	int32 Flags() const { return BFS_ENDIAN_TO_HOST_INT32(flags); }
+	uint32 Features() const { return BFS_ENDIAN_TO_HOST_INT32(features); }
 	off_t LogStart() const { return BFS_ENDIAN_TO_HOST_INT64(log_start); }
 	off_t LogEnd() const { return BFS_ENDIAN_TO_HOST_INT64(log_end); }
 
@@ -112,6 +114,15 @@ struct disk_super_block {
 #define SUPER_BLOCK_DISK_CLEAN		'CLEN'		/* CLEN */
 #define SUPER_BLOCK_DISK_DIRTY		'DIRT'		/* DIRT */
 
+// Features that change the on-disk format; a volume that uses a feature
+// unknown to this implementation must not be mounted.
+#define SUPER_BLOCK_FEATURE_PREFIX_KEYS		0x00000001
+	// B+tree nodes may store their keys prefix compressed
+#define SUPER_BLOCK_FEATURE_INLINE_DATA		0x00000002
+	// files may keep their data in the inode (INODE_INLINE_DATA)
+#define SUPER_BLOCK_SUPPORTED_FEATURES		(SUPER_BLOCK_FEATURE_PREFIX_KEYS \
+												| SUPER_BLOCK_FEATURE_INLINE_DATA)
+
 //**************************************
 
 #define NUM_DIRECT_BLOCKS			12
@@ -171,6 +182,11 @@ struct small_data {
 #define FILE_NAME_NAME			0x13
 #define FILE_NAME_NAME_LENGTH	1
 
+// The data of small files can be stored there as well (INODE_INLINE_DATA)
+#define INLINE_DATA_TYPE		'RAWT'
+#define INLINE_DATA_NAME		0x14
+#define INLINE_DATA_NAME_LENGTH	1
+
 // The maximum key length of attribute data that is put  in the index.
 // This excludes a terminating null byte.
 // This must be smaller than or equal as BPLUSTREE_MAX_KEY_LENGTH.
@@ -258,6 +274,8 @@ enum inode_flags {
 	INODE_DELETED			= 0x00000010,
 	INODE_NOT_READY			= 0x00000020,	// used during Inode construction
 	INODE_LONG_SYMLINK		= 0x00000040,	// symlink in data stream
+	INODE_INLINE_DATA		= 0x00000080,	// file data in small_data section
+	INODE_INCOMPLETE_INDEX	= 0x00000100,	// index that is still being built
 
 	INODE_PERMANENT_FLAGS	= 0x0000ffff,
 
@@ -401,6 +419,17 @@ small_data::IsLast(const bfs_inode* inode) const
 		+ inode->InodeSize() - sizeof(small_data) || name_size == 0;
 }
 
+
+/*!	The name and the inline data of a file are kept in the small_data
+	section, but are not attributes.
+*/
+inline bool
+is_reserved_small_data_name(const char* name)
+{
+	return (name[0] == FILE_NAME_NAME || name[0] == INLINE_DATA_NAME)
+		&& name[1] == '\0';
+}
+
 #ifdef _BOOT_MODE
 }	// namespace BFS
 #endif
@@ -103,5 +103,73 @@ struct check_control {
  */
 #define BFS_IOCTL_RESIZE		14205
 
+/* Grows the log area to the given number of blocks; the parameter is a
+ * uint32. The blocks directly following the current log must be free.
+ */
+#define BFS_IOCTL_GROW_LOG		14206
+
+/* Runs a query to its end, and describes how it was evaluated: the terms
+ * with their estimated cost (the index entries they visit when they drive
+ * the query) and selectivity, which of them drove the query, and how many
+ * index entries were visited.
+ */
+struct explain_query_control {
+	const char*	query;
+	uint32		flags;
+		/* B_QUERY_NON_INDEXED */
+	char*		buffer;
+	uint32		buffer_size;
+		/* receives the plan as text; set to the size needed */
+	uint64		entries_visited;
+	uint64		matches;
+};
+
+#define BFS_IOCTL_EXPLAIN_QUERY	14207
+
+/* Rebuilds an existing index from scratch: the keys of all files are
+ * collected and sorted while the volume stays in use, and a new B+tree is
+ * built from them bottom-up. The changes that were made in the meantime
+ * are applied to it before it replaces the index; changes to the volume
+ * are only blocked while the tree is written, and while it catches up.
+ * Fails with B_BUSY if there were too many changes to keep track of.
+ */
+struct rebuild_index_control {
+	char		name[B_FILE_NAME_LENGTH];
+	uint64		entries;
+		/* the number of keys in the new index */
+	uint64		nodes;
+		/* the size of the new index in B+tree nodes */
+	uint32		levels;
+	bigtime_t	time;
+		/* the time spent collecting the keys, and building the tree */
+};
+
+#define BFS_IOCTL_REBUILD_INDEX	14208
+
+/* Moves the data of fragmented files, attributes, directories, and indices
+ * into as few contiguous runs as possible while the volume stays in use:
+ * each node is moved in a transaction of its own, and the defragmenter
+ * pauses after it, so that it only keeps the volume busy for the given
+ * share of the time. The statistics are written to the buffer after every
+ * node that has been moved, too, so that another thread can follow the
+ * progress.
+ */
+struct defragment_control {
+	uint32		load;
+		/* the percentage of time the volume may be kept busy, 0 selects
+		 * the default */
+	uint64		nodes;
+		/* the nodes with a data stream that have been visited */
+	uint64		fragmented_nodes;
+	uint64		moved_nodes;
+	uint64		moved_blocks;
+	uint64		fragments_before;
+	uint64		fragments_after;
+		/* the contiguous extents of the visited data streams */
+	bigtime_t	time;
+};
+
+#define BFS_IOCTL_DEFRAGMENT	14209
+
 
 #endif	/* BFS_CONTROL_H */
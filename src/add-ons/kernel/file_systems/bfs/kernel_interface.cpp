@@ -10,12 +10,15 @@
 #include "Attribute.h"
 #include "CheckVisitor.h"
 #include "Debug.h"
+#include "Defragmenter.h"
 #include "Volume.h"
 #include "Inode.h"
 #include "Index.h"
+#include "IndexBuilder.h"
 #include "BPlusTree.h"
 #include "Query.h"
 #include "ResizeVisitor.h"
+#include "TrigramIndex.h"
 #include "bfs_control.h"
 #include "bfs_disk_system.h"
 
@@ -88,7 +91,7 @@ fill_stat_buffer(Inode* inode, struct stat& stat)
 		// symlinks report the size of the link here
 		stat.st_size = strlen(node.short_symlink);
 	} else
-		stat.st_size = inode->Size();
+		stat.st_size = inode->LogicalSize();
 
 	stat.st_blocks = inode->AllocatedSize() / 512;
 }
@@ -407,6 +410,59 @@ bfs_can_page(fs_volume* _volume, fs_vnode* _v, void* _cookie)
 }
 
 
+/*!	Reads the pages of a file with inline data from its inode.
+	The inode must be locked.
+*/
+static status_t
+read_inline_data_pages(Inode* inode, off_t pos, const iovec* vecs,
+	size_t count, size_t numBytes)
+{
+	for (size_t i = 0; i < count && numBytes > 0; i++) {
+		size_t length = min_c(vecs[i].iov_len, numBytes);
+		status_t status = inode->ReadInlineData(pos,
+			(uint8*)vecs[i].iov_base, length);
+		if (status != B_OK)
+			return status;
+
+		pos += length;
+		numBytes -= length;
+	}
+
+	return B_OK;
+}
+
+
+/*!	Writes back the pages of a file with inline data to its inode; only the
+	part within the file size is looked at.
+*/
+static status_t
+write_inline_data_pages(Inode* inode, off_t pos, const iovec* vecs,
+	size_t count, size_t numBytes)
+{
+	// inline data never reaches the end of its inode
+	uint32 bufferSize = inode->GetVolume()->InodeSize();
+	if (pos >= bufferSize)
+		return B_OK;
+
+	numBytes = min_c(numBytes, bufferSize - pos);
+
+	uint8* buffer = (uint8*)malloc(numBytes);
+	if (buffer == NULL)
+		return B_NO_MEMORY;
+
+	MemoryDeleter deleter(buffer);
+
+	size_t bytes = 0;
+	for (size_t i = 0; i < count && bytes < numBytes; i++) {
+		size_t length = min_c(vecs[i].iov_len, numBytes - bytes);
+		memcpy(buffer + bytes, vecs[i].iov_base, length);
+		bytes += length;
+	}
+
+	return inode->WriteBackInlineData(pos, buffer, bytes);
+}
+
+
 static status_t
 bfs_read_pages(fs_volume* _volume, fs_vnode* _node, void* _cookie,
 	off_t pos, const iovec* vecs, size_t count, size_t* _numBytes)
@@ -419,6 +475,9 @@ bfs_read_pages(fs_volume* _volume, fs_vnode* _node, void* _cookie,
 
 	InodeReadLocker _(inode);
 
+	if (inode->HasInlineData())
+		return read_inline_data_pages(inode, pos, vecs, count, *_numBytes);
+
 	uint32 vecIndex = 0;
 	size_t vecOffset = 0;
 	size_t bytesLeft = *_numBytes;
@@ -462,6 +521,22 @@ bfs_write_pages(fs_volume* _volume, fs_vnode* _node, void* _cookie,
 	if (inode->FileCache() == NULL)
 		RETURN_ERROR(B_BAD_VALUE);
 
+	if (inode->HasInlineData()) {
+		status_t status = write_inline_data_pages(inode, pos, vecs, count,
+			*_numBytes);
+		if (status != B_ENTRY_NOT_FOUND)
+			return status;
+
+		// the data has been moved to a data stream in the mean time
+	}
+
+	// the data we're about to write might not have any blocks yet
+	if ((uint64)pos + (uint64)*_numBytes > (uint64)inode->Size()) {
+		status_t status = inode->AllocateDelayedBlocks();
+		if (status != B_OK)
+			return status;
+	}
+
 	InodeReadLocker _(inode);
 
 	uint32 vecIndex = 0;
@@ -519,9 +594,29 @@ bfs_io(fs_volume* _volume, fs_vnode* _node, void* _cookie, io_request* request)
 		RETURN_ERROR(B_BAD_VALUE);
 	}
 
+#ifndef FS_SHELL
+	// the data we're about to write might not have any blocks yet
+	if (io_request_is_write(request)
+		&& (uint64)io_request_offset(request)
+			+ (uint64)io_request_length(request) > (uint64)inode->Size()) {
+		status_t status = inode->AllocateDelayedBlocks();
+		if (status != B_OK) {
+			notify_io_request(request, status);
+			return status;
+		}
+	}
+#endif
+
 	// We lock the node here and will unlock it in the "finished" hook.
 	rw_lock_read_lock(&inode->Lock());
 
+	if (inode->HasInlineData()) {
+		// there are no blocks to do I/O on; the VFS falls back to
+		// bfs_read_pages(), and bfs_write_pages() then
+		rw_lock_read_unlock(&inode->Lock());
+		return B_UNSUPPORTED;
+	}
+
 	return do_iterative_fd_io(volume->Device(), request,
 		iterative_io_get_vecs_hook, iterative_io_finished_hook, inode);
 }
@@ -733,7 +828,7 @@ bfs_ioctl(fs_volume* _volume, fs_vnode* _node, void* _cookie, uint32 cmd,
 
 			checker->Control().errors = 0;
 
-			status_t status = checker->Next();
+			status_t status = checker->CheckNextNode();
 			if (status == B_ENTRY_NOT_FOUND) {
 				checker->Control().status = B_ENTRY_NOT_FOUND;
 					// tells StopChecking() that we finished the pass
@@ -786,6 +881,127 @@ bfs_ioctl(fs_volume* _volume, fs_vnode* _node, void* _cookie, uint32 cmd,
 			ResizeVisitor resizer(volume);
 			return resizer.Resize(size, -1);
 		}
+		case BFS_IOCTL_GROW_LOG:
+		{
+			// only root users are allowed to move the log
+			if (geteuid() != 0)
+				return B_NOT_ALLOWED;
+
+			if (bufferLength != sizeof(uint32))
+				return B_BAD_VALUE;
+
+			uint32 length;
+			if (user_memcpy(&length, buffer, sizeof(uint32)) != B_OK)
+				return B_BAD_ADDRESS;
+
+			return volume->GetJournal(0)->GrowLog(length);
+		}
+		case BFS_IOCTL_EXPLAIN_QUERY:
+		{
+			explain_query_control control;
+			if (bufferLength != sizeof(explain_query_control))
+				return B_BAD_VALUE;
+			if (user_memcpy(&control, buffer, sizeof(control)) != B_OK)
+				return B_BAD_ADDRESS;
+
+			char* queryString = (char*)malloc(B_PAGE_SIZE);
+			if (queryString == NULL)
+				return B_NO_MEMORY;
+			MemoryDeleter queryDeleter(queryString);
+
+			ssize_t length = user_strlcpy(queryString, control.query,
+				B_PAGE_SIZE);
+			if (length < B_OK)
+				return B_BAD_ADDRESS;
+			if (length >= B_PAGE_SIZE)
+				return B_NAME_TOO_LONG;
+
+			Expression expression(queryString);
+			if (expression.InitCheck() != B_OK)
+				return B_BAD_VALUE;
+
+			Query query(volume, &expression,
+				control.flags & B_QUERY_NON_INDEXED);
+
+			// read the query to its end to know how many entries it visits
+			union {
+				struct dirent	dirent;
+				char			buffer[sizeof(struct dirent)
+									+ B_FILE_NAME_LENGTH];
+			} entry;
+			status_t status;
+			while ((status = query.GetNextEntry(&entry.dirent, sizeof(entry)))
+					== B_OK) {
+			}
+			if (status != B_ENTRY_NOT_FOUND)
+				return status;
+
+			size_t size = min_c(control.buffer_size, B_PAGE_SIZE);
+			char* plan = NULL;
+			if (size > 0) {
+				plan = (char*)malloc(size);
+				if (plan == NULL)
+					return B_NO_MEMORY;
+			}
+			MemoryDeleter planDeleter(plan);
+
+			size_t planLength = query.Explain(plan, size);
+			if (size > 0 && user_memcpy(control.buffer, plan,
+					min_c(planLength + 1, size)) != B_OK) {
+				return B_BAD_ADDRESS;
+			}
+
+			control.buffer_size = planLength + 1;
+			control.entries_visited = query.VisitedEntries();
+			control.matches = query.CountMatches();
+
+			return user_memcpy(buffer, &control, sizeof(control));
+		}
+		case BFS_IOCTL_REBUILD_INDEX:
+		{
+			if (volume->IsReadOnly())
+				return B_READ_ONLY_DEVICE;
+
+			// only root users are allowed to change indices
+			if (geteuid() != 0)
+				return B_NOT_ALLOWED;
+
+			rebuild_index_control control;
+			if (bufferLength != sizeof(rebuild_index_control))
+				return B_BAD_VALUE;
+			if (user_memcpy(&control, buffer, sizeof(control)) != B_OK)
+				return B_BAD_ADDRESS;
+
+			IndexBuilder builder(volume);
+			status_t status = builder.Rebuild(control);
+			if (status != B_OK)
+				return status;
+
+			return user_memcpy(buffer, &control, sizeof(control));
+		}
+		case BFS_IOCTL_DEFRAGMENT:
+		{
+			if (volume->IsReadOnly())
+				return B_READ_ONLY_DEVICE;
+
+			// only root users are allowed to move the blocks of all files
+			if (geteuid() != 0)
+				return B_NOT_ALLOWED;
+
+			defragment_control control;
+			if (bufferLength != sizeof(defragment_control))
+				return B_BAD_VALUE;
+			if (user_memcpy(&control, buffer, sizeof(control)) != B_OK)
+				return B_BAD_ADDRESS;
+
+			Defragmenter defragmenter(volume);
+			status_t status = defragmenter.Defragment(control,
+				(defragment_control*)buffer);
+			if (status != B_OK)
+				return status;
+
+			return user_memcpy(buffer, &control, sizeof(control));
+		}
 
 #ifdef DEBUG_FRAGMENTER
 		case 56741:
@@ -846,8 +1062,15 @@ bfs_fsync(fs_volume* _volume, fs_vnode* _node)
 {
 	FUNCTION();
 
+	Volume* volume = (Volume*)_volume->private_volume;
 	Inode* inode = (Inode*)_node->private_node;
-	return inode->Sync();
+
+	status_t status = inode->Sync();
+	if (status != B_OK)
+		return status;
+
+	// the inode's own changes are only safe once they are in the log
+	return volume->GetJournal(inode->BlockNumber())->FlushLog();
 }
 
 
@@ -887,7 +1110,7 @@ bfs_write_stat(fs_volume* _volume, fs_vnode* _node, const struct stat* stat,
 	Transaction transaction(volume, inode->BlockNumber());
 	inode->WriteLockInTransaction(transaction);
 
-	if ((mask & B_STAT_SIZE) != 0 && inode->Size() != stat->st_size) {
+	if ((mask & B_STAT_SIZE) != 0 && inode->LogicalSize() != stat->st_size) {
 		// Since B_STAT_SIZE is the only thing that can fail directly, we
 		// do it first, so that the inode state will still be consistent
 		// with the on-disk version
@@ -898,7 +1121,7 @@ bfs_write_stat(fs_volume* _volume, fs_vnode* _node, const struct stat* stat,
 		if (!hasWriteAccess)
 			RETURN_ERROR(B_NOT_ALLOWED);
 
-		off_t oldSize = inode->Size();
+		off_t oldSize = inode->LogicalSize();
 
 		status_t status = inode->SetFileSize(transaction, stat->st_size);
 		if (status != B_OK)
@@ -1373,7 +1596,7 @@ bfs_open(fs_volume* _volume, fs_vnode* _node, int openMode, void** _cookie)
 
 	// initialize the cookie
 	cookie->open_mode = openMode & BFS_OPEN_MODE_USER_MASK;
-	cookie->last_size = inode->Size();
+	cookie->last_size = inode->LogicalSize();
 	cookie->last_notification = system_time();
 
 	// Disable the file cache, if requested?
@@ -1444,7 +1667,7 @@ bfs_write(fs_volume* _volume, fs_vnode* _node, void* _cookie, off_t pos,
 	file_cookie* cookie = (file_cookie*)_cookie;
 
 	if (cookie->open_mode & O_APPEND)
-		pos = inode->Size();
+		pos = inode->LogicalSize();
 
 	Transaction transaction;
 		// We are not starting the transaction here, since
@@ -1460,12 +1683,12 @@ bfs_write(fs_volume* _volume, fs_vnode* _node, void* _cookie, off_t pos,
 
 		// periodically notify if the file size has changed
 		// TODO: should we better test for a change in the last_modified time only?
-		if (!inode->IsDeleted() && cookie->last_size != inode->Size()
+		if (!inode->IsDeleted() && cookie->last_size != inode->LogicalSize()
 			&& system_time() > cookie->last_notification
 					+ INODE_NOTIFICATION_INTERVAL) {
 			notify_stat_changed(volume->ID(), inode->ParentID(), inode->ID(),
 				B_STAT_MODIFICATION_TIME | B_STAT_SIZE | B_STAT_INTERIM_UPDATE);
-			cookie->last_size = inode->Size();
+			cookie->last_size = inode->LogicalSize();
 			cookie->last_notification = system_time();
 		}
 	}
@@ -1495,6 +1718,15 @@ bfs_free_cookie(fs_volume* _volume, fs_vnode* _node, void* _cookie)
 	bool needsTrimming = false;
 
 	if (!volume->IsReadOnly() && !volume->IsCheckingThread()) {
+		if (!inode->IsDeleted()) {
+			// give the data written through this cookie its final blocks
+			status_t status = inode->AllocateDelayedBlocks();
+			if (status != B_OK) {
+				FATAL(("Could not allocate delayed blocks: inode %" B_PRIdINO
+					": %s!\n", inode->ID(), strerror(status)));
+			}
+		}
+
 		InodeReadLocker locker(inode);
 		needsTrimming = inode->NeedsTrimming();
 
@@ -1772,6 +2004,59 @@ bfs_read_dir(fs_volume* _volume, fs_vnode* _node, void* _cookie,
 }
 
 
+#ifndef FS_SHELL
+/*!	Reads the directory entries like bfs_read_dir(), and fills in the stat
+	data and the requested attribute of the entries as well. The inodes are
+	retrieved via get_vnode(), so that they stay in the vnode cache for any
+	subsequent access.
+	Without search permission on the directory, only the entries are read.
+*/
+static status_t
+bfs_read_dir_stat(fs_volume* _volume, fs_vnode* _node, void* _cookie,
+	struct dirent* dirent, size_t bufferSize, struct stat* stats,
+	const char* attribute, void* _attributeBuffer, size_t attributeSize,
+	uint32* _num)
+{
+	FUNCTION();
+
+	Volume* volume = (Volume*)_volume->private_volume;
+	Inode* directory = (Inode*)_node->private_node;
+
+	status_t status = bfs_read_dir(_volume, _node, _cookie, dirent,
+		bufferSize, _num);
+	if (status != B_OK)
+		return status;
+
+	if (directory->CheckPermissions(X_OK) != B_OK)
+		return B_OK;
+
+	uint8* attributeBuffer = (uint8*)_attributeBuffer;
+	uint32 count = *_num;
+	for (uint32 i = 0; i < count; i++) {
+		Vnode vnode(volume, dirent->d_ino);
+		Inode* inode;
+		if (vnode.Get(&inode) == B_OK) {
+			fill_stat_buffer(inode, stats[i]);
+
+			if (attribute != NULL) {
+				uint8* buffer = attributeBuffer + i * attributeSize;
+				size_t length = attributeSize;
+				if (Attribute(inode).CheckAccess(attribute, O_RDONLY) != B_OK
+					|| inode->ReadAttribute(attribute, 0, 0, buffer, &length)
+						!= B_OK) {
+					memset(buffer, 0, attributeSize);
+				}
+			}
+		}
+
+		dirent = (struct dirent*)((uint8*)dirent + dirent->d_reclen);
+	}
+
+	return B_OK;
+}
+#endif	// !FS_SHELL
+
+
 /*!	Sets the TreeIterator back to the beginning of the directory. */
 static status_t
 bfs_rewind_dir(fs_volume* /*_volume*/, fs_vnode* /*node*/, void* _cookie)
@@ -2012,6 +2297,9 @@ bfs_remove_attr(fs_volume* _volume, fs_vnode* _node, const char* name)
 	Volume* volume = (Volume*)_volume->private_volume;
 	Inode* inode = (Inode*)_node->private_node;
 
+	if (is_reserved_small_data_name(name))
+		return B_NOT_ALLOWED;
+
 	status_t status = inode->CheckPermissions(W_OK);
 	if (status != B_OK)
 		return status;
@@ -2030,6 +2318,103 @@ bfs_remove_attr(fs_volume* _volume, fs_vnode* _node, const char* name)
 }
 
 
+#ifndef FS_SHELL
+static status_t
+bfs_read_attrs(fs_volume* _volume, fs_vnode* _node, attr_io_vec* vecs,
+	size_t count)
+{
+	FUNCTION();
+
+	Inode* inode = (Inode*)_node->private_node;
+
+	status_t status = inode->CheckPermissions(R_OK);
+	if (status != B_OK)
+		return status;
+
+	for (size_t i = 0; i < count; i++) {
+		// the name and inline data cannot be accessed this way
+		vecs[i].status = is_reserved_small_data_name(vecs[i].name)
+			? B_NOT_ALLOWED : B_OK;
+	}
+
+	inode->ReadAttributes(vecs, count);
+	return B_OK;
+}
+
+
+/*!	Writes all attributes in a single transaction: if any of them fails,
+	none of them is changed.
+*/
+static status_t
+bfs_write_attrs(fs_volume* _volume, fs_vnode* _node, attr_io_vec* vecs,
+	size_t count)
+{
+	FUNCTION();
+
+	Volume* volume = (Volume*)_volume->private_volume;
+	Inode* inode = (Inode*)_node->private_node;
+
+	if (volume->IsReadOnly())
+		return B_READ_ONLY_DEVICE;
+
+	status_t status = inode->CheckPermissions(W_OK);
+	if (status != B_OK)
+		return status;
+
+	ArrayDeleter<bool> created(new(std::nothrow) bool[count]);
+	if (!created.IsSet())
+		return B_NO_MEMORY;
+
+	Transaction transaction(volume, inode->BlockNumber());
+
+	for (size_t i = 0; i < count; i++) {
+		attr_io_vec& vec = vecs[i];
+		status = B_OK;
+
+		if (is_reserved_small_data_name(vec.name))
+			status = B_NOT_ALLOWED;
+
+		// truncate an existing attribute file, like an O_TRUNC open would
+		Inode* attribute;
+		if (status == B_OK
+			&& inode->GetAttribute(vec.name, &attribute) == B_OK) {
+			attribute->WriteLockInTransaction(transaction);
+			status = attribute->SetFileSize(transaction, 0);
+			if (status == B_OK)
+				status = attribute->WriteBack(transaction);
+			inode->ReleaseAttribute(attribute);
+		}
+
+		if (status == B_OK) {
+			status = inode->WriteAttribute(transaction, vec.name, vec.type, 0,
+				(const uint8*)vec.buffer, &vec.length, &created[i]);
+		}
+
+		vec.status = status;
+		if (status != B_OK) {
+			// the transaction will be aborted
+			for (size_t j = 0; j < count; j++)
+				vecs[j].length = 0;
+			return status;
+		}
+	}
+
+	status = transaction.Done();
+	if (status != B_OK)
+		return status;
+
+	for (size_t i = 0; i < count; i++) {
+		notify_attribute_changed(volume->ID(), inode->ParentID(), inode->ID(),
+			vecs[i].name, created[i] ? B_ATTR_CREATED : B_ATTR_CHANGED);
+	}
+	notify_stat_changed(volume->ID(), inode->ParentID(), inode->ID(),
+		B_STAT_CHANGE_TIME);
+
+	return B_OK;
+}
+#endif	// !FS_SHELL
+
+
 //	#pragma mark - Special Nodes
 
 
@@ -2183,6 +2568,19 @@ bfs_create_index(fs_volume* _volume, const char* name, uint32 type,
 	if (geteuid() != 0)
 		return B_NOT_ALLOWED;
 
+	if (type == B_STRING_TYPE && is_trigram_index_name(name)) {
+		// queries would miss the existing files in an empty trigram index;
+		// it is filled while the volume stays in use, and only becomes
+		// visible once it is complete
+		rebuild_index_control control;
+		if (strlcpy(control.name, name, sizeof(control.name))
+				>= sizeof(control.name))
+			return B_NAME_TOO_LONG;
+
+		IndexBuilder builder(volume);
+		RETURN_ERROR(builder.Create(control, type));
+	}
+
 	Transaction transaction(volume, volume->Indices());
 
 	Index index(volume);
@@ -2218,6 +2616,8 @@ bfs_remove_index(fs_volume* _volume, const char* name)
 	status_t status = indices->Remove(transaction, name);
 	if (status == B_OK)
 		status = transaction.Done();
+	if (status == B_OK && is_trigram_index_name(name))
+		volume->RemoveTrigramIndex();
 
 	RETURN_ERROR(status);
 }
@@ -2555,7 +2955,22 @@ fs_vnode_ops gBFSVnodeOps = {
 	&bfs_remove_attr,
 
 	/* special nodes */
-	&bfs_create_special_node
+	&bfs_create_special_node,
+	NULL,	// get_super_vnode
+#ifndef FS_SHELL
+
+	/* lock operations */
+	NULL,	// test_lock
+	NULL,	// acquire_lock
+	NULL,	// release_lock
+
+	/* bulk directory operations */
+	&bfs_read_dir_stat,
+
+	/* bulk attribute operations */
+	&bfs_read_attrs,
+	&bfs_write_attrs
+#endif
 };
 
 static file_system_module_info sBeFileSystem = {
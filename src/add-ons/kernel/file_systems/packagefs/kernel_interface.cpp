@@ -10,6 +10,7 @@
 
 #include <new>
 
+#include <fs_attr.h>
 #include <fs_info.h>
 #include <fs_interface.h>
 #include <KernelExport.h>
@@ -50,6 +51,54 @@ check_access(Node* node, int mode)
 }
 
 
+/*!	Fills in the stat data of the given node, except st_dev and st_ino.
+	The caller must hold the node's read lock.
+*/
+static void
+fill_stat_buffer(Node* node, struct stat* st)
+{
+	st->st_mode = node->Mode();
+	st->st_nlink = 1;
+	st->st_uid = node->UserID();
+	st->st_gid = node->GroupID();
+	st->st_size = node->FileSize();
+	st->st_blksize = kOptimalIOSize;
+	st->st_mtim = node->ModifiedTime();
+	st->st_atim = st->st_mtim;
+	st->st_ctim = st->st_mtim;
+		// TODO: Perhaps manage a changed time (particularly for directories)?
+	st->st_crtim = st->st_mtim;
+	st->st_blocks = (st->st_size + 511) / 512;
+}
+
+
+/*!	Reads the start of the given node's attribute \a name into \a buffer.
+	The node must not be locked by the caller.
+*/
+static status_t
+read_attribute(Node* node, const char* name, void* buffer, size_t* _length)
+{
+	NodeReadLocker nodeLocker(node);
+
+	status_t error = check_access(node, R_OK);
+	if (error != B_OK)
+		return error;
+
+	AttributeCookie* cookie;
+	error = node->OpenAttribute(StringKey(name), O_RDONLY, cookie);
+	if (error != B_OK)
+		return error;
+
+	nodeLocker.Unlock();
+
+	error = cookie->ReadAttribute(0, buffer, _length);
+	cookie->Close();
+	delete cookie;
+
+	return error;
+}
+
+
 //	#pragma mark - Volume
 
 
@@ -312,19 +361,7 @@ packagefs_read_stat(fs_volume* fsVolume, fs_vnode* fsNode, struct stat* st)
 	TOUCH(volume);
 
 	NodeReadLocker nodeLocker(node);
-
-	st->st_mode = node->Mode();
-	st->st_nlink = 1;
-	st->st_uid = node->UserID();
-	st->st_gid = node->GroupID();
-	st->st_size = node->FileSize();
-	st->st_blksize = kOptimalIOSize;
-	st->st_mtim = node->ModifiedTime();
-	st->st_atim = st->st_mtim;
-	st->st_ctim = st->st_mtim;
-		// TODO: Perhaps manage a changed time (particularly for directories)?
-	st->st_crtim = st->st_mtim;
-	st->st_blocks = (st->st_size + 511) / 512;
+	fill_stat_buffer(node, st);
 
 	return B_OK;
 }
@@ -630,6 +667,54 @@ packagefs_read_dir(fs_volume* fsVolume, fs_vnode* fsNode, void* _cookie,
 }
 
 
+/*!	Reads the directory entries like packagefs_read_dir(), and fills in the
+	stat data and the requested attribute of the entries directly from the
+	in-memory nodes.
+*/
+static status_t
+packagefs_read_dir_stat(fs_volume* fsVolume, fs_vnode* fsNode, void* _cookie,
+	struct dirent* buffer, size_t bufferSize, struct stat* stats,
+	const char* attribute, void* attributeBuffer, size_t attributeSize,
+	uint32* _count)
+{
+	Volume* volume = (Volume*)fsVolume->private_volume;
+
+	status_t error = packagefs_read_dir(fsVolume, fsNode, _cookie, buffer,
+		bufferSize, _count);
+	if (error != B_OK)
+		return error;
+
+	// without search permission, only the entries are read
+	if (packagefs_access(fsVolume, fsNode, X_OK) != B_OK)
+		return B_OK;
+
+	uint32 count = *_count;
+	for (uint32 i = 0; i < count; i++) {
+		VolumeReadLocker volumeLocker(volume);
+		Node* child = volume->FindNode(buffer->d_ino);
+		BReference<Node> childReference(child);
+		volumeLocker.Unlock();
+
+		if (child != NULL) {
+			NodeReadLocker childLocker(child);
+			fill_stat_buffer(child, &stats[i]);
+			childLocker.Unlock();
+
+			if (attribute != NULL) {
+				void* slot = (uint8*)attributeBuffer + i * attributeSize;
+				size_t length = attributeSize;
+				if (read_attribute(child, attribute, slot, &length) != B_OK)
+					memset(slot, 0, attributeSize);
+			}
+		}
+
+		buffer = (dirent*)((addr_t)buffer + buffer->d_reclen);
+	}
+
+	return B_OK;
+}
+
+
 static status_t
 packagefs_rewind_dir(fs_volume* fsVolume, fs_vnode* fsNode, void* _cookie)
 {
@@ -815,6 +900,28 @@ packagefs_read_attr(fs_volume* fsVolume, fs_vnode* fsNode, void* _cookie,
 }
 
 
+static status_t
+packagefs_read_attrs(fs_volume* fsVolume, fs_vnode* fsNode, attr_io_vec* vecs,
+	size_t count)
+{
+	Volume* volume = (Volume*)fsVolume->private_volume;
+	Node* node = (Node*)fsNode->private_node;
+
+	FUNCTION("volume: %p, node: %p (%" B_PRId64 "), count: %" B_PRIuSIZE "\n",
+		volume, node, node->ID(), count);
+	TOUCH(volume);
+
+	for (size_t i = 0; i < count; i++) {
+		attr_io_vec& vec = vecs[i];
+		vec.status = read_attribute(node, vec.name, vec.buffer, &vec.length);
+		if (vec.status != B_OK)
+			vec.length = 0;
+	}
+
+	return B_OK;
+}
+
+
 status_t
 packagefs_read_attr_stat(fs_volume* fsVolume, fs_vnode* fsNode,
 	void* _cookie, struct stat* st)
@@ -1238,9 +1345,23 @@ fs_vnode_ops gPackageFSVnodeOps = {
 	&packagefs_read_attr_stat,
 	NULL,	// write_attr_stat,
 	NULL,	// rename_attr,
-	NULL	// remove_attr,
+	NULL,	// remove_attr,
 
 	// TODO: FS layer operations
+	NULL,	// create_special_node,
+	NULL,	// get_super_vnode,
+
+	// lock operations
+	NULL,	// test_lock,
+	NULL,	// acquire_lock,
+	NULL,	// release_lock,
+
+	// bulk directory operations
+	&packagefs_read_dir_stat,
+
+	// bulk attribute operations
+	&packagefs_read_attrs,
+	NULL	// write_attrs
 };
 
 
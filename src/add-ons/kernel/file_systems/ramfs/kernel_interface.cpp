@@ -674,6 +674,26 @@ ramfs_access(fs_volume* _volume, fs_vnode* _node, int mode)
 }
 
 
+// fill_stat_buffer
+static void
+fill_stat_buffer(Volume* volume, Node* node, struct stat *st)
+{
+	// The caller must hold the volume lock.
+	st->st_dev = volume->GetID();
+	st->st_ino = node->GetID();
+	st->st_mode = node->GetMode();
+	st->st_nlink = node->GetRefCount();
+	st->st_uid = node->GetUID();
+	st->st_gid = node->GetGID();
+	st->st_size = node->GetSize();
+	st->st_blksize = kOptimalIOSize;
+	st->st_atime = node->GetATime();
+	st->st_mtime = node->GetMTime();
+	st->st_ctime = node->GetCTime();
+	st->st_crtime = node->GetCrTime();
+}
+
+
 // ramfs_read_stat
 static status_t
 ramfs_read_stat(fs_volume* _volume, fs_vnode* _node, struct stat *st)
@@ -685,18 +705,7 @@ ramfs_read_stat(fs_volume* _volume, fs_vnode* _node, struct stat *st)
 	FUNCTION(("node: %lld\n", node->GetID()));
 	status_t error = B_OK;
 	if (VolumeReadLocker locker = volume) {
-		st->st_dev = volume->GetID();
-		st->st_ino = node->GetID();
-		st->st_mode = node->GetMode();
-		st->st_nlink = node->GetRefCount();
-		st->st_uid = node->GetUID();
-		st->st_gid = node->GetGID();
-		st->st_size = node->GetSize();
-		st->st_blksize = kOptimalIOSize;
-		st->st_atime = node->GetATime();
-		st->st_mtime = node->GetMTime();
-		st->st_ctime = node->GetCTime();
-		st->st_crtime = node->GetCrTime();
+		fill_stat_buffer(volume, node, st);
 	} else
 		SET_ERROR(error, B_ERROR);
 	RETURN_ERROR(error);
@@ -1327,6 +1336,74 @@ ramfs_read_dir(fs_volume* _volume, fs_vnode* DARG(_node), void* _cookie,
 }
 
 
+// ramfs_read_dir_stat
+static status_t
+ramfs_read_dir_stat(fs_volume* _volume, fs_vnode* _node, void* _cookie,
+	struct dirent *buffer, size_t bufferSize, struct stat *stats,
+	const char *attributeName, void *attributeBuffer, size_t attributeSize,
+	uint32 *count)
+{
+	FUNCTION_START();
+	Volume* volume = (Volume*)_volume->private_volume;
+
+	// read the entries one by one, as long as any name is guaranteed to fit
+	// (ramfs_read_dir() would otherwise skip the entry that doesn't)
+	struct dirent *entry = buffer;
+	uint32 maxCount = *count;
+	uint32 entryCount = 0;
+	while (entryCount < maxCount
+		&& bufferSize >= sizeof(struct dirent) + B_FILE_NAME_LENGTH) {
+		uint32 entryRead = 1;
+		status_t error = ramfs_read_dir(_volume, _node, _cookie, entry,
+			bufferSize, &entryRead);
+		if (error != B_OK) {
+			if (entryCount == 0)
+				RETURN_ERROR(error);
+			break;
+		}
+		if (entryRead == 0)
+			break;
+
+		bufferSize -= entry->d_reclen;
+		entry = (struct dirent*)((uint8*)entry + entry->d_reclen);
+		entryCount++;
+	}
+
+	// without search permission, only the entries are read
+	*count = entryCount;
+	if (ramfs_access(_volume, _node, X_OK) != B_OK)
+		return B_OK;
+
+	// fill in the stat data and attributes
+	if (VolumeReadLocker locker = volume) {
+		entry = buffer;
+		for (uint32 i = 0; i < entryCount; i++) {
+			Node *node = NULL;
+			if (volume->FindNode(entry->d_ino, &node) == B_OK) {
+				fill_stat_buffer(volume, node, &stats[i]);
+
+				Attribute *attribute = NULL;
+				if (attributeName != NULL
+					&& node->CheckPermissions(ACCESS_R) == B_OK
+					&& node->FindAttribute(attributeName, &attribute) == B_OK) {
+					void *slot = (uint8*)attributeBuffer + i * attributeSize;
+					size_t bytesRead;
+					if (attribute->ReadAt(0, slot, attributeSize, &bytesRead)
+							!= B_OK) {
+						memset(slot, 0, attributeSize);
+					}
+				}
+			}
+
+			entry = (struct dirent*)((uint8*)entry + entry->d_reclen);
+		}
+	} else
+		RETURN_ERROR(B_ERROR);
+
+	return B_OK;
+}
+
+
 // ramfs_rewind_dir
 static status_t
 ramfs_rewind_dir(fs_volume* /*fs*/, fs_vnode* /*_node*/, void* _cookie)
@@ -2239,7 +2316,16 @@ fs_vnode_ops gRamFSVnodeOps = {
 	&ramfs_remove_attr,
 
 	/* special nodes */
-	NULL	// create_special_node
+	NULL,	// create_special_node
+	NULL,	// get_super_vnode
+
+	/* lock operations */
+	NULL,	// test_lock
+	NULL,	// acquire_lock
+	NULL,	// release_lock
+
+	/* bulk directory operations */
+	&ramfs_read_dir_stat
 };
 
 static file_system_module_info sRamFSModuleInfo = {
@@ -16,6 +16,7 @@
 #include <net_buffer.h>
 #include <syscall_restart.h>
 #include <util/AutoLock.h>
+#include <WorkQueue.h>
 
 #include "stack_private.h"
 
@@ -30,10 +31,10 @@
 
 static struct list sTimers;
 static mutex sTimerLock;
-static sem_id sTimerWaitSem;
 static ConditionVariable sWaitForTimerCondition;
 static net_timer* sCurrentTimer;
-static thread_id sTimerThread;
+static WorkQueue sTimerQueue;
+static FunctionWorkItem sTimerWork;
 static bigtime_t sTimerTimeout;
 
 
@@ -321,60 +322,60 @@ fifo_socket_enqueue_buffer(net_fifo* fifo, net_socket* socket, uint8 event,
 //	#pragma mark - Timer
 
 
-static status_t
-timer_thread(void* /*data*/)
+/*!	Schedules the timer work item to run at \a due. sTimerLock must be held,
+	which also serializes the calls to QueueDelayed().
+*/
+static void
+schedule_timer_work(bigtime_t due)
 {
-	status_t status = B_OK;
+	sTimerTimeout = due;
+	if (due != B_INFINITE_TIMEOUT)
+		sTimerQueue.QueueDelayed(&sTimerWork, due - system_time());
+}
 
-	do {
-		bigtime_t timeout = B_INFINITE_TIMEOUT;
 
-		if (status == B_TIMED_OUT || status == B_OK) {
-			// scan timers for new timeout and/or execute a timer
-			mutex_lock(&sTimerLock);
+/*!	Executes all timers that are due and re-arms the timer work item for the
+	next one. Runs in the single worker thread of sTimerQueue, so timer hooks
+	are never executed concurrently.
+*/
+static void
+timer_work(void* /*data*/)
+{
+	bigtime_t timeout = B_INFINITE_TIMEOUT;
 
-			struct net_timer* timer = NULL;
-			while (true) {
-				timer = (net_timer*)list_get_next_item(&sTimers, timer);
-				if (timer == NULL)
-					break;
+	mutex_lock(&sTimerLock);
 
-				if (timer->due < system_time()) {
-					// execute timer
-					list_remove_item(&sTimers, timer);
-					timer->due = -1;
-					sCurrentTimer = timer;
-
-					mutex_unlock(&sTimerLock);
-					timer->hook(timer, timer->data);
-					mutex_lock(&sTimerLock);
-
-					sCurrentTimer = NULL;
-					sWaitForTimerCondition.NotifyAll();
-
-					timer = NULL;
-						// restart scanning as we unlocked the list
-				} else {
-					// calculate new timeout
-					if (timer->due < timeout)
-						timeout = timer->due;
-				}
-			}
+	struct net_timer* timer = NULL;
+	while (true) {
+		timer = (net_timer*)list_get_next_item(&sTimers, timer);
+		if (timer == NULL)
+			break;
+
+		if (timer->due <= system_time()) {
+			// execute timer
+			list_remove_item(&sTimers, timer);
+			timer->due = -1;
+			sCurrentTimer = timer;
 
-			sTimerTimeout = timeout;
 			mutex_unlock(&sTimerLock);
-		}
+			timer->hook(timer, timer->data);
+			mutex_lock(&sTimerLock);
 
-		status = acquire_sem_etc(sTimerWaitSem, 1, B_ABSOLUTE_TIMEOUT, timeout);
-			// the wait sem normally can't be acquired, so we
-			// have to look at the status value the call returns:
-			//
-			// B_OK - a new timer has been added or canceled
-			// B_TIMED_OUT - look for timers to be executed
-			// B_BAD_SEM_ID - we are asked to quit
-	} while (status != B_BAD_SEM_ID);
+			sCurrentTimer = NULL;
+			sWaitForTimerCondition.NotifyAll();
 
-	return B_OK;
+			timer = NULL;
+			timeout = B_INFINITE_TIMEOUT;
+				// restart scanning as we unlocked the list
+		} else {
+			// calculate new timeout
+			if (timer->due < timeout)
+				timeout = timer->due;
+		}
+	}
+
+	schedule_timer_work(timeout);
+	mutex_unlock(&sTimerLock);
 }
 
 
@@ -420,9 +421,9 @@ set_timer(net_timer* timer, bigtime_t delay)
 
 		timer->due = system_time() + delay;
 
-		// notify timer about the change if necessary
+		// reschedule the timer work if necessary
 		if (sTimerTimeout > timer->due)
-			release_sem(sTimerWaitSem);
+			schedule_timer_work(timer->due);
 	}
 }
 
@@ -448,7 +449,7 @@ cancel_timer(struct net_timer* timer)
 status_t
 wait_for_timer(struct net_timer* timer)
 {
-	if (find_thread(NULL) == sTimerThread) {
+	if (sTimerQueue.IsWorkerThread(find_thread(NULL))) {
 		// let's not wait for ourselves...
 		return B_BAD_VALUE;
 	}
@@ -511,44 +512,31 @@ init_timers(void)
 	list_init(&sTimers);
 	sTimerTimeout = B_INFINITE_TIMEOUT;
 
-	status_t status = B_OK;
 	mutex_init(&sTimerLock, "net timer");
 
-	sTimerWaitSem = create_sem(0, "net timer wait");
-	if (sTimerWaitSem < B_OK) {
-		status = sTimerWaitSem;
-		goto err1;
-	}
-
-	sTimerThread = spawn_kernel_thread(timer_thread, "net timer",
-		B_NORMAL_PRIORITY, NULL);
-	if (sTimerThread < B_OK) {
-		status = sTimerThread;
-		goto err2;
+	// A single worker keeps the timer hooks serialized
+	status_t status = sTimerQueue.Init("net timer", B_NORMAL_PRIORITY,
+		WORK_QUEUE_UNBOUND, 1);
+	if (status != B_OK) {
+		mutex_destroy(&sTimerLock);
+		return status;
 	}
 
+	sTimerWork.SetTo(&timer_work, NULL);
 	sWaitForTimerCondition.Init(NULL, "wait for net timer");
 
 	add_debugger_command("net_timer", dump_timer,
 		"Lists all active network timer");
 
-	return resume_thread(sTimerThread);
-
-err1:
-	mutex_destroy(&sTimerLock);
-err2:
-	delete_sem(sTimerWaitSem);
-	return status;
+	return B_OK;
 }
 
 
 void
 uninit_timers(void)
 {
-	delete_sem(sTimerWaitSem);
-
-	status_t status;
-	wait_for_thread(sTimerThread, &status);
+	sTimerQueue.Cancel(&sTimerWork);
+	sTimerQueue.Close(true);
 
 	mutex_lock(&sTimerLock);
 
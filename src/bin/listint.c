@@ -0,0 +1,128 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <OS.h>
+
+#include <interrupt_defs.h>
+#include <syscalls.h>
+
+
+static void
+usage(const char* program)
+{
+	fprintf(stderr, "Usage: %s [-c]\n"
+		"       %s -p <vector> <cpu>\n"
+		"       %s -u <vector>\n"
+		"Lists the interrupt vectors in use and the CPUs they are routed to.\n\n"
+		"  -c\t\tAlso print the number of interrupts per CPU.\n"
+		"  -p\t\tPin the vector to the given CPU.\n"
+		"  -u\t\tUnpin the vector, handing it back to the automatic balancing.\n",
+		program, program, program);
+	exit(1);
+}
+
+
+static int32
+parse_number(const char* program, const char* string)
+{
+	char* end;
+	long number = strtol(string, &end, 0);
+	if (end == string || *end != '\0')
+		usage(program);
+
+	return (int32)number;
+}
+
+
+static int
+set_affinity(int32 vector, int32 cpu)
+{
+	status_t status = _kern_set_interrupt_affinity(vector, cpu);
+	if (status != B_OK) {
+		fprintf(stderr, "Could not set the affinity of vector %" B_PRId32
+			": %s\n", vector, strerror(status));
+		return 1;
+	}
+
+	return 0;
+}
+
+
+static void
+list_interrupts(bool perCPU)
+{
+	system_info systemInfo;
+	get_system_info(&systemInfo);
+	uint32 cpuCount = systemInfo.cpu_count;
+
+	uint64* cpuCounts = NULL;
+	if (perCPU) {
+		cpuCounts = (uint64*)calloc(cpuCount, sizeof(uint64));
+		if (cpuCounts == NULL) {
+			fprintf(stderr, "Out of memory\n");
+			exit(1);
+		}
+	}
+
+	printf("vector  cpu  handlers   load             count");
+	if (perCPU) {
+		uint32 i;
+		for (i = 0; i < cpuCount; i++)
+			printf("      cpu%-3" B_PRIu32, i);
+	}
+	printf("\n");
+
+	interrupt_info info;
+	int32 cookie = 0;
+	while (_kern_get_next_interrupt_info(&cookie, &info, cpuCounts,
+			perCPU ? cpuCount : 0) == B_OK) {
+		printf("%6" B_PRId32 " %4" B_PRId32 "%c %8" B_PRId32 " %5" B_PRId32
+			".%" B_PRId32 "%% %17" B_PRIu64, info.vector, info.cpu,
+			(info.flags & INTERRUPT_INFO_PINNED) != 0 ? '*' : ' ',
+			info.handlers, info.load / 10, info.load % 10, info.count);
+
+		if (perCPU) {
+			uint32 i;
+			for (i = 0; i < cpuCount; i++)
+				printf(" %12" B_PRIu64, cpuCounts[i]);
+		}
+		printf("\n");
+	}
+
+	free(cpuCounts);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	const char* program = argv[0];
+
+	if (argc == 1) {
+		list_interrupts(false);
+		return 0;
+	}
+
+	if (!strcmp(argv[1], "-c") && argc == 2) {
+		list_interrupts(true);
+		return 0;
+	}
+
+	if (!strcmp(argv[1], "-p") && argc == 4) {
+		return set_affinity(parse_number(program, argv[2]),
+			parse_number(program, argv[3]));
+	}
+
+	if (!strcmp(argv[1], "-u") && argc == 3)
+		return set_affinity(parse_number(program, argv[2]), -1);
+
+	usage(program);
+	return 1;
+}
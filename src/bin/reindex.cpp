@@ -6,10 +6,12 @@
 
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <new>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <Directory.h>
 #include <Entry.h>
@@ -22,6 +24,8 @@
 #include <fs_index.h>
 #include <fs_info.h>
 
+#include "bfs_control.h"
+
 
 extern const char *__progname;
 static const char *kProgramName = __progname;
@@ -31,6 +35,7 @@ bool gVerbose = false;
 char *gAttrPattern;
 bool gIsPattern = false;
 bool gFromVolume = false;	// copy indices from another volume
+bool gBulk = false;			// rebuild the index of the whole volume
 BList gAttrList;				// list of indices of that volume
 
 
@@ -303,14 +308,49 @@ copyIndicesFromVolume(const char *path, BEntry &to)
 }
 
 
+/*!	Lets the file system rebuild the index from all files of the volume
+	at once, which is much faster than rewriting the attributes of each file.
+	Only BFS supports this.
+*/
+void
+rebuildIndex(const char *index, const char *path)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "%s: could not open \"%s\": %s\n", kProgramName, path,
+			strerror(errno));
+		return;
+	}
+
+	rebuild_index_control control;
+	memset(&control, 0, sizeof(control));
+	strlcpy(control.name, index, sizeof(control.name));
+
+	if (ioctl(fd, BFS_IOCTL_REBUILD_INDEX, &control, sizeof(control)) != 0) {
+		fprintf(stderr, "%s: could not rebuild index \"%s\" on the volume of "
+			"\"%s\": %s\n", kProgramName, index, path, strerror(errno));
+	} else if (gVerbose) {
+		printf("%s: rebuilt index \"%s\" with %" B_PRIu64 " entries, %"
+			B_PRIu64 " nodes, in %" B_PRId64 " ms\n", path, index,
+			control.entries, control.nodes, control.time / 1000);
+	}
+
+	close(fd);
+}
+
+
 void
 printUsage(char *cmd)
 {
 	printf("usage: %s [-rvf] attr <list of filenames and/or directories>\n"
+		"       %s -b [-v] index <list of volumes>\n"
 		"  -r\tenter directories recursively\n"
 		"  -v\tverbose output\n"
 		"  -f\tcreate/update all indices from the source volume,\n\t\"attr\" is "
-			"the path to the source volume\n", cmd);
+			"the path to the source volume\n"
+		"  -b\trebuild the existing index from all files of the volumes at "
+			"once;\n\tthe volumes are given by any path on them (BFS only)\n",
+		cmd, cmd);
 }
 
 
@@ -327,6 +367,9 @@ main(int argc, char **argv)
 	while (*++argv && **argv == '-') {
 		for (int i = 1; (*argv)[i]; i++) {
 			switch ((*argv)[i]) {
+				case 'b':
+					gBulk = true;
+					break;
 				case 'f':
 					gFromVolume = true;
 					break;
@@ -343,9 +386,19 @@ main(int argc, char **argv)
 		}
 	}
 	gAttrPattern = *argv;
+	if (gAttrPattern == NULL || (gBulk && (gRecursive || gFromVolume))) {
+		printUsage(cmd);
+		return 1;
+	}
 	if (strchr(gAttrPattern,'*'))
 		gIsPattern = true;
 
+	if (gBulk) {
+		while (*++argv)
+			rebuildIndex(gAttrPattern, *argv);
+		return 0;
+	}
+
 	while (*++argv) {
 		BEntry entry(*argv);
 		BNode node;
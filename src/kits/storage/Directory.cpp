@@ -380,6 +380,22 @@ BDirectory::GetNextDirents(dirent* buf, size_t bufSize, int32 count)
 }
 
 
+int32
+BDirectory::GetNextDirentsWithStat(dirent* buf, size_t bufSize,
+	struct stat* stats, int32 count, const char* attribute,
+	void* attributeBuffer, size_t attributeSize)
+{
+	if (buf == NULL || stats == NULL || count < 0)
+		return B_BAD_VALUE;
+	if (attribute != NULL && (attributeBuffer == NULL || attributeSize == 0))
+		return B_BAD_VALUE;
+	if (InitCheck() != B_OK)
+		return B_FILE_ERROR;
+	return _kern_read_dir_stat(fDirFd, buf, bufSize, stats, attribute,
+		attributeBuffer, attributeSize, count);
+}
+
+
 status_t
 BDirectory::Rewind()
 {
@@ -275,6 +275,32 @@ BNode::ReadAttr(const char* attr, type_code type, off_t offset,
 }
 
 
+status_t
+BNode::WriteAttrs(attr_io_vec* vecs, size_t count)
+{
+	if (fCStatus != B_OK)
+		return B_FILE_ERROR;
+
+	if (vecs == NULL && count > 0)
+		return B_BAD_VALUE;
+
+	return fs_write_attrs(fFd, vecs, count) < 0 ? errno : B_OK;
+}
+
+
+status_t
+BNode::ReadAttrs(attr_io_vec* vecs, size_t count) const
+{
+	if (fCStatus != B_OK)
+		return B_FILE_ERROR;
+
+	if (vecs == NULL && count > 0)
+		return B_BAD_VALUE;
+
+	return fs_read_attrs(fFd, vecs, count) < 0 ? errno : B_OK;
+}
+
+
 status_t
 BNode::RemoveAttr(const char* name)
 {
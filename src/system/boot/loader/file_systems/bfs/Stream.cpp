@@ -309,6 +309,9 @@ Stream::ReadAt(off_t pos, uint8* buffer, size_t* _length)
 	if (pos + (off_t)length > data.Size())
 		length = data.Size() - pos;
 
+	if ((Flags() & INODE_INLINE_DATA) != 0)
+		return ReadInlineData(pos, buffer, length, _length);
+
 	block_run run;
 	off_t offset;
 	if (FindBlockRun(pos, run, offset) < B_OK) {
@@ -415,6 +418,38 @@ Stream::ReadAt(off_t pos, uint8* buffer, size_t* _length)
 }
 
 
+/*!	Small files may keep their data in the small_data section of their
+	inode, which is not part of the Stream itself.
+*/
+status_t
+Stream::ReadInlineData(off_t pos, uint8* buffer, size_t length,
+	size_t* _length)
+{
+	*_length = 0;
+
+	CachedBlock cached(fVolume);
+	const bfs_inode* node = (const bfs_inode*)cached.SetTo(inode_num);
+	if (node == NULL)
+		return B_IO_ERROR;
+
+	const small_data* smallData = node->small_data_start;
+	for (; !smallData->IsLast(node); smallData = smallData->Next()) {
+		if (*smallData->Name() != INLINE_DATA_NAME
+			|| smallData->NameSize() != INLINE_DATA_NAME_LENGTH)
+			continue;
+
+		if (pos + (off_t)length > smallData->DataSize())
+			return B_BAD_DATA;
+
+		memcpy(buffer, smallData->Data() + pos, length);
+		*_length = length;
+		return B_OK;
+	}
+
+	return B_BAD_DATA;
+}
+
+
 Node*
 Stream::NodeFactory(Volume& volume, off_t id)
 {
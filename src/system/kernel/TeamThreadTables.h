@@ -7,6 +7,7 @@
 
 
 #include <thread_types.h>
+#include <util/rcu.h>
 
 
 namespace BKernel {
@@ -70,6 +71,9 @@ public:
 	{
 	}
 
+	/*!	The table never grows or shrinks; \a initialSize must be a power of
+		two and should be in the order of the expected number of elements.
+	*/
 	status_t Init(size_t initialSize)
 	{
 		return fTable.Init(initialSize);
@@ -78,6 +82,13 @@ public:
 	void Insert(Element* element)
 	{
 		element->serial_number = fNextSerialNumber++;
+
+		// Make sure lockless readers never see an uninitialized element or
+		// hash link. At worst they see the bucket chain cut off behind the
+		// new element, which LookupUnlocked() callers treat as a miss.
+		element->hash_next = NULL;
+		memory_write_barrier();
+
 		fTable.InsertUnchecked(element);
 		fList.Add(element);
 	}
@@ -95,6 +106,24 @@ public:
 			? element : NULL;
 	}
 
+	/*!	Looks up an element without holding the table's lock and acquires a
+		reference to it.
+		The caller must be in an RCU read-side critical section, and the
+		elements must not be freed before a grace period has passed after
+		their removal. Concurrent insertions may cause false misses, so
+		callers have to retry a miss with the lock held.
+	*/
+	Element* LookupUnlocked(id_type id) const
+	{
+		Element* element = fTable.Lookup(id);
+		if (element == NULL || !element->visible
+			|| !element->TryAcquireReference()) {
+			return NULL;
+		}
+
+		return element;
+	}
+
 	/*! Gets an iterator.
 		The iterator iterates through all, including invisible, entries!
 	*/
@@ -168,7 +197,9 @@ private:
 		}
 	};
 
-	typedef BOpenHashTable<HashDefinition> ElementTable;
+	// Not auto-expanding: LookupUnlocked() must never observe a resize,
+	// as it reads the table array and its size without synchronization.
+	typedef BOpenHashTable<HashDefinition, false> ElementTable;
 	typedef DoublyLinkedList<IteratorEntry> List;
 
 private:
@@ -27,6 +27,11 @@
 // the kernel timer is rescheduled.
 static const bigtime_t kMinPeriodicTimerInterval = 100;
 
+// Minimum delay in microseconds for a one-shot timer to be scheduled as a
+// coarse kernel timer. Coarse timers may fire up to an eighth of their delay
+// late, which is only acceptable for longer alarms and timeouts.
+static const bigtime_t kMinCoarseTimerDelay = 100000;
+
 static RealTimeUserTimerList sAbsoluteRealTimeTimers;
 static spinlock sAbsoluteRealTimeTimersLock = B_SPINLOCK_INITIALIZER;
 
@@ -292,6 +297,13 @@ UserTimer::CancelTimer()
 // #pragma mark - SystemTimeUserTimer
 
 
+SystemTimeUserTimer::SystemTimeUserTimer()
+	:
+	fPrecise(false)
+{
+}
+
+
 void
 SystemTimeUserTimer::Schedule(bigtime_t nextTime, bigtime_t interval,
 	uint32 flags, bigtime_t& _oldRemainingTime, bigtime_t& _oldInterval)
@@ -318,6 +330,8 @@ SystemTimeUserTimer::Schedule(bigtime_t nextTime, bigtime_t interval,
 	fNextTime = nextTime;
 	fInterval = interval;
 	fOverrunCount = 0;
+	fPrecise = thread_get_current_thread()->priority
+		>= B_REAL_TIME_DISPLAY_PRIORITY;
 
 	if (nextTime == B_INFINITE_TIMEOUT)
 		return;
@@ -381,6 +395,11 @@ SystemTimeUserTimer::ScheduleKernelTimer(bigtime_t now,
 
 	uint32 timerFlags = B_ONE_SHOT_ABSOLUTE_TIMER
 			| B_TIMER_USE_TIMER_STRUCT_TIMES;
+	if (fInterval == 0 && !fPrecise
+		&& fNextTime - now >= kMinCoarseTimerDelay) {
+		// longer one-shot timers (alarms, timeouts) can use the timer wheel
+		timerFlags |= B_TIMER_COARSE;
+	}
 
 	fTimer.schedule_time = std::max(fNextTime, (bigtime_t)0);
 	fTimer.period = 0;
@@ -425,6 +444,8 @@ RealTimeUserTimer::Schedule(bigtime_t nextTime, bigtime_t interval,
 	fNextTime = nextTime;
 	fInterval = interval;
 	fOverrunCount = 0;
+	fPrecise = thread_get_current_thread()->priority
+		>= B_REAL_TIME_DISPLAY_PRIORITY;
 
 	if (nextTime == B_INFINITE_TIMEOUT)
 		return;
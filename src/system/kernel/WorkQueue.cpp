@@ -0,0 +1,552 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include <WorkQueue.h>
+
+#include <new>
+#include <stdio.h>
+#include <string.h>
+
+#include <debug.h>
+#include <smp.h>
+#include <util/AutoLock.h>
+#include <util/atomic.h>
+
+
+#define NORMAL_PRIORITY		B_NORMAL_PRIORITY
+
+
+typedef DoublyLinkedList<WorkItem> WorkItemList;
+typedef DoublyLinkedList<WorkQueue> WorkQueueList;
+
+
+namespace BKernel {
+
+
+struct WorkerPool {
+	spinlock			lock;
+	WorkItemList		items;
+	ConditionVariable	pendingItemsCondition;
+	ConditionVariable	itemDoneCondition;
+	work_queue_stats	stats;
+};
+
+
+struct WorkQueue::Worker {
+	WorkQueue*			queue;
+	WorkerPool*			pool;
+	thread_id			thread;
+	WorkItem*			current;
+		// protected by the pool's lock
+};
+
+
+}	// namespace BKernel
+
+
+static WorkQueue sDefaultQueue;
+static WorkQueue sDefaultUnboundQueue;
+
+static WorkQueueList sWorkQueues;
+static spinlock sWorkQueuesLock = B_SPINLOCK_INITIALIZER;
+
+
+// #pragma mark - WorkItem
+
+
+WorkItem::WorkItem()
+	:
+	fInQueue(NULL),
+	fPool(NULL),
+	fQueueTime(0),
+	fTimerQueue(NULL)
+{
+	memset(&fTimer, 0, sizeof(fTimer));
+	fTimer.cpu = 0xffff;
+		// not scheduled -- lets cancel_timer() return early
+}
+
+
+WorkItem::~WorkItem()
+{
+}
+
+
+/*static*/ int32
+WorkItem::_TimerHook(timer* timer)
+{
+	WorkItem* item = (WorkItem*)timer->user_data;
+	item->fTimerQueue->Queue(item);
+	return B_HANDLED_INTERRUPT;
+}
+
+
+// #pragma mark - FunctionWorkItem
+
+
+FunctionWorkItem::FunctionWorkItem()
+	:
+	fFunction(NULL),
+	fArgument(NULL)
+{
+}
+
+
+void
+FunctionWorkItem::SetTo(void (*function)(void*), void* argument)
+{
+	fFunction = function;
+	fArgument = argument;
+}
+
+
+void
+FunctionWorkItem::DoWork(WorkQueue* queue)
+{
+	fFunction(fArgument);
+}
+
+
+// #pragma mark - WorkQueue
+
+
+WorkQueue::WorkQueue()
+	:
+	fFlags(0),
+	fMaxActive(0),
+	fPoolCount(0),
+	fPools(NULL),
+	fWorkers(NULL),
+	fClosed(true)
+{
+	fName[0] = '\0';
+}
+
+
+WorkQueue::~WorkQueue()
+{
+	Close(false);
+
+	delete[] fWorkers;
+	delete[] fPools;
+}
+
+
+/*static*/ WorkQueue*
+WorkQueue::DefaultQueue()
+{
+	return &sDefaultQueue;
+}
+
+
+/*static*/ WorkQueue*
+WorkQueue::DefaultUnboundQueue()
+{
+	return &sDefaultUnboundQueue;
+}
+
+
+status_t
+WorkQueue::Init(const char* name, int32 priority, uint32 flags,
+	int32 maxActive)
+{
+	if (maxActive < 1)
+		return B_BAD_VALUE;
+
+	strlcpy(fName, name, sizeof(fName));
+	fFlags = flags;
+	fMaxActive = maxActive;
+	fPoolCount = (flags & WORK_QUEUE_UNBOUND) != 0 ? 1 : smp_get_num_cpus();
+
+	fPools = new(std::nothrow) WorkerPool[fPoolCount];
+	fWorkers = new(std::nothrow) Worker[fPoolCount * fMaxActive];
+	if (fPools == NULL || fWorkers == NULL)
+		return B_NO_MEMORY;
+
+	for (int32 i = 0; i < fPoolCount * fMaxActive; i++)
+		fWorkers[i].thread = -1;
+
+	for (int32 i = 0; i < fPoolCount; i++) {
+		WorkerPool& pool = fPools[i];
+		B_INITIALIZE_SPINLOCK(&pool.lock);
+		pool.pendingItemsCondition.Init(&pool, "work queue");
+		pool.itemDoneCondition.Init(&pool, "work item done");
+		memset(&pool.stats, 0, sizeof(pool.stats));
+	}
+
+	fClosed = false;
+
+	// spawn the workers
+	for (int32 i = 0; i < fPoolCount * fMaxActive; i++) {
+		Worker& worker = fWorkers[i];
+		worker.queue = this;
+		worker.pool = &fPools[i / fMaxActive];
+		worker.current = NULL;
+
+		char threadName[B_OS_NAME_LENGTH];
+		if ((fFlags & WORK_QUEUE_UNBOUND) != 0)
+			snprintf(threadName, sizeof(threadName), "%s", fName);
+		else {
+			snprintf(threadName, sizeof(threadName), "%s: cpu %" B_PRId32,
+				fName, i / fMaxActive);
+		}
+
+		worker.thread = spawn_kernel_thread(&_WorkerEntry, threadName,
+			priority, &worker);
+		if (worker.thread < 0) {
+			status_t error = worker.thread;
+			Close(true);
+			return error;
+		}
+
+		resume_thread(worker.thread);
+	}
+
+	InterruptsSpinLocker locker(sWorkQueuesLock);
+	sWorkQueues.Add(this);
+
+	return B_OK;
+}
+
+
+void
+WorkQueue::Close(bool cancelPending)
+{
+	if (fPools == NULL || fClosed)
+		return;
+
+	{
+		InterruptsSpinLocker locker(sWorkQueuesLock);
+		if (sWorkQueues.Contains(this))
+			sWorkQueues.Remove(this);
+	}
+
+	for (int32 i = 0; i < fPoolCount; i++) {
+		WorkerPool& pool = fPools[i];
+		InterruptsSpinLocker locker(pool.lock);
+
+		// mark the queue closed
+		fClosed = true;
+
+		// If requested, dequeue all pending items
+		if (cancelPending) {
+			while (WorkItem* item = pool.items.RemoveHead()) {
+				item->fPool = NULL;
+				atomic_pointer_set(&item->fInQueue, (WorkQueue*)NULL);
+				pool.stats.pending--;
+			}
+		}
+
+		locker.Unlock();
+		pool.pendingItemsCondition.NotifyAll();
+	}
+
+	// wait for the workers
+	for (int32 i = 0; i < fPoolCount * fMaxActive; i++) {
+		if (fWorkers[i].thread >= 0)
+			wait_for_thread(fWorkers[i].thread, NULL);
+		fWorkers[i].thread = -1;
+	}
+}
+
+
+/*!	Queues \a item on the pool of the current CPU, or on the single pool of
+	an unbound queue. Returns \c EALREADY, if the item is already queued.
+	May be called from interrupt context.
+*/
+status_t
+WorkQueue::Queue(WorkItem* item)
+{
+	if (fPools == NULL)
+		return B_NOT_INITIALIZED;
+
+	if (fPoolCount == 1)
+		return _Queue(&fPools[0], item);
+
+	InterruptsLocker _;
+	return _Queue(&fPools[smp_get_current_cpu() % fPoolCount], item);
+}
+
+
+status_t
+WorkQueue::QueueOn(int32 cpu, WorkItem* item)
+{
+	if (fPools == NULL)
+		return B_NOT_INITIALIZED;
+	if (cpu < 0)
+		return B_BAD_VALUE;
+
+	return _Queue(&fPools[cpu % fPoolCount], item);
+}
+
+
+/*!	Queues \a item after \a delay has passed. If the item's timer is already
+	armed, it is re-armed with the new delay. Must not be called concurrently
+	for the same item.
+*/
+status_t
+WorkQueue::QueueDelayed(WorkItem* item, bigtime_t delay)
+{
+	if (fPools == NULL || _IsClosed())
+		return B_NOT_INITIALIZED;
+
+	cancel_timer(&item->fTimer);
+
+	if (delay <= 0)
+		return Queue(item);
+
+	item->fTimerQueue = this;
+	item->fTimer.user_data = item;
+	return add_timer(&item->fTimer, &WorkItem::_TimerHook, delay,
+		B_ONE_SHOT_RELATIVE_TIMER);
+}
+
+
+/*!	Removes \a item from the queue, if queued, and disarms its timer. If the
+	item is currently being executed, the function waits until it is done.
+	Returns \c true, if the item has been removed before it could run.
+*/
+bool
+WorkQueue::Cancel(WorkItem* item)
+{
+	if (fPools == NULL)
+		return false;
+
+	if (item->fTimerQueue == this)
+		cancel_timer(&item->fTimer);
+
+	for (int32 i = 0; i < fPoolCount; i++) {
+		WorkerPool& pool = fPools[i];
+		InterruptsSpinLocker locker(pool.lock);
+
+		// If the item is queued in this pool, remove it.
+		if (item->fPool == &pool) {
+			pool.items.Remove(item);
+			pool.stats.pending--;
+			item->fPool = NULL;
+			atomic_pointer_set(&item->fInQueue, (WorkQueue*)NULL);
+			return true;
+		}
+
+		// If one of the pool's workers is executing the item, we need to wait
+		// for it to be done. The condition is notified whenever any item of
+		// the pool is done, so we have to check again after every wakeup.
+		Worker* executingWorker;
+		while ((executingWorker = _ExecutingWorker(i, item)) != NULL) {
+			// the item is canceling itself
+			if (executingWorker->thread == thread_get_current_thread_id())
+				return false;
+
+			ConditionVariableEntry waitEntry;
+			pool.itemDoneCondition.Add(&waitEntry);
+
+			locker.Unlock();
+			waitEntry.Wait();
+			locker.Lock();
+		}
+	}
+
+	return false;
+}
+
+
+bool
+WorkQueue::IsWorkerThread(thread_id thread) const
+{
+	for (int32 i = 0; i < fPoolCount * fMaxActive; i++) {
+		if (fWorkers[i].thread == thread)
+			return true;
+	}
+
+	return false;
+}
+
+
+/*!	Returns the statistics summed up over all pools of the queue. */
+void
+WorkQueue::GetStatistics(work_queue_stats& stats) const
+{
+	memset(&stats, 0, sizeof(stats));
+
+	for (int32 i = 0; i < fPoolCount; i++) {
+		WorkerPool& pool = fPools[i];
+		InterruptsSpinLocker locker(pool.lock);
+
+		stats.queued += pool.stats.queued;
+		stats.executed += pool.stats.executed;
+		stats.pending += pool.stats.pending;
+		stats.max_pending = max_c(stats.max_pending, pool.stats.max_pending);
+		stats.total_latency += pool.stats.total_latency;
+		stats.max_latency = max_c(stats.max_latency, pool.stats.max_latency);
+	}
+}
+
+
+void
+WorkQueue::Dump() const
+{
+	kprintf("%-32s %s, %" B_PRId32 " pool(s) with %" B_PRId32 " worker(s)\n",
+		fName, (fFlags & WORK_QUEUE_UNBOUND) != 0 ? "unbound" : "bound",
+		fPoolCount, fMaxActive);
+
+	for (int32 i = 0; i < fPoolCount; i++) {
+		const work_queue_stats& stats = fPools[i].stats;
+		bigtime_t averageLatency = stats.executed > 0
+			? stats.total_latency / stats.executed : 0;
+
+		kprintf("  pool %3" B_PRId32 ": queued %10" B_PRId64 ", executed %10"
+			B_PRId64 ", pending %4" B_PRId32 " (max %4" B_PRId32 "), latency"
+			" avg %" B_PRIdBIGTIME " us, max %" B_PRIdBIGTIME " us\n", i,
+			stats.queued, stats.executed, stats.pending, stats.max_pending,
+			averageLatency, stats.max_latency);
+	}
+}
+
+
+/*static*/ status_t
+WorkQueue::_WorkerEntry(void* data)
+{
+	Worker* worker = (Worker*)data;
+	return worker->queue->_Worker(worker);
+}
+
+
+status_t
+WorkQueue::_Worker(Worker* worker)
+{
+	WorkerPool* pool = worker->pool;
+
+	while (true) {
+		InterruptsSpinLocker locker(pool->lock);
+
+		// get the next pending item
+		WorkItem* item = pool->items.RemoveHead();
+		if (item == NULL) {
+			// nothing is pending -- wait unless the queue is already closed
+			if (_IsClosed())
+				break;
+
+			ConditionVariableEntry waitEntry;
+			pool->pendingItemsCondition.Add(&waitEntry);
+
+			locker.Unlock();
+			waitEntry.Wait();
+
+			continue;
+		}
+
+		bigtime_t latency = system_time() - item->fQueueTime;
+		pool->stats.pending--;
+		pool->stats.total_latency += latency;
+		if (latency > pool->stats.max_latency)
+			pool->stats.max_latency = latency;
+
+		item->fPool = NULL;
+		atomic_pointer_set(&item->fInQueue, (WorkQueue*)NULL);
+		worker->current = item;
+
+		// execute the item -- it may be requeued or deleted from now on
+		locker.Unlock();
+		item->DoWork(this);
+		locker.Lock();
+
+		worker->current = NULL;
+		pool->stats.executed++;
+
+		// wake up threads waiting for an item to be done
+		locker.Unlock();
+		pool->itemDoneCondition.NotifyAll();
+	}
+
+	return B_OK;
+}
+
+
+/*!	Returns the worker of pool \a pool that is executing \a item, if any.
+	The pool's lock must be held.
+*/
+WorkQueue::Worker*
+WorkQueue::_ExecutingWorker(int32 pool, WorkItem* item) const
+{
+	for (int32 i = 0; i < fMaxActive; i++) {
+		Worker* worker = &fWorkers[pool * fMaxActive + i];
+		if (worker->current == item)
+			return worker;
+	}
+
+	return NULL;
+}
+
+
+status_t
+WorkQueue::_Queue(WorkerPool* pool, WorkItem* item)
+{
+	// claim the item -- it may only be queued once at a time
+	if (atomic_pointer_test_and_set(&item->fInQueue, this, (WorkQueue*)NULL)
+			!= NULL) {
+		return EALREADY;
+	}
+
+	InterruptsSpinLocker locker(pool->lock);
+
+	if (_IsClosed()) {
+		atomic_pointer_set(&item->fInQueue, (WorkQueue*)NULL);
+		return B_NOT_INITIALIZED;
+	}
+
+	item->fPool = pool;
+	item->fQueueTime = system_time();
+	pool->items.Add(item);
+
+	pool->stats.queued++;
+	if (++pool->stats.pending > pool->stats.max_pending)
+		pool->stats.max_pending = pool->stats.pending;
+
+	locker.Unlock();
+
+	pool->pendingItemsCondition.NotifyOne();
+	return B_OK;
+}
+
+
+// #pragma mark - debugger commands
+
+
+static int
+dump_work_queues(int argc, char** argv)
+{
+	WorkQueueList::Iterator iterator = sWorkQueues.GetIterator();
+	while (WorkQueue* queue = iterator.Next())
+		queue->Dump();
+
+	return 0;
+}
+
+
+// #pragma mark - kernel private
+
+
+void
+work_queue_init()
+{
+	new(&sWorkQueues) WorkQueueList;
+
+	// create the default queues
+	new(&sDefaultQueue) WorkQueue;
+	new(&sDefaultUnboundQueue) WorkQueue;
+
+	if (sDefaultQueue.Init("work queue", NORMAL_PRIORITY, 0, 1) != B_OK
+		|| sDefaultUnboundQueue.Init("work queue: unbound", NORMAL_PRIORITY,
+			WORK_QUEUE_UNBOUND, smp_get_num_cpus()) != B_OK) {
+		panic("Failed to create default work queues!");
+	}
+
+	add_debugger_command_etc("work_queues", &dump_work_queues,
+		"Dump all work queues and their statistics",
+		"\n"
+		"Prints all work queues with the number of queued and executed\n"
+		"items, and the queue-to-start latency of each worker pool.\n", 0);
+}
@@ -36,3 +36,11 @@ msi_free_vectors(uint32 count, uint32 startVector)
 {
 	sMSIInterface->FreeVectors(count, startVector);
 }
+
+
+void
+msi_set_vector_table(uint32 count, uint32 startVector, addr_t tableAddress)
+{
+	// The vectors keep sharing one CPU assignment, as they can't be
+	// retargeted individually.
+}
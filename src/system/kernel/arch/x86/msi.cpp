@@ -12,9 +12,17 @@
 #include <lock.h>
 
 
+// MSI-X table entry layout
+#define MSIX_ENTRY_ADDRESS_LOW		0
+#define MSIX_ENTRY_ADDRESS_HIGH		1
+#define MSIX_ENTRY_VECTOR_CONTROL	3
+#define MSIX_VECTOR_CONTROL_MASK	0x1
+
+
 struct MSIConfiguration {
-	uint64*	fAddress;
-	uint32* fData;
+	uint64*				fAddress;
+	uint32*				fData;
+	volatile uint32*	fTableEntry;
 };
 
 static MSIConfiguration sMSIConfigurations[NUM_IO_VECTORS];
@@ -64,6 +72,7 @@ msi_allocate_vectors(uint32 count, uint32 *startVector, uint64 *address,
 
 	sMSIConfigurations[vector].fAddress = address;
 	sMSIConfigurations[vector].fData = data;
+	sMSIConfigurations[vector].fTableEntry = NULL;
 	x86_set_irq_source(vector, IRQ_SOURCE_MSI);
 
 	*startVector = (uint32)vector;
@@ -89,17 +98,62 @@ msi_free_vectors(uint32 count, uint32 startVector)
 	dprintf("msi_free_vectors: freeing %" B_PRIu32 " vectors starting from %" B_PRIu32 "\n", count,
 		startVector);
 
+	for (uint32 i = 0; i < count; i++) {
+		sMSIConfigurations[startVector + i].fAddress = NULL;
+		sMSIConfigurations[startVector + i].fData = NULL;
+		sMSIConfigurations[startVector + i].fTableEntry = NULL;
+	}
+
 	free_io_interrupt_vectors(count, startVector);
 }
 
 
+/*!	Registers the MSI-X table the \a count vectors starting at \a startVector
+	have been programmed into. Since every table entry has its own message
+	address, the vectors are then assigned to CPUs individually instead of as
+	a block.
+*/
+void
+msi_set_vector_table(uint32 count, uint32 startVector, addr_t tableAddress)
+{
+	if (!sMSISupported)
+		return;
+
+	for (uint32 i = 0; i < count; i++) {
+		MSIConfiguration& configuration = sMSIConfigurations[startVector + i];
+		if (i > 0) {
+			configuration.fAddress = NULL;
+			configuration.fData = NULL;
+		}
+		configuration.fTableEntry = (volatile uint32*)(tableAddress + 16 * i);
+		x86_set_irq_source(startVector + i, IRQ_SOURCE_MSI);
+	}
+
+	split_io_interrupt_vectors(count, startVector);
+}
+
+
 void
 msi_assign_interrupt_to_cpu(uint32 irq, int32 cpu)
 {
 	uint32 apic_id = x86_get_cpu_apic_id(cpu);
 
-	uint64* address = sMSIConfigurations[irq].fAddress;
-	*address = MSI_ADDRESS_BASE | (apic_id << MSI_DESTINATION_ID_SHIFT)
+	uint64 address = MSI_ADDRESS_BASE | (apic_id << MSI_DESTINATION_ID_SHIFT)
 		| MSI_NO_REDIRECTION | MSI_DESTINATION_MODE_PHYSICAL;
+
+	MSIConfiguration& configuration = sMSIConfigurations[irq];
+	if (configuration.fAddress != NULL)
+		*configuration.fAddress = address;
+
+	// MSI-X entries can be retargeted while the device is running; mask the
+	// entry while its address is inconsistent, a pending message is
+	// delivered once it is unmasked again
+	volatile uint32* entry = configuration.fTableEntry;
+	if (entry != NULL) {
+		entry[MSIX_ENTRY_VECTOR_CONTROL] |= MSIX_VECTOR_CONTROL_MASK;
+		entry[MSIX_ENTRY_ADDRESS_LOW] = address & 0xffffffff;
+		entry[MSIX_ENTRY_ADDRESS_HIGH] = address >> 32;
+		entry[MSIX_ENTRY_VECTOR_CONTROL] &= ~MSIX_VECTOR_CONTROL_MASK;
+	}
 }
 
@@ -10,6 +10,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <sys/uio.h>
 
 #include <KernelExport.h>
 #include <fs_cache.h>
@@ -23,13 +24,20 @@
 #include <util/DoublyLinkedList.h>
 #include <util/AutoLock.h>
 #include <vm/vm_page.h>
+#include <WorkQueue.h>
 
 #include "kernel_debug_config.h"
 
+#ifdef _KERNEL_MODE
+#	include <vfs.h>
+
+#	include "IORequest.h"
+#endif
+
 
 // TODO: this is a naive but growing implementation to test the API:
-//	block reading/writing is not at all optimized for speed, it will
-//	just read and write single blocks.
+//	block reading is not at all optimized for speed, it will just read
+//	single blocks.
 // TODO: the retrieval/copy of the original data could be delayed until the
 //		new data must be written, ie. in low memory situations.
 
@@ -53,6 +61,12 @@
 
 static const bigtime_t kTransactionIdleTime = 2000000LL;
 	// a transaction is considered idle after 2 seconds of inactivity
+static const uint32 kBlockShardCount = 16;
+	// number of independently locked parts of the block hash table
+static const uint32 kMaxMergedBlocks = 32;
+	// maximum number of consecutive blocks written back with a single request
+static const int32 kMaxSkippedUnusedBlocks = 64;
+	// maximum number of recently used blocks passed when freeing unused ones
 
 
 namespace {
@@ -170,12 +184,14 @@ struct BlockHash {
 
 	size_t HashKey(KeyType key) const
 	{
-		return key;
+		// the lower bits select the shard, and are the same for all blocks
+		// in its table
+		return key / kBlockShardCount;
 	}
 
 	size_t Hash(ValueType* block) const
 	{
-		return block->block_number;
+		return block->block_number / kBlockShardCount;
 	}
 
 	bool Compare(KeyType key, ValueType* block) const
@@ -192,6 +208,19 @@ struct BlockHash {
 typedef BOpenHashTable<BlockHash> BlockTable;
 
 
+/*!	One part of the block hash table. Changing the table requires both the
+	cache lock and the write lock of the shard, so that blocks can be looked
+	up with either of them. block_cache_get_etc() and block_cache_put() only
+	use the read lock for blocks that are already cached and clean.
+	The shard write lock also protects the transitions of the \c discard, and
+	\c busy_reading flags, as well as the last reference of unused blocks.
+*/
+struct block_shard {
+	rw_lock			lock;
+	BlockTable		hash;
+};
+
+
 struct TransactionHash {
 	typedef int32				KeyType;
 	typedef	cache_transaction	ValueType;
@@ -210,7 +239,7 @@ typedef BOpenHashTable<TransactionHash> TransactionTable;
 
 
 struct block_cache : DoublyLinkedListLinkImpl<block_cache> {
-	BlockTable*		hash;
+	block_shard		shards[kBlockShardCount];
 	mutex			lock;
 	int				fd;
 	off_t			max_blocks;
@@ -240,6 +269,11 @@ struct block_cache : DoublyLinkedListLinkImpl<block_cache> {
 	NotificationList pending_notifications;
 	ConditionVariable condition_variable;
 
+	thread_id		writer_thread;
+	ConditionVariable writer_condition;
+	bool			quit_writer;
+	size_t			used_memory;
+
 					block_cache(int fd, off_t numBlocks, size_t blockSize,
 						bool readOnly);
 					~block_cache();
@@ -252,7 +286,14 @@ struct block_cache : DoublyLinkedListLinkImpl<block_cache> {
 	cached_block*	NewBlock(off_t blockNumber);
 	void			FreeBlockParentData(cached_block* block);
 
+	block_shard&	Shard(off_t blockNumber)
+						{ return shards[blockNumber % kBlockShardCount]; }
+	cached_block*	Lookup(off_t blockNumber)
+						{ return Shard(blockNumber).hash.Lookup(blockNumber); }
+	void			Insert(cached_block* block);
+
 	void			RemoveUnusedBlocks(int32 count, int32 minSecondsOld = 0);
+	bool			RemoveUnusedBlock(cached_block* block);
 	void			RemoveBlock(cached_block* block);
 	void			DiscardBlock(cached_block* block);
 
@@ -303,6 +344,8 @@ public:
 private:
 			void*				_Data(cached_block* block) const;
 			status_t			_WriteBlock(cached_block* block);
+			status_t			_WriteBlocks(cached_block** blocks,
+									uint32 count);
 			void				_BlockDone(cached_block* block,
 									cache_transaction* transaction);
 			void				_UnmarkWriting(cached_block* block);
@@ -766,12 +809,12 @@ static mutex sCachesLock = MUTEX_INITIALIZER("block caches");
 static mutex sCachesMemoryUseLock
 	= MUTEX_INITIALIZER("block caches memory use");
 static size_t sUsedMemory;
-static sem_id sEventSemaphore;
+	// the sum of the used_memory of all caches
+static size_t sBlockUsedMemory;
+static WorkQueue sNotificationQueue;
+static FunctionWorkItem sNotificationWork;
 static mutex sNotificationsLock
 	= MUTEX_INITIALIZER("block cache notifications");
-static thread_id sNotifierWriterThread;
-static DoublyLinkedListLink<block_cache> sMarkCache;
-	// TODO: this only works if the link is the first entry of block_cache
 static object_cache* sBlockCache;
 
 
@@ -905,7 +948,7 @@ delete_notification(cache_notification* notification)
 	already part of it, updates its events_pending field.
 	Also marks the notification to be deleted if \a deleteNotification
 	is \c true.
-	Triggers the notifier thread to run.
+	Queues the notifier work item to run.
 */
 static void
 add_notification(block_cache* cache, cache_notification* notification,
@@ -926,9 +969,9 @@ add_notification(block_cache* cache, cache_notification* notification,
 		delete_notification(notification);
 	}
 
-	release_sem_etc(sEventSemaphore, 1, B_DO_NOT_RESCHEDULE);
-		// We're probably still holding some locks that makes rescheduling
-		// not a good idea at this point.
+	sNotificationQueue.Queue(&sNotificationWork);
+		// Does not reschedule -- we're probably still holding some locks
+		// that make rescheduling not a good idea at this point.
 }
 
 
@@ -1205,24 +1248,39 @@ BlockWriter::Write(cache_transaction* transaction, bool canUnlock)
 	if (canUnlock)
 		mutex_unlock(&fCache->lock);
 
-	// Sort blocks in their on-disk order
-	// TODO: ideally, this should be handled by the I/O scheduler
+	// Sort blocks in their on-disk order, so that consecutive blocks can be
+	// written with a single request
 
 	qsort(fBlocks, fCount, sizeof(void*), &_CompareBlocks);
 	fDeletedTransaction = false;
 
 	bigtime_t start = system_time();
 
-	for (uint32 i = 0; i < fCount; i++) {
-		status_t status = _WriteBlock(fBlocks[i]);
-		if (status != B_OK) {
-			// propagate to global error handling
-			if (fStatus == B_OK)
-				fStatus = status;
+	for (uint32 i = 0; i < fCount;) {
+		uint32 count = 1;
+		while (i + count < fCount && count < kMaxMergedBlocks
+			&& fBlocks[i + count]->block_number
+				== fBlocks[i]->block_number + count) {
+			count++;
+		}
+
+		if (count > 1 && _WriteBlocks(fBlocks + i, count) == B_OK) {
+			i += count;
+			continue;
+		}
 
-			_UnmarkWriting(fBlocks[i]);
-			fBlocks[i] = NULL;
-				// This block will not be marked clean
+		// Write the blocks one by one, so that we know which of them failed
+		for (uint32 end = i + count; i < end; i++) {
+			status_t status = _WriteBlock(fBlocks[i]);
+			if (status != B_OK) {
+				// propagate to global error handling
+				if (fStatus == B_OK)
+					fStatus = status;
+
+				_UnmarkWriting(fBlocks[i]);
+				fBlocks[i] = NULL;
+					// This block will not be marked clean
+			}
 		}
 	}
 
@@ -1298,6 +1356,41 @@ BlockWriter::_WriteBlock(cached_block* block)
 }
 
 
+/*!	Writes the \a count consecutive \a blocks back to disk with a single
+	request.
+*/
+status_t
+BlockWriter::_WriteBlocks(cached_block** blocks, uint32 count)
+{
+	ASSERT(count <= kMaxMergedBlocks);
+
+	size_t blockSize = fCache->block_size;
+	iovec vecs[kMaxMergedBlocks];
+
+	for (uint32 i = 0; i < count; i++) {
+		ASSERT(blocks[i]->busy_writing);
+		TB(Write(fCache, blocks[i]));
+		TB2(BlockData(fCache, blocks[i], "before write"));
+
+		vecs[i].iov_base = _Data(blocks[i]);
+		vecs[i].iov_len = blockSize;
+	}
+
+	TRACE(("BlockWriter::_WriteBlocks(block %" B_PRIdOFF ", count %" B_PRIu32
+		")\n", blocks[0]->block_number, count));
+
+	ssize_t written = writev_pos(fCache->fd,
+		blocks[0]->block_number * blockSize, vecs, count);
+	if (written != (ssize_t)(blockSize * count)) {
+		TB(Error(fCache, blocks[0]->block_number, "merged write failed",
+			written));
+		return written < 0 ? errno : B_IO_ERROR;
+	}
+
+	return B_OK;
+}
+
+
 void
 BlockWriter::_BlockDone(cached_block* block,
 	cache_transaction* transaction)
@@ -1397,7 +1490,6 @@ BlockWriter::_CompareBlocks(const void* _blockA, const void* _blockB)
 block_cache::block_cache(int _fd, off_t numBlocks, size_t blockSize,
 		bool readOnly)
 	:
-	hash(NULL),
 	fd(_fd),
 	max_blocks(numBlocks),
 	block_size(blockSize),
@@ -1413,8 +1505,13 @@ block_cache::block_cache(int _fd, off_t numBlocks, size_t blockSize,
 	last_block_write(0),
 	last_block_write_duration(0),
 	num_dirty_blocks(0),
-	read_only(readOnly)
+	read_only(readOnly),
+	writer_thread(-1),
+	quit_writer(false),
+	used_memory(0)
 {
+	for (uint32 i = 0; i < kBlockShardCount; i++)
+		rw_lock_init(&shards[i].lock, "block cache shard");
 }
 
 
@@ -1424,10 +1521,11 @@ block_cache::~block_cache()
 	unregister_low_resource_handler(&_LowMemoryHandler, this);
 
 	delete transaction_hash;
-	delete hash;
 
 	delete_object_cache(buffer_cache);
 
+	for (uint32 i = 0; i < kBlockShardCount; i++)
+		rw_lock_destroy(&shards[i].lock);
 	mutex_destroy(&lock);
 }
 
@@ -1438,6 +1536,7 @@ block_cache::Init()
 	busy_reading_condition.Init(this, "cache block busy_reading");
 	busy_writing_condition.Init(this, "cache block busy writing");
 	condition_variable.Init(this, "cache transaction sync");
+	writer_condition.Init(this, "block writer");
 	mutex_init(&lock, "block cache");
 
 	buffer_cache = create_object_cache_etc("block cache buffers", block_size,
@@ -1445,9 +1544,10 @@ block_cache::Init()
 	if (buffer_cache == NULL)
 		return B_NO_MEMORY;
 
-	hash = new BlockTable();
-	if (hash == NULL || hash->Init(1024) != B_OK)
-		return B_NO_MEMORY;
+	for (uint32 i = 0; i < kBlockShardCount; i++) {
+		if (shards[i].hash.Init(1024 / kBlockShardCount) != B_OK)
+			return B_NO_MEMORY;
+	}
 
 	transaction_hash = new(std::nothrow) TransactionTable();
 	if (transaction_hash == NULL || transaction_hash->Init(16) != B_OK)
@@ -1566,16 +1666,37 @@ block_cache::FreeBlockParentData(cached_block* block)
 }
 
 
+void
+block_cache::Insert(cached_block* block)
+{
+	block_shard& shard = Shard(block->block_number);
+
+	WriteLocker _(shard.lock);
+	shard.hash.Insert(block);
+}
+
+
 void
 block_cache::RemoveUnusedBlocks(int32 count, int32 minSecondsOld)
 {
 	TRACE(("block_cache: remove up to %" B_PRId32 " unused blocks\n", count));
 
+	int32 skipped = 0;
+
 	for (block_list::Iterator iterator = unused_blocks.GetIterator();
 			cached_block* block = iterator.Next();) {
 		if (minSecondsOld >= block->LastAccess()) {
-			// The list is sorted by last access
-			break;
+			// The list is sorted by the time the blocks were put, but
+			// blocks that were accessed without the lock stay where they
+			// are. Move those to the end of the list, and stop when there
+			// are too many of them; the remaining blocks are likely just
+			// as young.
+			if (++skipped > kMaxSkippedUnusedBlocks)
+				break;
+
+			iterator.Remove();
+			unused_blocks.Add(block);
+			continue;
 		}
 		if (block->busy_reading || block->busy_writing)
 			continue;
@@ -1590,12 +1711,17 @@ block_cache::RemoveUnusedBlocks(int32 count, int32 minSecondsOld)
 				continue;
 
 			BlockWriter::WriteBlock(this, block);
+			if (!block->unused) {
+				// the block has been reused while we were writing it
+				continue;
+			}
 		}
 
 		// remove block from lists
-		iterator.Remove();
-		unused_block_count--;
-		RemoveBlock(block);
+		if (!RemoveUnusedBlock(block))
+			continue;
+
+		FreeBlock(block);
 
 		if (--count <= 0)
 			break;
@@ -1603,10 +1729,44 @@ block_cache::RemoveUnusedBlocks(int32 count, int32 minSecondsOld)
 }
 
 
+/*!	Removes the \a block from the unused list, and also from the hash table,
+	unless it has been retrieved without the cache lock in the meantime.
+	In that case, block_cache_put() will put it back into the unused list.
+	Returns whether or not the block has been removed from the hash table.
+*/
+bool
+block_cache::RemoveUnusedBlock(cached_block* block)
+{
+	ASSERT(block->unused);
+
+	unused_blocks.Remove(block);
+	unused_block_count--;
+
+	block_shard& shard = Shard(block->block_number);
+	WriteLocker _(shard.lock);
+
+	block->unused = false;
+	if (block->ref_count != 0)
+		return false;
+
+	shard.hash.Remove(block);
+	return true;
+}
+
+
+/*!	Removes the \a block from the hash table, and frees it. No one must be
+	able to get a reference to it anymore, ie. it must either be referenced
+	by the caller, or be marked busy or discarded.
+*/
 void
 block_cache::RemoveBlock(cached_block* block)
 {
-	hash->Remove(block);
+	block_shard& shard = Shard(block->block_number);
+
+	WriteLocker locker(shard.lock);
+	shard.hash.Remove(block);
+	locker.Unlock();
+
 	FreeBlock(block);
 }
 
@@ -1692,16 +1852,17 @@ block_cache::_GetUnusedBlock()
 			cached_block* block = iterator.Next();) {
 		TB(Flush(this, block, true));
 		// this can only happen if no transactions are used
-		if (block->is_dirty && !block->busy_writing && !block->discard)
+		if (block->is_dirty && !block->busy_writing && !block->discard) {
 			BlockWriter::WriteBlock(this, block);
+			if (!block->unused)
+				continue;
+		}
 
 		// remove block from lists
-		iterator.Remove();
-		unused_block_count--;
-		hash->Remove(block);
+		if (!RemoveUnusedBlock(block))
+			continue;
 
 		ASSERT(block->original_data == NULL && block->parent_data == NULL);
-		block->unused = false;
 
 		// TODO: see if compare data is handled correctly here!
 #if BLOCK_CACHE_DEBUG_CHANGED
@@ -1733,7 +1894,12 @@ mark_block_busy_reading(block_cache* cache, cached_block* block)
 static void
 mark_block_unbusy_reading(block_cache* cache, cached_block* block)
 {
-	block->busy_reading = false;
+	{
+		// make sure the data is visible to lockless readers before they
+		// can see the block
+		WriteLocker _(cache->Shard(block->block_number).lock);
+		block->busy_reading = false;
+	}
 	cache->busy_reading_count--;
 
 	if ((cache->busy_reading_waiters && cache->busy_reading_count == 0)
@@ -1854,16 +2020,16 @@ put_cached_block(block_cache* cache, cached_block* block)
 		return;
 	}
 
-	if (--block->ref_count == 0
+	if (atomic_add(&block->ref_count, -1) == 1
 		&& block->transaction == NULL && block->previous_transaction == NULL) {
 		// This block is not used anymore, and not part of any transaction
 		block->is_writing = false;
 
 		if (block->discard) {
 			cache->RemoveBlock(block);
-		} else {
-			// put this block in the list of unused blocks
-			ASSERT(!block->unused);
+		} else if (!block->unused) {
+			// put this block in the list of unused blocks (it might still be
+			// in there if it was only retrieved without the lock)
 			block->unused = true;
 
 			ASSERT(block->original_data == NULL && block->parent_data == NULL);
@@ -1882,7 +2048,7 @@ put_cached_block(block_cache* cache, off_t blockNumber)
 			blockNumber, cache->max_blocks - 1);
 	}
 
-	cached_block* block = cache->hash->Lookup(blockNumber);
+	cached_block* block = cache->Lookup(blockNumber);
 	if (block != NULL)
 		put_cached_block(cache, block);
 	else {
@@ -1891,6 +2057,77 @@ put_cached_block(block_cache* cache, off_t blockNumber)
 }
 
 
+#if !BLOCK_CACHE_DEBUG_CHANGED
+
+
+/*!	Retrieves the block \a blockNumber without the cache lock, if it is
+	already in the cache, and is clean. Otherwise, \c NULL is returned, and
+	the caller needs to use get_cached_block() instead.
+	The block stays in the unused list if it's in there, so that no list
+	needs to be changed.
+*/
+static cached_block*
+get_cached_block_lockless(block_cache* cache, off_t blockNumber)
+{
+	if (blockNumber < 0 || blockNumber >= cache->max_blocks)
+		return NULL;
+
+	block_shard& shard = cache->Shard(blockNumber);
+	ReadLocker _(shard.lock);
+
+	cached_block* block = shard.hash.Lookup(blockNumber);
+	if (block == NULL || block->busy_reading || block->discard
+		|| block->is_dirty || block->is_writing || block->transaction != NULL
+		|| block->previous_transaction != NULL) {
+		return NULL;
+	}
+
+	atomic_add(&block->ref_count, 1);
+	block->last_accessed = system_time() / 1000000L;
+
+	TB(Get(cache, block));
+	return block;
+}
+
+
+/*!	Removes a reference from the block \a blockNumber without the cache lock.
+	Returns \c false if that's not possible, because this is the last
+	reference, and the block needs to be moved into the unused list, or
+	removed from the cache. In this case, put_cached_block() must be used
+	instead.
+*/
+static bool
+put_cached_block_lockless(block_cache* cache, off_t blockNumber)
+{
+	if (blockNumber < 0 || blockNumber >= cache->max_blocks)
+		return false;
+
+	block_shard& shard = cache->Shard(blockNumber);
+	ReadLocker _(shard.lock);
+
+	cached_block* block = shard.hash.Lookup(blockNumber);
+	if (block == NULL)
+		return false;
+
+	while (true) {
+		int32 refCount = atomic_get(&block->ref_count);
+		if (refCount < 1)
+			return false;
+		if (refCount == 1 && (!block->unused || block->discard))
+			return false;
+
+		if (atomic_test_and_set(&block->ref_count, refCount - 1, refCount)
+				== refCount) {
+			TB(Put(cache, block));
+			return true;
+		}
+	}
+}
+
+
+#endif	// !BLOCK_CACHE_DEBUG_CHANGED
+
+
 /*!	Retrieves the block \a blockNumber from the hash table, if it's already
 	there, or reads it from the disk.
 	You need to have the cache locked when calling this function.
@@ -1899,8 +2136,9 @@ put_cached_block(block_cache* cache, off_t blockNumber)
 		to satisfy your request.
 	\param readBlock if \c false, the block will not be read in case it was
 		not already in the cache. The block you retrieve may contain random
-		data. If \c true, the cache will be temporarily unlocked while the
-		block is read in.
+		data, and stays marked busy until you call mark_block_unbusy_reading()
+		after you initialized it. If \c true, the cache will be temporarily
+		unlocked while the block is read in.
 */
 static status_t
 get_cached_block(block_cache* cache, off_t blockNumber, bool* _allocated,
@@ -1915,7 +2153,7 @@ get_cached_block(block_cache* cache, off_t blockNumber, bool* _allocated,
 	}
 
 retry:
-	cached_block* block = cache->hash->Lookup(blockNumber);
+	cached_block* block = cache->Lookup(blockNumber);
 	*_allocated = false;
 
 	if (block == NULL) {
@@ -1924,7 +2162,9 @@ retry:
 		if (block == NULL)
 			return B_NO_MEMORY;
 
-		cache->hash->Insert(block);
+		// it must not be visible to lockless readers before it's initialized
+		mark_block_busy_reading(cache, block);
+		cache->Insert(block);
 		*_allocated = true;
 	} else if (block->busy_reading) {
 		// The block is currently busy_reading - wait and try again later
@@ -1943,7 +2183,6 @@ retry:
 		// read block into cache
 		int32 blockSize = cache->block_size;
 
-		mark_block_busy_reading(cache, block);
 		mutex_unlock(&cache->lock);
 
 		ssize_t bytesRead = read_pos(cache->fd, blockNumber * blockSize,
@@ -1963,7 +2202,7 @@ retry:
 		mark_block_unbusy_reading(cache, block);
 	}
 
-	block->ref_count++;
+	atomic_add(&block->ref_count, 1);
 	block->last_accessed = system_time() / 1000000L;
 
 	*_block = block;
@@ -2006,7 +2245,8 @@ get_writable_cached_block(block_cache* cache, off_t blockNumber, off_t base,
 	// if there is no transaction support, we just return the current block
 	if (transactionID == -1) {
 		if (cleared) {
-			mark_block_busy_reading(cache, block);
+			if (!allocated)
+				mark_block_busy_reading(cache, block);
 			mutex_unlock(&cache->lock);
 
 			memset(block->current_data, 0, cache->block_size);
@@ -2110,7 +2350,8 @@ get_writable_cached_block(block_cache* cache, off_t blockNumber, off_t base,
 		transaction->sub_num_blocks++;
 
 	if (cleared) {
-		mark_block_busy_reading(cache, block);
+		if (!allocated)
+			mark_block_busy_reading(cache, block);
 		mutex_unlock(&cache->lock);
 
 		memset(block->current_data, 0, cache->block_size);
@@ -2128,6 +2369,153 @@ get_writable_cached_block(block_cache* cache, off_t blockNumber, off_t base,
 }
 
 
+#ifdef _KERNEL_MODE
+
+
+/*!	Reads a run of consecutive blocks that are not yet in the cache with a
+	single asynchronous request. The blocks are inserted into the cache
+	right away, but stay busy until the request has finished.
+	The object deletes itself once it is done.
+*/
+class BlockPrefetcher : public AsyncIOCallback {
+public:
+								BlockPrefetcher(block_cache* cache,
+									off_t blockNumber, size_t numBlocks);
+
+			status_t			Allocate();
+			void				ReadAsync();
+
+			size_t				NumAllocated() const { return fNumAllocated; }
+
+	virtual	void				IOFinished(status_t status,
+									bool partialTransfer,
+									generic_size_t bytesTransferred);
+
+private:
+			block_cache*		fCache;
+			off_t				fBlockNumber;
+			size_t				fNumRequested;
+			size_t				fNumAllocated;
+			cached_block*		fBlocks[kMaxMergedBlocks];
+			generic_io_vec		fVecs[kMaxMergedBlocks];
+};
+
+
+BlockPrefetcher::BlockPrefetcher(block_cache* cache, off_t blockNumber,
+		size_t numBlocks)
+	:
+	fCache(cache),
+	fBlockNumber(blockNumber),
+	fNumRequested(min_c(numBlocks, kMaxMergedBlocks)),
+	fNumAllocated(0)
+{
+}
+
+
+/*!	Inserts busy blocks for the requested range into the cache, up to the
+	first block that is already cached.
+	Cache must be locked.
+*/
+status_t
+BlockPrefetcher::Allocate()
+{
+	ASSERT_LOCKED_MUTEX(&fCache->lock);
+
+	for (; fNumAllocated < fNumRequested; fNumAllocated++) {
+		off_t blockNumber = fBlockNumber + fNumAllocated;
+		if (fCache->Lookup(blockNumber) != NULL)
+			break;
+
+		cached_block* block = fCache->NewBlock(blockNumber);
+		if (block == NULL)
+			break;
+
+		mark_block_busy_reading(fCache, block);
+		fCache->Insert(block);
+
+		fBlocks[fNumAllocated] = block;
+		fVecs[fNumAllocated].base = (generic_addr_t)block->current_data;
+		fVecs[fNumAllocated].length = fCache->block_size;
+	}
+
+	return fNumAllocated > 0 ? B_OK : B_NO_MEMORY;
+}
+
+
+/*!	Issues the read request. IOFinished() is always called, either when the
+	request is done, or if it could not be issued at all.
+	Cache must not be locked.
+*/
+void
+BlockPrefetcher::ReadAsync()
+{
+	generic_size_t length = fNumAllocated * fCache->block_size;
+
+	IORequest* request = IORequest::Create(false);
+	if (request == NULL) {
+		IOFinished(B_NO_MEMORY, true, 0);
+		return;
+	}
+
+	status_t status = request->Init(fBlockNumber * fCache->block_size, fVecs,
+		fNumAllocated, length, false, B_DELETE_IO_REQUEST);
+	if (status != B_OK) {
+		delete request;
+		IOFinished(status, true, 0);
+		return;
+	}
+
+	request->SetFinishedCallback(&AsyncIOCallback::IORequestCallback, this);
+
+	do_fd_io(fCache->fd, request);
+}
+
+
+void
+BlockPrefetcher::IOFinished(status_t status, bool partialTransfer,
+	generic_size_t bytesTransferred)
+{
+	MutexLocker locker(&fCache->lock);
+
+	for (size_t i = 0; i < fNumAllocated; i++) {
+		cached_block* block = fBlocks[i];
+
+		if (status == B_OK && !block->discard
+			&& (i + 1) * fCache->block_size <= bytesTransferred) {
+			TB(Read(fCache, block));
+
+			block->last_accessed = system_time() / 1000000L;
+			mark_block_unbusy_reading(fCache, block);
+
+			// No one could have gotten a reference to the busy block yet
+			ASSERT(block->ref_count == 0 && !block->unused);
+			block->unused = true;
+			fCache->unused_blocks.Add(block);
+			fCache->unused_block_count++;
+			continue;
+		}
+
+		// Remove the block again; it will be read synchronously once it's
+		// actually needed
+		TB(Error(fCache, block->block_number, "prefetch failed", status));
+
+		{
+			block_shard& shard = fCache->Shard(block->block_number);
+			WriteLocker _(shard.lock);
+			shard.hash.Remove(block);
+		}
+		mark_block_unbusy_reading(fCache, block);
+		fCache->FreeBlock(block);
+	}
+
+	locker.Unlock();
+	delete this;
+}
+
+
+#endif	// _KERNEL_MODE
+
+
 #if DEBUG_BLOCK_CACHE
 
 
@@ -2243,7 +2631,7 @@ dump_cache(int argc, char** argv)
 	off_t blockNumber = -1;
 	if (i + 1 < argc) {
 		blockNumber = parse_expression(argv[i + 1]);
-		cached_block* block = cache->hash->Lookup(blockNumber);
+		cached_block* block = cache->Lookup(blockNumber);
 		if (block != NULL)
 			dump_block_long(block);
 		else
@@ -2303,19 +2691,21 @@ dump_cache(int argc, char** argv)
 	uint32 count = 0;
 	uint32 dirty = 0;
 	uint32 discarded = 0;
-	BlockTable::Iterator iterator(cache->hash);
-	while (iterator.HasNext()) {
-		cached_block* block = iterator.Next();
-		if (showBlocks)
-			dump_block(block);
-
-		if (block->is_dirty)
-			dirty++;
-		if (block->discard)
-			discarded++;
-		if (block->ref_count)
-			referenced++;
-		count++;
+	for (uint32 i = 0; i < kBlockShardCount; i++) {
+		BlockTable::Iterator iterator(&cache->shards[i].hash);
+		while (iterator.HasNext()) {
+			cached_block* block = iterator.Next();
+			if (showBlocks)
+				dump_block(block);
+
+			if (block->is_dirty)
+				dirty++;
+			if (block->discard)
+				discarded++;
+			if (block->ref_count)
+				referenced++;
+			count++;
+		}
 	}
 
 	kprintf(" %" B_PRIu32 " blocks total, %" B_PRIu32 " dirty, %" B_PRIu32
@@ -2409,10 +2799,7 @@ dump_caches(int argc, char** argv)
 	DoublyLinkedList<block_cache>::Iterator i = sCaches.GetIterator();
 	while (i.HasNext()) {
 		block_cache* cache = i.Next();
-		if (cache == (block_cache*)&sMarkCache)
-			continue;
-
-		kprintf("  %p\n", cache);
+		kprintf("  %p (writer %" B_PRId32 ")\n", cache, cache->writer_thread);
 	}
 
 	return 0;
@@ -2527,91 +2914,85 @@ dump_block_data(int argc, char** argv)
 #endif	// DEBUG_BLOCK_CACHE
 
 
-/*!	Traverses through the block_cache list, and returns one cache after the
-	other. The cache returned is automatically locked when you get it, and
-	unlocked with the next call to this function. Ignores caches that are in
-	deletion state.
-	Returns \c NULL when the end of the list is reached.
+/*!	Work item function that flushes the pending notifications of all caches.
 */
-static block_cache*
-get_next_locked_block_cache(block_cache* last)
+static void
+block_notifier(void* /*data*/)
 {
-	MutexLocker _(sCachesLock);
-
-	block_cache* cache;
-	if (last != NULL) {
-		mutex_unlock(&last->lock);
+	flush_pending_notifications();
+}
 
-		cache = sCaches.GetNext((block_cache*)&sMarkCache);
-		sCaches.Remove((block_cache*)&sMarkCache);
-	} else
-		cache = sCaches.Head();
 
-	if (cache != NULL) {
-		mutex_lock(&cache->lock);
-		sCaches.InsertBefore(sCaches.GetNext(cache), (block_cache*)&sMarkCache);
-	}
+/*!	Updates the memory usage of the \a cache. */
+static void
+update_used_memory(block_cache* cache)
+{
+	size_t cacheUsedMemory;
+	object_cache_get_usage(cache->buffer_cache, &cacheUsedMemory);
+	size_t blockUsedMemory;
+	object_cache_get_usage(sBlockCache, &blockUsedMemory);
 
-	return cache;
+	MutexLocker _(sCachesMemoryUseLock);
+	sUsedMemory += cacheUsedMemory - cache->used_memory;
+	sBlockUsedMemory = blockUsedMemory;
+	cache->used_memory = cacheUsedMemory;
 }
 
 
-/*!	Background thread that continuously checks for pending notifications of
-	all caches.
-	Every two seconds, it will also write back up to 64 blocks per cache.
+/*!	Background thread of each cache that writes back up to 64 of its blocks
+	every two seconds. Since every cache has its own writer, the devices
+	are written to in parallel.
 */
 static status_t
-block_notifier_and_writer(void* /*data*/)
+block_writer(void* _cache)
 {
+	block_cache* cache = (block_cache*)_cache;
 	const bigtime_t kDefaultTimeout = 2000000LL;
 	bigtime_t timeout = kDefaultTimeout;
 
-	while (true) {
-		bigtime_t start = system_time();
+	MutexLocker locker(cache->lock);
 
-		status_t status = acquire_sem_etc(sEventSemaphore, 1,
-			B_RELATIVE_TIMEOUT, timeout);
-		if (status == B_OK) {
-			flush_pending_notifications();
-			timeout -= system_time() - start;
-			continue;
-		}
+	while (!cache->quit_writer) {
+		// quit_writer is only changed with the lock held, so we cannot miss
+		// the notification once we have checked it
+		ConditionVariableEntry entry;
+		cache->writer_condition.Add(&entry);
+
+		locker.Unlock();
+		entry.Wait(B_RELATIVE_TIMEOUT, timeout);
+		locker.Lock();
+
+		if (cache->quit_writer)
+			break;
 
-		// Write 64 blocks of each block_cache roughly every 2 seconds,
-		// potentially more or less depending on congestion and drive speeds
-		// (usually much less.) We do not want to queue everything at once
-		// because a future transaction might then get held up waiting for
-		// a specific block to be written.
+		// Write 64 blocks roughly every 2 seconds, potentially more or less
+		// depending on congestion and drive speeds (usually much less.) We do
+		// not want to queue everything at once because a future transaction
+		// might then get held up waiting for a specific block to be written.
 		timeout = kDefaultTimeout;
-		size_t usedMemory;
-		object_cache_get_usage(sBlockCache, &usedMemory);
-
-		block_cache* cache = NULL;
-		while ((cache = get_next_locked_block_cache(cache)) != NULL) {
-			// Give some breathing room: wait 2x the length of the potential
-			// maximum block count-sized write between writes, and also skip
-			// if there are more than 16 blocks currently being written.
-			const bigtime_t next = cache->last_block_write
-					+ cache->last_block_write_duration * 2 * 64;
-			if (cache->busy_writing_count > 16 || system_time() < next) {
-				if (cache->last_block_write_duration > 0) {
-					timeout = min_c(timeout,
-						cache->last_block_write_duration * 2 * 64);
-				}
-				continue;
+		update_used_memory(cache);
+
+		// Give some breathing room: wait 2x the length of the potential
+		// maximum block count-sized write between writes, and also skip
+		// if there are more than 16 blocks currently being written.
+		const bigtime_t next = cache->last_block_write
+				+ cache->last_block_write_duration * 2 * 64;
+		if (cache->busy_writing_count > 16 || system_time() < next) {
+			if (cache->last_block_write_duration > 0) {
+				timeout = min_c(timeout,
+					cache->last_block_write_duration * 2 * 64);
 			}
+			continue;
+		}
 
-			BlockWriter writer(cache, 64);
-			bool hasMoreBlocks = false;
-
-			size_t cacheUsedMemory;
-			object_cache_get_usage(cache->buffer_cache, &cacheUsedMemory);
-			usedMemory += cacheUsedMemory;
+		BlockWriter writer(cache, 64);
+		bool hasMoreBlocks = false;
 
-			if (cache->num_dirty_blocks) {
-				// This cache is not using transactions, we'll scan the blocks
-				// directly
-				BlockTable::Iterator iterator(cache->hash);
+		if (cache->num_dirty_blocks) {
+			// This cache is not using transactions, we'll scan the blocks
+			// directly
+			for (uint32 i = 0; i < kBlockShardCount && !hasMoreBlocks; i++) {
+				BlockTable::Iterator iterator(&cache->shards[i].hash);
 
 				while (iterator.HasNext()) {
 					cached_block* block = iterator.Next();
@@ -2620,52 +3001,48 @@ block_notifier_and_writer(void* /*data*/)
 						break;
 					}
 				}
-			} else {
-				TransactionTable::Iterator iterator(cache->transaction_hash);
-
-				while (iterator.HasNext()) {
-					cache_transaction* transaction = iterator.Next();
-					if (transaction->open) {
-						if (system_time() > transaction->last_used
-								+ kTransactionIdleTime) {
-							// Transaction is open but idle
-							notify_transaction_listeners(cache, transaction,
-								TRANSACTION_IDLE);
-						}
-						continue;
+			}
+		} else {
+			TransactionTable::Iterator iterator(cache->transaction_hash);
+
+			while (iterator.HasNext()) {
+				cache_transaction* transaction = iterator.Next();
+				if (transaction->open) {
+					if (system_time() > transaction->last_used
+							+ kTransactionIdleTime) {
+						// Transaction is open but idle
+						notify_transaction_listeners(cache, transaction,
+							TRANSACTION_IDLE);
 					}
+					continue;
+				}
 
-					bool hasLeftOvers;
-						// we ignore this one
-					if (!writer.Add(transaction, hasLeftOvers)) {
-						hasMoreBlocks = true;
-						break;
-					}
+				bool hasLeftOvers;
+					// we ignore this one
+				if (!writer.Add(transaction, hasLeftOvers)) {
+					hasMoreBlocks = true;
+					break;
 				}
 			}
+		}
 
-			writer.Write();
+		writer.Write();
 
-			if (hasMoreBlocks && cache->last_block_write_duration > 0) {
-				// There are probably still more blocks that we could write, so
-				// see if we can decrease the timeout.
-				timeout = min_c(timeout,
-					cache->last_block_write_duration * 2 * 64);
-			}
-
-			if ((block_cache_used_memory() / B_PAGE_SIZE)
-					> vm_page_num_pages() / 2) {
-				// Try to reduce memory usage to half of the available
-				// RAM at maximum
-				cache->RemoveUnusedBlocks(1000, 10);
-			}
+		if (hasMoreBlocks && cache->last_block_write_duration > 0) {
+			// There are probably still more blocks that we could write, so
+			// see if we can decrease the timeout.
+			timeout = min_c(timeout,
+				cache->last_block_write_duration * 2 * 64);
 		}
 
-		MutexLocker _(sCachesMemoryUseLock);
-		sUsedMemory = usedMemory;
+		if ((block_cache_used_memory() / B_PAGE_SIZE)
+				> vm_page_num_pages() / 2) {
+			// Try to reduce memory usage to half of the available
+			// RAM at maximum
+			cache->RemoveUnusedBlocks(1000, 10);
+		}
 	}
 
-	// never can get here
 	return B_OK;
 }
 
@@ -2696,8 +3073,26 @@ is_valid_cache(block_cache* cache)
 }
 
 
+/*!	Must be called with the sCachesLock held. */
+static bool
+is_block_writer_thread()
+{
+	ASSERT_LOCKED_MUTEX(&sCachesLock);
+
+	thread_id thread = find_thread(NULL);
+
+	DoublyLinkedList<block_cache>::Iterator iterator = sCaches.GetIterator();
+	while (iterator.HasNext()) {
+		if (iterator.Next()->writer_thread == thread)
+			return true;
+	}
+
+	return false;
+}
+
+
 /*!	Waits until all pending notifications are carried out.
-	Safe to be called from the block writer/notifier thread.
+	Safe to be called from the block writer threads.
 	You must not hold the \a cache lock when calling this function.
 */
 static void
@@ -2705,9 +3100,10 @@ wait_for_notifications(block_cache* cache)
 {
 	MutexLocker locker(sCachesLock);
 
-	if (find_thread(NULL) == sNotifierWriterThread) {
-		// We're the notifier thread, don't wait, but flush all pending
-		// notifications directly.
+	if (is_block_writer_thread()
+		|| sNotificationQueue.IsWorkerThread(find_thread(NULL))) {
+		// We're the writer or the notifier thread, don't wait, but flush all
+		// pending notifications directly.
 		if (is_valid_cache(cache))
 			flush_pending_notifications(cache);
 		return;
@@ -2745,14 +3141,15 @@ block_cache_init(void)
 	new (&sCaches) DoublyLinkedList<block_cache>;
 		// manually call constructor
 
-	sEventSemaphore = create_sem(0, "block cache event");
-	if (sEventSemaphore < B_OK)
-		return sEventSemaphore;
+	// The notifications get a worker of their own, so that they are never
+	// queued behind work waiting for them, like a low resource handler.
+	status_t status = sNotificationQueue.Init("block notifier",
+		B_LOW_PRIORITY, WORK_QUEUE_UNBOUND, 1);
+	if (status != B_OK)
+		return status;
 
-	sNotifierWriterThread = spawn_kernel_thread(&block_notifier_and_writer,
-		"block notifier/writer", B_LOW_PRIORITY, NULL);
-	if (sNotifierWriterThread >= B_OK)
-		resume_thread(sNotifierWriterThread);
+	new(&sNotificationWork) FunctionWorkItem;
+	sNotificationWork.SetTo(&block_notifier, NULL);
 
 #if DEBUG_BLOCK_CACHE
 	add_debugger_command_etc("block_caches", &dump_caches,
@@ -2791,7 +3188,7 @@ size_t
 block_cache_used_memory(void)
 {
 	MutexLocker _(sCachesMemoryUseLock);
-	return sUsedMemory;
+	return sUsedMemory + sBlockUsedMemory;
 }
 
 
@@ -3394,7 +3791,7 @@ cache_has_block_in_transaction(void* _cache, int32 id, off_t blockNumber)
 	block_cache* cache = (block_cache*)_cache;
 	TransactionLocker locker(cache);
 
-	cached_block* block = cache->hash->Lookup(blockNumber);
+	cached_block* block = cache->Lookup(blockNumber);
 
 	return (block != NULL && block->transaction != NULL
 		&& block->transaction->id == id);
@@ -3418,17 +3815,32 @@ block_cache_delete(void* _cache, bool allowWrites)
 
 	mutex_lock(&cache->lock);
 
+	// stop the writer thread
+	cache->quit_writer = true;
+	cache->writer_condition.NotifyAll();
+	mutex_unlock(&cache->lock);
+
+	wait_for_thread(cache->writer_thread, NULL);
+
+	mutex_lock(&sCachesMemoryUseLock);
+	sUsedMemory -= cache->used_memory;
+	mutex_unlock(&sCachesMemoryUseLock);
+
+	mutex_lock(&cache->lock);
+
 	// wait for all blocks to become unbusy
 	wait_for_busy_reading_blocks(cache);
 	wait_for_busy_writing_blocks(cache);
 
 	// free all blocks
 
-	cached_block* block = cache->hash->Clear(true);
-	while (block != NULL) {
-		cached_block* next = block->next;
-		cache->FreeBlock(block);
-		block = next;
+	for (uint32 i = 0; i < kBlockShardCount; i++) {
+		cached_block* block = cache->shards[i].hash.Clear(true);
+		while (block != NULL) {
+			cached_block* next = block->next;
+			cache->FreeBlock(block);
+			block = next;
+		}
 	}
 
 	// free all transactions (they will all be aborted)
@@ -3457,8 +3869,16 @@ block_cache_create(int fd, off_t numBlocks, size_t blockSize, bool readOnly)
 		return NULL;
 	}
 
+	cache->writer_thread = spawn_kernel_thread(&block_writer, "block writer",
+		B_LOW_PRIORITY, cache);
+	if (cache->writer_thread < B_OK) {
+		delete cache;
+		return NULL;
+	}
+
 	MutexLocker _(sCachesLock);
 	sCaches.Add(cache);
+	resume_thread(cache->writer_thread);
 
 	return cache;
 }
@@ -3475,12 +3895,15 @@ block_cache_sync(void* _cache)
 	MutexLocker locker(&cache->lock);
 
 	BlockWriter writer(cache);
-	BlockTable::Iterator iterator(cache->hash);
 
-	while (iterator.HasNext()) {
-		cached_block* block = iterator.Next();
-		if (block->CanBeWritten())
-			writer.Add(block);
+	for (uint32 i = 0; i < kBlockShardCount; i++) {
+		BlockTable::Iterator iterator(&cache->shards[i].hash);
+
+		while (iterator.HasNext()) {
+			cached_block* block = iterator.Next();
+			if (block->CanBeWritten())
+				writer.Add(block);
+		}
 	}
 
 	status_t status = writer.Write();
@@ -3513,7 +3936,7 @@ block_cache_sync_etc(void* _cache, off_t blockNumber, size_t numBlocks)
 	BlockWriter writer(cache);
 
 	for (; numBlocks > 0; numBlocks--, blockNumber++) {
-		cached_block* block = cache->hash->Lookup(blockNumber);
+		cached_block* block = cache->Lookup(blockNumber);
 		if (block == NULL)
 			continue;
 
@@ -3547,7 +3970,7 @@ block_cache_discard(void* _cache, off_t blockNumber, size_t numBlocks)
 	BlockWriter writer(cache);
 
 	for (size_t i = 0; i < numBlocks; i++, blockNumber++) {
-		cached_block* block = cache->hash->Lookup(blockNumber);
+		cached_block* block = cache->Lookup(blockNumber);
 		if (block != NULL && block->previous_transaction != NULL)
 			writer.Add(block);
 	}
@@ -3559,16 +3982,14 @@ block_cache_discard(void* _cache, off_t blockNumber, size_t numBlocks)
 		// reset blockNumber to its original value
 
 	for (size_t i = 0; i < numBlocks; i++, blockNumber++) {
-		cached_block* block = cache->hash->Lookup(blockNumber);
+		cached_block* block = cache->Lookup(blockNumber);
 		if (block == NULL)
 			continue;
 
 		ASSERT(block->previous_transaction == NULL);
 
-		if (block->unused) {
-			cache->unused_blocks.Remove(block);
-			cache->unused_block_count--;
-			cache->RemoveBlock(block);
+		if (block->unused && cache->RemoveUnusedBlock(block)) {
+			cache->FreeBlock(block);
 		} else {
 			if (block->transaction != NULL && block->parent_data != NULL
 				&& block->parent_data != block->current_data) {
@@ -3577,6 +3998,7 @@ block_cache_discard(void* _cache, off_t blockNumber, size_t numBlocks)
 			}
 
 			// mark it as discarded (in the current transaction only, if any)
+			WriteLocker _(cache->Shard(blockNumber).lock);
 			block->discard = true;
 		}
 	}
@@ -3661,10 +4083,20 @@ block_cache_get_etc(void* _cache, off_t blockNumber, off_t base, off_t length,
 	const void** _block)
 {
 	block_cache* cache = (block_cache*)_cache;
+
+#if !BLOCK_CACHE_DEBUG_CHANGED
+	cached_block* block = get_cached_block_lockless(cache, blockNumber);
+	if (block != NULL) {
+		*_block = block->current_data;
+		return B_OK;
+	}
+#else
+	cached_block* block;
+#endif
+
 	MutexLocker locker(&cache->lock);
 	bool allocated;
 
-	cached_block* block;
 	status_t status = get_cached_block(cache, blockNumber, &allocated, true,
 		&block);
 	if (status != B_OK)
@@ -3683,6 +4115,58 @@ block_cache_get_etc(void* _cache, off_t blockNumber, off_t base, off_t length,
 }
 
 
+/*!	Starts reading the \a numBlocks blocks starting at \a blockNumber into
+	the cache, without waiting for them. Blocks that are already cached are
+	skipped, and runs of consecutive blocks are read with a single request.
+	This is only a hint: in low memory situations, or if the platform does
+	not support asynchronous I/O, nothing is read at all.
+*/
+status_t
+block_cache_prefetch(void* _cache, off_t blockNumber, size_t numBlocks)
+{
+	block_cache* cache = (block_cache*)_cache;
+
+	if (blockNumber < 0 || blockNumber >= cache->max_blocks)
+		return B_BAD_VALUE;
+	if ((off_t)numBlocks > cache->max_blocks - blockNumber)
+		numBlocks = cache->max_blocks - blockNumber;
+
+#ifdef _KERNEL_MODE
+	if (low_resource_state(B_KERNEL_RESOURCE_PAGES | B_KERNEL_RESOURCE_MEMORY
+			| B_KERNEL_RESOURCE_ADDRESS_SPACE) != B_NO_LOW_RESOURCE)
+		return B_OK;
+
+	off_t end = blockNumber + numBlocks;
+	MutexLocker locker(&cache->lock);
+
+	while (blockNumber < end) {
+		if (cache->Lookup(blockNumber) != NULL) {
+			blockNumber++;
+			continue;
+		}
+
+		BlockPrefetcher* prefetcher = new(std::nothrow) BlockPrefetcher(cache,
+			blockNumber, end - blockNumber);
+		if (prefetcher == NULL)
+			return B_NO_MEMORY;
+
+		if (prefetcher->Allocate() != B_OK) {
+			delete prefetcher;
+			return B_NO_MEMORY;
+		}
+
+		blockNumber += prefetcher->NumAllocated();
+
+		locker.Unlock();
+		prefetcher->ReadAsync();
+		locker.Lock();
+	}
+#endif
+
+	return B_OK;
+}
+
+
 const void*
 block_cache_get(void* _cache, off_t blockNumber)
 {
@@ -3709,7 +4193,7 @@ block_cache_set_dirty(void* _cache, off_t blockNumber, bool dirty,
 	block_cache* cache = (block_cache*)_cache;
 	MutexLocker locker(&cache->lock);
 
-	cached_block* block = cache->hash->Lookup(blockNumber);
+	cached_block* block = cache->Lookup(blockNumber);
 	if (block == NULL)
 		return B_BAD_VALUE;
 	if (block->is_dirty == dirty) {
@@ -3729,6 +4213,12 @@ void
 block_cache_put(void* _cache, off_t blockNumber)
 {
 	block_cache* cache = (block_cache*)_cache;
+
+#if !BLOCK_CACHE_DEBUG_CHANGED
+	if (put_cached_block_lockless(cache, blockNumber))
+		return;
+#endif
+
 	MutexLocker locker(&cache->lock);
 
 	put_cached_block(cache, blockNumber);
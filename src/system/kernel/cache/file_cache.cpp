@@ -6,6 +6,7 @@
 
 #include "vnode_store.h"
 
+#include <fcntl.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
@@ -17,8 +18,10 @@
 #include <file_cache.h>
 #include <generic_syscall.h>
 #include <low_resource_manager.h>
+#include <heap.h>
 #include <thread.h>
 #include <util/AutoLock.h>
+#include <util/DoublyLinkedList.h>
 #include <util/kernel_cpp.h>
 #include <vfs.h>
 #include <vm/vm.h>
@@ -40,6 +43,51 @@
 
 #define BYPASS_IO_SIZE		65536
 #define LAST_ACCESSES		3
+#define READ_AHEAD_STATES	4
+
+// read-ahead window sizes
+static const size_t kMinReadAheadSize = 64 * 1024;
+static const size_t kMaxReadAheadSize = 2 * 1024 * 1024;
+
+struct file_read_ahead {
+	void*			cookie;
+	off_t			next_offset;
+		// the offset a sequential read would continue at
+	off_t			end;
+		// the end of the last read-ahead window
+	size_t			size;
+		// the size of the last read-ahead window
+	uint32			last_used;
+		// 0 if unused
+	int32			advice;
+};
+
+// dirty page limits
+static const uint32 kDirtyRatio = 20;
+	// percentage of all pages that may be modified file pages
+static const bigtime_t kDirtyDeviceWriteTime = 3000000;
+	// a device may have as many modified pages as it can write in that time
+static const uint32 kMinDeviceDirtyPages = 1024;
+static const uint32 kThrottleWritePages = 256;
+static const bigtime_t kWriteRateInterval = 200000;
+static const bigtime_t kMinDirtyPause = 10000;
+static const bigtime_t kMaxDirtyPause = 200000;
+static const uint32 kInitialWriteRate = 10 * 1024 * 1024 / B_PAGE_SIZE;
+	// assumed until the first write back has been measured
+
+struct dirty_device : DoublyLinkedListLinkImpl<dirty_device> {
+	dev_t			device;
+	int32			ref_count;
+	int32			dirty_pages;
+	int32			cleaned_pages;
+		// pages written back since the last write rate estimate
+	int32			estimating;
+	bigtime_t		last_estimate;
+	uint32			write_rate;
+		// estimated write back rate in pages per second
+};
+
+typedef DoublyLinkedList<dirty_device> DirtyDeviceList;
 
 struct file_cache_ref {
 	VMCache			*cache;
@@ -50,6 +98,9 @@ struct file_cache_ref {
 		//	write vs. read)
 	int32			last_access_index;
 	uint16			disabled_count;
+	uint32			read_ahead_usage;
+	file_read_ahead	*read_ahead;
+		// per open file read-ahead state, keyed by the file system cookie
 
 	inline void SetLastAccess(int32 index, off_t access, bool isWrite)
 	{
@@ -112,6 +163,17 @@ static const size_t kZeroVecSize = kZeroVecCount * B_PAGE_SIZE;
 static phys_addr_t sZeroPage;
 static generic_io_vec sZeroVecs[kZeroVecCount];
 
+static int64 sReadAheadPages;
+static int64 sReadAheadHits;
+static int64 sReadAheadMisses;
+static int64 sDroppedPages;
+
+static mutex sDirtyDevicesLock = MUTEX_INITIALIZER("dirty devices");
+static DirtyDeviceList sDirtyDevices;
+static int32 sDirtyPages;
+static int64 sThrottledWrites;
+static int64 sThrottleTime;
+
 
 //	#pragma mark -
 
@@ -330,6 +392,317 @@ reserve_pages(file_cache_ref* ref, vm_page_reservation* reservation,
 }
 
 
+/*!	Starts asynchronous reads for all pages in the given range that are not
+	yet in the cache, and returns the number of pages read.
+	The cache must be locked, it is temporarily unlocked while the I/O is
+	scheduled. \a offset and \a size must be page aligned.
+*/
+static size_t
+prefetch_range(file_cache_ref* ref, off_t offset, size_t size,
+	vm_page_reservation* reservation)
+{
+	VMCache* cache = ref->cache;
+	size_t bytesToRead = 0;
+	size_t bytesRead = 0;
+	off_t lastOffset = offset;
+
+	while (true) {
+		// check if this page is already in memory
+		if (size > 0) {
+			vm_page* page = cache->LookupPage(offset);
+
+			offset += B_PAGE_SIZE;
+			size -= B_PAGE_SIZE;
+
+			if (page == NULL) {
+				bytesToRead += B_PAGE_SIZE;
+				continue;
+			}
+		}
+		if (bytesToRead != 0) {
+			// read the part before the current page (or the end of the request)
+			PrecacheIO* io = new(std::nothrow) PrecacheIO(ref, lastOffset,
+				bytesToRead);
+			if (io == NULL || io->Prepare(reservation) != B_OK) {
+				delete io;
+				break;
+			}
+
+			// we must not have the cache locked during I/O
+			cache->Unlock();
+			io->ReadAsync();
+			cache->Lock();
+
+			bytesRead += bytesToRead;
+			bytesToRead = 0;
+		}
+
+		if (size == 0) {
+			// we have reached the end of the request
+			break;
+		}
+
+		lastOffset = offset;
+	}
+
+	return bytesRead / B_PAGE_SIZE;
+}
+
+
+/*!	Reads the given range of the file asynchronously into the cache, if
+	there are enough free pages left. Returns \c false if it didn't.
+	The cache must not be locked.
+*/
+static bool
+read_ahead(file_cache_ref* ref, off_t offset, size_t size)
+{
+	VMCache* cache = ref->cache;
+	off_t fileSize = cache->virtual_end;
+
+	if (offset >= fileSize || size == 0)
+		return true;
+	if ((off_t)(offset + size) > fileSize)
+		size = fileSize - offset;
+
+	size = ROUNDUP(offset + size, B_PAGE_SIZE) - ROUNDDOWN(offset, B_PAGE_SIZE);
+	offset = ROUNDDOWN(offset, B_PAGE_SIZE);
+
+	size_t reservePages = size / B_PAGE_SIZE;
+
+	// Read-ahead is only a hint, we never wait for memory to become available
+	vm_page_reservation reservation;
+	if (vm_page_num_unused_pages() < 2 * reservePages
+		|| !vm_page_try_reserve_pages(&reservation, reservePages,
+			VM_PRIORITY_USER)) {
+		return false;
+	}
+
+	cache->Lock();
+	size_t pagesRead = prefetch_range(ref, offset, size, &reservation);
+	cache->Unlock();
+
+	vm_page_unreserve_pages(&reservation);
+
+	atomic_add64(&sReadAheadPages, pagesRead);
+	return true;
+}
+
+
+/*!	Frees all clean and unmapped pages between \a offset and \a end.
+	The cache must be locked.
+*/
+static void
+drop_pages(file_cache_ref* ref, off_t offset, off_t end)
+{
+	VMCache* cache = ref->cache;
+	if (!cache->consumers.IsEmpty() || cache->areas != NULL)
+		return;
+
+	page_num_t endPage = (end + B_PAGE_SIZE - 1) >> PAGE_SHIFT;
+	int64 dropped = 0;
+
+	vm_page* page;
+	for (VMCachePagesTree::Iterator it
+				= cache->pages.GetIterator(offset >> PAGE_SHIFT, true, true);
+			(page = it.Next()) != NULL && page->cache_offset < endPage;) {
+		if (page->State() != PAGE_STATE_CACHED || page->busy)
+			continue;
+
+		DEBUG_PAGE_ACCESS_START(page);
+		ASSERT(!page->IsMapped());
+		ASSERT(!page->modified);
+		cache->RemovePage(page);
+		vm_page_set_state(page, PAGE_STATE_FREE);
+		dropped++;
+	}
+
+	atomic_add64(&sDroppedPages, dropped);
+}
+
+
+/*!	Returns the read-ahead state of the file opened with \a cookie, and
+	creates it if necessary, replacing the least recently used one.
+	The cache must be locked.
+*/
+static file_read_ahead*
+get_read_ahead(file_cache_ref* ref, void* cookie, bool create)
+{
+	if (ref->read_ahead == NULL) {
+		if (!create)
+			return NULL;
+
+		ref->read_ahead = new(std::nothrow) file_read_ahead[READ_AHEAD_STATES];
+		if (ref->read_ahead == NULL)
+			return NULL;
+
+		memset(ref->read_ahead, 0,
+			sizeof(file_read_ahead) * READ_AHEAD_STATES);
+	}
+
+	file_read_ahead* oldest = &ref->read_ahead[0];
+	for (int32 i = 0; i < READ_AHEAD_STATES; i++) {
+		file_read_ahead* state = &ref->read_ahead[i];
+		if (state->last_used != 0 && state->cookie == cookie) {
+			state->last_used = ++ref->read_ahead_usage;
+			return state;
+		}
+		if (state->last_used < oldest->last_used)
+			oldest = state;
+	}
+
+	if (!create)
+		return NULL;
+
+	oldest->cookie = cookie;
+	oldest->next_offset = 0;
+	oldest->end = 0;
+	oldest->size = 0;
+	oldest->advice = POSIX_FADV_NORMAL;
+	oldest->last_used = ++ref->read_ahead_usage;
+	return oldest;
+}
+
+
+/*!	Updates the read-ahead state of the file opened with \a cookie for a
+	read of \a size bytes at \a offset, and starts reading the next window
+	asynchronously if the file is read sequentially.
+	Every sequential read doubles the read-ahead window, up to
+	kMaxReadAheadSize; any other access resets it.
+	Returns the advice given for the file.
+*/
+static int32
+update_read_ahead(file_cache_ref* ref, void* cookie, off_t offset,
+	size_t size)
+{
+	off_t start;
+	size_t length;
+	int32 advice;
+
+	{
+		AutoLocker<VMCache> locker(ref->cache);
+
+		file_read_ahead* state = get_read_ahead(ref, cookie, true);
+		if (state == NULL)
+			return POSIX_FADV_NORMAL;
+
+		advice = state->advice;
+		if (advice == POSIX_FADV_RANDOM)
+			return advice;
+
+		off_t end = offset + size;
+		if (offset != state->next_offset) {
+			// a random access, start over
+			state->next_offset = end;
+			state->end = 0;
+			state->size = 0;
+			if (advice != POSIX_FADV_SEQUENTIAL)
+				return advice;
+
+			// start with the maximum window right away
+			state->size = kMaxReadAheadSize / 2;
+		} else {
+			if (state->end != 0) {
+				if (end <= state->end)
+					atomic_add64(&sReadAheadHits, 1);
+				else
+					atomic_add64(&sReadAheadMisses, 1);
+			}
+			state->next_offset = end;
+		}
+
+		// Wait until half of the last window has been consumed before
+		// starting the next one
+		if (state->end - (off_t)(state->size / 2) > end)
+			return advice;
+
+		state->size = state->size == 0
+			? kMinReadAheadSize : min_c(state->size * 2, kMaxReadAheadSize);
+
+		start = max_c(state->end, end);
+		length = state->size;
+		state->end = start + length;
+	}
+
+	read_ahead(ref, start, length);
+	return advice;
+}
+
+
+/*!	Updates the write back rate estimate of \a device from the number of
+	pages that have been written back since the last estimate.
+*/
+static void
+update_write_rate(dirty_device* device)
+{
+	bigtime_t now = system_time();
+	bigtime_t elapsed = now - device->last_estimate;
+	if (elapsed < kWriteRateInterval
+		|| atomic_get_and_set(&device->estimating, 1) != 0) {
+		return;
+	}
+
+	int32 cleaned = atomic_get_and_set(&device->cleaned_pages, 0);
+	if (atomic_get(&device->dirty_pages) > 0 || cleaned > 0) {
+		// Only idle devices keep their last rate -- write back doesn't
+		// happen continuously, so we smoothen the estimate a bit
+		uint32 rate = (uint64)cleaned * 1000000 / elapsed;
+		device->write_rate = (device->write_rate * 3 + rate) / 4;
+	}
+
+	device->last_estimate = now;
+	atomic_set(&device->estimating, 0);
+}
+
+
+/*!	Returns by how many pages the modified pages of \a device, or all
+	modified file pages, exceed their limit.
+*/
+static int32
+dirty_pages_over_limit(dirty_device* device)
+{
+	int32 limit = vm_page_num_pages() * kDirtyRatio / 100;
+	int32 over = atomic_get(&sDirtyPages) - limit;
+
+	uint64 deviceLimit = (uint64)device->write_rate * kDirtyDeviceWriteTime
+		/ 1000000;
+	deviceLimit = min_c(max_c(deviceLimit, kMinDeviceDirtyPages),
+		(uint64)limit);
+	over = max_c(over,
+		atomic_get(&device->dirty_pages) - (int32)deviceLimit);
+
+	return max_c(over, 0);
+}
+
+
+/*!	Lets a writer that has just written up to \a offset write back the
+	pages it has written last itself, if there are more modified pages than
+	the device they belong to can write back in a reasonable time, or than
+	the system is willing to hold.
+	The writer may still hold file system locks, so it never waits here;
+	cache_balance_dirty_pages() pauses it before its next write, if needed.
+*/
+static void
+write_back_dirty_pages(file_cache_ref* ref, off_t offset)
+{
+	dirty_device* device = ((VMVnodeCache*)ref->cache)->DirtyDevice();
+	if (device == NULL)
+		return;
+
+	update_write_rate(device);
+
+	if (dirty_pages_over_limit(device) == 0)
+		return;
+
+	uint32 endPage = (offset + B_PAGE_SIZE - 1) >> PAGE_SHIFT;
+	uint32 firstPage = endPage > kThrottleWritePages
+		? endPage - kThrottleWritePages : 0;
+
+	ref->cache->Lock();
+	vm_page_write_modified_page_range(ref->cache, firstPage, endPage);
+	ref->cache->Unlock();
+}
+
+
 static inline status_t
 read_pages_and_clear_partial(file_cache_ref* ref, void* cookie, off_t offset,
 	const generic_io_vec* vecs, size_t count, uint32 flags,
@@ -897,6 +1270,37 @@ cache_io(void* _cacheRef, void* cookie, off_t offset, addr_t buffer,
 }
 
 
+static int
+dump_read_ahead_stats(int argc, char** argv)
+{
+	kprintf("read-ahead: %" B_PRId64 " pages read, %" B_PRId64 " hits, %"
+		B_PRId64 " misses\n", sReadAheadPages, sReadAheadHits,
+		sReadAheadMisses);
+	kprintf("dropped after use: %" B_PRId64 " pages\n", sDroppedPages);
+	return 0;
+}
+
+
+static int
+dump_dirty_devices(int argc, char** argv)
+{
+	kprintf("modified file pages: %" B_PRId32 ", limit %" B_PRIuPHYSADDR
+		"\n", sDirtyPages, vm_page_num_pages() * kDirtyRatio / 100);
+	kprintf("throttled writes: %" B_PRId64 ", %" B_PRId64 " us in total\n\n",
+		sThrottledWrites, sThrottleTime);
+
+	kprintf("device  modified  write rate (pages/s)\n");
+
+	DirtyDeviceList::Iterator iterator = sDirtyDevices.GetIterator();
+	while (dirty_device* device = iterator.Next()) {
+		kprintf("%6" B_PRIdDEV "  %8" B_PRId32 "  %" B_PRIu32 "\n",
+			device->device, device->dirty_pages, device->write_rate);
+	}
+
+	return 0;
+}
+
+
 static status_t
 file_cache_control(const char* subsystem, uint32 function, void* buffer,
 	size_t bufferSize)
@@ -984,71 +1388,222 @@ cache_prefetch_vnode(struct vnode* vnode, off_t offset, size_t size)
 		return;
 	}
 
-	size_t bytesToRead = 0;
-	off_t lastOffset = offset;
-
 	vm_page_reservation reservation;
 	vm_page_reserve_pages(&reservation, reservePages, VM_PRIORITY_USER);
 
 	cache->Lock();
+	prefetch_range(ref, offset, size, &reservation);
+	cache->ReleaseRefAndUnlock();
+	vm_page_unreserve_pages(&reservation);
+}
 
-	while (true) {
-		// check if this page is already in memory
-		if (size > 0) {
-			vm_page* page = cache->LookupPage(offset);
 
-			offset += B_PAGE_SIZE;
-			size -= B_PAGE_SIZE;
+extern "C" void
+cache_prefetch(dev_t mountID, ino_t vnodeID, off_t offset, size_t size)
+{
+	// ToDo: schedule prefetch
 
-			if (page == NULL) {
-				bytesToRead += B_PAGE_SIZE;
-				continue;
-			}
-		}
-		if (bytesToRead != 0) {
-			// read the part before the current page (or the end of the request)
-			PrecacheIO* io = new(std::nothrow) PrecacheIO(ref, lastOffset,
-				bytesToRead);
-			if (io == NULL || io->Prepare(&reservation) != B_OK) {
-				delete io;
-				break;
-			}
+	TRACE(("cache_prefetch(vnode %ld:%lld)\n", mountID, vnodeID));
 
-			// we must not have the cache locked during I/O
-			cache->Unlock();
-			io->ReadAsync();
-			cache->Lock();
+	// get the vnode for the object, this also grabs a ref to it
+	struct vnode* vnode;
+	if (vfs_get_vnode(mountID, vnodeID, true, &vnode) != B_OK)
+		return;
 
-			bytesToRead = 0;
-		}
+	cache_prefetch_vnode(vnode, offset, size);
+	vfs_put_vnode(vnode);
+}
 
-		if (size == 0) {
-			// we have reached the end of the request
+
+/*!	Applies the posix_fadvise() \a advice to the file \a vnode has been
+	opened with as \a cookie.
+	POSIX_FADV_NORMAL, POSIX_FADV_SEQUENTIAL, POSIX_FADV_RANDOM, and
+	POSIX_FADV_NOREUSE change the read-ahead behaviour for the whole file,
+	POSIX_FADV_WILLNEED and POSIX_FADV_DONTNEED act on the given range only.
+*/
+extern "C" status_t
+cache_advise_vnode(struct vnode* vnode, void* cookie, off_t offset,
+	off_t length, int advice)
+{
+	VMCache* cache;
+	if (vfs_get_vnode_cache(vnode, &cache, false) != B_OK)
+		return B_OK;
+	if (cache->type != CACHE_TYPE_VNODE) {
+		cache->ReleaseRef();
+		return B_OK;
+	}
+
+	file_cache_ref* ref = ((VMVnodeCache*)cache)->FileCacheRef();
+	if (ref == NULL) {
+		cache->ReleaseRef();
+		return B_OK;
+	}
+
+	AutoLocker<VMCache> locker(cache);
+
+	off_t end = length == 0 || offset > OFF_MAX - length
+		? OFF_MAX : offset + length;
+	if (end > cache->virtual_end)
+		end = cache->virtual_end;
+
+	switch (advice) {
+		case POSIX_FADV_NORMAL:
+		case POSIX_FADV_SEQUENTIAL:
+		case POSIX_FADV_RANDOM:
+		case POSIX_FADV_NOREUSE:
+		{
+			file_read_ahead* state = get_read_ahead(ref, cookie, true);
+			if (state == NULL)
+				break;
+
+			state->advice = advice;
+			state->end = 0;
+			state->size = advice == POSIX_FADV_SEQUENTIAL
+				? kMaxReadAheadSize / 2 : 0;
 			break;
 		}
 
-		lastOffset = offset;
+		case POSIX_FADV_WILLNEED:
+			locker.Unlock();
+
+			while (offset < end) {
+				size_t size = min_c(end - offset, (off_t)kMaxReadAheadSize);
+				if (!read_ahead(ref, offset, size))
+					break;
+				offset += size;
+			}
+			break;
+
+		case POSIX_FADV_DONTNEED:
+			if (offset >= end)
+				break;
+
+			// write back modified pages, so that they can be freed as well
+			vm_page_write_modified_page_range(cache, offset >> PAGE_SHIFT,
+				(end + B_PAGE_SIZE - 1) >> PAGE_SHIFT);
+			drop_pages(ref, offset, end);
+			break;
 	}
 
-	cache->ReleaseRefAndUnlock();
-	vm_page_unreserve_pages(&reservation);
+	locker.Unlock();
+	cache->ReleaseRef();
+	return B_OK;
 }
 
 
+/*!	Throttles a writer of the vnode \a cache, if its device has more
+	modified pages than it can write back in a reasonable time, or the
+	system more than it is willing to hold: the writer waits for the page
+	writer for a time relative to the device's write rate.
+	Called by the VFS before a file is written, that is, before the file
+	system acquires any locks.
+*/
 extern "C" void
-cache_prefetch(dev_t mountID, ino_t vnodeID, off_t offset, size_t size)
+cache_balance_dirty_pages(VMCache* cache)
 {
-	// ToDo: schedule prefetch
+	if (cache == NULL || cache->type != CACHE_TYPE_VNODE)
+		return;
 
-	TRACE(("cache_prefetch(vnode %ld:%lld)\n", mountID, vnodeID));
+	dirty_device* device = ((VMVnodeCache*)cache)->DirtyDevice();
+	if (device == NULL)
+		return;
 
-	// get the vnode for the object, this also grabs a ref to it
-	struct vnode* vnode;
-	if (vfs_get_vnode(mountID, vnodeID, true, &vnode) != B_OK)
+	update_write_rate(device);
+
+	int32 over = dirty_pages_over_limit(device);
+	if (over == 0)
 		return;
 
-	cache_prefetch_vnode(vnode, offset, size);
-	vfs_put_vnode(vnode);
+	bigtime_t pause = (bigtime_t)over * 1000000
+		/ max_c(device->write_rate, 1);
+	pause = min_c(max_c(pause, kMinDirtyPause), kMaxDirtyPause);
+	snooze(pause);
+
+	atomic_add64(&sThrottledWrites, 1);
+	atomic_add64(&sThrottleTime, pause);
+}
+
+
+/*!	Returns the modified page accounting of \a device, and creates it if
+	needed. All vnode caches of a device share it.
+*/
+extern "C" dirty_device*
+cache_acquire_dirty_device(dev_t id, uint32 allocationFlags)
+{
+	MutexLocker locker(sDirtyDevicesLock);
+
+	DirtyDeviceList::Iterator iterator = sDirtyDevices.GetIterator();
+	while (dirty_device* device = iterator.Next()) {
+		if (device->device == id) {
+			device->ref_count++;
+			return device;
+		}
+	}
+
+	dirty_device* device = new(malloc_flags(allocationFlags)) dirty_device;
+	if (device == NULL)
+		return NULL;
+
+	device->device = id;
+	device->ref_count = 1;
+	device->dirty_pages = 0;
+	device->cleaned_pages = 0;
+	device->estimating = 0;
+	device->last_estimate = system_time();
+	device->write_rate = kInitialWriteRate;
+
+	sDirtyDevices.Add(device);
+	return device;
+}
+
+
+extern "C" void
+cache_release_dirty_device(dirty_device* device)
+{
+	MutexLocker locker(sDirtyDevicesLock);
+
+	if (--device->ref_count > 0)
+		return;
+
+	sDirtyDevices.Remove(device);
+	delete device;
+}
+
+
+/*!	Called whenever pages of a vnode cache enter (\a delta > 0) or leave
+	the modified state. \a device may be \c NULL.
+*/
+extern "C" void
+cache_dirty_pages_changed(dirty_device* device, int32 delta)
+{
+	atomic_add(&sDirtyPages, delta);
+
+	if (device != NULL) {
+		atomic_add(&device->dirty_pages, delta);
+		if (delta < 0)
+			atomic_add(&device->cleaned_pages, -delta);
+	}
+}
+
+
+/*!	Forgets the read-ahead state of the file \a cache belongs to that was
+	opened as \a cookie. Must be called before the cookie is freed.
+*/
+extern "C" void
+cache_node_cookie_freed(VMCache* cache, void* cookie)
+{
+	if (cache == NULL || cache->type != CACHE_TYPE_VNODE)
+		return;
+
+	file_cache_ref* ref = ((VMVnodeCache*)cache)->FileCacheRef();
+	if (ref == NULL)
+		return;
+
+	AutoLocker<VMCache> _(cache);
+
+	file_read_ahead* state = get_read_ahead(ref, cookie, false);
+	if (state != NULL)
+		state->last_used = 0;
 }
 
 
@@ -1128,6 +1683,11 @@ file_cache_init(void)
 	}
 
 	register_generic_syscall(CACHE_SYSCALLS, file_cache_control, 1, 0);
+
+	add_debugger_command("read_ahead_stats", &dump_read_ahead_stats,
+		"Dumps the file cache read-ahead statistics.");
+	add_debugger_command("dirty_devices", &dump_dirty_devices,
+		"Dumps the modified file pages per device.");
 	return B_OK;
 }
 
@@ -1148,6 +1708,8 @@ file_cache_create(dev_t mountID, ino_t vnodeID, off_t size)
 	memset(ref->last_access, 0, sizeof(ref->last_access));
 	ref->last_access_index = 0;
 	ref->disabled_count = 0;
+	ref->read_ahead_usage = 0;
+	ref->read_ahead = NULL;
 
 	// TODO: delay VMCache creation until data is
 	//	requested/written for the first time? Listing lots of
@@ -1189,6 +1751,7 @@ file_cache_delete(void* _cacheRef)
 	TRACE(("file_cache_delete(ref = %p)\n", ref));
 
 	ref->cache->ReleaseRef();
+	delete[] ref->read_ahead;
 	delete ref;
 }
 
@@ -1325,7 +1888,18 @@ file_cache_read(void* _cacheRef, void* cookie, off_t offset, void* buffer,
 		return error;
 	}
 
-	return cache_io(ref, cookie, offset, (addr_t)buffer, _size, false);
+	int32 advice = update_read_ahead(ref, cookie, offset, *_size);
+
+	status_t status = cache_io(ref, cookie, offset, (addr_t)buffer, _size,
+		false);
+	if (status == B_OK && advice == POSIX_FADV_NOREUSE) {
+		// the data won't be needed again, don't let it push other pages out
+		AutoLocker<VMCache> _(ref->cache);
+		drop_pages(ref, ROUNDDOWN(offset, B_PAGE_SIZE),
+			ROUNDDOWN(offset + *_size, B_PAGE_SIZE));
+	}
+
+	return status;
 }
 
 
@@ -1356,6 +1930,8 @@ file_cache_write(void* _cacheRef, void* cookie, off_t offset,
 
 	status_t status = cache_io(ref, cookie, offset,
 		(addr_t)const_cast<void*>(buffer), _size, true);
+	if (status == B_OK)
+		write_back_dirty_pages(ref, offset + *_size);
 
 	TRACE(("file_cache_write(ref = %p, offset = %lld, buffer = %p, size = %lu)"
 		" = %ld\n", ref, offset, buffer, *_size, status));
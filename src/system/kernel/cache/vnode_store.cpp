@@ -20,6 +20,8 @@
 status_t
 VMVnodeCache::Init(struct vnode* vnode, uint32 allocationFlags)
 {
+	fDirtyDevice = NULL;
+
 	status_t error = VMCache::Init(CACHE_TYPE_VNODE, allocationFlags);
 	if (error != B_OK)
 		return error;
@@ -30,6 +32,9 @@ VMVnodeCache::Init(struct vnode* vnode, uint32 allocationFlags)
 
 	vfs_vnode_to_node_ref(fVnode, &fDevice, &fInode);
 
+	// Without it, the pages of this cache are just not throttled
+	fDirtyDevice = cache_acquire_dirty_device(fDevice, allocationFlags);
+
 	return B_OK;
 }
 
@@ -157,6 +162,13 @@ VMVnodeCache::ReleaseStoreRef()
 }
 
 
+void
+VMVnodeCache::ModifiedPageCountChanged(int32 delta)
+{
+	cache_dirty_pages_changed(fDirtyDevice, delta);
+}
+
+
 void
 VMVnodeCache::Dump(bool showPages) const
 {
@@ -170,5 +182,8 @@ VMVnodeCache::Dump(bool showPages) const
 void
 VMVnodeCache::DeleteObject()
 {
+	if (fDirtyDevice != NULL)
+		cache_release_dirty_device(fDirtyDevice);
+
 	object_cache_delete(gVnodeCacheObjectCache, this);
 }
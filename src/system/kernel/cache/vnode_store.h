@@ -10,6 +10,7 @@
 #include <vm/VMCache.h>
 
 
+struct dirty_device;
 struct file_cache_ref;
 
 
@@ -39,6 +40,8 @@ public:
 	virtual	void				AcquireStoreRef();
 	virtual	void				ReleaseStoreRef();
 
+	virtual	void				ModifiedPageCountChanged(int32 delta);
+
 	virtual	void				Dump(bool showPages) const;
 
 			void				SetFileCacheRef(file_cache_ref* ref)
@@ -50,6 +53,8 @@ public:
 
 			dev_t				DeviceId() const
 									{ return fDevice; }
+			dirty_device*		DirtyDevice() const
+									{ return fDirtyDevice; }
 			ino_t				InodeId() const
 									{ return fInode; }
 
@@ -59,6 +64,7 @@ protected:
 private:
 			struct vnode*		fVnode;
 			file_cache_ref*		fFileCacheRef;
+			dirty_device*		fDirtyDevice;
 			ino_t				fInode;
 			dev_t				fDevice;
 	volatile bool				fVnodeDeleted;
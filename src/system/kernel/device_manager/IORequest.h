@@ -231,6 +231,9 @@ struct IORequest : IORequestChunk, DoublyLinkedListLinkImpl<IORequest> {
 			void				SetOwner(IORequestOwner* owner)
 									{ fOwner = owner; }
 			IORequestOwner*		Owner() const	{ return fOwner; }
+			void				SetDeadline(bigtime_t deadline)
+									{ fDeadline = deadline; }
+			bigtime_t			Deadline() const	{ return fDeadline; }
 
 			status_t			CreateSubRequest(off_t parentOffset,
 									off_t offset, generic_size_t length,
@@ -251,6 +254,8 @@ struct IORequest : IORequestChunk, DoublyLinkedListLinkImpl<IORequest> {
 			bool				IsFinished() const
 									{ return fStatus != 1
 										&& fPendingChildren == 0; }
+			bool				HasPendingChildren() const
+									{ return fPendingChildren > 0; }
 			void				NotifyFinished();
 			bool				HasCallbacks() const;
 			void				SetStatusAndNotify(status_t status);
@@ -326,6 +331,9 @@ private:
 
 			mutex				fLock;
 			IORequestOwner*		fOwner;
+			bigtime_t			fDeadline;
+									// time by which the I/O scheduler should
+									// have started the request
 			IOBuffer*			fBuffer;
 			off_t				fOffset;
 			generic_size_t		fLength;
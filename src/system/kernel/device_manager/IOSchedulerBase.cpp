@@ -0,0 +1,536 @@
+/*
+ * Copyright 2008-2011, Ingo Weinhold, ingo_weinhold@gmx.de.
+ * Copyright 2004-2010, Axel Dörfler, axeld@pinc-software.de.
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "IOSchedulerBase.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <lock.h>
+#include <thread_types.h>
+#include <thread.h>
+#include <util/AutoLock.h>
+
+#include "IOSchedulerRoster.h"
+
+
+//#define TRACE_IO_SCHEDULER
+#ifdef TRACE_IO_SCHEDULER
+#	define TRACE(x...) dprintf(x)
+#else
+#	define TRACE(x...) ;
+#endif
+
+
+namespace {
+
+struct OperationComparator {
+	inline bool operator()(const IOOperation* a, const IOOperation* b)
+	{
+		off_t offsetA = a->Offset();
+		off_t offsetB = b->Offset();
+		return offsetA < offsetB
+			|| (offsetA == offsetB && a->Length() > b->Length());
+	}
+};
+
+}	// namespace
+
+
+IOSchedulerBase::IOSchedulerBase(DMAResource* resource)
+	:
+	IOScheduler(resource),
+	fBlockSize(0),
+	fTerminating(false),
+	fSchedulerThread(-1),
+	fRequestNotifierThread(-1),
+	fOperationArray(NULL),
+	fPendingOperations(0)
+{
+	mutex_init(&fLock, "I/O scheduler");
+	B_INITIALIZE_SPINLOCK(&fFinisherLock);
+
+	fNewRequestCondition.Init(this, "I/O new request");
+	fFinishedOperationCondition.Init(this, "I/O finished operation");
+	fFinishedRequestCondition.Init(this, "I/O finished request");
+}
+
+
+IOSchedulerBase::~IOSchedulerBase()
+{
+	StopThreads();
+
+	// destroy our belongings
+	mutex_lock(&fLock);
+	mutex_destroy(&fLock);
+
+	while (IOOperation* operation = fUnusedOperations.RemoveHead())
+		delete operation;
+
+	delete[] fOperationArray;
+}
+
+
+/*!	Prepares the operations; subclasses set up their own structures after
+	this, and then call StartThreads().
+*/
+status_t
+IOSchedulerBase::Init(const char* name)
+{
+	status_t error = IOScheduler::Init(name);
+	if (error != B_OK)
+		return error;
+
+	size_t count = fDMAResource != NULL ? fDMAResource->BufferCount() : 16;
+	for (size_t i = 0; i < count; i++) {
+		IOOperation* operation = new(std::nothrow) IOOperation;
+		if (operation == NULL)
+			return B_NO_MEMORY;
+
+		fUnusedOperations.Add(operation);
+	}
+
+	fOperationArray = new(std::nothrow) IOOperation*[count];
+	if (fOperationArray == NULL)
+		return B_NO_MEMORY;
+
+	if (fDMAResource != NULL)
+		fBlockSize = fDMAResource->BlockSize();
+	if (fBlockSize == 0)
+		fBlockSize = 512;
+
+	return B_OK;
+}
+
+
+void
+IOSchedulerBase::OperationCompleted(IOOperation* operation, status_t status,
+	generic_size_t transferredBytes)
+{
+	InterruptsSpinLocker _(fFinisherLock);
+
+	// finish operation only once
+	if (operation->Status() <= 0)
+		return;
+
+	operation->SetStatus(status, transferredBytes);
+
+	fCompletedOperations.Add(operation);
+	fFinishedOperationCondition.NotifyAll();
+}
+
+
+status_t
+IOSchedulerBase::StartThreads()
+{
+	char buffer[B_OS_NAME_LENGTH];
+	strlcpy(buffer, Name(), sizeof(buffer));
+	strlcat(buffer, " scheduler ", sizeof(buffer));
+	size_t nameLength = strlen(buffer);
+	snprintf(buffer + nameLength, sizeof(buffer) - nameLength, "%" B_PRId32,
+		fID);
+	fSchedulerThread = spawn_kernel_thread(&_SchedulerThread, buffer,
+		B_NORMAL_PRIORITY + 2, (void *)this);
+	if (fSchedulerThread < B_OK)
+		return fSchedulerThread;
+
+	strlcpy(buffer, Name(), sizeof(buffer));
+	strlcat(buffer, " notifier ", sizeof(buffer));
+	nameLength = strlen(buffer);
+	snprintf(buffer + nameLength, sizeof(buffer) - nameLength, "%" B_PRId32,
+		fID);
+	fRequestNotifierThread = spawn_kernel_thread(&_RequestNotifierThread,
+		buffer, B_NORMAL_PRIORITY + 2, (void *)this);
+	if (fRequestNotifierThread < B_OK)
+		return fRequestNotifierThread;
+
+	resume_thread(fSchedulerThread);
+	resume_thread(fRequestNotifierThread);
+
+	return B_OK;
+}
+
+
+/*!	Stops the threads; subclasses need to call this in their destructor
+	before they destroy the structures the threads are using.
+*/
+void
+IOSchedulerBase::StopThreads()
+{
+	MutexLocker locker(fLock);
+	InterruptsSpinLocker finisherLocker(fFinisherLock);
+	fTerminating = true;
+
+	fNewRequestCondition.NotifyAll();
+	fFinishedOperationCondition.NotifyAll();
+	fFinishedRequestCondition.NotifyAll();
+
+	finisherLocker.Unlock();
+	locker.Unlock();
+
+	if (fSchedulerThread >= 0) {
+		wait_for_thread(fSchedulerThread, NULL);
+		fSchedulerThread = -1;
+	}
+
+	if (fRequestNotifierThread >= 0) {
+		wait_for_thread(fRequestNotifierThread, NULL);
+		fRequestNotifierThread = -1;
+	}
+}
+
+
+/*!	Called with \c fLock held. Waits until HasWork() returns \c true, and
+	performs the finisher work meanwhile.
+	Returns \c false when the scheduler is asked to terminate.
+*/
+bool
+IOSchedulerBase::WaitForWork()
+{
+	while (!fTerminating) {
+		if (HasWork())
+			return true;
+
+		// Before waiting, first check whether any finisher work has to be
+		// done.
+		InterruptsSpinLocker finisherLocker(fFinisherLock);
+		if (_FinisherWorkPending()) {
+			finisherLocker.Unlock();
+			mutex_unlock(&fLock);
+			_Finisher();
+			mutex_lock(&fLock);
+			continue;
+		}
+
+		// Wait for new requests.
+		ConditionVariableEntry entry;
+		fNewRequestCondition.Add(&entry);
+
+		finisherLocker.Unlock();
+		mutex_unlock(&fLock);
+
+		entry.Wait(B_CAN_INTERRUPT);
+		_Finisher();
+		mutex_lock(&fLock);
+	}
+
+	return false;
+}
+
+
+/*!	Called with \c fLock held. Translates up to \a quantum bytes of the
+	request into operations.
+	Returns \c B_BUSY when the operations or DMA buffers ran out, and we
+	need to retry later, or an error, if the request could not be translated
+	at all.
+*/
+status_t
+IOSchedulerBase::PrepareRequestOperations(IORequest* request,
+	IOOperationList& operations, int32& operationsPrepared, off_t quantum,
+	off_t& usedBandwidth)
+{
+	usedBandwidth = 0;
+
+	if (fDMAResource != NULL) {
+		while (quantum >= (off_t)fBlockSize && request->RemainingBytes() > 0) {
+			IOOperation* operation = fUnusedOperations.RemoveHead();
+			if (operation == NULL)
+				return B_BUSY;
+
+			status_t status = fDMAResource->TranslateNext(request, operation,
+				quantum);
+			if (status != B_OK) {
+				operation->SetParent(NULL);
+				fUnusedOperations.Add(operation);
+
+				// B_BUSY means some resource (DMABuffers or
+				// DMABounceBuffers) was temporarily unavailable. That's OK,
+				// we'll retry later.
+				return status;
+			}
+
+			off_t bandwidth = operation->Length();
+			quantum -= bandwidth;
+			usedBandwidth += bandwidth;
+
+			operations.Add(operation);
+			operationsPrepared++;
+		}
+	} else {
+		// TODO: If the device has block size restrictions, we might need to use
+		// a bounce buffer.
+		IOOperation* operation = fUnusedOperations.RemoveHead();
+		if (operation == NULL)
+			return B_BUSY;
+
+		status_t status = operation->Prepare(request);
+		if (status != B_OK) {
+			operation->SetParent(NULL);
+			fUnusedOperations.Add(operation);
+			return status;
+		}
+
+		operation->SetOriginalRange(request->Offset(), request->Length());
+		request->Advance(request->Length());
+
+		off_t bandwidth = operation->Length();
+		usedBandwidth += bandwidth;
+
+		operations.Add(operation);
+		operationsPrepared++;
+	}
+
+	return B_OK;
+}
+
+
+/*!	Must not be called with the fLock held. */
+void
+IOSchedulerBase::_Finisher()
+{
+	while (true) {
+		InterruptsSpinLocker locker(fFinisherLock);
+		IOOperation* operation = fCompletedOperations.RemoveHead();
+		if (operation == NULL)
+			return;
+
+		locker.Unlock();
+
+		TRACE("IOSchedulerBase::_Finisher(): operation: %p\n", operation);
+
+		bool operationFinished = operation->Finish();
+
+		IOSchedulerRoster::Default()->Notify(IO_SCHEDULER_OPERATION_FINISHED,
+			this, operation->Parent(), operation);
+			// Notify for every time the operation is passed to the I/O hook,
+			// not only when it is fully finished.
+
+		if (!operationFinished) {
+			TRACE("  operation: %p not finished yet\n", operation);
+			MutexLocker _(fLock);
+			operation->Parent()->Owner()->operations.Add(operation);
+			fPendingOperations--;
+			continue;
+		}
+
+		// notify request and remove operation
+		IORequest* request = operation->Parent();
+
+		request->OperationFinished(operation);
+
+		// recycle the operation
+		MutexLocker _(fLock);
+		if (fDMAResource != NULL)
+			fDMAResource->RecycleBuffer(operation->Buffer());
+
+		fPendingOperations--;
+		fUnusedOperations.Add(operation);
+
+		// If the request is done, we need to perform its notifications.
+		if (!request->IsFinished())
+			continue;
+
+		if (request->Status() == B_OK && request->RemainingBytes() > 0
+			&& !request->IsPartialTransfer()) {
+			// The request has been processed OK so far, but it isn't really
+			// finished yet.
+			request->SetUnfinished();
+			continue;
+		}
+
+		RemoveFinishedRequest(request);
+
+		if (request->HasCallbacks()) {
+			// The request has callbacks that may take some time to perform,
+			// so we hand it over to the request notifier.
+			fFinishedRequests.Add(request);
+			fFinishedRequestCondition.NotifyAll();
+		} else {
+			// No callbacks -- finish the request right now.
+			IOSchedulerRoster::Default()->Notify(IO_SCHEDULER_REQUEST_FINISHED,
+				this, request);
+			request->NotifyFinished();
+		}
+	}
+}
+
+
+/*!	Called with \c fFinisherLock held.
+*/
+bool
+IOSchedulerBase::_FinisherWorkPending()
+{
+	return !fCompletedOperations.IsEmpty();
+}
+
+
+void
+IOSchedulerBase::_SortOperations(IOOperationList& operations,
+	off_t& lastOffset)
+{
+// TODO: PrepareOperations() could directly add the operations to the array.
+	// move operations to an array and sort it
+	int32 count = 0;
+	while (IOOperation* operation = operations.RemoveHead())
+		fOperationArray[count++] = operation;
+
+	std::sort(fOperationArray, fOperationArray + count, OperationComparator());
+
+	// move the sorted operations to a temporary list we can work with
+	IOOperationList sortedOperations;
+	for (int32 i = 0; i < count; i++)
+		sortedOperations.Add(fOperationArray[i]);
+
+	// Sort the operations so that no two adjacent operations overlap. This
+	// might result in several elevator runs.
+	while (!sortedOperations.IsEmpty()) {
+		IOOperation* operation = sortedOperations.Head();
+		while (operation != NULL) {
+			IOOperation* nextOperation = sortedOperations.GetNext(operation);
+			if (operation->Offset() >= lastOffset) {
+				sortedOperations.Remove(operation);
+				operations.Add(operation);
+				lastOffset = operation->Offset() + operation->Length();
+			}
+
+			operation = nextOperation;
+		}
+
+		if (!sortedOperations.IsEmpty())
+			lastOffset = 0;
+	}
+}
+
+
+status_t
+IOSchedulerBase::_Scheduler()
+{
+	off_t lastOffset = 0;
+
+	while (!fTerminating) {
+		MutexLocker locker(fLock);
+
+		IOOperationList operations;
+		int32 operationCount = 0;
+		if (!PrepareOperations(operations, operationCount)) {
+			// we've been asked to terminate
+			return B_OK;
+		}
+
+		if (operations.IsEmpty())
+			continue;
+
+		fPendingOperations = operationCount;
+
+		locker.Unlock();
+
+		// sort the operations
+		_SortOperations(operations, lastOffset);
+
+		// execute the operations
+#ifdef TRACE_IO_SCHEDULER
+		int32 i = 0;
+#endif
+		while (IOOperation* operation = operations.RemoveHead()) {
+			TRACE("IOSchedulerBase::_Scheduler(): calling callback for "
+				"operation %ld: %p\n", i++, operation);
+
+			IOSchedulerRoster::Default()->Notify(IO_SCHEDULER_OPERATION_STARTED,
+				this, operation->Parent(), operation);
+
+			fIOCallback(fIOCallbackData, operation);
+
+			_Finisher();
+		}
+
+		// wait for all operations to finish
+		while (!fTerminating) {
+			locker.Lock();
+
+			if (fPendingOperations == 0)
+				break;
+
+			// Before waiting first check whether any finisher work has to be
+			// done.
+			InterruptsSpinLocker finisherLocker(fFinisherLock);
+			if (_FinisherWorkPending()) {
+				finisherLocker.Unlock();
+				locker.Unlock();
+				_Finisher();
+				continue;
+			}
+
+			// wait for finished operations
+			ConditionVariableEntry entry;
+			fFinishedOperationCondition.Add(&entry);
+
+			finisherLocker.Unlock();
+			locker.Unlock();
+
+			entry.Wait(B_CAN_INTERRUPT);
+			_Finisher();
+		}
+	}
+
+	return B_OK;
+}
+
+
+/*static*/ status_t
+IOSchedulerBase::_SchedulerThread(void *_self)
+{
+	IOSchedulerBase *self = (IOSchedulerBase *)_self;
+	return self->_Scheduler();
+}
+
+
+status_t
+IOSchedulerBase::_RequestNotifier()
+{
+	while (true) {
+		MutexLocker locker(fLock);
+
+		// get a request
+		IORequest* request = fFinishedRequests.RemoveHead();
+
+		if (request == NULL) {
+			if (fTerminating)
+				return B_OK;
+
+			ConditionVariableEntry entry;
+			fFinishedRequestCondition.Add(&entry);
+
+			locker.Unlock();
+
+			entry.Wait();
+			continue;
+		}
+
+		locker.Unlock();
+
+		IOSchedulerRoster::Default()->Notify(IO_SCHEDULER_REQUEST_FINISHED,
+			this, request);
+
+		// notify the request
+		request->NotifyFinished();
+	}
+
+	// never can get here
+	return B_OK;
+}
+
+
+/*static*/ status_t
+IOSchedulerBase::_RequestNotifierThread(void *_self)
+{
+	IOSchedulerBase *self = (IOSchedulerBase*)_self;
+	return self->_RequestNotifier();
+}
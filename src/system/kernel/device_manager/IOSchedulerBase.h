@@ -0,0 +1,88 @@
+/*
+ * Copyright 2008-2010, Ingo Weinhold, ingo_weinhold@gmx.de.
+ * Copyright 2004-2008, Axel Dörfler, axeld@pinc-software.de.
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef IO_SCHEDULER_BASE_H
+#define IO_SCHEDULER_BASE_H
+
+
+#include <KernelExport.h>
+
+#include <condition_variable.h>
+#include <lock.h>
+
+#include "dma_resources.h"
+#include "IOScheduler.h"
+
+
+/*!	Base class of the I/O schedulers that translate the requests into
+	operations themselves. It runs the scheduler thread that executes the
+	operations, finishes them, and notifies the requests; subclasses only
+	decide which operations are dispatched next.
+*/
+class IOSchedulerBase : public IOScheduler {
+public:
+								IOSchedulerBase(DMAResource* resource);
+	virtual						~IOSchedulerBase();
+
+	virtual	status_t			Init(const char* name);
+
+	virtual	void				OperationCompleted(IOOperation* operation,
+									status_t status,
+									generic_size_t transferredBytes);
+									// called by the driver when the operation
+									// has been completed successfully or failed
+									// for some reason
+
+protected:
+	virtual	bool				HasWork() const = 0;
+									// called with fLock held
+	virtual	bool				PrepareOperations(IOOperationList& operations,
+									int32& operationCount) = 0;
+									// called with fLock held; returns false
+									// when the scheduler is asked to terminate
+	virtual	void				RemoveFinishedRequest(IORequest* request) = 0;
+									// called with fLock held
+
+			status_t			StartThreads();
+			void				StopThreads();
+
+			bool				WaitForWork();
+			status_t			PrepareRequestOperations(IORequest* request,
+									IOOperationList& operations,
+									int32& operationsPrepared, off_t quantum,
+									off_t& usedBandwidth);
+
+private:
+			void				_Finisher();
+			bool				_FinisherWorkPending();
+			void				_SortOperations(IOOperationList& operations,
+									off_t& lastOffset);
+			status_t			_Scheduler();
+	static	status_t			_SchedulerThread(void* self);
+			status_t			_RequestNotifier();
+	static	status_t			_RequestNotifierThread(void* self);
+
+protected:
+			mutex				fLock;
+			ConditionVariable	fNewRequestCondition;
+			generic_size_t		fBlockSize;
+	volatile bool				fTerminating;
+
+private:
+			spinlock			fFinisherLock;
+			thread_id			fSchedulerThread;
+			thread_id			fRequestNotifierThread;
+			IORequestList		fFinishedRequests;
+			ConditionVariable	fFinishedOperationCondition;
+			ConditionVariable	fFinishedRequestCondition;
+			IOOperation**		fOperationArray;
+			IOOperationList		fUnusedOperations;
+			IOOperationList		fCompletedOperations;
+			int32				fPendingOperations;
+};
+
+
+#endif	// IO_SCHEDULER_BASE_H
@@ -0,0 +1,574 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	An I/O scheduler that queues requests per team and I/O class, and shares
+	the device among the queues in a fair way: the queue of the most
+	important class that has received the least (priority weighted) service
+	so far goes next. Every request also gets a deadline, though, shorter for
+	reads than for writes, and requests that missed it are always served
+	first, so that neither a heavy writer can starve interactive reads, nor
+	the lower classes are starved completely.
+	Requests that continue where the previous one ended are dispatched right
+	after it, so that the device sees one sequential transfer.
+*/
+
+
+#include "IOSchedulerDeadline.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include <team.h>
+#include <thread_types.h>
+#include <thread.h>
+#include <util/AutoLock.h>
+
+#include "IOSchedulerRoster.h"
+
+
+//#define TRACE_IO_SCHEDULER_DEADLINE
+#ifdef TRACE_IO_SCHEDULER_DEADLINE
+#	define TRACE(x...) dprintf(x)
+#else
+#	define TRACE(x...) ;
+#endif
+
+
+static const off_t kIterationBandwidth = 1024 * 1024;
+	// the maximum number of bytes dispatched at once
+static const off_t kQuantum = 128 * 1024;
+	// the maximum number of bytes a queue gets per turn
+static const bigtime_t kReadDeadline = 500000;
+static const bigtime_t kWriteDeadline = 5000000;
+static const int32 kIdleDeadlineFactor = 4;
+static const int32 kWeightScale = B_NORMAL_PRIORITY;
+	// a queue of normal priority is charged exactly the bytes it transferred
+
+
+IORequest*
+IOSchedulerDeadline::RequestQueue::NextRequest() const
+{
+	// requests that have been started already come first, then reads
+	if (IORequest* request = requests.Head())
+		return request;
+	if (IORequest* request = pending[0].Head())
+		return request;
+	return pending[1].Head();
+}
+
+
+// #pragma mark -
+
+
+namespace {
+
+struct RequestQueueKey {
+	team_id	team;
+	int32	io_class;
+};
+
+}	// namespace
+
+
+struct IOSchedulerDeadline::RequestQueueHashDefinition {
+	typedef RequestQueueKey	KeyType;
+	typedef RequestQueue	ValueType;
+
+	size_t HashKey(const RequestQueueKey& key) const
+		{ return key.team * 4 + key.io_class; }
+	size_t Hash(const RequestQueue* value) const
+		{ return value->team * 4 + value->io_class; }
+	bool Compare(const RequestQueueKey& key, const RequestQueue* value) const
+		{ return value->team == key.team && value->io_class == key.io_class; }
+	RequestQueue*& GetLink(RequestQueue* value) const
+		{ return value->hash_next; }
+};
+
+struct IOSchedulerDeadline::RequestQueueHashTable
+		: BOpenHashTable<RequestQueueHashDefinition, false> {
+};
+
+
+IOSchedulerDeadline::IOSchedulerDeadline(DMAResource* resource)
+	:
+	IOSchedulerBase(resource),
+	fAllocatedQueues(NULL),
+	fAllocatedQueueCount(0),
+	fQueues(NULL),
+	fVirtualTime(0)
+{
+}
+
+
+IOSchedulerDeadline::~IOSchedulerDeadline()
+{
+	StopThreads();
+
+	delete fQueues;
+	delete[] fAllocatedQueues;
+}
+
+
+status_t
+IOSchedulerDeadline::Init(const char* name)
+{
+	status_t error = IOSchedulerBase::Init(name);
+	if (error != B_OK)
+		return error;
+
+	// Every active queue has at least one thread waiting for it, so there
+	// can't be more of them than threads.
+	fAllocatedQueueCount = thread_max_threads();
+	fAllocatedQueues = new(std::nothrow) RequestQueue[fAllocatedQueueCount];
+	if (fAllocatedQueues == NULL)
+		return B_NO_MEMORY;
+
+	for (int32 i = 0; i < fAllocatedQueueCount; i++) {
+		RequestQueue& queue = fAllocatedQueues[i];
+		queue.team = -1;
+		queue.thread = -1;
+		queue.priority = B_IDLE_PRIORITY;
+		queue.io_class = IO_CLASS_IDLE;
+		queue.virtual_time = 0;
+		fUnusedQueues.Add(&queue);
+	}
+
+	fQueues = new(std::nothrow) RequestQueueHashTable;
+	if (fQueues == NULL)
+		return B_NO_MEMORY;
+
+	error = fQueues->Init();
+	if (error != B_OK)
+		return error;
+
+	return StartThreads();
+}
+
+
+status_t
+IOSchedulerDeadline::ScheduleRequest(IORequest* request)
+{
+	TRACE("%p->IOSchedulerDeadline::ScheduleRequest(%p)\n", this, request);
+
+	IOBuffer* buffer = request->Buffer();
+
+	if (buffer->IsVirtual()) {
+		status_t status = buffer->LockMemory(request->TeamID(),
+			request->IsWrite());
+		if (status != B_OK) {
+			request->SetStatusAndNotify(status);
+			return status;
+		}
+	}
+
+	int32 priority = thread_get_io_priority(request->ThreadID());
+	if (priority < 0)
+		priority = B_NORMAL_PRIORITY;
+
+	int32 ioClass = team_get_io_class(request->TeamID());
+	if (ioClass == IO_CLASS_DEFAULT)
+		ioClass = _ClassForPriority(priority);
+
+	bigtime_t deadline = request->IsWrite() ? kWriteDeadline : kReadDeadline;
+	if (ioClass == IO_CLASS_IDLE)
+		deadline *= kIdleDeadlineFactor;
+
+	MutexLocker locker(fLock);
+
+	RequestQueue* queue = _GetRequestQueue(request->TeamID(), ioClass);
+	if (queue == NULL) {
+		panic("IOSchedulerDeadline: Out of request queues!\n");
+		locker.Unlock();
+		if (buffer->IsVirtual())
+			buffer->UnlockMemory(request->TeamID(), request->IsWrite());
+		request->SetStatusAndNotify(B_NO_MEMORY);
+		return B_NO_MEMORY;
+	}
+
+	queue->priority = priority;
+
+	request->SetOwner(queue);
+	request->SetDeadline(system_time() + deadline);
+	queue->pending[request->IsWrite() ? 1 : 0].Add(request);
+
+	IOSchedulerRoster::Default()->Notify(IO_SCHEDULER_REQUEST_SCHEDULED, this,
+		request);
+
+	fNewRequestCondition.NotifyAll();
+
+	return B_OK;
+}
+
+
+/*!	Aborts a request that has not been finished yet. If it has not been
+	started, it is removed from its queue, and finished with \a status right
+	away. Otherwise, no further operations are dispatched for it; if some
+	are still in progress, it is finished as a partial transfer once they
+	are done.
+*/
+void
+IOSchedulerDeadline::AbortRequest(IORequest* request, status_t status)
+{
+	TRACE("IOSchedulerDeadline::AbortRequest(%p, %s)\n", request,
+		strerror(status));
+
+	MutexLocker locker(fLock);
+
+	RequestQueue* queue = _FindRequestQueue(request);
+	if (queue == NULL) {
+		// it has been dispatched completely already
+		return;
+	}
+
+	if (request->HasPendingChildren() || request->IsFinished()) {
+		// the finisher completes it with its last operation
+		request->SetTransferredBytes(true, request->TransferredBytes());
+		queue->requests.Remove(request);
+		queue->completed_requests.Add(request);
+		return;
+	}
+
+	_RemoveRequest(queue, request);
+
+	locker.Unlock();
+
+	IOSchedulerRoster::Default()->Notify(IO_SCHEDULER_REQUEST_FINISHED, this,
+		request);
+	request->SetStatusAndNotify(status);
+}
+
+
+void
+IOSchedulerDeadline::Dump() const
+{
+	kprintf("IOSchedulerDeadline at %p\n", this);
+	kprintf("  DMA resource:   %p\n", fDMAResource);
+	kprintf("  virtual time:   %" B_PRIdOFF "\n", fVirtualTime);
+
+	kprintf("  active request queues:\n");
+	for (RequestQueueList::ConstIterator it = fActiveQueues.GetIterator();
+			RequestQueue* queue = it.Next();) {
+		kprintf("    %p: team %" B_PRId32 ", class %" B_PRId32 ", priority %"
+			B_PRId32 ", virtual time %" B_PRIdOFF ", %" B_PRId32 " reads, %"
+			B_PRId32 " writes pending\n", queue, queue->team, queue->io_class,
+			queue->priority, queue->virtual_time, queue->pending[0].Count(),
+			queue->pending[1].Count());
+	}
+}
+
+
+bool
+IOSchedulerDeadline::HasWork() const
+{
+	for (RequestQueueList::ConstIterator it = fActiveQueues.GetIterator();
+			RequestQueue* queue = it.Next();) {
+		if (!queue->operations.IsEmpty() || queue->NextRequest() != NULL)
+			return true;
+	}
+
+	return false;
+}
+
+
+bool
+IOSchedulerDeadline::PrepareOperations(IOOperationList& operations,
+	int32& operationCount)
+{
+	if (!WaitForWork()) {
+		// we've been asked to terminate
+		return false;
+	}
+
+	off_t bandwidth = kIterationBandwidth;
+
+	// Operations that could not be finished in one go (e.g. the read
+	// part of a partial block write) have to be continued first.
+	for (RequestQueueList::Iterator it = fActiveQueues.GetIterator();
+			RequestQueue* queue = it.Next();) {
+		while (IOOperation* operation = queue->operations.RemoveHead()) {
+			operations.Add(operation);
+			operationCount++;
+			bandwidth -= operation->Length();
+		}
+	}
+
+	while (bandwidth >= (off_t)fBlockSize) {
+		RequestQueue* queue;
+		IORequest* request = _NextRequest(queue);
+		if (request == NULL)
+			break;
+
+		status_t status = _DispatchRequest(queue, request, operations,
+			operationCount, std::min(bandwidth, kQuantum), bandwidth);
+
+		// Dispatch the requests that continue where this one ended right
+		// after it.
+		while (status == B_OK && request->RemainingBytes() == 0
+			&& bandwidth >= (off_t)fBlockSize) {
+			request = _NextAdjacentRequest(request, queue);
+			if (request == NULL)
+				break;
+
+			status = _DispatchRequest(queue, request, operations,
+				operationCount, std::min(bandwidth, kQuantum), bandwidth);
+		}
+
+		if (status == B_BUSY)
+			break;
+		if (status != B_OK)
+			_AbortRequest(queue, request, status, operations);
+	}
+
+	return true;
+}
+
+
+void
+IOSchedulerDeadline::RemoveFinishedRequest(IORequest* request)
+{
+	_RemoveRequest(static_cast<RequestQueue*>(request->Owner()), request);
+}
+
+
+/*!	Called with \c fLock held. Returns the queue in which the request is
+	waiting to be started, or to be dispatched further, if any.
+*/
+IOSchedulerDeadline::RequestQueue*
+IOSchedulerDeadline::_FindRequestQueue(IORequest* request)
+{
+	int32 direction = request->IsWrite() ? 1 : 0;
+
+	for (RequestQueueList::Iterator it = fActiveQueues.GetIterator();
+			RequestQueue* queue = it.Next();) {
+		if (queue->pending[direction].Contains(request)
+			|| queue->requests.Contains(request)) {
+			return queue;
+		}
+	}
+
+	return NULL;
+}
+
+
+/*!	Called with \c fLock held. Chooses the request to be dispatched next, and
+	returns it, already moved to the \c requests list of its queue.
+*/
+IORequest*
+IOSchedulerDeadline::_NextRequest(RequestQueue*& _queue)
+{
+	// Requests that missed their deadline come first, reads before writes.
+	bigtime_t now = system_time();
+	for (int32 direction = 0; direction < 2; direction++) {
+		RequestQueue* expired = NULL;
+		bigtime_t expiredDeadline = now;
+
+		for (RequestQueueList::Iterator it = fActiveQueues.GetIterator();
+				RequestQueue* queue = it.Next();) {
+			IORequest* request = queue->pending[direction].Head();
+			if (request != NULL && request->Deadline() <= expiredDeadline) {
+				expired = queue;
+				expiredDeadline = request->Deadline();
+			}
+		}
+
+		if (expired != NULL) {
+			TRACE("IOSchedulerDeadline::_NextRequest(): queue %p missed its "
+				"deadline\n", expired);
+			_queue = expired;
+			return _StartRequest(expired, expired->pending[direction].Head());
+		}
+	}
+
+	// Otherwise, the queue of the most important class that has received the
+	// least service so far is next.
+	RequestQueue* next = NULL;
+	for (RequestQueueList::Iterator it = fActiveQueues.GetIterator();
+			RequestQueue* queue = it.Next();) {
+		if (queue->NextRequest() == NULL)
+			continue;
+
+		if (next == NULL || queue->io_class < next->io_class
+			|| (queue->io_class == next->io_class
+				&& queue->virtual_time < next->virtual_time)) {
+			next = queue;
+		}
+	}
+
+	if (next == NULL)
+		return NULL;
+
+	// queues that become active later start from here
+	if (next->virtual_time > fVirtualTime)
+		fVirtualTime = next->virtual_time;
+
+	_queue = next;
+
+	IORequest* request = next->requests.Head();
+	if (request != NULL)
+		return request;
+
+	return _StartRequest(next, next->NextRequest());
+}
+
+
+/*!	Called with \c fLock held. Returns a request that hasn't been started yet,
+	and that continues in the same direction where \a request ends, if any.
+	Only the oldest request of each queue is considered, as sequential
+	transfers issue their requests in order anyway.
+*/
+IORequest*
+IOSchedulerDeadline::_NextAdjacentRequest(IORequest* request,
+	RequestQueue*& _queue)
+{
+	off_t offset = request->Offset() + request->Length();
+	int32 direction = request->IsWrite() ? 1 : 0;
+
+	for (RequestQueueList::Iterator it = fActiveQueues.GetIterator();
+			RequestQueue* queue = it.Next();) {
+		IORequest* next = queue->pending[direction].Head();
+		if (next != NULL && next->Offset() == offset) {
+			_queue = queue;
+			return _StartRequest(queue, next);
+		}
+	}
+
+	return NULL;
+}
+
+
+IORequest*
+IOSchedulerDeadline::_StartRequest(RequestQueue* queue, IORequest* request)
+{
+	queue->pending[request->IsWrite() ? 1 : 0].Remove(request);
+	queue->requests.Add(request);
+	return request;
+}
+
+
+/*!	Called with \c fLock held. Prepares operations for up to \a quantum bytes
+	of the given request, and charges them to its queue.
+*/
+status_t
+IOSchedulerDeadline::_DispatchRequest(RequestQueue* queue, IORequest* request,
+	IOOperationList& operations, int32& operationsPrepared, off_t quantum,
+	off_t& bandwidth)
+{
+	off_t usedBandwidth = 0;
+	status_t status = PrepareRequestOperations(request, operations,
+		operationsPrepared, quantum, usedBandwidth);
+
+	bandwidth -= usedBandwidth;
+	queue->virtual_time += usedBandwidth * kWeightScale
+		/ std::max(queue->priority, (int32)1);
+
+	if (status == B_OK && request->RemainingBytes() == 0) {
+		// The request has been dispatched completely, so move it to the
+		// completed list, so we don't pick it up again.
+		queue->requests.Remove(request);
+		queue->completed_requests.Add(request);
+	}
+
+	return status;
+}
+
+
+/*!	Called with \c fLock held, when (the rest of) a started request could not
+	be translated into operations. If none of its operations are about to be
+	executed, the request is finished with the given error right away --
+	this temporarily unlocks \c fLock. Otherwise, it is marked as partially
+	transferred, and is finished together with its last operation.
+*/
+void
+IOSchedulerDeadline::_AbortRequest(RequestQueue* queue, IORequest* request,
+	status_t status, const IOOperationList& operations)
+{
+	TRACE("IOSchedulerDeadline::_AbortRequest(%p, %s)\n", request,
+		strerror(status));
+
+	for (IOOperationList::ConstIterator it = operations.GetIterator();
+			IOOperation* operation = it.Next();) {
+		if (operation->Parent() == request) {
+			request->SetTransferredBytes(true, request->TransferredBytes());
+			queue->requests.Remove(request);
+			queue->completed_requests.Add(request);
+			return;
+		}
+	}
+
+	_RemoveRequest(queue, request);
+
+	mutex_unlock(&fLock);
+
+	IOSchedulerRoster::Default()->Notify(IO_SCHEDULER_REQUEST_FINISHED, this,
+		request);
+	request->SetStatusAndNotify(status);
+
+	mutex_lock(&fLock);
+}
+
+
+/*!	Called with \c fLock held. Returns the queue of the given team and class,
+	and makes it active, if necessary.
+*/
+IOSchedulerDeadline::RequestQueue*
+IOSchedulerDeadline::_GetRequestQueue(team_id team, int32 ioClass)
+{
+	RequestQueueKey key = { team, ioClass };
+	RequestQueue* queue = fQueues->Lookup(key);
+	if (queue != NULL)
+		return queue;
+
+	queue = fUnusedQueues.RemoveHead();
+	if (queue == NULL)
+		return NULL;
+
+	queue->team = team;
+	queue->io_class = ioClass;
+	queue->virtual_time = fVirtualTime;
+	fQueues->InsertUnchecked(queue);
+	fActiveQueues.Add(queue);
+
+	return queue;
+}
+
+
+/*!	Called with \c fLock held. Removes the request from its queue, and
+	deactivates the queue, if it has nothing left to do.
+*/
+void
+IOSchedulerDeadline::_RemoveRequest(RequestQueue* queue, IORequest* request)
+{
+	if (queue->completed_requests.Contains(request))
+		queue->completed_requests.Remove(request);
+	else if (queue->requests.Contains(request))
+		queue->requests.Remove(request);
+	else
+		queue->pending[request->IsWrite() ? 1 : 0].Remove(request);
+
+	request->SetOwner(NULL);
+
+	if (queue->IsIdle()) {
+		fQueues->RemoveUnchecked(queue);
+		fActiveQueues.Remove(queue);
+		fUnusedQueues.Add(queue);
+	}
+}
+
+
+/*!	Maps a thread's I/O priority to the class its requests are served in,
+	for teams that have not chosen one explicitly.
+*/
+/*static*/ int32
+IOSchedulerDeadline::_ClassForPriority(int32 priority)
+{
+	if (priority >= B_FIRST_REAL_TIME_PRIORITY)
+		return IO_CLASS_REALTIME;
+	if (priority < B_LOW_PRIORITY)
+		return IO_CLASS_IDLE;
+
+	return IO_CLASS_BEST_EFFORT;
+}
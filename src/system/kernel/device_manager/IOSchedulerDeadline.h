@@ -0,0 +1,91 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef IO_SCHEDULER_DEADLINE_H
+#define IO_SCHEDULER_DEADLINE_H
+
+
+#include <KernelExport.h>
+
+#include <util/OpenHashTable.h>
+
+#include "IOSchedulerBase.h"
+
+
+class IOSchedulerDeadline : public IOSchedulerBase {
+public:
+								IOSchedulerDeadline(DMAResource* resource);
+	virtual						~IOSchedulerDeadline();
+
+	virtual	status_t			Init(const char* name);
+
+	virtual	status_t			ScheduleRequest(IORequest* request);
+
+	virtual	void				AbortRequest(IORequest* request,
+									status_t status = B_CANCELED);
+
+	virtual	void				Dump() const;
+
+protected:
+	virtual	bool				HasWork() const;
+	virtual	bool				PrepareOperations(IOOperationList& operations,
+									int32& operationCount);
+	virtual	void				RemoveFinishedRequest(IORequest* request);
+
+private:
+			struct RequestQueue : IORequestOwner {
+				int32			io_class;
+				off_t			virtual_time;
+				IORequestList	pending[2];
+									// requests that have not been started
+									// yet, reads and writes, each in the
+									// order of their deadlines
+				RequestQueue*	hash_next;
+				DoublyLinkedListLink<RequestQueue> queue_link;
+
+				IORequest*		NextRequest() const;
+				bool			IsIdle() const
+									{ return !IsActive()
+										&& pending[0].IsEmpty()
+										&& pending[1].IsEmpty(); }
+			};
+
+			typedef DoublyLinkedList<RequestQueue,
+				DoublyLinkedListMemberGetLink<RequestQueue,
+					&RequestQueue::queue_link> > RequestQueueList;
+
+			struct RequestQueueHashDefinition;
+			struct RequestQueueHashTable;
+
+			RequestQueue*		_FindRequestQueue(IORequest* request);
+			IORequest*			_NextRequest(RequestQueue*& _queue);
+			IORequest*			_NextAdjacentRequest(IORequest* request,
+									RequestQueue*& _queue);
+			IORequest*			_StartRequest(RequestQueue* queue,
+									IORequest* request);
+			status_t			_DispatchRequest(RequestQueue* queue,
+									IORequest* request,
+									IOOperationList& operations,
+									int32& operationsPrepared, off_t quantum,
+									off_t& bandwidth);
+			void				_AbortRequest(RequestQueue* queue,
+									IORequest* request, status_t status,
+									const IOOperationList& operations);
+
+			RequestQueue*		_GetRequestQueue(team_id team, int32 ioClass);
+			void				_RemoveRequest(RequestQueue* queue,
+									IORequest* request);
+	static	int32				_ClassForPriority(int32 priority);
+
+private:
+			RequestQueue*		fAllocatedQueues;
+			int32				fAllocatedQueueCount;
+			RequestQueueList	fActiveQueues;
+			RequestQueueList	fUnusedQueues;
+			RequestQueueHashTable* fQueues;
+			off_t				fVirtualTime;
+};
+
+
+#endif	// IO_SCHEDULER_DEADLINE_H
@@ -6,8 +6,14 @@
 
 #include "IOSchedulerRoster.h"
 
+#include <string.h>
+
+#include <driver_settings.h>
 #include <util/AutoLock.h>
 
+#include "IOSchedulerDeadline.h"
+#include "IOSchedulerSimple.h"
+
 
 /*static*/ IOSchedulerRoster IOSchedulerRoster::sDefaultInstance;
 
@@ -19,6 +25,49 @@ IOSchedulerRoster::Init()
 }
 
 
+/*!	Creates the I/O scheduler for a device of the driver with the given name,
+	as chosen by the "io_scheduler" entries in the kernel settings. The
+	scheduler still needs to be initialized.
+*/
+IOScheduler*
+IOSchedulerRoster::CreateScheduler(DMAResource* resource, const char* name)
+{
+	bool useDeadline = false;
+
+	void* handle = load_driver_settings("kernel");
+	if (handle != NULL) {
+		const driver_settings* settings = get_driver_settings(handle);
+		bool nameMatched = false;
+
+		for (int32 i = 0; settings != NULL && i < settings->parameter_count;
+				i++) {
+			const driver_parameter& parameter = settings->parameters[i];
+			if (strcmp(parameter.name, "io_scheduler") != 0
+				|| parameter.value_count < 1) {
+				continue;
+			}
+
+			// an entry for this driver overrides the general one
+			if (parameter.value_count > 1) {
+				if (strcmp(parameter.values[1], name) != 0)
+					continue;
+				nameMatched = true;
+			} else if (nameMatched)
+				continue;
+
+			useDeadline = strcmp(parameter.values[0], "deadline") == 0;
+		}
+
+		unload_driver_settings(handle);
+	}
+
+	if (useDeadline)
+		return new(std::nothrow) IOSchedulerDeadline(resource);
+
+	return new(std::nothrow) IOSchedulerSimple(resource);
+}
+
+
 void
 IOSchedulerRoster::AddScheduler(IOScheduler* scheduler)
 {
@@ -38,6 +38,9 @@ public:
 									// caller must keep the roster locked,
 									// while accessing the list
 
+			IOScheduler*		CreateScheduler(DMAResource* resource,
+									const char* name);
+
 			void				AddScheduler(IOScheduler* scheduler);
 			void				RemoveScheduler(IOScheduler* scheduler);
 
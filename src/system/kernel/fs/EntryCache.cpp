@@ -77,10 +77,6 @@ EntryCache::~EntryCache()
 status_t
 EntryCache::Init()
 {
-	status_t error = fEntries.Init();
-	if (error != B_OK)
-		return error;
-
 	int32 entriesSize = 1024;
 	fGenerationCount = 8;
 
@@ -91,6 +87,17 @@ EntryCache::Init()
 		fGenerationCount = 16;
 	}
 
+	// Lookup() accesses the table without holding the lock, so it must never
+	// be resized. The number of entries is bounded by the generations, so we
+	// can size it for the worst case right away.
+	size_t tableSize = BOpenHashTable<EntryCacheHashDefinition>::kMinimumSize;
+	while (tableSize < (size_t)entriesSize * fGenerationCount / 4)
+		tableSize <<= 1;
+
+	status_t error = fEntries.Init(tableSize);
+	if (error != B_OK)
+		return error;
+
 	fGenerations = new(std::nothrow) EntryCacheGeneration[fGenerationCount];
 	for (int32 i = 0; i < fGenerationCount; i++) {
 		error = fGenerations[i].Init(entriesSize);
@@ -113,9 +120,8 @@ EntryCache::Add(ino_t dirID, const char* name, ino_t nodeID, bool missing)
 		return B_NO_MEMORY;
 
 	EntryCacheEntry* entry = fEntries.Lookup(key);
-	if (entry != NULL) {
-		entry->node_id = nodeID;
-		entry->missing = missing;
+	if (entry != NULL && entry->node_id == nodeID
+		&& entry->missing == missing) {
 		if (entry->generation != fCurrentGeneration) {
 			if (entry->index >= 0) {
 				fGenerations[entry->generation].entries[entry->index] = NULL;
@@ -125,6 +131,11 @@ EntryCache::Add(ino_t dirID, const char* name, ino_t nodeID, bool missing)
 		return B_OK;
 	}
 
+	// Lockless readers must not see the node ID and the missing flag change
+	// independently, so a changed entry is replaced instead of updated.
+	if (entry != NULL)
+		_RemoveEntry(entry);
+
 	entry = (EntryCacheEntry*)malloc(sizeof(EntryCacheEntry) + strlen(name));
 	if (entry == NULL)
 		return B_NO_MEMORY;
@@ -136,6 +147,11 @@ EntryCache::Add(ino_t dirID, const char* name, ino_t nodeID, bool missing)
 	entry->index = kEntryNotInArray;
 	strcpy(entry->name, name);
 
+	// Publish the fully initialized entry. A concurrent lockless lookup
+	// might see the bucket chain cut off behind it, which is just a miss.
+	entry->hash_link = NULL;
+	memory_write_barrier();
+
 	fEntries.Insert(entry);
 
 	_AddEntryToCurrentGeneration(entry);
@@ -155,19 +171,7 @@ EntryCache::Remove(ino_t dirID, const char* name)
 	if (entry == NULL)
 		return B_ENTRY_NOT_FOUND;
 
-	fEntries.Remove(entry);
-
-	if (entry->index >= 0) {
-		// remove the entry from its generation and delete it
-		fGenerations[entry->generation].entries[entry->index] = NULL;
-		free(entry);
-	} else {
-		// We can't free it, since another thread is about to try to move it
-		// to another generation. We mark it removed and the other thread will
-		// take care of deleting it.
-		entry->index = kEntryRemoved;
-	}
-
+	_RemoveEntry(entry);
 	return B_OK;
 }
 
@@ -178,6 +182,21 @@ EntryCache::Lookup(ino_t dirID, const char* name, ino_t& _nodeID,
 {
 	EntryCacheKey key(dirID, name);
 
+	// Fast path: entries already in the current generation don't have to be
+	// touched, so they can be looked up without locking.
+	{
+		RCUReadLocker rcuLocker;
+
+		EntryCacheEntry* entry = fEntries.Lookup(key);
+		if (entry != NULL
+			&& atomic_get(&entry->generation)
+				== atomic_get(&fCurrentGeneration)) {
+			_nodeID = entry->node_id;
+			_missing = entry->missing;
+			return true;
+		}
+	}
+
 	ReadLocker readLocker(fLock);
 
 	EntryCacheEntry* entry = fEntries.Lookup(key);
@@ -215,7 +234,7 @@ EntryCache::Lookup(ino_t dirID, const char* name, ino_t& _nodeID,
 
 	if (entry->index == kEntryRemoved) {
 		// the entry has been removed in the meantime
-		free(entry);
+		_FreeEntry(entry);
 		return false;
 	}
 
@@ -266,7 +285,7 @@ EntryCache::_AddEntryToCurrentGeneration(EntryCacheEntry* entry)
 
 		fGenerations[newGeneration].entries[i] = NULL;
 		fEntries.Remove(otherEntry);
-		free(otherEntry);
+		_FreeEntry(otherEntry);
 	}
 
 	// set the new generation and add the entry
@@ -276,3 +295,31 @@ EntryCache::_AddEntryToCurrentGeneration(EntryCacheEntry* entry)
 	entry->generation = newGeneration;
 	entry->index = 0;
 }
+
+
+void
+EntryCache::_RemoveEntry(EntryCacheEntry* entry)
+{
+	ASSERT_WRITE_LOCKED_RW_LOCK(&fLock);
+
+	fEntries.Remove(entry);
+
+	if (entry->index >= 0) {
+		// remove the entry from its generation and delete it
+		fGenerations[entry->generation].entries[entry->index] = NULL;
+		_FreeEntry(entry);
+	} else {
+		// We can't free it, since another thread is about to try to move it
+		// to another generation. We mark it removed and the other thread will
+		// take care of deleting it.
+		entry->index = kEntryRemoved;
+	}
+}
+
+
+void
+EntryCache::_FreeEntry(EntryCacheEntry* entry)
+{
+	// lockless lookups might still be looking at the entry
+	rcu_free(&entry->rcu, entry);
+}
@@ -12,6 +12,7 @@
 #include <util/DoublyLinkedList.h>
 #include <util/OpenHashTable.h>
 #include <util/StringHash.h>
+#include <util/rcu.h>
 
 
 struct EntryCacheKey {
@@ -31,6 +32,10 @@ struct EntryCacheKey {
 };
 
 
+/*!	Apart from \c generation and \c index, entries are immutable once they
+	have been added to the cache, since Lookup() reads them without holding
+	the cache's lock.
+*/
 struct EntryCacheEntry {
 			EntryCacheEntry*	hash_link;
 			ino_t				node_id;
@@ -38,6 +43,7 @@ struct EntryCacheEntry {
 			int32				generation;
 			int32				index;
 			bool				missing;
+			rcu_head			rcu;
 			char				name[1];
 };
 
@@ -100,12 +106,16 @@ public:
 			const char*			DebugReverseLookup(ino_t nodeID, ino_t& _dirID);
 
 private:
-			typedef BOpenHashTable<EntryCacheHashDefinition> EntryTable;
+			typedef BOpenHashTable<EntryCacheHashDefinition, false>
+				EntryTable;
+				// never resized, cf. Init()
 			typedef DoublyLinkedList<EntryCacheEntry> EntryList;
 
 private:
 			void				_AddEntryToCurrentGeneration(
 									EntryCacheEntry* entry);
+			void				_RemoveEntry(EntryCacheEntry* entry);
+			void				_FreeEntry(EntryCacheEntry* entry);
 
 private:
 			rw_lock				fLock;
@@ -35,6 +35,8 @@ struct vnode : fs_vnode, DoublyLinkedListLinkImpl<vnode> {
 			ino_t				id;
 			dev_t				device;
 			int32				ref_count;
+			int32				hot_cpu;
+				// CPU of the hot vnodes array the node has been entered into
 
 public:
 	inline	bool				IsBusy() const;
@@ -52,11 +54,11 @@ public:
 	inline	bool				IsHot() const;
 	inline	void				SetHot(bool hot);
 
-	// setter requires sVnodeLock write-locked, getter is lockless
+	// setter requires write_lock_vnodes(), getter is lockless
 	inline	bool				IsCovered() const;
 	inline	void				SetCovered(bool covered);
 
-	// setter requires sVnodeLock write-locked, getter is lockless
+	// setter requires write_lock_vnodes(), getter is lockless
 	inline	bool				IsCovering() const;
 	inline	void				SetCovering(bool covering);
 
@@ -245,12 +247,13 @@ vnode::SetType(uint32 type)
 
 
 /*!	Locks the vnode.
-	The caller must hold sVnodeLock (at least read locked) and must continue to
-	hold it until calling Unlock(). After acquiring the lock the caller is
-	allowed to write access the vnode's mutable fields, if it hasn't been marked
-	busy by someone else.
-	Due to the condition of holding sVnodeLock at least read locked, write
-	locking it grants the same write access permission to *any* vnode.
+	The caller must hold the vnode's shard lock or sVnodeLock (at least read
+	locked) and must continue to hold it until calling Unlock(). After
+	acquiring the lock the caller is allowed to write access the vnode's
+	mutable fields, if it hasn't been marked busy by someone else.
+	Due to that condition, write locking sVnodeLock and all shards (cf.
+	write_lock_vnodes()) grants the same write access permission to *any*
+	vnode.
 
 	The vnode's lock should be held only for a short time. It can be held over
 	sUnusedVnodesLock.
@@ -11,7 +11,9 @@
 #include <util/AutoLock.h>
 #include <util/list.h>
 
+#include <cpu.h>
 #include <low_resource_manager.h>
+#include <smp.h>
 
 #include "Vnode.h"
 
@@ -32,25 +34,64 @@ static mutex sUnusedVnodesLock = MUTEX_INITIALIZER("unused vnodes");
 static list sUnusedVnodeList;
 static uint32 sUnusedVnodes = 0;
 
-static const int32 kMaxHotVnodes = 1024;
-static rw_lock sHotVnodesLock = RW_LOCK_INITIALIZER("hot vnodes");
-static Vnode* sHotVnodes[kMaxHotVnodes];
-static int32 sNextHotVnodeIndex = 0;
+static const int32 kMaxHotVnodesPerCPU = 256;
+
+/*!	\brief Recently unused vnodes not yet added to sUnusedVnodeList.
+
+	Each CPU has its own array, so that vnodes becoming unused on different
+	CPUs don't contend for the same lock and cache lines. A hot vnode's
+	hot_cpu field refers to the array it has been entered into. The array's
+	lock must be write-locked to flush it, while entering or removing a vnode
+	only requires a read lock.
+*/
+struct hot_vnodes {
+	rw_lock		lock;
+	int32		next_index;
+	Vnode*		vnodes[kMaxHotVnodesPerCPU];
+} CACHE_LINE_ALIGN;
+
+static hot_vnodes* sHotVnodes;
 
 static const int32 kUnusedVnodesCheckInterval = 64;
 static int32 sUnusedVnodesCheckCount = 0;
 
 
-/*!	Must be called with sHotVnodesLock write-locked.
+static inline hot_vnodes&
+hot_vnodes_for(int32 cpu)
+{
+	return sHotVnodes[cpu];
+}
+
+
+static status_t
+init_hot_vnodes()
+{
+	int32 cpuCount = smp_get_num_cpus();
+	sHotVnodes = new(std::nothrow) hot_vnodes[cpuCount];
+	if (sHotVnodes == NULL)
+		return B_NO_MEMORY;
+
+	for (int32 i = 0; i < cpuCount; i++) {
+		hot_vnodes& hot = sHotVnodes[i];
+		rw_lock_init(&hot.lock, "hot vnodes");
+		hot.next_index = 0;
+		memset(hot.vnodes, 0, sizeof(hot.vnodes));
+	}
+
+	return B_OK;
+}
+
+
+/*!	Must be called with the array's lock write-locked.
 */
 static void
-flush_hot_vnodes_locked()
+flush_hot_vnodes_locked(hot_vnodes& hot)
 {
 	MutexLocker unusedLocker(sUnusedVnodesLock);
 
-	int32 count = std::min(sNextHotVnodeIndex, kMaxHotVnodes);
+	int32 count = std::min(hot.next_index, kMaxHotVnodesPerCPU);
 	for (int32 i = 0; i < count; i++) {
-		Vnode* vnode = sHotVnodes[i];
+		Vnode* vnode = hot.vnodes[i];
 		if (vnode == NULL)
 			continue;
 
@@ -62,28 +103,25 @@ flush_hot_vnodes_locked()
 			vnode->SetHot(false);
 		}
 
-		sHotVnodes[i] = NULL;
+		hot.vnodes[i] = NULL;
 	}
 
 	unusedLocker.Unlock();
 
-	sNextHotVnodeIndex = 0;
+	hot.next_index = 0;
 }
 
 
 
 /*!	To be called when the vnode's ref count drops to 0.
-	Must be called with sVnodeLock at least read-locked and the vnode locked.
+	Must be called with the vnode's shard or sVnodeLock at least read-locked
+	and the vnode locked.
 	\param vnode The vnode.
 	\return \c true, if the caller should trigger unused vnode freeing.
 */
 static bool
 vnode_unused(Vnode* vnode)
 {
-	ReadLocker hotReadLocker(sHotVnodesLock);
-
-	vnode->SetUnused(true);
-
 	bool result = false;
 	int32 checkCount = atomic_add(&sUnusedVnodesCheckCount, 1);
 	if (checkCount == kUnusedVnodesCheckInterval) {
@@ -101,43 +139,57 @@ vnode_unused(Vnode* vnode)
 		}
 	}
 
+	// The node might still be hot in the array of the CPU it became unused on
+	// last time, which can be flushed concurrently.
+	ReadLocker hotReadLocker(hot_vnodes_for(vnode->hot_cpu).lock);
+
+	vnode->SetUnused(true);
+
 	// nothing to do, if the node is already hot
 	if (vnode->IsHot())
 		return result;
 
-	// no -- enter it
-	int32 index = atomic_add(&sNextHotVnodeIndex, 1);
-	if (index < kMaxHotVnodes) {
+	hotReadLocker.Unlock();
+
+	// no -- enter it into the current CPU's array
+	int32 cpu = smp_get_current_cpu();
+	hot_vnodes& hot = hot_vnodes_for(cpu);
+	hotReadLocker.SetTo(hot.lock, false);
+
+	vnode->hot_cpu = cpu;
+	int32 index = atomic_add(&hot.next_index, 1);
+	if (index < kMaxHotVnodesPerCPU) {
 		vnode->SetHot(true);
-		sHotVnodes[index] = vnode;
+		hot.vnodes[index] = vnode;
 		return result;
 	}
 
 	// the array is full -- it has to be emptied
 	hotReadLocker.Unlock();
-	WriteLocker hotWriteLocker(sHotVnodesLock);
+	WriteLocker hotWriteLocker(hot.lock);
 
 	// unless someone was faster than we were, we have to flush the array
-	if (sNextHotVnodeIndex >= kMaxHotVnodes)
-		flush_hot_vnodes_locked();
+	if (hot.next_index >= kMaxHotVnodesPerCPU)
+		flush_hot_vnodes_locked(hot);
 
 	// enter the vnode
-	index = sNextHotVnodeIndex++;
+	index = hot.next_index++;
 	vnode->SetHot(true);
-	sHotVnodes[index] = vnode;
+	hot.vnodes[index] = vnode;
 
 	return result;
 }
 
 
 /*!	To be called when the vnode's ref count is changed from 0 to 1.
-	Must be called with sVnodeLock at least read-locked and the vnode locked.
+	Must be called with the vnode's shard or sVnodeLock at least read-locked
+	and the vnode locked.
 	\param vnode The vnode.
 */
 static void
 vnode_used(Vnode* vnode)
 {
-	ReadLocker hotReadLocker(sHotVnodesLock);
+	ReadLocker hotReadLocker(hot_vnodes_for(vnode->hot_cpu).lock);
 
 	if (!vnode->IsUnused())
 		return;
@@ -153,22 +205,24 @@ vnode_used(Vnode* vnode)
 
 
 /*!	To be called when the vnode's is about to be freed.
-	Must be called with sVnodeLock at least read-locked and the vnode locked.
+	Must be called with the vnode's shard or sVnodeLock at least read-locked
+	and the vnode locked.
 	\param vnode The vnode.
 */
 static void
 vnode_to_be_freed(Vnode* vnode)
 {
-	ReadLocker hotReadLocker(sHotVnodesLock);
+	hot_vnodes& hot = hot_vnodes_for(vnode->hot_cpu);
+	ReadLocker hotReadLocker(hot.lock);
 
 	if (vnode->IsHot()) {
 		// node is hot -- remove it from the array
 // TODO: Maybe better completely flush the array while at it?
-		int32 count = atomic_get(&sNextHotVnodeIndex);
-		count = std::min(count, kMaxHotVnodes);
+		int32 count = atomic_get(&hot.next_index);
+		count = std::min(count, kMaxHotVnodesPerCPU);
 		for (int32 i = 0; i < count; i++) {
-			if (sHotVnodes[i] == vnode) {
-				sHotVnodes[i] = NULL;
+			if (hot.vnodes[i] == vnode) {
+				hot.vnodes[i] = NULL;
 				break;
 			}
 		}
@@ -185,8 +239,12 @@ vnode_to_be_freed(Vnode* vnode)
 static inline void
 flush_hot_vnodes()
 {
-	WriteLocker hotWriteLocker(sHotVnodesLock);
-	flush_hot_vnodes_locked();
+	int32 cpuCount = smp_get_num_cpus();
+	for (int32 i = 0; i < cpuCount; i++) {
+		hot_vnodes& hot = hot_vnodes_for(i);
+		WriteLocker hotWriteLocker(hot.lock);
+		flush_hot_vnodes_locked(hot);
+	}
 }
 
 
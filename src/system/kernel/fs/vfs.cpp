@@ -35,6 +35,7 @@
 #include <AutoDeleterDrivers.h>
 #include <block_cache.h>
 #include <boot/kernel_args.h>
+#include <cpu.h>
 #include <debug_heap.h>
 #include <disk_device_manager/KDiskDevice.h>
 #include <disk_device_manager/KDiskDeviceManager.h>
@@ -117,6 +118,14 @@ const static size_t kMaxPathLength = 65536;
 	// The absolute maximum path length (for getcwd() - this is not depending
 	// on PATH_MAX
 
+const static uint32 kMaxReadDirStatCount = 128;
+const static size_t kMaxReadDirStatBufferSize = 64 * 1024;
+const static size_t kMaxReadDirStatAttributeSize = 1024;
+	// limits for a single read_dir_stat() call, bounding the size of the
+	// kernel buffers
+const static size_t kMaxAttrIOVecCount = 64;
+	// maximum number of attributes read or written in a single call
+
 
 typedef DoublyLinkedList<vnode> VnodeList;
 
@@ -233,18 +242,23 @@ static rw_lock sMountLock = RW_LOCK_INITIALIZER("vfs_mount_lock");
 */
 static recursive_lock sMountOpLock;
 
-/*!	\brief Guards sVnodeTable.
+/*!	\brief Guards the vnode tables as a whole.
 
-	The holder is allowed read/write access to sVnodeTable and to
-	any unbusy vnode in that table, save to the immutable fields (device, id,
-	private_node, mount) to which only read-only access is allowed.
-	The mutable fields advisory_locking, mandatory_locked_by, and ref_count, as
-	well as the busy, removed, unused flags, and the vnode's type can also be
-	write accessed when holding a read lock to sVnodeLock *and* having the vnode
-	locked. Write access to covered_by and covers requires to write lock
-	sVnodeLock.
+	The vnodes are kept in VNODE_SHARD_COUNT hash tables ("shards") selected
+	by mount and node ID, each guarded by its own lock (cf. vnode_shard).
+
+	Holding a read lock guarantees that no vnode is freed (free_vnode() write
+	locks sVnodeLock before removing the node from its shard) and that the
+	covers and covered_by links don't change. The mutable vnode fields listed
+	for vnode_shard::lock may also be write accessed when holding a read lock
+	to sVnodeLock *and* having the vnode locked.
+	The lock is only write locked via write_lock_vnodes(), which also write
+	locks all shards. That grants access to any unbusy vnode, save to the
+	immutable fields (device, id, private_node, mount) to which only read-only
+	access is allowed. Write access to covered_by and covers requires this.
 
-	The thread trying to acquire the lock must not hold sMountLock.
+	The thread trying to acquire the lock must not hold a shard lock or
+	sMountLock.
 	You must not hold this lock when calling create_sem(), as this might call
 	vfs_free_unused_vnodes() and thus cause a deadlock.
 */
@@ -333,8 +347,33 @@ object_cache* sPathNameCache;
 object_cache* sVnodeCache;
 object_cache* sFileDescriptorCache;
 
-#define VNODE_HASH_TABLE_SIZE 1024
-static VnodeTable* sVnodeTable;
+/*!	\brief A part of the vnode table.
+
+	The holder of the shard's lock is allowed read access to its table and to
+	the immutable fields (device, id, private_node, mount) of the vnodes in it.
+	Adding or removing vnodes requires a write lock, as does write access to
+	busy vnodes that aren't locked.
+	The mutable fields advisory_locking, mandatory_locked_by, and ref_count, as
+	well as the busy, removed, unused flags, and the vnode's type can be write
+	accessed when holding a read lock to the vnode's shard *and* having the
+	vnode locked. As an exception, ref_count may be changed atomically without
+	locking the vnode as long as it neither starts nor ends at 0 (cf.
+	try_inc_vnode_ref_count() and dec_vnode_ref_count()).
+
+	A thread may hold at most one shard lock at a time -- unless it holds all
+	of them via write_lock_vnodes(). The lock must be acquired after sVnodeLock
+	and before sMountLock.
+*/
+struct vnode_shard {
+	rw_lock		lock;
+	VnodeTable*	table;
+} CACHE_LINE_ALIGN;
+
+#define VNODE_SHARD_SHIFT		5
+#define VNODE_SHARD_COUNT		(1 << VNODE_SHARD_SHIFT)
+#define VNODE_HASH_TABLE_SIZE	64
+	// initial size of each shard's table
+static vnode_shard sVnodeShards[VNODE_SHARD_COUNT];
 static struct vnode* sRoot;
 
 #define MOUNTS_HASH_TABLE_SIZE 16
@@ -757,7 +796,8 @@ get_file_system(const char* fsName)
 	if (strncmp(fsName, "file_systems/", strlen("file_systems/"))) {
 		// construct module name if we didn't get one
 		// (we currently support only one API)
-		snprintf(name, sizeof(name), "file_systems/%s/v1", fsName);
+		snprintf(name, sizeof(name), "file_systems/%s"
+			B_CURRENT_FS_API_VERSION, fsName);
 		fsName = NULL;
 	}
 
@@ -852,9 +892,73 @@ remove_vnode_from_mount_list(struct vnode* vnode, struct fs_mount* mount)
 }
 
 
-/*!	\brief Looks up a vnode by mount and node ID in the sVnodeTable.
+/*!	Returns the shard that holds the vnode with the given mount and node ID.
+*/
+static inline vnode_shard&
+vnode_shard_for(dev_t mountID, ino_t vnodeID)
+{
+	// Use the upper bits of a multiplicative hash, so that the shard doesn't
+	// determine the bucket the node ends up in within the shard's table.
+	uint32 hash = ((uint32)(vnodeID >> 32) + (uint32)vnodeID)
+		^ (uint32)mountID;
+	return sVnodeShards[(hash * 0x9e3779b1) >> (32 - VNODE_SHARD_SHIFT)];
+}
+
+
+static inline rw_lock&
+vnode_shard_lock(dev_t mountID, ino_t vnodeID)
+{
+	return vnode_shard_for(mountID, vnodeID).lock;
+}
+
+
+static inline rw_lock&
+vnode_shard_lock(struct vnode* vnode)
+{
+	return vnode_shard_lock(vnode->device, vnode->id);
+}
+
+
+/*!	Write locks \c sVnodeLock and all vnode shards.
+*/
+static void
+write_lock_vnodes()
+{
+	rw_lock_write_lock(&sVnodeLock);
+	for (int32 i = 0; i < VNODE_SHARD_COUNT; i++)
+		rw_lock_write_lock(&sVnodeShards[i].lock);
+}
+
+
+static void
+write_unlock_vnodes()
+{
+	for (int32 i = VNODE_SHARD_COUNT - 1; i >= 0; i--)
+		rw_lock_write_unlock(&sVnodeShards[i].lock);
+	rw_lock_write_unlock(&sVnodeLock);
+}
+
+
+class VnodesWriteLocking {
+public:
+	inline bool Lock(rw_lock* lockable)
+	{
+		write_lock_vnodes();
+		return true;
+	}
+
+	inline void Unlock(rw_lock* lockable)
+	{
+		write_unlock_vnodes();
+	}
+};
+
+typedef AutoLocker<rw_lock, VnodesWriteLocking> VnodesWriteLocker;
+
 
-	The caller must hold the sVnodeLock (read lock at least).
+/*!	\brief Looks up a vnode by mount and node ID in the vnode table.
+
+	The caller must hold the lock of the vnode's shard (read lock at least).
 
 	\param mountID the mount ID.
 	\param vnodeID the node ID.
@@ -865,14 +969,15 @@ remove_vnode_from_mount_list(struct vnode* vnode, struct fs_mount* mount)
 static struct vnode*
 lookup_vnode(dev_t mountID, ino_t vnodeID)
 {
-	ASSERT_READ_LOCKED_RW_LOCK(&sVnodeLock);
+	vnode_shard& shard = vnode_shard_for(mountID, vnodeID);
+	ASSERT_READ_LOCKED_RW_LOCK(&shard.lock);
 
 	struct vnode_hash_key key;
 
 	key.device = mountID;
 	key.vnode = vnodeID;
 
-	return sVnodeTable->Lookup(key);
+	return shard.table->Lookup(key);
 }
 
 
@@ -900,8 +1005,8 @@ retry_busy_vnode(int32& tries, dev_t mountID, ino_t vnodeID)
 /*!	Creates a new vnode with the given mount and node ID.
 	If the node already exists, it is returned instead and no new node is
 	created. In either case -- but not, if an error occurs -- the function write
-	locks \c sVnodeLock and keeps it locked for the caller when returning. On
-	error the lock is not held on return.
+	locks the vnode's shard and keeps it locked for the caller when returning.
+	On error the lock is not held on return.
 
 	\param mountID The mount ID.
 	\param vnodeID The vnode ID.
@@ -932,7 +1037,8 @@ create_new_vnode_and_lock(dev_t mountID, ino_t vnodeID, struct vnode*& _vnode,
 
 	// look up the node -- it might have been added by someone else in the
 	// meantime
-	rw_lock_write_lock(&sVnodeLock);
+	vnode_shard& shard = vnode_shard_for(mountID, vnodeID);
+	rw_lock_write_lock(&shard.lock);
 	struct vnode* existingVnode = lookup_vnode(mountID, vnodeID);
 	if (existingVnode != NULL) {
 		object_cache_free(sVnodeCache, vnode, 0);
@@ -946,13 +1052,13 @@ create_new_vnode_and_lock(dev_t mountID, ino_t vnodeID, struct vnode*& _vnode,
 	vnode->mount = find_mount(mountID);
 	if (!vnode->mount || vnode->mount->unmounting) {
 		rw_lock_read_unlock(&sMountLock);
-		rw_lock_write_unlock(&sVnodeLock);
+		rw_lock_write_unlock(&shard.lock);
 		object_cache_free(sVnodeCache, vnode, 0);
 		return B_ENTRY_NOT_FOUND;
 	}
 
 	// add the vnode to the mount's node list and the hash table
-	sVnodeTable->Insert(vnode);
+	shard.table->Insert(vnode);
 	add_vnode_to_mount_list(vnode, vnode->mount);
 
 	rw_lock_read_unlock(&sMountLock);
@@ -960,7 +1066,7 @@ create_new_vnode_and_lock(dev_t mountID, ino_t vnodeID, struct vnode*& _vnode,
 	_vnode = vnode;
 	_nodeCreated = true;
 
-	// keep the vnode lock locked
+	// keep the shard locked
 	return B_OK;
 }
 
@@ -1012,8 +1118,11 @@ free_vnode(struct vnode* vnode, bool reenter)
 
 	// The file system has removed the resources of the vnode now, so we can
 	// make it available again (by removing the busy vnode from the hash).
+	vnode_shard& shard = vnode_shard_for(vnode->device, vnode->id);
 	rw_lock_write_lock(&sVnodeLock);
-	sVnodeTable->Remove(vnode);
+	rw_lock_write_lock(&shard.lock);
+	shard.table->Remove(vnode);
+	rw_lock_write_unlock(&shard.lock);
 	rw_lock_write_unlock(&sVnodeLock);
 
 	// if we have a VMCache attached, remove it
@@ -1045,7 +1154,18 @@ free_vnode(struct vnode* vnode, bool reenter)
 static status_t
 dec_vnode_ref_count(struct vnode* vnode, bool alwaysFree, bool reenter)
 {
-	ReadLocker locker(sVnodeLock);
+	// Only the transition to 0 needs to be synchronized with get_vnode(), so
+	// any other reference can be dropped without locking.
+	int32 count = atomic_get(&vnode->ref_count);
+	while (count > 1) {
+		int32 previous = atomic_test_and_set(&vnode->ref_count, count - 1,
+			count);
+		if (previous == count)
+			return B_OK;
+		count = previous;
+	}
+
+	ReadLocker locker(vnode_shard_lock(vnode));
 	AutoLocker<Vnode> nodeLocker(vnode);
 
 	int32 oldRefCount = atomic_add(&vnode->ref_count, -1);
@@ -1091,8 +1211,9 @@ dec_vnode_ref_count(struct vnode* vnode, bool alwaysFree, bool reenter)
 	is called. This can be done either:
 	- by ensuring that a reference to the node exists and remains in existence,
 	  or
-	- by holding the vnode's lock (which also requires read locking sVnodeLock)
-	  or by holding sVnodeLock write locked.
+	- by holding the vnode's lock (which also requires read locking the vnode's
+	  shard or sVnodeLock) or by holding all vnodes write locked (cf.
+	  write_lock_vnodes()).
 
 	In the second case the caller is responsible for dealing with the ref count
 	0 -> 1 transition. That is 1. this function must not be invoked when the
@@ -1110,6 +1231,36 @@ inc_vnode_ref_count(struct vnode* vnode)
 }
 
 
+/*!	\brief Increments the reference counter of the given vnode, unless it is
+	unused.
+
+	Unlike inc_vnode_ref_count() this function doesn't require the vnode to be
+	locked, since it never performs the 0 -> 1 transition.
+	The caller must hold the vnode's shard lock (read lock at least).
+
+	\param vnode the vnode.
+	\return \c true, if a reference has been acquired, \c false if the vnode
+		is unused or busy.
+*/
+static bool
+try_inc_vnode_ref_count(struct vnode* vnode)
+{
+	if (vnode->IsBusy())
+		return false;
+
+	int32 count = atomic_get(&vnode->ref_count);
+	while (count > 0) {
+		int32 previous = atomic_test_and_set(&vnode->ref_count, count + 1,
+			count);
+		if (previous == count)
+			return true;
+		count = previous;
+	}
+
+	return false;
+}
+
+
 static bool
 is_special_node_type(int type)
 {
@@ -1149,11 +1300,20 @@ get_vnode(dev_t mountID, ino_t vnodeID, struct vnode** _vnode, bool canWait,
 	FUNCTION(("get_vnode: mountid %" B_PRId32 " vnid 0x%" B_PRIx64 " %p\n",
 		mountID, vnodeID, _vnode));
 
-	rw_lock_read_lock(&sVnodeLock);
+	vnode_shard& shard = vnode_shard_for(mountID, vnodeID);
+	rw_lock_read_lock(&shard.lock);
 
 	int32 tries = BUSY_VNODE_RETRIES;
 restart:
 	struct vnode* vnode = lookup_vnode(mountID, vnodeID);
+
+	// fast path: the vnode is in use already, no need to lock it
+	if (vnode != NULL && try_inc_vnode_ref_count(vnode)) {
+		rw_lock_read_unlock(&shard.lock);
+		*_vnode = vnode;
+		return B_OK;
+	}
+
 	AutoLocker<Vnode> nodeLocker(vnode);
 
 	if (vnode && vnode->IsBusy()) {
@@ -1162,7 +1322,7 @@ restart:
 		const bool doNotWait = vnode->IsRemoved() && !vnode->IsUnpublished();
 
 		nodeLocker.Unlock();
-		rw_lock_read_unlock(&sVnodeLock);
+		rw_lock_read_unlock(&shard.lock);
 		if (!canWait) {
 			dprintf("vnode %" B_PRIdDEV ":%" B_PRIdINO " is busy!\n",
 				mountID, vnodeID);
@@ -1171,7 +1331,7 @@ restart:
 		if (doNotWait || !retry_busy_vnode(tries, mountID, vnodeID))
 			return B_BUSY;
 
-		rw_lock_read_lock(&sVnodeLock);
+		rw_lock_read_lock(&shard.lock);
 		goto restart;
 	}
 
@@ -1187,10 +1347,10 @@ restart:
 		inc_vnode_ref_count(vnode);
 
 		nodeLocker.Unlock();
-		rw_lock_read_unlock(&sVnodeLock);
+		rw_lock_read_unlock(&shard.lock);
 	} else {
 		// we need to create a new vnode and read it in
-		rw_lock_read_unlock(&sVnodeLock);
+		rw_lock_read_unlock(&shard.lock);
 			// unlock -- create_new_vnode_and_lock() write-locks on success
 		bool nodeCreated;
 		status = create_new_vnode_and_lock(mountID, vnodeID, vnode,
@@ -1199,12 +1359,12 @@ restart:
 			return status;
 
 		if (!nodeCreated) {
-			rw_lock_read_lock(&sVnodeLock);
-			rw_lock_write_unlock(&sVnodeLock);
+			rw_lock_read_lock(&shard.lock);
+			rw_lock_write_unlock(&shard.lock);
 			goto restart;
 		}
 
-		rw_lock_write_unlock(&sVnodeLock);
+		rw_lock_write_unlock(&shard.lock);
 
 		int type;
 		uint32 flags;
@@ -1229,22 +1389,24 @@ restart:
 				FS_CALL(vnode, put_vnode, reenter);
 
 			rw_lock_write_lock(&sVnodeLock);
-			sVnodeTable->Remove(vnode);
+			rw_lock_write_lock(&shard.lock);
+			shard.table->Remove(vnode);
 			remove_vnode_from_mount_list(vnode, vnode->mount);
+			rw_lock_write_unlock(&shard.lock);
 			rw_lock_write_unlock(&sVnodeLock);
 
 			object_cache_free(sVnodeCache, vnode, 0);
 			return status;
 		}
 
-		rw_lock_read_lock(&sVnodeLock);
+		rw_lock_read_lock(&shard.lock);
 		vnode->Lock();
 
 		vnode->SetRemoved((flags & B_VNODE_PUBLISH_REMOVED) != 0);
 		vnode->SetBusy(false);
 
 		vnode->Unlock();
-		rw_lock_read_unlock(&sVnodeLock);
+		rw_lock_read_unlock(&shard.lock);
 	}
 
 	TRACE(("get_vnode: returning %p\n", vnode));
@@ -1485,14 +1647,15 @@ put_advisory_locking(struct advisory_locking* locking)
 static struct advisory_locking*
 get_advisory_locking(struct vnode* vnode)
 {
-	rw_lock_read_lock(&sVnodeLock);
+	rw_lock& shardLock = vnode_shard_lock(vnode);
+	rw_lock_read_lock(&shardLock);
 	vnode->Lock();
 
 	struct advisory_locking* locking = vnode->advisory_locking;
 	sem_id lock = locking != NULL ? locking->lock : B_ERROR;
 
 	vnode->Unlock();
-	rw_lock_read_unlock(&sVnodeLock);
+	rw_lock_read_unlock(&shardLock);
 
 	if (lock >= 0)
 		lock = acquire_sem(lock);
@@ -1540,7 +1703,7 @@ create_advisory_locking(struct vnode* vnode)
 		}
 
 		// set our newly created locking object
-		ReadLocker _(sVnodeLock);
+		ReadLocker _(vnode_shard_lock(vnode));
 		AutoLocker<Vnode> nodeLocker(vnode);
 		if (vnode->advisory_locking == NULL) {
 			vnode->advisory_locking = locking;
@@ -1688,7 +1851,7 @@ release_advisory_lock(struct vnode* vnode, struct io_context* context,
 		// longer used
 		locking = get_advisory_locking(vnode);
 		if (locking != NULL) {
-			ReadLocker locker(sVnodeLock);
+			ReadLocker locker(vnode_shard_lock(vnode));
 			AutoLocker<Vnode> nodeLocker(vnode);
 
 			// the locking could have been changed in the mean time
@@ -2088,9 +2251,10 @@ lookup_dir_entry(struct vnode* dir, const char* name, struct vnode** _vnode)
 
 	// The lookup() hook calls get_vnode() or publish_vnode(), so we do already
 	// have a reference and just need to look the node up.
-	rw_lock_read_lock(&sVnodeLock);
+	rw_lock& shardLock = vnode_shard_lock(dir->device, id);
+	rw_lock_read_lock(&shardLock);
 	*_vnode = lookup_vnode(dir->device, id);
-	rw_lock_read_unlock(&sVnodeLock);
+	rw_lock_read_unlock(&shardLock);
 
 	if (*_vnode == NULL) {
 		panic("lookup_dir_entry(): could not lookup vnode (mountid 0x%" B_PRIx32
@@ -3261,13 +3425,15 @@ dump_vnode(int argc, char** argv)
 	dev_t device = parse_expression(argv[argi]);
 	ino_t id = parse_expression(argv[argi + 1]);
 
-	VnodeTable::Iterator iterator(sVnodeTable);
-	while (iterator.HasNext()) {
-		vnode = iterator.Next();
-		if (vnode->id != id || vnode->device != device)
-			continue;
+	for (int32 i = 0; i < VNODE_SHARD_COUNT; i++) {
+		VnodeTable::Iterator iterator(sVnodeShards[i].table);
+		while (iterator.HasNext()) {
+			vnode = iterator.Next();
+			if (vnode->id != id || vnode->device != device)
+				continue;
 
-		_dump_vnode(vnode, printPath);
+			_dump_vnode(vnode, printPath);
+		}
 	}
 
 	return 0;
@@ -3291,17 +3457,19 @@ dump_vnodes(int argc, char** argv)
 		B_PRINTF_POINTER_WIDTH, "address", B_PRINTF_POINTER_WIDTH, "cache",
 		B_PRINTF_POINTER_WIDTH, "fs-node", B_PRINTF_POINTER_WIDTH, "locking");
 
-	VnodeTable::Iterator iterator(sVnodeTable);
-	while (iterator.HasNext()) {
-		vnode = iterator.Next();
-		if (vnode->device != device)
-			continue;
+	for (int32 i = 0; i < VNODE_SHARD_COUNT; i++) {
+		VnodeTable::Iterator iterator(sVnodeShards[i].table);
+		while (iterator.HasNext()) {
+			vnode = iterator.Next();
+			if (vnode->device != device)
+				continue;
 
-		kprintf("%p%4" B_PRIdDEV "%10" B_PRIdINO "%5" B_PRId32 " %p %p %p %s%s%s\n",
-			vnode, vnode->device, vnode->id, vnode->ref_count, vnode->cache,
-			vnode->private_node, vnode->advisory_locking,
-			vnode->IsRemoved() ? "r" : "-", vnode->IsBusy() ? "b" : "-",
-			vnode->IsUnpublished() ? "u" : "-");
+			kprintf("%p%4" B_PRIdDEV "%10" B_PRIdINO "%5" B_PRId32 " %p %p %p %s%s%s\n",
+				vnode, vnode->device, vnode->id, vnode->ref_count, vnode->cache,
+				vnode->private_node, vnode->advisory_locking,
+				vnode->IsRemoved() ? "r" : "-", vnode->IsBusy() ? "b" : "-",
+				vnode->IsUnpublished() ? "u" : "-");
+		}
 	}
 
 	return 0;
@@ -3326,18 +3494,20 @@ dump_vnode_caches(int argc, char** argv)
 	kprintf("%-*s   dev     inode %-*s       size   pages\n",
 		B_PRINTF_POINTER_WIDTH, "address", B_PRINTF_POINTER_WIDTH, "cache");
 
-	VnodeTable::Iterator iterator(sVnodeTable);
-	while (iterator.HasNext()) {
-		vnode = iterator.Next();
-		if (vnode->cache == NULL)
-			continue;
-		if (device != -1 && vnode->device != device)
-			continue;
+	for (int32 i = 0; i < VNODE_SHARD_COUNT; i++) {
+		VnodeTable::Iterator iterator(sVnodeShards[i].table);
+		while (iterator.HasNext()) {
+			vnode = iterator.Next();
+			if (vnode->cache == NULL)
+				continue;
+			if (device != -1 && vnode->device != device)
+				continue;
 
-		kprintf("%p%4" B_PRIdDEV "%10" B_PRIdINO " %p %8" B_PRIdOFF "%8" B_PRId32 "\n",
-			vnode, vnode->device, vnode->id, vnode->cache,
-			(vnode->cache->virtual_end + B_PAGE_SIZE - 1) / B_PAGE_SIZE,
-			vnode->cache->page_count);
+			kprintf("%p%4" B_PRIdDEV "%10" B_PRIdINO " %p %8" B_PRIdOFF "%8" B_PRId32 "\n",
+				vnode, vnode->device, vnode->id, vnode->cache,
+				(vnode->cache->virtual_end + B_PAGE_SIZE - 1) / B_PAGE_SIZE,
+				vnode->cache->page_count);
+		}
 	}
 
 	return 0;
@@ -3414,7 +3584,9 @@ dump_vnode_usage(int argc, char** argv)
 	kprintf("Unused vnodes: %" B_PRIu32 " (max unused %" B_PRIu32 ")\n",
 		sUnusedVnodes, kMaxUnusedVnodes);
 
-	uint32 count = sVnodeTable->CountElements();
+	uint32 count = 0;
+	for (int32 i = 0; i < VNODE_SHARD_COUNT; i++)
+		count += sVnodeShards[i].table->CountElements();
 
 	kprintf("%" B_PRIu32 " vnodes total (%" B_PRIu32 " in use).\n", count,
 		count - sUnusedVnodes);
@@ -3696,7 +3868,7 @@ restart:
 	if (status != B_OK)
 		return status;
 
-	WriteLocker nodeLocker(sVnodeLock, true);
+	WriteLocker nodeLocker(vnode_shard_lock(volume->id, vnodeID), true);
 		// create_new_vnode_and_lock() has locked for us
 
 	if (!nodeCreated && vnode->IsBusy()) {
@@ -3732,8 +3904,9 @@ publish_vnode(fs_volume* volume, ino_t vnodeID, void* privateNode,
 	FUNCTION(("publish_vnode()\n"));
 
 	int32 tries = BUSY_VNODE_RETRIES;
+	vnode_shard& shard = vnode_shard_for(volume->id, vnodeID);
 restart:
-	WriteLocker locker(sVnodeLock);
+	WriteLocker locker(shard.lock);
 
 	struct vnode* vnode = lookup_vnode(volume->id, vnodeID);
 
@@ -3750,7 +3923,7 @@ restart:
 		if (status != B_OK)
 			return status;
 
-		locker.SetTo(sVnodeLock, true);
+		locker.SetTo(shard.lock, true);
 	}
 
 	if (nodeCreated) {
@@ -3802,14 +3975,18 @@ restart:
 		}
 
 		if (status == B_OK) {
-			ReadLocker vnodesReadLocker(sVnodeLock);
+			ReadLocker shardReadLocker(shard.lock);
 			AutoLocker<Vnode> nodeLocker(vnode);
 			vnode->SetBusy(false);
 			vnode->SetUnpublished(false);
 		} else {
+			WriteLocker vnodesWriteLocker(sVnodeLock);
 			locker.Lock();
-			sVnodeTable->Remove(vnode);
+			shard.table->Remove(vnode);
 			remove_vnode_from_mount_list(vnode, vnode->mount);
+			locker.Unlock();
+			vnodesWriteLocker.Unlock();
+
 			object_cache_free(sVnodeCache, vnode, 0);
 		}
 	} else {
@@ -3861,7 +4038,7 @@ get_vnode(fs_volume* volume, ino_t vnodeID, void** _privateNode)
 extern "C" status_t
 acquire_vnode(fs_volume* volume, ino_t vnodeID)
 {
-	ReadLocker nodeLocker(sVnodeLock);
+	ReadLocker nodeLocker(vnode_shard_lock(volume->id, vnodeID));
 
 	struct vnode* vnode = lookup_vnode(volume->id, vnodeID);
 	if (vnode == NULL)
@@ -3875,11 +4052,10 @@ acquire_vnode(fs_volume* volume, ino_t vnodeID)
 extern "C" status_t
 put_vnode(fs_volume* volume, ino_t vnodeID)
 {
-	struct vnode* vnode;
-
-	rw_lock_read_lock(&sVnodeLock);
-	vnode = lookup_vnode(volume->id, vnodeID);
-	rw_lock_read_unlock(&sVnodeLock);
+	rw_lock& shardLock = vnode_shard_lock(volume->id, vnodeID);
+	rw_lock_read_lock(&shardLock);
+	struct vnode* vnode = lookup_vnode(volume->id, vnodeID);
+	rw_lock_read_unlock(&shardLock);
 
 	if (vnode == NULL)
 		return B_BAD_VALUE;
@@ -3892,7 +4068,7 @@ put_vnode(fs_volume* volume, ino_t vnodeID)
 extern "C" status_t
 remove_vnode(fs_volume* volume, ino_t vnodeID)
 {
-	ReadLocker locker(sVnodeLock);
+	ReadLocker locker(vnode_shard_lock(volume->id, vnodeID));
 
 	struct vnode* vnode = lookup_vnode(volume->id, vnodeID);
 	if (vnode == NULL)
@@ -3930,17 +4106,13 @@ remove_vnode(fs_volume* volume, ino_t vnodeID)
 extern "C" status_t
 unremove_vnode(fs_volume* volume, ino_t vnodeID)
 {
-	struct vnode* vnode;
+	ReadLocker _(vnode_shard_lock(volume->id, vnodeID));
 
-	rw_lock_read_lock(&sVnodeLock);
-
-	vnode = lookup_vnode(volume->id, vnodeID);
-	if (vnode) {
+	if (struct vnode* vnode = lookup_vnode(volume->id, vnodeID)) {
 		AutoLocker<Vnode> nodeLocker(vnode);
 		vnode->SetRemoved(false);
 	}
 
-	rw_lock_read_unlock(&sVnodeLock);
 	return B_OK;
 }
 
@@ -3948,7 +4120,7 @@ unremove_vnode(fs_volume* volume, ino_t vnodeID)
 extern "C" status_t
 get_vnode_removed(fs_volume* volume, ino_t vnodeID, bool* _removed)
 {
-	ReadLocker _(sVnodeLock);
+	ReadLocker _(vnode_shard_lock(volume->id, vnodeID));
 
 	if (struct vnode* vnode = lookup_vnode(volume->id, vnodeID)) {
 		if (_removed != NULL)
@@ -4262,9 +4434,10 @@ vfs_open_vnode(struct vnode* vnode, int openMode, bool kernel)
 extern "C" status_t
 vfs_lookup_vnode(dev_t mountID, ino_t vnodeID, struct vnode** _vnode)
 {
-	rw_lock_read_lock(&sVnodeLock);
+	rw_lock& shardLock = vnode_shard_lock(mountID, vnodeID);
+	rw_lock_read_lock(&shardLock);
 	struct vnode* vnode = lookup_vnode(mountID, vnodeID);
-	rw_lock_read_unlock(&sVnodeLock);
+	rw_lock_read_unlock(&shardLock);
 
 	if (vnode == NULL)
 		return B_ERROR;
@@ -4550,9 +4723,10 @@ vfs_create_special_node(const char* path, fs_vnode* subVnode, mode_t mode,
 		return status;
 
 	// lookup the node
-	rw_lock_read_lock(&sVnodeLock);
+	rw_lock& shardLock = vnode_shard_lock(dirNode->mount->id, nodeID);
+	rw_lock_read_lock(&shardLock);
 	*_createdVnode = lookup_vnode(dirNode->mount->id, nodeID);
-	rw_lock_read_unlock(&sVnodeLock);
+	rw_lock_read_unlock(&shardLock);
 
 	if (*_createdVnode == NULL) {
 		panic("vfs_create_special_node(): lookup of node failed");
@@ -4703,7 +4877,8 @@ vfs_get_vnode_cache(struct vnode* vnode, VMCache** _cache, bool allocate)
 		return B_OK;
 	}
 
-	rw_lock_read_lock(&sVnodeLock);
+	rw_lock& shardLock = vnode_shard_lock(vnode);
+	rw_lock_read_lock(&shardLock);
 	vnode->Lock();
 
 	status_t status = B_OK;
@@ -4717,11 +4892,11 @@ vfs_get_vnode_cache(struct vnode* vnode, VMCache** _cache, bool allocate)
 			vnode->SetBusy(true);
 
 			vnode->Unlock();
-			rw_lock_read_unlock(&sVnodeLock);
+			rw_lock_read_unlock(&shardLock);
 
 			status = vm_create_vnode_cache(vnode, &vnode->cache);
 
-			rw_lock_read_lock(&sVnodeLock);
+			rw_lock_read_lock(&shardLock);
 			vnode->Lock();
 			vnode->SetBusy(wasBusy);
 		} else
@@ -4729,7 +4904,7 @@ vfs_get_vnode_cache(struct vnode* vnode, VMCache** _cache, bool allocate)
 	}
 
 	vnode->Unlock();
-	rw_lock_read_unlock(&sVnodeLock);
+	rw_lock_read_unlock(&shardLock);
 
 	if (status == B_OK) {
 		vnode->cache->AcquireRef();
@@ -4748,7 +4923,8 @@ vfs_get_vnode_cache(struct vnode* vnode, VMCache** _cache, bool allocate)
 extern "C" status_t
 vfs_set_vnode_cache(struct vnode* vnode, VMCache* _cache)
 {
-	rw_lock_read_lock(&sVnodeLock);
+	rw_lock& shardLock = vnode_shard_lock(vnode);
+	rw_lock_read_lock(&shardLock);
 	vnode->Lock();
 
 	status_t status = B_OK;
@@ -4760,7 +4936,7 @@ vfs_set_vnode_cache(struct vnode* vnode, VMCache* _cache)
 	}
 
 	vnode->Unlock();
-	rw_lock_read_unlock(&sVnodeLock);
+	rw_lock_read_unlock(&shardLock);
 	return status;
 }
 
@@ -5184,7 +5360,7 @@ vfs_bind_mount_directory(dev_t mountID, ino_t nodeID, dev_t coveredMountID,
 	VnodePutter coveredVnodePutter(coveredVnode);
 
 	// establish the covered/covering links
-	WriteLocker locker(sVnodeLock);
+	VnodesWriteLocker locker(sVnodeLock);
 
 	if (vnode->covers != NULL || coveredVnode->covered_by != NULL
 		|| vnode->mount->unmounting || coveredVnode->mount->unmounting) {
@@ -5274,9 +5450,18 @@ vfs_init(kernel_args* args)
 {
 	vnode::StaticInit();
 
-	sVnodeTable = new(std::nothrow) VnodeTable();
-	if (sVnodeTable == NULL || sVnodeTable->Init(VNODE_HASH_TABLE_SIZE) != B_OK)
-		panic("vfs_init: error creating vnode hash table\n");
+	for (int32 i = 0; i < VNODE_SHARD_COUNT; i++) {
+		vnode_shard& shard = sVnodeShards[i];
+		rw_lock_init(&shard.lock, "vnode shard");
+		shard.table = new(std::nothrow) VnodeTable();
+		if (shard.table == NULL
+			|| shard.table->Init(VNODE_HASH_TABLE_SIZE) != B_OK) {
+			panic("vfs_init: error creating vnode hash table\n");
+		}
+	}
+
+	if (init_hot_vnodes() != B_OK)
+		panic("vfs_init: error creating hot vnode arrays\n");
 
 	struct vnode dummy_vnode;
 	list_init_etc(&sUnusedVnodeList, offset_of_member(dummy_vnode, unused_link));
@@ -5466,9 +5651,10 @@ create_vnode(struct vnode* directory, const char* name, int openMode,
 
 	// the node has been created successfully
 
-	rw_lock_read_lock(&sVnodeLock);
+	rw_lock& shardLock = vnode_shard_lock(directory->device, newID);
+	rw_lock_read_lock(&shardLock);
 	vnode.SetTo(lookup_vnode(directory->device, newID));
-	rw_lock_read_unlock(&sVnodeLock);
+	rw_lock_read_unlock(&shardLock);
 
 	if (!vnode.IsSet()) {
 		panic("vfs: fs_create() returned success but there is no vnode, "
@@ -5686,6 +5872,7 @@ file_free_fd(struct file_descriptor* descriptor)
 	struct vnode* vnode = descriptor->u.vnode;
 
 	if (vnode != NULL) {
+		cache_node_cookie_freed(vnode->cache, descriptor->cookie);
 		FS_CALL(vnode, free_cookie, descriptor->cookie);
 		put_vnode(vnode);
 	}
@@ -5725,6 +5912,9 @@ file_write(struct file_descriptor* descriptor, off_t pos, const void* buffer,
 	if (!HAS_FS_CALL(vnode, write))
 		return B_READ_ONLY_DEVICE;
 
+	// throttle heavy writers while they don't hold any file system locks
+	cache_balance_dirty_pages(vnode->cache);
+
 	return FS_CALL(vnode, write, descriptor->cookie, pos, buffer, length);
 }
 
@@ -6035,7 +6225,7 @@ fix_dirent(struct vnode* parent, struct dirent* entry,
 	}
 
 	// resolve covered vnodes
-	ReadLocker _(&sVnodeLock);
+	ReadLocker _(vnode_shard_lock(entry->d_dev, entry->d_ino));
 
 	struct vnode* vnode = lookup_vnode(entry->d_dev, entry->d_ino);
 	if (vnode != NULL && vnode->covered_by != NULL) {
@@ -6077,6 +6267,122 @@ dir_read(struct io_context* ioContext, struct vnode* vnode, void* cookie,
 }
 
 
+/*!	Stats the node referred to by \a entry the generic way, and reads the
+	first \a attributeSize bytes of its \a attribute, if given.
+	If the node cannot be stat()ed, \a stat is cleared; a missing attribute
+	leaves the attribute buffer cleared.
+*/
+static void
+stat_dir_entry(const struct dirent* entry, struct stat* stat,
+	const char* attribute, void* attributeBuffer, size_t attributeSize)
+{
+	memset(stat, 0, sizeof(struct stat));
+	if (attribute != NULL)
+		memset(attributeBuffer, 0, attributeSize);
+
+	struct vnode* vnode;
+	if (get_vnode(entry->d_dev, entry->d_ino, &vnode, true, false) != B_OK)
+		return;
+	VnodePutter vnodePutter(vnode);
+
+	if (vfs_stat_vnode(vnode, stat) != B_OK) {
+		memset(stat, 0, sizeof(struct stat));
+		return;
+	}
+
+	if (attribute == NULL || !HAS_FS_CALL(vnode, open_attr)
+		|| !HAS_FS_CALL(vnode, read_attr)) {
+		return;
+	}
+
+	void* cookie;
+	if (FS_CALL(vnode, open_attr, attribute, O_RDONLY, &cookie) != B_OK)
+		return;
+
+	size_t length = attributeSize;
+	if (FS_CALL(vnode, read_attr, cookie, 0, attributeBuffer, &length) != B_OK)
+		memset(attributeBuffer, 0, attributeSize);
+
+	if (HAS_FS_CALL(vnode, close_attr))
+		FS_CALL(vnode, close_attr, cookie);
+	FS_CALL(vnode, free_attr_cookie, cookie);
+}
+
+
+/*!	Reads directory entries like dir_read(), and in addition fills in one
+	stat structure per entry into \a stats, and, if \a attribute is given,
+	the first \a attributeSize bytes of that attribute of each entry into
+	consecutive slots of \a attributeBuffer.
+	The file system's read_dir_stat() hook is used when available; entries it
+	could not handle, and all entries of file systems without the hook, are
+	stat()ed one by one. Entries that cannot be stat()ed get a cleared stat
+	structure (i.e. an \c st_mode of 0).
+	Like a lookup, this requires search permission on the directory; without
+	it, only the entries are read, and all stat structures stay cleared.
+*/
+static status_t
+dir_read_stat(struct io_context* ioContext, struct vnode* vnode, void* cookie,
+	struct dirent* buffer, size_t bufferSize, struct stat* stats,
+	const char* attribute, uint8* attributeBuffer, size_t attributeSize,
+	uint32* _count)
+{
+	uint32 count = *_count;
+	memset(stats, 0, sizeof(struct stat) * count);
+	if (attribute != NULL)
+		memset(attributeBuffer, 0, attributeSize * count);
+
+	bool searchable = !HAS_FS_CALL(vnode, access)
+		|| FS_CALL(vnode, access, X_OK) == B_OK;
+
+	bool filled = false;
+	status_t error = B_UNSUPPORTED;
+	if (searchable && HAS_FS_CALL(vnode, read_dir_stat)) {
+		error = FS_CALL(vnode, read_dir_stat, cookie, buffer, bufferSize,
+			stats, attribute, attributeBuffer, attributeSize, &count);
+		filled = error == B_OK;
+	}
+
+	if (error == B_UNSUPPORTED) {
+		if (!HAS_FS_CALL(vnode, read_dir))
+			return B_UNSUPPORTED;
+
+		count = *_count;
+		error = FS_CALL(vnode, read_dir, cookie, buffer, bufferSize, &count);
+	}
+	if (error != B_OK)
+		return error;
+
+	struct dirent* entry = buffer;
+	for (uint32 i = 0; i < count; i++) {
+		dev_t device = entry->d_dev;
+		ino_t id = entry->d_ino;
+
+		error = fix_dirent(vnode, entry, ioContext);
+		if (error != B_OK)
+			return error;
+
+		if (!searchable) {
+			// leave the stat data cleared
+		} else if (!filled || entry->d_dev != device || entry->d_ino != id) {
+			// the file system didn't fill in the entry, or it refers to
+			// another node now (mount point or covered parent)
+			stat_dir_entry(entry, &stats[i], attribute,
+				attributeBuffer + i * attributeSize, attributeSize);
+		} else if (stats[i].st_mode != 0) {
+			stats[i].st_dev = device;
+			stats[i].st_ino = id;
+			if (!S_ISBLK(stats[i].st_mode) && !S_ISCHR(stats[i].st_mode))
+				stats[i].st_rdev = -1;
+		}
+
+		entry = (struct dirent*)((uint8*)entry + entry->d_reclen);
+	}
+
+	*_count = count;
+	return B_OK;
+}
+
+
 static status_t
 dir_rewind(struct file_descriptor* descriptor)
 {
@@ -6090,6 +6396,31 @@ dir_rewind(struct file_descriptor* descriptor)
 }
 
 
+static ssize_t
+dir_read_stat(int fd, struct dirent* buffer, size_t bufferSize,
+	struct stat* stats, const char* attribute, uint8* attributeBuffer,
+	size_t attributeSize, uint32 maxCount, bool kernel)
+{
+	io_context* ioContext = get_current_io_context(kernel);
+	FileDescriptorPutter descriptor(get_fd(ioContext, fd));
+	if (!descriptor.IsSet())
+		return B_FILE_ERROR;
+
+	if (descriptor->type != FDTYPE_DIR)
+		return B_NOT_A_DIRECTORY;
+
+	uint32 count = maxCount;
+	status_t status = dir_read_stat(ioContext, descriptor->u.vnode,
+		descriptor->cookie, buffer, bufferSize, stats, attribute,
+		attributeBuffer, attributeSize, &count);
+	if (status != B_OK)
+		return status;
+
+	ASSERT(count <= maxCount);
+	return count;
+}
+
+
 static status_t
 dir_remove(int fd, char* path, bool kernel)
 {
@@ -6431,6 +6762,52 @@ common_preallocate(int fd, off_t offset, off_t length, bool kernel)
 }
 
 
+static status_t
+common_fadvise(int fd, off_t offset, off_t length, int advice, bool kernel)
+{
+	if (offset < 0 || length < 0)
+		return B_BAD_VALUE;
+
+	switch (advice) {
+		case POSIX_FADV_NORMAL:
+		case POSIX_FADV_SEQUENTIAL:
+		case POSIX_FADV_RANDOM:
+		case POSIX_FADV_WILLNEED:
+		case POSIX_FADV_DONTNEED:
+		case POSIX_FADV_NOREUSE:
+			break;
+
+		default:
+			return B_BAD_VALUE;
+	}
+
+	struct vnode* vnode;
+	FileDescriptorPutter descriptor(get_fd_and_vnode(fd, &vnode, kernel));
+	if (!descriptor.IsSet())
+		return B_FILE_ERROR;
+
+	switch (vnode->Type() & S_IFMT) {
+		case S_IFIFO:
+		case S_IFSOCK:
+			return ESPIPE;
+
+		case S_IFREG:
+			break;
+
+		default:
+			// nothing to do
+			return B_OK;
+	}
+
+	// only files have a file system cookie the file cache knows about
+	if (descriptor->type != FDTYPE_FILE)
+		return B_OK;
+
+	return cache_advise_vnode(vnode, descriptor->cookie, offset, length,
+		advice);
+}
+
+
 static status_t
 common_read_link(int fd, char* path, char* buffer, size_t* _bufferSize,
 	bool kernel)
@@ -7023,6 +7400,100 @@ attr_rename(int fromFD, const char* fromName, int toFD, const char* toName,
 }
 
 
+/*!	Reads all attributes described by \a vecs from the node \a fd refers to.
+	The result of each read is stored in the vec's \c status, the number of
+	bytes read in its \c length field.
+	File systems may implement the read_attrs() hook to do this in one go,
+	otherwise the attributes are opened and read one by one.
+*/
+static status_t
+attr_read_vecs(int fd, attr_io_vec* vecs, size_t count, bool kernel)
+{
+	VnodePutter vnode;
+	status_t status = fd_and_path_to_vnode(fd, NULL, false, vnode, NULL,
+		kernel);
+	if (status != B_OK)
+		return status;
+
+	if (HAS_FS_CALL(vnode, read_attrs)) {
+		status = FS_CALL(vnode.Get(), read_attrs, vecs, count);
+		if (status != B_UNSUPPORTED)
+			return status;
+	}
+
+	if (!HAS_FS_CALL(vnode, open_attr) || !HAS_FS_CALL(vnode, read_attr))
+		return B_UNSUPPORTED;
+
+	for (size_t i = 0; i < count; i++) {
+		attr_io_vec& vec = vecs[i];
+
+		void* cookie;
+		vec.status = FS_CALL(vnode.Get(), open_attr, vec.name, O_RDONLY,
+			&cookie);
+		if (vec.status == B_OK) {
+			vec.status = FS_CALL(vnode.Get(), read_attr, cookie, 0, vec.buffer,
+				&vec.length);
+
+			if (HAS_FS_CALL(vnode, close_attr))
+				FS_CALL(vnode.Get(), close_attr, cookie);
+			FS_CALL(vnode.Get(), free_attr_cookie, cookie);
+		}
+		if (vec.status != B_OK)
+			vec.length = 0;
+	}
+
+	return B_OK;
+}
+
+
+/*!	Writes all attributes described by \a vecs to the node \a fd refers to.
+	Like fs_write_attr() at position 0, any previous contents of the
+	attributes are replaced. The result of each write is stored in the vec's
+	\c status, the number of bytes written in its \c length field.
+	If the file system implements the write_attrs() hook, all attributes are
+	written in a single transaction, and a failure means that none of them
+	has been changed.
+*/
+static status_t
+attr_write_vecs(int fd, attr_io_vec* vecs, size_t count, bool kernel)
+{
+	VnodePutter vnode;
+	status_t status = fd_and_path_to_vnode(fd, NULL, false, vnode, NULL,
+		kernel);
+	if (status != B_OK)
+		return status;
+
+	if (HAS_FS_CALL(vnode, write_attrs)) {
+		status = FS_CALL(vnode.Get(), write_attrs, vecs, count);
+		if (status != B_UNSUPPORTED)
+			return status;
+	}
+
+	if (!HAS_FS_CALL(vnode, create_attr) || !HAS_FS_CALL(vnode, write_attr))
+		return B_READ_ONLY_DEVICE;
+
+	for (size_t i = 0; i < count; i++) {
+		attr_io_vec& vec = vecs[i];
+
+		void* cookie;
+		vec.status = FS_CALL(vnode.Get(), create_attr, vec.name, vec.type,
+			O_CREAT | O_WRONLY | O_TRUNC, &cookie);
+		if (vec.status == B_OK) {
+			vec.status = FS_CALL(vnode.Get(), write_attr, cookie, 0,
+				vec.buffer, &vec.length);
+
+			if (HAS_FS_CALL(vnode, close_attr))
+				FS_CALL(vnode.Get(), close_attr, cookie);
+			FS_CALL(vnode.Get(), free_attr_cookie, cookie);
+		}
+		if (vec.status != B_OK)
+			vec.length = 0;
+	}
+
+	return B_OK;
+}
+
+
 static int
 index_dir_open(dev_t mountID, bool kernel)
 {
@@ -7585,12 +8056,12 @@ fs_mount(char* path, const char* device, const char* fsName, uint32 flags,
 
 	// the root node is supposed to be owned by the file system - it must
 	// exist at this point
-	rw_lock_write_lock(&sVnodeLock);
+	write_lock_vnodes();
 	mount->root_vnode = lookup_vnode(mount->id, rootID);
 	if (mount->root_vnode == NULL || mount->root_vnode->ref_count != 1) {
 		panic("fs_mount: file system does not own its root node!\n");
 		status = B_ERROR;
-		rw_lock_write_unlock(&sVnodeLock);
+		write_unlock_vnodes();
 		goto err4;
 	}
 
@@ -7599,7 +8070,7 @@ fs_mount(char* path, const char* device, const char* fsName, uint32 flags,
 		if (coveredNode->IsCovered()) {
 			// the vnode is covered now
 			status = B_BUSY;
-			rw_lock_write_unlock(&sVnodeLock);
+			write_unlock_vnodes();
 			goto err4;
 		}
 
@@ -7609,7 +8080,7 @@ fs_mount(char* path, const char* device, const char* fsName, uint32 flags,
 		coveredNode->covered_by = mount->root_vnode;
 		coveredNode->SetCovered(true);
 	}
-	rw_lock_write_unlock(&sVnodeLock);
+	write_unlock_vnodes();
 
 	if (!sRoot) {
 		sRoot = mount->root_vnode;
@@ -7717,7 +8188,7 @@ fs_unmount(char* path, dev_t mountID, uint32 flags, bool kernel)
 
 	// grab the vnode master mutex to keep someone from creating
 	// a vnode while we're figuring out if we can continue
-	WriteLocker vnodesWriteLocker(&sVnodeLock);
+	VnodesWriteLocker vnodesWriteLocker(&sVnodeLock);
 
 	bool disconnectedDescriptors = false;
 
@@ -7797,7 +8268,7 @@ fs_unmount(char* path, dev_t mountID, uint32 flags, bool kernel)
 				// from the chain.
 				coveredNode->covered_by = coveringNode;
 				coveringNode->covers = coveredNode;
-				vnode->ref_count -= 2;
+				atomic_add(&vnode->ref_count, -2);
 
 				vnode->covered_by = NULL;
 				vnode->covers = NULL;
@@ -7807,28 +8278,28 @@ fs_unmount(char* path, dev_t mountID, uint32 flags, bool kernel)
 				// We only have a covered vnode. Remove its link to us.
 				coveredNode->covered_by = NULL;
 				coveredNode->SetCovered(false);
-				vnode->ref_count--;
+				atomic_add(&vnode->ref_count, -1);
 
 				// If the other node is an external vnode, we keep its link
 				// link around so we can put the reference later on. Otherwise
 				// we get rid of it right now.
 				if (coveredNode->mount == mount) {
 					vnode->covers = NULL;
-					coveredNode->ref_count--;
+					atomic_add(&coveredNode->ref_count, -1);
 				}
 			}
 		} else if (Vnode* coveringNode = vnode->covered_by) {
 			// We only have a covering vnode. Remove its link to us.
 			coveringNode->covers = NULL;
 			coveringNode->SetCovering(false);
-			vnode->ref_count--;
+			atomic_add(&vnode->ref_count, -1);
 
 			// If the other node is an external vnode, we keep its link
 			// link around so we can put the reference later on. Otherwise
 			// we get rid of it right now.
 			if (coveringNode->mount == mount) {
 				vnode->covered_by = NULL;
-				coveringNode->ref_count--;
+				atomic_add(&coveringNode->ref_count, -1);
 			}
 		}
 
@@ -7892,14 +8363,6 @@ fs_sync(dev_t device)
 	// First, synchronize all file caches
 
 	while (true) {
-		WriteLocker locker(sVnodeLock);
-			// Note: That's the easy way. Which is probably OK for sync(),
-			// since it's a relatively rare call and doesn't need to allow for
-			// a lot of concurrency. Using a read lock would be possible, but
-			// also more involved, since we had to lock the individual nodes
-			// and take care of the locking order, which we might not want to
-			// do while holding fs_mount::lock.
-
 		// synchronize access to vnode list
 		mutex_lock(&mount->lock);
 
@@ -7918,10 +8381,12 @@ fs_sync(dev_t device)
 			vnode = mount->vnodes.GetNext(vnode);
 		}
 
+		ino_t id = -1;
 		if (vnode != NULL) {
 			// insert marker vnode again
 			mount->vnodes.InsertBefore(mount->vnodes.GetNext(vnode), &marker);
 			marker.SetRemoved(false);
+			id = vnode->id;
 		}
 
 		mutex_unlock(&mount->lock);
@@ -7929,8 +8394,17 @@ fs_sync(dev_t device)
 		if (vnode == NULL)
 			break;
 
-		vnode = lookup_vnode(mount->id, vnode->id);
-		if (vnode == NULL || vnode->IsBusy())
+		// The vnode might have been freed in the meantime, so we have to look
+		// it up again. Its shard lock and the vnode lock allow us to do the
+		// 0 -> 1 transition of the reference count.
+		ReadLocker shardLocker(vnode_shard_lock(mount->id, id));
+
+		vnode = lookup_vnode(mount->id, id);
+		if (vnode == NULL)
+			continue;
+
+		AutoLocker<Vnode> nodeLocker(vnode);
+		if (vnode->IsBusy())
 			continue;
 
 		if (vnode->ref_count == 0) {
@@ -7939,7 +8413,8 @@ fs_sync(dev_t device)
 		}
 		inc_vnode_ref_count(vnode);
 
-		locker.Unlock();
+		nodeLocker.Unlock();
+		shardLocker.Unlock();
 
 		if (vnode->cache != NULL && !vnode->IsRemoved())
 			vnode->cache->WriteModified();
@@ -8352,6 +8827,42 @@ _kern_open_dir(int fd, const char* path)
 }
 
 
+/*!	\brief Reads the next entries of a directory, together with their stat
+		   data and, optionally, the start of one of their attributes.
+
+	\param fd A FD referring to a directory.
+	\param buffer The buffer the dirents shall be written into.
+	\param bufferSize The size of \a buffer.
+	\param stats An array of at least \a maxCount stat structures; the one
+		   at index \c i is filled in for the \c i th returned entry. Nodes
+		   that cannot be stat()ed get a cleared structure.
+	\param attribute The name of an attribute to be read for every entry, or
+		   \c NULL.
+	\param attributeBuffer If \a attribute is given, an array of \a maxCount
+		   slots of \a attributeSize bytes each, that the first bytes of each
+		   entry's attribute are written into. Missing attributes are
+		   returned as cleared slots.
+	\param attributeSize The size of a single attribute slot.
+	\param maxCount The maximum number of entries to be read.
+	\return The number of entries read, or an error code.
+*/
+ssize_t
+_kern_read_dir_stat(int fd, struct dirent* buffer, size_t bufferSize,
+	struct stat* stats, const char* attribute, void* attributeBuffer,
+	size_t attributeSize, uint32 maxCount)
+{
+	if (maxCount == 0)
+		return 0;
+	if (buffer == NULL || stats == NULL)
+		return B_BAD_VALUE;
+	if (attribute != NULL && (attributeBuffer == NULL || attributeSize == 0))
+		return B_BAD_VALUE;
+
+	return dir_read_stat(fd, buffer, bufferSize, stats, attribute,
+		(uint8*)attributeBuffer, attributeSize, maxCount, true);
+}
+
+
 status_t
 _kern_fcntl(int fd, int op, size_t argument)
 {
@@ -8387,6 +8898,13 @@ _kern_preallocate(int fd, off_t offset, off_t length)
 }
 
 
+status_t
+_kern_fadvise(int fd, off_t offset, off_t length, int advice)
+{
+	return common_fadvise(fd, offset, length, advice, true);
+}
+
+
 status_t
 _kern_create_dir_entry_ref(dev_t device, ino_t inode, const char* name,
 	int perms)
@@ -9121,6 +9639,80 @@ _user_open_dir(int fd, const char* userPath)
 }
 
 
+ssize_t
+_user_read_dir_stat(int fd, struct dirent* userBuffer, size_t bufferSize,
+	struct stat* userStats, const char* userAttribute,
+	void* userAttributeBuffer, size_t attributeSize, uint32 maxCount)
+{
+	if (maxCount == 0)
+		return 0;
+
+	if (userBuffer == NULL || userStats == NULL)
+		return B_BAD_VALUE;
+	if (!IS_USER_ADDRESS(userBuffer) || !IS_USER_ADDRESS(userStats))
+		return B_BAD_ADDRESS;
+
+	char attributeName[B_FILE_NAME_LENGTH];
+	const char* attribute = NULL;
+	if (userAttribute != NULL) {
+		if (userAttributeBuffer == NULL || attributeSize == 0
+			|| attributeSize > kMaxReadDirStatAttributeSize) {
+			return B_BAD_VALUE;
+		}
+		if (!IS_USER_ADDRESS(userAttribute)
+			|| !IS_USER_ADDRESS(userAttributeBuffer)) {
+			return B_BAD_ADDRESS;
+		}
+		status_t status = user_copy_name(attributeName, userAttribute,
+			sizeof(attributeName));
+		if (status != B_OK)
+			return status;
+		attribute = attributeName;
+	} else
+		attributeSize = 0;
+
+	// restrict the sizes and allocate the heap buffers
+	if (maxCount > kMaxReadDirStatCount)
+		maxCount = kMaxReadDirStatCount;
+	if (bufferSize > kMaxReadDirStatBufferSize)
+		bufferSize = kMaxReadDirStatBufferSize;
+
+	struct dirent* buffer = (struct dirent*)malloc(bufferSize);
+	struct stat* stats = (struct stat*)malloc(sizeof(struct stat) * maxCount);
+	uint8* attributeBuffer = attribute != NULL
+		? (uint8*)malloc(attributeSize * maxCount) : NULL;
+	MemoryDeleter bufferDeleter(buffer);
+	MemoryDeleter statsDeleter(stats);
+	MemoryDeleter attributeBufferDeleter(attributeBuffer);
+	if (buffer == NULL || stats == NULL
+		|| (attribute != NULL && attributeBuffer == NULL)) {
+		return B_NO_MEMORY;
+	}
+
+	ssize_t count = dir_read_stat(fd, buffer, bufferSize, stats, attribute,
+		attributeBuffer, attributeSize, maxCount, false);
+	if (count <= 0)
+		return count;
+
+	// copy the buffers back -- determine the total dirent size first
+	size_t sizeToCopy = 0;
+	struct dirent* entry = buffer;
+	for (ssize_t i = 0; i < count; i++) {
+		sizeToCopy += entry->d_reclen;
+		entry = (struct dirent*)((uint8*)entry + entry->d_reclen);
+	}
+
+	if (user_memcpy(userBuffer, buffer, sizeToCopy) != B_OK
+		|| user_memcpy(userStats, stats, sizeof(struct stat) * count) != B_OK
+		|| (attribute != NULL && user_memcpy(userAttributeBuffer,
+			attributeBuffer, attributeSize * count) != B_OK)) {
+		return B_BAD_ADDRESS;
+	}
+
+	return count;
+}
+
+
 /*!	\brief Opens a directory's parent directory and returns the entry name
 		   of the former.
 
@@ -9272,6 +9864,13 @@ _user_preallocate(int fd, off_t offset, off_t length)
 }
 
 
+status_t
+_user_fadvise(int fd, off_t offset, off_t length, int advice)
+{
+	return common_fadvise(fd, offset, length, advice, false);
+}
+
+
 status_t
 _user_create_dir_entry_ref(dev_t device, ino_t inode, const char* userName,
 	int perms)
@@ -9815,6 +10414,77 @@ _user_stat_attr(int fd, const char* userAttribute,
 }
 
 
+static status_t
+user_attr_io_vecs(int fd, attr_io_vec* userVecs, size_t count, bool write)
+{
+	if (count == 0)
+		return B_OK;
+	if (userVecs == NULL || count > kMaxAttrIOVecCount)
+		return B_BAD_VALUE;
+	if (!IS_USER_ADDRESS(userVecs))
+		return B_BAD_ADDRESS;
+
+	BStackOrHeapArray<attr_io_vec, 8> vecs(count);
+	char* names = (char*)malloc(count * B_FILE_NAME_LENGTH);
+	MemoryDeleter namesDeleter(names);
+	if (!vecs.IsValid() || names == NULL)
+		return B_NO_MEMORY;
+
+	if (user_memcpy(vecs, userVecs, sizeof(attr_io_vec) * count) != B_OK)
+		return B_BAD_ADDRESS;
+
+	// copy the names into the kernel, the buffers are accessed directly
+	for (size_t i = 0; i < count; i++) {
+		char* name = names + i * B_FILE_NAME_LENGTH;
+		if (vecs[i].name == NULL || vecs[i].buffer == NULL)
+			return B_BAD_VALUE;
+		if (!IS_USER_ADDRESS(vecs[i].name) || !IS_USER_ADDRESS(vecs[i].buffer))
+			return B_BAD_ADDRESS;
+
+		status_t status = user_copy_name(name, vecs[i].name,
+			B_FILE_NAME_LENGTH);
+		if (status != B_OK)
+			return status;
+		if (name[0] == '\0')
+			return B_BAD_VALUE;
+
+		vecs[i].name = name;
+		vecs[i].status = B_OK;
+	}
+
+	status_t status = write
+		? attr_write_vecs(fd, vecs, count, false)
+		: attr_read_vecs(fd, vecs, count, false);
+	if (status != B_OK)
+		return status;
+
+	for (size_t i = 0; i < count; i++) {
+		if (user_memcpy(&userVecs[i].length, &vecs[i].length, sizeof(size_t))
+				!= B_OK
+			|| user_memcpy(&userVecs[i].status, &vecs[i].status,
+				sizeof(status_t)) != B_OK) {
+			return B_BAD_ADDRESS;
+		}
+	}
+
+	return B_OK;
+}
+
+
+status_t
+_user_read_attrs(int fd, attr_io_vec* userVecs, size_t count)
+{
+	return user_attr_io_vecs(fd, userVecs, count, false);
+}
+
+
+status_t
+_user_write_attrs(int fd, attr_io_vec* userVecs, size_t count)
+{
+	return user_attr_io_vecs(fd, userVecs, count, true);
+}
+
+
 int
 _user_open_attr(int fd, const char* userPath, const char* userName,
 	uint32 type, int openMode)
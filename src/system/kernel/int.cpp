@@ -18,11 +18,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <arch/debug_console.h>
 #include <arch/int.h>
 #include <boot/kernel_args.h>
 #include <elf.h>
+#include <interrupt_defs.h>
+#include <kernel.h>
 #include <load_tracking.h>
 #include <util/AutoLock.h>
 #include <smp.h>
@@ -78,6 +81,26 @@ static bool sAllocatedIOInterruptVectors[NUM_IO_VECTORS];
 static irq_assignment sVectorCPUAssignments[NUM_IO_VECTORS];
 static mutex sIOInterruptVectorAllocationLock
 	= MUTEX_INITIALIZER("io_interrupt_vector_allocation");
+static spinlock sAssignmentLock = B_SPINLOCK_INITIALIZER;
+	// serializes moving vectors between CPUs, acquired before irqs_lock
+
+// Per vector and CPU interrupt counts, NUM_IO_VECTORS rows of sCPUCount
+// entries. Each CPU only ever writes its own column.
+static uint64* sVectorCPUCounts;
+static int32 sCPUCount;
+
+
+static uint64
+vector_interrupt_count(int32 vector)
+{
+	if (sVectorCPUCounts == NULL)
+		return 0;
+
+	uint64 count = 0;
+	for (int32 i = 0; i < sCPUCount; i++)
+		count += sVectorCPUCounts[vector * sCPUCount + i];
+	return count;
+}
 
 
 #if DEBUG_INTERRUPTS
@@ -157,11 +180,22 @@ dump_int_load(int argc, char** argv)
 				kprintf(", cpu %" B_PRId32, sVectors[i].assigned_cpu->cpu);
 			else
 				kprintf(", cpu -");
+			if (sVectors[i].assigned_cpu->pinned)
+				kprintf(" (pinned)");
 		}
 
 		if (B_SPINLOCK_IS_LOCKED(&sVectors[i].vector_lock))
 			kprintf(", ACTIVE");
 		kprintf("\n");
+
+		if (sVectorCPUCounts != NULL) {
+			kprintf("       count %" B_PRIu64 ":", vector_interrupt_count(i));
+			for (int32 cpu = 0; cpu < sCPUCount; cpu++) {
+				kprintf(" %" B_PRIu64,
+					sVectorCPUCounts[i * sCPUCount + cpu]);
+			}
+			kprintf("\n");
+		}
 	}
 
 	return 0;
@@ -217,8 +251,15 @@ int_init_post_vm(kernel_args* args)
 		sVectorCPUAssignments[i].handlers_count = 0;
 		sVectorCPUAssignments[i].load = 0;
 		sVectorCPUAssignments[i].cpu = -1;
+		sVectorCPUAssignments[i].pinned = false;
 	}
 
+	sCPUCount = args->num_cpus;
+	sVectorCPUCounts = (uint64*)calloc(NUM_IO_VECTORS * sCPUCount,
+		sizeof(uint64));
+	if (sVectorCPUCounts == NULL)
+		dprintf("int_init_post_vm: no memory for interrupt counters\n");
+
 #if DEBUG_INTERRUPTS
 	add_debugger_command("ints", &dump_int_statistics,
 		"list interrupt statistics");
@@ -364,6 +405,9 @@ int_io_interrupt_handler(int vector, bool levelTriggered)
 	vectorLocker.Unlock();
 
 	cpu_ent* cpu = get_cpu_struct();
+	if (sVectorCPUCounts != NULL)
+		sVectorCPUCounts[vector * sCPUCount + cpu->cpu_num]++;
+
 	if (sVectors[vector].type == INTERRUPT_TYPE_IRQ
 		|| sVectors[vector].type == INTERRUPT_TYPE_ICI
 		|| sVectors[vector].type == INTERRUPT_TYPE_LOCAL_IRQ) {
@@ -684,6 +728,36 @@ allocate_io_interrupt_vectors(int32 count, int32 *startVector,
 }
 
 
+/*!	Gives each of the \a count vectors starting at \a startVector, which
+	must have been allocated as a block by allocate_io_interrupt_vectors(),
+	its own CPU assignment. Only vectors whose interrupt target can be
+	programmed individually (i.e. MSI-X table entries) may be split, and only
+	before any handler has been installed.
+*/
+void
+split_io_interrupt_vectors(int32 count, int32 startVector)
+{
+	MutexLocker locker(&sIOInterruptVectorAllocationLock);
+
+	for (int32 i = 0; i < count; i++) {
+		int32 vector = startVector + i;
+		ASSERT(sAllocatedIOInterruptVectors[vector]);
+		ASSERT(sVectors[vector].handler_list == NULL);
+
+		irq_assignment& assignment = sVectorCPUAssignments[vector];
+		assignment.irq = vector;
+		assignment.count = 1;
+		assignment.handlers_count = 0;
+		assignment.load = 0;
+		assignment.cpu = -1;
+		assignment.pinned = false;
+
+		InterruptsSpinLocker vectorLocker(sVectors[vector].vector_lock);
+		sVectors[vector].assigned_cpu = &assignment;
+	}
+}
+
+
 /*!	Free/unreserve interrupt vectors previously allocated with the
 	{reserve|allocate}_io_interrupt_vectors() functions. The \a count and
 	\a startVector can be adjusted from the allocation calls to partially free
@@ -717,24 +791,19 @@ free_io_interrupt_vectors(int32 count, int32 startVector)
 		}
 
 		vector.assigned_cpu = NULL;
+		sVectorCPUAssignments[startVector + i].pinned = false;
 		sAllocatedIOInterruptVectors[startVector + i] = false;
 	}
 }
 
 
-void assign_io_interrupt_to_cpu(int32 vector, int32 newCPU)
+static void
+move_io_interrupt_locked(int32 vector, int32 newCPU)
 {
-	ASSERT(sVectors[vector].type == INTERRUPT_TYPE_IRQ);
-
 	int32 oldCPU = sVectors[vector].assigned_cpu->cpu;
-
-	if (newCPU == -1)
-		newCPU = assign_cpu();
-
-	if (newCPU == oldCPU)
+	if (newCPU == oldCPU || oldCPU == -1)
 		return;
 
-	ASSERT(oldCPU != -1);
 	cpu_ent* cpu = &gCPU[oldCPU];
 
 	SpinLocker locker(cpu->irqs_lock);
@@ -748,3 +817,135 @@ void assign_io_interrupt_to_cpu(int32 vector, int32 newCPU)
 	locker.SetTo(cpu->irqs_lock, false);
 	list_add_item(&cpu->irqs, sVectors[vector].assigned_cpu);
 }
+
+
+/*!	Moves \a vector to \a newCPU, or to any enabled CPU if \a newCPU is -1.
+	The latter is used when the current CPU is going away and also drops a
+	pinned affinity; otherwise pinned vectors are left where they are.
+	Interrupts must be disabled.
+*/
+void
+assign_io_interrupt_to_cpu(int32 vector, int32 newCPU)
+{
+	ASSERT(sVectors[vector].type == INTERRUPT_TYPE_IRQ);
+
+	SpinLocker locker(sAssignmentLock);
+
+	irq_assignment* assignment = sVectors[vector].assigned_cpu;
+	if (newCPU == -1) {
+		assignment->pinned = false;
+		newCPU = assign_cpu();
+	} else if (assignment->pinned)
+		return;
+
+	move_io_interrupt_locked(vector, newCPU);
+}
+
+
+/*!	Binds \a vector to \a cpu and excludes it from the automatic balancing.
+	A \a cpu of -1 releases the binding without moving the vector.
+*/
+status_t
+set_io_interrupt_affinity(int32 vector, int32 cpu)
+{
+	if (vector < 0 || vector >= NUM_IO_VECTORS)
+		return B_BAD_VALUE;
+	if (cpu < -1 || cpu >= smp_get_num_cpus())
+		return B_BAD_VALUE;
+
+	InterruptsSpinLocker locker(sAssignmentLock);
+
+	if (sVectors[vector].type != INTERRUPT_TYPE_IRQ
+		|| sVectors[vector].assigned_cpu == NULL
+		|| sVectors[vector].assigned_cpu->cpu == -1) {
+		return B_ENTRY_NOT_FOUND;
+	}
+
+	irq_assignment* assignment = sVectors[vector].assigned_cpu;
+	if (cpu == -1) {
+		assignment->pinned = false;
+		return B_OK;
+	}
+
+	if (gCPU[cpu].disabled)
+		return B_NOT_ALLOWED;
+
+	move_io_interrupt_locked(vector, cpu);
+	assignment->pinned = true;
+	return B_OK;
+}
+
+
+//	#pragma mark - syscalls
+
+
+status_t
+_user_get_next_interrupt_info(int32* _cookie, interrupt_info* userInfo,
+	uint64* userCPUCounts, uint32 cpuCount)
+{
+	int32 cookie;
+	if (_cookie == NULL || userInfo == NULL
+		|| !IS_USER_ADDRESS(_cookie) || !IS_USER_ADDRESS(userInfo)
+		|| (userCPUCounts != NULL && !IS_USER_ADDRESS(userCPUCounts))
+		|| user_memcpy(&cookie, _cookie, sizeof(cookie)) != B_OK) {
+		return B_BAD_ADDRESS;
+	}
+
+	if (cookie < 0)
+		return B_BAD_VALUE;
+
+	// only report IRQs that are actually in use
+	interrupt_info info;
+	uint64 cpuCounts[SMP_MAX_CPUS];
+	int32 vector = cookie;
+	for (; vector < NUM_IO_VECTORS; vector++) {
+		InterruptsSpinLocker locker(sVectors[vector].vector_lock);
+
+		io_vector& ioVector = sVectors[vector];
+		if (ioVector.type != INTERRUPT_TYPE_IRQ
+			|| ioVector.handler_list == NULL
+			|| ioVector.assigned_cpu == NULL) {
+			continue;
+		}
+
+		info.vector = vector;
+		info.cpu = ioVector.assigned_cpu->cpu;
+		info.flags = ioVector.assigned_cpu->pinned ? INTERRUPT_INFO_PINNED : 0;
+		info.handlers = 0;
+		for (io_handler* io = ioVector.handler_list; io != NULL; io = io->next)
+			info.handlers++;
+		info.load = ioVector.load;
+		break;
+	}
+
+	if (vector >= NUM_IO_VECTORS)
+		return B_BAD_INDEX;
+
+	info.count = vector_interrupt_count(vector);
+
+	cpuCount = min_c(cpuCount, (uint32)sCPUCount);
+	for (uint32 i = 0; i < cpuCount; i++) {
+		cpuCounts[i] = sVectorCPUCounts != NULL
+			? sVectorCPUCounts[vector * sCPUCount + i] : 0;
+	}
+
+	cookie = vector + 1;
+	if (user_memcpy(userInfo, &info, sizeof(info)) != B_OK
+		|| (userCPUCounts != NULL && user_memcpy(userCPUCounts, cpuCounts,
+			cpuCount * sizeof(uint64)) != B_OK)
+		|| user_memcpy(_cookie, &cookie, sizeof(cookie)) != B_OK) {
+		return B_BAD_ADDRESS;
+	}
+
+	return B_OK;
+}
+
+
+status_t
+_user_set_interrupt_affinity(int32 vector, int32 cpu)
+{
+	if (geteuid() != 0)
+		return B_PERMISSION_DENIED;
+
+	return set_io_interrupt_affinity(vector, cpu);
+}
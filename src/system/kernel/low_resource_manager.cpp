@@ -21,6 +21,7 @@
 #include <util/DoublyLinkedList.h>
 #include <vm/vm_page.h>
 #include <vm/vm_priv.h>
+#include <WorkQueue.h>
 
 
 //#define TRACE_LOW_RESOURCE_MANAGER
@@ -73,7 +74,9 @@ static bigtime_t sLastMeasurement;
 
 static recursive_lock sLowResourceLock
 	= RECURSIVE_LOCK_INITIALIZER("low resource");
-static sem_id sLowResourceWaitSem;
+static WorkQueue sLowResourceQueue;
+static FunctionWorkItem sLowResourceWork;
+static int32 sLowResourceRequested;
 static HandlerList sLowResourceHandlers;
 
 static ConditionVariable sLowResourceWaiterCondition;
@@ -239,41 +242,43 @@ compute_state(void)
 }
 
 
-static status_t
+/*!	Work item function that runs one iteration of the low resource manager.
+	It is executed when low_resource() has been called, and requeues itself
+	to run periodically.
+*/
+static void
 low_resource_manager(void*)
 {
-	bigtime_t timeout = kLowResourceInterval;
-	while (true) {
-		const status_t status = acquire_sem_etc(sLowResourceWaitSem, 1,
-			B_RELATIVE_TIMEOUT, timeout);
+	static bigtime_t sTimeout = kLowResourceInterval;
 
-		RecursiveLocker _(&sLowResourceLock);
+	const bool requested = atomic_get_and_set(&sLowResourceRequested, 0) != 0;
 
-		// Do not recompute the state if we actually acquired the semaphore,
-		// as in this case, it has likely been set to something specific.
-		if (status == B_TIMED_OUT)
-			compute_state();
+	RecursiveLocker locker(&sLowResourceLock);
 
-		const int32 state = low_resource_state_no_update(B_ALL_KERNEL_RESOURCES);
+	// Do not recompute the state if low_resource() has been called, as in
+	// this case, it has likely been set to something specific.
+	if (!requested)
+		compute_state();
 
-		TRACE(("low_resource_manager: state = %ld, %ld free pages, %lld free "
-			"memory, %lu free semaphores\n", state, vm_page_num_free_pages(),
-			vm_available_not_needed_memory(),
-			sem_max_sems() - sem_used_sems()));
+	const int32 state = low_resource_state_no_update(B_ALL_KERNEL_RESOURCES);
 
-		if (state < B_LOW_RESOURCE_NOTE)
-			continue;
+	TRACE(("low_resource_manager: state = %ld, %ld free pages, %lld free "
+		"memory, %lu free semaphores\n", state, vm_page_num_free_pages(),
+		vm_available_not_needed_memory(),
+		sem_max_sems() - sem_used_sems()));
 
+	if (state >= B_LOW_RESOURCE_NOTE) {
 		call_handlers(sLowResources);
 
 		if (state >= B_LOW_RESOURCE_WARNING)
-			timeout = kWarnResourceInterval;
+			sTimeout = kWarnResourceInterval;
 		else
-			timeout = kLowResourceInterval;
+			sTimeout = kLowResourceInterval;
 
 		sLowResourceWaiterCondition.NotifyAll();
 	}
-	return 0;
+
+	sLowResourceQueue.QueueDelayed(&sLowResourceWork, sTimeout);
 }
 
 
@@ -370,7 +375,8 @@ low_resource(uint32 resource, uint64 requirements, uint32 flags, uint32 timeout)
 			break;
 	}
 
-	release_sem(sLowResourceWaitSem);
+	atomic_set(&sLowResourceRequested, 1);
+	sLowResourceQueue.Queue(&sLowResourceWork);
 
 	if ((flags & B_RELATIVE_TIMEOUT) == 0 || timeout > 0)
 		sLowResourceWaiterCondition.Wait(flags, timeout);
@@ -421,13 +427,20 @@ low_resource_manager_init(void)
 status_t
 low_resource_manager_init_post_thread(void)
 {
-	sLowResourceWaitSem = create_sem(0, "low resource wait");
-	if (sLowResourceWaitSem < B_OK)
-		return sLowResourceWaitSem;
-
-	thread_id thread = spawn_kernel_thread(&low_resource_manager,
-		"low resource manager", B_LOW_PRIORITY, NULL);
-	resume_thread(thread);
+	// The handlers get a worker of their own: they may wait for work that
+	// is queued on the shared queues, like the block cache notifications.
+	status_t status = sLowResourceQueue.Init("low resource manager",
+		B_LOW_PRIORITY, WORK_QUEUE_UNBOUND, 1);
+	if (status != B_OK)
+		return status;
+
+	new(&sLowResourceWork) FunctionWorkItem;
+	sLowResourceWork.SetTo(&low_resource_manager, NULL);
+
+	status = sLowResourceQueue.QueueDelayed(&sLowResourceWork,
+		kLowResourceInterval);
+	if (status != B_OK)
+		return status;
 
 	add_debugger_command("low_resource", &dump_handlers,
 		"Dump list of low resource handlers");
@@ -57,8 +57,10 @@
 #include <timer.h>
 #include <user_debugger.h>
 #include <user_mutex.h>
+#include <util/rcu.h>
 #include <vfs.h>
 #include <vm/vm.h>
+#include <WorkQueue.h>
 #include <boot/kernel_args.h>
 
 #include "vm/VMAnonymousCache.h"
@@ -205,6 +207,8 @@ _start(kernel_args *bootKernelArgs, int currentCPU)
 		thread_init(&sKernelArgs);
 		TRACE("init kernel daemons\n");
 		kernel_daemon_init();
+		TRACE("init RCU\n");
+		rcu_init();
 		TRACE("init stack protector\n");
 		stack_protector_init();
 		arch_platform_init_post_thread(&sKernelArgs);
@@ -213,6 +217,8 @@ _start(kernel_args *bootKernelArgs, int currentCPU)
 		int_init_io(&sKernelArgs);
 		TRACE("init VM threads\n");
 		vm_init_post_thread(&sKernelArgs);
+		TRACE("init work queues\n");
+		work_queue_init();
 		low_resource_manager_init_post_thread();
 		TRACE("init DPC\n");
 		dpc_init();
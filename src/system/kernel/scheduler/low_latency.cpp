@@ -121,7 +121,7 @@ rebalance_irqs(bool idle)
 
 	int32 totalLoad = 0;
 	while (irq != NULL) {
-		if (chosen == NULL || chosen->load < irq->load)
+		if (!irq->pinned && (chosen == NULL || chosen->load < irq->load))
 			chosen = irq;
 		totalLoad += irq->load;
 		irq = (irq_assignment*)list_get_next_item(&cpu->irqs, irq);
@@ -175,8 +175,12 @@ pack_irqs()
 		return;
 
 	SpinLocker locker(cpu->irqs_lock);
-	while (list_get_first_item(&cpu->irqs) != NULL) {
-		irq_assignment* irq = (irq_assignment*)list_get_first_item(&cpu->irqs);
+	irq_assignment* irq = (irq_assignment*)list_get_first_item(&cpu->irqs);
+	while (irq != NULL) {
+		if (irq->pinned) {
+			irq = (irq_assignment*)list_get_next_item(&cpu->irqs, irq);
+			continue;
+		}
 		locker.Unlock();
 
 		int32 newCPU = smallTaskCore->CPUHeap()->PeekRoot()->ID();
@@ -185,6 +189,7 @@ pack_irqs()
 			assign_io_interrupt_to_cpu(irq->irq, newCPU);
 
 		locker.Lock();
+		irq = (irq_assignment*)list_get_first_item(&cpu->irqs);
 	}
 }
 
@@ -209,7 +214,7 @@ rebalance_irqs(bool idle)
 	irq_assignment* irq = (irq_assignment*)list_get_first_item(&cpu->irqs);
 
 	while (irq != NULL) {
-		if (chosen == NULL || chosen->load < irq->load)
+		if (!irq->pinned && (chosen == NULL || chosen->load < irq->load))
 			chosen = irq;
 		irq = (irq_assignment*)list_get_next_item(&cpu->irqs, irq);
 	}
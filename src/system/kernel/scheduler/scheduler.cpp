@@ -28,6 +28,7 @@
 #include <smp.h>
 #include <timer.h>
 #include <util/Random.h>
+#include <util/rcu.h>
 
 #include "scheduler_common.h"
 #include "scheduler_cpu.h"
@@ -304,6 +305,8 @@ switch_thread(Thread* fromThread, Thread* toThread)
 	cpu->running_thread = toThread;
 	cpu->previous_thread = fromThread;
 
+	rcu_quiescent_state(cpu->cpu_num);
+
 	arch_thread_set_current_thread(toThread);
 	arch_thread_context_switch(fromThread, toThread);
 
@@ -57,17 +57,20 @@
 
 
 // Locking:
-// * sSemsSpinlock: Protects the semaphore free list (sFreeSemsHead,
-//   sFreeSemsTail), Team::sem_list, and together with sem_entry::lock
-//   write access to sem_entry::owner/team_link.
-// * sem_entry::lock: Protects all sem_entry members. owner, team_link
-//   additional need sSemsSpinlock for write access.
+// * sFreeSemsLock: Protects the semaphore free list (sFreeSemsHead,
+//   sFreeSemsTail). It is only held while a slot is taken from or appended to
+//   the list, and no other lock is acquired while holding it.
+// * Team::sem_list_lock: Protects the team's sem_list, and together with
+//   sem_entry::lock write access to sem_entry::owner/team/team_link.
+// * sem_entry::lock: Protects all sem_entry members. owner, team, team_link
+//   additional need the owning team's sem_list_lock for write access.
 //   lock itself doesn't need protection -- sem_entry objects are never deleted.
 //
-// The locking order is sSemsSpinlock -> sem_entry::lock -> scheduler lock. All
-// semaphores are in the sSems array (sem_entry[]). Access by sem_id requires
-// computing the object index (id % sMaxSems), locking the respective
-// sem_entry::lock and verifying that sem_entry::id matches afterwards.
+// The locking order is sem_entry::lock -> Team::sem_list_lock -> scheduler
+// lock. All semaphores are in the sSems array (sem_entry[]). Access by sem_id
+// doesn't need any global lock: it requires computing the object index
+// (id % sMaxSems), locking the respective sem_entry::lock and verifying that
+// sem_entry::id matches afterwards.
 
 
 struct queued_thread : DoublyLinkedListLinkImpl<queued_thread> {
@@ -97,6 +100,7 @@ struct sem_entry {
 									// threads
 			char*				name;
 			team_id				owner;
+			Team*				team;
 			select_info*		select_infos;
 			thread_id			last_acquirer;
 #if DEBUG_SEM_LAST_ACQUIRER
@@ -128,7 +132,7 @@ static bool sSemsActive = false;
 static struct sem_entry	*sFreeSemsHead = NULL;
 static struct sem_entry	*sFreeSemsTail = NULL;
 
-static spinlock sSemsSpinlock = B_SPINLOCK_INITIALIZER;
+static spinlock sFreeSemsLock = B_SPINLOCK_INITIALIZER;
 
 
 static int
@@ -267,7 +271,7 @@ dump_sem_info(int argc, char **argv)
 
 /*!	\brief Appends a semaphore slot to the free list.
 
-	The semaphore list must be locked.
+	The free list must be locked.
 	The slot's id field is not changed. It should already be set to -1.
 
 	\param slot The index of the semaphore slot.
@@ -316,7 +320,8 @@ fill_sem_info(struct sem_entry* sem, sem_info* info, size_t size)
 
 
 /*!	You must call this function with interrupts disabled, and the semaphore's
-	spinlock held. Note that it will unlock the spinlock itself.
+	spinlock held. The semaphore must already have been removed from its
+	team's list. Note that it will unlock the spinlock itself.
 	Since it cannot free() the semaphore's name with interrupts turned off, it
 	will return that one in \a name.
 */
@@ -342,7 +347,7 @@ uninit_sem_locked(struct sem_entry& sem, char** _name, SpinLocker& locker)
 	locker.Unlock();
 
 	// append slot to the free list
-	SpinLocker _(&sSemsSpinlock);
+	SpinLocker _(&sFreeSemsLock);
 	free_sem_slot(id % sMaxSems, id + sMaxSems);
 	atomic_add(&sUsedSems, -1);
 }
@@ -359,7 +364,6 @@ delete_sem_internal(sem_id id, bool checkPermission)
 	int32 slot = id % sMaxSems;
 
 	InterruptsLocker interruptsLocker;
-	SpinLocker listLocker(sSemsSpinlock);
 	SpinLocker semLocker(sSems[slot].lock);
 
 	if (sSems[slot].id != id) {
@@ -375,13 +379,15 @@ delete_sem_internal(sem_id id, bool checkPermission)
 	}
 
 	if (sSems[slot].u.used.owner >= 0) {
+		SpinLocker teamSemListLocker(sSems[slot].u.used.team->sem_list_lock);
 		list_remove_link(&sSems[slot].u.used.team_link);
+		teamSemListLocker.Unlock();
+
 		sSems[slot].u.used.owner = -1;
+		sSems[slot].u.used.team = NULL;
 	} else
 		panic("sem %" B_PRId32 " has no owner", id);
 
-	listLocker.Unlock();
-
 	char* name;
 	uninit_sem_locked(sSems[slot], &name, semLocker);
 
@@ -494,16 +500,20 @@ create_sem_etc(int32 count, const char* name, team_id owner)
 
 	strlcpy(tempName, name, nameLength);
 
-	InterruptsSpinLocker _(&sSemsSpinlock);
+	InterruptsLocker _;
 
 	// get the first slot from the free list
+	SpinLocker freeListLocker(sFreeSemsLock);
 	sem = sFreeSemsHead;
 	if (sem) {
 		// remove it from the free list
 		sFreeSemsHead = sem->u.unused.next;
 		if (!sFreeSemsHead)
 			sFreeSemsTail = NULL;
+	}
+	freeListLocker.Unlock();
 
+	if (sem) {
 		// init the slot
 		SpinLocker semLocker(sem->lock);
 		sem->id = sem->u.unused.next_id;
@@ -512,10 +522,13 @@ create_sem_etc(int32 count, const char* name, team_id owner)
 		new(&sem->queue) ThreadQueue;
 		sem->u.used.name = tempName;
 		sem->u.used.owner = team->id;
+		sem->u.used.team = team;
 		sem->u.used.select_infos = NULL;
 		id = sem->id;
 
+		SpinLocker teamSemListLocker(team->sem_list_lock);
 		list_add_item(&team->sem_list, &sem->u.used.team_link);
+		teamSemListLocker.Unlock();
 
 		semLocker.Unlock();
 
@@ -653,14 +666,27 @@ sem_delete_owned_sems(Team* team)
 		{
 			// get the next semaphore from the team's sem list
 			InterruptsLocker _;
-			SpinLocker semListLocker(sSemsSpinlock);
-			sem_entry* sem = (sem_entry*)list_remove_head_item(&team->sem_list);
+			SpinLocker semListLocker(team->sem_list_lock);
+			sem_entry* sem = (sem_entry*)list_get_first_item(&team->sem_list);
 			if (sem == NULL)
 				break;
 
-			// delete the semaphore
+			// The list lock ranks below the semaphore lock, so we have to
+			// drop it first and check whether the semaphore still belongs to
+			// the team once we hold its lock.
+			semListLocker.Unlock();
 			SpinLocker semLocker(sem->lock);
+			if (sem->id < 0 || sem->u.used.team != team)
+				continue;
+
+			semListLocker.Lock();
+			list_remove_link(&sem->u.used.team_link);
 			semListLocker.Unlock();
+
+			sem->u.used.owner = -1;
+			sem->u.used.team = NULL;
+
+			// delete the semaphore
 			uninit_sem_locked(*sem, &name, semLocker);
 		}
 
@@ -1051,40 +1077,39 @@ _get_next_sem_info(team_id teamID, int32 *_cookie, struct sem_info *info,
 		return B_BAD_TEAM_ID;
 	BReference<Team> teamReference(team, true);
 
-	InterruptsSpinLocker semListLocker(sSemsSpinlock);
+	InterruptsLocker _;
 
 	// TODO: find a way to iterate the list that is more reliable
-	sem_entry* sem = (sem_entry*)list_get_first_item(&team->sem_list);
-	int32 newIndex = *_cookie;
-	int32 index = 0;
-	bool found = false;
+	int32 index = *_cookie;
 
-	while (!found) {
+	while (true) {
 		// find the next entry to be returned
-		while (sem != NULL && index < newIndex) {
+		SpinLocker semListLocker(team->sem_list_lock);
+
+		sem_entry* sem = (sem_entry*)list_get_first_item(&team->sem_list);
+		for (int32 i = 0; sem != NULL && i < index; i++)
 			sem = (sem_entry*)list_get_next_item(&team->sem_list, sem);
-			index++;
-		}
 
 		if (sem == NULL)
 			return B_BAD_VALUE;
 
-		SpinLocker _(sem->lock);
+		// The ID of a listed semaphore doesn't change, so we can remember it
+		// and verify it again once we hold the semaphore's lock.
+		sem_id id = sem->id;
+		semListLocker.Unlock();
 
-		if (sem->id != -1 && sem->u.used.owner == team->id) {
+		SpinLocker semLocker(sem->lock);
+
+		if (sem->id == id && sem->u.used.team == team) {
 			// found one!
 			fill_sem_info(sem, info, size);
-			newIndex = index + 1;
-			found = true;
-		} else
-			newIndex++;
-	}
-
-	if (!found)
-		return B_BAD_VALUE;
+			*_cookie = index + 1;
+			return B_OK;
+		}
 
-	*_cookie = newIndex;
-	return B_OK;
+		// the semaphore has been deleted or changed its owner in the
+		// meantime -- the list has changed, try the same index again
+	}
 }
 
 
@@ -1106,18 +1131,27 @@ set_sem_owner(sem_id id, team_id newTeamID)
 		return B_BAD_TEAM_ID;
 	BReference<Team> newTeamReference(newTeam, true);
 
-	InterruptsSpinLocker semListLocker(sSemsSpinlock);
-	SpinLocker semLocker(sSems[slot].lock);
+	InterruptsSpinLocker semLocker(sSems[slot].lock);
 
 	if (sSems[slot].id != id) {
 		TRACE(("set_sem_owner: invalid sem_id %ld\n", id));
 		return B_BAD_SEM_ID;
 	}
 
+	Team* oldTeam = sSems[slot].u.used.team;
+	if (oldTeam == newTeam)
+		return B_OK;
+
+	SpinLocker oldTeamSemListLocker(oldTeam->sem_list_lock);
 	list_remove_link(&sSems[slot].u.used.team_link);
+	oldTeamSemListLocker.Unlock();
+
+	SpinLocker newTeamSemListLocker(newTeam->sem_list_lock);
 	list_add_item(&newTeam->sem_list, &sSems[slot].u.used.team_link);
+	newTeamSemListLocker.Unlock();
 
 	sSems[slot].u.used.owner = newTeam->id;
+	sSems[slot].u.used.team = newTeam;
 	return B_OK;
 }
 
@@ -60,6 +60,7 @@
 #include <vm/VMAddressSpace.h>
 #include <util/AutoLock.h>
 #include <util/ThreadAutoLock.h>
+#include <util/rcu.h>
 
 #include "TeamThreadTables.h"
 
@@ -445,6 +446,7 @@ Team::Team(team_id id, bool kernel)
 	realtime_sem_context = NULL;
 	xsi_sem_context = NULL;
 	death_entry = NULL;
+	io_class = IO_CLASS_DEFAULT;
 	list_init(&dead_threads);
 
 	dead_children.condition_variable.Init(&dead_children, "team children");
@@ -467,6 +469,7 @@ Team::Team(team_id id, bool kernel)
 	list_init(&image_list);
 	list_init(&watcher_list);
 	list_init(&sem_list);
+	B_INITIALIZE_SPINLOCK(&sem_list_lock);
 	list_init_etc(&port_list, port_team_link_offset());
 
 	user_data = 0;
@@ -550,6 +553,15 @@ Team::~Team()
 }
 
 
+void
+Team::operator delete(void* pointer)
+{
+	// The team can still be found by lockless hash lookups, so the memory
+	// must not be reused before an RCU grace period has passed.
+	rcu_free(&((Team*)pointer)->rcu_entry, pointer);
+}
+
+
 /*static*/ Team*
 Team::Create(team_id id, const char* name, bool kernel)
 {
@@ -596,6 +608,15 @@ Team::Get(team_id id)
 		return team;
 	}
 
+	{
+		RCUReadLocker rcuLocker;
+		Team* team = sTeamHash.LookupUnlocked(id);
+		if (team != NULL)
+			return team;
+	}
+
+	// retry with the lock held -- the team might have been added
+	// concurrently
 	InterruptsReadSpinLocker locker(sTeamHashLock);
 	Team* team = sTeamHash.Lookup(id);
 	if (team != NULL)
@@ -1789,6 +1810,7 @@ load_image_internal(char**& _flatArgs, size_t flatArgsSize, int32 argCount,
 
 	// inherit the parent's user/group
 	inherit_parent_user_and_group(team, parent);
+	team->io_class = atomic_get(&parent->io_class);
 
 	// get a reference to the parent's I/O context -- we need it to create ours
 	parentIOContext = parent->io_context;
@@ -2143,6 +2165,7 @@ fork_team(void)
 
 	// Inherit the parent's user/group.
 	inherit_parent_user_and_group(team, parentTeam);
+	team->io_class = atomic_get(&parentTeam->io_class);
 
 	// inherit signal handlers
 	team->InheritSignalActions(parentTeam);
@@ -2867,7 +2890,7 @@ team_init(kernel_args* args)
 {
 	// create the team hash table
 	new(&sTeamHash) TeamTable;
-	if (sTeamHash.Init(64) != B_OK)
+	if (sTeamHash.Init(512) != B_OK)
 		panic("Failed to init team hash table!");
 
 	new(&sGroupHash) ProcessGroupHashTable;
@@ -3103,6 +3126,20 @@ team_geteuid(team_id id)
 }
 
 
+/*!	Returns the I/O class of the given team, one of the \c IO_CLASS_*
+	constants. Unknown teams use \c IO_CLASS_DEFAULT.
+*/
+int32
+team_get_io_class(team_id id)
+{
+	InterruptsReadSpinLocker teamsLocker(sTeamHashLock);
+	Team* team = team_get_team_struct_locked(id);
+	if (team == NULL)
+		return IO_CLASS_DEFAULT;
+	return atomic_get(&team->io_class);
+}
+
+
 /*!	Removes the specified team from the global team hash, from its process
 	group, and from its parent.
 	It also moves all of its children to the kernel team.
@@ -4556,3 +4593,39 @@ _user_get_extended_team_info(team_id teamID, uint32 flags, void* buffer,
 
 	return B_OK;
 }
+
+
+status_t
+_user_set_team_io_class(team_id teamID, int32 ioClass)
+{
+	if (ioClass < IO_CLASS_DEFAULT || ioClass > IO_CLASS_IDLE)
+		return B_BAD_VALUE;
+
+	Team* team = Team::GetAndLock(teamID);
+	if (team == NULL)
+		return B_BAD_TEAM_ID;
+	BReference<Team> teamReference(team, true);
+	TeamLocker teamLocker(team, true);
+
+	// only root may change other users' teams, or use the realtime class
+	uid_t uid = geteuid();
+	if (uid != 0 && (uid != team->effective_uid
+			|| ioClass == IO_CLASS_REALTIME)) {
+		return B_NOT_ALLOWED;
+	}
+
+	atomic_set(&team->io_class, ioClass);
+	return B_OK;
+}
+
+
+int32
+_user_get_team_io_class(team_id teamID)
+{
+	Team* team = Team::Get(teamID);
+	if (team == NULL)
+		return B_BAD_TEAM_ID;
+	BReference<Team> teamReference(team, true);
+
+	return atomic_get(&team->io_class);
+}
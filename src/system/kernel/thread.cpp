@@ -27,6 +27,7 @@
 
 #include <util/AutoLock.h>
 #include <util/ThreadAutoLock.h>
+#include <util/rcu.h>
 
 #include <arch/debug.h>
 #include <boot/kernel_args.h>
@@ -288,6 +289,15 @@ Thread::Create(const char* name, Thread*& _thread)
 /*static*/ Thread*
 Thread::Get(thread_id id)
 {
+	{
+		RCUReadLocker rcuLocker;
+		Thread* thread = sThreadHash.LookupUnlocked(id);
+		if (thread != NULL)
+			return thread;
+	}
+
+	// retry with the lock held -- the thread might have been added
+	// concurrently
 	InterruptsReadSpinLocker threadHashLocker(sThreadHashLock);
 	Thread* thread = sThreadHash.Lookup(id);
 	if (thread != NULL)
@@ -339,6 +349,13 @@ Thread::IsAlive(thread_id id)
 }
 
 
+static void
+free_thread_memory(void* pointer)
+{
+	object_cache_free(sThreadCache, pointer, 0);
+}
+
+
 void*
 Thread::operator new(size_t size)
 {
@@ -356,7 +373,9 @@ Thread::operator new(size_t, void* pointer)
 void
 Thread::operator delete(void* pointer, size_t size)
 {
-	object_cache_free(sThreadCache, pointer, 0);
+	// The thread can still be found by lockless hash lookups, so the memory
+	// must not be reused before an RCU grace period has passed.
+	rcu_call(&((Thread*)pointer)->rcu_entry, &free_thread_memory, pointer);
 }
 
 
@@ -2717,7 +2736,7 @@ thread_init(kernel_args *args)
 
 	// create the thread hash table
 	new(&sThreadHash) ThreadHashTable();
-	if (sThreadHash.Init(128) != B_OK)
+	if (sThreadHash.Init(1024) != B_OK)
 		panic("thread_init(): failed to init thread hash table!");
 
 	// create the thread structure object cache
@@ -2972,6 +2991,13 @@ thread_block_with_timeout(uint32 timeoutFlags, bigtime_t timeout)
 				timerFlags |= B_TIMER_REAL_TIME_BASE;
 		}
 
+		// Timeouts rarely expire and needn't be precise, unlike sleeps --
+		// real-time threads always get precise ones, though.
+		if (thread->wait.type != THREAD_BLOCK_TYPE_SNOOZE
+			&& thread->priority < B_REAL_TIME_DISPLAY_PRIORITY) {
+			timerFlags |= B_TIMER_COARSE;
+		}
+
 		// install the timer
 		thread->wait.unblock_timer.user_data = thread;
 		add_timer(&thread->wait.unblock_timer, &thread_block_timeout, timeout,
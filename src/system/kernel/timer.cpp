@@ -25,12 +25,49 @@
 #include <util/AutoLock.h>
 
 
+// Coarse timers are kept in a hierarchical timer wheel. Each level has
+// kTimerWheelLevelSize slots; the slot granularity of a level is
+// 2^kTimerWheelClockShift times that of the level below it, with level 0
+// slots covering 2^kTimerWheelTickShift microseconds (a wheel "tick"). A timer
+// is put into the lowest level that can hold its delay and is rounded up to
+// the slot boundary, so it is never early and at most about 1/8 of its delay
+// late. All timers of a slot expire together.
+static const uint32 kTimerWheelTickShift = 10;
+static const uint32 kTimerWheelLevelBits = 6;
+static const uint32 kTimerWheelLevelSize = 1 << kTimerWheelLevelBits;
+static const uint32 kTimerWheelLevelMask = kTimerWheelLevelSize - 1;
+static const uint32 kTimerWheelClockShift = 3;
+static const uint32 kTimerWheelClockMask = (1 << kTimerWheelClockShift) - 1;
+static const uint32 kTimerWheelLevels = 7;
+static const uint32 kTimerWheelSlots = kTimerWheelLevels * kTimerWheelLevelSize;
+
+static const bigtime_t kTimerWheelMinDelay = 10000;
+	// coarse timers with a shorter delay are kept in the precise list
+
+#define TIMER_IN_WHEEL	0x0800
+	// internal timer::flags bit: the timer is in the wheel or expired list
+
+struct timer_wheel {
+	uint64			clock;
+		// next tick to be processed
+	uint64			next_expiry;
+		// lower bound for the tick at which the next slot expires
+	int32			count;
+		// number of timers in the slots and the expired list
+	uint64			pending[kTimerWheelLevels];
+		// bitmaps of the non-empty slots
+	timer*			slots[kTimerWheelSlots];
+	timer*			expired;
+		// timers whose slot has expired, but that haven't been run yet
+};
+
 struct per_cpu_timer_data {
 	spinlock		lock;
 	timer* volatile	events;
 	timer* volatile	current_event;
 	int32			current_event_in_progress;
 	bigtime_t		real_time_offset;
+	timer_wheel		wheel;
 };
 
 static per_cpu_timer_data sPerCPU[SMP_MAX_CPUS];
@@ -56,17 +93,6 @@ set_hardware_timer(bigtime_t scheduleTime, bigtime_t now)
 }
 
 
-/*!	Sets the hardware timer to the given absolute time.
-
-	\param scheduleTime The absolute system time for the timer expiration.
-*/
-static inline void
-set_hardware_timer(bigtime_t scheduleTime)
-{
-	set_hardware_timer(scheduleTime, system_time());
-}
-
-
 /*! NOTE: expects interrupts to be off */
 static void
 add_event_to_list(timer* event, timer* volatile* list)
@@ -90,6 +116,254 @@ add_event_to_list(timer* event, timer* volatile* list)
 }
 
 
+// #pragma mark - timer wheel
+
+
+/*!	Wheel timers are kept in doubly linked lists: timer::next points to the
+	next timer, timer::period to the previous timer's next field or to the list
+	head.
+*/
+static inline timer**
+wheel_previous_link(timer* event)
+{
+	return (timer**)(addr_t)event->period;
+}
+
+
+static inline void
+wheel_set_previous_link(timer* event, timer** link)
+{
+	event->period = (addr_t)link;
+}
+
+
+static inline void
+wheel_list_add(timer** list, timer* event)
+{
+	event->next = *list;
+	if (event->next != NULL)
+		wheel_set_previous_link(event->next, &event->next);
+	*list = event;
+	wheel_set_previous_link(event, list);
+}
+
+
+static inline uint32
+wheel_level_shift(uint32 level)
+{
+	return level * kTimerWheelClockShift;
+}
+
+
+/*!	Returns the smallest delta (in ticks) that is put into  level. */
+static inline uint64
+wheel_level_start(uint32 level)
+{
+	if (level == 0)
+		return 0;
+	return (uint64)(kTimerWheelLevelSize - 1)
+		<< ((level - 1) * kTimerWheelClockShift);
+}
+
+
+/*!	Removes  event from its slot or the expired list. */
+static void
+wheel_remove(timer_wheel& wheel, timer* event)
+{
+	timer** link = wheel_previous_link(event);
+	*link = event->next;
+	if (event->next != NULL)
+		wheel_set_previous_link(event->next, link);
+	event->next = NULL;
+
+	// If that emptied a slot, clear its pending bit.
+	if (*link == NULL && link >= wheel.slots
+		&& link < wheel.slots + kTimerWheelSlots) {
+		uint32 index = link - wheel.slots;
+		wheel.pending[index / kTimerWheelLevelSize]
+			&= ~((uint64)1 << (index % kTimerWheelLevelSize));
+	}
+
+	event->flags &= ~TIMER_IN_WHEEL;
+	wheel.count--;
+}
+
+
+/*!	Puts  event into the slot matching its schedule time and returns the
+	tick at which that slot expires.
+*/
+static uint64
+wheel_insert(timer_wheel& wheel, timer* event)
+{
+	// round up, so that the timer never expires early
+	uint64 expires = ((uint64)event->schedule_time
+		+ (1 << kTimerWheelTickShift) - 1) >> kTimerWheelTickShift;
+
+	uint32 level = 0;
+	uint64 bucket;
+	if (expires < wheel.clock) {
+		// already due -- put it into the next slot to be processed
+		bucket = wheel.clock;
+	} else {
+		uint64 delta = expires - wheel.clock;
+		while (level < kTimerWheelLevels - 1
+			&& delta >= wheel_level_start(level + 1)) {
+			level++;
+		}
+
+		if (delta >= wheel_level_start(kTimerWheelLevels)) {
+			// Too far in the future. Use the last slot, we'll requeue the
+			// timer when it expires.
+			expires = wheel.clock + wheel_level_start(kTimerWheelLevels)
+				- ((uint64)1 << wheel_level_shift(level));
+		}
+
+		// On level 0 every tick is processed, on the higher levels the slot
+		// of the current clock value may already have been processed.
+		bucket = level == 0
+			? expires : (expires >> wheel_level_shift(level)) + 1;
+	}
+
+	uint32 slot = bucket & kTimerWheelLevelMask;
+	wheel_list_add(&wheel.slots[level * kTimerWheelLevelSize + slot], event);
+	wheel.pending[level] |= (uint64)1 << slot;
+	wheel.count++;
+	event->flags |= TIMER_IN_WHEEL;
+
+	uint64 bucketExpiry = bucket << wheel_level_shift(level);
+	if (bucketExpiry < wheel.next_expiry)
+		wheel.next_expiry = bucketExpiry;
+
+	return bucketExpiry;
+}
+
+
+/*!	Computes the tick at which the next non-empty slot expires. */
+static uint64
+wheel_next_expiry(const timer_wheel& wheel)
+{
+	uint64 next = UINT64_MAX;
+	uint64 clock = wheel.clock;
+
+	for (uint32 level = 0; level < kTimerWheelLevels; level++) {
+		uint64 pending = wheel.pending[level];
+		if (pending != 0) {
+			// rotate the bitmap, so that bit 0 is the slot of the current
+			// clock value, and find the first non-empty slot from there
+			uint32 position = clock & kTimerWheelLevelMask;
+			if (position != 0) {
+				pending = (pending >> position)
+					| (pending << (kTimerWheelLevelSize - position));
+			}
+
+			uint64 expiry = (clock + __builtin_ctzll(pending))
+				<< wheel_level_shift(level);
+			if (expiry < next)
+				next = expiry;
+		}
+
+		// The next level's slot for the current clock value has been
+		// processed already, unless the clock is aligned to it.
+		uint64 adjust = (clock & kTimerWheelClockMask) != 0 ? 1 : 0;
+		clock = (clock >> kTimerWheelClockShift) + adjust;
+	}
+
+	return next;
+}
+
+
+/*!	Moves the wheel clock forward to  nowTick, if no slot expires before. */
+static void
+wheel_forward(timer_wheel& wheel, uint64 nowTick)
+{
+	if (nowTick <= wheel.clock)
+		return;
+
+	if (wheel.next_expiry <= nowTick) {
+		wheel.next_expiry = wheel_next_expiry(wheel);
+		if (wheel.next_expiry <= nowTick)
+			return;
+	}
+
+	wheel.clock = nowTick;
+}
+
+
+/*!	Moves all timers of the slots that have expired by  now to the expired
+	list.
+*/
+static void
+wheel_collect(timer_wheel& wheel, bigtime_t now)
+{
+	uint64 nowTick = (uint64)now >> kTimerWheelTickShift;
+	if (wheel.next_expiry > nowTick)
+		return;
+
+	while (true) {
+		uint64 next = wheel_next_expiry(wheel);
+		if (next > nowTick) {
+			wheel.next_expiry = next;
+			break;
+		}
+
+		wheel.clock = next;
+
+		uint64 clock = next;
+		for (uint32 level = 0; level < kTimerWheelLevels; level++) {
+			timer** slot = &wheel.slots[level * kTimerWheelLevelSize
+				+ (clock & kTimerWheelLevelMask)];
+
+			while (timer* event = *slot) {
+				wheel_remove(wheel, event);
+				if (event->schedule_time > now) {
+					// clamped to the end of the wheel before
+					wheel_insert(wheel, event);
+				} else {
+					wheel_list_add(&wheel.expired, event);
+					event->flags |= TIMER_IN_WHEEL;
+					wheel.count++;
+				}
+			}
+
+			if ((clock & kTimerWheelClockMask) != 0)
+				break;
+			clock >>= kTimerWheelClockShift;
+		}
+
+		wheel.clock++;
+	}
+
+	wheel_forward(wheel, nowTick);
+}
+
+
+/*!	Sets the hardware timer to the earlier of the first precise timer and the
+	next wheel slot expiry. Expects the CPU data lock to be held.
+*/
+static void
+set_next_hardware_timer(per_cpu_timer_data& cpuData, bigtime_t now)
+{
+	bigtime_t scheduleTime = B_INFINITE_TIMEOUT;
+	if (cpuData.events != NULL)
+		scheduleTime = cpuData.events->schedule_time;
+
+	timer_wheel& wheel = cpuData.wheel;
+	if (wheel.expired != NULL)
+		scheduleTime = now;
+	else if (wheel.count > 0) {
+		bigtime_t wheelTime
+			= (bigtime_t)(wheel.next_expiry << kTimerWheelTickShift);
+		if (wheelTime < scheduleTime)
+			scheduleTime = wheelTime;
+	}
+
+	if (scheduleTime != B_INFINITE_TIMEOUT)
+		set_hardware_timer(scheduleTime, now);
+	else
+		arch_timer_clear_hardware_timer();
+}
+
+
 static void
 per_cpu_real_time_clock_changed(void*, int cpu)
 {
@@ -151,13 +425,45 @@ per_cpu_real_time_clock_changed(void*, int cpu)
 
 	// If the first event has changed, reset the hardware timer.
 	if (firstEventChanged)
-		set_hardware_timer(cpuData.events->schedule_time);
+		set_next_hardware_timer(cpuData, system_time());
 }
 
 
 // #pragma mark - debugging
 
 
+static void
+dump_timer(timer* event)
+{
+	kprintf("  [%9lld] %p: ", (long long)event->schedule_time, event);
+	if ((event->flags & TIMER_IN_WHEEL) != 0)
+		kprintf("coarse,             ");
+	else if ((event->flags & ~B_TIMER_FLAGS) == B_PERIODIC_TIMER)
+		kprintf("periodic %9lld, ", (long long)event->period);
+	else
+		kprintf("one shot,           ");
+
+	kprintf("flags: %#x, user data: %p, callback: %p  ",
+		event->flags, event->user_data, event->hook);
+
+	// look up and print the hook function symbol
+	const char* symbol;
+	const char* imageName;
+	bool exactMatch;
+
+	status_t error = elf_debug_lookup_symbol_address(
+		(addr_t)event->hook, NULL, &symbol, &imageName, &exactMatch);
+	if (error == B_OK && exactMatch) {
+		if (const char* slash = strchr(imageName, '/'))
+			imageName = slash + 1;
+
+		kprintf("   %s:%s", imageName, symbol);
+	}
+
+	kprintf("\n");
+}
+
+
 static int
 dump_timers(int argc, char** argv)
 {
@@ -165,37 +471,34 @@ dump_timers(int argc, char** argv)
 	for (int32 i = 0; i < cpuCount; i++) {
 		kprintf("CPU %" B_PRId32 ":\n", i);
 
-		if (sPerCPU[i].events == NULL) {
+		timer_wheel& wheel = sPerCPU[i].wheel;
+		if (sPerCPU[i].events == NULL && wheel.count == 0) {
 			kprintf("  no timers scheduled\n");
 			continue;
 		}
 
 		for (timer* event = sPerCPU[i].events; event != NULL;
 				event = event->next) {
-			kprintf("  [%9lld] %p: ", (long long)event->schedule_time, event);
-			if ((event->flags & ~B_TIMER_FLAGS) == B_PERIODIC_TIMER)
-				kprintf("periodic %9lld, ", (long long)event->period);
-			else
-				kprintf("one shot,           ");
-
-			kprintf("flags: %#x, user data: %p, callback: %p  ",
-				event->flags, event->user_data, event->hook);
-
-			// look up and print the hook function symbol
-			const char* symbol;
-			const char* imageName;
-			bool exactMatch;
-
-			status_t error = elf_debug_lookup_symbol_address(
-				(addr_t)event->hook, NULL, &symbol, &imageName, &exactMatch);
-			if (error == B_OK && exactMatch) {
-				if (const char* slash = strchr(imageName, '/'))
-					imageName = slash + 1;
-
-				kprintf("   %s:%s", imageName, symbol);
-			}
+			dump_timer(event);
+		}
+
+		if (wheel.count == 0)
+			continue;
 
-			kprintf("\n");
+		kprintf("  timer wheel: %" B_PRId32 " timers, clock %" B_PRIu64
+			", next expiry %" B_PRIu64 "\n", wheel.count, wheel.clock,
+			wheel.next_expiry);
+
+		for (timer* event = wheel.expired; event != NULL;
+				event = event->next) {
+			dump_timer(event);
+		}
+
+		for (uint32 slot = 0; slot < kTimerWheelSlots; slot++) {
+			for (timer* event = wheel.slots[slot]; event != NULL;
+					event = event->next) {
+				dump_timer(event);
+			}
 		}
 	}
 
@@ -248,6 +551,7 @@ timer_interrupt()
 	timer* event;
 	spinlock* spinlock;
 	per_cpu_timer_data& cpuData = sPerCPU[smp_get_current_cpu()];
+	timer_wheel& wheel = cpuData.wheel;
 	int32 rc = B_HANDLED_INTERRUPT;
 
 	TRACE(("timer_interrupt: time %" B_PRIdBIGTIME ", cpu %" B_PRId32 "\n",
@@ -257,12 +561,27 @@ timer_interrupt()
 
 	acquire_spinlock(spinlock);
 
-	event = cpuData.events;
-	while (event != NULL && ((bigtime_t)event->schedule_time < system_time())) {
+	while (true) {
+		// expired wheel timers first, then the due precise ones
+		if (wheel.expired == NULL && wheel.count > 0)
+			wheel_collect(wheel, system_time());
+
+		event = wheel.expired;
+		if (event != NULL) {
+			wheel_remove(wheel, event);
+		} else {
+			event = cpuData.events;
+			if (event == NULL
+				|| (bigtime_t)event->schedule_time >= system_time()) {
+				break;
+			}
+
+			cpuData.events = (timer*)event->next;
+		}
+
 		// this event needs to happen
 		int mode = event->flags;
 
-		cpuData.events = (timer*)event->next;
 		cpuData.current_event = event;
 		atomic_set(&cpuData.current_event_in_progress, 1);
 
@@ -299,13 +618,11 @@ timer_interrupt()
 		}
 
 		cpuData.current_event = NULL;
-
-		event = cpuData.events;
 	}
 
 	// setup the next hardware timer
-	if (cpuData.events != NULL)
-		set_hardware_timer(cpuData.events->schedule_time);
+	if (cpuData.events != NULL || wheel.count > 0)
+		set_next_hardware_timer(cpuData, system_time());
 
 	release_spinlock(spinlock);
 
@@ -343,6 +660,13 @@ add_timer(timer* event, timer_hook hook, bigtime_t period, int32 flags)
 	event->hook = hook;
 	event->flags = flags;
 
+	// Only one-shot system time based timers can go into the timer wheel,
+	// and short ones are always kept precise.
+	bool coarse = (flags & B_TIMER_COARSE) != 0
+		&& (flags & ~B_TIMER_FLAGS) != B_PERIODIC_TIMER
+		&& (flags & B_TIMER_REAL_TIME_BASE) == 0
+		&& scheduleTime - currentTime >= kTimerWheelMinDelay;
+
 	state = disable_interrupts();
 	int currentCPU = smp_get_current_cpu();
 	per_cpu_timer_data& cpuData = sPerCPU[currentCPU];
@@ -358,12 +682,26 @@ add_timer(timer* event, timer_hook hook, bigtime_t period, int32 flags)
 			event->schedule_time = 0;
 	}
 
-	add_event_to_list(event, &cpuData.events);
-	event->cpu = currentCPU;
+	if (coarse) {
+		timer_wheel& wheel = cpuData.wheel;
+		uint64 previousExpiry
+			= wheel.count > 0 ? wheel.next_expiry : UINT64_MAX;
 
-	// if we were stuck at the head of the list, set the hardware timer
-	if (event == cpuData.events)
-		set_hardware_timer(scheduleTime, currentTime);
+		wheel_forward(wheel, (uint64)currentTime >> kTimerWheelTickShift);
+		uint64 expiry = wheel_insert(wheel, event);
+		event->cpu = currentCPU;
+
+		// if our slot is the first to expire, update the hardware timer
+		if (expiry < previousExpiry)
+			set_next_hardware_timer(cpuData, currentTime);
+	} else {
+		add_event_to_list(event, &cpuData.events);
+		event->cpu = currentCPU;
+
+		// if we were stuck at the head of the list, set the hardware timer
+		if (event == cpuData.events)
+			set_next_hardware_timer(cpuData, currentTime);
+	}
 
 	release_spinlock(&cpuData.lock);
 	restore_interrupts(state);
@@ -397,6 +735,14 @@ cancel_timer(timer* event)
 
 	per_cpu_timer_data& cpuData = sPerCPU[cpu];
 
+	if (event != cpuData.current_event
+		&& (event->flags & TIMER_IN_WHEEL) != 0) {
+		// The timer is still in the timer wheel.
+		wheel_remove(cpuData.wheel, event);
+		event->cpu = 0xffff;
+		return false;
+	}
+
 	if (event != cpuData.current_event) {
 		// The timer hook is not yet being executed.
 		timer* current = cpuData.events;
@@ -426,12 +772,8 @@ cancel_timer(timer* event)
 		event->cpu = 0xffff;
 
 		// If on the current CPU, also reset the hardware timer.
-		if (cpu == smp_get_current_cpu()) {
-			if (cpuData.events == NULL)
-				arch_timer_clear_hardware_timer();
-			else
-				set_hardware_timer(cpuData.events->schedule_time);
-		}
+		if (cpu == smp_get_current_cpu())
+			set_next_hardware_timer(cpuData, system_time());
 
 		return false;
 	}
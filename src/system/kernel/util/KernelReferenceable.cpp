@@ -9,6 +9,27 @@
 #include <int.h>
 
 
+/*!	Acquires a reference, unless the object's reference count has already
+	dropped to zero, i.e. it is about to be deleted. Meant for lookups that
+	find objects without holding the lock that protects their removal.
+	Returns whether a reference has been acquired.
+*/
+bool
+KernelReferenceable::TryAcquireReference()
+{
+	int32 count = atomic_get(&fReferenceCount);
+	while (count > 0) {
+		int32 previous = atomic_test_and_set(&fReferenceCount, count + 1,
+			count);
+		if (previous == count)
+			return true;
+		count = previous;
+	}
+
+	return false;
+}
+
+
 void
 KernelReferenceable::LastReferenceReleased()
 {
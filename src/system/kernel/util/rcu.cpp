@@ -0,0 +1,171 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include <util/rcu.h>
+
+#include <stdlib.h>
+
+#include <KernelExport.h>
+
+#include <util/AutoLock.h>
+
+
+//#define TRACE_RCU
+#ifdef TRACE_RCU
+#	define TRACE(x...) dprintf("rcu: " x)
+#else
+#	define TRACE(x...) do {} while (false)
+#endif
+
+
+int64 gRCUGeneration = 0;
+
+static spinlock sPendingLock = B_SPINLOCK_INITIALIZER;
+static rcu_head* sPendingHead = NULL;
+static rcu_head* sPendingTail = NULL;
+static bool sGracePeriodStalled = false;
+
+
+/*!	Returns the oldest generation any CPU has seen at its last quiescent state.
+	Callbacks queued with a generation older than that can safely be invoked.
+*/
+static int64
+oldest_quiescent_generation()
+{
+	int32 cpuCount = smp_get_num_cpus();
+	int64 oldest = atomic_get64(&gCPU[0].rcu_generation);
+
+	for (int32 i = 1; i < cpuCount; i++) {
+		int64 generation = atomic_get64(&gCPU[i].rcu_generation);
+		if (generation < oldest)
+			oldest = generation;
+	}
+
+	return oldest;
+}
+
+
+/*!	Invoked on all CPUs via ICI. Since read-side critical sections are run
+	with interrupts disabled, a CPU handling the ICI cannot be inside one.
+*/
+static void
+force_quiescent_state(void* /*cookie*/, int cpu)
+{
+	rcu_quiescent_state(cpu);
+}
+
+
+/*!	Kernel daemon hook that invokes all callbacks whose grace period has
+	ended. CPUs normally pass their quiescent states through context switches;
+	if some didn't for a whole daemon period (e.g. because they are idle), a
+	quiescent state is forced on all of them.
+*/
+static void
+rcu_reclaim(void* /*cookie*/, int /*iteration*/)
+{
+	InterruptsSpinLocker locker(sPendingLock);
+	rcu_head* pending = sPendingHead;
+	sPendingHead = sPendingTail = NULL;
+	locker.Unlock();
+
+	if (pending == NULL) {
+		sGracePeriodStalled = false;
+		return;
+	}
+
+	if (sGracePeriodStalled) {
+		TRACE("forcing quiescent state\n");
+		call_all_cpus_sync(&force_quiescent_state, NULL);
+	}
+
+	int64 oldest = oldest_quiescent_generation();
+
+	rcu_head* keepHead = NULL;
+	rcu_head* keepTail = NULL;
+
+	while (pending != NULL) {
+		rcu_head* head = pending;
+		pending = head->next;
+
+		if (head->generation < oldest) {
+			head->callback(head->cookie);
+			continue;
+		}
+
+		head->next = NULL;
+		if (keepTail != NULL)
+			keepTail->next = head;
+		else
+			keepHead = head;
+		keepTail = head;
+	}
+
+	sGracePeriodStalled = keepHead != NULL;
+	if (keepHead == NULL)
+		return;
+
+	// requeue the callbacks that still have to wait
+	locker.Lock();
+	keepTail->next = sPendingHead;
+	if (sPendingHead == NULL)
+		sPendingTail = keepTail;
+	sPendingHead = keepHead;
+}
+
+
+// #pragma mark - kernel private API
+
+
+/*!	Schedules \a callback to be invoked with \a cookie once all read-side
+	critical sections that might still reference the object have ended.
+	\a head must remain valid until then.
+	May be called with interrupts disabled. The callback is invoked with
+	interrupts enabled.
+*/
+void
+rcu_call(rcu_head* head, rcu_callback callback, void* cookie)
+{
+	head->callback = callback;
+	head->cookie = cookie;
+	head->next = NULL;
+	head->generation = atomic_add64(&gRCUGeneration, 1);
+
+	InterruptsSpinLocker locker(sPendingLock);
+	if (sPendingTail != NULL)
+		sPendingTail->next = head;
+	else
+		sPendingHead = head;
+	sPendingTail = head;
+}
+
+
+/*!	free()s \a memory once all current read-side critical sections have
+	ended. \a head must be located within \a memory or otherwise stay valid
+	until then.
+*/
+void
+rcu_free(rcu_head* head, void* memory)
+{
+	rcu_call(head, &free, memory);
+}
+
+
+/*!	Waits until all read-side critical sections currently in progress have
+	ended. Interrupts must be enabled.
+*/
+void
+rcu_synchronize(void)
+{
+	atomic_add64(&gRCUGeneration, 1);
+	call_all_cpus_sync(&force_quiescent_state, NULL);
+}
+
+
+status_t
+rcu_init(void)
+{
+	return register_kernel_daemon(&rcu_reclaim, NULL, 1);
+}
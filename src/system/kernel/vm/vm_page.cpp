@@ -1657,11 +1657,13 @@ set_page_state(vm_page *page, int pageState)
 	}
 
 	VMCache* cache = page->Cache();
-	if (cache != NULL && cache->temporary) {
-		if (pageState == PAGE_STATE_MODIFIED)
-			atomic_add(&sModifiedTemporaryPages, 1);
-		else if (page->State() == PAGE_STATE_MODIFIED)
-			atomic_add(&sModifiedTemporaryPages, -1);
+	if (cache != NULL && (pageState == PAGE_STATE_MODIFIED
+			|| page->State() == PAGE_STATE_MODIFIED)) {
+		int32 delta = pageState == PAGE_STATE_MODIFIED ? 1 : -1;
+		if (cache->temporary)
+			atomic_add(&sModifiedTemporaryPages, delta);
+		else
+			cache->ModifiedPageCountChanged(delta);
 	}
 
 	// move the page
@@ -4022,8 +4024,12 @@ vm_page_free_etc(VMCache* cache, vm_page* page,
 	PAGE_ASSERT(page, page->State() != PAGE_STATE_FREE
 		&& page->State() != PAGE_STATE_CLEAR);
 
-	if (page->State() == PAGE_STATE_MODIFIED && cache->temporary)
-		atomic_add(&sModifiedTemporaryPages, -1);
+	if (page->State() == PAGE_STATE_MODIFIED) {
+		if (cache->temporary)
+			atomic_add(&sModifiedTemporaryPages, -1);
+		else
+			cache->ModifiedPageCountChanged(-1);
+	}
 
 	free_page(page, false);
 	if (reservation == NULL)
@@ -99,6 +99,22 @@ fs_stat_attr(int fd, const char* attribute, struct attr_info* attrInfo)
 }
 
 
+extern "C" int
+fs_read_attrs(int fd, struct attr_io_vec* vecs, size_t count)
+{
+	status_t status = _kern_read_attrs(fd, vecs, count);
+	RETURN_AND_SET_ERRNO(status);
+}
+
+
+extern "C" int
+fs_write_attrs(int fd, struct attr_io_vec* vecs, size_t count)
+{
+	status_t status = _kern_write_attrs(fd, vecs, count);
+	RETURN_AND_SET_ERRNO(status);
+}
+
+
 int
 fs_open_attr(const char *path, const char *attribute, uint32 type, int openMode)
 {
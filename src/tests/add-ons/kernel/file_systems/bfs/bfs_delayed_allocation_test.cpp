@@ -0,0 +1,174 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * This file may be used under the terms of the MIT License.
+ */
+
+
+/*!	Writes a file without letting its blocks be allocated, fills the rest
+	of the volume with files, directories, and attributes, and then checks
+	that the data written first can still be written back.
+	Since it fills the volume, it must be run on a scratch BFS volume.
+*/
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fs_attr.h>
+#include <TypeConstants.h>
+
+
+static const size_t kDelayedSize = 4 * 1024 * 1024;
+static const size_t kChunkSize = 64 * 1024;
+
+
+static void
+fill_pattern(uint8_t* buffer, size_t size, off_t offset)
+{
+	for (size_t i = 0; i < size; i++)
+		buffer[i] = (uint8_t)((offset + i) * 31 / 7);
+}
+
+
+static int
+fill_volume(const char* directory)
+{
+	char path[PATH_MAX];
+	char buffer[kChunkSize];
+	memset(buffer, 0x55, sizeof(buffer));
+
+	// data of other files
+	int count = 0;
+	for (;; count++) {
+		snprintf(path, sizeof(path), "%s/data-%d", directory, count);
+		int fd = open(path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+		if (fd < 0)
+			break;
+
+		ssize_t written;
+		while ((written = write(fd, buffer, sizeof(buffer))) > 0)
+			;
+		int error = fsync(fd) != 0 ? errno : 0;
+		close(fd);
+
+		if (written < 0 || error != 0)
+			break;
+	}
+
+	// new inodes, B+tree nodes, and attributes
+	for (int i = 0;; i++) {
+		snprintf(path, sizeof(path), "%s/dir-%d", directory, i);
+		if (mkdir(path, 0755) != 0)
+			break;
+
+		snprintf(path, sizeof(path), "%s/dir-%d/file", directory, i);
+		int fd = open(path, O_CREAT | O_WRONLY, 0644);
+		if (fd < 0)
+			break;
+
+		ssize_t written = fs_write_attr(fd, "test:attribute", B_RAW_TYPE, 0,
+			buffer, sizeof(buffer));
+		close(fd);
+
+		if (written < 0)
+			break;
+	}
+
+	return count;
+}
+
+
+static void
+remove_files(const char* directory)
+{
+	char command[PATH_MAX + 32];
+	snprintf(command, sizeof(command), "rm -rf \"%s\"", directory);
+	system(command);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s <directory on a scratch BFS volume>\n",
+			argv[0]);
+		return 1;
+	}
+
+	char directory[PATH_MAX];
+	snprintf(directory, sizeof(directory), "%s/bfs_delayed_allocation_test",
+		argv[1]);
+	if (mkdir(directory, 0755) != 0) {
+		fprintf(stderr, "Could not create \"%s\": %s\n", directory,
+			strerror(errno));
+		return 1;
+	}
+
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/delayed", directory);
+	int fd = open(path, O_CREAT | O_TRUNC | O_RDWR, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "Could not create \"%s\": %s\n", path,
+			strerror(errno));
+		remove_files(directory);
+		return 1;
+	}
+
+	// the blocks of this data are only reserved, not allocated yet
+	uint8_t* buffer = (uint8_t*)malloc(kChunkSize);
+	for (off_t offset = 0; offset < (off_t)kDelayedSize;
+			offset += kChunkSize) {
+		fill_pattern(buffer, kChunkSize, offset);
+		if (write(fd, buffer, kChunkSize) != (ssize_t)kChunkSize) {
+			fprintf(stderr, "Writing the delayed data failed: %s\n",
+				strerror(errno));
+			remove_files(directory);
+			return 1;
+		}
+	}
+
+	int files = fill_volume(directory);
+	printf("Filled the volume with %d files.\n", files);
+
+	int result = 0;
+	if (fsync(fd) != 0) {
+		fprintf(stderr, "Writing back the delayed data failed: %s\n",
+			strerror(errno));
+		result = 1;
+	}
+
+	uint8_t* pattern = (uint8_t*)malloc(kChunkSize);
+	for (off_t offset = 0; result == 0 && offset < (off_t)kDelayedSize;
+			offset += kChunkSize) {
+		fill_pattern(pattern, kChunkSize, offset);
+		if (pread(fd, buffer, kChunkSize, offset) != (ssize_t)kChunkSize
+			|| memcmp(buffer, pattern, kChunkSize) != 0) {
+			fprintf(stderr, "The delayed data differs at %lld\n",
+				(long long)offset);
+			result = 1;
+		}
+	}
+
+	struct stat st;
+	if (result == 0 && (fstat(fd, &st) != 0
+			|| st.st_blocks * 512 < (off_t)kDelayedSize)) {
+		fprintf(stderr, "The delayed data has no blocks\n");
+		result = 1;
+	}
+
+	close(fd);
+	free(buffer);
+	free(pattern);
+	remove_files(directory);
+
+	if (result == 0)
+		printf("All tests passed.\n");
+	return result;
+}
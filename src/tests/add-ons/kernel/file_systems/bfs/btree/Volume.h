@@ -17,7 +17,7 @@ class BFile;
 
 class Volume {
 	public:
-		Volume(BFile *file) : fFile(file) {}
+		Volume(BFile *file) : fFile(file), fFeatures(0) {}
 
 		bool IsInitializing() const { return false; }
 		bool IsValidInodeBlock(off_t) const { return true; }
@@ -35,12 +35,17 @@ class Volume {
 			return block_run::Run(0, 0, block);
 		}
 
+		bool HasFeature(uint32 feature) const
+			{ return (fFeatures & feature) != 0; }
+		void SetFeatures(uint32 features) { fFeatures = features; }
+
 		static void Panic();
 
 		int32 GenerateTransactionID();
 
 	private:
 		BFile	*fFile;
+		uint32	fFeatures;
 };
 
 
@@ -31,6 +31,8 @@ static size_t sBlockSize;
 
 
 BList gBlocks;
+int32 gBlockGets;
+	// counts the calls to block_cache_get()
 
 
 void
@@ -118,6 +120,7 @@ const void*
 block_cache_get(void* _cache, off_t blockNumber)
 {
 	TRACE(("block_cache_get(block = %" B_PRIdOFF ")\n", blockNumber));
+	gBlockGets++;
 	return get_block(_cache, blockNumber);
 }
 
@@ -42,7 +42,7 @@ key* gKeys;
 int32 gNum = DEFAULT_NUM_KEYS;
 int32 gType = DEFAULT_KEY_TYPE;
 int32 gTreeCount = 0;
-bool gVerbose, gExcessive;
+bool gVerbose, gExcessive, gPrefixKeys, gStatistics, gPathKeys;
 int32 gIterations = DEFAULT_ITERATIONS;
 int32 gHard = 1;
 Volume* gVolume;
@@ -50,6 +50,7 @@ int32 gSeed = 42;
 
 // from cache.cpp (yes, we are that mean)
 extern BList gBlocks;
+extern int32 gBlockGets;
 
 
 // prototypes
@@ -182,6 +183,19 @@ dumpKeys()
 void
 generateName(int32 i, char* name, int32* _length)
 {
+	if (gPathKeys) {
+		// path-like names share long prefixes, like in the "path" index
+		static const char* kDirectories[] = {
+			"/boot/home/Desktop/",
+			"/boot/home/config/settings/",
+			"/boot/home/mail/inbox/",
+			"/boot/system/data/fonts/ttfonts/"
+		};
+		*_length = sprintf(name, "%sfolder-%02d/file-%05d",
+			kDirectories[rand() % 4], rand() % 32, rand() % 100000);
+		return;
+	}
+
 	int32 length = rand() % (MAX_STRING - MIN_STRING) + MIN_STRING;
 	for (int32 i = 0; i < length; i++) {
 		int32 c = int32(52.0 * rand() / RAND_MAX);
@@ -416,6 +430,37 @@ checkTree(BPlusTree* tree)
 }
 
 
+/*!	Prints the number of nodes in use, the height of the tree, and the
+	number of blocks that have to be read to find a key.
+*/
+void
+printStatistics(BPlusTree* tree)
+{
+	bplustree_header* header = (bplustree_header*)gBlocks.ItemAt(0);
+	int32 nodes = 0;
+	for (int32 i = 1; i < header->MaximumSize() / BPLUSTREE_NODE_SIZE; i++) {
+		bplustree_node* node = (bplustree_node*)gBlocks.ItemAt(i);
+		if (node->OverflowLink() != BPLUSTREE_FREE)
+			nodes++;
+	}
+
+	TreeIterator iterator(tree);
+	int32 lookups = 0;
+	gBlockGets = 0;
+	for (int32 i = 0; i < gNum; i++) {
+		if (gKeys[i].in == 0)
+			continue;
+
+		iterator.Find((uint8*)gKeys[i].data, gKeys[i].length);
+		lookups++;
+	}
+
+	printf("* %ld keys in %ld nodes, %ld levels, %.2f blocks per lookup\n",
+		gTreeCount, nodes, header->MaxNumberOfLevels(),
+		lookups > 0 ? 1.0 * gBlockGets / lookups : 0.0);
+}
+
+
 //	#pragma mark - "Torture" functions
 
 
@@ -620,11 +665,12 @@ usage(char* program)
 {
 	if (strrchr(program, '/'))
 		program = strrchr(program, '/') + 1;
-	fprintf(stderr, "usage: %s [-veh] [-t type] [-n keys] [-i iterations] "
+	fprintf(stderr, "usage: %s [-vepsh] [-t type] [-n keys] [-i iterations] "
 			"[-h times] [-r seed]\n"
 		"BFS B+Tree torture test\n"
-		"\t-t\ttype is one of string, int32, uint32, int64, uint64, float,\n"
-		"\t\tor double; defaults to string.\n"
+		"\t-t\ttype is one of string, path, int32, uint32, int64, uint64,\n"
+		"\t\tfloat, or double; defaults to string. \"path\" are strings\n"
+		"\t\twith long common prefixes.\n"
 		"\t-n\tkeys is the number of keys to be used,\n"
 		"\t\tminimum is 1, defaults to %d.\n"
 		"\t-i\titerations is the number of the test cycles, defaults to %d.\n"
@@ -632,6 +678,8 @@ usage(char* program)
 		"\t-h\tremoves the keys and start over again for x times.\n"
 		"\t-e\texcessive validity tests: tree contents will be tested after "
 			"every operation\n"
+		"\t-p\tstore the keys with their common prefix only once per node.\n"
+		"\t-s\tprint the size of the tree, and the blocks read per lookup.\n"
 		"\t-v\tfor verbose output.\n",
 		program, DEFAULT_NUM_KEYS, DEFAULT_ITERATIONS, gSeed);
 	exit(0);
@@ -657,12 +705,22 @@ main(int argc, char** argv)
 					case 'e':
 						gExcessive = true;
 						break;
+					case 'p':
+						gPrefixKeys = true;
+						break;
+					case 's':
+						gStatistics = true;
+						break;
 					case 't':
 						if (*++argv == NULL)
 							usage(program);
 
 						if (!strcmp(*argv, "string"))
 							gType = S_STR_INDEX;
+						else if (!strcmp(*argv, "path")) {
+							gType = S_STR_INDEX;
+							gPathKeys = true;
+						}
 						else if (!strcmp(*argv, "int32")
 							|| !strcmp(*argv, "int"))
 							gType = S_INT_INDEX;
@@ -726,6 +784,7 @@ main(int argc, char** argv)
 	Inode inode("tree.data", gType | S_ALLOW_DUPS);
 	rw_lock_write_lock(&inode.Lock());
 	gVolume = inode.GetVolume();
+	gVolume->SetFeatures(gPrefixKeys ? SUPER_BLOCK_FEATURE_PREFIX_KEYS : 0);
 	Transaction transaction(gVolume, 0);
 
 	init_cache(gVolume->Device(), gVolume->BlockSize());
@@ -751,6 +810,8 @@ main(int argc, char** argv)
 
 	for (int32 j = 0; j < gHard; j++) {
 		addAllKeys(transaction, &tree);
+		if (gStatistics)
+			printStatistics(&tree);
 
 		// Run the tests (they will exit the app, if an error occurs)
 
@@ -764,6 +825,8 @@ main(int argc, char** argv)
 				int32(1.0 * gNum * rand() / RAND_MAX));
 			duplicateTest(transaction, &tree);
 		}
+		if (gStatistics)
+			printStatistics(&tree);
 
 		removeAllKeys(transaction, &tree);
 	}
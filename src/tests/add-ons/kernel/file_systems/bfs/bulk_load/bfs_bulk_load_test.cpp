@@ -0,0 +1,688 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * This file may be used under the terms of the MIT License.
+ */
+
+/*!	Sorts entries with small runs of the KeySorter, bulk-loads B+trees from
+	them into memory, and checks the structure of the trees: the keys of
+	the inner nodes, the sibling links of each level, the duplicates, the
+	list of free nodes, and that every entry can be found.
+*/
+
+
+#include "BPlusTreeLoader.h"
+
+#include <file_systems/QueryParserUtils.h>
+
+
+static int32 sFailed;
+
+
+static void
+report(const char* name, bool ok)
+{
+	if (!ok) {
+		printf("FAILED %s\n", name);
+		sFailed++;
+	} else
+		printf("ok     %s\n", name);
+}
+
+
+struct test_entry {
+	uint8	key[16];
+	uint16	length;
+	off_t	value;
+};
+
+
+/*!	Keeps the whole tree in memory, and makes sure that each node is
+	written exactly once.
+*/
+class MemoryLoader : public BPlusTreeLoader {
+public:
+	MemoryLoader(uint32 blockSize, type_code type)
+		:
+		BPlusTreeLoader(BPLUSTREE_NODE_SIZE, blockSize, type),
+		fData(NULL),
+		fWritten(NULL),
+		fSize(0),
+		fErrors(0)
+	{
+	}
+
+	~MemoryLoader()
+	{
+		free(fData);
+		free(fWritten);
+	}
+
+	status_t Allocate()
+	{
+		fSize = Size();
+		fData = (uint8*)calloc(1, fSize);
+		fWritten = (uint8*)calloc(1, fSize / BPLUSTREE_NODE_SIZE);
+		return fData != NULL && fWritten != NULL ? B_OK : B_NO_MEMORY;
+	}
+
+	virtual status_t WriteNodes(off_t offset, const uint8* buffer,
+		size_t size)
+	{
+		if (offset < BPLUSTREE_NODE_SIZE || offset + (off_t)size > fSize
+			|| offset % BPLUSTREE_NODE_SIZE != 0
+			|| size % BPLUSTREE_NODE_SIZE != 0) {
+			fErrors++;
+			return B_BAD_VALUE;
+		}
+
+		for (size_t i = 0; i < size / BPLUSTREE_NODE_SIZE; i++) {
+			if (fWritten[offset / BPLUSTREE_NODE_SIZE + i]++ != 0)
+				fErrors++;
+		}
+
+		memcpy(fData + offset, buffer, size);
+		return B_OK;
+	}
+
+	const bplustree_node* NodeAt(off_t offset) const
+	{
+		if (offset < BPLUSTREE_NODE_SIZE || offset >= fSize
+			|| offset % BPLUSTREE_NODE_SIZE != 0)
+			return NULL;
+
+		return (const bplustree_node*)(fData + offset);
+	}
+
+	bool AllWritten() const
+	{
+		for (off_t i = 1; i < fSize / BPLUSTREE_NODE_SIZE; i++) {
+			if (fWritten[i] != 1)
+				return false;
+		}
+		return fErrors == 0;
+	}
+
+private:
+	uint8*	fData;
+	uint8*	fWritten;
+	off_t	fSize;
+	int32	fErrors;
+};
+
+
+class TreeChecker {
+public:
+	TreeChecker(MemoryLoader& loader, type_code type)
+		:
+		fLoader(loader),
+		fType(type),
+		fUsed((uint8*)calloc(1, loader.Size() / BPLUSTREE_NODE_SIZE)),
+		fFirstLeaf(BPLUSTREE_NULL),
+		fErrors(0)
+	{
+		for (int32 i = 0; i < BPlusTreeLoader::kMaxLevels; i++)
+			fLastOfLevel[i] = BPLUSTREE_NULL;
+	}
+
+	~TreeChecker()
+	{
+		free(fUsed);
+	}
+
+	bool Check(const test_entry* entries, int32 count)
+	{
+		uint8 lastKey[BPLUSTREE_MAX_KEY_LENGTH];
+		uint16 lastLength;
+		_CheckNode(fLoader.RootNode(), fLoader.CountLevels() - 1, lastKey,
+			lastLength);
+
+		for (int32 level = 0; level < (int32)fLoader.CountLevels(); level++) {
+			const bplustree_node* node = fLoader.NodeAt(fLastOfLevel[level]);
+			if (node == NULL || node->RightLink() != BPLUSTREE_NULL)
+				fErrors++;
+		}
+
+		_CheckEntries(entries, count);
+		_CheckFreeList();
+
+		for (int32 i = 0; i < count; i += 7) {
+			if (!_Find(entries[i].key, entries[i].length))
+				fErrors++;
+		}
+
+		return fErrors == 0;
+	}
+
+private:
+	int _Compare(const uint8* key1, uint16 length1, const uint8* key2,
+		uint16 length2) const
+	{
+		return QueryParser::compareKeys(fType, key1, length1, key2, length2);
+	}
+
+	const uint8* _KeyAt(const bplustree_node* node, int32 index,
+		uint16& _length) const
+	{
+		Unaligned<uint16>* keyLengths = node->KeyLengths();
+		uint16 start = index > 0
+			? BFS_ENDIAN_TO_HOST_INT16(keyLengths[index - 1]) : 0;
+		_length = BFS_ENDIAN_TO_HOST_INT16(keyLengths[index]) - start;
+		return node->Keys() + start;
+	}
+
+	bool _Use(off_t offset)
+	{
+		const bplustree_node* node = fLoader.NodeAt(offset);
+		if (node == NULL || fUsed[offset / BPLUSTREE_NODE_SIZE]) {
+			fErrors++;
+			return false;
+		}
+
+		fUsed[offset / BPLUSTREE_NODE_SIZE] = 1;
+		return true;
+	}
+
+	//!	Checks the subtree, and returns its last key.
+	void _CheckNode(off_t offset, int32 level, uint8* lastKey,
+		uint16& lastLength)
+	{
+		lastLength = 0;
+		if (!_Use(offset))
+			return;
+
+		const bplustree_node* node = fLoader.NodeAt(offset);
+		if (node->Used() > BPLUSTREE_NODE_SIZE
+			|| node->LeftLink() != fLastOfLevel[level]
+			|| (level == 0) != node->IsLeaf()) {
+			fErrors++;
+			return;
+		}
+		if (fLastOfLevel[level] != BPLUSTREE_NULL
+			&& fLoader.NodeAt(fLastOfLevel[level])->RightLink() != offset)
+			fErrors++;
+		fLastOfLevel[level] = offset;
+
+		if (level == 0) {
+			if (fFirstLeaf == BPLUSTREE_NULL)
+				fFirstLeaf = offset;
+			if (node->NumKeys() > 0) {
+				const uint8* key = _KeyAt(node, node->NumKeys() - 1,
+					lastLength);
+				memcpy(lastKey, key, lastLength);
+			}
+			return;
+		}
+
+		// the key of each child is its last key
+		uint8 childKey[BPLUSTREE_MAX_KEY_LENGTH];
+		uint16 childLength;
+		const uint8* previous = NULL;
+		uint16 previousLength = 0;
+
+		for (int32 i = 0; i < node->NumKeys(); i++) {
+			uint16 length;
+			const uint8* key = _KeyAt(node, i, length);
+			if (previous != NULL
+				&& _Compare(previous, previousLength, key, length) >= 0)
+				fErrors++;
+
+			_CheckNode(BFS_ENDIAN_TO_HOST_INT64(node->Values()[i]), level - 1,
+				childKey, childLength);
+			if (_Compare(childKey, childLength, key, length) != 0)
+				fErrors++;
+
+			previous = key;
+			previousLength = length;
+		}
+
+		_CheckNode(node->OverflowLink(), level - 1, lastKey, lastLength);
+		if (previous != NULL
+			&& _Compare(previous, previousLength, lastKey, lastLength) >= 0)
+			fErrors++;
+	}
+
+	void _CheckEntries(const test_entry* entries, int32 count)
+	{
+		int32 index = 0;
+		off_t offset = fFirstLeaf;
+
+		while (offset != BPLUSTREE_NULL) {
+			const bplustree_node* node = fLoader.NodeAt(offset);
+			if (node == NULL) {
+				fErrors++;
+				return;
+			}
+
+			for (int32 i = 0; i < node->NumKeys(); i++) {
+				uint16 length;
+				const uint8* key = _KeyAt(node, i, length);
+				off_t value = BFS_ENDIAN_TO_HOST_INT64(node->Values()[i]);
+
+				off_t values[1024];
+				int32 valueCount = _Values(value, values, 1024);
+				for (int32 j = 0; j < valueCount; j++, index++) {
+					if (index >= count
+						|| _Compare(key, length, entries[index].key,
+							entries[index].length) != 0
+						|| values[j] != entries[index].value) {
+						fErrors++;
+						return;
+					}
+				}
+			}
+
+			offset = node->RightLink();
+		}
+
+		if (index != count)
+			fErrors++;
+	}
+
+	int32 _Values(off_t value, off_t* values, int32 maxCount)
+	{
+		if (!bplustree_node::IsDuplicate(value)) {
+			values[0] = value;
+			return 1;
+		}
+
+		off_t offset = bplustree_node::FragmentOffset(value);
+
+		if (bplustree_node::LinkType(value) == BPLUSTREE_DUPLICATE_FRAGMENT) {
+			const bplustree_node* node = fLoader.NodeAt(offset);
+			if (node == NULL || bplustree_node::FragmentIndex(value)
+					>= bplustree_node::MaxFragments(BPLUSTREE_NODE_SIZE)) {
+				fErrors++;
+				return 0;
+			}
+			if (!fUsed[offset / BPLUSTREE_NODE_SIZE])
+				_Use(offset);
+
+			const off_t* array = (const off_t*)node->FragmentAt(
+				bplustree_node::FragmentIndex(value));
+			int32 count = BFS_ENDIAN_TO_HOST_INT64(array[0]);
+			if (count < 2 || count > NUM_FRAGMENT_VALUES) {
+				fErrors++;
+				return 0;
+			}
+			for (int32 i = 0; i < count; i++)
+				values[i] = BFS_ENDIAN_TO_HOST_INT64(array[i + 1]);
+			return count;
+		}
+
+		int32 count = 0;
+		off_t previous = BPLUSTREE_NULL;
+		while (offset != BPLUSTREE_NULL) {
+			if (!_Use(offset))
+				return 0;
+
+			const bplustree_node* node = fLoader.NodeAt(offset);
+			const off_t* array = (const off_t*)node->DuplicateArray();
+			int32 arrayCount = BFS_ENDIAN_TO_HOST_INT64(array[0]);
+			if (node->LeftLink() != previous || arrayCount < 1
+				|| arrayCount > NUM_DUPLICATE_VALUES
+				|| count + arrayCount > maxCount) {
+				fErrors++;
+				return 0;
+			}
+			for (int32 i = 0; i < arrayCount; i++)
+				values[count++] = BFS_ENDIAN_TO_HOST_INT64(array[i + 1]);
+
+			previous = offset;
+			offset = node->RightLink();
+		}
+		return count;
+	}
+
+	//!	All nodes that are not part of the tree must be in the free list.
+	void _CheckFreeList()
+	{
+		off_t offset = fLoader.FreeNode();
+		while (offset != BPLUSTREE_NULL) {
+			if (!_Use(offset))
+				return;
+
+			const bplustree_node* node = fLoader.NodeAt(offset);
+			if (node->OverflowLink() != BPLUSTREE_FREE) {
+				fErrors++;
+				return;
+			}
+			offset = node->LeftLink();
+		}
+
+		for (off_t i = 1; i < fLoader.Size() / BPLUSTREE_NODE_SIZE; i++) {
+			if (!fUsed[i])
+				fErrors++;
+		}
+	}
+
+	//!	Looks up the key like BPlusTree::_FindKey() does.
+	bool _Find(const uint8* key, uint16 keyLength)
+	{
+		off_t offset = fLoader.RootNode();
+
+		for (uint32 level = fLoader.CountLevels(); level-- > 0;) {
+			const bplustree_node* node = fLoader.NodeAt(offset);
+			if (node == NULL)
+				return false;
+
+			int32 i = 0;
+			for (; i < node->NumKeys(); i++) {
+				uint16 length;
+				const uint8* nodeKey = _KeyAt(node, i, length);
+				int compare = _Compare(key, keyLength, nodeKey, length);
+				if (compare == 0 && level == 0)
+					return true;
+				if (compare <= 0)
+					break;
+			}
+			if (level == 0)
+				return false;
+
+			offset = i < node->NumKeys()
+				? BFS_ENDIAN_TO_HOST_INT64(node->Values()[i])
+				: node->OverflowLink();
+		}
+		return false;
+	}
+
+private:
+	MemoryLoader&	fLoader;
+	type_code		fType;
+	uint8*			fUsed;
+	off_t			fLastOfLevel[BPlusTreeLoader::kMaxLevels];
+	off_t			fFirstLeaf;
+	int32			fErrors;
+};
+
+
+static int
+compare_entries(const void* _first, const void* _second)
+{
+	const test_entry* first = (const test_entry*)_first;
+	const test_entry* second = (const test_entry*)_second;
+
+	int compare = QueryParser::compareKeys(
+		first->length == sizeof(int64) ? B_INT64_TYPE : B_STRING_TYPE,
+		first->key, first->length, second->key, second->length);
+	if (compare != 0)
+		return compare;
+
+	return first->value < second->value ? -1 : first->value > second->value;
+}
+
+
+static void
+shuffle(test_entry* entries, int32 count)
+{
+	srand(42);
+	for (int32 i = count; i-- > 1;) {
+		int32 j = rand() % (i + 1);
+		test_entry swap = entries[i];
+		entries[i] = entries[j];
+		entries[j] = swap;
+	}
+}
+
+
+/*!	Sorts \a entries with a KeySorter, builds a tree from it, and checks
+	the tree against the sorted entries.
+*/
+static void
+check_tree(const char* name, test_entry* entries, int32 count,
+	type_code type, uint32 blockSize, uint32 minLevels)
+{
+	shuffle(entries, count);
+
+	KeySorter sorter(type, 64 * 1024 * 1024, 4096);
+	for (int32 i = 0; i < count; i++)
+		sorter.Add(entries[i].key, entries[i].length, entries[i].value);
+
+	qsort(entries, count, sizeof(test_entry), &compare_entries);
+
+	MemoryLoader loader(blockSize, type);
+	bool ok = loader.InitCheck() == B_OK && loader.Prepare(sorter) == B_OK
+		&& loader.Allocate() == B_OK && loader.Write(sorter) == B_OK;
+	ok = ok && loader.AllWritten() && loader.Size() % blockSize == 0
+		&& loader.CountLevels() >= minLevels;
+
+	TreeChecker checker(loader, type);
+	ok = ok && checker.Check(entries, count);
+
+	char buffer[256];
+	snprintf(buffer, sizeof(buffer), "%s (%" B_PRId32 " entries, %" B_PRIu32
+		" levels, %" B_PRIdOFF " nodes)", name, count, loader.CountLevels(),
+		loader.Size() / BPLUSTREE_NODE_SIZE);
+	report(buffer, ok);
+}
+
+
+static int32
+fill_strings(test_entry* entries, int32 count)
+{
+	for (int32 i = 0; i < count; i++) {
+		entries[i].length = snprintf((char*)entries[i].key,
+			sizeof(entries[i].key), "file-%08" B_PRId32, i * 7919 % count);
+		entries[i].value = 1000 + i;
+	}
+	return count;
+}
+
+
+//!	Key \c k has \c k % \a maxValues + 1 values.
+static int32
+fill_duplicates(test_entry* entries, int32 keys, int32 maxValues)
+{
+	int32 count = 0;
+	for (int64 key = 0; key < keys; key++) {
+		for (int32 i = 0; i <= key % maxValues; i++) {
+			memcpy(entries[count].key, &key, sizeof(int64));
+			entries[count].length = sizeof(int64);
+			entries[count].value = key * 1000 + i * 3;
+			count++;
+		}
+	}
+	return count;
+}
+
+
+/*!	Returns the entries in a fixed order, for the tests that need to feed
+	the loader directly.
+*/
+class ArraySource : public BPlusTreeSource {
+public:
+	ArraySource(const test_entry* entries, int32 count)
+		:
+		fEntries(entries),
+		fCount(count),
+		fIndex(0)
+	{
+	}
+
+	virtual status_t Rewind()
+	{
+		fIndex = 0;
+		return B_OK;
+	}
+
+	virtual status_t GetNext(const uint8** _key, uint16* _keyLength,
+		off_t* _value)
+	{
+		if (fIndex == fCount)
+			return B_ENTRY_NOT_FOUND;
+
+		*_key = fEntries[fIndex].key;
+		*_keyLength = fEntries[fIndex].length;
+		*_value = fEntries[fIndex].value;
+		fIndex++;
+		return B_OK;
+	}
+
+private:
+	const test_entry*	fEntries;
+	int32				fCount;
+	int32				fIndex;
+};
+
+
+/*!	Keeps the runs that don't fit into the memory of the sorter in a
+	buffer of its own.
+*/
+class StoringSorter : public KeySorter {
+public:
+	StoringSorter(type_code type, size_t maxMemory)
+		:
+		KeySorter(type, maxMemory, 4096),
+		fStorage(NULL),
+		fSize(0)
+	{
+	}
+
+	virtual ~StoringSorter()
+	{
+		free(fStorage);
+	}
+
+protected:
+	virtual status_t WriteStorage(off_t offset, const uint8* buffer,
+		size_t size)
+	{
+		if (offset % ChunkSize() != 0 || size != ChunkSize())
+			return B_BAD_VALUE;
+
+		if (offset + (off_t)size > fSize) {
+			uint8* storage = (uint8*)realloc(fStorage, offset + size);
+			if (storage == NULL)
+				return B_NO_MEMORY;
+
+			fStorage = storage;
+			fSize = offset + size;
+		}
+
+		memcpy(fStorage + offset, buffer, size);
+		return B_OK;
+	}
+
+	virtual status_t ReadStorage(off_t offset, uint8* buffer, size_t size)
+	{
+		if (offset % ChunkSize() != 0 || size != ChunkSize()
+			|| offset + (off_t)size > fSize)
+			return B_BAD_VALUE;
+
+		memcpy(buffer, fStorage + offset, size);
+		return B_OK;
+	}
+
+private:
+	uint8*	fStorage;
+	off_t	fSize;
+};
+
+
+int
+main(int argc, char** argv)
+{
+	const int32 kMaxEntries = 200000;
+	test_entry* entries = new test_entry[kMaxEntries];
+
+	// the sorter
+
+	int32 count = fill_strings(entries, 20000);
+	{
+		KeySorter sorter(B_STRING_TYPE, 64 * 1024 * 1024, 4096);
+		for (int32 i = 0; i < count; i++)
+			sorter.Add(entries[i].key, entries[i].length, entries[i].value);
+
+		bool ok = sorter.CountRuns() > 100 && sorter.Rewind() == B_OK;
+		const uint8* previous = NULL;
+		uint16 previousLength = 0;
+		int32 read = 0;
+		const uint8* key;
+		uint16 length;
+		off_t value;
+		while (ok && sorter.GetNext(&key, &length, &value) == B_OK) {
+			if (previous != NULL && QueryParser::compareKeys(B_STRING_TYPE,
+					previous, previousLength, key, length) >= 0)
+				ok = false;
+			previous = key;
+			previousLength = length;
+			read++;
+		}
+		report("sorter merges its runs", ok && read == count);
+
+		ok = sorter.Rewind() == B_OK
+			&& sorter.GetNext(&key, &length, &value) == B_OK
+			&& length == 13 && !memcmp(key, "file-00000000", 13);
+		report("sorter rewinds", ok);
+	}
+	{
+		KeySorter sorter(B_STRING_TYPE, 3 * 4096, 4096);
+		status_t status = B_OK;
+		for (int32 i = 0; i < count && status == B_OK; i++)
+			status = sorter.Add(entries[i].key, entries[i].length, i);
+		report("sorter limits its memory", status == B_NO_MEMORY);
+	}
+	{
+		StoringSorter sorter(B_STRING_TYPE, 256 * 1024);
+		status_t status = B_OK;
+		for (int32 i = 0; i < count && status == B_OK; i++)
+			status = sorter.Add(entries[i].key, entries[i].length, i);
+
+		bool ok = status == B_OK && sorter.StorageSize() > 0;
+		for (int32 pass = 0; ok && pass < 2; pass++) {
+			ok = sorter.Rewind() == B_OK;
+
+			const uint8* key;
+			uint16 length;
+			off_t value;
+			int32 read = 0;
+			while (ok && sorter.GetNext(&key, &length, &value) == B_OK) {
+				char expected[16];
+				snprintf(expected, sizeof(expected), "file-%08" B_PRId32,
+					read);
+				ok = length == strlen(expected)
+					&& !memcmp(key, expected, length)
+					&& entries[value].length == length
+					&& !memcmp(entries[value].key, key, length);
+				read++;
+			}
+			ok = ok && read == count;
+		}
+		report("sorter stores the runs that don't fit into memory", ok);
+	}
+
+	// trees
+
+	check_tree("empty tree", entries, 0, B_STRING_TYPE, 2048, 1);
+	check_tree("single entry", entries, fill_strings(entries, 1),
+		B_STRING_TYPE, 2048, 1);
+	check_tree("single leaf", entries, fill_strings(entries, 30),
+		B_STRING_TYPE, 1024, 1);
+	check_tree("two levels", entries, fill_strings(entries, 300),
+		B_STRING_TYPE, 2048, 2);
+	check_tree("unique keys", entries, fill_strings(entries, kMaxEntries),
+		B_STRING_TYPE, 2048, 3);
+	check_tree("unique keys, 4096 byte blocks", entries,
+		fill_strings(entries, 50000), B_STRING_TYPE, 4096, 3);
+	check_tree("duplicate fragments", entries,
+		fill_duplicates(entries, 2000, 7), B_INT64_TYPE, 2048, 2);
+	check_tree("duplicate nodes", entries, fill_duplicates(entries, 600, 300),
+		B_INT64_TYPE, 1024, 2);
+
+	// entries that are not sorted are refused
+
+	count = fill_strings(entries, 10);
+	{
+		ArraySource source(entries, count);
+		MemoryLoader loader(2048, B_STRING_TYPE);
+		report("unsorted entries", loader.Prepare(source) == B_BAD_DATA);
+	}
+
+	delete[] entries;
+
+	if (sFailed > 0) {
+		printf("%" B_PRId32 " tests failed!\n", sFailed);
+		return 1;
+	}
+
+	return 0;
+}
@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #define	int8	int8_t
@@ -94,6 +95,13 @@ count_bits(int value)
 	return count;
 }
 
+/*!	Marks the free blocks of a BFS image as used according to the pattern,
+	so that everything written to it afterwards is fragmented.
+	To see the defragmenter at work, fragment a fresh image, copy some
+	files to it with bfs_shell, and run "checkfs" to release the marked
+	blocks again; "defrag" then reports the extents of all data streams
+	before and after it moved them.
+*/
 int
 main(int argc, const char *const *argv)
 {
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * This file may be used under the terms of the MIT License.
+ */
+
+/*!	Builds index statistics from known key distributions, and makes sure
+	that the estimates the query planner gets from them are close enough to
+	the real number of matching entries.
+*/
+
+
+#include "IndexStatistics.h"
+
+
+static int32 sFailed;
+
+
+/*!	Checks that \a estimate is within \a tolerance percent of \a expected,
+	or off by at most one entry.
+*/
+static void
+check(const char* name, int64 estimate, int64 expected, int32 tolerance)
+{
+	int64 difference = estimate > expected
+		? estimate - expected : expected - estimate;
+
+	if (difference > 1 && difference * 100 > expected * tolerance) {
+		printf("FAILED %s: estimated %" B_PRId64 " (expected %" B_PRId64
+			")\n", name, estimate, expected);
+		sFailed++;
+	} else
+		printf("ok     %s\n", name);
+}
+
+
+static int64
+estimate_range(IndexStatistics& statistics, int32* lower, int32* upper)
+{
+	return statistics.Estimate((uint8*)lower,
+		lower != NULL ? sizeof(int32) : 0, (uint8*)upper,
+		upper != NULL ? sizeof(int32) : 0);
+}
+
+
+static int64
+estimate_equal(IndexStatistics& statistics, int32 value)
+{
+	return estimate_range(statistics, &value, &value);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	// uniformly distributed unique keys
+
+	IndexStatistics uniform(1, B_INT32_TYPE);
+	uniform.Start();
+	for (int32 i = 0; i < 100000; i++)
+		uniform.Add((uint8*)&i, sizeof(int32));
+	uniform.Finish();
+
+	if (uniform.CountEntries() != 100000
+		|| uniform.CountBuckets() > IndexStatistics::kMaxBuckets) {
+		printf("FAILED uniform: %" B_PRId64 " entries in %" B_PRId32
+			" buckets\n", uniform.CountEntries(), uniform.CountBuckets());
+		sFailed++;
+	}
+
+	int32 lower = 25000;
+	int32 upper = 75000;
+	check("uniform range", estimate_range(uniform, &lower, &upper), 50000, 10);
+	check("uniform lower half", estimate_range(uniform, NULL, &lower), 25000,
+		10);
+	check("uniform upper half", estimate_range(uniform, &upper, NULL), 25000,
+		10);
+	check("uniform equal", estimate_equal(uniform, 4711), 1, 0);
+
+	lower = 200000;
+	check("uniform above", estimate_range(uniform, &lower, NULL), 0, 0);
+	check("uniform equal above", estimate_equal(uniform, 200000), 0, 0);
+
+	// one frequent key among unique ones
+
+	IndexStatistics skewed(2, B_INT32_TYPE);
+	skewed.Start();
+	for (int32 i = 0; i < 10000; i++)
+		skewed.Add((uint8*)&i, sizeof(int32));
+	for (int32 i = 0; i < 50000; i++) {
+		int32 frequent = 10000;
+		skewed.Add((uint8*)&frequent, sizeof(int32));
+	}
+	for (int32 i = 10001; i < 20000; i++)
+		skewed.Add((uint8*)&i, sizeof(int32));
+	skewed.Finish();
+
+	check("frequent key", estimate_equal(skewed, 10000), 50000, 20);
+	check("rare key", estimate_equal(skewed, 15000), 1, 0);
+	lower = 10001;
+	check("range after frequent key", estimate_range(skewed, &lower, NULL),
+		9999, 25);
+
+	// updates keep the estimates current
+
+	for (int32 i = 0; i < 1000; i++) {
+		int32 value = 100000 + i;
+		uniform.Update(NULL, 0, (uint8*)&value, sizeof(int32));
+	}
+	lower = 100000;
+	check("appended keys", estimate_range(uniform, &lower, NULL), 1000, 60);
+	check("entries after update", uniform.CountEntries(), 101000, 0);
+
+	for (int32 i = 0; i < 1000; i++)
+		uniform.Update((uint8*)&i, sizeof(int32), NULL, 0);
+	check("entries after removal", uniform.CountEntries(), 100000, 0);
+
+	// string keys, and a prefix range as used for patterns
+
+	IndexStatistics names(3, B_STRING_TYPE);
+	names.Start();
+	for (char first = 'a'; first <= 'z'; first++) {
+		for (int32 i = 0; i < 1000; i++) {
+			char name[16];
+			int length = snprintf(name, sizeof(name), "%c%04" B_PRId32,
+				first, i);
+			names.Add((uint8*)name, length);
+		}
+	}
+	names.Finish();
+
+	check("string equal", names.Estimate((uint8*)"m0500", 5,
+		(uint8*)"m0500", 5), 1, 0);
+	check("string prefix", names.Estimate((uint8*)"m", 1, (uint8*)"m\xff", 2),
+		1000, 60);
+
+	// an empty index
+
+	IndexStatistics empty(4, B_INT32_TYPE);
+	empty.Start();
+	empty.Finish();
+	check("empty", estimate_equal(empty, 1), 0, 0);
+
+	int32 value = 42;
+	empty.Update(NULL, 0, (uint8*)&value, sizeof(int32));
+	check("empty after insert", estimate_equal(empty, 42), 1, 0);
+
+	if (sFailed > 0) {
+		printf("%" B_PRId32 " tests failed!\n", sFailed);
+		return 1;
+	}
+
+	return 0;
+}
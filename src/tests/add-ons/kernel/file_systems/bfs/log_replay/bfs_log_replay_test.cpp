@@ -0,0 +1,197 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * This file may be used under the terms of the MIT License.
+ */
+
+/*!	Writes transactions into a log area in memory the same way the journal
+	does, damages them like a crash in the middle of a log write would, and
+	makes sure that check_log_transaction() only lets complete transactions
+	pass for replay.
+*/
+
+
+#include "RunArray.h"
+
+
+static const int32 kBlockSize = 1024;
+static const uint32 kLogSize = 512;
+
+static uint8 sLog[kLogSize * kBlockSize];
+static int32 sFailed;
+
+
+class MemoryLogReader {
+public:
+	const void* operator()(uint32 position)
+	{
+		if (position >= kLogSize)
+			return NULL;
+
+		return sLog + position * kBlockSize;
+	}
+};
+
+
+static uint8*
+log_block(uint32 position)
+{
+	return sLog + (position % kLogSize) * kBlockSize;
+}
+
+
+/*!	Writes a transaction of \a blocks blocks at \a start, and returns the log
+	position after it. If \a checksum is \c false, the log entries are written
+	like older versions of BFS did.
+*/
+static uint32
+write_transaction(uint32 start, int32 blocks, uint8 pattern,
+	bool checksum = true)
+{
+	int32 maxRuns = run_array::MaxRuns(kBlockSize) - 1;
+	uint32 position = start;
+
+	while (blocks > 0) {
+		run_array* array = (run_array*)log_block(position);
+		memset(array, 0, kBlockSize);
+		array->max_runs = HOST_ENDIAN_TO_BFS_INT32(maxRuns + 1);
+
+		int32 count = min_c(blocks, maxRuns);
+		array->count = HOST_ENDIAN_TO_BFS_INT32(count);
+		for (int32 i = 0; i < count; i++)
+			array->runs[i] = block_run::Run(1, i);
+
+		for (int32 i = 0; i < count; i++)
+			memset(log_block(position + 1 + i), pattern + i, kBlockSize);
+
+		blocks -= count;
+
+		if (checksum) {
+			log_entry_tail& tail = array->Tail();
+			tail.magic = HOST_ENDIAN_TO_BFS_INT16(LOG_ENTRY_TAIL_MAGIC);
+			tail.flags = HOST_ENDIAN_TO_BFS_INT16(
+				blocks > 0 ? LOG_ENTRY_CONTINUED : 0);
+
+			uint32 crc = array->StartChecksum(kBlockSize);
+			for (int32 i = 0; i < count; i++) {
+				crc = run_array::AddToChecksum(crc,
+					log_block(position + 1 + i), kBlockSize);
+			}
+			tail.checksum = HOST_ENDIAN_TO_BFS_INT32(crc);
+		}
+
+		position = (position + 1 + count) % kLogSize;
+	}
+
+	return position;
+}
+
+
+static void
+check(const char* name, uint32 start, uint32 end, status_t expectedStatus,
+	uint32 expectedNext = 0)
+{
+	MemoryLogReader reader;
+	uint32 next = 0;
+	status_t status = check_log_transaction(reader, kBlockSize, kLogSize,
+		start, end, next);
+
+	if (status != expectedStatus
+		|| (status == B_OK && next != expectedNext)) {
+		printf("FAILED %s: status %s, next %" B_PRIu32 " (expected %s, %"
+			B_PRIu32 ")\n", name, strerror(status), next,
+			strerror(expectedStatus), expectedNext);
+		sFailed++;
+	} else
+		printf("ok     %s\n", name);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	// complete transactions
+
+	uint32 end = write_transaction(0, 10, 1);
+	check("single array", 0, end, B_OK, end);
+
+	end = write_transaction(0, 200, 1);
+	check("two arrays", 0, end, B_OK, end);
+
+	end = write_transaction(kLogSize - 50, 200, 1);
+	check("wrapping log", kLogSize - 50, end, B_OK, end);
+
+	end = write_transaction(0, 10, 1, false);
+	check("without checksum", 0, end, B_OK, end);
+
+	// torn transactions
+
+	end = write_transaction(0, 10, 1);
+	log_block(5)[17] ^= 0x40;
+	check("torn block", 0, end, B_BAD_DATA);
+
+	end = write_transaction(0, 200, 1);
+	memset(log_block(150), 0, kBlockSize);
+		// a block written by the second array
+	check("torn second array", 0, end, B_BAD_DATA);
+
+	end = write_transaction(0, 200, 1);
+	memset(log_block(127), 0, kBlockSize);
+		// the second run_array itself
+	check("torn second header", 0, end, B_BAD_DATA);
+
+	end = write_transaction(0, 200, 1);
+	check("missing second array", 0, 127, B_BAD_DATA);
+
+	end = write_transaction(kLogSize - 50, 200, 1);
+	memset(log_block(3), 0, kBlockSize);
+	check("torn wrapped block", kLogSize - 50, end, B_BAD_DATA);
+
+	end = write_transaction(0, 10, 1);
+	run_array* array = (run_array*)log_block(0);
+	array->runs[3] = block_run::Run(1, 99);
+	check("changed run", 0, end, B_BAD_DATA);
+
+	// damaged entries
+
+	end = write_transaction(0, 10, 1);
+	memset(log_block(0), 0, kBlockSize);
+	check("broken header", 0, end, B_ERROR);
+
+	end = write_transaction(0, 10, 1, false);
+	memset(log_block(0), 0, kBlockSize);
+	check("broken header without checksum", 0, end, B_ERROR);
+
+	end = write_transaction(0, 10, 1, false);
+	check("too long without checksum", 0, end - 1, B_ERROR);
+
+	// replaying stops in front of a torn transaction
+
+	uint32 first = write_transaction(0, 20, 1);
+	uint32 second = write_transaction(first, 150, 2);
+	end = write_transaction(second, 30, 3);
+	memset(log_block(second + 20), 0, kBlockSize);
+
+	MemoryLogReader reader;
+	uint32 position = 0;
+	uint32 next;
+	int32 replayed = 0;
+	while (position != end && check_log_transaction(reader, kBlockSize,
+			kLogSize, position, end, next) == B_OK) {
+		position = next;
+		replayed++;
+	}
+	if (replayed != 2 || position != second) {
+		printf("FAILED replay: %" B_PRId32 " transactions up to %" B_PRIu32
+			" (expected 2 up to %" B_PRIu32 ")\n", replayed, position,
+			second);
+		sFailed++;
+	} else
+		printf("ok     replay\n");
+
+	if (sFailed > 0) {
+		printf("%" B_PRId32 " tests failed!\n", sFailed);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * This file may be used under the terms of the MIT License.
+ */
+
+/*!	Makes sure that the trigrams a query takes from a pattern are contained
+	in the trigrams of every value that matches it, so that a trigram index
+	never misses a file.
+*/
+
+
+#include "TrigramIndex.h"
+
+#include <file_systems/QueryParserUtils.h>
+
+
+static int32 sFailed;
+
+
+static void
+report(const char* name, bool ok)
+{
+	if (!ok) {
+		printf("FAILED %s\n", name);
+		sFailed++;
+	} else
+		printf("ok     %s\n", name);
+}
+
+
+static bool
+contains(const uint32* trigrams, int32 count, uint32 trigram)
+{
+	for (int32 i = 0; i < count; i++) {
+		if (trigrams[i] == trigram)
+			return true;
+	}
+	return false;
+}
+
+
+static uint32
+trigram(const char* string)
+{
+	return ((uint32)(uint8)string[0] << 16) | ((uint32)(uint8)string[1] << 8)
+		| (uint8)string[2];
+}
+
+
+/*!	Checks that \a value matches \a pattern, and that it contains all the
+	trigrams of the pattern.
+*/
+static void
+check_match(const char* pattern, const char* value)
+{
+	char name[256];
+	snprintf(name, sizeof(name), "\"%s\" == \"%s\"", value, pattern);
+
+	uint32 valueTrigrams[MAX_TRIGRAMS];
+	uint32 patternTrigrams[MAX_TRIGRAMS];
+	int32 valueCount = collect_trigrams((const uint8*)value, strlen(value) + 1,
+		valueTrigrams);
+	int32 patternCount = collect_pattern_trigrams(pattern, patternTrigrams);
+
+	bool ok = QueryParser::matchString((char*)pattern, (char*)value)
+		== QueryParser::MATCH_OK;
+	for (int32 i = 0; ok && i < patternCount; i++)
+		ok = contains(valueTrigrams, valueCount, patternTrigrams[i]);
+
+	report(name, ok);
+}
+
+
+static void
+check_pattern(const char* pattern, int32 expectedCount,
+	const char* expectedFirst)
+{
+	uint32 trigrams[MAX_TRIGRAMS];
+	int32 count = collect_pattern_trigrams(pattern, trigrams);
+
+	char name[256];
+	snprintf(name, sizeof(name), "trigrams of \"%s\"", pattern);
+	report(name, count == expectedCount
+		&& (count == 0 || trigrams[0] == trigram(expectedFirst)));
+}
+
+
+int
+main(int argc, char** argv)
+{
+	// values
+
+	uint32 trigrams[MAX_TRIGRAMS];
+	int32 count = collect_trigrams((const uint8*)"Banana", 6, trigrams);
+	report("distinct trigrams", count == 3 && trigrams[0] == trigram("ana")
+		&& trigrams[1] == trigram("ban") && trigrams[2] == trigram("nan"));
+
+	count = collect_trigrams((const uint8*)"ab", 3, trigrams);
+	report("short value", count == 0);
+
+	// patterns
+
+	check_pattern("*[Hh][Oo][Ww]*", 1, "how");
+	check_pattern("*How*", 1, "how");
+	check_pattern("*[Hh][Oo]*", 0, NULL);
+	check_pattern("*[Hh][a-z][Ww]*", 0, NULL);
+	check_pattern("*ab?cd*", 0, NULL);
+	check_pattern("read\\*me", 2, "rea");
+	check_pattern("[\\]]abc", 1, "abc");
+	check_pattern("[r]eadme", 4, "rea");
+	check_pattern("*[!a]bc*", 0, NULL);
+
+	// matching values contain the trigrams of the pattern
+
+	check_match("*[Hh][Oo][Ww]*", "Show me HOW");
+	check_match("*[Hh][Oo][Ww]*", "somehow.txt");
+	check_match("*How*", "How to");
+	check_match("[Rr]eadMe*.[Tt][Xx][Tt]", "ReadMe first.TXT");
+	check_match("*.cpp", "Query.cpp");
+
+	if (sFailed > 0) {
+		printf("%" B_PRId32 " tests failed!\n", sFailed);
+		return 1;
+	}
+
+	return 0;
+}
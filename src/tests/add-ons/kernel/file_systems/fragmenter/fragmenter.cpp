@@ -11,8 +11,10 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#include <fs_info.h>
 #include <OS.h>
 
 
@@ -21,18 +23,88 @@ const char* kProgramName = __progname;
 
 const int32_t kDefaultFiles = -1;
 const off_t kDefaultFileSize = 4096;
+const off_t kDefaultAppendFileSize = 16 * 1024 * 1024;
+const size_t kDefaultChunkSize = 4096;
+const int32_t kMaxAppenders = 64;
+
+
+// The parts of the BFS on-disk structures needed to count the block runs
+// of a file.
+
+struct block_run {
+	int32_t		allocation_group;
+	uint16_t	start;
+	uint16_t	length;
+} __attribute__((packed));
+
+struct bfs_super_block {
+	char		name[32];
+	int32_t		magic1;
+	int32_t		fs_byte_order;
+	uint32_t	block_size;
+	uint32_t	block_shift;
+	int64_t		num_blocks;
+	int64_t		used_blocks;
+	int32_t		inode_size;
+	int32_t		magic2;
+	int32_t		blocks_per_ag;
+	int32_t		ag_shift;
+} __attribute__((packed));
+
+struct bfs_inode_head {
+	int32_t		magic1;
+	block_run	inode_num;
+	int32_t		uid;
+	int32_t		gid;
+	int32_t		mode;
+	int32_t		flags;
+	int64_t		create_time;
+	int64_t		last_modified_time;
+	block_run	parent;
+	block_run	attributes;
+	uint32_t	type;
+	int32_t		inode_size;
+	uint32_t	etc;
+	block_run	direct[12];
+	int64_t		max_direct_range;
+	block_run	indirect;
+	int64_t		max_indirect_range;
+	block_run	double_indirect;
+	int64_t		max_double_indirect_range;
+	int64_t		size;
+} __attribute__((packed));
+
+struct appender {
+	int32_t		index;
+	off_t		size;
+	size_t		chunk_size;
+	const char*	buffer;
+	status_t	status;
+};
 
 
 static void
 usage(int status)
 {
-	printf("usage: %s [--files <num-of-files>] [--size <file-size>]\n",
-		kProgramName);
+	printf("usage: %s [--files <num-of-files>] [--size <file-size>]\n"
+		"       %s --appenders <num-of-files> [--size <file-size>] "
+		"[--chunk <bytes>]\n", kProgramName, kProgramName);
 	printf("options:\n");
-	printf("  -f  --files  Number of files to be created. Defaults to as "
+	printf("  -f  --files      Number of files to be created. Defaults to as "
 		"many as fit.\n");
-	printf("  -s  --size   Size of each file. Defaults to %lldKB.\n",
-		kDefaultFileSize / 1024);
+	printf("  -s  --size       Size of each file. Defaults to %lldKB, or "
+		"%lldMB with\n"
+		"                   --appenders.\n", kDefaultFileSize / 1024,
+		kDefaultAppendFileSize / (1024 * 1024));
+	printf("  -a  --appenders  Instead of fragmenting the disk, let this many "
+		"threads\n"
+		"                   append to a file each at the same time, and "
+		"report the\n"
+		"                   throughput, and how many block runs the files "
+		"ended up\n"
+		"                   with (on BFS only).\n");
+	printf("  -c  --chunk      Size of each append. Defaults to %zu bytes.\n",
+		kDefaultChunkSize);
 
 	exit(status);
 }
@@ -62,11 +134,243 @@ create_file(int32_t i, const char* suffix, const char* buffer, size_t size)
 }
 
 
+static status_t
+append_thread(void* _data)
+{
+	appender* data = (appender*)_data;
+
+	char name[64];
+	snprintf(name, sizeof(name), "fragments/append-%06d", data->index);
+
+	int fd = open(name, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+	if (fd < 0) {
+		data->status = errno;
+		return data->status;
+	}
+
+	for (off_t written = 0; written < data->size;
+			written += data->chunk_size) {
+		size_t size = data->chunk_size;
+		if ((off_t)size > data->size - written)
+			size = data->size - written;
+
+		if (write(fd, data->buffer, size) < (ssize_t)size) {
+			data->status = errno;
+			break;
+		}
+	}
+
+	close(fd);
+	return data->status;
+}
+
+
+static bool
+read_blocks(int device, off_t offset, void* buffer, size_t size)
+{
+	return pread(device, buffer, size, offset) == (ssize_t)size;
+}
+
+
+static off_t
+to_offset(const bfs_super_block& superBlock, const block_run& run)
+{
+	return (((off_t)run.allocation_group << superBlock.ag_shift) | run.start)
+		<< superBlock.block_shift;
+}
+
+
+/*!	Counts the physically contiguous extents in the array of \a count block
+	runs, and adds them to \a runs. Returns the offset after the last run.
+*/
+static off_t
+count_runs(const block_run* array, int32_t count,
+	const bfs_super_block& superBlock, off_t lastEnd, int32_t& runs)
+{
+	for (int32_t i = 0; i < count; i++) {
+		if (array[i].allocation_group == 0 && array[i].start == 0
+			&& array[i].length == 0)
+			break;
+
+		off_t offset = to_offset(superBlock, array[i]);
+		if (offset != lastEnd)
+			runs++;
+		lastEnd = offset + ((off_t)array[i].length << superBlock.block_shift);
+	}
+
+	return lastEnd;
+}
+
+
+/*!	Reads the inode of the file \a name directly from the disk, and returns
+	the number of extents its data is stored in, or -1 if that could not be
+	determined.
+*/
+static int32_t
+file_runs(const char* name)
+{
+	struct stat st;
+	fs_info info;
+	if (stat(name, &st) != 0 || fs_stat_dev(st.st_dev, &info) != 0
+		|| strcmp(info.fsh_name, "bfs") != 0)
+		return -1;
+
+	int device = open(info.device_name, O_RDONLY);
+	if (device < 0)
+		return -1;
+
+	bfs_super_block superBlock;
+	bfs_inode_head inode;
+	if (!read_blocks(device, 512, &superBlock, sizeof(superBlock))
+		|| !read_blocks(device, st.st_ino << superBlock.block_shift, &inode,
+			sizeof(inode))) {
+		close(device);
+		return -1;
+	}
+
+	int32_t runs = 0;
+	off_t lastEnd = count_runs(inode.direct, 12, superBlock, -1, runs);
+
+	int32_t perBlock = superBlock.block_size / sizeof(block_run);
+	block_run* array = (block_run*)malloc(superBlock.block_size);
+	block_run* indirectArray = (block_run*)malloc(superBlock.block_size);
+	bool ok = array != NULL && indirectArray != NULL;
+
+	if (ok && inode.max_indirect_range != 0) {
+		off_t offset = to_offset(superBlock, inode.indirect);
+		for (int32_t i = 0; ok && i < inode.indirect.length; i++) {
+			ok = read_blocks(device, offset + i * superBlock.block_size, array,
+				superBlock.block_size);
+			if (ok)
+				lastEnd = count_runs(array, perBlock, superBlock, lastEnd, runs);
+		}
+	}
+
+	if (ok && inode.max_double_indirect_range != 0) {
+		off_t offset = to_offset(superBlock, inode.double_indirect);
+		for (int32_t i = 0; ok && i < inode.double_indirect.length; i++) {
+			ok = read_blocks(device, offset + i * superBlock.block_size,
+				indirectArray, superBlock.block_size);
+
+			for (int32_t j = 0; ok && j < perBlock; j++) {
+				const block_run& run = indirectArray[j];
+				if (run.allocation_group == 0 && run.start == 0
+					&& run.length == 0)
+					break;
+
+				off_t arrayOffset = to_offset(superBlock, run);
+				for (int32_t k = 0; ok && k < run.length; k++) {
+					ok = read_blocks(device,
+						arrayOffset + k * superBlock.block_size, array,
+						superBlock.block_size);
+					if (ok) {
+						lastEnd = count_runs(array, perBlock, superBlock,
+							lastEnd, runs);
+					}
+				}
+			}
+		}
+	}
+
+	free(array);
+	free(indirectArray);
+	close(device);
+	return ok ? runs : -1;
+}
+
+
+static int
+append_files(int32_t numFiles, off_t fileSize, size_t chunkSize)
+{
+	char* buffer = (char*)malloc(chunkSize);
+	if (buffer == NULL) {
+		fprintf(stderr, "%s: not enough memory.\n", kProgramName);
+		return 1;
+	}
+
+	for (uint32_t i = 0; i < chunkSize; i++) {
+		buffer[i] = (char)(i & 0xff);
+	}
+
+	printf("Appending to %d files of %lld KB in %zu byte chunks...\n",
+		numFiles, fileSize / 1024, chunkSize);
+
+	mkdir("fragments", 0777);
+
+	appender appenders[kMaxAppenders];
+	thread_id threads[kMaxAppenders];
+	bigtime_t startTime = system_time();
+
+	for (int32_t i = 0; i < numFiles; i++) {
+		appenders[i].index = i;
+		appenders[i].size = fileSize;
+		appenders[i].chunk_size = chunkSize;
+		appenders[i].buffer = buffer;
+		appenders[i].status = B_OK;
+
+		threads[i] = spawn_thread(&append_thread, "appender",
+			B_NORMAL_PRIORITY, &appenders[i]);
+		if (threads[i] < 0) {
+			fprintf(stderr, "%s: Could not spawn thread.\n", kProgramName);
+			exit(1);
+		}
+		resume_thread(threads[i]);
+	}
+
+	bool failed = false;
+	for (int32_t i = 0; i < numFiles; i++) {
+		status_t status;
+		wait_for_thread(threads[i], &status);
+		if (appenders[i].status != B_OK) {
+			fprintf(stderr, "%s: Could not write file %d: %s\n", kProgramName,
+				i, strerror(appenders[i].status));
+			failed = true;
+		}
+	}
+
+	sync();
+	bigtime_t elapsed = system_time() - startTime;
+	free(buffer);
+
+	if (failed)
+		return 1;
+
+	printf("Throughput: %.2f MB/s\n",
+		numFiles * (double)fileSize / elapsed * 1000000 / (1024 * 1024));
+
+	// count the runs of each file
+
+	int64_t totalRuns = 0;
+	int32_t maxRuns = 0;
+
+	for (int32_t i = 0; i < numFiles; i++) {
+		char name[64];
+		snprintf(name, sizeof(name), "fragments/append-%06d", i);
+
+		int32_t runs = file_runs(name);
+		if (runs < 0) {
+			printf("Could not count the block runs (not a BFS volume?)\n");
+			return 0;
+		}
+
+		totalRuns += runs;
+		if (runs > maxRuns)
+			maxRuns = runs;
+	}
+
+	printf("Block runs per file: %.1f average, %d maximum\n",
+		(double)totalRuns / numFiles, maxRuns);
+	return 0;
+}
+
+
 int
 main(int argc, char** argv)
 {
 	int32_t numFiles = kDefaultFiles;
-	off_t fileSize = kDefaultFileSize;
+	off_t fileSize = -1;
+	int32_t numAppenders = 0;
+	size_t chunkSize = kDefaultChunkSize;
 
 	int optionIndex = 0;
 	int opt;
@@ -74,11 +378,13 @@ main(int argc, char** argv)
 		{"help", no_argument, 0, 'h'},
 		{"size", required_argument, 0, 's'},
 		{"files", required_argument, 0, 'f'},
+		{"appenders", required_argument, 0, 'a'},
+		{"chunk", required_argument, 0, 'c'},
 		{0, 0, 0, 0}
 	};
 
 	do {
-		opt = getopt_long(argc, argv, "hs:f:", longOptions, &optionIndex);
+		opt = getopt_long(argc, argv, "hs:f:a:c:", longOptions, &optionIndex);
 		switch (opt) {
 			case -1:
 				// end of arguments, do nothing
@@ -92,6 +398,18 @@ main(int argc, char** argv)
 				fileSize = strtoul(optarg, NULL, 0);
 				break;
 
+			case 'a':
+				numAppenders = strtoul(optarg, NULL, 0);
+				if (numAppenders < 1 || numAppenders > kMaxAppenders)
+					usage(1);
+				break;
+
+			case 'c':
+				chunkSize = strtoul(optarg, NULL, 0);
+				if (chunkSize == 0)
+					usage(1);
+				break;
+
 			case 'h':
 			default:
 				usage(0);
@@ -99,6 +417,13 @@ main(int argc, char** argv)
 		}
 	} while (opt != -1);
 
+	if (numAppenders > 0) {
+		return append_files(numAppenders,
+			fileSize >= 0 ? fileSize : kDefaultAppendFileSize, chunkSize);
+	}
+	if (fileSize < 0)
+		fileSize = kDefaultFileSize;
+
 	// fill buffer
 
 	char* buffer = (char*)malloc(fileSize);
@@ -0,0 +1,403 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include <WorkQueue.h>
+
+#include <new>
+#include <stdio.h>
+#include <string.h>
+
+#include <lock.h>
+#include <util/AutoLock.h>
+#include <util/atomic.h>
+
+
+typedef DoublyLinkedList<WorkItem> WorkItemList;
+
+
+namespace BKernel {
+
+
+/*!	In userland every queue is emulated by a single worker thread. Delayed
+	items are kept in the item list with their due time, so no timers are
+	needed.
+*/
+struct WorkerPool {
+	mutex				lock;
+	WorkItemList		items;
+	ConditionVariable	condition;
+	work_queue_stats	stats;
+};
+
+
+struct WorkQueue::Worker {
+	WorkQueue*			queue;
+	WorkerPool*			pool;
+	thread_id			thread;
+	WorkItem*			current;
+};
+
+
+}	// namespace BKernel
+
+
+static WorkQueue sDefaultQueue;
+static WorkQueue sDefaultUnboundQueue;
+static mutex sDefaultQueuesLock = MUTEX_INITIALIZER("default work queues");
+
+
+// #pragma mark - WorkItem
+
+
+WorkItem::WorkItem()
+	:
+	fInQueue(NULL),
+	fPool(NULL),
+	fQueueTime(0),
+	fTimerQueue(NULL)
+{
+}
+
+
+WorkItem::~WorkItem()
+{
+}
+
+
+FunctionWorkItem::FunctionWorkItem()
+	:
+	fFunction(NULL),
+	fArgument(NULL)
+{
+}
+
+
+void
+FunctionWorkItem::SetTo(void (*function)(void*), void* argument)
+{
+	fFunction = function;
+	fArgument = argument;
+}
+
+
+void
+FunctionWorkItem::DoWork(WorkQueue* queue)
+{
+	if (fFunction != NULL)
+		fFunction(fArgument);
+}
+
+
+// #pragma mark - WorkQueue
+
+
+WorkQueue::WorkQueue()
+	:
+	fFlags(0),
+	fMaxActive(0),
+	fPoolCount(0),
+	fPools(NULL),
+	fWorkers(NULL),
+	fClosed(true)
+{
+	fName[0] = '\0';
+}
+
+
+WorkQueue::~WorkQueue()
+{
+}
+
+
+/*static*/ WorkQueue*
+WorkQueue::DefaultQueue()
+{
+	MutexLocker _(sDefaultQueuesLock);
+	if (sDefaultQueue.fPools == NULL
+		&& sDefaultQueue.Init("work queue", B_NORMAL_PRIORITY, 0, 1) != B_OK) {
+		return NULL;
+	}
+	return &sDefaultQueue;
+}
+
+
+/*static*/ WorkQueue*
+WorkQueue::DefaultUnboundQueue()
+{
+	MutexLocker _(sDefaultQueuesLock);
+	if (sDefaultUnboundQueue.fPools == NULL
+		&& sDefaultUnboundQueue.Init("work queue: unbound", B_NORMAL_PRIORITY,
+			WORK_QUEUE_UNBOUND, 1) != B_OK) {
+		return NULL;
+	}
+	return &sDefaultUnboundQueue;
+}
+
+
+status_t
+WorkQueue::Init(const char* name, int32 priority, uint32 flags,
+	int32 maxActive)
+{
+	strlcpy(fName, name, sizeof(fName));
+	fFlags = flags;
+	fMaxActive = 1;
+	fPoolCount = 1;
+
+	fPools = new(std::nothrow) WorkerPool;
+	fWorkers = new(std::nothrow) Worker;
+	if (fPools == NULL || fWorkers == NULL) {
+		delete fPools;
+		delete fWorkers;
+		fPools = NULL;
+		fWorkers = NULL;
+		return B_NO_MEMORY;
+	}
+
+	mutex_init(&fPools->lock, fName);
+	fPools->condition.Init(fPools, "work queue");
+	memset(&fPools->stats, 0, sizeof(fPools->stats));
+
+	fWorkers->queue = this;
+	fWorkers->pool = fPools;
+	fWorkers->current = NULL;
+	fClosed = false;
+
+	fWorkers->thread = spawn_kernel_thread(&_WorkerEntry, fName, priority,
+		fWorkers);
+	if (fWorkers->thread < 0) {
+		status_t error = fWorkers->thread;
+		Close(false);
+		return error;
+	}
+
+	resume_thread(fWorkers->thread);
+	return B_OK;
+}
+
+
+void
+WorkQueue::Close(bool cancelPending)
+{
+	if (fPools == NULL)
+		return;
+
+	MutexLocker locker(fPools->lock);
+	fClosed = true;
+	if (cancelPending) {
+		while (WorkItem* item = fPools->items.RemoveHead())
+			atomic_pointer_set(&item->fInQueue, (WorkQueue*)NULL);
+	}
+	fPools->condition.NotifyAll();
+	locker.Unlock();
+
+	if (fWorkers->thread >= 0) {
+		status_t result;
+		wait_for_thread(fWorkers->thread, &result);
+	}
+
+	mutex_destroy(&fPools->lock);
+	delete fPools;
+	delete fWorkers;
+	fPools = NULL;
+	fWorkers = NULL;
+}
+
+
+status_t
+WorkQueue::Queue(WorkItem* item)
+{
+	if (fPools == NULL)
+		return B_NOT_INITIALIZED;
+
+	if (atomic_pointer_test_and_set(&item->fInQueue, this, (WorkQueue*)NULL)
+			!= NULL) {
+		return EALREADY;
+	}
+
+	item->fQueueTime = system_time();
+	return _Queue(fPools, item);
+}
+
+
+status_t
+WorkQueue::QueueOn(int32 cpu, WorkItem* item)
+{
+	return Queue(item);
+}
+
+
+status_t
+WorkQueue::QueueDelayed(WorkItem* item, bigtime_t delay)
+{
+	if (fPools == NULL)
+		return B_NOT_INITIALIZED;
+
+	MutexLocker locker(fPools->lock);
+	if (atomic_pointer_get(&item->fInQueue) == this) {
+		// re-arm
+		item->fQueueTime = system_time() + delay;
+		fPools->condition.NotifyAll();
+		return B_OK;
+	}
+	locker.Unlock();
+
+	if (atomic_pointer_test_and_set(&item->fInQueue, this, (WorkQueue*)NULL)
+			!= NULL) {
+		return EALREADY;
+	}
+
+	item->fQueueTime = system_time() + delay;
+	return _Queue(fPools, item);
+}
+
+
+bool
+WorkQueue::Cancel(WorkItem* item)
+{
+	if (fPools == NULL)
+		return false;
+
+	MutexLocker locker(fPools->lock);
+
+	if (atomic_pointer_get(&item->fInQueue) == this) {
+		fPools->items.Remove(item);
+		fPools->stats.pending--;
+		atomic_pointer_set(&item->fInQueue, (WorkQueue*)NULL);
+		return true;
+	}
+
+	if (fWorkers->current != item || find_thread(NULL) == fWorkers->thread)
+		return false;
+
+	// wait for the worker to finish the item
+	while (fWorkers->current == item) {
+		ConditionVariableEntry entry;
+		fPools->condition.Add(&entry);
+		locker.Unlock();
+		entry.Wait();
+		locker.Lock();
+	}
+
+	return false;
+}
+
+
+bool
+WorkQueue::IsWorkerThread(thread_id thread) const
+{
+	return fWorkers != NULL && fWorkers->thread == thread;
+}
+
+
+void
+WorkQueue::GetStatistics(work_queue_stats& stats) const
+{
+	MutexLocker _(fPools->lock);
+	stats = fPools->stats;
+}
+
+
+void
+WorkQueue::Dump() const
+{
+	printf("work queue \"%s\": %" B_PRId64 " queued, %" B_PRId64 " executed\n",
+		fName, fPools->stats.queued, fPools->stats.executed);
+}
+
+
+/*static*/ status_t
+WorkQueue::_WorkerEntry(void* data)
+{
+	Worker* worker = (Worker*)data;
+	return worker->queue->_Worker(worker);
+}
+
+
+status_t
+WorkQueue::_Worker(Worker* worker)
+{
+	WorkerPool* pool = worker->pool;
+	MutexLocker locker(pool->lock);
+
+	while (true) {
+		// find the first item that is due
+		bigtime_t now = system_time();
+		bigtime_t nextDue = B_INFINITE_TIMEOUT;
+		WorkItem* item = NULL;
+		for (WorkItemList::Iterator it = pool->items.GetIterator();
+				WorkItem* candidate = it.Next();) {
+			if (candidate->fQueueTime <= now) {
+				item = candidate;
+				break;
+			}
+			if (candidate->fQueueTime < nextDue)
+				nextDue = candidate->fQueueTime;
+		}
+
+		if (item == NULL) {
+			if (fClosed)
+				break;
+
+			ConditionVariableEntry entry;
+			pool->condition.Add(&entry);
+			locker.Unlock();
+			if (nextDue == B_INFINITE_TIMEOUT)
+				entry.Wait();
+			else
+				entry.Wait(B_ABSOLUTE_TIMEOUT, nextDue);
+			locker.Lock();
+			continue;
+		}
+
+		pool->items.Remove(item);
+		pool->stats.pending--;
+		pool->stats.executed++;
+
+		bigtime_t latency = now - item->fQueueTime;
+		pool->stats.total_latency += latency;
+		if (latency > pool->stats.max_latency)
+			pool->stats.max_latency = latency;
+
+		worker->current = item;
+		atomic_pointer_set(&item->fInQueue, (WorkQueue*)NULL);
+		locker.Unlock();
+
+		item->DoWork(this);
+
+		locker.Lock();
+		worker->current = NULL;
+		pool->condition.NotifyAll();
+	}
+
+	return B_OK;
+}
+
+
+status_t
+WorkQueue::_Queue(WorkerPool* pool, WorkItem* item)
+{
+	MutexLocker _(pool->lock);
+
+	if (fClosed) {
+		atomic_pointer_set(&item->fInQueue, (WorkQueue*)NULL);
+		return B_NOT_ALLOWED;
+	}
+
+	item->fPool = pool;
+	pool->items.Add(item);
+	pool->stats.queued++;
+	if (++pool->stats.pending > pool->stats.max_pending)
+		pool->stats.max_pending = pool->stats.pending;
+
+	pool->condition.NotifyAll();
+	return B_OK;
+}
+
+
+void
+work_queue_init()
+{
+}
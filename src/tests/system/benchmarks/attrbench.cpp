@@ -0,0 +1,203 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+/*!	Loads the attributes of a number of mail-like files the way Tracker
+	does for its poses, once with one BNode::ReadAttr() per attribute, and
+	once with a single BNode::ReadAttrs() per file. The files are created
+	(using BNode::WriteAttrs()) in the given directory first.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fs_attr.h>
+#include <Node.h>
+#include <OS.h>
+#include <TypeConstants.h>
+
+
+#define DEFAULT_FILES	50000
+
+static const char* kAttributes[] = {
+	"BEOS:TYPE",
+	"MAIL:subject",
+	"MAIL:from",
+	"MAIL:to",
+	"MAIL:cc",
+	"MAIL:reply",
+	"MAIL:status",
+	"MAIL:account",
+	"MAIL:thread",
+	"MAIL:when",
+	"MAIL:priority",
+	"MAIL:flags",
+};
+static const size_t kAttributeCount
+	= sizeof(kAttributes) / sizeof(kAttributes[0]);
+static const size_t kAttributeSize = 256;
+
+
+static void
+file_path(char* path, size_t size, const char* directory, int32 index)
+{
+	snprintf(path, size, "%s/attrbench-%" B_PRId32, directory, index);
+}
+
+
+static bool
+create_file(const char* path, int32 index)
+{
+	FILE* file = fopen(path, "w");
+	if (file == NULL)
+		return false;
+	fclose(file);
+
+	BNode node(path);
+	if (node.InitCheck() != B_OK)
+		return false;
+
+	char values[kAttributeCount][64];
+	attr_io_vec vecs[kAttributeCount];
+	for (size_t i = 0; i < kAttributeCount; i++) {
+		if (i == 0)
+			strlcpy(values[i], "text/x-email", sizeof(values[i]));
+		else {
+			snprintf(values[i], sizeof(values[i]), "%s value of mail %" B_PRId32,
+				kAttributes[i], index);
+		}
+
+		vecs[i].name = kAttributes[i];
+		vecs[i].type = i == 0 ? B_MIME_STRING_TYPE : B_STRING_TYPE;
+		vecs[i].buffer = values[i];
+		vecs[i].length = strlen(values[i]) + 1;
+	}
+
+	return node.WriteAttrs(vecs, kAttributeCount) == B_OK;
+}
+
+
+static int32
+read_single(const char* path)
+{
+	BNode node(path);
+	if (node.InitCheck() != B_OK)
+		return -1;
+
+	char buffer[kAttributeSize];
+	int32 found = 0;
+	for (size_t i = 0; i < kAttributeCount; i++) {
+		if (node.ReadAttr(kAttributes[i], B_ANY_TYPE, 0, buffer,
+				sizeof(buffer)) > 0) {
+			found++;
+		}
+	}
+
+	return found;
+}
+
+
+static int32
+read_batched(const char* path)
+{
+	BNode node(path);
+	if (node.InitCheck() != B_OK)
+		return -1;
+
+	char buffers[kAttributeCount][kAttributeSize];
+	attr_io_vec vecs[kAttributeCount];
+	for (size_t i = 0; i < kAttributeCount; i++) {
+		vecs[i].name = kAttributes[i];
+		vecs[i].type = B_ANY_TYPE;
+		vecs[i].buffer = buffers[i];
+		vecs[i].length = kAttributeSize;
+	}
+
+	if (node.ReadAttrs(vecs, kAttributeCount) != B_OK)
+		return -1;
+
+	int32 found = 0;
+	for (size_t i = 0; i < kAttributeCount; i++) {
+		if (vecs[i].status == B_OK && vecs[i].length > 0)
+			found++;
+	}
+
+	return found;
+}
+
+
+static void
+run_test(const char* name, int32 (*read)(const char*),
+	const char* directory, int32 fileCount)
+{
+	int64 found = 0;
+	bigtime_t startTime = system_time();
+
+	for (int32 i = 0; i < fileCount; i++) {
+		char path[B_PATH_NAME_LENGTH];
+		file_path(path, sizeof(path), directory, i);
+
+		int32 count = read(path);
+		if (count < 0) {
+			fprintf(stderr, "attrbench: could not read \"%s\"\n", path);
+			exit(1);
+		}
+		found += count;
+	}
+
+	bigtime_t elapsed = system_time() - startTime;
+	printf("%-10s %" B_PRId32 " files, %" B_PRId64 " attributes: %"
+		B_PRIdBIGTIME " us, %f us per file\n", name, fileCount, found,
+		elapsed, (double)elapsed / fileCount);
+}
+
+
+static void
+usage()
+{
+	printf("attrbench <directory> [<files>]\n");
+	exit(1);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	if (argc < 2 || argc > 3)
+		usage();
+
+	const char* directory = argv[1];
+	int32 fileCount = argc > 2 ? atol(argv[2]) : DEFAULT_FILES;
+	if (fileCount < 1)
+		usage();
+
+	bigtime_t startTime = system_time();
+	for (int32 i = 0; i < fileCount; i++) {
+		char path[B_PATH_NAME_LENGTH];
+		file_path(path, sizeof(path), directory, i);
+		if (!create_file(path, i)) {
+			fprintf(stderr, "attrbench: could not create \"%s\"\n", path);
+			return 1;
+		}
+	}
+	printf("created %" B_PRId32 " files in %" B_PRIdBIGTIME " us\n",
+		fileCount, system_time() - startTime);
+
+	// warm up the caches
+	run_test("warm up", &read_single, directory, fileCount);
+
+	run_test("ReadAttr", &read_single, directory, fileCount);
+	run_test("ReadAttrs", &read_batched, directory, fileCount);
+
+	for (int32 i = 0; i < fileCount; i++) {
+		char path[B_PATH_NAME_LENGTH];
+		file_path(path, sizeof(path), directory, i);
+		unlink(path);
+	}
+
+	return 0;
+}
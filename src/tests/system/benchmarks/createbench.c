@@ -0,0 +1,178 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+/*!	Creates and removes lots of empty files from several threads at once,
+	each one working in its own directory below the given one. Since this
+	mostly changes file system meta data, it stresses the block cache, and
+	its write back.
+	Pass directories on different volumes to see how well they are written
+	back in parallel.
+	With -s, every file is synced after it has been created; on BFS, the
+	threads then share their log writes.
+*/
+
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <OS.h>
+
+
+#define DEFAULT_FILES	10000
+#define MAX_THREADS		32
+
+
+typedef struct thread_data {
+	char		directory[B_PATH_NAME_LENGTH];
+	int32		files;
+	int			sync;
+	bigtime_t	create_time;
+	bigtime_t	unlink_time;
+} thread_data;
+
+
+static int32
+create_thread(void* _data)
+{
+	thread_data* data = (thread_data*)_data;
+	char path[B_PATH_NAME_LENGTH];
+	bigtime_t startTime;
+	int32 i;
+
+	if (mkdir(data->directory, 0755) != 0)
+		return 1;
+
+	startTime = system_time();
+
+	for (i = 0; i < data->files; i++) {
+		int fd;
+
+		snprintf(path, sizeof(path), "%s/file-%" B_PRId32, data->directory, i);
+		fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+		if (fd < 0)
+			return 1;
+		if (data->sync && fsync(fd) != 0) {
+			close(fd);
+			return 1;
+		}
+		close(fd);
+	}
+
+	data->create_time = system_time() - startTime;
+	startTime = system_time();
+
+	for (i = 0; i < data->files; i++) {
+		snprintf(path, sizeof(path), "%s/file-%" B_PRId32, data->directory, i);
+		if (unlink(path) != 0)
+			return 1;
+	}
+
+	data->unlink_time = system_time() - startTime;
+
+	rmdir(data->directory);
+	return 0;
+}
+
+
+static void
+usage(void)
+{
+	printf("createbench [-s] [-t <threads>] [-n <files per thread>] "
+		"<directory> [<directory>...]\n");
+	exit(1);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	thread_data data[MAX_THREADS];
+	thread_id threads[MAX_THREADS];
+	int32 threadCount = 4;
+	int32 files = DEFAULT_FILES;
+	int syncFiles = 0;
+	int32 directoryCount;
+	bigtime_t startTime;
+	bigtime_t elapsed;
+	bigtime_t maxCreate = 0;
+	bigtime_t maxUnlink = 0;
+	int32 failed = 0;
+	int32 i;
+	int option;
+
+	while ((option = getopt(argc, argv, "st:n:")) != -1) {
+		switch (option) {
+			case 's':
+				syncFiles = 1;
+				break;
+			case 't':
+				threadCount = atol(optarg);
+				break;
+			case 'n':
+				files = atol(optarg);
+				break;
+			default:
+				usage();
+		}
+	}
+
+	directoryCount = argc - optind;
+	if (directoryCount < 1 || threadCount < 1 || threadCount > MAX_THREADS
+		|| files < 1) {
+		usage();
+	}
+
+	startTime = system_time();
+
+	for (i = 0; i < threadCount; i++) {
+		snprintf(data[i].directory, sizeof(data[i].directory),
+			"%s/createbench-%" B_PRId32, argv[optind + i % directoryCount], i);
+		data[i].files = files;
+		data[i].sync = syncFiles;
+		data[i].create_time = 0;
+		data[i].unlink_time = 0;
+
+		threads[i] = spawn_thread(&create_thread, "create", B_NORMAL_PRIORITY,
+			&data[i]);
+		if (threads[i] < 0) {
+			fprintf(stderr, "createbench: failed to spawn thread\n");
+			return 1;
+		}
+		resume_thread(threads[i]);
+	}
+
+	for (i = 0; i < threadCount; i++) {
+		status_t returnValue;
+		wait_for_thread(threads[i], &returnValue);
+		if (returnValue != 0) {
+			fprintf(stderr, "createbench: thread %" B_PRId32 " failed in "
+				"\"%s\"\n", i, data[i].directory);
+			failed++;
+		}
+
+		if (data[i].create_time > maxCreate)
+			maxCreate = data[i].create_time;
+		if (data[i].unlink_time > maxUnlink)
+			maxUnlink = data[i].unlink_time;
+	}
+
+	elapsed = system_time() - startTime;
+	if (failed > 0)
+		return 1;
+
+	printf("%" B_PRId32 " threads, %" B_PRId32 " files each%s:\n",
+		threadCount, files, syncFiles ? ", synced" : "");
+	printf("  create: %8" B_PRIdBIGTIME " us, %f files/s\n", maxCreate,
+		1000000.0 * threadCount * files / maxCreate);
+	printf("  unlink: %8" B_PRIdBIGTIME " us, %f files/s\n", maxUnlink,
+		1000000.0 * threadCount * files / maxUnlink);
+	printf("  total:  %8" B_PRIdBIGTIME " us\n", elapsed);
+
+	return 0;
+}
@@ -0,0 +1,168 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+/*!	Measures how long it takes to write and fsync() a small file, once on an
+	idle system, and once while another thread copies a large file to the
+	same directory. Without write-back throttling, the copy fills memory with
+	modified pages, and the small writes have to wait behind them.
+*/
+
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <OS.h>
+
+
+#define DEFAULT_SIZE_MB		2048
+#define COPY_BUFFER_SIZE	(256 * 1024)
+#define SMALL_SIZE			4096
+#define SAMPLE_INTERVAL		100000
+
+
+static char sLargePath[B_PATH_NAME_LENGTH];
+static char sSmallPath[B_PATH_NAME_LENGTH];
+static off_t sLargeSize;
+static volatile bool sCopying;
+
+
+static int32
+copy_thread(void* data)
+{
+	char* buffer = (char*)malloc(COPY_BUFFER_SIZE);
+	bigtime_t startTime;
+	off_t written = 0;
+	int fd;
+
+	if (buffer == NULL)
+		return 1;
+	memset(buffer, 0x55, COPY_BUFFER_SIZE);
+
+	fd = open(sLargePath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		free(buffer);
+		return 1;
+	}
+
+	startTime = system_time();
+
+	while (written < sLargeSize) {
+		ssize_t bytes = write(fd, buffer, COPY_BUFFER_SIZE);
+		if (bytes <= 0)
+			break;
+		written += bytes;
+	}
+
+	fsync(fd);
+	close(fd);
+	free(buffer);
+
+	printf("copied %" B_PRIdOFF " MB in %f s\n", written / (1024 * 1024),
+		(system_time() - startTime) / 1000000.0);
+
+	sCopying = false;
+	return 0;
+}
+
+
+static bigtime_t
+write_small_file(void)
+{
+	char buffer[SMALL_SIZE];
+	bigtime_t startTime = system_time();
+	int fd;
+
+	memset(buffer, 0xaa, sizeof(buffer));
+
+	fd = open(sSmallPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "fsyncbench: could not create \"%s\"\n", sSmallPath);
+		exit(1);
+	}
+
+	write(fd, buffer, sizeof(buffer));
+	fsync(fd);
+	close(fd);
+
+	return system_time() - startTime;
+}
+
+
+static void
+sample(const char* name, int32 count)
+{
+	bigtime_t total = 0;
+	bigtime_t minimum = B_INFINITE_TIMEOUT;
+	bigtime_t maximum = 0;
+	int32 samples = 0;
+
+	while (count < 0 ? sCopying : samples < count) {
+		bigtime_t latency = write_small_file();
+		total += latency;
+		if (latency < minimum)
+			minimum = latency;
+		if (latency > maximum)
+			maximum = latency;
+		samples++;
+
+		snooze(SAMPLE_INTERVAL);
+	}
+
+	if (samples == 0)
+		return;
+
+	printf("%-10s %4" B_PRId32 " fsyncs: min %8" B_PRIdBIGTIME " us, avg %8"
+		B_PRIdBIGTIME " us, max %8" B_PRIdBIGTIME " us\n", name, samples,
+		minimum, total / samples, maximum);
+}
+
+
+static void
+usage(void)
+{
+	printf("fsyncbench <directory> [<copy size in MB>]\n");
+	exit(1);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	thread_id thread;
+	status_t returnValue;
+	int32 sizeMB = DEFAULT_SIZE_MB;
+
+	if (argc < 2 || argc > 3)
+		usage();
+	if (argc > 2)
+		sizeMB = atol(argv[2]);
+	if (sizeMB < 1)
+		usage();
+
+	sLargeSize = (off_t)sizeMB * 1024 * 1024;
+	snprintf(sLargePath, sizeof(sLargePath), "%s/fsyncbench-large", argv[1]);
+	snprintf(sSmallPath, sizeof(sSmallPath), "%s/fsyncbench-small", argv[1]);
+
+	sample("idle", 20);
+
+	sCopying = true;
+	thread = spawn_thread(&copy_thread, "copy", B_NORMAL_PRIORITY, NULL);
+	if (thread < 0) {
+		fprintf(stderr, "fsyncbench: failed to spawn thread\n");
+		return 1;
+	}
+	resume_thread(thread);
+
+	sample("copying", -1);
+	wait_for_thread(thread, &returnValue);
+
+	unlink(sLargePath);
+	unlink(sSmallPath);
+
+	return returnValue == 0 ? 0 : 1;
+}
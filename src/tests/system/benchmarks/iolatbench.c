@@ -0,0 +1,195 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+/*!	Measures the latency of small random reads from a raw disk device, once
+	while the disk is idle, and once while another team writes a large file
+	to a directory on the same disk. The I/O class of the writing team can be
+	chosen; to see the difference the deadline I/O scheduler makes, enable it
+	with "io_scheduler deadline" in the kernel settings.
+*/
+
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <Drivers.h>
+#include <OS.h>
+
+#include <syscalls.h>
+#include <thread_defs.h>
+
+
+#define DEFAULT_SIZE_MB		2048
+#define WRITE_BUFFER_SIZE	(256 * 1024)
+#define READ_SIZE			4096
+#define SAMPLE_INTERVAL		50000
+
+
+static char sReadBuffer[READ_SIZE];
+
+
+static void
+write_file(const char* path, off_t size, int32 ioClass)
+{
+	char* buffer = (char*)malloc(WRITE_BUFFER_SIZE);
+	bigtime_t startTime;
+	off_t written = 0;
+	int fd;
+
+	if (buffer == NULL)
+		exit(1);
+	memset(buffer, 0x55, WRITE_BUFFER_SIZE);
+
+	if (ioClass != IO_CLASS_DEFAULT
+		&& _kern_set_team_io_class(B_CURRENT_TEAM, ioClass) != B_OK) {
+		fprintf(stderr, "iolatbench: could not set the I/O class\n");
+		exit(1);
+	}
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		exit(1);
+
+	startTime = system_time();
+
+	while (written < size) {
+		ssize_t bytes = write(fd, buffer, WRITE_BUFFER_SIZE);
+		if (bytes <= 0)
+			break;
+		written += bytes;
+	}
+
+	fsync(fd);
+	close(fd);
+	free(buffer);
+
+	printf("wrote %" B_PRIdOFF " MB in %f s\n", written / (1024 * 1024),
+		(system_time() - startTime) / 1000000.0);
+	exit(0);
+}
+
+
+static void
+sample(const char* name, int fd, off_t deviceSize, pid_t writer)
+{
+	bigtime_t total = 0;
+	bigtime_t minimum = B_INFINITE_TIMEOUT;
+	bigtime_t maximum = 0;
+	int32 samples = 0;
+
+	while (writer >= 0 ? waitpid(writer, NULL, WNOHANG) == 0 : samples < 50) {
+		off_t offset = ((off_t)rand() * RAND_MAX + rand())
+			% (deviceSize / READ_SIZE) * READ_SIZE;
+		bigtime_t startTime = system_time();
+		bigtime_t latency;
+
+		if (pread(fd, sReadBuffer, READ_SIZE, offset) != READ_SIZE) {
+			fprintf(stderr, "iolatbench: reading the device failed\n");
+			exit(1);
+		}
+
+		latency = system_time() - startTime;
+		total += latency;
+		if (latency < minimum)
+			minimum = latency;
+		if (latency > maximum)
+			maximum = latency;
+		samples++;
+
+		snooze(SAMPLE_INTERVAL);
+	}
+
+	if (samples == 0)
+		return;
+
+	printf("%-10s %4" B_PRId32 " reads: min %8" B_PRIdBIGTIME " us, avg %8"
+		B_PRIdBIGTIME " us, max %8" B_PRIdBIGTIME " us\n", name, samples,
+		minimum, total / samples, maximum);
+}
+
+
+static void
+usage(void)
+{
+	printf("iolatbench [-c realtime|best-effort|idle] <raw device> "
+		"<directory on that device> [<write size in MB>]\n");
+	exit(1);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	char path[B_PATH_NAME_LENGTH];
+	device_geometry geometry;
+	off_t deviceSize;
+	int32 ioClass = IO_CLASS_DEFAULT;
+	int32 sizeMB = DEFAULT_SIZE_MB;
+	pid_t writer;
+	int option;
+	int fd;
+
+	while ((option = getopt(argc, argv, "c:")) != -1) {
+		switch (option) {
+			case 'c':
+				if (!strcmp(optarg, "realtime"))
+					ioClass = IO_CLASS_REALTIME;
+				else if (!strcmp(optarg, "best-effort"))
+					ioClass = IO_CLASS_BEST_EFFORT;
+				else if (!strcmp(optarg, "idle"))
+					ioClass = IO_CLASS_IDLE;
+				else
+					usage();
+				break;
+			default:
+				usage();
+		}
+	}
+
+	if (argc - optind < 2 || argc - optind > 3)
+		usage();
+	if (argc - optind > 2)
+		sizeMB = atol(argv[optind + 2]);
+	if (sizeMB < 1)
+		usage();
+
+	fd = open(argv[optind], O_RDONLY);
+	if (fd < 0 || ioctl(fd, B_GET_GEOMETRY, &geometry,
+			sizeof(geometry)) != 0) {
+		fprintf(stderr, "iolatbench: could not open device \"%s\"\n",
+			argv[optind]);
+		return 1;
+	}
+
+	deviceSize = (off_t)geometry.bytes_per_sector
+		* geometry.sectors_per_track * geometry.cylinder_count
+		* geometry.head_count;
+	if (deviceSize < READ_SIZE)
+		usage();
+
+	snprintf(path, sizeof(path), "%s/iolatbench-large", argv[optind + 1]);
+	srand(system_time());
+
+	sample("idle", fd, deviceSize, -1);
+
+	writer = fork();
+	if (writer < 0) {
+		fprintf(stderr, "iolatbench: fork() failed\n");
+		return 1;
+	}
+	if (writer == 0)
+		write_file(path, (off_t)sizeMB * 1024 * 1024, ioClass);
+
+	sample("writing", fd, deviceSize, writer);
+
+	close(fd);
+	unlink(path);
+	return 0;
+}
@@ -0,0 +1,175 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+/*!	Measures how many small random reads per second a raw disk device
+	completes, with a growing number of threads reading from it at the same
+	time. On devices with one queue per CPU (NVMe, or virtio block devices
+	with several queues, as QEMU provides them with "num-queues"), the rate
+	should grow with the number of threads until the device is saturated.
+*/
+
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <Drivers.h>
+#include <OS.h>
+
+
+#define READ_SIZE			4096
+#define MAX_THREADS			64
+#define DEFAULT_DURATION	5
+
+
+typedef struct thread_data {
+	int			fd;
+	off_t		blocks;
+	uint32		seed;
+	int64		reads;
+} thread_data;
+
+
+static bigtime_t sEndTime;
+
+
+static int32
+read_thread(void* _data)
+{
+	thread_data* data = (thread_data*)_data;
+	void* buffer;
+
+	if (posix_memalign(&buffer, B_PAGE_SIZE, READ_SIZE) != 0)
+		return 1;
+
+	while (system_time() < sEndTime) {
+		off_t block;
+
+		// a simple LCG, as rand() is not meant to be used from many threads
+		data->seed = data->seed * 1103515245 + 12345;
+		block = ((off_t)data->seed << 16 ^ data->reads) % data->blocks;
+
+		if (pread(data->fd, buffer, READ_SIZE, block * READ_SIZE)
+				!= READ_SIZE) {
+			free(buffer);
+			return 1;
+		}
+		data->reads++;
+	}
+
+	free(buffer);
+	return 0;
+}
+
+
+static int
+run(int fd, off_t blocks, int32 threadCount, int32 duration)
+{
+	thread_data data[MAX_THREADS];
+	thread_id threads[MAX_THREADS];
+	int64 reads = 0;
+	int32 i;
+
+	sEndTime = system_time() + duration * 1000000LL;
+
+	for (i = 0; i < threadCount; i++) {
+		data[i].fd = fd;
+		data[i].blocks = blocks;
+		data[i].seed = (uint32)system_time() + i * 7919;
+		data[i].reads = 0;
+
+		threads[i] = spawn_thread(&read_thread, "read", B_NORMAL_PRIORITY,
+			&data[i]);
+		if (threads[i] < 0) {
+			fprintf(stderr, "iopsbench: failed to spawn thread\n");
+			return 1;
+		}
+		resume_thread(threads[i]);
+	}
+
+	for (i = 0; i < threadCount; i++) {
+		status_t returnValue;
+		wait_for_thread(threads[i], &returnValue);
+		if (returnValue != 0) {
+			fprintf(stderr, "iopsbench: reading the device failed\n");
+			return 1;
+		}
+		reads += data[i].reads;
+	}
+
+	printf("%3" B_PRId32 " threads: %10.0f reads/s\n", threadCount,
+		(double)reads / duration);
+	return 0;
+}
+
+
+static void
+usage(void)
+{
+	printf("iopsbench [-t <max threads>] [-d <seconds per run>] "
+		"<raw device>\n");
+	exit(1);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	device_geometry geometry;
+	off_t blocks;
+	int32 maxThreads = 0;
+	int32 duration = DEFAULT_DURATION;
+	int32 threadCount;
+	int option;
+	int fd;
+
+	while ((option = getopt(argc, argv, "t:d:")) != -1) {
+		switch (option) {
+			case 't':
+				maxThreads = atol(optarg);
+				break;
+			case 'd':
+				duration = atol(optarg);
+				break;
+			default:
+				usage();
+		}
+	}
+
+	if (maxThreads == 0) {
+		system_info info;
+		get_system_info(&info);
+		maxThreads = info.cpu_count * 2;
+	}
+
+	if (argc - optind != 1 || maxThreads < 1 || maxThreads > MAX_THREADS
+		|| duration < 1) {
+		usage();
+	}
+
+	fd = open(argv[optind], O_RDONLY);
+	if (fd < 0 || ioctl(fd, B_GET_GEOMETRY, &geometry,
+			sizeof(geometry)) != 0) {
+		fprintf(stderr, "iopsbench: could not open device \"%s\"\n",
+			argv[optind]);
+		return 1;
+	}
+
+	blocks = (off_t)geometry.bytes_per_sector * geometry.sectors_per_track
+		* geometry.cylinder_count * geometry.head_count / READ_SIZE;
+	if (blocks < 1)
+		usage();
+
+	for (threadCount = 1; threadCount <= maxThreads; threadCount *= 2) {
+		if (run(fd, blocks, threadCount, duration) != 0)
+			return 1;
+	}
+
+	close(fd);
+	return 0;
+}
@@ -0,0 +1,162 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+/*!	Lists a directory the way Tracker or "ls -l" do, once with readdir() and
+	a stat() (and optionally an attribute read) per entry, and once with
+	BDirectory::GetNextDirentsWithStat(). Optionally fills the directory with
+	the given number of files first.
+*/
+
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <Directory.h>
+#include <fs_attr.h>
+#include <OS.h>
+
+
+static const char* kTypeAttribute = "BEOS:TYPE";
+static const size_t kTypeSize = B_MIME_TYPE_LENGTH;
+static const int32 kEntriesPerCall = 128;
+
+
+static int32
+list_readdir(const char* directory, bool readType)
+{
+	DIR* dir = opendir(directory);
+	if (dir == NULL)
+		return -1;
+
+	int32 count = 0;
+	while (dirent* entry = readdir(dir)) {
+		char path[B_PATH_NAME_LENGTH];
+		snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+
+		struct stat st;
+		if (lstat(path, &st) != 0)
+			continue;
+
+		if (readType) {
+			char type[kTypeSize];
+			int fd = open(path, O_RDONLY | O_NOTRAVERSE);
+			if (fd >= 0) {
+				fs_read_attr(fd, kTypeAttribute, B_MIME_STRING_TYPE, 0, type,
+					sizeof(type));
+				close(fd);
+			}
+		}
+		count++;
+	}
+
+	closedir(dir);
+	return count;
+}
+
+
+static int32
+list_with_stat(const char* directory, bool readType)
+{
+	BDirectory dir(directory);
+	if (dir.InitCheck() != B_OK)
+		return -1;
+
+	char buffer[64 * 1024];
+	struct stat stats[kEntriesPerCall];
+	char* types = readType ? new char[kEntriesPerCall * kTypeSize] : NULL;
+
+	int32 count = 0;
+	while (true) {
+		int32 read = dir.GetNextDirentsWithStat((dirent*)buffer,
+			sizeof(buffer), stats, kEntriesPerCall,
+			readType ? kTypeAttribute : NULL, types, readType ? kTypeSize : 0);
+		if (read <= 0)
+			break;
+
+		for (int32 i = 0; i < read; i++) {
+			if (stats[i].st_mode != 0)
+				count++;
+		}
+	}
+
+	delete[] types;
+	return count;
+}
+
+
+static void
+run_test(const char* name, int32 (*list)(const char*, bool),
+	const char* directory, bool readType)
+{
+	bigtime_t startTime = system_time();
+	int32 count = list(directory, readType);
+	bigtime_t elapsed = system_time() - startTime;
+
+	if (count < 0) {
+		fprintf(stderr, "listdirbench: could not list \"%s\"\n", directory);
+		exit(1);
+	}
+
+	printf("%-28s %7" B_PRId32 " entries: %8" B_PRIdBIGTIME " us, %f us per "
+		"entry\n", name, count, elapsed, (double)elapsed / count);
+}
+
+
+static void
+usage()
+{
+	printf("listdirbench <directory> [<files to create>]\n");
+	exit(1);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	if (argc < 2 || argc > 3)
+		usage();
+
+	const char* directory = argv[1];
+	int32 createCount = argc > 2 ? atol(argv[2]) : 0;
+	if (createCount < 0)
+		usage();
+
+	for (int32 i = 0; i < createCount; i++) {
+		char path[B_PATH_NAME_LENGTH];
+		snprintf(path, sizeof(path), "%s/listdirbench-%" B_PRId32, directory,
+			i);
+		int fd = open(path, O_RDWR | O_CREAT, 0644);
+		if (fd < 0) {
+			fprintf(stderr, "listdirbench: could not create \"%s\"\n", path);
+			return 1;
+		}
+		fs_write_attr(fd, kTypeAttribute, B_MIME_STRING_TYPE, 0, "text/plain",
+			sizeof("text/plain"));
+		close(fd);
+	}
+
+	// warm up the caches
+	list_readdir(directory, true);
+
+	run_test("readdir + lstat", &list_readdir, directory, false);
+	run_test("GetNextDirentsWithStat", &list_with_stat, directory, false);
+	run_test("readdir + lstat + type", &list_readdir, directory, true);
+	run_test("GetNextDirentsWithStat + type", &list_with_stat, directory,
+		true);
+
+	for (int32 i = 0; i < createCount; i++) {
+		char path[B_PATH_NAME_LENGTH];
+		snprintf(path, sizeof(path), "%s/listdirbench-%" B_PRId32, directory,
+			i);
+		unlink(path);
+	}
+
+	return 0;
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+/*!	Calls get_thread_info() and kill(pid, 0) from a number of threads in
+	parallel. Both boil down to a thread respectively team hash table lookup
+	in the kernel, so the achieved call rate shows how well those lookups
+	scale with the number of CPUs.
+*/
+
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <OS.h>
+
+
+#define DEFAULT_THREADS		4
+#define DEFAULT_ITERATIONS	500000
+#define MAX_THREADS			256
+
+
+static int32 sIterations = DEFAULT_ITERATIONS;
+static thread_id sTargetThread;
+
+
+static int32
+thread_info_thread(void* data)
+{
+	thread_info info;
+	int32 i;
+
+	for (i = 0; i < sIterations; i++) {
+		if (get_thread_info(sTargetThread, &info) != B_OK)
+			return 1;
+	}
+
+	return 0;
+}
+
+
+static int32
+kill_thread(void* data)
+{
+	pid_t pid = getpid();
+	int32 i;
+
+	for (i = 0; i < sIterations; i++) {
+		if (kill(pid, 0) != 0)
+			return 1;
+	}
+
+	return 0;
+}
+
+
+static void
+run_test(const char* name, thread_func function, int32 threadCount)
+{
+	thread_id threads[MAX_THREADS];
+	bigtime_t startTime;
+	bigtime_t elapsed;
+	int32 i;
+
+	for (i = 0; i < threadCount; i++) {
+		threads[i] = spawn_thread(function, name, B_NORMAL_PRIORITY, NULL);
+		if (threads[i] < 0) {
+			fprintf(stderr, "lookupbench: failed to spawn threads\n");
+			exit(1);
+		}
+	}
+
+	startTime = system_time();
+
+	for (i = 0; i < threadCount; i++)
+		resume_thread(threads[i]);
+
+	for (i = 0; i < threadCount; i++) {
+		status_t returnValue;
+		wait_for_thread(threads[i], &returnValue);
+	}
+
+	elapsed = system_time() - startTime;
+
+	printf("%s: %f calls/s, %f ns per call and thread\n", name,
+		(double)threadCount * sIterations * 1000000 / elapsed,
+		(double)elapsed * 1000 / sIterations);
+}
+
+
+static void
+usage(void)
+{
+	printf("lookupbench [<threads> [<iterations>]]\n");
+	exit(1);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int32 threadCount = DEFAULT_THREADS;
+
+	if (argc > 3)
+		usage();
+	if (argc > 1)
+		threadCount = atol(argv[1]);
+	if (argc > 2)
+		sIterations = atol(argv[2]);
+	if (threadCount < 1 || threadCount > MAX_THREADS || sIterations < 1)
+		usage();
+
+	sTargetThread = find_thread(NULL);
+
+	printf("threads: %" B_PRId32 ", iterations: %" B_PRId32 "\n", threadCount,
+		sIterations);
+	run_test("get_thread_info", &thread_info_thread, threadCount);
+	run_test("kill(0)", &kill_thread, threadCount);
+
+	return 0;
+}
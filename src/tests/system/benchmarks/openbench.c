@@ -0,0 +1,151 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+/*!	Opens and closes files from a number of threads in parallel. Each thread
+	uses its own set of files in the given directory, so this mostly measures
+	how well getting and putting vnodes scales with the number of CPUs.
+*/
+
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <OS.h>
+
+
+#define DEFAULT_THREADS		16
+#define DEFAULT_ITERATIONS	10000
+#define MAX_THREADS			256
+#define FILES_PER_THREAD	16
+
+
+static const char* sDirectory;
+static int32 sIterations = DEFAULT_ITERATIONS;
+
+
+static void
+file_path(char* path, size_t size, int32 thread, int32 file)
+{
+	snprintf(path, size, "%s/openbench-%" B_PRId32 "-%" B_PRId32, sDirectory,
+		thread, file);
+}
+
+
+static int32
+open_thread(void* data)
+{
+	int32 index = (int32)(addr_t)data;
+	char paths[FILES_PER_THREAD][B_PATH_NAME_LENGTH];
+	int32 i;
+
+	for (i = 0; i < FILES_PER_THREAD; i++)
+		file_path(paths[i], sizeof(paths[i]), index, i);
+
+	for (i = 0; i < sIterations; i++) {
+		int fd = open(paths[i % FILES_PER_THREAD], O_RDONLY);
+		if (fd >= 0)
+			close(fd);
+	}
+
+	return 0;
+}
+
+
+static void
+run_test(int32 threadCount)
+{
+	thread_id threads[MAX_THREADS];
+	bigtime_t startTime;
+	bigtime_t elapsed;
+	int32 i;
+
+	for (i = 0; i < threadCount; i++) {
+		threads[i] = spawn_thread(&open_thread, "open", B_NORMAL_PRIORITY,
+			(void*)(addr_t)i);
+		if (threads[i] < 0) {
+			fprintf(stderr, "openbench: failed to spawn threads\n");
+			exit(1);
+		}
+	}
+
+	startTime = system_time();
+
+	for (i = 0; i < threadCount; i++)
+		resume_thread(threads[i]);
+
+	for (i = 0; i < threadCount; i++) {
+		status_t returnValue;
+		wait_for_thread(threads[i], &returnValue);
+	}
+
+	elapsed = system_time() - startTime;
+
+	printf("%3" B_PRId32 " threads: %f open+close/s, %f us per open+close and "
+		"thread\n", threadCount,
+		(double)threadCount * sIterations * 1000000 / elapsed,
+		(double)elapsed / sIterations);
+}
+
+
+static void
+usage(void)
+{
+	printf("openbench <directory> [<threads> [<iterations>]]\n");
+	exit(1);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int32 threadCount = DEFAULT_THREADS;
+	int32 count;
+	int32 i;
+	int32 j;
+
+	if (argc < 2 || argc > 4)
+		usage();
+	sDirectory = argv[1];
+	if (argc > 2)
+		threadCount = atol(argv[2]);
+	if (argc > 3)
+		sIterations = atol(argv[3]);
+	if (threadCount < 1 || threadCount > MAX_THREADS || sIterations < 1)
+		usage();
+
+	for (i = 0; i < threadCount; i++) {
+		for (j = 0; j < FILES_PER_THREAD; j++) {
+			char path[B_PATH_NAME_LENGTH];
+			int fd;
+
+			file_path(path, sizeof(path), i, j);
+			fd = open(path, O_RDWR | O_CREAT, 0644);
+			if (fd < 0) {
+				fprintf(stderr, "openbench: could not create \"%s\"\n", path);
+				return 1;
+			}
+			close(fd);
+		}
+	}
+
+	// warm up the caches, then scale up to the requested number of threads
+	open_thread(NULL);
+	for (count = 1; count < threadCount; count *= 2)
+		run_test(count);
+	run_test(threadCount);
+
+	for (i = 0; i < threadCount; i++) {
+		for (j = 0; j < FILES_PER_THREAD; j++) {
+			char path[B_PATH_NAME_LENGTH];
+			file_path(path, sizeof(path), i, j);
+			unlink(path);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,274 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+/*!	Measures how long it takes to index an attribute that already exists on
+	lots of files: once the way "reindex" does it by rewriting the attribute
+	of each file, which inserts one key after the other into the index, and
+	once by letting BFS rebuild the index from all files at once. First
+	create the files with -c; the per-file pass can be skipped with -b, as
+	it takes very long for a million files.
+	Both passes are checked with a query that has to find all files.
+*/
+
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fs_attr.h>
+#include <fs_index.h>
+#include <fs_query.h>
+#include <OS.h>
+#include <StorageDefs.h>
+#include <TypeConstants.h>
+
+#include "bfs_control.h"
+
+
+#define DEFAULT_FILES		1000000
+#define FILES_PER_DIRECTORY	1000
+#define ATTRIBUTE			"reindexbench:key"
+
+
+static void
+get_value(int32 index, char* buffer, size_t size)
+{
+	// not in the order of creation, so that the index is not filled
+	// sequentially
+	snprintf(buffer, size, "key-%08" B_PRIx32,
+		(uint32)(index * 2654435761UL));
+}
+
+
+static int
+create_files(const char* base, int32 files)
+{
+	char path[B_PATH_NAME_LENGTH];
+	char value[32];
+	bigtime_t startTime = system_time();
+	int32 i;
+
+	for (i = 0; i < files; i++) {
+		int fd;
+
+		if (i % FILES_PER_DIRECTORY == 0) {
+			snprintf(path, sizeof(path), "%s/%" B_PRId32, base,
+				i / FILES_PER_DIRECTORY);
+			if (mkdir(path, 0755) != 0) {
+				fprintf(stderr, "reindexbench: could not create \"%s\"\n",
+					path);
+				return 1;
+			}
+		}
+
+		snprintf(path, sizeof(path), "%s/%" B_PRId32 "/file-%" B_PRId32, base,
+			i / FILES_PER_DIRECTORY, i);
+		fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+		get_value(i, value, sizeof(value));
+		if (fd < 0 || fs_write_attr(fd, ATTRIBUTE, B_STRING_TYPE, 0, value,
+				strlen(value) + 1) < 0) {
+			fprintf(stderr, "reindexbench: could not write \"%s\"\n", path);
+			return 1;
+		}
+		close(fd);
+	}
+
+	sync();
+
+	printf("created %" B_PRId32 " files in %f s\n", files,
+		(system_time() - startTime) / 1000000.0);
+	return 0;
+}
+
+
+static int
+count_matches(dev_t device)
+{
+	struct dirent* entry;
+	DIR* query;
+	int32 count = 0;
+
+	query = fs_open_query(device, ATTRIBUTE "==\"key-*\"", 0);
+	if (query == NULL)
+		return -1;
+
+	while ((entry = fs_read_query(query)) != NULL)
+		count++;
+
+	fs_close_query(query);
+	return count;
+}
+
+
+/*!	Rewrites the attribute of each file, like "reindex" does. */
+static int
+reindex_files(const char* base, dev_t device)
+{
+	char path[B_PATH_NAME_LENGTH];
+	char value[256];
+	bigtime_t startTime = system_time();
+	int32 files = 0;
+	int32 directory;
+
+	fs_remove_index(device, ATTRIBUTE);
+	if (fs_create_index(device, ATTRIBUTE, B_STRING_TYPE, 0) != 0) {
+		fprintf(stderr, "reindexbench: could not create index: %s\n",
+			strerror(errno));
+		return 1;
+	}
+
+	for (directory = 0;; directory++) {
+		struct dirent* entry;
+		DIR* dir;
+
+		snprintf(path, sizeof(path), "%s/%" B_PRId32, base, directory);
+		dir = opendir(path);
+		if (dir == NULL)
+			break;
+
+		while ((entry = readdir(dir)) != NULL) {
+			ssize_t length;
+			int fd;
+
+			if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+				continue;
+
+			snprintf(path, sizeof(path), "%s/%" B_PRId32 "/%s", base,
+				directory, entry->d_name);
+			fd = open(path, O_RDONLY);
+			if (fd < 0) {
+				fprintf(stderr, "reindexbench: could not open \"%s\"\n", path);
+				return 1;
+			}
+
+			length = fs_read_attr(fd, ATTRIBUTE, B_STRING_TYPE, 0, value,
+				sizeof(value));
+			if (length > 0) {
+				fs_remove_attr(fd, ATTRIBUTE);
+				fs_write_attr(fd, ATTRIBUTE, B_STRING_TYPE, 0, value, length);
+			}
+			close(fd);
+			files++;
+		}
+
+		closedir(dir);
+	}
+
+	sync();
+
+	printf("per file: %" B_PRId32 " files in %f s, query finds %d\n", files,
+		(system_time() - startTime) / 1000000.0, count_matches(device));
+	return 0;
+}
+
+
+/*!	Lets BFS rebuild the index from all files at once. */
+static int
+rebuild_index(const char* base, dev_t device)
+{
+	struct rebuild_index_control control;
+	bigtime_t startTime = system_time();
+	int fd;
+
+	fs_remove_index(device, ATTRIBUTE);
+	if (fs_create_index(device, ATTRIBUTE, B_STRING_TYPE, 0) != 0) {
+		fprintf(stderr, "reindexbench: could not create index: %s\n",
+			strerror(errno));
+		return 1;
+	}
+
+	fd = open(base, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "reindexbench: could not open \"%s\"\n", base);
+		return 1;
+	}
+
+	memset(&control, 0, sizeof(control));
+	strlcpy(control.name, ATTRIBUTE, sizeof(control.name));
+
+	if (ioctl(fd, BFS_IOCTL_REBUILD_INDEX, &control, sizeof(control)) != 0) {
+		fprintf(stderr, "reindexbench: could not rebuild index: %s\n",
+			strerror(errno));
+		close(fd);
+		return 1;
+	}
+	close(fd);
+
+	sync();
+
+	printf("bulk: %" B_PRIu64 " entries in %f s (%f s in BFS), %" B_PRIu64
+		" nodes, %" B_PRIu32 " levels, query finds %d\n", control.entries,
+		(system_time() - startTime) / 1000000.0, control.time / 1000000.0,
+		control.nodes, control.levels, count_matches(device));
+	return 0;
+}
+
+
+static void
+usage(void)
+{
+	printf("reindexbench [-c [-n <files>]] [-b] <directory>\n"
+		"  -c  create the files first\n"
+		"  -n  number of files to create, default is %d\n"
+		"  -b  only rebuild the index in bulk, skip the per-file pass\n",
+		DEFAULT_FILES);
+	exit(1);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int32 files = DEFAULT_FILES;
+	int create = 0;
+	int bulkOnly = 0;
+	const char* base;
+	struct stat info;
+	int option;
+
+	while ((option = getopt(argc, argv, "bcn:")) != -1) {
+		switch (option) {
+			case 'b':
+				bulkOnly = 1;
+				break;
+			case 'c':
+				create = 1;
+				break;
+			case 'n':
+				files = atol(optarg);
+				break;
+			default:
+				usage();
+		}
+	}
+
+	if (argc - optind != 1 || files < 1)
+		usage();
+
+	base = argv[optind];
+
+	if (create) {
+		// without an index, creating the files is not slowed down by it
+		if (stat(base, &info) == 0)
+			fs_remove_index(info.st_dev, ATTRIBUTE);
+		if (create_files(base, files) != 0)
+			return 1;
+	}
+
+	if (stat(base, &info) != 0) {
+		fprintf(stderr, "reindexbench: could not find \"%s\"\n", base);
+		return 1;
+	}
+
+	if (!bulkOnly && reindex_files(base, info.st_dev) != 0)
+		return 1;
+
+	return rebuild_index(base, info.st_dev);
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+/*!	Ping-pongs acquire_sem()/release_sem() between a number of thread pairs,
+	each using its own pair of semaphores, and reports the achieved round trip
+	rate. Since the pairs share no semaphores, the rate should scale with the
+	number of pairs up to the number of CPUs.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <OS.h>
+
+
+#define DEFAULT_PAIRS		4
+#define DEFAULT_ITERATIONS	100000
+#define MAX_PAIRS			256
+
+
+typedef struct pair_info {
+	sem_id	ping;
+	sem_id	pong;
+	int32	iterations;
+} pair_info;
+
+
+static int32
+ping_thread(void* data)
+{
+	pair_info* pair = (pair_info*)data;
+	int32 i;
+
+	for (i = 0; i < pair->iterations; i++) {
+		release_sem(pair->ping);
+		if (acquire_sem(pair->pong) != B_OK)
+			return 1;
+	}
+
+	return 0;
+}
+
+
+static int32
+pong_thread(void* data)
+{
+	pair_info* pair = (pair_info*)data;
+	int32 i;
+
+	for (i = 0; i < pair->iterations; i++) {
+		if (acquire_sem(pair->ping) != B_OK)
+			return 1;
+		release_sem(pair->pong);
+	}
+
+	return 0;
+}
+
+
+static void
+usage(void)
+{
+	printf("sembench [<pairs> [<iterations>]]\n");
+	exit(1);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	pair_info pairs[MAX_PAIRS];
+	thread_id threads[MAX_PAIRS * 2];
+	int32 pairCount = DEFAULT_PAIRS;
+	int32 iterations = DEFAULT_ITERATIONS;
+	bigtime_t startTime;
+	bigtime_t elapsed;
+	int32 i;
+
+	if (argc > 3)
+		usage();
+	if (argc > 1)
+		pairCount = atol(argv[1]);
+	if (argc > 2)
+		iterations = atol(argv[2]);
+	if (pairCount < 1 || pairCount > MAX_PAIRS || iterations < 1)
+		usage();
+
+	for (i = 0; i < pairCount; i++) {
+		pairs[i].ping = create_sem(0, "sembench ping");
+		pairs[i].pong = create_sem(0, "sembench pong");
+		pairs[i].iterations = iterations;
+		if (pairs[i].ping < 0 || pairs[i].pong < 0) {
+			fprintf(stderr, "sembench: failed to create semaphores\n");
+			return 1;
+		}
+
+		threads[i * 2] = spawn_thread(&ping_thread, "sembench ping",
+			B_NORMAL_PRIORITY, &pairs[i]);
+		threads[i * 2 + 1] = spawn_thread(&pong_thread, "sembench pong",
+			B_NORMAL_PRIORITY, &pairs[i]);
+		if (threads[i * 2] < 0 || threads[i * 2 + 1] < 0) {
+			fprintf(stderr, "sembench: failed to spawn threads\n");
+			return 1;
+		}
+	}
+
+	startTime = system_time();
+
+	for (i = 0; i < pairCount * 2; i++)
+		resume_thread(threads[i]);
+
+	for (i = 0; i < pairCount * 2; i++) {
+		status_t returnValue;
+		wait_for_thread(threads[i], &returnValue);
+	}
+
+	elapsed = system_time() - startTime;
+
+	for (i = 0; i < pairCount; i++) {
+		delete_sem(pairs[i].ping);
+		delete_sem(pairs[i].pong);
+	}
+
+	printf("pairs: %" B_PRId32 ", iterations: %" B_PRId32 "\n", pairCount,
+		iterations);
+	printf("elapsed time: %" B_PRIdBIGTIME " us\n", elapsed);
+	printf("round trips/s: %f\n",
+		(double)pairCount * iterations * 1000000 / elapsed);
+	printf("round trip latency: %f us\n",
+		(double)elapsed / iterations);
+
+	return 0;
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+/*!	Collects the paths of a directory tree and stat()s all of them from a
+	number of threads in parallel. Once the tree is in the entry and vnode
+	caches, this measures how well path resolution scales with the number of
+	CPUs.
+*/
+
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <OS.h>
+
+
+#define DEFAULT_THREADS		16
+#define DEFAULT_ITERATIONS	10
+#define MAX_THREADS			256
+#define MAX_PATHS			100000
+
+
+static char** sPaths;
+static int32 sPathCount;
+static int32 sIterations = DEFAULT_ITERATIONS;
+
+
+static void
+collect_paths(const char* directory)
+{
+	DIR* dir = opendir(directory);
+	struct dirent* entry;
+
+	if (dir == NULL)
+		return;
+
+	while ((entry = readdir(dir)) != NULL && sPathCount < MAX_PATHS) {
+		char path[B_PATH_NAME_LENGTH];
+		struct stat st;
+
+		if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+			continue;
+
+		snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+		if (lstat(path, &st) != 0)
+			continue;
+
+		sPaths[sPathCount] = strdup(path);
+		if (sPaths[sPathCount] == NULL)
+			break;
+		sPathCount++;
+
+		if (S_ISDIR(st.st_mode))
+			collect_paths(path);
+	}
+
+	closedir(dir);
+}
+
+
+static int32
+stat_thread(void* data)
+{
+	int32 offset = (int32)(addr_t)data;
+	int32 i;
+	int32 j;
+
+	// start at different offsets, so that the threads don't walk the tree
+	// in lock step
+	for (i = 0; i < sIterations; i++) {
+		for (j = 0; j < sPathCount; j++) {
+			struct stat st;
+			lstat(sPaths[(offset + j) % sPathCount], &st);
+		}
+	}
+
+	return 0;
+}
+
+
+static void
+run_test(int32 threadCount)
+{
+	thread_id threads[MAX_THREADS];
+	bigtime_t startTime;
+	bigtime_t elapsed;
+	int32 i;
+
+	for (i = 0; i < threadCount; i++) {
+		threads[i] = spawn_thread(&stat_thread, "stat", B_NORMAL_PRIORITY,
+			(void*)(addr_t)(sPathCount / threadCount * i));
+		if (threads[i] < 0) {
+			fprintf(stderr, "statbench: failed to spawn threads\n");
+			exit(1);
+		}
+	}
+
+	startTime = system_time();
+
+	for (i = 0; i < threadCount; i++)
+		resume_thread(threads[i]);
+
+	for (i = 0; i < threadCount; i++) {
+		status_t returnValue;
+		wait_for_thread(threads[i], &returnValue);
+	}
+
+	elapsed = system_time() - startTime;
+
+	printf("%3" B_PRId32 " threads: %f stats/s, %f us per stat and thread\n",
+		threadCount,
+		(double)threadCount * sIterations * sPathCount * 1000000 / elapsed,
+		(double)elapsed / ((double)sIterations * sPathCount));
+}
+
+
+static void
+usage(void)
+{
+	printf("statbench <directory> [<threads> [<iterations>]]\n");
+	exit(1);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int32 threadCount = DEFAULT_THREADS;
+	int32 count;
+
+	if (argc < 2 || argc > 4)
+		usage();
+	if (argc > 2)
+		threadCount = atol(argv[2]);
+	if (argc > 3)
+		sIterations = atol(argv[3]);
+	if (threadCount < 1 || threadCount > MAX_THREADS || sIterations < 1)
+		usage();
+
+	sPaths = (char**)malloc(MAX_PATHS * sizeof(char*));
+	if (sPaths == NULL) {
+		fprintf(stderr, "statbench: out of memory\n");
+		return 1;
+	}
+
+	collect_paths(argv[1]);
+	if (sPathCount == 0) {
+		fprintf(stderr, "statbench: no entries found in \"%s\"\n", argv[1]);
+		return 1;
+	}
+
+	printf("paths: %" B_PRId32 ", iterations: %" B_PRId32 "\n", sPathCount,
+		sIterations);
+
+	// warm up the caches, then scale up to the requested number of threads
+	stat_thread(NULL);
+	for (count = 1; count < threadCount; count *= 2)
+		run_test(count);
+	run_test(threadCount);
+
+	return 0;
+}
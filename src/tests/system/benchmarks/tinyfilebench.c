@@ -0,0 +1,182 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+/*!	Measures how fast lots of tiny files can be read from a cold cache, as
+	it happens when applications read their settings, or when a source tree
+	is built. First create the files with -c, then unmount and mount the
+	volume again (or reboot), and read them back by omitting -c.
+	On BFS, files that fit into their inode do not need any other block to
+	be read; the space they use shows how many of them did.
+*/
+
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <OS.h>
+
+
+#define DEFAULT_FILES		100000
+#define DEFAULT_SIZE		200
+#define FILES_PER_DIRECTORY	1000
+#define MAX_SIZE			65536
+
+
+static char sBuffer[MAX_SIZE];
+
+
+static int
+create_files(const char* base, int32 files, int32 size)
+{
+	char path[B_PATH_NAME_LENGTH];
+	bigtime_t startTime = system_time();
+	int32 i;
+
+	memset(sBuffer, 'x', size);
+
+	for (i = 0; i < files; i++) {
+		int fd;
+
+		if (i % FILES_PER_DIRECTORY == 0) {
+			snprintf(path, sizeof(path), "%s/%" B_PRId32, base,
+				i / FILES_PER_DIRECTORY);
+			if (mkdir(path, 0755) != 0) {
+				fprintf(stderr, "tinyfilebench: could not create \"%s\"\n",
+					path);
+				return 1;
+			}
+		}
+
+		snprintf(path, sizeof(path), "%s/%" B_PRId32 "/file-%" B_PRId32, base,
+			i / FILES_PER_DIRECTORY, i);
+		fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+		if (fd < 0 || write(fd, sBuffer, size) != size) {
+			fprintf(stderr, "tinyfilebench: could not write \"%s\"\n", path);
+			return 1;
+		}
+		close(fd);
+	}
+
+	sync();
+
+	printf("created %" B_PRId32 " files of %" B_PRId32 " bytes in %f s\n",
+		files, size, (system_time() - startTime) / 1000000.0);
+	printf("now remount the volume, and run again without -c\n");
+	return 0;
+}
+
+
+static int
+read_files(const char* base)
+{
+	char path[B_PATH_NAME_LENGTH];
+	bigtime_t startTime = system_time();
+	bigtime_t elapsed;
+	off_t bytes = 0;
+	off_t allocated = 0;
+	int32 files = 0;
+	int32 directory;
+
+	for (directory = 0;; directory++) {
+		struct dirent* entry;
+		DIR* dir;
+
+		snprintf(path, sizeof(path), "%s/%" B_PRId32, base, directory);
+		dir = opendir(path);
+		if (dir == NULL)
+			break;
+
+		while ((entry = readdir(dir)) != NULL) {
+			struct stat info;
+			ssize_t bytesRead;
+			int fd;
+
+			if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+				continue;
+
+			snprintf(path, sizeof(path), "%s/%" B_PRId32 "/%s", base,
+				directory, entry->d_name);
+			fd = open(path, O_RDONLY);
+			if (fd < 0 || fstat(fd, &info) != 0) {
+				fprintf(stderr, "tinyfilebench: could not open \"%s\"\n", path);
+				return 1;
+			}
+
+			bytesRead = read(fd, sBuffer, sizeof(sBuffer));
+			close(fd);
+			if (bytesRead < 0) {
+				fprintf(stderr, "tinyfilebench: could not read \"%s\"\n", path);
+				return 1;
+			}
+
+			bytes += bytesRead;
+			allocated += (off_t)info.st_blocks * 512;
+			files++;
+		}
+
+		closedir(dir);
+	}
+
+	elapsed = system_time() - startTime;
+	if (files == 0) {
+		fprintf(stderr, "tinyfilebench: no files found, create them with -c "
+			"first\n");
+		return 1;
+	}
+
+	printf("read %" B_PRId32 " files, %" B_PRIdOFF " bytes in %f s: %f "
+		"files/s\n", files, bytes, elapsed / 1000000.0,
+		1000000.0 * files / elapsed);
+	printf("allocated: %" B_PRIdOFF " KB, %" B_PRIdOFF " bytes per file\n",
+		allocated / 1024, allocated / files);
+	return 0;
+}
+
+
+static void
+usage(void)
+{
+	printf("tinyfilebench [-c [-n <files>] [-s <file size>]] <directory>\n");
+	exit(1);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int32 files = DEFAULT_FILES;
+	int32 size = DEFAULT_SIZE;
+	int create = 0;
+	int option;
+
+	while ((option = getopt(argc, argv, "cn:s:")) != -1) {
+		switch (option) {
+			case 'c':
+				create = 1;
+				break;
+			case 'n':
+				files = atol(optarg);
+				break;
+			case 's':
+				size = atol(optarg);
+				break;
+			default:
+				usage();
+		}
+	}
+
+	if (argc - optind != 1 || files < 1 || size < 0 || size > MAX_SIZE)
+		usage();
+
+	if (create)
+		return create_files(argv[optind], files, size);
+
+	return read_files(argv[optind]);
+}
@@ -0,0 +1,149 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Checks that BDirectory::GetNextDirentsWithStat() only returns stat data
+	and attributes of entries in directories the caller may search, just like
+	stat() on the entries would.
+*/
+
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <Directory.h>
+#include <fs_attr.h>
+#include <TypeConstants.h>
+
+
+static const char* kAttribute = "test:read_dir_stat";
+static const char* kAttributeValue = "value";
+static const int kFileCount = 4;
+static const uid_t kUnprivilegedUser = 1000;
+
+
+static int
+list_directory(const char* path, bool expectStat)
+{
+	BDirectory directory(path);
+	if (directory.InitCheck() != B_OK) {
+		fprintf(stderr, "Could not open \"%s\": %s\n", path,
+			strerror(directory.InitCheck()));
+		return 1;
+	}
+
+	char buffer[8192];
+	struct stat stats[16];
+	char attributes[16][16];
+	int32 count = directory.GetNextDirentsWithStat((dirent*)buffer,
+		sizeof(buffer), stats, 16, kAttribute, attributes,
+		sizeof(attributes[0]));
+	if (count < 0) {
+		fprintf(stderr, "Reading \"%s\" failed: %s\n", path, strerror(count));
+		return 1;
+	}
+
+	int files = 0;
+	int result = 0;
+	dirent* entry = (dirent*)buffer;
+	for (int32 i = 0; i < count; i++) {
+		if (strcmp(entry->d_name, ".") != 0
+			&& strcmp(entry->d_name, "..") != 0) {
+			files++;
+
+			bool hasStat = stats[i].st_mode != 0;
+			bool hasAttribute = strcmp(attributes[i], kAttributeValue) == 0;
+			if (hasStat != expectStat || hasAttribute != expectStat) {
+				fprintf(stderr, "\"%s\" in \"%s\": stat data %s, "
+					"attribute %s\n", entry->d_name, path,
+					hasStat ? "returned" : "missing",
+					hasAttribute ? "returned" : "missing");
+				result = 1;
+			}
+		}
+
+		entry = (dirent*)((uint8*)entry + entry->d_reclen);
+	}
+
+	if (files != kFileCount) {
+		fprintf(stderr, "Read %d of %d entries of \"%s\"\n", files,
+			kFileCount, path);
+		result = 1;
+	}
+
+	return result;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	const char* base = argc > 1 ? argv[1] : "/tmp";
+
+	char directory[PATH_MAX];
+	snprintf(directory, sizeof(directory), "%s/read_dir_stat_test", base);
+	if (mkdir(directory, 0755) != 0) {
+		fprintf(stderr, "Could not create \"%s\": %s\n", directory,
+			strerror(errno));
+		return 1;
+	}
+
+	char path[PATH_MAX];
+	for (int i = 0; i < kFileCount; i++) {
+		snprintf(path, sizeof(path), "%s/file-%d", directory, i);
+		int fd = open(path, O_CREAT | O_WRONLY, 0644);
+		if (fd < 0) {
+			fprintf(stderr, "Could not create \"%s\": %s\n", path,
+				strerror(errno));
+			return 1;
+		}
+		fs_write_attr(fd, kAttribute, B_STRING_TYPE, 0, kAttributeValue,
+			strlen(kAttributeValue) + 1);
+		close(fd);
+	}
+
+	// a searchable directory returns everything
+	int result = list_directory(directory, true);
+
+	// root may always search directories, so drop the privileges for the
+	// directory without search permission
+	chmod(directory, 0444);
+	uid_t user = geteuid();
+	if (user == 0 && seteuid(kUnprivilegedUser) != 0) {
+		fprintf(stderr, "Could not change the user: %s\n", strerror(errno));
+		result = 1;
+	} else {
+		struct stat st;
+		snprintf(path, sizeof(path), "%s/file-0", directory);
+		if (stat(path, &st) == 0) {
+			fprintf(stderr, "stat() succeeded without search permission\n");
+			result = 1;
+		}
+
+		// the entries can still be read, but nothing else
+		result |= list_directory(directory, false);
+
+		if (user == 0)
+			seteuid(0);
+	}
+
+	chmod(directory, 0755);
+	for (int i = 0; i < kFileCount; i++) {
+		snprintf(path, sizeof(path), "%s/file-%d", directory, i);
+		unlink(path);
+	}
+	rmdir(directory);
+
+	if (result == 0)
+		printf("All tests passed.\n");
+	return result;
+}
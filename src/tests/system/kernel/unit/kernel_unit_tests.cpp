@@ -20,6 +20,7 @@
 #include "TestOutput.h"
 
 #include "lock/LockTestSuite.h"
+#include "timer/TimerTestSuite.h"
 
 
 int32 api_version = B_CUR_DRIVER_API_VERSION;
@@ -295,6 +296,7 @@ init_driver(void)
 
 	// register test suites
 	sTestManager->AddTest(create_lock_test_suite());
+	sTestManager->AddTest(create_timer_test_suite());
 
 	return B_OK;
 }
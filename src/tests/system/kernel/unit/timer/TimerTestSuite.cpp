@@ -0,0 +1,20 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "TimerTestSuite.h"
+
+#include "TimerWheelTests.h"
+
+
+TestSuite*
+create_timer_test_suite()
+{
+	TestSuite* suite = new(std::nothrow) TestSuite("timer");
+
+	ADD_TEST(suite, create_timer_wheel_test_suite());
+
+	return suite;
+}
@@ -0,0 +1,15 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef TIMER_TEST_SUITE_H
+#define TIMER_TEST_SUITE_H
+
+
+#include "TestSuite.h"
+
+
+TestSuite* create_timer_test_suite();
+
+
+#endif	// TIMER_TEST_SUITE_H
@@ -0,0 +1,142 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "TimerWheelTests.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <timer.h>
+
+
+static const int32 kBenchmarkTimerCount = 100000;
+static const int32 kExpiryTimerCount = 1000;
+
+
+struct test_timer : timer {
+	bigtime_t	due;
+	bigtime_t	fired;
+};
+
+
+static int32
+record_fire_time(timer* _timer)
+{
+	test_timer* testTimer = static_cast<test_timer*>(_timer);
+	testTimer->fired = system_time();
+	return B_HANDLED_INTERRUPT;
+}
+
+
+class TimerWheelTest : public StandardTestDelegate {
+public:
+	TimerWheelTest()
+		:
+		fTimers(NULL)
+	{
+	}
+
+	virtual status_t Setup(TestContext& context)
+	{
+		fTimers = (test_timer*)calloc(kBenchmarkTimerCount,
+			sizeof(test_timer));
+		return fTimers != NULL ? B_OK : B_NO_MEMORY;
+	}
+
+	virtual void Cleanup(TestContext& context, bool setupOK)
+	{
+		if (fTimers != NULL) {
+			for (int32 i = 0; i < kBenchmarkTimerCount; i++)
+				cancel_timer(&fTimers[i]);
+		}
+
+		free(fTimers);
+		fTimers = NULL;
+	}
+
+	bool TestArmCancelCoarse(TestContext& context)
+	{
+		return _ArmCancel(context, B_TIMER_COARSE);
+	}
+
+	bool TestArmCancelPrecise(TestContext& context)
+	{
+		return _ArmCancel(context, 0);
+	}
+
+	bool TestExpiry(TestContext& context)
+	{
+		// Timers must never fire early and at most about an eighth of their
+		// delay late (plus a tick and some scheduling latency).
+		for (int32 i = 0; i < kExpiryTimerCount; i++) {
+			bigtime_t delay = 20000 + i * 200;
+			fTimers[i].fired = 0;
+			fTimers[i].due = system_time() + delay;
+			TEST_ASSERT(add_timer(&fTimers[i], &record_fire_time, delay,
+				B_ONE_SHOT_RELATIVE_TIMER | B_TIMER_COARSE) == B_OK);
+		}
+
+		snooze(20000 + kExpiryTimerCount * 200 * 9 / 8 + 100000);
+
+		for (int32 i = 0; i < kExpiryTimerCount; i++) {
+			bigtime_t delay = 20000 + i * 200;
+			test_timer& testTimer = fTimers[i];
+			TEST_ASSERT_PRINT(testTimer.fired != 0, "timer %" B_PRId32, i);
+			TEST_ASSERT_PRINT(testTimer.fired >= testTimer.due,
+				"timer %" B_PRId32 " fired %" B_PRIdBIGTIME " us early", i,
+				testTimer.due - testTimer.fired);
+			TEST_ASSERT_PRINT(testTimer.fired - testTimer.due
+					<= delay / 8 + 10000,
+				"timer %" B_PRId32 " fired %" B_PRIdBIGTIME " us late", i,
+				testTimer.fired - testTimer.due);
+		}
+
+		return true;
+	}
+
+private:
+	bool _ArmCancel(TestContext& context, uint32 flags)
+	{
+		// spread the delays over a minute, so that they hit all wheel levels
+		bigtime_t startTime = system_time();
+		for (int32 i = 0; i < kBenchmarkTimerCount; i++) {
+			bigtime_t delay = 1000000 + (bigtime_t)i * 613 % 59000000;
+			TEST_ASSERT(add_timer(&fTimers[i], &record_fire_time, delay,
+				B_ONE_SHOT_RELATIVE_TIMER | flags) == B_OK);
+		}
+		bigtime_t armTime = system_time() - startTime;
+
+		// cancel them in a different order than they were added
+		startTime = system_time();
+		for (int32 i = 0; i < kBenchmarkTimerCount; i++) {
+			int32 index = (int32)((int64)i * 7919 % kBenchmarkTimerCount);
+			TEST_ASSERT_PRINT(!cancel_timer(&fTimers[index]),
+				"timer %" B_PRId32 " not pending", index);
+		}
+		bigtime_t cancelTime = system_time() - startTime;
+
+		context.Print("%" B_PRId32 " timers: arm %" B_PRIdBIGTIME " us, cancel %"
+			B_PRIdBIGTIME " us\n", kBenchmarkTimerCount, armTime, cancelTime);
+
+		return true;
+	}
+
+private:
+			test_timer*	fTimers;
+};
+
+
+TestSuite*
+create_timer_wheel_test_suite()
+{
+	TestSuite* suite = new(std::nothrow) TestSuite("wheel");
+
+	ADD_STANDARD_TEST(suite, TimerWheelTest, TestArmCancelCoarse);
+	ADD_STANDARD_TEST(suite, TimerWheelTest, TestArmCancelPrecise);
+	ADD_STANDARD_TEST(suite, TimerWheelTest, TestExpiry);
+
+	return suite;
+}
@@ -0,0 +1,15 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef TIMER_WHEEL_TESTS_H
+#define TIMER_WHEEL_TESTS_H
+
+
+#include "TestSuite.h"
+
+
+TestSuite* create_timer_wheel_test_suite();
+
+
+#endif	// TIMER_WHEEL_TESTS_H
@@ -0,0 +1,146 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+/*!	Stresses the VFS vnode management: a number of threads create, open,
+	stat and remove files on a freshly mounted ramfs, while the main thread
+	repeatedly force-unmounts and remounts the volume underneath them.
+	The test fails if mounting or unmounting ever fails for another reason
+	than the volume being busy, or if the kernel doesn't survive it.
+*/
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fs_volume.h>
+#include <OS.h>
+
+
+static const int32 kThreadCount = 8;
+static const int32 kFilesPerThread = 64;
+static const int32 kDefaultRounds = 50;
+static const bigtime_t kRoundTime = 100000;
+
+static char sMountPoint[B_PATH_NAME_LENGTH];
+static int32 sQuit = 0;
+static int32 sOperations = 0;
+static int32 sFailures = 0;
+
+
+static status_t
+mount_volume()
+{
+	dev_t volume = fs_mount_volume(sMountPoint, NULL, "ramfs", 0, NULL);
+	if (volume < 0) {
+		fprintf(stderr, "vnode_unmount_test: mounting ramfs failed: %s\n",
+			strerror(volume));
+		return volume;
+	}
+	return B_OK;
+}
+
+
+static int32
+file_thread(void* data)
+{
+	int32 index = (int32)(addr_t)data;
+
+	while (atomic_get(&sQuit) == 0) {
+		for (int32 i = 0; i < kFilesPerThread; i++) {
+			char path[B_PATH_NAME_LENGTH];
+			snprintf(path, sizeof(path), "%s/file-%" B_PRId32 "-%" B_PRId32,
+				sMountPoint, index, i);
+
+			// All of these may fail while the volume is being unmounted; we
+			// are only interested in the kernel not tripping over it.
+			int fd = open(path, O_RDWR | O_CREAT, 0644);
+			if (fd >= 0) {
+				write(fd, path, strlen(path));
+				close(fd);
+			} else
+				atomic_add(&sFailures, 1);
+
+			struct stat st;
+			stat(path, &st);
+			unlink(path);
+			atomic_add(&sOperations, 1);
+		}
+	}
+
+	return 0;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int32 rounds = argc > 1 ? atol(argv[1]) : kDefaultRounds;
+	if (rounds < 1) {
+		fprintf(stderr, "usage: %s [<rounds>]\n", argv[0]);
+		return 1;
+	}
+
+	snprintf(sMountPoint, sizeof(sMountPoint), "/tmp/vnode_unmount_test-%"
+		B_PRId32, getpid());
+	if (mkdir(sMountPoint, 0755) != 0 && errno != EEXIST) {
+		fprintf(stderr, "vnode_unmount_test: could not create mount point: "
+			"%s\n", strerror(errno));
+		return 1;
+	}
+
+	if (mount_volume() != B_OK)
+		return 1;
+
+	thread_id threads[kThreadCount];
+	for (int32 i = 0; i < kThreadCount; i++) {
+		threads[i] = spawn_thread(&file_thread, "files", B_NORMAL_PRIORITY,
+			(void*)(addr_t)i);
+		resume_thread(threads[i]);
+	}
+
+	int result = 0;
+	int32 busyCount = 0;
+	for (int32 round = 0; round < rounds; round++) {
+		snooze(kRoundTime);
+
+		// a regular unmount may fail, since the files are in use
+		status_t status = fs_unmount_volume(sMountPoint, 0);
+		if (status == B_BUSY) {
+			busyCount++;
+			status = fs_unmount_volume(sMountPoint, B_FORCE_UNMOUNT);
+		}
+		if (status != B_OK) {
+			fprintf(stderr, "vnode_unmount_test: round %" B_PRId32 ": "
+				"unmounting failed: %s\n", round, strerror(status));
+			result = 1;
+			break;
+		}
+
+		if (mount_volume() != B_OK) {
+			result = 1;
+			break;
+		}
+	}
+
+	atomic_set(&sQuit, 1);
+	for (int32 i = 0; i < kThreadCount; i++) {
+		status_t returnValue;
+		wait_for_thread(threads[i], &returnValue);
+	}
+
+	if (fs_unmount_volume(sMountPoint, B_FORCE_UNMOUNT) != B_OK)
+		result = 1;
+	rmdir(sMountPoint);
+
+	printf("%" B_PRId32 " rounds (%" B_PRId32 " busy), %" B_PRId32
+		" operations, %" B_PRId32 " failed opens: %s\n", rounds, busyCount,
+		sOperations, sFailures, result == 0 ? "passed" : "FAILED");
+	return result;
+}
@@ -7,6 +7,10 @@
 #include "fssh.h"
 
 #include "command_checkfs.h"
+#include "command_defrag.h"
+#include "command_explain.h"
+#include "command_growlog.h"
+#include "command_rebuildindex.h"
 #include "command_resizefs.h"
 
 
@@ -18,6 +22,14 @@ register_additional_commands()
 {
 	CommandManager::Default()->AddCommand(command_checkfs, "checkfs",
 		"check file system");
+	CommandManager::Default()->AddCommand(command_defrag, "defrag",
+		"move fragmented files into contiguous runs");
+	CommandManager::Default()->AddCommand(command_explain, "explain",
+		"explain how a query is evaluated");
+	CommandManager::Default()->AddCommand(command_growlog, "growlog",
+		"grow the log area");
+	CommandManager::Default()->AddCommand(command_rebuildindex,
+		"rebuildindex", "rebuild an index from the files of the volume");
 	CommandManager::Default()->AddCommand(command_resizefs, "resizefs",
 		"resize file system");
 }
@@ -0,0 +1,64 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "fssh_stdio.h"
+#include "fssh_string.h"
+#include "syscalls.h"
+
+#include "bfs.h"
+#include "bfs_control.h"
+
+
+namespace FSShell {
+
+
+fssh_status_t
+command_defrag(int argc, const char* const* argv)
+{
+	if (argc > 2) {
+		fssh_dprintf("Usage: %s [<load in percent>]\n", argv[0]);
+		return B_ERROR;
+	}
+
+	defragment_control control;
+	fssh_memset(&control, 0, sizeof(control));
+
+	if (argc == 2 && (fssh_sscanf(argv[1], "%" B_SCNu32, &control.load) < 1
+			|| control.load > 100)) {
+		fssh_dprintf("Unknown argument or invalid load\n");
+		return B_ERROR;
+	}
+
+	int rootDir = _kern_open_dir(-1, "/myfs");
+	if (rootDir < 0) {
+		fssh_dprintf("Error: Couldn't open root directory\n");
+		return rootDir;
+	}
+
+	status_t status = _kern_ioctl(rootDir, BFS_IOCTL_DEFRAGMENT,
+		&control, sizeof(control));
+
+	_kern_close(rootDir);
+
+	if (status != B_OK) {
+		fssh_dprintf("Defragmenting failed, status: %s\n",
+			fssh_strerror(status));
+		return status;
+	}
+
+	fssh_dprintf("Moved %" FSSH_B_PRIu64 " of %" FSSH_B_PRIu64 " fragmented "
+		"nodes, %" FSSH_B_PRIu64 " blocks, in %" FSSH_B_PRId64 " ms\n",
+		control.moved_nodes, control.fragmented_nodes, control.moved_blocks,
+		control.time / 1000);
+	fssh_dprintf("The %" FSSH_B_PRIu64 " data streams had %" FSSH_B_PRIu64
+		" extents before, and %" FSSH_B_PRIu64 " after\n", control.nodes,
+		control.fragments_before, control.fragments_after);
+
+	return B_OK;
+}
+
+
+}	// namespace FSShell
@@ -0,0 +1,21 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef DEFRAG_H
+#define DEFRAG_H
+
+
+#include "fssh_types.h"
+
+
+namespace FSShell {
+
+
+fssh_status_t command_defrag(int argc, const char* const* argv);
+
+
+}	// namespace FSShell
+
+
+#endif	// DEFRAG_H
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "fssh_stdio.h"
+#include "fssh_string.h"
+#include "syscalls.h"
+
+#include "bfs.h"
+#include "bfs_control.h"
+
+
+namespace FSShell {
+
+
+fssh_status_t
+command_explain(int argc, const char* const* argv)
+{
+	bool nonIndexed = false;
+	if (argc == 3 && !fssh_strcmp(argv[1], "-n"))
+		nonIndexed = true;
+	else if (argc != 2) {
+		fssh_dprintf("Usage: %s [-n] <query>\n"
+			"  -n  also query attributes without an index\n", argv[0]);
+		return B_ERROR;
+	}
+
+	char plan[4096];
+	explain_query_control control;
+	control.query = argv[argc - 1];
+	control.flags = nonIndexed ? B_QUERY_NON_INDEXED : 0;
+	control.buffer = plan;
+	control.buffer_size = sizeof(plan);
+
+	int rootDir = _kern_open_dir(-1, "/myfs");
+	if (rootDir < 0) {
+		fssh_dprintf("Error: Couldn't open root directory\n");
+		return rootDir;
+	}
+
+	status_t status = _kern_ioctl(rootDir, BFS_IOCTL_EXPLAIN_QUERY,
+		&control, sizeof(control));
+
+	_kern_close(rootDir);
+
+	if (status != B_OK) {
+		fssh_dprintf("Explaining the query failed, status: %s\n",
+			fssh_strerror(status));
+		return status;
+	}
+
+	fssh_dprintf("%s", plan);
+	if (control.buffer_size > sizeof(plan))
+		fssh_dprintf("(plan truncated)\n");
+
+	return B_OK;
+}
+
+
+}	// namespace FSShell
@@ -0,0 +1,53 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "fssh_stdio.h"
+#include "syscalls.h"
+
+#include "bfs.h"
+#include "bfs_control.h"
+
+
+namespace FSShell {
+
+
+fssh_status_t
+command_growlog(int argc, const char* const* argv)
+{
+	if (argc != 2) {
+		fssh_dprintf("Usage: %s <log size in blocks>\n", argv[0]);
+		return B_ERROR;
+	}
+
+	uint32 length;
+	if (fssh_sscanf(argv[1], "%" B_SCNu32, &length) < 1) {
+		fssh_dprintf("Unknown argument or invalid size\n");
+		return B_ERROR;
+	}
+
+	int rootDir = _kern_open_dir(-1, "/myfs");
+	if (rootDir < 0) {
+		fssh_dprintf("Error: Couldn't open root directory\n");
+		return rootDir;
+	}
+
+	status_t status = _kern_ioctl(rootDir, BFS_IOCTL_GROW_LOG,
+		&length, sizeof(length));
+
+	_kern_close(rootDir);
+
+	if (status != B_OK) {
+		fssh_dprintf("Growing the log failed, status: %s\n",
+			fssh_strerror(status));
+		return status;
+	}
+
+	fssh_dprintf("Log successfully grown to %" B_PRIu32 " blocks!\n", length);
+	return B_OK;
+}
+
+
+}	// namespace FSShell
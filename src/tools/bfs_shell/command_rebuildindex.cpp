@@ -0,0 +1,56 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "fssh_stdio.h"
+#include "fssh_string.h"
+#include "syscalls.h"
+
+#include "bfs.h"
+#include "bfs_control.h"
+
+
+namespace FSShell {
+
+
+fssh_status_t
+command_rebuildindex(int argc, const char* const* argv)
+{
+	if (argc != 2) {
+		fssh_dprintf("Usage: %s <index>\n", argv[0]);
+		return B_ERROR;
+	}
+
+	rebuild_index_control control;
+	fssh_memset(&control, 0, sizeof(control));
+	fssh_strlcpy(control.name, argv[1], sizeof(control.name));
+
+	int rootDir = _kern_open_dir(-1, "/myfs");
+	if (rootDir < 0) {
+		fssh_dprintf("Error: Couldn't open root directory\n");
+		return rootDir;
+	}
+
+	status_t status = _kern_ioctl(rootDir, BFS_IOCTL_REBUILD_INDEX,
+		&control, sizeof(control));
+
+	_kern_close(rootDir);
+
+	if (status != B_OK) {
+		fssh_dprintf("Rebuilding the index failed, status: %s\n",
+			fssh_strerror(status));
+		return status;
+	}
+
+	fssh_dprintf("Rebuilt index \"%s\": %" FSSH_B_PRIu64 " entries in %"
+		FSSH_B_PRIu64 " nodes, %" FSSH_B_PRIu32 " levels, %" FSSH_B_PRId64
+		" ms\n", control.name, control.entries, control.nodes, control.levels,
+		control.time / 1000);
+
+	return B_OK;
+}
+
+
+}	// namespace FSShell
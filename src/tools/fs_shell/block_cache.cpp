@@ -1740,6 +1740,17 @@ fssh_block_cache_get(void* _cache, fssh_off_t blockNumber)
 }
 
 
+/*!	The fs_shell reads all blocks synchronously, so prefetching them would
+	not gain anything.
+*/
+fssh_status_t
+fssh_block_cache_prefetch(void* _cache, fssh_off_t blockNumber,
+	fssh_size_t numBlocks)
+{
+	return FSSH_B_OK;
+}
+
+
 /*!	Changes the internal status of a writable block to \a dirty. This can be
 	helpful in case you realize you don't need to change that block anymore
 	for whatever reason.